@@ -0,0 +1,477 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* benchmark suite for the main umesh kernels: generates synthetic
+   meshes of configurable size and element mix, times loading,
+   saving, and the major algorithms on them - optionally for multiple
+   thread counts - and reports times and throughput as JSON, so
+   results of different versions can be compared */
+
+#include "umesh/io/UMesh.h"
+#include "umesh/FaceConn.h"
+#include "umesh/TetConn.h"
+#include "umesh/extractIsoSurface.h"
+#include "umesh/extractShellFaces.h"
+#include "umesh/fixNegativeVolumes.h"
+#include "umesh/partition.h"
+#include "umesh/profile.h"
+#include "umesh/tetrahedralize.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace umesh {
+
+  // ==================================================================
+  // synthetic meshes
+  // ==================================================================
+
+  /*! smooth scalar field over the unit cube, with a (wobbly) sphere
+      of radius ~.3 around its center as iso-surface for value 0 */
+  inline float testScalar(const vec3f &p)
+  {
+    const vec3f d = p - vec3f(.5f);
+    return length(d) - .3f + .02f*sinf(20.f*p.x)*sinf(20.f*p.y)*sinf(20.f*p.z);
+  }
+
+  /*! vertex index of grid point (ix,iy,iz) of a grid with N cells per
+      side */
+  inline int gridVertex(int N, int ix, int iy, int iz)
+  {
+    return ix + (N+1)*(iy + (N+1)*iz);
+  }
+
+  /*! (N+1)^3 vertices of a regular grid over the unit cube, with
+      testScalar() values */
+  UMesh::SP createGridVertices(int N)
+  {
+    UMesh::SP mesh = std::make_shared<UMesh>();
+    mesh->perVertex = std::make_shared<Attribute>();
+    for (int iz=0;iz<=N;iz++)
+      for (int iy=0;iy<=N;iy++)
+        for (int ix=0;ix<=N;ix++) {
+          const vec3f p = vec3f(ix,iy,iz)*(1.f/N);
+          mesh->vertices.push_back(p);
+          mesh->perVertex->values.push_back(testScalar(p));
+        }
+    return mesh;
+  }
+
+  /*! the eight corners of cell (ix,iy,iz), with corner c at offset
+      (c&1,(c>>1)&1,(c>>2)&1) */
+  inline void cellCorners(int N, int ix, int iy, int iz, int corner[8])
+  {
+    for (int c=0;c<8;c++)
+      corner[c] = gridVertex(N,ix+(c&1),iy+((c>>1)&1),iz+((c>>2)&1));
+  }
+
+  inline Hex makeHex(const int c[8])
+  {
+    Hex hex;
+    hex.base = vec4i(c[0],c[1],c[3],c[2]);
+    hex.top  = vec4i(c[4],c[5],c[7],c[6]);
+    return hex;
+  }
+
+  /*! structured grid of N^3 hexes */
+  UMesh::SP createHexGrid(int N)
+  {
+    UMesh::SP mesh = createGridVertices(N);
+    for (int iz=0;iz<N;iz++)
+      for (int iy=0;iy<N;iy++)
+        for (int ix=0;ix<N;ix++) {
+          int c[8];
+          cellCorners(N,ix,iy,iz,c);
+          mesh->hexes.push_back(makeHex(c));
+        }
+    return mesh;
+  }
+
+  /*! N^3 grid cells, each split into the six (conforming) tets along
+      its main diagonal */
+  UMesh::SP createTetGrid(int N)
+  {
+    UMesh::SP mesh = createGridVertices(N);
+    const int axes[6][2] = {{0,1},{0,2},{1,0},{1,2},{2,0},{2,1}};
+    for (int iz=0;iz<N;iz++)
+      for (int iy=0;iy<N;iy++)
+        for (int ix=0;ix<N;ix++) {
+          int c[8];
+          cellCorners(N,ix,iy,iz,c);
+          for (auto &axis : axes) {
+            const int a = 1<<axis[0], b = a | (1<<axis[1]);
+            mesh->tets.push_back(Tet(c[0],c[a],c[b],c[7]));
+          }
+        }
+    return mesh;
+  }
+
+  /*! N^3 grid cells, each of which (chosen randomly, but
+      reproducibly) is either a hex, six pyramids around a new center
+      vertex, or two wedges; the elements of each type, as well as the
+      vertices, then get shuffled into random order, so this also has
+      none of the memory locality the grids have. Note the wedges'
+      triangle faces do not match the quad faces of the cells above
+      and below them, so (like many real-world meshes) this mesh is
+      not entirely conforming */
+  UMesh::SP createMixedMesh(int N)
+  {
+    UMesh::SP mesh = createGridVertices(N);
+    std::mt19937 rng(0x1234567);
+    /* the cube's six quad faces, as corners in cyclic order */
+    const int faces[6][4] = {
+      {0,1,3,2},{4,5,7,6},{0,1,5,4},{2,3,7,6},{0,2,6,4},{1,3,7,5}
+    };
+    for (int iz=0;iz<N;iz++)
+      for (int iy=0;iy<N;iy++)
+        for (int ix=0;ix<N;ix++) {
+          int c[8];
+          cellCorners(N,ix,iy,iz,c);
+          switch (rng() % 4) {
+          case 0:
+          case 1:
+            mesh->hexes.push_back(makeHex(c));
+            break;
+          case 2: {
+            const vec3f center = vec3f(ix+.5f,iy+.5f,iz+.5f)*(1.f/N);
+            const int top = (int)mesh->vertices.size();
+            mesh->vertices.push_back(center);
+            mesh->perVertex->values.push_back(testScalar(center));
+            for (auto &f : faces) {
+              Pyr pyr;
+              pyr.base = vec4i(c[f[0]],c[f[1]],c[f[2]],c[f[3]]);
+              pyr.top  = top;
+              mesh->pyrs.push_back(pyr);
+            }
+          } break;
+          default: {
+            Wedge w0, w1;
+            w0.front = vec3i(c[0],c[1],c[3]); w0.back = vec3i(c[4],c[5],c[7]);
+            w1.front = vec3i(c[0],c[3],c[2]); w1.back = vec3i(c[4],c[7],c[6]);
+            mesh->wedges.push_back(w0);
+            mesh->wedges.push_back(w1);
+          }
+          }
+        }
+
+    std::vector<int> newID(mesh->vertices.size());
+    for (size_t i=0;i<newID.size();i++) newID[i] = (int)i;
+    std::shuffle(newID.begin(),newID.end(),rng);
+    std::vector<vec3f> vertices(newID.size());
+    std::vector<float> scalars(newID.size());
+    for (size_t i=0;i<newID.size();i++) {
+      vertices[newID[i]] = mesh->vertices[i];
+      scalars[newID[i]]  = mesh->perVertex->values[i];
+    }
+    mesh->vertices = vertices;
+    mesh->perVertex->values = scalars;
+    auto remap = [&](auto &prims) {
+      for (auto &prim : prims)
+        for (int i=0;i<prim.numVertices;i++)
+          prim[i] = newID[prim[i]];
+      std::shuffle(prims.begin(),prims.end(),rng);
+    };
+    remap(mesh->hexes);
+    remap(mesh->pyrs);
+    remap(mesh->wedges);
+    return mesh;
+  }
+
+  /*! creates the mesh of given kind, with N cells along each side,
+      with all elements in VTK (positive-volume) order, and
+      finalized */
+  UMesh::SP createMesh(const std::string &kind, int N)
+  {
+    UMesh::SP mesh;
+    if (kind == "hexes")
+      mesh = createHexGrid(N);
+    else if (kind == "tets")
+      mesh = createTetGrid(N);
+    else if (kind == "mixed")
+      mesh = createMixedMesh(N);
+    else
+      throw std::runtime_error("unknown mesh kind '"+kind+"' (hexes, tets, or mixed)");
+    fixNegativeVolumes(mesh);
+    mesh->finalize();
+    return mesh;
+  }
+
+  /*! number of bytes of the mesh's vertices, scalars, and elements;
+      what most kernels have to read (at least) once */
+  size_t numBytesOf(const UMesh &mesh)
+  {
+    return mesh.vertices.size()*sizeof(vec3f)
+      + (mesh.perVertex ? mesh.perVertex->values.size()*sizeof(float) : 0)
+      + mesh.triangles.size()*sizeof(Triangle)
+      + mesh.quads.size()*sizeof(Quad)
+      + mesh.tets.size()*sizeof(Tet)
+      + mesh.pyrs.size()*sizeof(Pyr)
+      + mesh.wedges.size()*sizeof(Wedge)
+      + mesh.hexes.size()*sizeof(Hex);
+  }
+
+  // ==================================================================
+  // benchmarking
+  // ==================================================================
+
+  struct Benchmark {
+    std::string name;
+    /*! runs the benchmarked operation once on given mesh */
+    std::function<void(UMesh::SP)> run;
+    /*! whether this benchmark can run on given mesh */
+    std::function<bool(const UMesh &)> applies;
+    /*! number of bytes this operation processes on given mesh, for
+        the GB/s number; defaults to numBytesOf() */
+    std::function<size_t(const UMesh &)> numBytes;
+  };
+
+  struct Result {
+    std::string benchmark;
+    int         numThreads;
+    double      seconds;
+    double      elementsPerSecond;
+    double      gigaBytesPerSecond;
+  };
+
+  /*! runs given function once under given number of threads */
+  void withThreads(int numThreads, const std::function<void()> &f)
+  {
+#if UMESH_HAVE_TBB
+    ScopedExecutor use(Executor::createTBB(numThreads));
+#else
+    ScopedExecutor use(Executor::createThreadPool(numThreads));
+#endif
+    f();
+  }
+
+  /*! runs given benchmark 'numRuns' times, and returns the fastest
+      time, in seconds */
+  double timeBenchmark(const Benchmark &benchmark, UMesh::SP mesh,
+                       int numThreads, int numRuns)
+  {
+    double best = 0.;
+    for (int run=0;run<numRuns;run++) {
+      double secs = 0.;
+      withThreads(numThreads,[&](){
+          const auto begin = std::chrono::steady_clock::now();
+          benchmark.run(mesh);
+          const auto end = std::chrono::steady_clock::now();
+          secs = std::chrono::duration<double>(end-begin).count();
+        });
+      if (run == 0 || secs < best) best = secs;
+    }
+    return best;
+  }
+
+  std::vector<Benchmark> createBenchmarks(const std::string &tmpFileName)
+  {
+    auto always   = [](const UMesh &) { return true; };
+    auto onlyTets = [](const UMesh &mesh) {
+      return !mesh.tets.empty() && mesh.tets.size() == mesh.numVolumeElements();
+    };
+    auto fileSize = [tmpFileName](const UMesh &) {
+      std::ifstream in(tmpFileName,std::ios::binary|std::ios::ate);
+      return in.good() ? (size_t)in.tellg() : size_t(0);
+    };
+    auto input = [](const UMesh &mesh) { return numBytesOf(mesh); };
+    
+    std::vector<Benchmark> benchmarks;
+    benchmarks.push_back({"save",[tmpFileName](UMesh::SP mesh)
+                          { mesh->saveTo(tmpFileName); },always,fileSize});
+    benchmarks.push_back({"load",[tmpFileName](UMesh::SP)
+                          { UMesh::loadFrom(tmpFileName); },always,fileSize});
+    // (a clean mesh's finalize() would not look at anything)
+    benchmarks.push_back({"finalize",[](UMesh::SP mesh)
+                          { mesh->markDirty(); mesh->finalize(); },always,input});
+    benchmarks.push_back({"FaceConn::compute(SORT)",[](UMesh::SP mesh)
+                          { FaceConn::compute(mesh,FaceConn::SORT); },always,input});
+    benchmarks.push_back({"FaceConn::compute(HASH)",[](UMesh::SP mesh)
+                          { FaceConn::compute(mesh,FaceConn::HASH); },always,input});
+    benchmarks.push_back({"TetConn::computeFrom",[](UMesh::SP mesh)
+                          { TetConn::computeFrom(mesh); },onlyTets,input});
+    benchmarks.push_back({"extractIsoSurface",[](UMesh::SP mesh)
+                          { extractIsoSurface(mesh,0.f); },always,input});
+    benchmarks.push_back({"tetrahedralize",[](UMesh::SP mesh)
+                          { tetrahedralize(mesh); },always,input});
+    benchmarks.push_back({"extractShellFaces",[](UMesh::SP mesh)
+                          { extractShellFaces(mesh,true); },always,input});
+    benchmarks.push_back({"extractBoundaryFaces",[](UMesh::SP mesh)
+                          { extractBoundaryFaces(mesh,true); },always,input});
+    benchmarks.push_back({"partition",[](UMesh::SP mesh)
+                          { PartitionOptions options;
+                            options.maxBricks = 64;
+                            partition(mesh,options); },always,input});
+    return benchmarks;
+  }
+
+  /*! parses a comma-separated list of strings */
+  std::vector<std::string> parseList(const std::string &list)
+  {
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss,item,','))
+      if (!item.empty()) items.push_back(item);
+    return items;
+  }
+
+  void usage(const std::string &error = "")
+  {
+    if (error != "")
+      std::cerr << "Error : " << error  << "\n\n";
+
+    std::cout << "Usage: ./umeshBench [args]" << std::endl;
+    std::cout << "w/ Args: " << std::endl;
+    std::cout << "--meshes <kinds>\n\tcomma-separated list of synthetic meshes to run on:"
+              << " hexes, tets, and/or mixed (default: all three)" << std::endl;
+    std::cout << "-n <cellsPerSide>\n\tmesh size: kinds get N^3 grid cells (default: 64)" << std::endl;
+    std::cout << "--threads <counts>\n\tcomma-separated list of thread counts to run with"
+              << " (default: 1 and all hardware threads)" << std::endl;
+    std::cout << "--runs <N>\n\treport the best of N runs (default: 3)" << std::endl;
+    std::cout << "--only <names>\n\tcomma-separated list of benchmarks to run (default: all)" << std::endl;
+    std::cout << "--tmp <file.umesh>\n\tfile for the load/save benchmarks (default: umeshBench.tmp.umesh)" << std::endl;
+    std::cout << "--profile\n\tprint each benchmark's per-stage breakdown (summed over all runs)" << std::endl;
+    std::cout << "-o <out.json>\n\twrite results to this file (default: umeshBench.json)" << std::endl;
+    exit(error != "");
+  }
+  
+  extern "C" int main(int ac, char **av)
+  {
+    try {
+      std::vector<std::string> meshKinds = { "hexes", "tets", "mixed" };
+      std::vector<std::string> only;
+      std::vector<int>         threadCounts;
+      int N = 64;
+      int numRuns = 3;
+      bool printProfile = false;
+      std::string tmpFileName = "umeshBench.tmp.umesh";
+      std::string outFileName = "umeshBench.json";
+      for (int i=1;i<ac;i++) {
+        const std::string arg = av[i];
+        if (arg == "-h")
+          usage();
+        else if (arg == "--meshes")
+          meshKinds = parseList(av[++i]);
+        else if (arg == "-n")
+          N = std::max(1,atoi(av[++i]));
+        else if (arg == "--threads") {
+          threadCounts.clear();
+          for (auto count : parseList(av[++i]))
+            threadCounts.push_back(std::max(1,atoi(count.c_str())));
+        } else if (arg == "--runs")
+          numRuns = std::max(1,atoi(av[++i]));
+        else if (arg == "--only")
+          only = parseList(av[++i]);
+        else if (arg == "--tmp")
+          tmpFileName = av[++i];
+        else if (arg == "--profile")
+          printProfile = true;
+        else if (arg == "-o")
+          outFileName = av[++i];
+        else
+          usage("unknown cmd-line arg '"+arg+"'");
+      }
+      if (threadCounts.empty()) {
+        threadCounts.push_back(1);
+        const int maxThreads = (int)std::thread::hardware_concurrency();
+        if (maxThreads > 1) threadCounts.push_back(maxThreads);
+      }
+
+      const std::vector<Benchmark> benchmarks = createBenchmarks(tmpFileName);
+      for (auto &name : only) {
+        bool known = false;
+        for (auto &benchmark : benchmarks)
+          known = known || benchmark.name == name;
+        if (!known) usage("unknown benchmark '"+name+"'");
+      }
+
+      std::stringstream json;
+      json << "{\n  \"cellsPerSide\": " << N
+           << ",\n  \"numRuns\": " << numRuns
+           << ",\n  \"meshes\": [";
+      for (size_t meshID=0;meshID<meshKinds.size();meshID++) {
+        const std::string &kind = meshKinds[meshID];
+        std::cout << "#umeshBench: creating '" << kind << "' mesh ..." << std::endl;
+        UMesh::SP mesh = createMesh(kind,N);
+        std::cout << "#umeshBench: " << mesh->toString() << std::endl;
+        // make sure the file for 'load' exists even if 'save' does not run
+        mesh->saveTo(tmpFileName);
+
+        json << (meshID ? "," : "") << "\n    {\n"
+             << "      \"kind\": \"" << kind << "\",\n"
+             << "      \"numVertices\": " << mesh->vertices.size() << ",\n"
+             << "      \"numTets\": " << mesh->tets.size() << ",\n"
+             << "      \"numPyrs\": " << mesh->pyrs.size() << ",\n"
+             << "      \"numWedges\": " << mesh->wedges.size() << ",\n"
+             << "      \"numHexes\": " << mesh->hexes.size() << ",\n"
+             << "      \"results\": [";
+        bool first = true;
+        for (auto &benchmark : benchmarks) {
+          if (!only.empty() &&
+              std::find(only.begin(),only.end(),benchmark.name) == only.end())
+            continue;
+          if (!benchmark.applies(*mesh))
+            continue;
+          for (int numThreads : threadCounts) {
+            profile::Summary stages;
+            if (printProfile)
+              profile::setSink(stages.sink(),/*sampleMemory:*/true);
+            const double secs = timeBenchmark(benchmark,mesh,numThreads,numRuns);
+            profile::setSink(nullptr);
+            Result result;
+            result.benchmark          = benchmark.name;
+            result.numThreads         = numThreads;
+            result.seconds            = secs;
+            result.elementsPerSecond  = mesh->numVolumeElements()/secs;
+            result.gigaBytesPerSecond = benchmark.numBytes(*mesh)/secs/1e9;
+            std::cout << "#umeshBench: " << kind << " " << benchmark.name
+                      << " (" << numThreads << " threads) : "
+                      << prettyDouble(secs) << "s" << std::endl;
+            if (printProfile)
+              std::cout << stages.toString();
+            json << (first ? "" : ",") << "\n        { "
+                 << "\"benchmark\": \"" << result.benchmark << "\", "
+                 << "\"threads\": " << result.numThreads << ", "
+                 << "\"seconds\": " << result.seconds << ", "
+                 << "\"elementsPerSecond\": " << result.elementsPerSecond << ", "
+                 << "\"GBPerSecond\": " << result.gigaBytesPerSecond << " }";
+            first = false;
+          }
+        }
+        json << "\n      ]\n    }";
+      }
+      json << "\n  ]\n}\n";
+      std::remove(tmpFileName.c_str());
+
+      std::ofstream out(outFileName);
+      out << json.str();
+      if (!out.good())
+        throw std::runtime_error("could not write results to '"+outFileName+"'");
+      std::cout << "#umeshBench: results written to " << outFileName << std::endl;
+    }
+    catch (std::exception &e) {
+      std::cerr << "fatal error " << e.what() << std::endl;
+      exit(1);
+    }
+    return 0;
+  }
+  
+} // ::umesh
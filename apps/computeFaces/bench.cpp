@@ -0,0 +1,131 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* benchmarks the FaceConn::compute() engines - sort-based, and
+   hash-based, plus the cuda one if umesh was built with it - against
+   each other, on the same input mesh, and checks that all find the
+   same faces */
+
+#include "umesh/io/UMesh.h"
+#include "umesh/FaceConn.h"
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+
+namespace umesh {
+
+  /*! orders faces by vertex indices, so the results of the two
+      engines can be compared */
+  bool lessByVertices(const FaceConn::SharedFace &a,
+                      const FaceConn::SharedFace &b)
+  {
+    const vec4i &ia = a.vertexIdx, &ib = b.vertexIdx;
+    if (ia.x != ib.x) return ia.x < ib.x;
+    if (ia.y != ib.y) return ia.y < ib.y;
+    if (ia.z != ib.z) return ia.z < ib.z;
+    return ia.w < ib.w;
+  }
+
+  bool operator!=(const FaceConn::PrimFacetRef &a,
+                  const FaceConn::PrimFacetRef &b)
+  {
+    return a.primType != b.primType
+      || a.facetIdx != b.facetIdx
+      || a.primIdx  != b.primIdx;
+  }
+
+  /*! checks if both sets of faces are the same, ignoring order */
+  bool sameFaces(std::vector<FaceConn::SharedFace> a,
+                 std::vector<FaceConn::SharedFace> b)
+  {
+    if (a.size() != b.size()) return false;
+    std::sort(a.begin(),a.end(),lessByVertices);
+    std::sort(b.begin(),b.end(),lessByVertices);
+    for (size_t i=0;i<a.size();i++)
+      if (lessByVertices(a[i],b[i]) || lessByVertices(b[i],a[i]) ||
+          a[i].onFront != b[i].onFront || a[i].onBack != b[i].onBack)
+        return false;
+    return true;
+  }
+
+  /*! runs given engine 'numRuns' times, and returns the fastest
+      time, in seconds */
+  double benchmark(UMesh::SP mesh, FaceConn::Method method, int numRuns,
+                   FaceConn::SP &result)
+  {
+    double best = 0.;
+    for (int run=0;run<numRuns;run++) {
+      const auto begin = std::chrono::steady_clock::now();
+      result = FaceConn::compute(mesh,method);
+      const auto end = std::chrono::steady_clock::now();
+      const double secs = std::chrono::duration<double>(end-begin).count();
+      if (run == 0 || secs < best) best = secs;
+    }
+    return best;
+  }
+
+  extern "C" int main(int ac, char **av)
+  {
+    try {
+      std::string inFileName;
+      int numRuns = 3;
+      for (int i = 1; i < ac; i++) {
+        const std::string arg = av[i];
+        if (arg == "-n" || arg == "--num-runs")
+          numRuns = std::max(1,atoi(av[++i]));
+        else if (arg[0] != '-')
+          inFileName = arg;
+        else
+          throw std::runtime_error("./umeshComputeFacesBench <in.umesh> [-n numRuns]");
+      }
+      if (inFileName == "")
+        throw std::runtime_error("no input file specified");
+
+      std::cout << "loading umesh from " << inFileName << std::endl;
+      UMesh::SP mesh = io::loadBinaryUMesh(inFileName);
+      std::cout << "done loading, got " << mesh->toString() << std::endl;
+
+      FaceConn::SP sorted, hashed;
+      const double sortTime = benchmark(mesh,FaceConn::SORT,numRuns,sorted);
+      const double hashTime = benchmark(mesh,FaceConn::HASH,numRuns,hashed);
+
+      std::cout << "found " << prettyNumber(sorted->faces.size()) << " faces" << std::endl;
+      std::cout << "sort-based engine : " << prettyDouble(sortTime) << "s" << std::endl;
+      std::cout << "hash-based engine : " << prettyDouble(hashTime) << "s" << std::endl;
+      std::cout << "speedup (sort/hash) : " << std::fixed << std::setprecision(2)
+                << (sortTime/hashTime) << "x" << std::endl;
+
+      if (!sameFaces(sorted->faces,hashed->faces))
+        throw std::runtime_error("sort- and hash-based engines found different faces!");
+      std::cout << "both engines found the same faces" << std::endl;
+#if UMESH_HAVE_CUDA
+      FaceConn::SP onDevice;
+      const double cudaTime = benchmark(mesh,FaceConn::CUDA,numRuns,onDevice);
+      std::cout << "cuda engine : " << prettyDouble(cudaTime) << "s" << std::endl;
+      std::cout << "speedup (sort/cuda) : " << std::fixed << std::setprecision(2)
+                << (sortTime/cudaTime) << "x" << std::endl;
+      if (!sameFaces(sorted->faces,onDevice->faces))
+        throw std::runtime_error("sort-based and cuda engines found different faces!");
+      std::cout << "cuda engine found the same faces" << std::endl;
+#endif
+    } catch (std::exception &e) {
+      std::cerr << "fatal error " << e.what() << std::endl;
+      exit(1);
+    }
+    return 0;
+  }
+
+} // ::umesh
@@ -203,7 +203,7 @@ namespace umesh {
                 end = std::chrono::steady_clock::now();
             std::cout << "computed faces, found " << prettyNumber(helper.faces.size()) << " faces, took " << std::chrono::duration_cast<std::chrono::seconds>(end - begin).count() << " secs" << std::endl;
 
-            std::cout << "check: num vertices after re-indexing " << (helper.indexer.knownVertices.size()) << std::endl;;
+            std::cout << "check: num vertices after re-indexing " << (helper.indexer.numVertices()) << std::endl;;
         }
         catch (std::exception e) {
             std::cerr << "fatal error " << e.what() << std::endl;
@@ -20,6 +20,7 @@
 #include "umesh/UMesh.h"
 #include "umesh/TetConn.h"
 #include "umesh/io/IO.h"
+#include "umesh/io/DerivedCache.h"
 
 namespace umesh {
 
@@ -27,7 +28,9 @@ namespace umesh {
   {
     if (error != "") std::cout << "Error: " << error << std::endl << std::endl;
 
-    std::cout << "usage: umeshComputeTetConnectivity in.umesh -o out.tetconn" << std::endl;
+    std::cout << "usage: umeshComputeTetConnectivity in.umesh -o out.tetconn [--sort-faces] [--cache]" << std::endl;
+    std::cout << "  --sort-faces : order faces by vertex indices, not by first use" << std::endl;
+    std::cout << "  --cache      : reuse (or create) a cached connectivity, in 'in.umesh.tetConn.cache'" << std::endl;
     exit(error != "");
   }
   
@@ -36,6 +39,8 @@ namespace umesh {
       try {
           std::string inFileName;
           std::string outFileName;
+          TetConn::FaceOrder faceOrder = TetConn::FIRST_USE;
+          bool useCache = false;
 
           for (int i = 1; i < ac; i++) {
               const std::string arg = av[i];
@@ -43,6 +48,10 @@ namespace umesh {
                   usage();
               else if (arg == "-o")
                   outFileName = av[++i];
+              else if (arg == "--sort-faces")
+                  faceOrder = TetConn::SORTED_BY_VERTICES;
+              else if (arg == "--cache")
+                  useCache = true;
               else if (arg[0] != '-')
                   inFileName = arg;
               else
@@ -60,7 +69,10 @@ namespace umesh {
               throw std::runtime_error("umesh contains non-tet elements...");
 
           std::cout << "computing connectivity" << std::endl;
-          TetConn::SP conn = TetConn::computeFrom(in);
+          TetConn::SP conn
+              = useCache
+              ? io::DerivedCache(in,inFileName).tetConn(faceOrder)
+              : TetConn::computeFrom(in,faceOrder);
 
           std::cout << "done computing connectivity; have a total of "
               << prettyNumber(conn->faces.size()) << " faces" << std::endl;
@@ -0,0 +1,92 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+/* computes a chain of levels of detail for a surface mesh (or, for a
+   volume mesh, for its outer shell): each level gets decimated from
+   the previous one, down to a given fraction of its triangles, and
+   gets saved to its own file */
+
+#include "umesh/io/UMesh.h"
+#include "umesh/extractShellFaces.h"
+#include "umesh/decimate.h"
+
+namespace umesh {
+
+  void usage(const std::string &error = "")
+  {
+    if (error != "")
+      std::cout << "Fatal error: " << error << std::endl << std::endl;
+    std::cout << "./umeshDecimate <in.umesh> <args>" << std::endl;
+    std::cout << "w/ Args: " << std::endl;
+    std::cout << "-o <baseName>\n\tbase path for all output files (one per level)" << std::endl;
+    std::cout << "-r|--reduction <fraction>\n\tfraction of the previous level's triangles to keep in each level (default: .25)" << std::endl;
+    std::cout << "-l|--levels <N>\n\tmax number of levels, including the input (default: 8)" << std::endl;
+    std::cout << "--min-triangles <N>\n\tdon't create levels with fewer triangles than this (default: 1000)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "if the input has no surface elements, its shell faces get extracted (and decimated) instead" << std::endl;
+    std::cout << "generated files are <baseName>_lod%d.umesh, for levels 1 (the first decimated one) and up" << std::endl;
+    exit( error != "");
+  }
+
+  extern "C" int main(int ac, char **av)
+  {
+    std::string inFileName;
+    std::string outFileBase;
+    DecimateOptions options;
+
+    for (int i=1;i<ac;i++) {
+      const std::string arg = av[i];
+      if (arg == "-o")
+        outFileBase = av[++i];
+      else if (arg == "-r" || arg == "--reduction")
+        options.reduction = (float)atof(av[++i]);
+      else if (arg == "-l" || arg == "--levels")
+        options.maxLevels = atoi(av[++i]);
+      else if (arg == "--min-triangles")
+        options.minTriangles = atol(av[++i]);
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown arg "+arg);
+    }
+    if (outFileBase == "") usage("no output file name specified");
+    if (inFileName == "") usage("no input file name specified");
+    if (options.reduction <= 0.f || options.reduction >= 1.f)
+      usage("reduction has to be in (0,1)");
+
+    std::cout << "loading umesh from " << inFileName << std::endl;
+    UMesh::SP mesh = io::loadBinaryUMesh(inFileName);
+    std::cout << "done loading, found " << mesh->toString() << std::endl;
+    if (mesh->triangles.empty() && mesh->quads.empty()) {
+      std::cout << "no surface elements, extracting shell faces" << std::endl;
+      mesh = extractShellFaces(mesh,true);
+      std::cout << "got " << mesh->toString() << std::endl;
+    }
+
+    std::vector<UMesh::SP> levels = computeLODs(mesh,options);
+    for (size_t i=1;i<levels.size();i++) {
+      const std::string fileName
+        = outFileBase+"_lod"+std::to_string(i)+".umesh";
+      std::cout << "saving level " << i << " w/ "
+                << prettyNumber(levels[i]->triangles.size())
+                << " triangles to " << fileName << std::endl;
+      io::saveBinaryUMesh(fileName,levels[i]);
+    }
+    std::cout << "done" << std::endl;
+  }
+
+} // ::umesh
@@ -16,6 +16,7 @@
 
 #include "umesh/io/ugrid32.h"
 #include "umesh/io/UMesh.h"
+#include "umesh/PrimBounds.h"
 
 namespace umesh {
 
@@ -47,13 +48,28 @@ namespace umesh {
     std::ofstream out(outFileName.c_str(),std::ios::binary);
     for (auto inFileName : inFileNames) {
       std::cout << "loading umesh from " << inFileName << std::endl;
-      UMesh::SP in = io::loadBinaryUMesh(inFileName);
+      // the prims' bounds only need vertices, elements, and the
+      // per-vertex scalars - skip everything else
+      LoadSelection selection(LoadSelection::ALL
+                              & ~LoadSelection::VERTEX_TAGS
+                              & ~LoadSelection::ELEMENT_ATTRIBUTES);
+      UMesh::SP in = io::loadBinaryUMesh(inFileName,selection);
       std::cout << " -> got mesh:\n" << in->toString(false) << std::endl;
-      std::vector<UMesh::PrimRef> prims = in->createAllPrimRefs();
-      for (auto prim : prims) {
-        box4f bb = in->getBounds4f(prim);
-        out.write((char *)&bb,sizeof(bb));
-      }
+      // all prims' bounds and value ranges get computed in parallel,
+      // in the same order as createAllPrimRefs()
+      PrimBounds::SP primBounds = PrimBounds::compute(in,true);
+      std::vector<box4f> bbs(primBounds->size());
+      parallel_for_blocked
+        (0,bbs.size(),64*1024,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++) {
+             const box3f   &spatial = primBounds->bounds[i];
+             const range1f &value   = primBounds->valueRanges[i];
+             bbs[i] = box4f(vec4f(spatial.lower,value.lower),
+                            vec4f(spatial.upper,value.upper));
+           }
+         });
+      out.write((const char *)bbs.data(),bbs.size()*sizeof(box4f));
     }
     std::cout << "done. written all bb4's to " << outFileName << std::endl;
     return 0;
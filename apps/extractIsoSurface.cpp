@@ -17,6 +17,8 @@
 #include "umesh/io/ugrid32.h"
 #include "umesh/io/UMesh.h"
 #include "umesh/extractIsoSurface.h"
+#include "umesh/computeNormals.h"
+#include "umesh/io/btm/BTM.h"
 
 namespace umesh {
 
@@ -25,16 +27,28 @@ namespace umesh {
     if (error != "")
       std::cerr << "Error : " << error  << "\n\n";
 
-    std::cout << "Usage: ./umeshExtractIsoSurface <in.umesh> -iso scalarValue (-o <out.umesh> | --obj file.obj)" << std::endl;;
+    std::cout << "Usage: ./umeshExtractIsoSurface <in.umesh> (-iso scalarValue [-iso scalarValue ...] | --slice a b c d) [--weld-by-edge] [--interpolate-attributes] [--quantize <bits>] [--normals] (-o <out.umesh> | --obj file.obj | --btm file.btm)" << std::endl;
+    std::cout << "--quantize <bits> : quantize the scalars to 8 or 16 bits, and extract from those (files\n"
+              << "                    with only quantized attributes always use the first one of those)" << std::endl;
+    std::cout << "--slice a b c d   : instead of an iso-surface, extract the cut with the plane a*x+b*y+c*z+d=0,\n"
+              << "                    with the scalars interpolated onto it" << std::endl;
+    std::cout << "--normals         : add area-weighted vertex normals (as normal.x/y/z attributes in\n"
+              << "                    .umesh files)" << std::endl;
     exit (error != "");
   };
   
   extern "C" int main(int ac, char **av)
   {
-    float isoValue = std::numeric_limits<float>::infinity();
+    std::vector<float> isoValues;
+    IsoSurfaceOptions  options;
     std::string inFileName;
     std::string outFileName;
     std::string objFileName;
+    std::string btmFileName;
+    bool withNormals = false;
+    int quantizeBits = 0;
+    bool slice = false;
+    vec4f plane;
     /*! if enabled, we'll only save the tets that _we_ created, not
         those that were in the file initially */
     for (int i=1;i<ac;i++) {
@@ -44,9 +58,25 @@ namespace umesh {
       else if (arg == "-o")
         outFileName = av[++i];
       else if (arg == "-iso" || arg == "--iso-value" || arg == "--iso")
-        isoValue = std::stof(av[++i]);
+        isoValues.push_back(std::stof(av[++i]));
+      else if (arg == "--slice") {
+        slice = true;
+        plane.x = std::stof(av[++i]);
+        plane.y = std::stof(av[++i]);
+        plane.z = std::stof(av[++i]);
+        plane.w = std::stof(av[++i]);
+      } else if (arg == "--weld-by-edge")
+        options.welding = WELD_BY_EDGE;
+      else if (arg == "--interpolate-attributes")
+        options.interpolateAttributes = true;
+      else if (arg == "--quantize")
+        quantizeBits = std::stoi(av[++i]);
       else if (arg == "--obj")
         objFileName = av[++i];
+      else if (arg == "--btm")
+        btmFileName = av[++i];
+      else if (arg == "--normals")
+        withNormals = true;
       else if (arg[0] != '-')
         inFileName = arg;
       else
@@ -54,16 +84,19 @@ namespace umesh {
     }
     
     if (inFileName == "") usage("no input file specified");
-    if (outFileName == "" && objFileName == "") usage("neither obj nor umesh output file specified");
+    if (outFileName == "" && objFileName == "" && btmFileName == "")
+      usage("neither obj, btm, nor umesh output file specified");
     
-    if (isoValue == std::numeric_limits<float>::infinity())
+    if (isoValues.empty() && !slice)
       usage("no iso-value specified");
+    if (!isoValues.empty() && slice)
+      usage("cannot extract iso-surfaces and a slice at the same time");
     
     std::cout << "loading umesh from " << inFileName << std::endl;
     UMesh::SP in = UMesh::loadFrom(inFileName);
     
     std::cout << "done loading, found " << in->toString()
-              << " ... now extracting iso-surface" << std::endl;
+              << " ... now extracting " << (slice ? "slice" : "iso-surface") << std::endl;
     if (in->pyrs.empty() &&
         in->wedges.empty() &&
         in->hexes.empty()) {
@@ -74,12 +107,39 @@ namespace umesh {
       std::cout << UMESH_TERMINAL_DEFAULT << std::endl;
     }
     
-    UMesh::SP result = extractIsoSurface(in,isoValue);
+    if (quantizeBits && in->perVertex) {
+      options.quantizedScalars = QuantizedAttribute::quantize(*in->perVertex,quantizeBits);
+      std::cout << "quantized scalars to " << quantizeBits
+                << " bits, max error " << options.quantizedScalars->maxError() << std::endl;
+    } else if (!in->perVertex && !in->quantizedAttributes.empty())
+      options.quantizedScalars = in->quantizedAttributes[0];
+    
+    /* multiple iso-values get extracted in a single pass, with each
+       triangle's iso-value stored in the "isoValue" attribute */
+    UMesh::SP result
+      = slice
+      ? extractSlice(in,plane,options)
+      : (isoValues.size() == 1)
+      ? extractIsoSurface(in,isoValues[0],options)
+      : extractIsoSurfaces(in,isoValues,options);
+    result->finalize();
     std::cout << "done extracting isovalue, found " << result->toString() << std::endl;
+    // computed once, for all output formats
+    std::vector<vec3f> normals;
+    if (withNormals)
+      normals = computeVertexNormals(*result);
     if (outFileName != "") {
       std::cout << "saving to " << outFileName << std::endl;
+      if (withNormals)
+        addNormalAttributes(*result,normals);
       result->saveTo(outFileName);
     }
+    if (btmFileName != "") {
+      std::cout << "saving (in BTM format) to " << btmFileName << std::endl;
+      btm::Mesh::SP btm = btm::Mesh::fromUMesh(*result,false);
+      btm->normal = normals;
+      btm->save(btmFileName);
+    }
     if (objFileName != "") {
       std::cout << "writing in OBJ format to " << objFileName << std::endl;
       std::cout << UMESH_TERMINAL_RED << "# WARNING - this can take a while!"
@@ -87,8 +147,15 @@ namespace umesh {
       std::ofstream out(objFileName);
       for (auto v : result->vertices)
         out << "v " << v.x << " " << v.y << " " << v.z << std::endl;
+      for (auto n : normals)
+        out << "vn " << n.x << " " << n.y << " " << n.z << std::endl;
       for (auto t : result->triangles)
-        out << "f " << (t.x+1) << " " << (t.y+1) << " " << (t.z+1) << std::endl;
+        if (withNormals)
+          out << "f " << (t.x+1) << "//" << (t.x+1)
+              << " " << (t.y+1) << "//" << (t.y+1)
+              << " " << (t.z+1) << "//" << (t.z+1) << std::endl;
+        else
+          out << "f " << (t.x+1) << " " << (t.y+1) << " " << (t.z+1) << std::endl;
     }
       
     std::cout << "done all ..." << std::endl;
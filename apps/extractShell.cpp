@@ -22,16 +22,20 @@
 #include "umesh/io/UMesh.h"
 #include "umesh/RemeshHelper.h"
 #include "umesh/extractShellFaces.h"
+#include "umesh/io/DerivedCache.h"
+#include "umesh/io/btm/BTM.h"
+#include "umesh/computeNormals.h"
 #include <algorithm>
 
 namespace umesh {
 
-  typedef enum { INVALID, UMESH, OBJ } Format;
+  typedef enum { INVALID, UMESH, OBJ, BTM } Format;
 
   Format formatFromFileName(const std::string &fileName)
   {
     if (fileName.substr(fileName.size()-4) == ".obj") return OBJ;
     if (fileName.substr(fileName.size()-6) == ".umesh") return UMESH;
+    if (fileName.substr(fileName.size()-4) == ".btm") return BTM;
     return INVALID;
   }
 
@@ -109,6 +113,8 @@ namespace umesh {
       std::string inFileName;
       std::string outFileName;
       Format format = INVALID;
+      bool useCache = false;
+      bool withNormals = false;
 
       for (int i = 1; i < ac; i++) {
         const std::string arg = av[i];
@@ -118,21 +124,34 @@ namespace umesh {
           format = OBJ;
         else if (arg == "--umesh")
           format = UMESH;
+        else if (arg == "--btm")
+          format = BTM;
+        else if (arg == "--cache")
+          useCache = true;
+        else if (arg == "--normals")
+          withNormals = true;
         else if (arg[0] != '-')
           inFileName = arg;
         else {
-          throw std::runtime_error("./umeshExtractShell <in.umesh> [--obj|--umesh] -o <out.obj|.umesh>");
+          throw std::runtime_error("./umeshExtractShell <in.umesh> [--obj|--umesh|--btm] [--cache] [--normals] -o <out.obj|.umesh|.btm>");
         }
       }
 
       if (format == INVALID)
         format = formatFromFileName(outFileName);
+      if (withNormals && format == OBJ)
+        throw std::runtime_error("--normals only works for .umesh and .btm output");
       
       std::cout << "loading umesh from " << inFileName << std::endl;
       UMesh::SP inMesh = load(inFileName);
 
       std::cout << "extracting shell faces .... this can take a while" << std::endl;
-      UMesh::SP outMesh = extractShellFaces(inMesh,1);
+      // with the cache, the (cached) face connectivity gives the same
+      // faces as the boundary-only extraction
+      UMesh::SP outMesh
+        = useCache
+        ? extractShellFaces(inMesh,*io::DerivedCache(inMesh,inFileName).faceConn(),1)
+        : extractBoundaryFaces(inMesh,1);
 
       std::cout << "extracted surface of " << outMesh->toString() << std::endl;
       switch (format) {
@@ -140,8 +159,14 @@ namespace umesh {
         saveToOBJ(outFileName,outMesh);
         break;
       case UMESH:
+        if (withNormals)
+          addNormalAttributes(*outMesh,computeVertexNormals(*outMesh));
         outMesh->saveTo(outFileName);
         break;
+      case BTM:
+        std::cout << "... saving (in BTM format) to " << outFileName << std::endl;
+        btm::Mesh::fromUMesh(*outMesh,withNormals)->save(outFileName);
+        break;
       default:
         throw std::runtime_error("invalid/unsupported format!?");
       }
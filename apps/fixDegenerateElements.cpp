@@ -0,0 +1,70 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* replaces all elements of a umesh that have repeated vertex indices
+   (as some exporters write, say, pyramids or wedges as hexes with
+   collapsed vertices) by the tets, pyramids, wedges (or triangles)
+   they reduce to, drops those that have nothing left, and saves the
+   result; see umesh/normalizeDegenerates.h */ 
+
+#include "umesh/io/UMesh.h"
+#include "umesh/normalizeDegenerates.h"
+
+namespace umesh {
+
+  extern "C" int main(int ac, char **av)
+  {
+    try {
+      std::string inFileName;
+      std::string outFileName;
+
+      for (int i = 1; i < ac; i++) {
+        const std::string arg = av[i];
+        if (arg == "-o")
+          outFileName = av[++i];
+        else if (arg[0] != '-')
+          inFileName = arg;
+        else {
+          throw std::runtime_error("./umeshFixDegenerateElements <in.umesh> -o <out.umesh>");
+        }
+      }
+      if (outFileName == "")
+        throw std::runtime_error("no output filename specified (-o)");
+
+      std::cout << "loading umesh from " << inFileName << std::endl;
+      UMesh::SP in = io::loadBinaryUMesh(inFileName);
+      std::cout << "normalizing degenerate elements ...." << std::endl;
+      const DegenerateElementCounts fixed = normalizeDegenerateElements(in);
+      const char *typeName[] = { "tris", "quads", "tets", "pyrs", "wedges", "hexes" };
+      for (int t=0;t<=UMesh::HEX;t++) {
+        if (!fixed.numReduced[t] && !fixed.numDropped[t] && !fixed.numCreated[t])
+          continue;
+        std::cout << " - " << typeName[t] << ": " << fixed.numReduced[t]
+                  << " reduced, " << fixed.numDropped[t] << " dropped, "
+                  << fixed.numCreated[t] << " created" << std::endl;
+      }
+      std::cout << "done; mesh now is " << in->toString() << std::endl;
+
+      io::saveBinaryUMesh(outFileName, in);
+      std::cout << "done saving umesh file" << std::endl;
+    }
+    catch (std::exception &e) {
+      std::cerr << "fatal error " << e.what() << std::endl;
+      exit(1);
+    }
+    return 0;
+  }  
+} // ::umesh
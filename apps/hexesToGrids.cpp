@@ -0,0 +1,83 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* replaces the logically structured blocks of hexes in a umesh with
+   grids, which are (much) more compact, and faster to sample */
+
+#include "umesh/io/UMesh.h"
+#include "umesh/hexesToGrids.h"
+
+namespace umesh {
+
+  void usage(const std::string &error = "")
+  {
+    if (error != "")
+      std::cerr << "Error : " << error  << "\n\n";
+
+    std::cout << "Usage: ./umeshHexesToGrids <in.umesh> -o <out.umesh> [args]" << std::endl;
+    std::cout << "w/ Args: " << std::endl;
+    std::cout << "--max-grid-cells <n>\n\tmax number of cells per dimension of each grid (default 8)" << std::endl;
+    std::cout << "--min-grid-cells <n>\n\tblocks of fewer hexes than this stay hexes (default 8)" << std::endl;
+    std::cout << "--tolerance <t>\n\thow far (relative to the cell size) vertices may be off the regular lattice (default 1e-3)" << std::endl;
+    std::cout << "--compress\n\tcompress the output file's sections (see io/Compression.h)" << std::endl;
+    exit(error != "");
+  }
+  
+  extern "C" int main(int ac, char **av)
+  {
+    std::string inFileName;
+    std::string outFileName;
+    HexesToGridsOptions options;
+    bool compress = false;
+    
+    for (int i=1;i<ac;i++) {
+      const std::string arg = av[i];
+      if (arg == "-h")
+        usage();
+      else if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "--max-grid-cells")
+        options.maxGridCells = std::stoi(av[++i]);
+      else if (arg == "--min-grid-cells")
+        options.minGridCells = std::stoi(av[++i]);
+      else if (arg == "--tolerance")
+        options.tolerance = std::stof(av[++i]);
+      else if (arg == "--compress")
+        compress = true;
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmd-line arg '"+arg+"'");
+    }
+    
+    if (inFileName == "") usage("no input file specified");
+    if (outFileName == "") usage("no output file specified");
+    
+    std::cout << "loading umesh from " << inFileName << std::endl;
+    UMesh::SP mesh = io::loadBinaryUMesh(inFileName);
+    std::cout << "done loading, found " << mesh->toString() << std::endl;
+
+    std::cout << "converting structured hex blocks to grids ..." << std::endl;
+    const size_t numConverted = convertHexesToGrids(mesh,options);
+    std::cout << "replaced " << prettyNumber(numConverted) << " hexes, now have "
+              << mesh->toString() << std::endl;
+
+    std::cout << "saving to " << outFileName << std::endl;
+    io::saveBinaryUMesh(outFileName,mesh,compress);
+    std::cout << "done all ..." << std::endl;
+  }
+
+} // ::umesh
@@ -16,6 +16,7 @@
 
 #include "umesh/io/ugrid32.h"
 #include "umesh/io/UMesh.h"
+#include "umesh/ScalarStats.h"
 #include "umesh/tetrahedralize.h"
 
 namespace umesh {
@@ -25,7 +26,8 @@ namespace umesh {
     if (error != "")
       std::cerr << "Error : " << error  << "\n\n";
 
-    std::cout << "Usage: ./umeshImportUGrid64 <in.ugrid64> <scalarsFile.bin> -o <out.umesh>" << std::endl;;
+    std::cout << "Usage: ./umeshImportUGrid64 <in.ugrid64> <scalarsFile.bin> -o <out.umesh> [--fix-negative-volumes] [--stats]" << std::endl;;
+    std::cout << "  --stats : compute, and store with the mesh, the stats (range, histogram, etc) of its scalars" << std::endl;
     std::cout << "  --doubles : input vertices are in double precision" << std::endl;
     exit (error != "");
   };
@@ -35,9 +37,14 @@ namespace umesh {
     std::string ugridFileName;
     std::string scalarsFileName;
     std::string outFileName;
+    /*! compute, and store in the output file, the stats of all
+        attributes (see umesh/ScalarStats.h) */
+    bool storeStats = false;
     /*! if enabled, we'll only save the tets that _we_ created, not
         those that were in the file initially */
     bool skipActualTets = false;
+    /*! flip inside-out elements while loading */
+    bool fixNegativeVolumes = false;
     io::UGrid32Loader::VertexFormat
       vertexFormat = io::UGrid32Loader::AUTO;
     for (int i=1;i<ac;i++) {
@@ -46,6 +53,10 @@ namespace umesh {
         usage();
       else if (arg == "-o")
         outFileName = av[++i];
+      else if (arg == "--stats")
+        storeStats = true;
+      else if (arg == "--fix-negative-volumes")
+        fixNegativeVolumes = true;
       else if (arg == "--doubles" || arg == "-d")
         vertexFormat = io::UGrid32Loader::DOUBLE;
       else if (arg == "--floats" || arg == "-f")
@@ -70,12 +81,19 @@ namespace umesh {
     std::cout << "loading ugrid32 from " << ugridFileName << " + " << scalarsFileName << std::endl;
     UMesh::SP in = io::UGrid32Loader::load(vertexFormat,
                                            ugridFileName,
-                                           scalarsFileName);
+                                           scalarsFileName,
+                                           fixNegativeVolumes);
     if (scalarsFileName == "")
       for (size_t i=0;i<in->vertices.size();i++)
         in->vertexTags.push_back(i);
     std::cout << "done loading, found " << in->toString() << std::endl;
     
+    if (storeStats) {
+      computeAllStats(in);
+      if (in->perVertex && in->perVertex->stats)
+        std::cout << "scalar stats: " << in->perVertex->stats->toString() << std::endl;
+    }
+    
     in->saveTo(outFileName);
     std::cout << "done ..." << std::endl;
   }
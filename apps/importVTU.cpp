@@ -0,0 +1,71 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/VTU.h"
+#include "umesh/io/UMesh.h"
+#include "umesh/ScalarStats.h"
+
+namespace umesh {
+
+  void usage(const std::string error="")
+  {
+    if (error != "")
+      std::cerr << "Error : " << error  << "\n\n";
+
+    std::cout << "Usage: ./umeshImportVTU <in.vtu> -o <out.umesh> [--stats]" << std::endl;;
+    std::cout << "  --stats : compute, and store with the mesh, the stats (range, histogram, etc) of its scalars" << std::endl;
+    exit (error != "");
+  };
+
+  extern "C" int main(int ac, char **av)
+  {
+    std::string inFileName;
+    std::string outFileName;
+    /*! compute, and store in the output file, the stats of all
+        attributes (see umesh/ScalarStats.h) */
+    bool storeStats = false;
+    for (int i=1;i<ac;i++) {
+      const std::string arg = av[i];
+      if (arg == "-h")
+        usage();
+      else if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "--stats")
+        storeStats = true;
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmd-line arg '"+arg+"'");
+    }
+    
+    if (inFileName == "") usage("no input file specified");
+    if (outFileName == "") usage("no output file specified");
+    
+    std::cout << "loading vtu from " << inFileName << std::endl;
+    UMesh::SP in = io::loadVTU(inFileName);
+    
+    std::cout << "done loading, found " << in->toString() << std::endl;
+    
+    if (storeStats) {
+      computeAllStats(in);
+      if (in->perVertex && in->perVertex->stats)
+        std::cout << "scalar stats: " << in->perVertex->stats->toString() << std::endl;
+    }
+    
+    in->saveTo(outFileName);
+    std::cout << "done ..." << std::endl;
+  }
+} // ::umesh
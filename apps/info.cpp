@@ -16,6 +16,7 @@
 
 #include "umesh/io/ugrid32.h"
 #include "umesh/io/UMesh.h"
+#include "umesh/ScalarStats.h"
 
 namespace umesh {
 
@@ -24,17 +25,34 @@ namespace umesh {
     if (error != "")
       std::cerr << "\nError : " << error  << "\n\n";
 
-    std::cout << "Usage: ./umeshInfo <in.umesh>\n\n";
+    std::cout << "Usage: ./umeshInfo [--load] [--stats [--bins <n>] [--volume-weighted]] <in.umesh>\n\n";
+    std::cout << "--load : load the entire mesh (default is to only read\n"
+              << "         the file's metadata, including any stats the file has)\n"
+              << "--stats : (load the mesh and) compute range, mean, variance,\n"
+              << "         NaN/inf counts, and a histogram of every attribute\n"
+              << "--bins <n> : number of histogram bins for --stats (default 256)\n"
+              << "--volume-weighted : weight values by the volume they stand for\n\n";
     exit(error != "");
   };
   
   extern "C" int main(int ac, char **av)
   {
     std::string inFileName;
+    bool loadEntireMesh = false;
+    bool computeStats = false;
+    ScalarStatsOptions statsOptions;
     for (int i=1;i<ac;i++) {
       const std::string arg = av[i];
       if (arg == "-h")
         usage();
+      else if (arg == "--load")
+        loadEntireMesh = true;
+      else if (arg == "--stats")
+        loadEntireMesh = computeStats = true;
+      else if (arg == "--bins")
+        statsOptions.numBins = std::stoi(av[++i]);
+      else if (arg == "--volume-weighted")
+        statsOptions.volumeWeighted = true;
       else if (arg[0] != '-')
         inFileName = arg;
       else
@@ -43,10 +61,27 @@ namespace umesh {
     
     if (inFileName == "") usage("no input file specified");
     
+    if (!loadEntireMesh) {
+      std::cout << "reading umesh info from " << inFileName << std::endl;
+      io::UMeshInfo info = io::readUMeshInfo(inFileName);
+      std::cout << "UMesh info:\n" << info.toString() << std::endl;
+      return 0;
+    }
+    
     std::cout << "loading umesh from " << inFileName << std::endl;
     UMesh::SP in = io::loadBinaryUMesh(inFileName);
 
     std::cout << "UMesh info:\n" << in->toString(false) << std::endl;
+
+    if (computeStats)
+      computeAllStats(in,statsOptions);
+    for (auto attr : in->attributes)
+      if (attr->stats)
+        std::cout << "'" << attr->name << "' : " << attr->stats->toString() << std::endl;
+    for (auto attr : in->elementAttributes)
+      if (attr.second->stats)
+        std::cout << "'" << attr.second->name << "' (per element) : "
+                  << attr.second->stats->toString() << std::endl;
   }
   
 } // ::umesh
@@ -0,0 +1,786 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+/* MPI-parallel version of umeshPartitionObjectSpace, for meshes that
+   are too big to be loaded on any single node: each rank reads only
+   a slice of the input's element arrays (straight out of the mapped
+   file, one container section at a time, so no rank ever has to
+   hold an entire array), and all ranks together recursively bisect
+   the elements' centroids, with each split's position found via
+   (allreduce'd) histograms of all ranks' centroids. Once every node
+   of that distributed tree belongs to a single rank, elements - and
+   the vertices they reference - get exchanged so each rank has the
+   elements of its node, which it then partitions into bricks, and
+   writes out, just like the serial partitioner. Rank 0 finally
+   writes the .domains file for all bricks.
+
+   Only the input's per-vertex scalar field (its first vertex
+   attribute) gets carried along; other attributes, grids, and ghost
+   layers (which would require cross-rank adjacency) are not
+   supported. Compressed sections get decompressed the first time
+   they're needed, and then stay in memory, so this works best with
+   uncompressed inputs. */
+
+#include "umesh/io/MappedUMesh.h"
+#include "umesh/io/Compression.h"
+#include "umesh/io/UMesh.h"
+#include "umesh/io/IO.h"
+#include "umesh/partition.h"
+#include <mpi.h>
+#include <mutex>
+#include <cstring>
+
+namespace umesh {
+
+  using namespace io::container;
+
+  int mpiRank = 0;
+  int mpiSize = 1;
+
+  void usage(const std::string &error = "")
+  {
+    if (mpiRank == 0) {
+      if (error != "")
+        std::cout << "Fatal error: " << error << std::endl << std::endl;
+      std::cout << "mpirun ... ./umeshPartitionMPI <in.umesh> <args>" << std::endl;
+      std::cout << "w/ Args: " << std::endl;
+      std::cout << "-o <baseName>\n\tbase path for all output files (there will be multiple)" << std::endl;
+      std::cout << "-n|-num-bricks <N>\n\ttotal number of bricks to create (at least one per rank)" << std::endl;
+      std::cout << "-lt|--leaf-threshold <N>\n\tnum prims at which we make a leaf" << std::endl;
+      std::cout << std::endl;
+      std::cout << "generated files are:" << std::endl;
+      std::cout << "<baseName>.domains : one box3f for each generated brick, followed by one range1f value range each" << std::endl;
+      std::cout << "<baseName>_%05d.umesh : the extracted umeshes for each brick" << std::endl;
+    }
+    MPI_Finalize();
+    exit( error != "");
+  }
+
+  /*! one array of the input file, as the list of container sections
+      it is split into. Uncompressed sections get used straight out of
+      the mapped file; compressed ones get decompressed on first
+      access */
+  template<typename T>
+  struct ChunkedArray {
+    struct Chunk {
+      /*! index of the chunk's first element within the whole array */
+      size_t                          begin = 0;
+      size_t                          count = 0;
+      const T                        *ptr   = nullptr;
+      /*! only for compressed chunks */
+      const uint8_t                  *compressed = nullptr;
+      size_t                          numBytes   = 0;
+      std::shared_ptr<std::vector<T>> copy;
+      std::shared_ptr<std::once_flag> decompressed;
+    };
+
+    inline size_t size() const { return numElements; }
+
+    /*! add an (uncompressed, or already copied) array as next
+        chunk */
+    void addChunk(const T *ptr, size_t count,
+                  std::shared_ptr<std::vector<T>> copy = nullptr)
+    {
+      if (count == 0) return;
+      Chunk chunk;
+      chunk.begin = numElements;
+      chunk.count = count;
+      chunk.ptr   = ptr;
+      chunk.copy  = copy;
+      chunks.push_back(chunk);
+      numElements += count;
+    }
+
+    void addSection(io::MappedFile::SP file, const Section &section)
+    {
+      if (section.count == 0) return;
+      if (section.compression) {
+        Chunk chunk;
+        chunk.begin        = numElements;
+        chunk.count        = section.count;
+        chunk.compressed   = file->at(section.offset,section.numBytes);
+        chunk.numBytes     = section.numBytes;
+        chunk.decompressed = std::make_shared<std::once_flag>();
+        chunks.push_back(chunk);
+        numElements += section.count;
+        return;
+      }
+      if (section.numBytes != section.count*sizeof(T))
+        throw std::runtime_error("#umesh.partitionMPI: section '"
+                                 +toString(section.type)
+                                 +"' has wrong element size");
+      const T *begin = (const T *)file->at(section.offset,section.numBytes);
+      if (((size_t)begin % alignof(T)) == 0) {
+        addChunk(begin,section.count);
+        return;
+      }
+      std::shared_ptr<std::vector<T>> copy
+        = std::make_shared<std::vector<T>>(section.count);
+      memcpy(copy->data(),begin,section.numBytes);
+      addChunk(copy->data(),copy->size(),copy);
+    }
+
+    void addArray(const io::MappedArray<T> &array)
+    { addChunk(array.data(),array.size(),array.copy); }
+
+    /*! returns the chunk that contains the i'th element of the
+        array, decompressing it if required; may get called
+        concurrently */
+    const Chunk &chunkOf(size_t i) const
+    {
+      auto it = std::upper_bound(chunks.begin(),chunks.end(),i,
+                                 [](size_t i, const Chunk &chunk)
+                                 { return i < chunk.begin; });
+      const Chunk &chunk = *(it-1);
+      if (chunk.decompressed)
+        std::call_once(*chunk.decompressed,[&](){
+            Chunk &c = (Chunk &)chunk;
+            c.copy = std::make_shared<std::vector<T>>(c.count);
+            io::compression::decompress(c.compressed,c.numBytes,
+                                        c.copy->data(),c.count*sizeof(T));
+            c.ptr = c.copy->data();
+          });
+      return chunk;
+    }
+
+    inline const T &operator[](size_t i) const
+    {
+      assert(i < numElements);
+      if (chunks.size() == 1 && !chunks[0].decompressed)
+        return chunks[0].ptr[i];
+      const Chunk &chunk = chunkOf(i);
+      return chunk.ptr[i-chunk.begin];
+    }
+
+    std::vector<Chunk> chunks;
+    size_t             numElements = 0;
+  };
+
+  /*! the parts of the input file that we need */
+  struct Input {
+    Input(const std::string &fileName);
+
+    /*! number of elements of given type */
+    size_t numElements(int type) const;
+
+    io::MappedFile::SP      file;
+    /*! only for pre-container files, which we map as a whole */
+    io::MappedUMesh::SP     legacy;
+    ChunkedArray<vec3f>     vertices;
+    /*! the first vertex attribute, if any */
+    ChunkedArray<float>     scalars;
+    std::string             scalarsName;
+    ChunkedArray<Triangle>  triangles;
+    ChunkedArray<Quad>      quads;
+    ChunkedArray<Tet>       tets;
+    ChunkedArray<Pyr>       pyrs;
+    ChunkedArray<Wedge>     wedges;
+    ChunkedArray<Hex>       hexes;
+    size_t                  numGrids = 0;
+  };
+
+  Input::Input(const std::string &fileName)
+  {
+    file = io::MappedFile::open(fileName);
+    uint64_t magic;
+    memcpy(&magic,file->at(0,sizeof(magic)),sizeof(magic));
+    if (!isContainer(magic)) {
+      legacy = io::MappedUMesh::map(fileName);
+      vertices.addArray(legacy->vertices);
+      if (legacy->perVertex()) {
+        scalars.addArray(legacy->perVertex()->values);
+        scalarsName = legacy->perVertex()->name;
+      }
+      triangles.addArray(legacy->triangles);
+      quads.addArray(legacy->quads);
+      tets.addArray(legacy->tets);
+      pyrs.addArray(legacy->pyrs);
+      wedges.addArray(legacy->wedges);
+      hexes.addArray(legacy->hexes);
+      numGrids = legacy->grids.size();
+      return;
+    }
+
+    Header header;
+    memcpy(&header,file->at(0,sizeof(header)),sizeof(header));
+    if (header.version != version)
+      throw std::runtime_error("#umesh.partitionMPI: unsupported container version "
+                               +std::to_string(header.version));
+    std::vector<Section> sections(header.numSections);
+    memcpy(sections.data(),
+           file->at(header.tocOffset,sections.size()*sizeof(Section)),
+           sections.size()*sizeof(Section));
+    if (checksum(sections.data(),sections.size()*sizeof(Section))
+        != header.tocChecksum)
+      throw std::runtime_error("#umesh.partitionMPI: checksum mismatch in container TOC");
+    bool haveScalars = false;
+    for (auto &section : sections) {
+      switch (section.type) {
+      case VERTICES:
+        vertices.addSection(file,section); break;
+      case VERTEX_ATTRIBUTE:
+        if (!haveScalars) {
+          haveScalars = true;
+          scalarsName = section.getName();
+        }
+        if (section.getName() == scalarsName)
+          scalars.addSection(file,section);
+        break;
+      case TRIANGLES:
+        triangles.addSection(file,section); break;
+      case QUADS:
+        quads.addSection(file,section); break;
+      case TETS:
+        tets.addSection(file,section); break;
+      case PYRS:
+        pyrs.addSection(file,section); break;
+      case WEDGES:
+        wedges.addSection(file,section); break;
+      case HEXES:
+        hexes.addSection(file,section); break;
+      case GRIDS:
+        numGrids += section.count; break;
+      default:
+        /* nothing we need */
+        break;
+      }
+    }
+  }
+
+  size_t Input::numElements(int type) const
+  {
+    switch (type) {
+    case UMesh::TRI:   return triangles.size();
+    case UMesh::QUAD:  return quads.size();
+    case UMesh::TET:   return tets.size();
+    case UMesh::PYR:   return pyrs.size();
+    case UMesh::WEDGE: return wedges.size();
+    case UMesh::HEX:   return hexes.size();
+    default: return 0;
+    }
+  }
+
+  /*! one element, as it gets sent around between ranks; vertex
+      indices are those of the input file until the element arrives
+      at its final rank */
+  struct Element {
+    vec3f   centroid;
+    int32_t type;
+    int32_t numVertices;
+    int32_t vertex[8];
+  };
+
+  /*! one vertex referenced by elements that get sent to another
+      rank */
+  struct Vertex {
+    int32_t id;
+    vec3f   position;
+    float   scalar;
+  };
+
+  template<typename T>
+  inline void toElement(Element &element, int type, const T &prim,
+                        const ChunkedArray<vec3f> &vertices)
+  {
+    const int N = sizeof(T)/sizeof(int);
+    box3f bounds;
+    element.type        = type;
+    element.numVertices = N;
+    for (int i=0;i<N;i++) {
+      element.vertex[i] = prim[i];
+      bounds.extend(vertices[prim[i]]);
+    }
+    element.centroid = bounds.center();
+  }
+
+  /*! reads (and computes the centroids of) this rank's slice of all
+      elements, in order tris, quads, tets, pyrs, wedges, hexes */
+  std::vector<Element> readSlice(const Input &input)
+  {
+    const int types[] = {
+      UMesh::TRI, UMesh::QUAD, UMesh::TET, UMesh::PYR, UMesh::WEDGE, UMesh::HEX
+    };
+    size_t typeBegin[7] = { 0 };
+    for (int i=0;i<6;i++)
+      typeBegin[i+1] = typeBegin[i]+input.numElements(types[i]);
+    const size_t numTotal = typeBegin[6];
+    const size_t begin = numTotal*mpiRank/mpiSize;
+    const size_t end   = numTotal*(mpiRank+1)/mpiSize;
+
+    std::vector<Element> elements(end-begin);
+    parallel_for_blocked(begin,end,16*1024,[&](size_t blockBegin, size_t blockEnd){
+        int t = 0;
+        for (size_t i=blockBegin;i<blockEnd;i++) {
+          while (i >= typeBegin[t+1]) t++;
+          const size_t idx = i-typeBegin[t];
+          Element &element = elements[i-begin];
+          switch (types[t]) {
+          case UMesh::TRI:
+            toElement(element,UMesh::TRI,input.triangles[idx],input.vertices); break;
+          case UMesh::QUAD:
+            toElement(element,UMesh::QUAD,input.quads[idx],input.vertices); break;
+          case UMesh::TET:
+            toElement(element,UMesh::TET,input.tets[idx],input.vertices); break;
+          case UMesh::PYR:
+            toElement(element,UMesh::PYR,input.pyrs[idx],input.vertices); break;
+          case UMesh::WEDGE:
+            toElement(element,UMesh::WEDGE,input.wedges[idx],input.vertices); break;
+          case UMesh::HEX:
+            toElement(element,UMesh::HEX,input.hexes[idx],input.vertices); break;
+          }
+        }
+      });
+    return elements;
+  }
+
+  /*! one node of the distributed bisection, responsible for ranks
+      [rankBegin,rankEnd) */
+  struct Node {
+    int   rankBegin, rankEnd;
+    /*! number of elements in this node, over all ranks */
+    uint64_t numElements;
+  };
+
+  /*! number of bins we histogram a node's centroids into to find its
+      split position; each split gets refined once more within the
+      bin the split falls into */
+  const int numBins = 1024;
+  const int numRefinements = 2;
+
+  /*! recursively bisects all ranks' elements, until every node
+      belongs to a single rank, and returns for each local element
+      the rank it goes to. Each split step goes over all nodes of the
+      same tree level at once, so the number of collective operations
+      only depends on the depth of the tree */
+  std::vector<int> distributedSplit(const std::vector<Element> &elements)
+  {
+    std::vector<int> nodeOf(elements.size(),0);
+    std::vector<Node> nodes;
+    uint64_t numLocal = elements.size(), numTotal = 0;
+    MPI_Allreduce(&numLocal,&numTotal,1,MPI_UINT64_T,MPI_SUM,MPI_COMM_WORLD);
+    nodes.push_back({0,mpiSize,numTotal});
+
+    while (true) {
+      bool needsSplit = false;
+      for (auto &node : nodes)
+        needsSplit |= (node.rankEnd-node.rankBegin > 1);
+      if (!needsSplit) break;
+      const int numNodes = (int)nodes.size();
+
+      // ------------------------------------------------------------------
+      // centroid bounds of each node
+      // ------------------------------------------------------------------
+      std::vector<float> lower(3*numNodes,+std::numeric_limits<float>::infinity());
+      std::vector<float> upper(3*numNodes,-std::numeric_limits<float>::infinity());
+      for (size_t i=0;i<elements.size();i++) {
+        const int n = nodeOf[i];
+        for (int d=0;d<3;d++) {
+          lower[3*n+d] = std::min(lower[3*n+d],elements[i].centroid[d]);
+          upper[3*n+d] = std::max(upper[3*n+d],elements[i].centroid[d]);
+        }
+      }
+      MPI_Allreduce(MPI_IN_PLACE,lower.data(),3*numNodes,MPI_FLOAT,MPI_MIN,MPI_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE,upper.data(),3*numNodes,MPI_FLOAT,MPI_MAX,MPI_COMM_WORLD);
+
+      // per node, the split axis, the [lo,hi) range along that axis
+      // the split position is still to be found in, and the number
+      // of elements below 'lo'
+      std::vector<int>      dim(numNodes,0);
+      std::vector<double>   lo(numNodes), hi(numNodes);
+      std::vector<uint64_t> numBelow(numNodes,0);
+      std::vector<uint64_t> target(numNodes,0);
+      for (int n=0;n<numNodes;n++) {
+        const Node &node = nodes[n];
+        for (int d=1;d<3;d++)
+          if (upper[3*n+d]-lower[3*n+d] > upper[3*n+dim[n]]-lower[3*n+dim[n]])
+            dim[n] = d;
+        lo[n] = lower[3*n+dim[n]];
+        hi[n] = upper[3*n+dim[n]];
+        const int numRanks = node.rankEnd-node.rankBegin;
+        target[n] = node.numElements*(numRanks/2)/std::max(numRanks,1);
+      }
+
+      // ------------------------------------------------------------------
+      // find each node's split position, by (repeatedly) binning its
+      // centroids within [lo,hi), and narrowing that range down to
+      // the bin that contains the target number of elements
+      // ------------------------------------------------------------------
+      for (int r=0;r<numRefinements;r++) {
+        std::vector<uint64_t> bins(size_t(numNodes)*numBins,0);
+        for (size_t i=0;i<elements.size();i++) {
+          const int n = nodeOf[i];
+          if (nodes[n].rankEnd-nodes[n].rankBegin < 2 || hi[n] <= lo[n]) continue;
+          const double x = elements[i].centroid[dim[n]];
+          // (the first pass' range includes its upper end)
+          if (x < lo[n] || (r == 0 ? x > hi[n] : x >= hi[n])) continue;
+          const int bin = std::min(numBins-1,int((x-lo[n])*numBins/(hi[n]-lo[n])));
+          bins[size_t(n)*numBins+bin]++;
+        }
+        MPI_Allreduce(MPI_IN_PLACE,bins.data(),(int)bins.size(),
+                      MPI_UINT64_T,MPI_SUM,MPI_COMM_WORLD);
+        for (int n=0;n<numNodes;n++) {
+          if (hi[n] <= lo[n]) continue;
+          const uint64_t *nodeBins = bins.data()+size_t(n)*numBins;
+          uint64_t below = numBelow[n];
+          int bin = 0;
+          while (bin < numBins-1 && below+nodeBins[bin] <= target[n])
+            below += nodeBins[bin++];
+          const double width = (hi[n]-lo[n])/numBins;
+          if (r == numRefinements-1) {
+            // split at whichever of the bin's two boundaries is
+            // closer to the target
+            if (int64_t(below+nodeBins[bin])-int64_t(target[n])
+                < int64_t(target[n])-int64_t(below)) {
+              bin++;
+              below += nodeBins[bin-1];
+            }
+            lo[n] = hi[n] = lo[n]+bin*width;
+          } else {
+            hi[n] = lo[n]+(bin+1)*width;
+            lo[n] = lo[n]+bin*width;
+          }
+          numBelow[n] = below;
+        }
+      }
+
+      // ------------------------------------------------------------------
+      // create the next level's nodes, and move elements to them
+      // ------------------------------------------------------------------
+      std::vector<Node> children;
+      std::vector<int>  leftChild(numNodes);
+      for (int n=0;n<numNodes;n++) {
+        const Node &node = nodes[n];
+        leftChild[n] = (int)children.size();
+        if (node.rankEnd-node.rankBegin < 2) {
+          children.push_back(node);
+          continue;
+        }
+        const int rankMid = (node.rankBegin+node.rankEnd)/2;
+        children.push_back({node.rankBegin,rankMid,numBelow[n]});
+        children.push_back({rankMid,node.rankEnd,node.numElements-numBelow[n]});
+      }
+      parallel_for_blocked(0,elements.size(),16*1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            const int n = nodeOf[i];
+            const Node &node = nodes[n];
+            if (node.rankEnd-node.rankBegin < 2)
+              nodeOf[i] = leftChild[n];
+            else
+              nodeOf[i] = leftChild[n]
+                + (elements[i].centroid[dim[n]] >= lo[n] ? 1 : 0);
+          }
+        });
+      nodes = children;
+    }
+
+    std::vector<int> rankOf(elements.size());
+    for (size_t i=0;i<elements.size();i++)
+      rankOf[i] = nodes[nodeOf[i]].rankBegin;
+    return rankOf;
+  }
+
+  /*! MPI's all-to-all counts and displacements are ints */
+  std::vector<int> toDisplacements(const std::vector<size_t> &counts)
+  {
+    std::vector<int> displs(counts.size());
+    size_t sum = 0;
+    for (size_t i=0;i<counts.size();i++) {
+      if (sum > (size_t)std::numeric_limits<int>::max())
+        throw std::runtime_error("#umesh.partitionMPI: too much data per rank for MPI_Alltoallv");
+      displs[i] = (int)sum;
+      sum += counts[i];
+    }
+    return displs;
+  }
+
+  /*! sends each element to the rank given in 'rankOf', together with
+      all the vertices it references, and returns this rank's own
+      part of the mesh */
+  UMesh::SP exchange(const Input &input,
+                     std::vector<Element> &elements,
+                     const std::vector<int> &rankOf)
+  {
+    // sort elements by destination rank
+    std::vector<size_t> sendCount(mpiSize,0);
+    for (int r : rankOf) sendCount[r]++;
+    std::vector<size_t> sendBegin(mpiSize+1,0);
+    for (int r=0;r<mpiSize;r++) sendBegin[r+1] = sendBegin[r]+sendCount[r];
+    std::vector<Element> sendElements(elements.size());
+    {
+      std::vector<size_t> cursor(sendBegin.begin(),sendBegin.end()-1);
+      for (size_t i=0;i<elements.size();i++)
+        sendElements[cursor[rankOf[i]]++] = elements[i];
+    }
+    elements.clear();
+    elements.shrink_to_fit();
+
+    // all (unique) vertices that each rank's elements reference
+    std::vector<std::vector<Vertex>> sendVertices(mpiSize);
+    const bool haveScalars = input.scalars.size() > 0;
+    parallel_for(mpiSize,[&](size_t r){
+        std::vector<int32_t> ids;
+        for (size_t i=sendBegin[r];i<sendBegin[r+1];i++)
+          for (int j=0;j<sendElements[i].numVertices;j++)
+            ids.push_back(sendElements[i].vertex[j]);
+        std::sort(ids.begin(),ids.end());
+        ids.erase(std::unique(ids.begin(),ids.end()),ids.end());
+        sendVertices[r].resize(ids.size());
+        for (size_t i=0;i<ids.size();i++) {
+          Vertex &v = sendVertices[r][i];
+          v.id       = ids[i];
+          v.position = input.vertices[ids[i]];
+          v.scalar   = haveScalars ? input.scalars[ids[i]] : 0.f;
+        }
+      });
+    std::vector<Vertex> sendVertexData;
+    std::vector<size_t> sendVertexCount(mpiSize);
+    for (int r=0;r<mpiSize;r++) {
+      sendVertexCount[r] = sendVertices[r].size();
+      sendVertexData.insert(sendVertexData.end(),
+                            sendVertices[r].begin(),sendVertices[r].end());
+      std::vector<Vertex>().swap(sendVertices[r]);
+    }
+
+    // exchange counts, then data
+    std::vector<uint64_t> counts(2*mpiSize), recvCounts(2*mpiSize);
+    for (int r=0;r<mpiSize;r++) {
+      counts[2*r+0] = sendCount[r];
+      counts[2*r+1] = sendVertexCount[r];
+    }
+    MPI_Alltoall(counts.data(),2,MPI_UINT64_T,
+                 recvCounts.data(),2,MPI_UINT64_T,MPI_COMM_WORLD);
+    std::vector<size_t> recvCount(mpiSize), recvVertexCount(mpiSize);
+    for (int r=0;r<mpiSize;r++) {
+      recvCount[r]       = recvCounts[2*r+0];
+      recvVertexCount[r] = recvCounts[2*r+1];
+    }
+
+    MPI_Datatype elementType, vertexType;
+    MPI_Type_contiguous(sizeof(Element),MPI_BYTE,&elementType);
+    MPI_Type_contiguous(sizeof(Vertex),MPI_BYTE,&vertexType);
+    MPI_Type_commit(&elementType);
+    MPI_Type_commit(&vertexType);
+
+    auto toInts = [](const std::vector<size_t> &v) {
+      std::vector<int> result;
+      for (auto c : v) result.push_back((int)c);
+      return result;
+    };
+    std::vector<Element> recvElements;
+    {
+      std::vector<int> sc = toInts(sendCount), sd = toDisplacements(sendCount);
+      std::vector<int> rc = toInts(recvCount), rd = toDisplacements(recvCount);
+      recvElements.resize(rd.back()+rc.back());
+      MPI_Alltoallv(sendElements.data(),sc.data(),sd.data(),elementType,
+                    recvElements.data(),rc.data(),rd.data(),elementType,
+                    MPI_COMM_WORLD);
+      std::vector<Element>().swap(sendElements);
+    }
+    std::vector<Vertex> recvVertices;
+    {
+      std::vector<int> sc = toInts(sendVertexCount), sd = toDisplacements(sendVertexCount);
+      std::vector<int> rc = toInts(recvVertexCount), rd = toDisplacements(recvVertexCount);
+      recvVertices.resize(rd.back()+rc.back());
+      MPI_Alltoallv(sendVertexData.data(),sc.data(),sd.data(),vertexType,
+                    recvVertices.data(),rc.data(),rd.data(),vertexType,
+                    MPI_COMM_WORLD);
+      std::vector<Vertex>().swap(sendVertexData);
+    }
+    MPI_Type_free(&elementType);
+    MPI_Type_free(&vertexType);
+
+    // vertices shared by elements from different ranks arrive
+    // multiple times
+    std::sort(recvVertices.begin(),recvVertices.end(),
+              [](const Vertex &a, const Vertex &b){ return a.id < b.id; });
+    recvVertices.erase(std::unique(recvVertices.begin(),recvVertices.end(),
+                                   [](const Vertex &a, const Vertex &b)
+                                   { return a.id == b.id; }),
+                       recvVertices.end());
+
+    UMesh::SP mesh = std::make_shared<UMesh>();
+    mesh->vertices.resize(recvVertices.size());
+    for (size_t i=0;i<recvVertices.size();i++)
+      mesh->vertices[i] = recvVertices[i].position;
+    if (haveScalars) {
+      mesh->perVertex = std::make_shared<Attribute>(recvVertices.size());
+      mesh->perVertex->name = input.scalarsName;
+      for (size_t i=0;i<recvVertices.size();i++)
+        mesh->perVertex->values[i] = recvVertices[i].scalar;
+      mesh->attributes.push_back(mesh->perVertex);
+    }
+
+    parallel_for_blocked(0,recvElements.size(),16*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          Element &element = recvElements[i];
+          for (int j=0;j<element.numVertices;j++)
+            element.vertex[j]
+              = int(std::lower_bound(recvVertices.begin(),recvVertices.end(),
+                                     element.vertex[j],
+                                     [](const Vertex &v, int32_t id)
+                                     { return v.id < id; })
+                    -recvVertices.begin());
+        }
+      });
+    for (auto &element : recvElements) {
+      const int32_t *v = element.vertex;
+      switch (element.type) {
+      case UMesh::TRI:
+        mesh->triangles.push_back(Triangle(v[0],v[1],v[2])); break;
+      case UMesh::QUAD:
+        mesh->quads.push_back(Quad(v[0],v[1],v[2],v[3])); break;
+      case UMesh::TET:
+        mesh->tets.push_back(Tet(v[0],v[1],v[2],v[3])); break;
+      case UMesh::PYR:
+        mesh->pyrs.push_back(Pyr(v[0],v[1],v[2],v[3],v[4])); break;
+      case UMesh::WEDGE:
+        mesh->wedges.push_back(Wedge(v[0],v[1],v[2],v[3],v[4],v[5])); break;
+      case UMesh::HEX:
+        mesh->hexes.push_back(Hex(v[0],v[1],v[2],v[3],v[4],v[5],v[6],v[7])); break;
+      }
+    }
+    return mesh;
+  }
+
+  /*! gathers given per-brick values of all ranks on rank 0, in rank
+      order */
+  template<typename T>
+  std::vector<T> gatherOnRankZero(const std::vector<T> &local)
+  {
+    int count = (int)(local.size()*sizeof(T));
+    std::vector<int> counts(mpiSize), displs(mpiSize,0);
+    MPI_Gather(&count,1,MPI_INT,counts.data(),1,MPI_INT,0,MPI_COMM_WORLD);
+    for (int r=1;r<mpiSize;r++)
+      displs[r] = displs[r-1]+counts[r-1];
+    std::vector<T> result;
+    if (mpiRank == 0)
+      result.resize((displs.back()+counts.back())/sizeof(T));
+    MPI_Gatherv(local.data(),count,MPI_BYTE,
+                result.data(),counts.data(),displs.data(),MPI_BYTE,
+                0,MPI_COMM_WORLD);
+    return result;
+  }
+
+  void partitionMPI(int ac, char **av)
+  {
+    std::string inFileName;
+    std::string outFileBase;
+    int leafThreshold = 1<<30;
+    int numBricks = 1<<30;
+
+    for (int i=1;i<ac;i++) {
+      const std::string arg = av[i];
+      if (arg == "-o")
+        outFileBase = av[++i];
+      else if (arg == "-lt" || arg == "--leaf-threshold")
+        leafThreshold = atoi(av[++i]);
+      else if (arg == "-n" || arg == "--num-bricks") {
+        numBricks = atoi(av[++i]);
+        leafThreshold = 1;
+      } else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown arg "+arg);
+    }
+
+    if (outFileBase == "") usage("no output file name specified");
+    if (inFileName == "") usage("no input file name specified");
+    if (leafThreshold == 1<<30 && numBricks == 1<<30)
+      usage("neither leaf threshold nor number of bricks specified");
+    if (numBricks < mpiSize)
+      usage("need at least one brick per rank");
+
+    if (mpiRank == 0)
+      std::cout << "mapping umesh from " << inFileName
+                << " on " << mpiSize << " rank(s)" << std::endl;
+    Input input(inFileName);
+    if (input.numGrids > 0)
+      throw std::runtime_error("#umesh.partitionMPI: input has grids, which are not supported");
+
+    std::vector<Element> elements = readSlice(input);
+    if (mpiRank == 0)
+      std::cout << "read slices of " << prettyNumber(elements.size())
+                << " elements (on rank 0), splitting" << std::endl;
+    std::vector<int> rankOf = distributedSplit(elements);
+    if (mpiRank == 0)
+      std::cout << "done splitting, exchanging elements and vertices" << std::endl;
+    UMesh::SP mesh = exchange(input,elements,rankOf);
+    mesh->finalize();
+    std::cout << "#rank " << mpiRank << ": got " << mesh->toString() << std::endl;
+
+    PartitionOptions options;
+    options.method        = PARTITION_OBJECT_SPACE;
+    options.maxBricks     = size_t(numBricks)*(mpiRank+1)/mpiSize
+      -                     size_t(numBricks)*mpiRank/mpiSize;
+    options.leafThreshold = leafThreshold;
+    std::vector<PartitionBrick> bricks;
+    if (mesh->size() > 0)
+      bricks = partition(mesh,options);
+
+    int numLocalBricks = (int)bricks.size(), firstBrickID = 0;
+    MPI_Exscan(&numLocalBricks,&firstBrickID,1,MPI_INT,MPI_SUM,MPI_COMM_WORLD);
+    if (mpiRank == 0) firstBrickID = 0;
+
+    std::vector<box3f>   brickBounds(bricks.size());
+    std::vector<range1f> valueRanges(bricks.size());
+    std::mutex logMutex;
+    parallel_for(bricks.size(),[&](size_t i){
+        const int brickID = firstBrickID+int(i);
+        UMesh::SP out = extractBrick(mesh,bricks[i],brickID);
+        char ext[20];
+        sprintf(ext,"_%05d",brickID);
+        const std::string fileName = outFileBase+ext+".umesh";
+        {
+          std::lock_guard<std::mutex> lock(logMutex);
+          std::cout << "#rank " << mpiRank << ": saving out " << fileName
+                    << " w/ " << prettyNumber(out->size()) << " prims" << std::endl;
+        }
+        io::saveBinaryUMesh(fileName,out);
+        brickBounds[i] = bricks[i].bounds;
+        valueRanges[i] = out->perVertex ? out->getValueRange() : range1f();
+      });
+
+    // same layout as the serial partitioners', so io::BrickSet can
+    // read it
+    brickBounds = gatherOnRankZero(brickBounds);
+    valueRanges = gatherOnRankZero(valueRanges);
+    if (mpiRank == 0) {
+      const std::string boundsFileName = outFileBase+".domains";
+      std::ofstream boundsFile(boundsFileName,std::ios::binary);
+      io::writeVector(boundsFile,brickBounds);
+      io::writeVector(boundsFile,valueRanges);
+      std::cout << "done writing " << brickBounds.size()
+                << " bricks' bounds... done all" << std::endl;
+    }
+  }
+
+  extern "C" int main(int ac, char **av)
+  {
+    MPI_Init(&ac,&av);
+    MPI_Comm_rank(MPI_COMM_WORLD,&mpiRank);
+    MPI_Comm_size(MPI_COMM_WORLD,&mpiSize);
+    try {
+      partitionMPI(ac,av);
+    } catch (std::exception &e) {
+      std::cerr << "#rank " << mpiRank << ": fatal error: " << e.what() << std::endl;
+      MPI_Abort(MPI_COMM_WORLD,1);
+    }
+    MPI_Finalize();
+    return 0;
+  }
+
+} // ::umesh
@@ -24,11 +24,20 @@
 #include "umesh/io/ugrid32.h"
 #include "umesh/io/UMesh.h"
 #include "umesh/RemeshHelper.h"
-#include <queue>
+#include "umesh/partition.h"
+#include "umesh/CompactBrick.h"
+#include "umesh/io/BrickSet.h"
+#include "umesh/io/DerivedCache.h"
+#include <mutex>
 
 namespace umesh {
 
   bool equalWeight = true;
+  /*! whether to write bricks with 16-bit quantized vertices and (where
+      possible) 16-bit indices, and the max error to allow for the
+      former (0 for no bound) */
+  bool  compactBricks    = false;
+  float maxPositionError = 0.f;
   
   void usage(const std::string &error = "")
   {
@@ -40,156 +49,41 @@ namespace umesh {
     std::cout << "-n|-num-bricks <N>\n\tnumber of bricks to create" << std::endl;
     std::cout << "--max-bricks <N>\n\tmax number of bricks to create, for given -lt" << std::endl;
     std::cout << "-lt|--leaf-threshold <N>\n\tnum prims at which we make a leaf" << std::endl;
+    std::cout << "-g|--ghost-rings <N>\n\tadd N rings of face-neighboring elements around each brick as ghosts (default: 0)" << std::endl;
+    std::cout << "--cache\n\treuse (or create) cached partitionings and adjacency, in '<in.umesh>.*.cache' files" << std::endl;
+    std::cout << "--compact\n\twrite bricks with 16-bit quantized vertices, and 16-bit indices where they have <= 64K vertices" << std::endl;
+    std::cout << "--max-position-error <e>\n\t(implies --compact) fail if quantizing any brick's vertices would move them by more than e" << std::endl;
     std::cout << std::endl;
     std::cout << "generated files are:" << std::endl;
-    std::cout << "<baseName>.bricks : one box3f for each generated brick" << std::endl;
+    std::cout << "<baseName>.domains : one box3f for each generated brick, followed by one range1f value range each" << std::endl;
     std::cout << "<baseName>_%05d.umesh : the extracted umeshes for each brick" << std::endl;
+    std::cout << "<baseName>.neighbors : (with ghosts only) each brick's neighboring bricks" << std::endl;
+    std::cout << "with ghosts, each brick's elements get an 'ownerBrick' element attribute" << std::endl;
     exit( error != "");
   }
 
-  struct Brick {
-    std::vector<UMesh::PrimRef> prims;
-    box3f bounds;
-    box3f centBounds;
-  };
-
-  void split(UMesh::SP mesh,
-             Brick *in,
-             Brick *out[2])
-  {
-    // PING;
-    // PRINT(in->prims.size());
-    // PRINT(in->bounds);
-    // PRINT(in->centBounds);
-    
-    if (in->centBounds.lower == in->centBounds.upper)
-      throw std::runtime_error("can't split this any more ...");
-    std::cout << "splitting brick\tw/ bounds " << in->bounds << " cent " << in->centBounds << std::endl;
-    
-#if 1
-    float bestWeight = 1e30f;
-    int bestDim = -1;
-    float bestPos = 0.f;
-    for (int dim=0;dim<3;dim++) {
-      enum { numPlanes = 15 };
-      for (int plane=0;plane<numPlanes;plane++) {
-        float f = (plane+1.f)/(numPlanes+1.f);
-        float pos
-          = (1.f-f)*in->centBounds.lower[dim]
-          +      f *in->centBounds.upper[dim];
-        std::cout << "checking at " << char('x'+dim) << "=" << pos << std::endl;
-
-        std::mutex mutex;
-        size_t count[2] = { 0,0 };
-        // out[0] = new Brick;
-        // out[1] = new Brick;
-        parallel_for_blocked
-          (0,in->prims.size(),16*1024,[&](size_t begin, size_t end){
-            int l_count[2] = { 0,0 };
-            for (int i=begin;i<end;i++) {
-              auto prim = in->prims[i];
-              const box3f pb = mesh->getBounds(prim);
-              int side = (pb.center()[dim] < pos) ? 0 : 1;
-              l_count[side]++;
-            }
-            std::lock_guard<std::mutex> lock(mutex);
-            count[0] += l_count[0];
-            count[1] += l_count[1];
-          });
-        // for (auto prim : in->prims) {
-        //   const box3f pb = mesh->getBounds(prim);
-        //   int side = (pb.center()[dim] < pos) ? 0 : 1;
-        //   // out[side]->prims.push_back(prim);
-        //   // out[side]->bounds.extend(pb);
-        //   // out[side]->centBounds.extend(pb.center());
-        // }
-        float s0 = (float)count[0];//out[0]->prims.size();
-        float s1 = (float)count[1];//out[1]->prims.size();
-        float s = fabsf(s0-s1)/(s0+s1);
-        float sx = in->bounds.size().x;
-        float sy = in->bounds.size().y;
-        float sz = in->bounds.size().z;
-        float weight
-          = (.1f+s)
-          * max(max(sx,sy),sz)
-          / std::max(1e-10f,in->bounds.size()[dim]);
-        std::cout << " -> split has " << prettyNumber(count[0])
-                  << " vs " << prettyNumber(count[1])
-                  << ", weight " << weight << std::endl;
-        if (count[0] && count[1] && 
-            weight < bestWeight) {
-          bestWeight = weight;
-          bestPos = pos;
-          bestDim = dim;
-        }
-      }
-    }
-    int dim = bestDim;
-    float pos = bestPos;
-    std::cout << "chosen split " << char('x'+dim) << "=" << pos << std::endl;
-#else      
-    int dim = arg_max(in->centBounds.size());
-    float pos = in->centBounds.center()[dim];
-#endif
-    std::cout << "splitting at " << char('x'+dim) << "=" << pos << std::endl;
-
-    out[0] = new Brick;
-    out[1] = new Brick;
-    for (auto prim : in->prims) {
-      const box3f pb = mesh->getBounds(prim);
-      int side = (pb.center()[dim] < pos) ? 0 : 1;
-      out[side]->prims.push_back(prim);
-      out[side]->bounds.extend(pb);
-      out[side]->centBounds.extend(pb.center());
-    }
-    std::cout << "done splitting " << prettyNumber(in->prims.size()) << " prims\tw/ bounds " << in->bounds << std::endl;
-    std::cout << "into L = " << prettyNumber(out[0]->prims.size()) << " prims\tw/ bounds " << out[0]->bounds << std::endl;
-    std::cout << " and R = " << prettyNumber(out[1]->prims.size()) << " prims\tw/ bounds " << out[1]->bounds << std::endl;
-  }
-  
-void createInitialBrick(std::priority_queue<std::pair<int,Brick *>> &bricks,
-                          UMesh::SP in)
-  {
-    Brick *brick = new Brick;
-    brick->prims = in->createAllPrimRefs();
-#if 1
-    parallel_for_blocked
-      (0,brick->prims.size(),1024,
-       [&](size_t begin, size_t end) {
-        for (int i=begin;i<end;i++) {
-          auto prim = brick->prims[i];
-          const box3f pb = in->getBounds(prim);
-          brick->bounds.extend(pb);
-          brick->centBounds.extend(pb.center());
-        }
-      });
-#else
-    for (auto prim : brick->prims) {
-      const box3f pb = in->getBounds(prim);
-      brick->bounds.extend(pb);
-      brick->centBounds.extend(pb.center());
-    }
-#endif
-           
-    bricks.push({(int)brick->prims.size(),brick});
-  }
-
-  void writeBrick(UMesh::SP in,
-                  const std::string &fileBase,
-                  Brick *brick)
+  /*! extracts the given brick's prims into their own mesh, saves
+      that, and returns its value range; may get called for multiple
+      bricks concurrently */
+  range1f writeBrick(UMesh::SP in,
+                     const std::string &fileBase,
+                     const PartitionBrick &brick,
+                     int brickID,
+                     std::mutex &logMutex)
   {
-    std::cout << "creating output brick over " << prettyNumber(brick->prims.size()) << " prims" << std::endl;
-    UMesh::SP out = std::make_shared<UMesh>();
-    RemeshHelper indexer(*out);
-    for (auto prim : brick->prims) 
-      indexer.add(in,prim);
-    std:: cout << "done reindexing, finalizing umesh" << std::endl;
-    out->finalize();
+    UMesh::SP out = extractBrick(in,brick,brickID);
     const std::string fileName = fileBase+".umesh";
-    std::cout << "saving out " << fileName
-              << " w/ " << prettyNumber(out->size()) << " prims" << std::endl;
-    io::saveBinaryUMesh(fileName,out);
-    std::cout << "done saving" << std::endl;
+    {
+      std::lock_guard<std::mutex> lock(logMutex);
+      std::cout << "saving out " << fileName
+                << " w/ " << prettyNumber(out->size()) << " prims" << std::endl;
+    }
+    if (compactBricks) {
+      const CompactBrick compact = CompactBrick::encode(*out,maxPositionError);
+      out->saveTo(fileName,compact);
+    } else
+      io::saveBinaryUMesh(fileName,out);
+    return out->perVertex ? out->getValueRange() : range1f();
   }
   
   extern "C" int main(int ac, char **av)
@@ -198,6 +92,8 @@ void createInitialBrick(std::priority_queue<std::pair<int,Brick *>> &bricks,
     std::string outFileBase;
     int leafThreshold = 1<<30;
     int maxBricks = 1<<30;
+    int ghostRings = 0;
+    bool useCache = false;
     
     for (int i=1;i<ac;i++) {
       const std::string arg = av[i];
@@ -205,6 +101,16 @@ void createInitialBrick(std::priority_queue<std::pair<int,Brick *>> &bricks,
         outFileBase = av[++i];
       else if (arg == "-lt" || arg == "--leaf-threshold")
         leafThreshold = atoi(av[++i]);
+      else if (arg == "-g" || arg == "--ghost-rings")
+        ghostRings = atoi(av[++i]);
+      else if (arg == "--cache")
+        useCache = true;
+      else if (arg == "--compact")
+        compactBricks = true;
+      else if (arg == "--max-position-error") {
+        compactBricks    = true;
+        maxPositionError = (float)atof(av[++i]);
+      }
       else if (arg == "-mb" || arg == "--max-bricks")
         maxBricks = atoi(av[++i]);
       else if (arg == "-n" || arg == "--num-bricks") {
@@ -224,41 +130,52 @@ void createInitialBrick(std::priority_queue<std::pair<int,Brick *>> &bricks,
     UMesh::SP in = io::loadBinaryUMesh(inFileName);
     std::cout << "done loading, found " << in->toString() << std::endl;
 
-    std::priority_queue<std::pair<int,Brick *>> bricks;
-    createInitialBrick(bricks,in);
-    
-    while (bricks.size() < maxBricks) {
-      auto biggest = bricks.top(); 
-      std::cout << "########### currently having " << bricks.size()
-                << " bricks, biggest of which has "
-                << prettyNumber(biggest.first) << " prims" << std::endl;
-      if (biggest.first < leafThreshold)
-        break;
-      bricks.pop();
-
-      std::cout << "splitting..." << std::endl;
-      Brick *half[2];
-      split(in,biggest.second,half);
-      bricks.push({(int)half[0]->prims.size(),half[0]});
-      bricks.push({(int)half[1]->prims.size(),half[1]});
-      delete biggest.second;
+    PartitionOptions options;
+    options.method        = PARTITION_OBJECT_SPACE;
+    options.maxBricks     = maxBricks;
+    options.leafThreshold = leafThreshold;
+    io::DerivedCache::SP cache;
+    if (useCache)
+      cache = std::make_shared<io::DerivedCache>(in,inFileName);
+    std::vector<PartitionBrick> bricks
+      = cache ? cache->partition(options) : partition(in,options);
+    if (ghostRings > 0) {
+      std::cout << "computing " << ghostRings << " ring(s) of ghosts per brick" << std::endl;
+      Adjacency::SP adjacency
+        = cache ? cache->adjacency() : Adjacency::compute(in);
+      addGhostLayers(bricks,ghostRings,*adjacency);
     }
 
-    std::cout << "done splitting, creating and emitting bricks" << std::endl;
-    char ext[20];
-    // std::vector<box3f> brickBounds;
-    for (int brickID=0;!bricks.empty();brickID++) {
-      Brick *brick = bricks.top().second;
-      bricks.pop();
-      sprintf(ext,"_%05d",brickID);
-      writeBrick(in,outFileBase+ext,brick);
-      // brickBounds.push_back(brick->bounds);
-      delete brick;
-    }
+    std::cout << "done splitting into " << bricks.size()
+              << " bricks, creating and emitting bricks" << std::endl;
+    // bricks get extracted and written in parallel, so writing one
+    // brick overlaps with extracting (and writing) others
+    std::vector<box3f> brickBounds(bricks.size());
+    std::vector<range1f> valueRanges(bricks.size());
+    std::mutex logMutex;
+    parallel_for(bricks.size(),[&](size_t brickID){
+        char ext[20];
+        sprintf(ext,"_%05d",int(brickID));
+        valueRanges[brickID] = writeBrick(in,outFileBase+ext,bricks[brickID],int(brickID),logMutex);
+        brickBounds[brickID] = bricks[brickID].bounds;
+      });
+    std::cout << "done saving all bricks" << std::endl;
+
+    // same layout as the spatial partitioner's, so io::BrickSet can
+    // read either; here, each brick's domain is its prims' bounds
+    const std::string boundsFileName = outFileBase+".domains";
+    std::ofstream boundsFile(boundsFileName,std::ios::binary);
+    io::writeVector(boundsFile,brickBounds);
+    io::writeVector(boundsFile,valueRanges);
+    std::cout << "done writing bounds... done all" << std::endl;
 
-    // std::ofstream boundsFile(outFileBase+".bounds",std::ios::binary);
-    // io::writeVector(boundsFile,brickBounds);
-    // std::cout << "done wirting bounds... done all" << std::endl;
+    if (ghostRings > 0) {
+      std::vector<std::vector<int>> neighbors;
+      for (auto &brick : bricks)
+        neighbors.push_back(brick.neighbors);
+      io::BrickSet::saveNeighbors(outFileBase,neighbors);
+      std::cout << "done writing brick neighbors to " << outFileBase << ".neighbors" << std::endl;
+    }
   }
   
 } // ::umesh
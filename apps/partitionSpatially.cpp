@@ -24,11 +24,20 @@
 #include "umesh/io/ugrid32.h"
 #include "umesh/io/UMesh.h"
 #include "umesh/RemeshHelper.h"
-#include <queue>
+#include "umesh/partition.h"
+#include "umesh/CompactBrick.h"
+#include "umesh/io/BrickSet.h"
+#include "umesh/io/DerivedCache.h"
+#include <mutex>
 
 namespace umesh {
 
   bool primRefsOnly = false;
+  /*! whether to write bricks with 16-bit quantized vertices and (where
+      possible) 16-bit indices, and the max error to allow for the
+      former (0 for no bound) */
+  bool  compactBricks    = false;
+  float maxPositionError = 0.f;
   
   void usage(const std::string &error = "")
   {
@@ -41,100 +50,61 @@ namespace umesh {
     std::cout << "-o <baseName>\n\tbase path for all output files (there will be multiple)" << std::endl;
     std::cout << "-n|-mb|--max-bricks <N>\n\tmax number of bricks to create" << std::endl;
     std::cout << "-lt|--leaf-threshold <N>\n\tnum prims at which we make a leaf" << std::endl;
+    std::cout << "-g|--ghost-rings <N>\n\tadd N rings of face-neighboring elements around each brick as ghosts (default: 0)" << std::endl;
+    std::cout << "--cache\n\treuse (or create) cached partitionings and adjacency, in '<in.umesh>.*.cache' files" << std::endl;
     std::cout << "-pro|--prim-refs-only\n\tdump _only_ the primrefs going into each brick, do not create the actual umeshes" << std::endl;
+    std::cout << "--compact\n\twrite bricks with 16-bit quantized vertices, and 16-bit indices where they have <= 64K vertices" << std::endl;
+    std::cout << "--max-position-error <e>\n\t(implies --compact) fail if quantizing any brick's vertices would move them by more than e" << std::endl;
     std::cout << std::endl;
     std::cout << "generated files are:" << std::endl;
-    std::cout << "<baseName>.bricks : one box3f for each generated brick" << std::endl;
+    std::cout << "<baseName>.domains : one box3f for each generated brick, followed by one range1f value range each" << std::endl;
     std::cout << "<baseName>_%05d.umesh : the extracted umeshes for each brick" << std::endl;
+    std::cout << "<baseName>.neighbors : (with ghosts only) each brick's neighboring bricks" << std::endl;
+    std::cout << "with ghosts, each brick's elements get an 'ownerBrick' element attribute" << std::endl;
     exit( error != "");
   }
 
-  struct Brick {
-    std::vector<UMesh::PrimRef> prims;
-    box3f domain;
-  };
-
-  void split(UMesh::SP mesh,
-             Brick *in,
-             Brick *out[2])
-  {
-    if (in->domain.lower == in->domain.upper)
-      throw std::runtime_error("can't split this any more ...");
-
-    int dim = arg_max(in->domain.size());
-    float pos = in->domain.center()[dim];
-    std::cout << "splitting brick\tw/ domain " << in->domain << std::endl;
-    std::cout << "splitting at " << char('x'+dim) << "=" << pos << std::endl;
-
-    Brick *l = out[0] = new Brick;
-    Brick *r = out[1] = new Brick;
-    l->domain = r->domain = in->domain;
-    l->domain.upper[dim] = pos;
-    r->domain.lower[dim] = pos;
-    box3f lBounds, rBounds;
-
-    for (auto prim : in->prims) {
-      const box3f pb = mesh->getBounds(prim);
-      if (pb.overlaps(l->domain)) {
-        l->prims.push_back(prim);
-        lBounds.extend(pb);
-      }
-      if (pb.overlaps(r->domain)) {
-        r->prims.push_back(prim);
-        rBounds.extend(pb);
-      }
-    }
-    l->domain = intersection(l->domain,lBounds);
-    r->domain = intersection(r->domain,rBounds);
-    
-    std::cout << "done splitting " << prettyNumber(in->prims.size()) << " prims\tw/ domain " << in->domain << std::endl;
-    std::cout << "into L = " << prettyNumber(out[0]->prims.size()) << " prims\tw/ domain " << out[0]->domain << std::endl;
-    std::cout << " and R = " << prettyNumber(out[1]->prims.size()) << " prims\tw/ domain " << out[1]->domain << std::endl;
-  }
-  
-  void createInitialBrick(std::priority_queue<std::pair<int,Brick *>> &bricks,
-                          UMesh::SP in)
+  /*! saves the given brick (either as a umesh, or just its prim
+      refs), and returns its value range; may get called for multiple
+      bricks concurrently */
+  range1f writeBrick(UMesh::SP in,
+                     const std::string &fileBase,
+                     const PartitionBrick &brick,
+                     int brickID,
+                     std::mutex &logMutex)
   {
-    Brick *brick = new Brick;
-    // in->createVolumePrimRefs(brick->prims);
-    brick->prims = in->createAllPrimRefs();
-    box3f bounds;
-    for (auto prim : brick->prims) {
-      const box3f pb = in->getBounds(prim);
-      bounds.extend(pb);
-    }
-    brick->domain = bounds;
-    bricks.push({(int)brick->prims.size(),brick});
-  }
-
-  void writeBrick(UMesh::SP in,
-                  const std::string &fileBase,
-                  Brick *brick,
-                  range1f &valueRange)
-  {
-    UMesh::SP out = std::make_shared<UMesh>();
-    RemeshHelper indexer(*out);
-
-    valueRange = range1f();
-    for (auto pr : brick->prims)
-      valueRange.extend(in->getValueRange(pr));
-    
+    range1f valueRange;
     if (primRefsOnly) {
+      for (auto pr : brick.prims)
+        valueRange.extend(in->getValueRange(pr));
       const std::string fileName = fileBase+".primRefs";
-      std::cout << "saving out " << fileName
-                << " w/ " << prettyNumber(brick->prims.size()) << " primsRefs" << std::endl;
+      {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cout << "saving out " << fileName
+                  << " w/ " << prettyNumber(brick.prims.size()) << " primsRefs" << std::endl;
+      }
       std::ofstream out(fileName,std::ios::binary);
-      io::writeVector(out,brick->prims);
+      io::writeVector(out,brick.prims);
       io::writeElement(out,valueRange);
     } else {
-      for (auto prim : brick->prims) 
-        indexer.add(in,prim);
+      UMesh::SP out = extractBrick(in,brick,brickID);
+      // the brick's vertices are exactly those used by its prims, so
+      // their range is that of the prims
+      if (out->perVertex)
+        valueRange = out->getValueRange();
       const std::string fileName = fileBase+".umesh";
-      std::cout << "saving out " << fileName
-                << " w/ " << prettyNumber(out->size()) << " prims, domain is " << brick->domain << std::endl;
-      out->finalize();
-      io::saveBinaryUMesh(fileName,out);
+      {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cout << "saving out " << fileName
+                  << " w/ " << prettyNumber(out->size()) << " prims, domain is " << brick.domain << std::endl;
+      }
+      if (compactBricks) {
+        const CompactBrick compact = CompactBrick::encode(*out,maxPositionError);
+        out->saveTo(fileName,compact);
+      } else
+        io::saveBinaryUMesh(fileName,out);
     }
+    return valueRange;
   }
   
   extern "C" int main(int ac, char **av)
@@ -143,6 +113,8 @@ namespace umesh {
     std::string outFileBase;
     int leafThreshold = 1<<30;
     int maxBricks = 1<<30;
+    int ghostRings = 0;
+    bool useCache = false;
     
     for (int i=1;i<ac;i++) {
       const std::string arg = av[i];
@@ -152,11 +124,21 @@ namespace umesh {
         outFileBase = av[++i];
       else if (arg == "-lt" || arg == "--leaf-threshold")
         leafThreshold = atoi(av[++i]);
+      else if (arg == "-g" || arg == "--ghost-rings")
+        ghostRings = atoi(av[++i]);
+      else if (arg == "--cache")
+        useCache = true;
       else if (arg == "-n" || arg == "-mb" || arg == "--max-bricks") {
         maxBricks = atoi(av[++i]);
         leafThreshold= 1;
       } else if (arg == "-pro" || arg == "--prim-refs-only")
         primRefsOnly = true;
+      else if (arg == "--compact")
+        compactBricks = true;
+      else if (arg == "--max-position-error") {
+        compactBricks    = true;
+        maxPositionError = (float)atof(av[++i]);
+      }
       else if (arg[0] != '-')
         inFileName = arg;
       else
@@ -167,51 +149,42 @@ namespace umesh {
     if (inFileName == "") usage("no input file name specified");
     if (leafThreshold == 1<<30 && maxBricks == 1<<30)
       usage("neither leaf threshold nor max bricks specified");
+    if (primRefsOnly && ghostRings > 0)
+      usage("ghost layers are not supported with --prim-refs-only");
 
     std::cout << "loading umesh from " << inFileName << std::endl;
     UMesh::SP in = io::loadBinaryUMesh(inFileName);
     std::cout << "done loading, found " << in->toString() << std::endl;
     
-    std::priority_queue<std::pair<int,Brick *>> bricks;
-    createInitialBrick(bricks,in);
-    
-    while (bricks.size() < maxBricks) {
-      auto biggest = bricks.top(); 
-      std::cout << "########### currently having " << bricks.size()
-                << " bricks, biggest of which has "
-                << prettyNumber(biggest.first) << " prims" << std::endl;
-      if (biggest.first < leafThreshold)
-        break;
-      bricks.pop();
-
-      std::cout << "splitting..." << std::endl;
-      Brick *half[2];
-      split(in,biggest.second,half);
-      for (int i=0;i<2;i++) {
-        if (half[i]->prims.empty() ||
-            reduce_min(half[i]->domain.size()) == 0.f) {
-          std::cout << "WARNING: got invalid split, dropping!" << std::endl;
-          delete half[i];
-        }
-        else
-          bricks.push({ (int)half[i]->prims.size(),half[i]});
-      }
-      delete biggest.second;
-    }
-
-    char ext[20];
-    std::vector<box3f> brickDomains;
-    std::vector<range1f> valueRanges;
-    for (int brickID=0;!bricks.empty();brickID++) {
-      Brick *brick = bricks.top().second;
-      bricks.pop();
-      sprintf(ext,"_%05d",brickID);
-      range1f valueRange;
-      writeBrick(in,outFileBase+ext,brick,valueRange);
-      brickDomains.push_back(brick->domain);
-      valueRanges.push_back(valueRange);
-      delete brick;
+    PartitionOptions options;
+    options.method        = PARTITION_SPATIAL;
+    options.maxBricks     = maxBricks;
+    options.leafThreshold = leafThreshold;
+    io::DerivedCache::SP cache;
+    if (useCache)
+      cache = std::make_shared<io::DerivedCache>(in,inFileName);
+    std::vector<PartitionBrick> bricks
+      = cache ? cache->partition(options) : partition(in,options);
+    if (ghostRings > 0) {
+      std::cout << "computing " << ghostRings << " ring(s) of ghosts per brick" << std::endl;
+      Adjacency::SP adjacency
+        = cache ? cache->adjacency() : Adjacency::compute(in);
+      addGhostLayers(bricks,ghostRings,*adjacency);
     }
+    std::cout << "done splitting into " << bricks.size() << " bricks" << std::endl;
+
+    // bricks get extracted and written in parallel, so writing one
+    // brick overlaps with extracting (and writing) others
+    std::vector<box3f> brickDomains(bricks.size());
+    std::vector<range1f> valueRanges(bricks.size());
+    std::mutex logMutex;
+    parallel_for(bricks.size(),[&](size_t brickID){
+        const PartitionBrick &brick = bricks[brickID];
+        char ext[20];
+        sprintf(ext,"_%05d",int(brickID));
+        valueRanges[brickID]  = writeBrick(in,outFileBase+ext,brick,int(brickID),logMutex);
+        brickDomains[brickID] = brick.domain;
+      });
 
     std::cout << "# =======================================================" << std::endl;
     std::cout << "# Done partitioning, writing final results" << std::endl;
@@ -223,6 +196,14 @@ namespace umesh {
     // std::cout << "writing " << valueRanges.size() << " brick value ranges" << std::endl;
     io::writeVector(boundsFile,valueRanges);
     std::cout << "done writing domains... done all" << std::endl;
+
+    if (ghostRings > 0) {
+      std::vector<std::vector<int>> neighbors;
+      for (auto &brick : bricks)
+        neighbors.push_back(brick.neighbors);
+      io::BrickSet::saveNeighbors(outFileBase,neighbors);
+      std::cout << "done writing brick neighbors to " << outFileBase << ".neighbors" << std::endl;
+    }
   }
   
 } // ::umesh
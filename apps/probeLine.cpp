@@ -0,0 +1,115 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* marches a line segment through the volume elements of a umesh, and
+   prints every element it passes through, with the scalars where it
+   enters and leaves that element, and the (piecewise linear) integral
+   of the scalar field along the segment */
+
+#include "umesh/io/UMesh.h"
+#include "umesh/RayMarcher.h"
+#include <fstream>
+
+namespace umesh {
+
+  void usage(const std::string &error = "")
+  {
+    if (error != "")
+      std::cerr << "Error : " << error  << "\n\n";
+
+    std::cout << "Usage: ./umeshProbeLine <in.umesh> -from x y z -to x y z [args]" << std::endl;
+    std::cout << "w/ Args: " << std::endl;
+    std::cout << "-o <out.txt>\n\twrite the segments to given file (default: to stdout)" << std::endl;
+    exit(error != "");
+  }
+  
+  extern "C" int main(int ac, char **av)
+  {
+    std::string inFileName;
+    std::string outFileName;
+    vec3f from(NAN), to(NAN);
+    
+    for (int i=1;i<ac;i++) {
+      const std::string arg = av[i];
+      if (arg == "-h")
+        usage();
+      else if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "-from" || arg == "--from") {
+        from.x = std::stof(av[++i]);
+        from.y = std::stof(av[++i]);
+        from.z = std::stof(av[++i]);
+      } else if (arg == "-to" || arg == "--to") {
+        to.x = std::stof(av[++i]);
+        to.y = std::stof(av[++i]);
+        to.z = std::stof(av[++i]);
+      } else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmd-line arg '"+arg+"'");
+    }
+    
+    if (inFileName == "") usage("no input file specified");
+    if (isnan(from.x) || isnan(to.x)) usage("no (valid) line specified");
+    const float lineLength = length(to-from);
+    if (lineLength == 0.f) usage("line has zero length");
+    
+    std::cout << "loading umesh from " << inFileName << std::endl;
+    UMesh::SP in = io::loadBinaryUMesh(inFileName);
+    std::cout << "done loading, found " << in->toString() << std::endl;
+
+    std::cout << "building face connectivity ..." << std::endl;
+    RayMarcher::SP marcher = RayMarcher::build(in);
+
+    // parameterize the ray by distance along the line
+    RayMarcher::Ray ray;
+    ray.org  = from;
+    ray.dir  = (to-from)*(1.f/lineLength);
+    ray.tMax = lineLength;
+    std::vector<RayMarcher::Segment> segments;
+    const bool lost = !marcher->march(ray,segments);
+
+    std::ofstream file;
+    if (outFileName != "") {
+      file.open(outFileName);
+      if (!file.good())
+        throw std::runtime_error("could not open '"+outFileName+"' for writing");
+    }
+    std::ostream &out = outFileName != "" ? file : std::cout;
+    const char *typeName[] = { "tet", "pyr", "wedge", "hex" };
+    out << "# element type ID tEnter tExit scalarEnter scalarExit" << std::endl;
+    double integral = 0.;
+    float covered = 0.f;
+    for (auto &segment : segments) {
+      const UMesh::PrimRef prim = marcher->primOf(segment.element);
+      out << segment.element << " " << typeName[prim.type-UMesh::TET]
+          << " " << prim.ID
+          << " " << segment.tEnter << " " << segment.tExit
+          << " " << segment.scalarEnter << " " << segment.scalarExit << std::endl;
+      const float length = segment.tExit-segment.tEnter;
+      integral += .5*(segment.scalarEnter+segment.scalarExit)*length;
+      covered  += length;
+    }
+    std::cout << "line passes through " << prettyNumber(segments.size())
+              << " elements, over a length of " << covered
+              << " (of " << lineLength << ")" << std::endl;
+    std::cout << "integral of the scalars along the line: " << integral << std::endl;
+    if (lost)
+      std::cout << "warning: traversal got lost (degenerate or inverted elements?)" << std::endl;
+    std::cout << "done all ..." << std::endl;
+  }
+
+} // ::umesh
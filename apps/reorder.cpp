@@ -0,0 +1,83 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+/* reorders a umesh's vertices and elements along a space-filling
+   curve, so that things that are close in space are also close in
+   memory (which makes pretty much every kernel that gathers vertices
+   more cache friendly) */
+
+#include "umesh/io/UMesh.h"
+#include "umesh/reorder.h"
+
+namespace umesh {
+
+  void usage(const std::string &error = "")
+  {
+    if (error != "")
+      std::cerr << "Error : " << error  << "\n\n";
+
+    std::cout << "Usage: ./umeshReorder <in.umesh> -o <out.umesh> [args]" << std::endl;
+    std::cout << "w/ Args: " << std::endl;
+    std::cout << "--hilbert\n\tsort along a hilbert curve (default)" << std::endl;
+    std::cout << "--morton\n\tsort along a morton (z-order) curve" << std::endl;
+    std::cout << "--compress\n\tcompress the output file's sections (see io/Compression.h)" << std::endl;
+    exit(error != "");
+  }
+  
+  extern "C" int main(int ac, char **av)
+  {
+    std::string inFileName;
+    std::string outFileName;
+    SpaceFillingCurve curve = REORDER_HILBERT;
+    bool compress = false;
+    
+    for (int i=1;i<ac;i++) {
+      const std::string arg = av[i];
+      if (arg == "-h")
+        usage();
+      else if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "--hilbert")
+        curve = REORDER_HILBERT;
+      else if (arg == "--morton")
+        curve = REORDER_MORTON;
+      else if (arg == "--compress")
+        compress = true;
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmd-line arg '"+arg+"'");
+    }
+    
+    if (inFileName == "") usage("no input file specified");
+    if (outFileName == "") usage("no output file specified");
+    
+    std::cout << "loading umesh from " << inFileName << std::endl;
+    UMesh::SP mesh = io::loadBinaryUMesh(inFileName);
+    std::cout << "done loading, found " << mesh->toString() << std::endl;
+
+    std::cout << "reordering along "
+              << (curve == REORDER_HILBERT ? "hilbert" : "morton")
+              << " curve ..." << std::endl;
+    reorder(mesh,curve);
+
+    std::cout << "saving to " << outFileName << std::endl;
+    io::saveBinaryUMesh(outFileName,mesh,compress);
+    std::cout << "done all ..." << std::endl;
+  }
+
+} // ::umesh
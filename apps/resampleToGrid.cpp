@@ -0,0 +1,108 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* resamples the scalar field of a umesh onto a regular grid, and
+   writes that as a raw volume of floats (in x-fastest order, the same
+   layout umeshRawToGrids reads) */
+
+#include "umesh/io/UMesh.h"
+#include "umesh/io/IO.h"
+#include "umesh/resampleToGrid.h"
+
+namespace umesh {
+
+  void usage(const std::string &error = "")
+  {
+    if (error != "")
+      std::cerr << "Error : " << error  << "\n\n";
+
+    std::cout << "Usage: ./umeshResampleToGrid <in.umesh> -o <out.raw> -dims dimsX dimsY dimsZ [args]" << std::endl;
+    std::cout << "w/ Args: " << std::endl;
+    std::cout << "-bounds|--bounds lowerX lowerY lowerZ upperX upperY upperZ\n\tregion to resample (default: the mesh's bounds)" << std::endl;
+    std::cout << "--outside <value>\n\tvalue for samples that are not in any element (default: NaN)" << std::endl;
+    std::cout << "--quantize <bits>\n\tquantize the scalars to 8 or 16 bits, and resample those (files with\n\tonly quantized attributes always use the first one of those)" << std::endl;
+    exit(error != "");
+  }
+  
+  extern "C" int main(int ac, char **av)
+  {
+    std::string inFileName;
+    std::string outFileName;
+    vec3i dims(0);
+    box3f domain;
+    float valueIfOutside = NAN;
+    int quantizeBits = 0;
+    
+    for (int i=1;i<ac;i++) {
+      const std::string arg = av[i];
+      if (arg == "-h")
+        usage();
+      else if (arg == "-o")
+        outFileName = av[++i];
+      else if (arg == "-d" || arg == "-dims" || arg == "--dims") {
+        dims.x = std::stoi(av[++i]);
+        dims.y = std::stoi(av[++i]);
+        dims.z = std::stoi(av[++i]);
+      } else if (arg == "-bounds" || arg == "--bounds") {
+        domain.lower.x = std::stof(av[++i]);
+        domain.lower.y = std::stof(av[++i]);
+        domain.lower.z = std::stof(av[++i]);
+        domain.upper.x = std::stof(av[++i]);
+        domain.upper.y = std::stof(av[++i]);
+        domain.upper.z = std::stof(av[++i]);
+      } else if (arg == "--outside")
+        valueIfOutside = std::stof(av[++i]);
+      else if (arg == "--quantize")
+        quantizeBits = std::stoi(av[++i]);
+      else if (arg[0] != '-')
+        inFileName = arg;
+      else
+        usage("unknown cmd-line arg '"+arg+"'");
+    }
+    
+    if (inFileName == "") usage("no input file specified");
+    if (outFileName == "") usage("no output file specified");
+    if (dims.x <= 0 || dims.y <= 0 || dims.z <= 0) usage("no (valid) grid dims specified");
+    
+    std::cout << "loading umesh from " << inFileName << std::endl;
+    UMesh::SP in = io::loadBinaryUMesh(inFileName);
+    std::cout << "done loading, found " << in->toString() << std::endl;
+    if (domain.empty())
+      domain = in->getBounds();
+    
+    std::cout << "resampling to " << dims.x << "x" << dims.y << "x" << dims.z
+              << " grid over " << domain << std::endl;
+    QuantizedAttribute::SP quantized;
+    if (quantizeBits && in->perVertex) {
+      quantized = QuantizedAttribute::quantize(*in->perVertex,quantizeBits);
+      std::cout << "quantized scalars to " << quantizeBits
+                << " bits, max error " << quantized->maxError() << std::endl;
+    } else if (!in->perVertex && !in->quantizedAttributes.empty())
+      quantized = in->quantizedAttributes[0];
+    const std::vector<float> samples
+      = quantized
+      ? resampleToGrid(in,*quantized,domain,dims,valueIfOutside)
+      : resampleToGrid(in,domain,dims,valueIfOutside);
+
+    std::cout << "writing raw volume to " << outFileName << std::endl;
+    std::ofstream out(outFileName,std::ios::binary);
+    io::writeArray(out,samples.data(),samples.size());
+    if (!out.good())
+      throw std::runtime_error("error writing to '"+outFileName+"'");
+    std::cout << "done all ..." << std::endl;
+  }
+
+} // ::umesh
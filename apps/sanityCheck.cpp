@@ -25,17 +25,20 @@ namespace umesh {
     if (error != "")
       std::cerr << "\nError : " << error  << "\n\n";
 
-    std::cout << "Usage: ./umeshSanityCheck <in.umesh>\n\n";
+    std::cout << "Usage: ./umeshSanityCheck <in.umesh> [--max-offenders N]\n\n";
     exit(error != "");
   };
   
   extern "C" int main(int ac, char **av)
   {
     std::string inFileName;
+    size_t maxOffenders = 10;
     for (int i=1;i<ac;i++) {
       const std::string arg = av[i];
       if (arg == "-h")
         usage();
+      else if (arg == "--max-offenders")
+        maxOffenders = std::stoul(av[++i]);
       else if (arg[0] != '-')
         inFileName = arg;
       else
@@ -48,8 +51,14 @@ namespace umesh {
     UMesh::SP in = io::loadBinaryUMesh(inFileName);
 
     std::cout << "UMesh info:\n" << in->toString(false) << std::endl;
-    sanityCheck(in);
+    CheckReport report = checkMesh(in,0,maxOffenders);
+    std::cout << report.toString();
+    if (report.hasErrors()) {
+      std::cout << "mesh FAILED sanity check" << std::endl;
+      return 1;
+    }
     std::cout << "all sanity checks went through ..." << std::endl;
+    return 0;
   }
   
 } // ::umesh
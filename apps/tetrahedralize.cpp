@@ -16,10 +16,42 @@
 
 #include "umesh/io/ugrid32.h"
 #include "umesh/io/UMesh.h"
+#include "umesh/io/UMeshWriter.h"
 #include "umesh/tetrahedralize.h"
 
 namespace umesh {
 
+  /*! streams everything the tetrahedralization generates directly
+      to the output file, so the output mesh never has to be in
+      memory as a whole */
+  struct StreamToFile : public TetrahedralizeConsumer {
+    StreamToFile(io::UMeshWriter &writer, const std::string &scalarsName)
+      : writer(writer), scalarsName(scalarsName)
+    {}
+    
+    void addVertices(const vec3f *vertices,
+                     const float *scalars,
+                     size_t count) override
+    {
+      writer.addVertices(vertices,count);
+      if (scalars)
+        writer.addVertexAttribute(scalarsName,scalars,count);
+    }
+    void addTets(const UMesh::Tet *tets, size_t count) override
+    { writer.addTets(tets,count); numTets += count; }
+    void addPyrs(const UMesh::Pyr *pyrs, size_t count) override
+    { writer.addPyrs(pyrs,count); numOthers += count; }
+    void addWedges(const UMesh::Wedge *wedges, size_t count) override
+    { writer.addWedges(wedges,count); numOthers += count; }
+    void addHexes(const UMesh::Hex *hexes, size_t count) override
+    { writer.addHexes(hexes,count); numOthers += count; }
+
+    io::UMeshWriter   &writer;
+    const std::string  scalarsName;
+    size_t             numTets   = 0;
+    size_t             numOthers = 0;
+  };
+
   void usage(const std::string error="")
   {
     if (error != "")
@@ -69,19 +101,19 @@ namespace umesh {
       std::cout << UMESH_TERMINAL_DEFAULT << std::endl;
     }
     
-    UMesh::SP out
-      = maintainFlatElements
-      ? tetrahedralize_maintainFlatElements(in)
-      : tetrahedralize(in);
-    std::cout << "done all prims, saving output to " << outFileName << std::endl;
-    // PRINT(prettyNumber(out->tets.size()));
-    // PRINT(prettyNumber(out->pyrs.size()));
-    // PRINT(prettyNumber(out->wedges.size()));
-    // PRINT(prettyNumber(out->hexes.size()));
-
-    out->finalize();
-    io::saveBinaryUMesh(outFileName,out);
-    std::cout << "done all ..." << std::endl;
+    std::cout << "tetrahedralizing, and streaming output to " << outFileName << std::endl;
+    io::UMeshWriter writer(outFileName);
+    const std::string scalarsName
+      = in->perVertex ? in->perVertex->name : std::string();
+    writer.addVertices(in->vertices);
+    if (in->perVertex)
+      writer.addVertexAttribute(scalarsName,in->perVertex->values);
+    StreamToFile stream(writer,scalarsName);
+    tetrahedralize(in,stream,maintainFlatElements);
+    writer.close();
+    std::cout << "done all, wrote " << prettyNumber(writer.numVertices()) << " vertices, "
+              << prettyNumber(stream.numTets) << " tets, and "
+              << prettyNumber(stream.numOthers) << " passed-through elements" << std::endl;
     
   }
 } // ::umesh
@@ -1,16 +1,13 @@
-#include <vtkDoubleArray.h>
-#include <vtkPointData.h>
-#include <vtkUnstructuredGrid.h>
-#include <vtkUnstructuredGridWriter.h>
 #include "umesh/io/ugrid64.h"
 #include "umesh/io/UMesh.h"
+#include "umesh/io/VTU.h"
 
 namespace umesh {
 
   static bool g_verbose = false;
-  static bool g_ascii = false;
   static std::string g_filename;
-  static std::string g_outname = "out.vtk";
+  static std::string g_outname = "out.vtu";
+  static io::VTUOptions g_options;
 
   UMesh::SP load(const std::string &fileName)
   {
@@ -28,9 +25,9 @@ namespace umesh {
 
   static void printUsage() {
     std::cout << "./umeshToVTU <filename> [{--help|-h}]\n"
-              << "   [-o <outname>]\n"
+              << "   [-o <outname.vtu>]\n"
               << "   [{--verbose|-v}]\n"
-              << "   [{--ascii|-a}]\n";
+              << "   [{--compress|-z} [<level>]]\n";
   }
   
   static void parseCommandLine(int argc, char *argv[]) {
@@ -41,9 +38,11 @@ namespace umesh {
       else if (arg == "--help" || arg == "-h") {
         printUsage();
         std::exit(0);
-      } else if (arg == "-a" || arg == "--ascii")
-        g_ascii = true;
-      else if (arg == "-o")
+      } else if (arg == "-z" || arg == "--compress") {
+        g_options.compress = true;
+        if (i+1 < argc && isdigit(argv[i+1][0]))
+          g_options.compressionLevel = std::stoi(argv[++i]);
+      } else if (arg == "-o")
         g_outname = std::string(argv[++i]);
       else
         g_filename = std::move(arg);
@@ -65,93 +64,8 @@ namespace umesh {
     UMesh::SP inMesh = load(g_filename);
     inMesh->print();
 
-    vtkNew<vtkPoints> points;
-
-    vtkDoubleArray *data = vtkDoubleArray::New();
-    data->SetName("data");
-    data->SetNumberOfTuples(inMesh->perVertex->values.size());
-    data->SetNumberOfComponents(1);
-
-    for (size_t i=0;i<inMesh->vertices.size();++i) {
-      double x[3] = {inMesh->vertices[i].x,
-                     inMesh->vertices[i].y,
-                     inMesh->vertices[i].z};
-      points->InsertPoint(i, x);
-      data->InsertComponent(0, i, inMesh->perVertex->values[i]);
-    }
-  
-    vtkNew<vtkUnstructuredGrid> ugrid;
-    ugrid->AllocateExact(inMesh->numVolumeElements(),
-                         inMesh->vertices.size());
-
-    // Tets
-    for (size_t i=0;i<inMesh->tets.size();++i) {
-      vtkIdType pts[8] = {
-        inMesh->tets[i][0],
-        inMesh->tets[i][1],
-        inMesh->tets[i][2],
-        inMesh->tets[i][3],
-        0,0,0,0
-      };
-      ugrid->InsertNextCell(VTK_TETRA, 4, pts);
-    }
-
-    // Pyrs
-    for (size_t i=0;i<inMesh->pyrs.size();++i) {
-      vtkIdType pts[8] = {
-        inMesh->pyrs[i][0],
-        inMesh->pyrs[i][1],
-        inMesh->pyrs[i][2],
-        inMesh->pyrs[i][3],
-        inMesh->pyrs[i][4],
-        0,0,0
-      };
-      ugrid->InsertNextCell(VTK_PYRAMID, 5, pts);
-    }
-
-    // Wedges
-    for (size_t i=0;i<inMesh->wedges.size();++i) {
-      vtkIdType pts[8] = {
-        inMesh->wedges[i][0],
-        inMesh->wedges[i][1],
-        inMesh->wedges[i][2],
-        inMesh->wedges[i][3],
-        inMesh->wedges[i][4],
-        inMesh->wedges[i][5],
-        0,0
-      };
-      ugrid->InsertNextCell(VTK_WEDGE, 6, pts);
-    }
-
-    // Hexes
-    for (size_t i=0;i<inMesh->hexes.size();++i) {
-      vtkIdType pts[8] = {
-        inMesh->hexes[i][0],
-        inMesh->hexes[i][1],
-        inMesh->hexes[i][2],
-        inMesh->hexes[i][3],
-        inMesh->hexes[i][4],
-        inMesh->hexes[i][5],
-        inMesh->hexes[i][6],
-        inMesh->hexes[i][7]
-      };
-      ugrid->InsertNextCell(VTK_HEXAHEDRON, 8, pts);
-    }
-
-    ugrid->SetPoints(points);
-    //ugrid->GetCellData()->SetScalars(data);
-    ugrid->GetPointData()->SetScalars(data);
-
-    vtkNew<vtkUnstructuredGridWriter> xwriter;
-    xwriter->SetInputData(ugrid);
-    xwriter->SetFileName(g_outname.c_str());
-    if (g_ascii)
-      xwriter->SetFileTypeToASCII();
-    else
-      xwriter->SetFileTypeToBinary();
-    xwriter->Write();
-
-
+    std::cout << "writing " << g_outname << std::endl;
+    io::saveVTU(g_outname,*inMesh,g_options);
 
     return 0;
   }
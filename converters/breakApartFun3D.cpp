@@ -20,6 +20,7 @@
 #include "umesh/io/ugrid32.h"
 #include "umesh/io/fun3dScalars.h"
 #include "umesh/RemeshHelper.h"
+#include "umesh/io/UMeshWriter.h"
 
 namespace umesh {
 
@@ -31,6 +32,10 @@ namespace umesh {
   /*! list of ALL time steps in first rank's scalars file */
   std::vector<int>         timeSteps;
   bool extractAll = false;
+  /*! if set (and extracting all), all time steps and variables go
+      into the rank's .umesh file, as (compressed) time-series
+      sections, rather than into separate .floats files */
+  bool timeSeries = false;
 
   std::string variable = "";
   int timeStep = -1;
@@ -110,41 +115,63 @@ namespace umesh {
 #endif
 
     const std::string outFileNameMesh = outFileNameBase + "." + std::to_string(rank) + ".umesh";
-    mesh->saveTo(outFileNameMesh);
+    if (extractAll && timeSeries) {
+      std::cout << "exporting *ALL* time steps and variables as time series to "
+                << outFileNameMesh << std::endl;
+      std::string scalarsFileName
+        = scalarsPath
+        + std::to_string(rank);
+      io::fun3d::ScalarsReader::SP reader
+        = io::fun3d::ScalarsReader::open(scalarsFileName);
+      io::UMeshWriter writer(outFileNameMesh);
+      writer.addMesh(*mesh);
+      for (auto ts : timeSteps) {
+        std::cout << "reading time step " << ts
+                  << " from " << scalarsFileName << std::endl;
+        std::vector<std::vector<float>> allScalars = reader->read(variables,ts);
+        for (size_t varID=0;varID<variables.size();varID++)
+          writer.addTimeStep(variables[varID],ts,allScalars[varID]);
+      }
+      writer.close();
+      std::cout << UMESH_TERMINAL_GREEN 
+                << " -> written to " << outFileNameMesh
+                << UMESH_TERMINAL_DEFAULT << std::endl;
+    } else
+      mesh->saveTo(outFileNameMesh);
 
-    if (extractAll) {
+    if (extractAll && !timeSeries) {
       std::cout << "exporting *ALL* time steps and variables to separate scalar-files" << std::endl;
-    for (auto var : variables) {
+      std::string scalarsFileName
+        = scalarsPath
+        //    + "volume_data."
+        + std::to_string(rank);
+      io::fun3d::ScalarsReader::SP reader
+        = io::fun3d::ScalarsReader::open(scalarsFileName);
       for (auto ts : timeSteps) {
-          
-        std::string scalarsFileName
-          = scalarsPath
-      //    + "volume_data."
-          + std::to_string(rank);
-        char ts_suffix[100];
-        sprintf(ts_suffix,"__ts_%07i",ts);
-        const std::string outFileNameScalars
-          = outFileNameBase + "__var_" + var + ts_suffix + "." + std::to_string(rank) + ".floats";
-        
         std::cout << "reading time step " << ts
                   << " from " << scalarsFileName << std::endl;
-          
-        std::vector<uint64_t> globalVertexIDs;
-        /*! desired time step's scalars for current brick, if provided */
-        std::vector<float> scalars
-          = io::fun3d::readTimeStep(scalarsFileName,var,ts,
-                                    &globalVertexIDs);
-        for (int i=0;i<10;i++)
-          std::cout << scalars[i] << " ";
-        std::cout << std::endl;
-        std::ofstream bin(outFileNameScalars,std::ios::binary);
-        bin.write((const char *)scalars.data(),scalars.size()*sizeof(scalars[0]));
-        std::cout << UMESH_TERMINAL_GREEN 
-                  << " -> written to " << outFileNameScalars
-                  << UMESH_TERMINAL_DEFAULT << std::endl;
+        /*! all variables of this time step, in one pass over the
+            time step's data */
+        std::vector<std::vector<float>> allScalars = reader->read(variables,ts);
+        for (size_t varID=0;varID<variables.size();varID++) {
+          const std::string &var = variables[varID];
+          const std::vector<float> &scalars = allScalars[varID];
+          char ts_suffix[100];
+          sprintf(ts_suffix,"__ts_%07i",ts);
+          const std::string outFileNameScalars
+            = outFileNameBase + "__var_" + var + ts_suffix + "." + std::to_string(rank) + ".floats";
+        
+          for (int i=0;i<std::min(size_t(10),scalars.size());i++)
+            std::cout << scalars[i] << " ";
+          std::cout << std::endl;
+          std::ofstream bin(outFileNameScalars,std::ios::binary);
+          bin.write((const char *)scalars.data(),scalars.size()*sizeof(scalars[0]));
+          std::cout << UMESH_TERMINAL_GREEN 
+                    << " -> written to " << outFileNameScalars
+                    << UMESH_TERMINAL_DEFAULT << std::endl;
+        }
       }
     }
-    }
     std::cout << " >>> done part " << rank << ", got " << mesh->toString(false) << " (note it's OK that bounds aren't set yet)" << std::endl;
     return true;
   }
@@ -163,6 +190,8 @@ namespace umesh {
     std::cout << "-o <outPath>\n\tbase part of filename for all output files" << std::endl;
     std::cout << "-n <numFiles> --first <firstFile>\n\t(optional) which range of files to process\n\te.g., --first 2 -n 3 will process files name.2, name.3, and name.4" << std::endl;
     std::cout << "--scalars scalarBasePath\n\twill read scalars from *_volume.X files at given <scalarBasePath>_volume.X" << std::endl;
+    std::cout << "-all|--extract-all\n\texport all variables and time steps" << std::endl;
+    std::cout << "--time-series\n\t(with -all) store all variables and time steps in the per-rank .umesh files\n\t(compressed, see io::TimeSeriesReader), rather than in separate .floats files" << std::endl;
     std::cout << std::endl;
     std::cout << "Example:" << std::endl;
     std::cout << "./umeshBreakApartFun3D /space/fun3d/small/dAgpu0145_Fa_ --scalars /space/fun3d/small/10000unsteadyiters/dAgpu0145_Fa_volume_data. -o /space/fun3d/merged_lander_small" << std::endl;
@@ -192,6 +221,8 @@ namespace umesh {
         ghosts = true;
       else if (arg == "-all" || arg == "--extract-all")
         extractAll = true;
+      else if (arg == "--time-series")
+        timeSeries = true;
       else if (arg == "-ts" || arg == "--time-step")
         timeStep = atoi(av[++i]);
       else if (arg == "-var" || arg == "--variable")
@@ -133,33 +133,51 @@ namespace umesh {
     for (size_t i=0;i<mesh->vertexTags.size();i++)
       requestedVertices[mesh->vertexTags[i]] = i;
 
+    /* open all ranks' files once, and figure out - once, not per
+       time step - which of each rank's scalars go to which of our
+       vertices */
+    struct Rank {
+      io::fun3d::ScalarsReader::SP reader;
+      /*! .first is index in rank's file, .second is our vertex ID */
+      std::vector<std::pair<size_t,size_t>> scalarToVertex;
+    };
+    std::vector<Rank> ranks;
+    for (int rankID=1;true;rankID++) {
+      std::string scalarsFileName = volumeDataPath // + "volume_data."
+        +std::to_string(rankID);
+      Rank rank;
+      try {
+        rank.reader = io::fun3d::ScalarsReader::open(scalarsFileName);
+      } catch (std::exception e) {
+        break;
+      }
+      std::vector<uint64_t> globalVertexIDs = rank.reader->getGlobalVertexIDs();
+      for (size_t i=0;i<globalVertexIDs.size();i++) {
+        auto it = requestedVertices.find(globalVertexIDs[i]);
+        if (it == requestedVertices.end())
+          // this partitioned umesh doesn't need this vertex...
+          continue;
+        rank.scalarToVertex.push_back({i,it->second});
+      }
+      ranks.push_back(rank);
+    }
+    std::cout << "found " << ranks.size() << " ranks' volume data files" << std::endl;
+
     range1f totalValueRange;
     std::ofstream scalarsFile(outFileName+"."+variable+".scalars",std::ios::binary);
     for (int timeStep : timeSteps) {
       std::cout << "----------- extracting time step " << timeStep << " -----------" << std::endl;
-      for (int rank=1;true;rank++) {
-        std::cout << "[" << rank << "]" << std::flush;
-        std::string scalarsFileName = volumeDataPath // + "volume_data."
-          +std::to_string(rank);
-        // std::cout << "reading time step " << timeStep
-        //           << " from " << scalarsFileName << std::endl;
-        
-        std::vector<uint64_t> globalVertexIDs;
+      for (size_t rankID=0;rankID<ranks.size();rankID++) {
+        std::cout << "[" << (rankID+1) << "]" << std::flush;
+        const Rank &rank = ranks[rankID];
         std::vector<float> scalars;
         try {
-          scalars = io::fun3d::readTimeStep(scalarsFileName,variable,timeStep,
-                                            &globalVertexIDs);
+          scalars = rank.reader->read(variable,timeStep);
         } catch (std::exception e) {
           break;
         }
-        for (int i=0;i<scalars.size();i++) {
-          size_t vertexID = globalVertexIDs[i];
-          if (requestedVertices.find(vertexID) == requestedVertices.end())
-            // this partitioned umesh doesn't need this vertex...
-            continue;
-          size_t ourID = requestedVertices[vertexID];
-          mesh->setScalar(ourID,scalars[i]);
-        }
+        for (auto it : rank.scalarToVertex)
+          mesh->setScalar(it.second,scalars[it.first]);
       }
       std::cout << std::endl;
       mesh->perVertex->finalize();
@@ -20,7 +20,14 @@
 #include "umesh/io/ugrid32.h"
 #include "umesh/io/ugrid64.h"
 #include "umesh/io/fun3dScalars.h"
-#include "umesh/RemeshHelper.h"
+#include "umesh/io/UMeshWriter.h"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
 
 namespace umesh {
 
@@ -48,217 +55,330 @@ namespace umesh {
       isDegen(v.x) || isDegen(v.y) || isDegen(v.z);
   }
 
-  template<typename Prim>
-  inline bool isDegen(UMesh::SP mesh, Prim prim)
+  /*! size of given file in bytes, or 0 if it doesn't exist */
+  size_t fileSize(const std::string &fileName)
   {
-    for (int i=0;i<prim.numVertices;i++)
-      if (prim[i] < 0 || isDegen(mesh->vertices[prim[i]])) return true;
-    return false;
+    std::ifstream in(fileName,std::ios::binary|std::ios::ate);
+    return in.good() ? size_t(in.tellg()) : 0;
   }
+
+  std::string metaFileName(int fileID)
+  { return path + "ta."+std::to_string(fileID); }
+  
+  std::string meshFileName(int fileID)
+  { return path + "sh.lb4."+std::to_string(fileID); }
   
+  std::string scalarsFileName(int fileID)
+  { return scalarsPath // + "volume_data."
+      +std::to_string(fileID); }
+  
+  /*! one part, loaded and with its elements already translated to
+      global vertex IDs, waiting to be merged */
+  struct LoadedPart {
+    typedef std::shared_ptr<LoadedPart> SP;
+
+    int                   fileID;
+    /*! false if there is no such part (the end of the parts) */
+    bool                  exists = false;
+    /*! the part's vertices and scalars, and where they go in the
+        merged mesh */
+    std::vector<vec3f>    vertices;
+    std::vector<float>    scalars;
+    std::vector<uint64_t> globalVertexIDs;
+    size_t                maxGlobalVertexID = 0;
+    /*! the part's owned (non-degenerate) elements, with global vertex
+        IDs */
+    UMesh                 elements;
+    size_t                numDegenVertices = 0;
+    size_t                numDegenPrims    = 0;
+    /*! estimated memory this part takes until it's merged */
+    size_t                memoryEstimate   = 0;
+    /*! error that happened while loading, if any */
+    std::exception_ptr    error;
+  };
+
+  /*! translates the first 'count' of given prims from part-local to
+      global vertex IDs, dropping those with degenerate vertices (and
+      keeping the others' order); runs in parallel */
   template<typename Prim>
-  inline void warnDegen(UMesh::SP mesh, Prim prim)
+  std::vector<Prim> translatePrims(const std::vector<Prim> &prims,
+                                   size_t count,
+                                   LoadedPart &part)
   {
-    static size_t numDegen = 0;
-    numDegen++;
-    std::cout << "  >> degen prim #" << numDegen << std::endl;
-    for (int i=0;i<prim.numVertices;i++)
-      std::cout << "       vtx " << prim[i] << std::flush
-                << " " << mesh->vertices[prim[i]] << std::endl;
-  }
-
-  struct MergedMesh {
+    const int    N         = Prim::numVertices;
+    const size_t blockSize = 16*1024;
+    count = std::min(count,prims.size());
+    const size_t numBlocks = divRoundUp(count,blockSize);
+    auto isGood = [&](const Prim &prim) {
+      for (int i=0;i<N;i++)
+        if (isDegen(part.vertices[prim[i]])) return false;
+      return true;
+    };
+    
+    std::vector<size_t> blockBegin(numBlocks+1,0);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,count);
+        size_t numGood = 0;
+        for (size_t i=begin;i<end;i++)
+          numGood += isGood(prims[i]);
+        blockBegin[blockID] = numGood;
+      });
+    size_t sum = 0;
+    for (auto &begin : blockBegin) {
+      const size_t numGood = begin;
+      begin = sum;
+      sum += numGood;
+    }
 
-    MergedMesh() 
-      : merged(std::make_shared<UMesh>())
-    {}
+    std::vector<Prim> result(sum);
+    std::atomic<bool> tooLarge(false);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,count);
+        size_t out = blockBegin[blockID];
+        for (size_t i=begin;i<end;i++) {
+          if (!isGood(prims[i])) continue;
+          Prim &prim = result[out++];
+          for (int j=0;j<N;j++) {
+            const uint64_t gID = part.globalVertexIDs[prims[i][j]];
+            if (gID >= (1ull<<31))
+              tooLarge = true;
+            prim[j] = int(gID);
+          }
+        }
+      });
+    if (tooLarge)
+      throw std::runtime_error("global vertex ID doesn't fit into 32-bit signed int");
+    part.numDegenPrims += count - sum;
+    return result;
+  }
+  
+  /*! loads given part (its meta file, mesh, and scalars), and
+      translates its elements to global vertex IDs; can run
+      concurrently for different parts */
+  LoadedPart::SP loadPart(int fileID)
+  {
+    LoadedPart::SP part = std::make_shared<LoadedPart>();
+    part->fileID = fileID;
+    struct {
+      int tets, pyrs, wedges, hexes;
+    } meta;
 
-    void loadScalars(UMesh::SP mesh, int fileID,
-                     /*! where each one of the given "volume_data" and
-                       "mesh" files' vertices are supposed to go in
-                       the global, reconstituted file */
-                     std::vector<uint64_t> &globalVertexIDs)
     {
-      if (scalarsPath == "")
-        return;
-      
-      std::string scalarsFileName = scalarsPath // + "volume_data."
-        +std::to_string(fileID);
-      std::cout << "reading time step " << timeStep
-                << " from " << scalarsFileName << std::endl;
+      FILE *metaFile = fopen(metaFileName(fileID).c_str(),"r");
+      if (!metaFile) return part;
+        
+      int rc =
+        fscanf(metaFile,
+               "n_owned_tetrahedra %i\nn_owned_pyramids %i\nn_owned_prisms %i\nn_owned_hexahedra %i\n",
+               &meta.tets,&meta.pyrs,&meta.wedges,&meta.hexes);
+      fclose(metaFile);
+      if (rc != 4)
+        throw std::runtime_error("could not parse "+metaFileName(fileID));
+    }
+    part->exists = true;
 
-      scalars = io::fun3d::readTimeStep(scalarsFileName,variable,timeStep,
-                                        &globalVertexIDs);
+    // apparently the lander we have is in FLOAT vertices
+    UMesh::SP mesh = io::UGrid32Loader::load(io::UGrid32Loader::FLOAT,
+                                             meshFileName(fileID));
+    part->scalars = io::fun3d::readTimeStep(scalarsFileName(fileID),variable,timeStep,
+                                            &part->globalVertexIDs);
+    if (part->globalVertexIDs.size() != mesh->vertices.size() ||
+        part->scalars.size() != mesh->vertices.size())
+      throw std::runtime_error("scalars of part "+std::to_string(fileID)
+                               +" do not match its vertices");
+    part->vertices = std::move(mesh->vertices);
+    for (size_t i=0;i<part->vertices.size();i++) {
+      part->numDegenVertices += isDegen(part->vertices[i]);
+      part->maxGlobalVertexID = std::max(part->maxGlobalVertexID,
+                                         size_t(part->globalVertexIDs[i]));
     }
 
-    bool addPart(int fileID)
+    UMesh &elements = part->elements;
+    elements.triangles = translatePrims(mesh->triangles,mesh->triangles.size(),*part);
+    elements.quads     = translatePrims(mesh->quads,mesh->quads.size(),*part);
+    elements.tets      = translatePrims(mesh->tets,meta.tets,*part);
+    elements.pyrs      = translatePrims(mesh->pyrs,meta.pyrs,*part);
+    elements.wedges    = translatePrims(mesh->wedges,meta.wedges,*part);
+    elements.hexes     = translatePrims(mesh->hexes,meta.hexes,*part);
+    return part;
+  }
+
+  /*! loads parts on multiple threads while the previous parts get
+      merged, and hands them out in order. Parts get started in order,
+      and only while the estimated memory of all parts that are being
+      loaded or waiting to be merged stays within the budget (a part
+      always gets started if nothing else is in flight, so even parts
+      larger than the budget get loaded eventually) */
+  struct PartPipeline {
+    PartPipeline(int firstFileID, int numFiles,
+                 int numLoaders, size_t memoryBudget)
+      : endFileID(firstFileID+numFiles),
+        memoryBudget(memoryBudget),
+        nextToLoad(firstFileID),
+        nextToMerge(firstFileID)
     {
-      std::cout << "----------- part " << fileID << " -----------" << std::endl;
-      std::string metaFileName = path + "ta."+std::to_string(fileID);
-      std::string meshFileName = path + "sh.lb4."+std::to_string(fileID);
-      std::cout << "reading from " << meshFileName << std::endl;
-      std::cout << "     ... and " << metaFileName << std::endl;
-      struct {
-        int tets, pyrs, wedges, hexes;
-      } meta;
+      for (int i=0;i<std::max(numLoaders,1);i++)
+        loaders.push_back(std::thread([this](){ loaderLoop(); }));
+    }
 
+    ~PartPipeline()
+    {
       {
-        FILE *metaFile = fopen(metaFileName.c_str(),"r");
-        if (!metaFile) return false;
-        assert(metaFile);
-        
-        int rc =
-          fscanf(metaFile,
-                 "n_owned_tetrahedra %i\nn_owned_pyramids %i\nn_owned_prisms %i\nn_owned_hexahedra %i\n",
-                 &meta.tets,&meta.pyrs,&meta.wedges,&meta.hexes);
-        assert(rc == 4);
-        fclose(metaFile);
-      }
-
-      // apparently the lander we have is in FLOAT vertices
-      UMesh::SP mesh = io::UGrid32Loader::load(io::UGrid32Loader::FLOAT,
-                                               meshFileName);
-      std::cout << "loaded part mesh " << mesh->toString() << " " << mesh->getBounds() << std::endl;
-      for (auto vtx : mesh->vertices)
-        if (isDegen(vtx)) std::cout << " > DEGEN VERTEX " << vtx << std::endl;
-
-      
-      loadScalars(mesh,fileID,globalVertexIDs);
-
-      size_t requiredVertexArraySize = merged->vertices.size();
-      for (auto globalID : globalVertexIDs)
-        requiredVertexArraySize = std::max(requiredVertexArraySize,size_t(globalID)+1);
-      if (!merged->perVertex) {
-        merged->perVertex = std::make_shared<Attribute>();
-        merged->perVertex->name = variable;
-      }
-      
-      merged->perVertex->values.resize(requiredVertexArraySize);
-      merged->vertices.resize(requiredVertexArraySize);
-      for (int i=0;i<mesh->vertices.size();i++) {
-        merged->vertices[globalVertexIDs[i]] = mesh->vertices[i];
-        merged->perVertex->values[globalVertexIDs[i]] = scalars[i];
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
       }
+      changed.notify_all();
+      for (auto &loader : loaders)
+        loader.join();
+    }
 
-      if (verbose)
-        std::cout << "merging in " << prettyNumber(mesh->triangles.size()) << " triangles" << std::endl;
-      for (int i=0;i<mesh->triangles.size();i++) {
-        auto in = mesh->triangles[i];
-        if (!(i % 100000)) { std::cout << "." << std::flush; };
-        UMesh::Triangle out;
-        translate((uint32_t*)&out,(const uint32_t*)&in,3,mesh->vertices,fileID);
-        if (isDegen(merged,out)) {
-          warnDegen(merged,out);
-          continue;
-        }
-        merged->triangles.push_back(out);
+    /*! returns the next part (in fileID order), or nullptr once the
+        range of parts or the first missing one has been reached;
+        rethrows any error that happened while loading that part */
+    LoadedPart::SP next()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock,[&](){
+          return nextToMerge >= endFileID || loaded.count(nextToMerge);
+        });
+      if (nextToMerge >= endFileID)
+        return {};
+      LoadedPart::SP part = loaded[nextToMerge];
+      loaded.erase(nextToMerge);
+      if (part->error)
+        std::rethrow_exception(part->error);
+      if (!part->exists) {
+        nextToMerge = endFileID;
+        return {};
       }
-      if (!mesh->triangles.empty()) 
-        std::cout << std::endl;
+      nextToMerge++;
+      return part;
+    }
 
-      if (verbose)
-        std::cout << "merging in " << prettyNumber(mesh->quads.size()) << " quads" << std::endl;
-      for (int i=0;i<mesh->quads.size();i++) {
-        auto in = mesh->quads[i];
-        if (!(i % 100000)) { std::cout << "." << std::flush; };
-        UMesh::Quad out;
-        translate((uint32_t*)&out,(const uint32_t*)&in,4,mesh->vertices,fileID);
-        if (isDegen(merged,out)) {
-          warnDegen(merged,out);
-          continue;
-        }
-        merged->quads.push_back(out);
+    /*! to be called once the part returned by next() has been merged,
+        to release its memory budget */
+    void merged(const LoadedPart &part)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight -= part.memoryEstimate;
       }
-      if (!mesh->quads.empty()) 
-        std::cout << std::endl;
-
+      changed.notify_all();
+    }
 
-      // for (auto in : mesh->tets) {
-      if (verbose)
-        std::cout << "merging in " << prettyNumber(meta.tets) << " out of " << prettyNumber(mesh->tets.size()) << " tets" << std::endl;
-      for (int i=0;i<meta.tets;i++) {
-        auto in = mesh->tets[i];
-        if (!(i % 100000)) { std::cout << "." << std::flush; };
-        UMesh::Tet out;
-        translate((uint32_t*)&out,(const uint32_t*)&in,4,mesh->vertices,fileID);
-        if (isDegen(merged,out)) {
-          warnDegen(merged,out);
-          continue;
+  private:
+    /*! memory a part will (roughly) take until it's merged: about
+        twice its mesh file, for the elements as loaded and as
+        translated (its vertices, scalars, and global IDs take about
+        as much as its elements) */
+    static size_t estimateMemory(int fileID)
+    {
+      return 2*fileSize(meshFileName(fileID));
+    }
+    
+    void loaderLoop()
+    {
+      while (true) {
+        int    fileID;
+        size_t estimate;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          while (true) {
+            if (stop || nextToLoad >= endFileID) return;
+            estimate = estimateMemory(nextToLoad);
+            if (inFlight == 0 || inFlight+estimate <= memoryBudget) break;
+            changed.wait(lock);
+          }
+          fileID = nextToLoad++;
+          inFlight += estimate;
         }
-        merged->tets.push_back(out);
-      }
-      std::cout << std::endl;
 
-      if (verbose)
-        std::cout << "merging in " << prettyNumber(meta.pyrs) << " out of " << prettyNumber(mesh->pyrs.size()) << " pyrs" << std::endl;
-      for (int i=0;i<meta.pyrs;i++) {
-        auto in = mesh->pyrs[i];
-        UMesh::Pyr out;
-        translate((uint32_t*)&out,(const uint32_t*)&in,5,mesh->vertices,fileID);
-        if (isDegen(merged,out)) {
-          warnDegen(merged,out);
-          continue;
+        LoadedPart::SP part;
+        try {
+          part = loadPart(fileID);
+        } catch (...) {
+          part = std::make_shared<LoadedPart>();
+          part->fileID = fileID;
+          part->error  = std::current_exception();
         }
-        merged->pyrs.push_back(out);
-      }
-      
-      if (verbose)
-        std::cout << "merging in " << prettyNumber(meta.wedges) << " out of " << prettyNumber(mesh->wedges.size()) << " wedges" << std::endl;
-      for (int i=0;i<meta.wedges;i++) {
-        auto in = mesh->wedges[i];
-        UMesh::Wedge out;
-        translate((uint32_t*)&out,(const uint32_t*)&in,6,mesh->vertices,fileID);
-        if (isDegen(merged,out)) {
-          warnDegen(merged,out);
-          continue;
+        part->memoryEstimate = estimate;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          loaded[fileID] = part;
+          // parts after a missing (or broken) one are not needed
+          if (!part->exists || part->error) stop = true;
         }
-        merged->wedges.push_back(out);
+        changed.notify_all();
       }
-
-      if (verbose)
-        std::cout << "merging in " << prettyNumber(meta.hexes)
-                  << " out of " << prettyNumber(mesh->hexes.size())
-                  << " hexes" << std::endl;
-      for (int i=0;i<meta.hexes;i++) {
-        auto in = mesh->hexes[i];
-        UMesh::Hex out;
-        translate((uint32_t*)&out,(const uint32_t*)&in,8,mesh->vertices,fileID);
-        if (isDegen(merged,out)) {
-          warnDegen(merged,out);
-          continue;
-        }
-        merged->hexes.push_back(out);
-      }
-
-      merged->finalize();
-      std::cout << " >>> done part " << fileID << ", got\n" << merged->toString(false) << " (note it's OK that bounds aren't set yet)" << std::endl;
-      return true;
     }
     
-    uint32_t translate(uint32_t in,
-                       const std::vector<vec3f> &vertices,
-                       int fileID)
+    const int                    endFileID;
+    const size_t                 memoryBudget;
+    std::mutex                   mutex;
+    std::condition_variable      changed;
+    int                          nextToLoad;
+    int                          nextToMerge;
+    size_t                       inFlight = 0;
+    bool                         stop     = false;
+    std::map<int,LoadedPart::SP> loaded;
+    std::vector<std::thread>     loaders;
+  };
+  
+  /*! merges all parts into one mesh; since the parts' vertices get
+      scattered to their global IDs the merged vertices (and scalars)
+      have to stay in memory, but each part's elements get streamed
+      to the output file as soon as that part is merged */
+  struct MergedMesh {
+
+    MergedMesh(const std::string &outFileName) 
+      : merged(std::make_shared<UMesh>()),
+        writer(io::UMeshWriter::create(outFileName))
     {
-      size_t gID = globalVertexIDs[in];
-      if (gID >= (1ull<<31))
-        throw std::runtime_error("global vertex ID doesn't fit into 32-bit signed int");
-      return (uint32_t)gID;
+      merged->perVertex = std::make_shared<Attribute>();
+      merged->perVertex->name = variable;
     }
-    
-    void translate(uint32_t *out,
-                   const uint32_t *in,
-                   int N,
-                   const std::vector<vec3f> &vertices,
-                   int fileID)
+
+    void addPart(const LoadedPart &part)
     {
-      for (int i=0;i<N;i++)
-        out[i] = translate(in[i],vertices,fileID);
+      std::cout << "----------- part " << part.fileID << " -----------" << std::endl;
+      if (part.numDegenVertices)
+        std::cout << " > " << prettyNumber(part.numDegenVertices)
+                  << " degenerate vertices" << std::endl;
+      if (part.numDegenPrims)
+        std::cout << " > dropped " << prettyNumber(part.numDegenPrims)
+                  << " elements with degenerate vertices" << std::endl;
+      
+      const size_t requiredVertexArraySize
+        = std::max(merged->vertices.size(),part.maxGlobalVertexID+1);
+      merged->perVertex->values.resize(requiredVertexArraySize);
+      merged->vertices.resize(requiredVertexArraySize);
+      parallel_for_blocked
+        (0,part.vertices.size(),16*1024,
+         [&](size_t begin, size_t end){
+           for (size_t i=begin;i<end;i++) {
+             merged->vertices[part.globalVertexIDs[i]] = part.vertices[i];
+             merged->perVertex->values[part.globalVertexIDs[i]] = part.scalars[i];
+           }
+         });
+
+      const UMesh &elements = part.elements;
+      writer->addTriangles(elements.triangles);
+      writer->addQuads(elements.quads);
+      writer->addTets(elements.tets);
+      writer->addPyrs(elements.pyrs);
+      writer->addWedges(elements.wedges);
+      writer->addHexes(elements.hexes);
+      std::cout << " >>> done part " << part.fileID << ", got\n" << elements.toString(false)
+                << " (written), for a total of " << prettyNumber(merged->vertices.size())
+                << " merged vertices so far" << std::endl;
     }
     
+    /*! merged vertices and scalars only - the elements go straight
+        to the writer */
     UMesh::SP merged;
-    std::vector<uint64_t> globalVertexIDs;
-    /*! desired time step's scalars for current brick, if provided */
-    std::vector<float> scalars;
+    io::UMeshWriter::SP writer;
   };
 
   void usage(const std::string &error = "")
@@ -272,6 +392,8 @@ namespace umesh {
     std::cout << "--scalars scalarBasePath\n\twill read scalars from *_volume.X files at given <scalarBasePath>_volume.X" << std::endl;
     std::cout << "-ts <timeStep>" << std::endl;
     std::cout << "-var|--variable <variableName>" << std::endl;
+    std::cout << "-j|--parallel-parts <N>\n\tnumber of parts to load concurrently (default: 4)" << std::endl;
+    std::cout << "--memory-budget <GB>\n\tmemory that parts which are loaded but not yet merged may take (default: 8)" << std::endl;
     std::cout << std::endl;
     std::cout << "Example:" << std::endl;
     std::cout << "./umeshImportLanderFun3D /space/fun3d/small/dAgpu0145_Fa_ --scalars /space/fun3d/small/10000unsteadyiters/dAgpu0145_Fa_volume_data. -o /space/fun3d/merged_lander_small.umesh" << std::endl;
@@ -283,6 +405,8 @@ namespace umesh {
   {
     int begin = 1;
     int num = 10000;
+    int numLoaders = 4;
+    double memoryBudgetGB = 8.;
 
     std::string outFileName = "";//"huge-lander.umesh";
     for (int i=1;i<ac;i++) {
@@ -299,6 +423,10 @@ namespace umesh {
         timeStep = atoi(av[++i]);
       else if (arg == "-var" || arg == "--variable")
         variable = av[++i];
+      else if (arg == "-j" || arg == "--parallel-parts")
+        numLoaders = std::max(1,atoi(av[++i]));
+      else if (arg == "--memory-budget")
+        memoryBudgetGB = atof(av[++i]);
       // else if (arg == "-surf" || arg == "--surface-mesh")
       //   surfMeshName = av[++i];
       else if (arg == "-o")
@@ -326,18 +454,28 @@ namespace umesh {
       exit(0);
     }
     
-    MergedMesh mesh;
-    
-    for (int i=begin;i<(begin+num);i++)
-      if (!mesh.addPart(i))
-        break;
-
-    mesh.merged->finalize();
+    try {
+      MergedMesh mesh(outFileName);
+      {
+        PartPipeline parts(begin,num,numLoaders,size_t(memoryBudgetGB*(1ull<<30)));
+        while (LoadedPart::SP part = parts.next()) {
+          mesh.addPart(*part);
+          parts.merged(*part);
+        }
+      }
 
-    std::cout << "done all parts, saving output to "
-              << outFileName << std::endl;
-    mesh.merged->saveTo(outFileName);
-    std::cout << "done all ..." << std::endl;
+      std::cout << "done all parts, saving vertices to "
+                << outFileName << std::endl;
+      mesh.writer->addVertices(mesh.merged->vertices);
+      if (mesh.merged->perVertex)
+        mesh.writer->addVertexAttribute(mesh.merged->perVertex->name,
+                                        mesh.merged->perVertex->values);
+      mesh.writer->close();
+      std::cout << "done all ..." << std::endl;
+    } catch (std::exception &e) {
+      std::cerr << "fatal error " << e.what() << std::endl;
+      exit(1);
+    }
   }
   
 } // ::umesh
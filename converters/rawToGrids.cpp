@@ -19,6 +19,7 @@
 
 #include "umesh/RemeshHelper.h"
 #include <fstream>
+#include <limits>
 
 #ifndef PRINT
 # define PRINT(var) std::cout << #var << "=" << var << std::endl;
@@ -37,7 +38,13 @@ namespace umesh {
       std::cout << "Fatal error: " << error << "\n\n";
     
     std::cout << "Usage: ./umeshRawToGrids -d dimsX dimsY dimsZ -f float|uint8"
-      " -o outFileName.umesh inFileName.raw" << std::endl;
+      " -o outFileName.umesh inFileName.raw [args]" << std::endl;
+    std::cout << "w/ Args: " << std::endl;
+    std::cout << "--brick-size <n>\n\tnumber of vertices per dimension of each brick (default 8)" << std::endl;
+    std::cout << "--max-brick-size <n>\n\tstart with bricks this large, and only split them (octree-style)\n"
+              << "\tdown to --brick-size where they are neither constant nor empty" << std::endl;
+    std::cout << "--constant <eps>\n\tstore bricks whose values differ by at most eps as a single cell" << std::endl;
+    std::cout << "--empty <lo> <hi>\n\tdrop bricks whose values all are in [lo,hi] (or NaN)" << std::endl;
     
     exit(!error.empty());
   }
@@ -46,11 +53,121 @@ namespace umesh {
   vec3i dims(0);
   std::string outFileName = "rawToGrids.umesh";
   std::string inputFormat = "float";
+  /*! number of vertices (ie, cells+1) per dimension of each brick */
   int brickSize = 8;
+  /*! if larger than brickSize, bricks start out (about) this large,
+      and get split octree-style - along brickSize boundaries, so the
+      smallest bricks are the same as without this - only where they
+      are neither constant nor empty */
+  int maxBrickSize = 0;
+  /*! if >= 0, bricks whose values differ by at most this much get
+      stored as a single cell (ie, eight scalars), no matter how many
+      cells they have */
+  float constantEpsilon = -1.f;
+  /*! if not empty, bricks whose values all are in this range (or are
+      NaN) are empty space, and get dropped */
+  range1f emptyRange;
 
   inline float toScalar(float f) { return f; }
   inline float toScalar(uint8_t ui) { return ui/255.f; }
 
+  /*! the grids (and their scalars) created for one top-level brick */
+  struct Bricks {
+    std::vector<UMesh::Grid> grids;
+    std::vector<float>       scalars;
+    size_t numConstant = 0;
+    size_t numEmpty    = 0;
+  };
+
+  /*! the input volume's scalars, with 'dims' vertices */
+  std::vector<float> scalars;
+
+  inline float scalarAt(int ix, int iy, int iz)
+  { return scalars[ix+dims.x*(iy+(size_t)dims.y*(iz))]; }
+  
+  /*! appends a grid for the brick with given (inclusive) range of
+      vertices, with all of its scalars */
+  void addGrid(Bricks &bricks, const vec3i &lower, const vec3i &upper,
+               const range1f &r)
+  {
+    UMesh::Grid g;
+    g.domain.lower = vec4f(lower.x,lower.y,lower.z,r.lower);
+    g.domain.upper = vec4f(upper.x,upper.y,upper.z,r.upper);
+    g.numCells = upper-lower;
+    g.scalarsOffset = (int)bricks.scalars.size();
+    for (int iiz=lower.z;iiz<=upper.z;iiz++)
+      for (int iiy=lower.y;iiy<=upper.y;iiy++)
+        for (int iix=lower.x;iix<=upper.x;iix++)
+          bricks.scalars.push_back(scalarAt(iix,iiy,iiz));
+    bricks.grids.push_back(g);
+  }
+
+  /*! creates the bricks for the given (inclusive) range of vertices:
+      drops it if it's empty, stores it as a single cell if it's
+      constant, and otherwise either creates a grid for it or - if
+      it's larger than brickSize - splits it, and recurses */
+  void makeBricks(Bricks &bricks, const vec3i &lower, const vec3i &upper)
+  {
+    range1f r;
+    bool hasNaN = false;
+    for (int iiz=lower.z;iiz<=upper.z;iiz++)
+      for (int iiy=lower.y;iiy<=upper.y;iiy++)
+        for (int iix=lower.x;iix<=upper.x;iix++) {
+          float scalar = scalarAt(iix,iiy,iiz);
+          if (isnan(scalar))
+            hasNaN = true;
+          else
+            r.extend(scalar);
+        }
+
+    if (!emptyRange.empty() &&
+        (r.empty() || (r.lower >= emptyRange.lower && r.upper <= emptyRange.upper))) {
+      bricks.numEmpty++;
+      return;
+    }
+    if (constantEpsilon >= 0.f && !hasNaN && r.upper-r.lower <= constantEpsilon) {
+      // a brick's outer vertices are shared with its neighbors, so
+      // with an epsilon of 0 this is exactly the same field
+      UMesh::Grid g;
+      g.domain.lower = vec4f(lower.x,lower.y,lower.z,r.lower);
+      g.domain.upper = vec4f(upper.x,upper.y,upper.z,r.upper);
+      g.numCells = vec3i(1);
+      g.scalarsOffset = (int)bricks.scalars.size();
+      for (int i=0;i<8;i++)
+        bricks.scalars.push_back(.5f*(r.lower+r.upper));
+      bricks.grids.push_back(g);
+      bricks.numConstant++;
+      return;
+    }
+
+    const int brickCells = brickSize-1;
+    const vec3i numCells = upper-lower;
+    if (numCells.x <= brickCells && numCells.y <= brickCells && numCells.z <= brickCells) {
+      addGrid(bricks,lower,upper,r);
+      return;
+    }
+    // split every dimension that's larger than one brick in two,
+    // along a brick boundary
+    vec3i mid = upper;
+    for (int dim=0;dim<3;dim++)
+      if (numCells[dim] > brickCells)
+        mid[dim] = lower[dim]+brickCells*(divRoundUp(numCells[dim],brickCells)/2);
+    for (int iz=0;iz<2;iz++)
+      for (int iy=0;iy<2;iy++)
+        for (int ix=0;ix<2;ix++) {
+          const vec3i childLower(ix ? mid.x : lower.x,
+                                 iy ? mid.y : lower.y,
+                                 iz ? mid.z : lower.z);
+          const vec3i childUpper(ix ? upper.x : mid.x,
+                                 iy ? upper.y : mid.y,
+                                 iz ? upper.z : mid.z);
+          if (childLower.x < childUpper.x &&
+              childLower.y < childUpper.y &&
+              childLower.z < childUpper.z)
+            makeBricks(bricks,childLower,childUpper);
+        }
+  }
+  
   template<typename T>
   void rawToGrids()
   {
@@ -59,43 +176,54 @@ namespace umesh {
 
     mesh->perVertex = std::make_shared<Attribute>(0);
     
-    std::vector<float> scalars(dims.x*(size_t)dims.y*dims.z);
+    scalars.resize(dims.x*(size_t)dims.y*dims.z);
     std::vector<T> inputs(dims.x*(size_t)dims.y*dims.z);
     in.read((char*)inputs.data(),inputs.size()*sizeof(inputs[0]));
-    for (int64_t i=0;i<inputs.size();i++)
-      scalars[i] = toScalar(inputs[i]);
-
-    for (int iz=0;iz<dims.z-1;iz+=(brickSize-1)) 
-      for (int iy=0;iy<dims.y-1;iy+=(brickSize-1)) 
-        for (int ix=0;ix<dims.x-1;ix+=(brickSize-1)) {
-          UMesh::Grid g;
-          int ex = std::min(ix + (brickSize-1),dims.x-1);
-          int ey = std::min(iy + (brickSize-1),dims.y-1);
-          int ez = std::min(iz + (brickSize-1),dims.z-1);
-          g.domain.lower.x = ix;
-          g.domain.lower.y = iy;
-          g.domain.lower.z = iz;
-          g.domain.upper.x = ex;
-          g.domain.upper.y = ey;
-          g.domain.upper.z = ez;
-          g.numCells.x = (ex-ix);
-          g.numCells.y = (ey-iy);
-          g.numCells.z = (ez-iz);
-          g.scalarsOffset = mesh->gridScalars.size();
-
-          range1f r;
-          for (int iiz=iz;iiz<=ez;iiz++)
-            for (int iiy=iy;iiy<=ey;iiy++)
-              for (int iix=ix;iix<=ex;iix++) {
-                float scalar = scalars[iix+dims.x*(iiy+(size_t)dims.y*(iiz))];
-                mesh->gridScalars.push_back(scalar);
-                if (!isnan(scalar))
-                  r.extend(scalar);
-              }
-          g.domain.lower.w = r.lower;
-          g.domain.upper.w = r.upper;
-          mesh->grids.push_back(g);
+    parallel_for_blocked(0,inputs.size(),64*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          scalars[i] = toScalar(inputs[i]);
+      });
+    inputs = std::vector<T>();
+
+    // the top-level bricks, each of which gets processed by its own
+    // task
+    const int brickCells = brickSize-1;
+    const int topCells
+      = brickCells*std::max(1,divRoundUp(maxBrickSize-1,brickCells));
+    std::vector<std::pair<vec3i,vec3i>> topBricks;
+    for (int iz=0;iz<dims.z-1;iz+=topCells) 
+      for (int iy=0;iy<dims.y-1;iy+=topCells) 
+        for (int ix=0;ix<dims.x-1;ix+=topCells) {
+          const vec3i lower(ix,iy,iz);
+          const vec3i upper(std::min(ix+topCells,dims.x-1),
+                            std::min(iy+topCells,dims.y-1),
+                            std::min(iz+topCells,dims.z-1));
+          topBricks.push_back({lower,upper});
         }
+    std::vector<Bricks> bricks(topBricks.size());
+    parallel_for(topBricks.size(),[&](size_t brickID){
+        makeBricks(bricks[brickID],topBricks[brickID].first,topBricks[brickID].second);
+      });
+
+    size_t numConstant = 0, numEmpty = 0;
+    for (auto &brick : bricks) {
+      const size_t offset = mesh->gridScalars.size();
+      if (offset+brick.scalars.size() > size_t(std::numeric_limits<int>::max()))
+        throw std::runtime_error("too many grid scalars for 32-bit scalar offsets");
+      for (auto g : brick.grids) {
+        g.scalarsOffset += (int)offset;
+        mesh->grids.push_back(g);
+      }
+      mesh->gridScalars.insert(mesh->gridScalars.end(),
+                               brick.scalars.begin(),brick.scalars.end());
+      numConstant += brick.numConstant;
+      numEmpty    += brick.numEmpty;
+      brick = Bricks();
+    }
+    std::cout << "created " << prettyNumber(mesh->grids.size()) << " grids ("
+              << prettyNumber(numConstant) << " of them constant), with "
+              << prettyNumber(mesh->gridScalars.size()) << " scalars; dropped "
+              << prettyNumber(numEmpty) << " empty bricks" << std::endl;
     mesh->finalize();
     mesh->saveTo(outFileName);
   }
@@ -114,7 +242,16 @@ int main(int ac, const char **av)
       outFileName = av[++i];
     else if (arg == "-f" || arg == "-if" || arg == "--format")
       inputFormat = av[++i];
-    else if (arg == "-d" || arg == "-dims" || arg == "--dims") {
+    else if (arg == "--brick-size")
+      brickSize = std::stoi(av[++i]);
+    else if (arg == "--max-brick-size")
+      maxBrickSize = std::stoi(av[++i]);
+    else if (arg == "--constant")
+      constantEpsilon = std::stof(av[++i]);
+    else if (arg == "--empty") {
+      emptyRange.lower = std::stof(av[++i]);
+      emptyRange.upper = std::stof(av[++i]);
+    } else if (arg == "-d" || arg == "-dims" || arg == "--dims") {
       dims.x = std::stoi(av[++i]);
       dims.y = std::stoi(av[++i]);
       dims.z = std::stoi(av[++i]);
@@ -127,6 +264,8 @@ int main(int ac, const char **av)
     usage("no output file specified");
   if (dims.x <= 0)
     usage("no input volume dims specified");
+  if (brickSize < 2)
+    usage("brick size has to be at least 2");
       
   if (inputFormat == "float")
     rawToGrids<float>();
@@ -36,6 +36,10 @@ echo ./umeshPartitionSpatially $out/all.umesh -lt 10000 -pro -o $out/all-lt10k.s
 for nparts in 4 8 ; do
     echo mkdir $out/parts-$nparts
     echo ./umeshPartitionSpatially $out/all.umesh -n $nparts -o $out/parts-$nparts/general
+    # (if all.umesh is too big for any single node, use the MPI
+    # partitioner - object-space, so bricks' bounds may overlap -
+    # instead:)
+    # echo mpirun -np $nparts ./umeshPartitionMPI $out/all.umesh -n $nparts -o $out/parts-$nparts/general
 
     # ... then for each part:
     for f in `ls $out/parts-$nparts/general*umesh`; do
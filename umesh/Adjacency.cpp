@@ -0,0 +1,293 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/Adjacency.h"
+#include "umesh/io/IO.h"
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/forEachElement.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+
+namespace umesh {
+
+  /*! block size for all parallel loops */
+  const size_t adjacencyBlockSize = 16*1024;
+
+  /*! turns given per-item counts (plus one trailing dummy entry) into
+      exclusive prefix sums, so the trailing entry ends up with the
+      total. Each block of items first sums up its own counts, which
+      then get scanned sequentially, and then each block scans its
+      items starting at its block's offset */
+  void exclusiveScan(std::vector<uint32_t> &values, const char *what)
+  {
+    const size_t numItems  = values.size();
+    const size_t numBlocks = divRoundUp(numItems,adjacencyBlockSize);
+    std::vector<size_t> blockBegin(numBlocks+1,0);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*adjacencyBlockSize;
+        const size_t end   = std::min(begin+adjacencyBlockSize,numItems);
+        size_t sum = 0;
+        for (size_t i=begin;i<end;i++)
+          sum += values[i];
+        blockBegin[blockID+1] = sum;
+      });
+    for (size_t blockID=0;blockID<numBlocks;blockID++)
+      blockBegin[blockID+1] += blockBegin[blockID];
+    if (blockBegin[numBlocks] > std::numeric_limits<uint32_t>::max())
+      throw std::runtime_error(std::string("#umesh.Adjacency: too many ")+what
+                               +" for 32-bit offsets");
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*adjacencyBlockSize;
+        const size_t end   = std::min(begin+adjacencyBlockSize,numItems);
+        size_t sum = blockBegin[blockID];
+        for (size_t i=begin;i<end;i++) {
+          const size_t count = values[i];
+          values[i] = (uint32_t)sum;
+          sum += count;
+        }
+      });
+  }
+
+  /*! array of per-list counters, all starting at zero */
+  struct Counters {
+    Counters(size_t numLists)
+      : numLists(numLists), count(new std::atomic<uint32_t>[numLists])
+    {
+      parallel_for_blocked
+        (0,numLists,adjacencyBlockSize,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++) count[i] = 0;
+         });
+    }
+    inline void increment(size_t listID) { count[listID]++; }
+    /*! the counts, plus one trailing dummy entry, for buildCSR() */
+    std::vector<uint32_t> get() const
+    {
+      std::vector<uint32_t> result(numLists+1,0);
+      parallel_for_blocked
+        (0,numLists,adjacencyBlockSize,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++) result[i] = count[i];
+         });
+      return result;
+    }
+    const size_t numLists;
+    std::unique_ptr<std::atomic<uint32_t>[]> count;
+  };
+
+  /*! the second half of a (two-pass) CSR build: given each list's
+      size in 'begin' (plus a trailing dummy entry), computes the lists'
+      offsets, and then has 'fill' emit each list's entries (in
+      parallel, through 'cursor'); each list then gets sorted */
+  template<typename FillLambda>
+  void buildCSR(std::vector<uint32_t> &begin,
+                std::vector<uint32_t> &items,
+                const FillLambda &fill,
+                const char *what)
+  {
+    exclusiveScan(begin,what);
+    const size_t numLists = begin.size()-1;
+    items.resize(begin[numLists]);
+    std::unique_ptr<std::atomic<uint32_t>[]>
+      cursor(new std::atomic<uint32_t>[numLists]);
+    parallel_for_blocked
+      (0,numLists,adjacencyBlockSize,
+       [&](size_t blockBegin, size_t blockEnd) {
+         for (size_t i=blockBegin;i<blockEnd;i++)
+           cursor[i] = begin[i];
+       });
+    fill([&](size_t listID, uint32_t item) {
+        items[cursor[listID]++] = item;
+      });
+    parallel_for_blocked
+      (0,numLists,adjacencyBlockSize,
+       [&](size_t blockBegin, size_t blockEnd) {
+         for (size_t i=blockBegin;i<blockEnd;i++)
+           std::sort(items.begin()+begin[i],items.begin()+begin[i+1]);
+       });
+  }
+
+  /*! calls 'lambda(elementID,vertexID)' for each distinct vertex of
+      each volume element - in parallel */
+  template<typename Lambda>
+  void forEachElementVertex(const UMesh &mesh,
+                            const uint32_t typeBegin[5],
+                            const Lambda &lambda)
+  {
+    parallelForEachElement
+      (mesh,[&](const auto &prim, UMesh::PrimType type, size_t primID){
+          const uint32_t elementID = uint32_t(typeBegin[type-UMesh::TET]+primID);
+          for (int j=0;j<numVerticesOf(prim);j++) {
+            // degenerate elements may use the same vertex more
+            // than once; only list them once for that vertex
+            bool seen = false;
+            for (int k=0;k<j;k++)
+              seen |= (prim[k] == prim[j]);
+            if (!seen)
+              lambda(elementID,prim[j]);
+          }
+        },VOLUME_ELEMENTS,adjacencyBlockSize);
+  }
+
+  Adjacency::SP Adjacency::compute(UMesh::SP mesh, FaceConn::Method method)
+  {
+    FaceConn::SP faceConn = FaceConn::compute(mesh,method);
+    return compute(mesh,*faceConn);
+  }
+
+  Adjacency::SP Adjacency::compute(UMesh::SP mesh, const FaceConn &faceConn)
+  {
+    Adjacency::SP adj = std::make_shared<Adjacency>();
+    const size_t numElements
+      = mesh->tets.size()+mesh->pyrs.size()+mesh->wedges.size()+mesh->hexes.size();
+    if (numElements >= std::numeric_limits<uint32_t>::max())
+      throw std::runtime_error("#umesh.Adjacency: too many elements for 32-bit element IDs");
+    adj->typeBegin[0] = 0;
+    adj->typeBegin[1] = adj->typeBegin[0]+(uint32_t)mesh->tets.size();
+    adj->typeBegin[2] = adj->typeBegin[1]+(uint32_t)mesh->pyrs.size();
+    adj->typeBegin[3] = adj->typeBegin[2]+(uint32_t)mesh->wedges.size();
+    adj->typeBegin[4] = adj->typeBegin[3]+(uint32_t)mesh->hexes.size();
+
+    // ------------------------------------------------------------------
+    // vertex -> elements
+    // ------------------------------------------------------------------
+    const size_t numVertices = mesh->vertices.size();
+    {
+      Counters counters(numVertices);
+      forEachElementVertex(*mesh,adj->typeBegin,[&](uint32_t, int vertexID){
+          counters.increment(vertexID);
+        });
+      adj->vertexElementsBegin = counters.get();
+    }
+    buildCSR(adj->vertexElementsBegin,adj->vertexElements,
+             [&](const auto &emit) {
+               forEachElementVertex(*mesh,adj->typeBegin,
+                                    [&](uint32_t elementID, int vertexID){
+                                      emit(vertexID,elementID);
+                                    });
+             },"vertex-to-element entries");
+
+    // ------------------------------------------------------------------
+    // element -> elements, through the faces. Faces (in particular
+    // those from FaceConn::HASH) are in no particular order, so
+    // counting and filling per element would be nothing but cache
+    // misses; instead, we radix-sort all (element,neighbor) pairs,
+    // which leaves each element's neighbors in one (already sorted)
+    // run
+    // ------------------------------------------------------------------
+    const std::vector<FaceConn::SharedFace> &faces = faceConn.faces;
+    auto elementOf = [&](const FaceConn::PrimFacetRef &side) {
+      return uint64_t(adj->typeBegin[side.primType-UMesh::TET]+(uint32_t)side.primIdx);
+    };
+    auto isInner = [](const FaceConn::SharedFace &face) {
+      return !(face.onFront.primIdx < 0 || face.onBack.primIdx < 0);
+    };
+    const size_t numFaceBlocks = divRoundUp(faces.size(),adjacencyBlockSize);
+    std::vector<uint32_t> blockBegin(numFaceBlocks+1,0);
+    parallel_for(numFaceBlocks,[&](size_t blockID){
+        const size_t begin = blockID*adjacencyBlockSize;
+        const size_t end   = std::min(begin+adjacencyBlockSize,faces.size());
+        uint32_t count = 0;
+        for (size_t i=begin;i<end;i++)
+          if (isInner(faces[i])) count += 2;
+        blockBegin[blockID] = count;
+      });
+    exclusiveScan(blockBegin,"element neighbors");
+    std::vector<uint64_t> pairs(blockBegin[numFaceBlocks]);
+    parallel_for(numFaceBlocks,[&](size_t blockID){
+        const size_t begin = blockID*adjacencyBlockSize;
+        const size_t end   = std::min(begin+adjacencyBlockSize,faces.size());
+        size_t out = blockBegin[blockID];
+        for (size_t i=begin;i<end;i++) {
+          const FaceConn::SharedFace &face = faces[i];
+          if (!isInner(face)) continue;
+          const uint64_t front = elementOf(face.onFront);
+          const uint64_t back  = elementOf(face.onBack);
+          pairs[out++] = (front << 32) | back;
+          pairs[out++] = (back  << 32) | front;
+        }
+      });
+    parallel_radix_sort(pairs,[](uint64_t pair) { return pair; });
+
+    adj->elementNeighbors.resize(pairs.size());
+    parallel_for_blocked
+      (0,pairs.size(),adjacencyBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           adj->elementNeighbors[i] = uint32_t(pairs[i]);
+       });
+    adj->elementNeighborsBegin.resize(numElements+1);
+    parallel_for_blocked
+      (0,numElements+1,adjacencyBlockSize,
+       [&](size_t begin, size_t end) {
+         size_t i = std::lower_bound(pairs.begin(),pairs.end(),uint64_t(begin) << 32)
+           - pairs.begin();
+         for (size_t elementID=begin;elementID<end;elementID++) {
+           while (i < pairs.size() && (pairs[i] >> 32) < elementID) ++i;
+           adj->elementNeighborsBegin[elementID] = (uint32_t)i;
+         }
+       });
+    return adj;
+  }
+
+  UMesh::PrimRef Adjacency::toPrimRef(uint32_t elementID) const
+  {
+    for (int t=0;t<4;t++)
+      if (elementID < typeBegin[t+1])
+        return UMesh::PrimRef(UMesh::PrimType(UMesh::TET+t),elementID-typeBegin[t]);
+    throw std::runtime_error("#umesh.Adjacency: invalid element ID "
+                             +std::to_string(elementID));
+  }
+
+  /*! write - binary - to given file */
+  void Adjacency::write(std::ostream &out) const
+  {
+    io::writeArray(out,typeBegin,5);
+    io::writeVector(out,vertexElementsBegin);
+    io::writeVector(out,vertexElements);
+    io::writeVector(out,elementNeighborsBegin);
+    io::writeVector(out,elementNeighbors);
+  }
+  
+  /*! read from given file, assuming file format as used by saveTo() */
+  void Adjacency::read(std::istream &in)
+  {
+    io::readArray(in,typeBegin,5);
+    io::readVector(in,vertexElementsBegin);
+    io::readVector(in,vertexElements);
+    io::readVector(in,elementNeighborsBegin);
+    io::readVector(in,elementNeighbors);
+  }
+
+  /*! write - binary - to given file */
+  void Adjacency::saveTo(const std::string &fileName) const
+  {
+    std::ofstream out(fileName,std::ios::binary);
+    write(out);
+  }
+
+  /*! read from given file, assuming file format as used by saveTo() */
+  Adjacency::SP Adjacency::loadFrom(const std::string &fileName)
+  {
+    Adjacency::SP adj = std::make_shared<Adjacency>();
+    std::ifstream in(fileName,std::ios::binary);
+    adj->read(in);
+    return adj;
+  }
+  
+} // ::umesh
@@ -0,0 +1,112 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/FaceConn.h"
+
+namespace umesh {
+
+  /*! compact (CSR) vertex-to-element and element-to-element
+      adjacency of a mesh's volume elements (tets, pyramids, wedges,
+      and hexes; grids are not included). Elements are referred to by
+      a single 32-bit 'element ID', which numbers all tets first,
+      then all pyramids, wedges, and hexes (ie, the same order as
+      UMesh::createVolumePrimRefs(), minus the grids); toPrimRef()
+      and toElementID() convert between the two.
+
+      Two elements are neighbors if they share a face, as per the
+      mesh's FaceConn; so this has the same requirements on the mesh
+      as FaceConn::compute(). Each element's (and vertex's) list is
+      sorted by element ID, which makes the result deterministic no
+      matter how many threads build it. */
+  struct Adjacency {
+    typedef std::shared_ptr<Adjacency> SP;
+
+    /*! a range of element IDs in one of the CSR arrays */
+    struct Range {
+      inline const uint32_t *begin() const { return _begin; }
+      inline const uint32_t *end()   const { return _end; }
+      inline size_t size()  const { return _end-_begin; }
+      inline bool   empty() const { return _end == _begin; }
+      inline uint32_t operator[](size_t i) const { return _begin[i]; }
+      const uint32_t *_begin, *_end;
+    };
+
+    /*! computes both adjacencies of given mesh, with its face
+        connectivity computed by given method */
+    static Adjacency::SP compute(UMesh::SP mesh,
+                                 FaceConn::Method method = FaceConn::SORT);
+    /*! same, for a mesh whose face connectivity is already known */
+    static Adjacency::SP compute(UMesh::SP mesh, const FaceConn &faceConn);
+
+    /*! write - binary - to given file */
+    void saveTo(const std::string &fileName) const;
+    
+    /*! read from given file, assuming file format as used by saveTo() */
+    static Adjacency::SP loadFrom(const std::string &fileName);
+    
+    /*! write - binary - to given file */
+    void write(std::ostream &out) const;
+    
+    /*! read from given file, assuming file format as used by saveTo() */
+    void read(std::istream &in);
+
+    inline size_t numVertices() const
+    { return vertexElementsBegin.empty() ? 0 : vertexElementsBegin.size()-1; }
+    inline size_t numElements() const
+    { return elementNeighborsBegin.empty() ? 0 : elementNeighborsBegin.size()-1; }
+
+    /*! the elements using given vertex */
+    inline Range elementsOf(size_t vertexID) const
+    {
+      assert(vertexID < numVertices());
+      return { vertexElements.data()+vertexElementsBegin[vertexID],
+               vertexElements.data()+vertexElementsBegin[vertexID+1] };
+    }
+    /*! the elements sharing a face with given element */
+    inline Range neighborsOf(uint32_t elementID) const
+    {
+      assert(elementID < numElements());
+      return { elementNeighbors.data()+elementNeighborsBegin[elementID],
+               elementNeighbors.data()+elementNeighborsBegin[elementID+1] };
+    }
+
+    /*! the element ID of given (volume, non-grid) prim */
+    inline uint32_t toElementID(const UMesh::PrimRef &pr) const
+    {
+      assert(pr.type >= UMesh::TET && pr.type <= UMesh::HEX);
+      return typeBegin[pr.type-UMesh::TET]+(uint32_t)pr.ID;
+    }
+    /*! the prim that has given element ID */
+    UMesh::PrimRef toPrimRef(uint32_t elementID) const;
+
+    /*! for tets, pyramids, wedges, and hexes, the ID of the first
+        element of that type; plus the total number of elements */
+    uint32_t typeBegin[5] = { 0,0,0,0,0 };
+    
+    /*! for each vertex, where its elements begin in
+        'vertexElements'; plus one final entry with the total */
+    std::vector<uint32_t> vertexElementsBegin;
+    std::vector<uint32_t> vertexElements;
+    /*! for each element, where its neighbors begin in
+        'elementNeighbors'; plus one final entry with the total */
+    std::vector<uint32_t> elementNeighborsBegin;
+    std::vector<uint32_t> elementNeighbors;
+  };
+
+} // ::umesh
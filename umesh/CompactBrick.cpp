@@ -0,0 +1,193 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "umesh/CompactBrick.h"
+#include "umesh/forEachElement.h"
+#include "umesh/parallel_for.h"
+#include <atomic>
+#include <cfloat>
+#include <mutex>
+#include <sstream>
+
+namespace umesh {
+
+  /*! block size for the parallel loops over vertices and indices */
+  const size_t compactBlockSize = 64*1024;
+
+  /*! bounds of given vertices; throws if any of them is not finite */
+  box3f computeVertexBounds(const std::vector<vec3f> &vertices)
+  {
+    std::mutex mutex;
+    box3f bounds;
+    std::atomic<bool> nonFinite(false);
+    parallel_for_blocked
+      (0,vertices.size(),compactBlockSize,
+       [&](size_t begin, size_t end) {
+         box3f blockBounds;
+         for (size_t i=begin;i<end;i++) {
+           const vec3f v = vertices[i];
+           if (!std::isfinite(v.x) || !std::isfinite(v.y) || !std::isfinite(v.z))
+             nonFinite = true;
+           blockBounds.extend(v);
+         }
+         std::lock_guard<std::mutex> lock(mutex);
+         bounds.extend(blockBounds);
+       });
+    if (nonFinite)
+      throw std::runtime_error("#umesh.CompactBrick: cannot quantize non-finite vertices");
+    if (bounds.empty()) bounds = box3f(vec3f(0.f),vec3f(0.f));
+    return bounds;
+  }
+
+  CompactBrick CompactBrick::encode(const UMesh &mesh, float maxError)
+  {
+    CompactBrick result;
+    const box3f bounds = computeVertexBounds(mesh.vertices);
+    for (int axis=0;axis<3;axis++) {
+      range1f range;
+      range.lower = bounds.lower[axis];
+      range.upper = bounds.upper[axis];
+      result.setQuantization(axis,range);
+    }
+    if (maxError > 0.f && result.maxError() > maxError)
+    {
+      std::stringstream ss;
+      ss << "#umesh.CompactBrick: cannot quantize vertices to " << bits
+         << " bits with a max error of " << maxError
+         << " (would need " << result.maxError() << ")";
+      throw std::runtime_error(ss.str());
+    }
+
+    const size_t numVertices = mesh.vertices.size();
+    for (int axis=0;axis<3;axis++) {
+      const float lower   = result.range[axis].lower;
+      const float rcpStep
+        = result.step[axis] > 0.f ? 1.f/result.step[axis] : 0.f;
+      std::vector<uint16_t> &codes = result.codes[axis];
+      codes.resize(numVertices);
+      parallel_for_blocked
+        (0,numVertices,compactBlockSize,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++) {
+             const float code = roundf((mesh.vertices[i][axis]-lower)*rcpStep);
+             codes[i] = uint16_t(std::min(std::max(code,0.f),float(maxCode)));
+           }
+         });
+    }
+
+    if (numVertices > maxVerticesFor16BitIndices)
+      return result;
+    
+    result.hasIndices16 = true;
+    std::atomic<bool> invalid(false);
+    forEachElementType(mesh,[&](const auto &prims, UMesh::PrimType type){
+        typedef typename std::decay<decltype(prims)>::type::value_type Prim;
+        static_assert(sizeof(Prim) == Prim::numVertices*sizeof(int),
+                      "prims are expected to be plain arrays of int indices");
+        const int *in = (const int *)prims.data();
+        const size_t numIndices = prims.size()*Prim::numVertices;
+        std::vector<uint16_t> &out = result.indices[type];
+        out.resize(numIndices);
+        parallel_for_blocked
+          (0,numIndices,compactBlockSize,
+           [&](size_t begin, size_t end) {
+             bool blockInvalid = false;
+             for (size_t i=begin;i<end;i++) {
+               const int idx = in[i];
+               blockInvalid |= (idx < 0 || size_t(idx) >= numVertices);
+               out[i] = uint16_t(idx);
+             }
+             if (blockInvalid) invalid = true;
+           });
+      });
+    if (invalid)
+      throw std::runtime_error("#umesh.CompactBrick: mesh has invalid vertex indices");
+    return result;
+  }
+
+  void CompactBrick::decodeInto(UMesh &mesh) const
+  {
+    decodeVertices(mesh.vertices);
+    decodeElements(mesh);
+  }
+  
+  void CompactBrick::decodeVertices(std::vector<vec3f> &vertices) const
+  {
+    const size_t numVertices = codes[0].size();
+    if (codes[1].size() != numVertices || codes[2].size() != numVertices)
+      throw std::runtime_error("#umesh.CompactBrick: different numbers of codes per axis");
+    vertices.resize(numVertices);
+    parallel_for_blocked
+      (0,numVertices,compactBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           vertices[i] = vertex(i);
+       });
+  }
+  
+  void CompactBrick::decodeElements(UMesh &mesh) const
+  {
+    if (!hasIndices16) return;
+    // check first, so 'mesh' remains unchanged if that fails
+    forEachElementType(mesh,[&](const auto &prims, UMesh::PrimType type){
+        typedef typename std::decay<decltype(prims)>::type::value_type Prim;
+        if (indices[type].size() % Prim::numVertices)
+          throw std::runtime_error("#umesh.CompactBrick: number of indices "
+                                   "is not a multiple of the prim's vertex count");
+      });
+    forEachElementType(mesh,[&](auto &prims, UMesh::PrimType type){
+        typedef typename std::decay<decltype(prims)>::type::value_type Prim;
+        const std::vector<uint16_t> &in = indices[type];
+        prims.resize(in.size()/Prim::numVertices);
+        int *out = (int *)prims.data();
+        parallel_for_blocked
+          (0,in.size(),compactBlockSize,
+           [&](size_t begin, size_t end) {
+             for (size_t i=begin;i<end;i++)
+               out[i] = int(in[i]);
+           });
+      });
+  }
+  
+  void CompactBrick::setQuantization(int axis, const range1f &range)
+  {
+    this->range[axis] = range;
+    step[axis] = (range.upper-range.lower)/float(maxCode);
+  }
+  
+  float CompactBrick::maxError() const
+  {
+    float result = 0.f;
+    for (int axis=0;axis<3;axis++) {
+      const float magnitude
+        = std::max(fabsf(range[axis].lower),fabsf(range[axis].upper));
+      result = std::max(result,.5f*step[axis] + 4.f*FLT_EPSILON*magnitude);
+    }
+    return result;
+  }
+  
+  size_t CompactBrick::numBytes() const
+  {
+    size_t numBytes = 0;
+    for (auto &axisCodes : codes)
+      numBytes += axisCodes.size()*sizeof(uint16_t);
+    for (auto &typeIndices : indices)
+      numBytes += typeIndices.size()*sizeof(uint16_t);
+    return numBytes;
+  }
+  
+} // ::umesh
@@ -0,0 +1,109 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! a compact encoding of the geometry of a (small, brick-local)
+      mesh - its vertex positions and its elements' vertex indices;
+      attributes and grids are not part of this, and stay as they are
+      in the UMesh:
+
+      - each vertex coordinate gets quantized to a 16-bit code
+        relative to the range of that axis' coordinates over all
+        vertices, code 'k' standing for 'range[axis].lower+k*step'.
+        For the small boxes that the partitioners' bricks span that
+        is precise to within maxError(); note that a vertex that is
+        shared by neighboring bricks gets quantized relative to each
+        brick's own box, so its copies can differ by up to both
+        bricks' maxError()s;
+
+      - if the mesh has at most 64K vertices, each element's indices
+        get stored as 16-bit values (otherwise the indices stay
+        full-width ints, in the UMesh).
+
+      For a typical tet brick that halves the memory (and bandwidth)
+      that its vertices and elements need. Written to .umesh files
+      with UMesh::saveTo(fileName,compactBrick), as
+      QUANTIZED_VERTICES and INDICES_16 sections (see
+      io/Container.h). UMesh::loadFrom() decodes those on load, while
+      io::MappedUMesh exposes them as they are - eg, for uploading
+      them to a GPU, and decoding vertices with vertex() there */
+  struct CompactBrick {
+    /*! number of bits per quantized coordinate */
+    static const int      bits    = 16;
+    static const uint32_t maxCode = (1u << bits)-1;
+    /*! meshes with up to this many vertices get 16-bit indices */
+    static const size_t   maxVerticesFor16BitIndices = size_t(1) << 16;
+    
+    /*! encodes given mesh's vertices and elements; if 'maxError' is
+        > 0, throws if maxError() of the result would be larger than
+        that. Also throws if the mesh has any invalid (negative or
+        too large) vertex indices */
+    static CompactBrick encode(const UMesh &mesh, float maxError = 0.f);
+
+    /*! replaces given mesh's vertices - and, if this has 16-bit
+        indices, also its surface and volume elements - with the
+        decoded ones. Does not finalize() the mesh */
+    void decodeInto(UMesh &mesh) const;
+    /*! the decoded vertices (into 'vertices', which gets resized) ... */
+    void decodeVertices(std::vector<vec3f> &vertices) const;
+    /*! ... and elements, which replace given mesh's surface and volume
+        elements; does nothing if this does not have 16-bit indices */
+    void decodeElements(UMesh &mesh) const;
+    
+    /*! sets the range of given axis' codes, and with that the step
+        between codes; does not change any codes */
+    void setQuantization(int axis, const range1f &range);
+    
+    inline size_t numVertices() const { return codes[0].size(); }
+    
+    /*! decoded position of vertex 'i' */
+    inline vec3f vertex(size_t i) const
+    {
+      return vec3f(range[0].lower+float(codes[0][i])*step.x,
+                   range[1].lower+float(codes[1][i])*step.y,
+                   range[2].lower+float(codes[2][i])*step.z);
+    }
+
+    /*! upper bound for the difference between any original
+        coordinate and its decoded value - half a step (of the
+        widest axis), plus some slack for the rounding in vertex() */
+    float maxError() const;
+    
+    /*! number of bytes used for the codes and indices */
+    size_t numBytes() const;
+    
+    /*! per axis: the range of coordinates that codes 0..maxCode span */
+    range1f               range[3];
+    vec3f                 step { 0.f, 0.f, 0.f };
+    /*! per axis: one code per vertex */
+    std::vector<uint16_t> codes[3];
+    /*! whether this has 16-bit indices for all of the mesh's
+        elements, in 'indices' */
+    bool                  hasIndices16 = false;
+    /*! per element type (UMesh::TRI to UMesh::HEX): the 16-bit
+        vertex indices of all elements of that type, in order - ie,
+        numVertices indices for the first element, then for the
+        second, etc */
+    std::vector<uint16_t> indices[UMesh::HEX+1];
+  };
+  
+} // ::umesh
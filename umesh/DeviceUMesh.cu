@@ -0,0 +1,366 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* device-resident copies of meshes. Like all code built on
+   deviceHelpers.h this also compiles as plain C++, with "device"
+   memory in host memory */
+
+#include "umesh/DeviceUMesh.h"
+#include "umesh/deviceHelpers.h"
+#include "umesh/io/Container.h"
+#include "umesh/io/Compression.h"
+#include "umesh/io/ParallelIO.h"
+#include "umesh/profile.h"
+#include <cmath>
+#include <map>
+
+namespace umesh {
+  namespace {
+
+    /*! bounds (or, for scalars, a range in 'lower[0]' and
+        'upper[0]') of one group of items */
+    struct PartialBounds {
+      float lower[3], upper[3];
+    };
+
+    /*! number of items that each thread reduces; the per-group
+        results are few enough to be combined on the host */
+    const size_t reduceGroupSize = 256;
+
+    struct ReduceVertices {
+      const vec3f   *vertices;
+      size_t         numVertices;
+      PartialBounds *partials;
+      inline __umesh_gpu_device__ void operator()(size_t groupID) const
+      {
+        PartialBounds b;
+        for (int k=0;k<3;k++) { b.lower[k] = INFINITY; b.upper[k] = -INFINITY; }
+        const size_t begin = groupID*reduceGroupSize;
+        const size_t end   = begin+reduceGroupSize < numVertices
+          ? begin+reduceGroupSize : numVertices;
+        for (size_t i=begin;i<end;i++) {
+          const float *v = (const float *)&vertices[i];
+          for (int k=0;k<3;k++) {
+            b.lower[k] = fminf(b.lower[k],v[k]);
+            b.upper[k] = fmaxf(b.upper[k],v[k]);
+          }
+        }
+        partials[groupID] = b;
+      }
+    };
+
+    struct ReduceScalars {
+      const float   *scalars;
+      size_t         numScalars;
+      PartialBounds *partials;
+      inline __umesh_gpu_device__ void operator()(size_t groupID) const
+      {
+        PartialBounds b;
+        b.lower[0] = INFINITY; b.upper[0] = -INFINITY;
+        const size_t begin = groupID*reduceGroupSize;
+        const size_t end   = begin+reduceGroupSize < numScalars
+          ? begin+reduceGroupSize : numScalars;
+        // fminf/fmaxf ignore NaNs
+        for (size_t i=begin;i<end;i++) {
+          b.lower[0] = fminf(b.lower[0],scalars[i]);
+          b.upper[0] = fmaxf(b.upper[0],scalars[i]);
+        }
+        partials[groupID] = b;
+      }
+    };
+
+    /*! runs given reduction kernel over 'numItems' items, and
+        returns the per-group partial results */
+    template<typename Kernel>
+    std::vector<PartialBounds> reduce(size_t numItems, Kernel kernel)
+    {
+      const size_t numGroups = divRoundUp(numItems,reduceGroupSize);
+      DeviceArray<PartialBounds> partials;
+      partials.resize(numGroups);
+      kernel.partials = partials.ptr;
+      launch(numGroups,kernel);
+      std::vector<PartialBounds> result(numGroups);
+      if (numGroups) partials.download(result.data(),0,numGroups);
+      return result;
+    }
+    
+  } // ::umesh::<anonymous>
+
+  size_t DeviceUMesh::stagingChunkSize = 64*1024*1024;
+  
+  struct DeviceUMesh::Impl {
+    DeviceArray<vec3f>    vertices;
+    DeviceArray<float>    scalars;
+    DeviceArray<Triangle> triangles;
+    DeviceArray<Quad>     quads;
+    DeviceArray<Tet>      tets;
+    DeviceArray<Pyr>      pyrs;
+    DeviceArray<Wedge>    wedges;
+    DeviceArray<Hex>      hexes;
+    DeviceUMeshView       view;
+  };
+
+  DeviceUMesh::DeviceUMesh()
+    : impl(new Impl)
+  {}
+
+  DeviceUMesh::~DeviceUMesh()
+  {}
+
+  DeviceUMeshView DeviceUMesh::view() const
+  {
+    return impl->view;
+  }
+
+  bool DeviceUMesh::hasVolumeElements() const
+  {
+    const DeviceUMeshView &v = impl->view;
+    return v.numTets || v.numPyrs || v.numWedges || v.numHexes;
+  }
+  
+  /*! (re-)sets the view's pointers to the arrays, once all have been
+      allocated */
+  void updateView(DeviceUMesh::Impl &impl)
+  {
+    DeviceUMeshView &view = impl.view;
+    view.vertices  = view.numVertices  ? impl.vertices.ptr  : nullptr;
+    view.triangles = view.numTriangles ? impl.triangles.ptr : nullptr;
+    view.quads     = view.numQuads     ? impl.quads.ptr     : nullptr;
+    view.tets      = view.numTets      ? impl.tets.ptr      : nullptr;
+    view.pyrs      = view.numPyrs      ? impl.pyrs.ptr      : nullptr;
+    view.wedges    = view.numWedges    ? impl.wedges.ptr    : nullptr;
+    view.hexes     = view.numHexes     ? impl.hexes.ptr     : nullptr;
+    view.scalars   = impl.scalars.capacity ? impl.scalars.ptr : nullptr;
+  }
+  
+  DeviceUMesh::SP DeviceUMesh::upload(const UMesh &mesh)
+  {
+    return upload(MeshView(mesh));
+  }
+
+  DeviceUMesh::SP DeviceUMesh::upload(const MeshView &mesh)
+  {
+    if (!mesh.grids.empty())
+      throw std::runtime_error("#umesh: DeviceUMesh does not support grids");
+    profile::ScopedTimer timer("DeviceUMesh.upload",0,
+                               mesh.numVolumeElements()+mesh.triangles.size()+mesh.quads.size());
+    DeviceUMesh::SP device = std::make_shared<DeviceUMesh>();
+    Impl &impl = *device->impl;
+    impl.vertices.upload(mesh.vertices.data(),mesh.vertices.size());
+    if (!mesh.scalars.empty())
+      impl.scalars.upload(mesh.scalars.data(),mesh.scalars.size());
+    impl.triangles.upload(mesh.triangles.data(),mesh.triangles.size());
+    impl.quads.upload(mesh.quads.data(),mesh.quads.size());
+    impl.tets.upload(mesh.tets.data(),mesh.tets.size());
+    impl.pyrs.upload(mesh.pyrs.data(),mesh.pyrs.size());
+    impl.wedges.upload(mesh.wedges.data(),mesh.wedges.size());
+    impl.hexes.upload(mesh.hexes.data(),mesh.hexes.size());
+    impl.view.numVertices  = mesh.vertices.size();
+    impl.view.numTriangles = mesh.triangles.size();
+    impl.view.numQuads     = mesh.quads.size();
+    impl.view.numTets      = mesh.tets.size();
+    impl.view.numPyrs      = mesh.pyrs.size();
+    impl.view.numWedges    = mesh.wedges.size();
+    impl.view.numHexes     = mesh.hexes.size();
+    updateView(impl);
+    device->bounds = mesh.bounds;
+    return device;
+  }
+
+  DeviceUMesh::SP DeviceUMesh::load(const std::string &fileName,
+                                    const std::string &scalars)
+  {
+    using namespace io::container;
+    if (stagingChunkSize == 0 || stagingChunkSize % checksumBlockSize)
+      throw std::runtime_error("#umesh: DeviceUMesh::stagingChunkSize has to be a"
+                               " multiple of the checksum block size");
+    io::PositionalFile::SP file = io::PositionalFile::openForReading(fileName);
+    profile::ScopedTimer timer("DeviceUMesh.load",file->size());
+    Header header;
+    if (file->size() < sizeof(header))
+      throw std::runtime_error("#umesh: '"+fileName+"' is not a umesh container");
+    file->read(0,&header,sizeof(header));
+    if (!isContainer(header.magic) || header.version != io::container::version)
+      throw std::runtime_error("#umesh: DeviceUMesh::load() only supports (version-2)"
+                               " umesh containers; '"+fileName+"' is not one");
+    std::vector<Section> sections(header.numSections);
+    file->read(header.tocOffset,sections.data(),sections.size()*sizeof(Section));
+    if (checksum(sections.data(),sections.size()*sizeof(Section)) != header.tocChecksum)
+      throw std::runtime_error("#umesh.io: checksum mismatch in container TOC");
+
+    // the attribute that becomes the scalars; UMesh::loadFrom()
+    // makes the first one the perVertex
+    std::string scalarsName = scalars;
+    bool haveScalars = false;
+    for (auto &section : sections)
+      if (section.type == VERTEX_ATTRIBUTE && !haveScalars &&
+          (scalars.empty() || section.getName() == scalars)) {
+        scalarsName = section.getName();
+        haveScalars = true;
+      }
+    if (!scalars.empty() && !haveScalars)
+      throw std::runtime_error("#umesh: '"+fileName+"' has no vertex attribute '"
+                               +scalars+"'");
+
+    // ------------------------------------------------------------------
+    // find the sections we need, and the (device) array each goes to
+    // ------------------------------------------------------------------
+    DeviceUMesh::SP device = std::make_shared<DeviceUMesh>();
+    Impl &impl = *device->impl;
+    DeviceUMeshView &view = impl.view;
+    struct Target {
+      const Section *section;
+      /*! the array's element size, and the number of elements in it
+          before this section */
+      size_t         elementSize;
+      size_t         begin;
+      uint8_t      **array;
+    };
+    std::vector<Target> targets;
+    size_t numScalars = 0;
+    uint8_t *arrays[8] = { nullptr };
+    for (auto &section : sections) {
+      size_t *count = nullptr;
+      size_t elementSize = 0;
+      int arrayID = -1;
+      switch (section.type) {
+      case VERTICES:  arrayID = 0; count = &view.numVertices;  elementSize = sizeof(vec3f); break;
+      case TRIANGLES: arrayID = 1; count = &view.numTriangles; elementSize = sizeof(Triangle); break;
+      case QUADS:     arrayID = 2; count = &view.numQuads;     elementSize = sizeof(Quad); break;
+      case TETS:      arrayID = 3; count = &view.numTets;      elementSize = sizeof(Tet); break;
+      case PYRS:      arrayID = 4; count = &view.numPyrs;      elementSize = sizeof(Pyr); break;
+      case WEDGES:    arrayID = 5; count = &view.numWedges;    elementSize = sizeof(Wedge); break;
+      case HEXES:     arrayID = 6; count = &view.numHexes;     elementSize = sizeof(Hex); break;
+      case VERTEX_ATTRIBUTE:
+        if (!haveScalars || section.getName() != scalarsName) continue;
+        arrayID = 7; count = &numScalars; elementSize = sizeof(float);
+        break;
+      case GRIDS:
+        if (section.count)
+          throw std::runtime_error("#umesh: DeviceUMesh does not support grids");
+        continue;
+      default:
+        continue;
+      }
+      if (!section.compression && section.numBytes != section.count*elementSize)
+        throw std::runtime_error("#umesh.io: section '"+toString(section.type)
+                                 +"' has wrong element size");
+      targets.push_back({&section,elementSize,*count,&arrays[arrayID]});
+      *count += section.count;
+    }
+    impl.vertices.resize(view.numVertices);
+    impl.triangles.resize(view.numTriangles);
+    impl.quads.resize(view.numQuads);
+    impl.tets.resize(view.numTets);
+    impl.pyrs.resize(view.numPyrs);
+    impl.wedges.resize(view.numWedges);
+    impl.hexes.resize(view.numHexes);
+    impl.scalars.resize(numScalars);
+    arrays[0] = (uint8_t *)impl.vertices.ptr;
+    arrays[1] = (uint8_t *)impl.triangles.ptr;
+    arrays[2] = (uint8_t *)impl.quads.ptr;
+    arrays[3] = (uint8_t *)impl.tets.ptr;
+    arrays[4] = (uint8_t *)impl.pyrs.ptr;
+    arrays[5] = (uint8_t *)impl.wedges.ptr;
+    arrays[6] = (uint8_t *)impl.hexes.ptr;
+    arrays[7] = (uint8_t *)impl.scalars.ptr;
+    if (haveScalars && numScalars != view.numVertices)
+      throw std::runtime_error("#umesh: scalars '"+scalarsName+"' in '"+fileName
+                               +"' do not have one value per vertex");
+    updateView(impl);
+    
+    // ------------------------------------------------------------------
+    // stream all sections through the staging buffers: while one
+    // chunk gets uploaded, the next one gets read into the other
+    // buffer
+    // ------------------------------------------------------------------
+    DeviceStream stream;
+    PinnedBuffer staging0(stagingChunkSize), staging1(stagingChunkSize);
+    PinnedBuffer *staging[2] = { &staging0, &staging1 };
+    DeviceEvent uploaded[2];
+    int next = 0;
+    /*! uploads 'numBytes' bytes to 'dst' through the staging buffers,
+        with 'fill(offset,size,buffer)' producing each chunk's data */
+    auto stream_through = [&](uint8_t *dst, size_t numBytes, const auto &fill){
+      for (size_t offset=0;offset<numBytes;offset+=stagingChunkSize) {
+        const size_t size = std::min(stagingChunkSize,numBytes-offset);
+        PinnedBuffer &buffer = *staging[next];
+        uploaded[next].sync();
+        fill(offset,size,buffer.ptr);
+        uploadAsync(dst+offset,buffer.ptr,size,stream);
+        uploaded[next].record(stream);
+        next = 1-next;
+      }
+    };
+    for (auto &target : targets) {
+      const Section &section = *target.section;
+      uint8_t *dst = *target.array + target.begin*target.elementSize;
+      if (!section.compression) {
+        IncrementalChecksum checksum;
+        stream_through(dst,section.numBytes,[&](size_t offset, size_t size, void *buffer){
+            io::parallelRead(*file,{{section.offset+offset,buffer,size}});
+            checksum.add(buffer,size);
+          });
+        if (checksum.finish() != section.checksum)
+          throw std::runtime_error("#umesh.io: checksum mismatch in section '"
+                                   +toString(section.type)+"'");
+        continue;
+      }
+      std::vector<uint8_t> compressed(section.numBytes);
+      file->read(section.offset,compressed.data(),compressed.size());
+      if (io::container::checksum(compressed.data(),compressed.size()) != section.checksum)
+        throw std::runtime_error("#umesh.io: checksum mismatch in section '"
+                                 +toString(section.type)+"'");
+      std::vector<uint8_t> raw(section.count*target.elementSize);
+      io::compression::decompress(compressed.data(),compressed.size(),
+                                  raw.data(),raw.size());
+      stream_through(dst,raw.size(),[&](size_t offset, size_t size, void *buffer){
+          memcpy(buffer,raw.data()+offset,size);
+        });
+      // the staging buffers may still be reading from 'raw'
+      stream.sync();
+    }
+    stream.sync();
+    device->bounds = header.bounds;
+    return device;
+  }
+
+  box3f DeviceUMesh::computeBounds() const
+  {
+    const DeviceUMeshView &v = impl->view;
+    box3f bounds;
+    for (auto &partial : reduce(v.numVertices,ReduceVertices{v.vertices,v.numVertices}))
+      if (partial.lower[0] <= partial.upper[0]) {
+        bounds.extend(vec3f(partial.lower[0],partial.lower[1],partial.lower[2]));
+        bounds.extend(vec3f(partial.upper[0],partial.upper[1],partial.upper[2]));
+      }
+    return bounds;
+  }
+  
+  range1f DeviceUMesh::computeScalarRange() const
+  {
+    const DeviceUMeshView &v = impl->view;
+    range1f range;
+    if (!v.scalars) return range;
+    for (auto &partial : reduce(v.numVertices,ReduceScalars{v.scalars,v.numVertices}))
+      if (partial.lower[0] <= partial.upper[0]) {
+        range.extend(partial.lower[0]);
+        range.extend(partial.upper[0]);
+      }
+    return range;
+  }
+  
+} // ::umesh
@@ -0,0 +1,106 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/MeshView.h"
+
+#if UMESH_HAVE_CUDA
+namespace umesh {
+
+  /*! raw device pointers to a DeviceUMesh's arrays, and their sizes;
+      trivially copyable, so it can be passed to kernels by value */
+  struct DeviceUMeshView {
+    const vec3f    *vertices  = nullptr;
+    /*! one per vertex, or null if the mesh has no scalars */
+    const float    *scalars   = nullptr;
+    const Triangle *triangles = nullptr;
+    const Quad     *quads     = nullptr;
+    const Tet      *tets      = nullptr;
+    const Pyr      *pyrs      = nullptr;
+    const Wedge    *wedges    = nullptr;
+    const Hex      *hexes     = nullptr;
+    size_t numVertices  = 0;
+    size_t numTriangles = 0;
+    size_t numQuads     = 0;
+    size_t numTets      = 0;
+    size_t numPyrs      = 0;
+    size_t numWedges    = 0;
+    size_t numHexes     = 0;
+  };
+  
+  /*! a copy of a mesh's vertices, per-vertex scalars, and
+      (non-grid) element arrays in device memory, for device-side
+      algorithms - FaceConn::compute(const DeviceUMesh &),
+      DeviceIsoSurfaceExtractor, computeBounds() - to work on without
+      each of them uploading (and holding) its own copy.
+
+      load() reads a .umesh file straight to the device without ever
+      having the whole mesh in host memory: each section gets read in
+      chunks (of stagingChunkSize bytes) into one of two pinned
+      staging buffers, and each chunk's upload runs asynchronously
+      while the next chunk is being read, so the upload mostly hides
+      behind the file I/O. */
+  struct DeviceUMesh {
+    typedef std::shared_ptr<DeviceUMesh> SP;
+
+    /*! size of the chunks that load() reads and uploads sections in;
+        has to be a multiple of io::container::checksumBlockSize */
+    static size_t stagingChunkSize;
+
+    /*! uploads given mesh's vertices, perVertex scalars (if any), and
+        elements; throws if it has grids */
+    static DeviceUMesh::SP upload(const UMesh &mesh);
+    /*! same, for (the arrays of) given view */
+    static DeviceUMesh::SP upload(const MeshView &mesh);
+
+    /*! loads a (version-2) .umesh file directly to the device (see
+        above); 'scalars' names the vertex attribute that becomes the
+        scalars, with an empty name selecting the one that would
+        become 'perVertex' in UMesh::loadFrom(). Compressed sections
+        get decompressed on the host, and then uploaded the same way.
+        Throws for older file formats, and for files with grids */
+    static DeviceUMesh::SP load(const std::string &fileName,
+                                const std::string &scalars = "");
+
+    DeviceUMesh();
+    DeviceUMesh(const DeviceUMesh &) = delete;
+    ~DeviceUMesh();
+
+    /*! device pointers to all arrays */
+    DeviceUMeshView view() const;
+
+    /*! whether there are any tets, pyramids, wedges, or hexes */
+    bool hasVolumeElements() const;
+    
+    /*! bounds of all vertices, computed on the device */
+    box3f computeBounds() const;
+    /*! range of the (non-NaN) scalars, computed on the device; empty
+        if there are none */
+    range1f computeScalarRange() const;
+
+    /*! bounds as stored with the mesh (in UMesh::bounds, or in the
+        file's header) */
+    box3f bounds;
+    
+    struct Impl;
+  private:
+    std::unique_ptr<Impl> impl;
+  };
+
+} // ::umesh
+#endif
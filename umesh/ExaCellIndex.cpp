@@ -0,0 +1,159 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/ExaCellIndex.h"
+#include <atomic>
+#include <climits>
+
+namespace umesh {
+
+  /*! block size for parallel building of the table */
+  const size_t exaIndexBlockSize = 16*1024;
+
+  const uint32_t EMPTY_SLOT = uint32_t(-1);
+  
+  inline uint64_t cellHash(const vec3i &pos, int level)
+  {
+    uint64_t h
+      = (uint64_t(uint32_t(pos.x)) * 0x9e3779b97f4a7c15ull)
+      ^ (uint64_t(uint32_t(pos.y)) * 0xc2b2ae3d27d4eb4full)
+      ^ (uint64_t(uint32_t(pos.z)) * 0x165667b19e3779f9ull)
+      ^ (uint64_t(uint32_t(level)) * 0x27d4eb2f165667c5ull);
+    // finalizer of murmurhash3
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  inline bool sameLogicalCell(const ExaCell &cell, const vec3i &pos, int level)
+  {
+    return cell.pos == pos && cell.level == level;
+  }
+
+  inline int lowerOnLevel(float f, int level)
+  {
+    f = floorf(f/(1<<level));
+    return int(f*(1<<level));
+  }
+  
+  ExaCellIndex::SP ExaCellIndex::build(std::vector<ExaCell> cells)
+  {
+    return std::make_shared<ExaCellIndex>(std::move(cells));
+  }
+  
+  ExaCellIndex::ExaCellIndex(std::vector<ExaCell> cellVector)
+    : cells(std::move(cellVector))
+  {
+    const size_t numCells = cells.size();
+    if (numCells >= size_t(INT_MAX))
+      throw std::runtime_error("#umesh.ExaCellIndex: too many cells");
+
+    // levels are small numbers (they're shifts), so a flag per
+    // possible level is enough
+    std::atomic<uint64_t> levelMask(0);
+    std::atomic<bool>     invalidLevel(false);
+    size_t numSlots = 1;
+    while (numSlots < 2*numCells) numSlots *= 2;
+    mask = numSlots-1;
+    // the IDs get inserted with CAS first, and the keys copied into
+    // the slots afterwards
+    std::unique_ptr<std::atomic<uint32_t>[]> owners(new std::atomic<uint32_t>[numSlots]);
+    parallel_for_blocked
+      (0,numSlots,exaIndexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          owners[i].store(EMPTY_SLOT,std::memory_order_relaxed);
+      });
+    
+    parallel_for_blocked
+      (0,numCells,exaIndexBlockSize,
+       [&](size_t begin, size_t end){
+        uint64_t blockLevels = 0;
+        for (size_t cellID=begin;cellID<end;cellID++) {
+          const ExaCell &cell = cells[cellID];
+          if (cell.level < 0 || cell.level >= 31) {
+            invalidLevel = true;
+            continue;
+          }
+          blockLevels |= (1ull << cell.level);
+          for (size_t slot=cellHash(cell.pos,cell.level)&mask;;slot=(slot+1)&mask) {
+            uint32_t owner = EMPTY_SLOT;
+            if (owners[slot].compare_exchange_strong(owner,uint32_t(cellID)))
+              break;
+            if (!sameLogicalCell(cells[owner],cell.pos,cell.level))
+              continue;
+            // same cell twice: lowest ID wins, in any insertion order
+            while (cellID < owner &&
+                   !owners[slot].compare_exchange_weak(owner,uint32_t(cellID)))
+              ;
+            break;
+          }
+        }
+        levelMask |= blockLevels;
+      });
+    if (invalidLevel)
+      throw std::runtime_error("#umesh.ExaCellIndex: invalid cell level");
+
+    slots.resize(numSlots);
+    parallel_for_blocked
+      (0,numSlots,exaIndexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          const uint32_t owner = owners[i].load(std::memory_order_relaxed);
+          if (owner == EMPTY_SLOT) {
+            slots[i] = { vec3i(0), 0, -1 };
+            continue;
+          }
+          const ExaCell &cell = cells[owner];
+          slots[i] = { cell.pos, cell.level, int(owner) };
+        }
+      });
+    
+    for (int level=0;level<64;level++)
+      if (levelMask & (1ull << level))
+        levels.push_back(level);
+  }
+
+  int ExaCellIndex::find(const vec3i &pos, int level) const
+  {
+    if (slots.empty()) return -1;
+    for (size_t slot=cellHash(pos,level)&mask;;slot=(slot+1)&mask) {
+      const Slot &s = slots[slot];
+      if (s.cellID < 0)
+        return -1;
+      if (s.pos == pos && s.level == level)
+        return s.cellID;
+    }
+  }
+  
+  bool ExaCellIndex::find(int &cellID, const vec3f &where) const
+  {
+    for (int level : levels) {
+      const vec3i pos(lowerOnLevel(where.x,level),
+                      lowerOnLevel(where.y,level),
+                      lowerOnLevel(where.z,level));
+      cellID = find(pos,level);
+      if (cellID >= 0)
+        return true;
+    }
+    cellID = -1;
+    return false;
+  }
+  
+} // ::umesh
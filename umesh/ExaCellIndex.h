@@ -0,0 +1,87 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! one cell of an AMR ("exa") data set: a cube of width 1<<level
+      with lower-left corner 'pos', in integer cell coordinates of
+      the finest level, with one scalar value at its center. Layout
+      matches that of the .cells (pos and level) and .scalars files */
+  struct ExaCell {
+    inline box3f bounds() const
+    { return box3f(vec3f(pos),vec3f(pos+vec3i(1<<level))); }
+    /*! the (logical) cell on the same level that is 'delta' cells
+        away from this one */
+    inline ExaCell neighbor(const vec3i &delta) const
+    { return { pos+delta*(1<<level),level }; }
+    inline vec3f center() const { return vec3f(pos) + vec3f(0.5f*(1<<level)); }
+    
+    vec3i pos;
+    int   level;
+    float scalar;
+  };
+
+  /*! a hash table over a list of AMR cells, keyed by their (logical)
+      position and level, for finding a given cell - or the cell
+      that contains a given point - in (expected) constant time per
+      level, rather than a binary search over all cells.
+
+      The table uses open addressing with linear probing, and is at
+      most half full; it gets built in parallel, with lock-free
+      inserts, and each slot stores its cell's position and level
+      (so a lookup usually touches a single cache line). If the same logical cell appears more than once, the
+      one with the lowest index in the list gets found. The index
+      owns the list of cells; cell IDs are indices into 'cells' */
+  struct ExaCellIndex {
+    typedef std::shared_ptr<ExaCellIndex> SP;
+
+    static ExaCellIndex::SP build(std::vector<ExaCell> cells);
+    
+    ExaCellIndex(std::vector<ExaCell> cells);
+
+    /*! returns the ID of the cell at given position and level, or -1
+        if there is none */
+    int find(const vec3i &pos, int level) const;
+    
+    /*! finds the cell that contains given point, trying levels from
+        finest to coarsest; returns false (and a cellID of -1) if
+        there is none */
+    bool find(int &cellID, const vec3f &where) const;
+    
+    /*! the cells, in the order they were given in */
+    const std::vector<ExaCell> cells;
+    /*! all levels that have at least one cell, in ascending order */
+    std::vector<int> levels;
+    
+  private:
+    /*! a copy of the (logical) cell of each slot, so probing doesn't
+        have to look at the cells themselves; cellID is -1 for empty
+        slots */
+    struct Slot {
+      vec3i pos;
+      int   level;
+      int   cellID;
+    };
+    /*! number of slots is a power of two, this is that minus one */
+    size_t mask = 0;
+    std::vector<Slot> slots;
+  };
+  
+} // ::umesh
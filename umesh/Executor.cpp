@@ -0,0 +1,368 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/Executor.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#if UMESH_HAVE_TBB
+# include <tbb/blocked_range.h>
+# include <tbb/parallel_for.h>
+#endif
+#if UMESH_HAVE_OPENMP
+# include <omp.h>
+#endif
+
+namespace umesh {
+
+  /*! the executor set by the innermost ScopedExecutor of this thread
+      (or by the executor whose loop this thread is working on) */
+  thread_local Executor *scopedExecutor = nullptr;
+  
+  /*! the one set through setDefaultExecutor(); the SP keeps it
+      alive, the raw pointer is what loops look at */
+  Executor::SP           defaultExecutorSP;
+  std::atomic<Executor*> defaultExecutor(nullptr);
+
+  /*! makes loops started from within an executor's tasks use that
+      same executor */
+  struct WithinExecutor {
+    WithinExecutor(Executor *executor)
+      : previous(scopedExecutor)
+    { scopedExecutor = executor; }
+    ~WithinExecutor() { scopedExecutor = previous; }
+    Executor *const previous;
+  };
+
+  /*! number of chunks per thread that dynamically scheduled loops get
+      split into; more chunks balance the load better, fewer have less
+      overhead */
+  const size_t chunksPerThread = 8;
+
+  inline size_t chunkSizeFor(size_t numTasks, int numThreads)
+  {
+    return std::max(size_t(1),numTasks/(chunksPerThread*std::max(numThreads,1)));
+  }
+  
+  // ==================================================================
+  // serial
+  // ==================================================================
+  struct SerialExecutor : public Executor {
+    void run(size_t numTasks, const RangeTask &task) override
+    {
+      if (numTasks == 0) return;
+      WithinExecutor within(this);
+      task(0,numTasks);
+    }
+    int numThreads() const override { return 1; }
+    std::string toString() const override { return "serial"; }
+  };
+
+  Executor::SP Executor::createSerial()
+  {
+    return std::make_shared<SerialExecutor>();
+  }
+  
+  // ==================================================================
+  // built-in thread pool
+  // ==================================================================
+
+  /*! 'numThreads-1' workers that sleep until a loop gets started,
+      then help the thread that started it to grab chunks of that
+      loop's range through a shared atomic cursor, until none are
+      left. Only one loop runs at a time; loops started from within a
+      loop of the same pool run serially on that thread */
+  struct ThreadPool : public Executor {
+    ThreadPool(int numThreads)
+    {
+      for (int i=1;i<numThreads;i++)
+        workers.push_back(std::thread([this](){ workerLoop(); }));
+    }
+    
+    ~ThreadPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+      }
+      wakeUp.notify_all();
+      for (auto &worker : workers)
+        worker.join();
+    }
+
+    void run(size_t numTasks, const RangeTask &task) override
+    {
+      if (numTasks == 0) return;
+      if (workers.empty() || numTasks == 1 || insidePool == this) {
+        WithinExecutor within(this);
+        task(0,numTasks);
+        return;
+      }
+      std::lock_guard<std::mutex> runLock(runMutex);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task      = &task;
+        this->numTasks  = numTasks;
+        this->chunkSize = chunkSizeFor(numTasks,numThreads());
+        nextTask  = 0;
+        failed    = false;
+        exception = nullptr;
+        numBusy   = (int)workers.size();
+        ++jobID;
+      }
+      wakeUp.notify_all();
+      work();
+      std::exception_ptr result;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock,[&](){ return numBusy == 0; });
+        this->task = nullptr;
+        result = exception;
+      }
+      if (result)
+        std::rethrow_exception(result);
+    }
+    
+    int numThreads() const override { return (int)workers.size()+1; }
+    
+    std::string toString() const override
+    { return "threadPool("+std::to_string(numThreads())+" threads)"; }
+
+  private:
+    void workerLoop()
+    {
+      insidePool = this;
+      uint64_t lastJob = 0;
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          wakeUp.wait(lock,[&](){ return quit || jobID != lastJob; });
+          if (quit) return;
+          lastJob = jobID;
+        }
+        work();
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (--numBusy == 0)
+            allDone.notify_one();
+        }
+      }
+    }
+
+    /*! grabs and runs chunks of the current loop until there are none
+        left (or one of them threw) */
+    void work()
+    {
+      ThreadPool *previous = insidePool;
+      insidePool = this;
+      WithinExecutor within(this);
+      while (!failed) {
+        const size_t begin = nextTask.fetch_add(chunkSize);
+        if (begin >= numTasks) break;
+        try {
+          (*task)(begin,std::min(begin+chunkSize,numTasks));
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (!failed.exchange(true))
+            exception = std::current_exception();
+        }
+      }
+      insidePool = previous;
+    }
+
+    /*! the pool whose loop the current thread is working on, if any */
+    static thread_local ThreadPool *insidePool;
+
+    std::vector<std::thread> workers;
+    /*! serializes loops started concurrently from different threads */
+    std::mutex               runMutex;
+    /*! protects everything below */
+    std::mutex               mutex;
+    std::condition_variable  wakeUp, allDone;
+    uint64_t                 jobID   = 0;
+    bool                     quit    = false;
+    int                      numBusy = 0;
+
+    // the current loop
+    const RangeTask         *task      = nullptr;
+    size_t                   numTasks  = 0;
+    size_t                   chunkSize = 1;
+    std::atomic<size_t>      nextTask { 0 };
+    std::atomic<bool>        failed   { false };
+    std::exception_ptr       exception;
+  };
+
+  thread_local ThreadPool *ThreadPool::insidePool = nullptr;
+
+  inline int numHardwareThreads()
+  {
+    return std::max(1,(int)std::thread::hardware_concurrency());
+  }
+  
+  Executor::SP Executor::createThreadPool(int numThreads)
+  {
+    return std::make_shared<ThreadPool>(numThreads > 0 ? numThreads : numHardwareThreads());
+  }
+
+  // ==================================================================
+  // OpenMP
+  // ==================================================================
+#if UMESH_HAVE_OPENMP
+  struct OpenMPExecutor : public Executor {
+    OpenMPExecutor(int numThreads)
+      : maxThreads(numThreads > 0 ? numThreads : omp_get_max_threads())
+    {}
+    
+    void run(size_t numTasks, const RangeTask &task) override
+    {
+      if (numTasks == 0) return;
+      const size_t    chunkSize = chunkSizeFor(numTasks,maxThreads);
+      const long long numChunks = (long long)((numTasks+chunkSize-1)/chunkSize);
+      // exceptions must not leave an omp parallel region
+      std::atomic<bool>  failed(false);
+      std::exception_ptr exception;
+#pragma omp parallel for schedule(dynamic,1) num_threads(maxThreads)
+      for (long long chunkID=0;chunkID<numChunks;chunkID++) {
+        if (failed) continue;
+        const size_t begin = size_t(chunkID)*chunkSize;
+        WithinExecutor within(this);
+        try {
+          task(begin,std::min(begin+chunkSize,numTasks));
+        } catch (...) {
+#pragma omp critical (umesh_executor_exception)
+          if (!failed.exchange(true))
+            exception = std::current_exception();
+        }
+      }
+      if (exception)
+        std::rethrow_exception(exception);
+    }
+    
+    int numThreads() const override { return maxThreads; }
+    
+    std::string toString() const override
+    { return "openmp("+std::to_string(maxThreads)+" threads)"; }
+
+    const int maxThreads;
+  };
+#endif
+  
+  Executor::SP Executor::createOpenMP(int numThreads)
+  {
+#if UMESH_HAVE_OPENMP
+    return std::make_shared<OpenMPExecutor>(numThreads);
+#else
+    throw std::runtime_error("#umesh.Executor: umesh was built without OpenMP support");
+#endif
+  }
+
+  // ==================================================================
+  // TBB
+  // ==================================================================
+#if UMESH_HAVE_TBB
+  struct TBBExecutor : public Executor {
+    TBBExecutor(int numThreads)
+      : ownArena(numThreads > 0
+                 ? new tbb::task_arena(numThreads)
+                 : new tbb::task_arena),
+        arena(*ownArena)
+    {}
+    TBBExecutor(tbb::task_arena &arena)
+      : arena(arena)
+    {}
+    
+    void run(size_t numTasks, const RangeTask &task) override
+    {
+      if (numTasks == 0) return;
+      arena.execute([&](){
+          tbb::parallel_for
+            (tbb::blocked_range<size_t>(0,numTasks),
+             [&](const tbb::blocked_range<size_t> &range){
+               WithinExecutor within(this);
+               task(range.begin(),range.end());
+             });
+        });
+    }
+    
+    int numThreads() const override { return arena.max_concurrency(); }
+    
+    std::string toString() const override
+    { return "tbb("+std::to_string(numThreads())+" threads)"; }
+
+    std::unique_ptr<tbb::task_arena> ownArena;
+    tbb::task_arena                 &arena;
+  };
+  
+  Executor::SP Executor::createTBB(tbb::task_arena &arena)
+  {
+    return std::make_shared<TBBExecutor>(arena);
+  }
+#endif
+  
+  Executor::SP Executor::createTBB(int numThreads)
+  {
+#if UMESH_HAVE_TBB
+    return std::make_shared<TBBExecutor>(numThreads);
+#else
+    throw std::runtime_error("#umesh.Executor: umesh was built without tbb support");
+#endif
+  }
+
+  // ==================================================================
+  // selecting the executor
+  // ==================================================================
+  
+  void setDefaultExecutor(Executor::SP executor)
+  {
+    defaultExecutor   = executor.get();
+    defaultExecutorSP = executor;
+  }
+
+  Executor *currentExecutor()
+  {
+    if (scopedExecutor)
+      return scopedExecutor;
+    if (Executor *executor = defaultExecutor.load(std::memory_order_relaxed))
+      return executor;
+#if UMESH_HAVE_TBB
+    return nullptr;
+#else
+    static Executor::SP builtinPool
+      = numHardwareThreads() > 1
+      ? Executor::createThreadPool()
+      : Executor::createSerial();
+    return builtinPool.get();
+#endif
+  }
+
+  ScopedExecutor::ScopedExecutor(Executor::SP executor)
+    : executor(executor),
+      previous(scopedExecutor)
+  {
+    scopedExecutor = executor.get();
+  }
+  
+  ScopedExecutor::~ScopedExecutor()
+  {
+    scopedExecutor = previous;
+  }
+  
+} // ::umesh
@@ -0,0 +1,117 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* pluggable executors for umesh::parallel_for: by default all of
+   umesh's parallel loops run through tbb::parallel_for (in whatever
+   arena the calling thread is in), or - in builds without tbb - on
+   a built-in thread pool. Applications that need to control where
+   and on how many threads umesh runs can install a different
+   executor, either globally (setDefaultExecutor()), or for all
+   umesh calls made by one thread within a given scope
+   (ScopedExecutor):
+
+     Executor::SP fourThreads = Executor::createTBB(4);
+     {
+       ScopedExecutor use(fourThreads);
+       FaceConn::compute(mesh);  // runs on (at most) four threads
+     }
+
+   Loops that get started from within another loop of an executor
+   use that same executor. */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#if UMESH_HAVE_TBB
+# include <tbb/task_arena.h>
+#endif
+
+namespace umesh {
+
+  /*! something that can run a loop of independent tasks in parallel */
+  struct Executor {
+    typedef std::shared_ptr<Executor> SP;
+
+    /*! called with ranges [begin,end) of task indices; different
+        ranges may get run concurrently */
+    typedef std::function<void(size_t begin, size_t end)> RangeTask;
+
+    virtual ~Executor() = default;
+
+    /*! runs 'task' over all of [0,numTasks), and returns once all of
+        them are done. If any range throws, the first exception gets
+        rethrown once the loop has stopped (remaining ranges may or
+        may not have run) */
+    virtual void run(size_t numTasks, const RangeTask &task) = 0;
+
+    /*! (maximum) number of threads this executor runs on */
+    virtual int numThreads() const = 0;
+
+    virtual std::string toString() const = 0;
+
+    /*! runs all tasks on the calling thread */
+    static Executor::SP createSerial();
+
+    /*! a pool of (numThreads-1) worker threads that, along with the
+        calling thread, dynamically grab chunks of each loop's range,
+        so threads that finish early take over work from slow ones;
+        available in all builds. 0 means one thread per hardware
+        thread */
+    static Executor::SP createThreadPool(int numThreads = 0);
+
+    /*! runs loops with OpenMP; 0 means OpenMP's default number of
+        threads. Throws if umesh was built without OpenMP support */
+    static Executor::SP createOpenMP(int numThreads = 0);
+    
+    /*! runs loops in a tbb::task_arena of its own with given maximum
+        concurrency (0 means tbb's default). Throws if umesh was built
+        without tbb */
+    static Executor::SP createTBB(int numThreads = 0);
+#if UMESH_HAVE_TBB
+    /*! runs loops in the given, already existing, tbb arena, which
+        has to outlive the executor */
+    static Executor::SP createTBB(tbb::task_arena &arena);
+#endif
+  };
+
+  /*! sets the executor that all umesh loops use, unless overridden by
+      a ScopedExecutor; nullptr restores the default (tbb if
+      available, else a thread pool with one thread per hardware
+      thread). Should not be changed while any umesh function is
+      running */
+  void setDefaultExecutor(Executor::SP executor);
+
+  /*! the executor umesh loops started from this thread currently run
+      on, or nullptr for the built-in tbb::parallel_for path (in tbb
+      builds, when nothing else has been set) */
+  Executor *currentExecutor();
+
+  /*! makes all umesh loops that get started by the current thread
+      within this object's lifetime run on given executor (nullptr
+      meaning the default one); scopes can be nested */
+  struct ScopedExecutor {
+    ScopedExecutor(Executor::SP executor);
+    ~ScopedExecutor();
+    ScopedExecutor(const ScopedExecutor &) = delete;
+  private:
+    Executor::SP const executor;
+    Executor          *previous;
+  };
+  
+} // ::umesh
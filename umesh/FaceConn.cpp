@@ -15,15 +15,18 @@
 // ======================================================================== //
 
 #include "FaceConn.h"
+#include "umesh/FaceConnKernels.h"
 #include "umesh/io/IO.h"
+#include "umesh/profile.h"
 
-# ifdef UMESH_HAVE_TBB
-#  include "tbb/parallel_sort.h"
-# endif
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/ScratchArena.h"
 #include <set>
 #include <algorithm>
 #include <string.h>
 #include <fstream>
+#include <atomic>
+#include <memory>
 
 #ifndef PRINT
 #ifdef __CUDA_ARCH__
@@ -41,8 +44,6 @@
 
 namespace umesh {
 
-  using std::swap;
-  
   using SharedFace   = FaceConn::SharedFace;
   using PrimFacetRef = FaceConn::PrimFacetRef;
 
@@ -52,329 +53,31 @@ namespace umesh {
     return out;
   }
   
-  /*! one "face" of a given prim, defined through the (global) vertex
-      indices, the gloabl primitive index, and the (local to the prim)
-      facet index; orientation defines whether the given vertex
-      indices point inwards, or outwards, allowing to later keeping
-      track of which side of a face the given facet belons */
-  struct Facet {
-    vec4i        vertexIdx;
-    PrimFacetRef prim;
-    int          orientation;
-  };
-
   std::ostream &operator<<(std::ostream &out, const Facet &facet)
   {
     out << "Facet{vtx="<<facet.vertexIdx<<",prim="<<facet.prim<<",orientation="<<facet.orientation<<"}";
     return out;
   }
 
-  /*! allows for sorting facets in a unqieu order based on their
-      indices, but _ignoring_ things like orientation; this allows to
-      later find facets belonding to the same face by first
-      re-ordering the facet's vertex indices ina unque way and then
-      sorting by that order (which means two facets for the same face
-      shold then end up next to each other after sorting) */
-  struct FacetComparator {
-    inline 
-    bool operator()(const Facet &a, const Facet &b) const {
-      return
-        (a.vertexIdx.x < b.vertexIdx.x)
-        ||
-        ((a.vertexIdx.x == b.vertexIdx.x) &&
-         (a.vertexIdx.y <  b.vertexIdx.y))
-        ||
-        ((a.vertexIdx.x == b.vertexIdx.x) &&
-         (a.vertexIdx.y == b.vertexIdx.y) &&
-         (a.vertexIdx.z <  b.vertexIdx.z))
-        ||
-        ((a.vertexIdx.x == b.vertexIdx.x) &&
-         (a.vertexIdx.y == b.vertexIdx.y) &&
-         (a.vertexIdx.z == b.vertexIdx.z) &&
-         (a.vertexIdx.w <  b.vertexIdx.w));
-    }
-  };
-
-               
-  /*! describes input data through plain pointers, so we can run the
-    same algorithm once with std::vector::data() (on the host) or
-    cuda-malloced data (on gpu) */
-  struct InputMesh {
-    Tet   *tets;
-    size_t numTets;
-    Pyr   *pyrs;
-    size_t numPyrs;
-    Wedge *wedges;
-    size_t numWedges;
-    Hex   *hexes;
-    size_t numHexes;
-  };
-
-  inline int numUniqueVertices(vec3i v)
-  {
-    std::sort(&v.x,&v.x+3);
-    int cnt = 1;
-    for (int i=1;i<3;i++)
-      if (v[i] != v[i-1]) cnt++;
-    return cnt;
-  }
-  inline int numUniqueVertices(vec4i v)
-  {
-    std::sort(&v.x,&v.x+4);
-    int cnt = 1;
-    for (int i=1;i<4;i++)
-      if (v[i] != v[i-1]) cnt++;
-    return cnt;
-  }
-  
-  // ==================================================================
-  // compute vertex order stage
-  // ==================================================================
-  
-  /*! computes a unique vertex order such that two different prims
-    that share the same face - but have written thie facets with
-    differnetly ordered vertex indices - will end up with the same
-    vector of indices. of course, re-ordeirng indices can change
-    orientation, which this function keeps track of */
-  inline 
-  void computeUniqueVertexOrder(Facet &facet)
-  {
-    vec4i idx = facet.vertexIdx;
-    // \todo optimize this - all we need is detect the number of
-    // unique vertices, for which this is overkill
-    // std::set<int> uniqueIDs;
-    // uniqueIDs.insert(idx.x);
-    // uniqueIDs.insert(idx.y);
-    // uniqueIDs.insert(idx.z);
-    
-    if (idx.w < 0) {
-      int numUnique = numUniqueVertices((const vec3i&)idx);
-      if (numUnique < 3) {
-        facet.vertexIdx = vec4i(-1);
-        return;
-      }
-      if (idx.y < idx.x)
-        { swap(idx.x,idx.y); facet.orientation = 1-facet.orientation; }
-      if (idx.z < idx.x)
-        { swap(idx.x,idx.z); facet.orientation = 1-facet.orientation; }
-      if (idx.z < idx.y)
-        { swap(idx.y,idx.z); facet.orientation = 1-facet.orientation; }
-    } else {
-      // uniqueIDs.insert(idx.w);
-      int numUnique = numUniqueVertices(idx);
-      
-      if (numUnique == 2) {
-        facet.vertexIdx = vec4i(-1);
-        return;
-      }
-      
-      if (numUnique == 3) {
-        if (idx.x==idx.y) {
-          idx = { idx.x, idx.z, idx.w, -1 };
-        } else if (idx.x == idx.z) {
-          // oooooh... this one is fishy
-          PING;
-          idx = { idx.x, idx.y, idx.w, -1 };
-        } else if (idx.x == idx.w) {
-          idx = { idx.x, idx.y, idx.z, -1 };
-        } else if (idx.y == idx.z) {
-          idx = { idx.x, idx.y, idx.w, -1 };
-        } else if (idx.y == idx.w) {
-          // oooooh... this one is fishy
-          PING;
-          idx = { idx.x, idx.y, idx.z, -1 };
-        } else if (idx.z == idx.w) {
-          idx = { idx.x, idx.y, idx.z, -1 };
-        } else throw std::runtime_error("???");
-        
-        if (idx.y < idx.x)
-          { swap(idx.x,idx.y); facet.orientation = 1-facet.orientation; }
-        if (idx.z < idx.x)
-          { swap(idx.x,idx.z); facet.orientation = 1-facet.orientation; }
-        if (idx.z < idx.y)
-          { swap(idx.y,idx.z); facet.orientation = 1-facet.orientation; }
-      } else {
-
-        int lv = idx.x, li=0;
-        if (idx.y < lv) { lv = idx.y; li = 1; }
-        if (idx.z < lv) { lv = idx.z; li = 2; }
-        if (idx.w < lv) { lv = idx.w; li = 3; }
-
-        switch (li) {
-        case 0: idx = { idx.x,idx.y,idx.z,idx.w }; break;
-        case 1: idx = { idx.y,idx.z,idx.w,idx.x }; break;
-        case 2: idx = { idx.z,idx.w,idx.x,idx.y }; break;
-        case 3: idx = { idx.w,idx.x,idx.y,idx.z }; break;
-        };
-
-        if (idx.w < idx.y) {
-          facet.orientation = 1-facet.orientation;
-          swap(idx.w,idx.y);
-        }
-      }
-    }
-    facet.vertexIdx = idx;
-  }
-
-  void computeUniqueVertexOrder(Facet *facets, size_t numFacets)
+  /*! computes the unique vertex order of all facets, and returns
+      the largest vertex index used by any of them */
+  int computeUniqueVertexOrder(Facet *facets, size_t numFacets)
   {
+    const size_t blockSize = 16*1024;
+    std::vector<int> blockMax(divRoundUp(numFacets,blockSize),-1);
     parallel_for_blocked
-      (0,numFacets,1024,
+      (0,numFacets,blockSize,
        [&](size_t begin, size_t end) {
+         int maxIdx = -1;
          for (size_t i=begin;i<end;i++) {
            computeUniqueVertexOrder(facets[i]);
+           const vec4i idx = facets[i].vertexIdx;
+           maxIdx = std::max(maxIdx,std::max(std::max(idx.x,idx.y),
+                                             std::max(idx.z,idx.w)));
          }
+         blockMax[begin/blockSize] = maxIdx;
        });
-  }
-
-  // ==================================================================
-  // init faces
-  // ==================================================================
-  
-  /*! writes the four facets of a tet; for degenerate tets that may
-    end up with faces that collapse to points or lines - that's OK,
-    as it'll be fixed later on in computeUniqueVertexOrder() */
-  inline 
-  void writeTetFacets(Facet *facets,
-                      size_t tetIdx,
-                      InputMesh mesh
-                      )
-  {
-    for (int i=0;i<4;i++) facets[i].prim.primType = UMesh::TET;
-    for (int i=0;i<4;i++) facets[i].prim.facetIdx = i;
-    for (int i=0;i<4;i++) facets[i].prim.primIdx  = tetIdx;
-    for (int i=0;i<4;i++) facets[i].orientation   = 0;
-
-    vec4i tet = mesh.tets[tetIdx];
-
-    facets[0].vertexIdx = { tet.y,tet.w,tet.z,-1 };
-    facets[1].vertexIdx = { tet.x,tet.z,tet.w,-1 };
-    facets[2].vertexIdx = { tet.x,tet.w,tet.y,-1 };
-    facets[3].vertexIdx = { tet.x,tet.y,tet.z,-1 };
-  }
-  
-  /*! writes the five facets of a pyrs; for degenerate pyramids thta
-    may end up with quads that become triangles, and/or entire faces
-    that collapse to points or lines - that's OK, as it'll be fixed
-    later on in computeUniqueVertexOrder() */
-  inline 
-  void writePyrFacets(Facet *facets,
-                      size_t pyrIdx,
-                      InputMesh mesh
-                      )
-  {
-    for (int i=0;i<5;i++) facets[i].prim.primType = UMesh::PYR;
-    for (int i=0;i<5;i++) facets[i].prim.facetIdx = i;
-    for (int i=0;i<5;i++) facets[i].prim.primIdx  = pyrIdx;
-    for (int i=0;i<5;i++) facets[i].orientation   = 0;
-    
-    UMesh::Pyr pyr = mesh.pyrs[pyrIdx];
-    vec4i base = pyr.base;
-    facets[0].vertexIdx = { pyr.top,base.y,base.x,-1 };
-    facets[1].vertexIdx = { pyr.top,base.z,base.y,-1 };
-    facets[2].vertexIdx = { pyr.top,base.w,base.z,-1 };
-    facets[3].vertexIdx = { pyr.top,base.x,base.w,-1 };
-    facets[4].vertexIdx = { base.x,base.y,base.z,base.w };
-  }
-
-  /*! writes the five facets of a wedge; for degenerate wedges thta
-    may end up with quads that become triangles, and/or entire faces
-    that collapse to points or lines - that's OK, as it'll be fixed
-    later on in computeUniqueVertexOrder() */
-  inline 
-  void writeWedgeFacets(Facet *facets,
-                        size_t wedgeIdx,
-                        InputMesh mesh
-                        )
-  {
-    for (int i=0;i<5;i++) facets[i].prim.primType = UMesh::WEDGE;
-    for (int i=0;i<5;i++) facets[i].prim.facetIdx = i;
-    for (int i=0;i<5;i++) facets[i].prim.primIdx  = wedgeIdx;
-    for (int i=0;i<5;i++) facets[i].orientation   = 0;
-    
-    UMesh::Wedge wedge = mesh.wedges[wedgeIdx];
-    int i0 = wedge.front.x;
-    int i1 = wedge.front.y;
-    int i2 = wedge.front.z;
-    int i3 = wedge.back.x;
-    int i4 = wedge.back.y;
-    int i5 = wedge.back.z;
-
-    facets[0].vertexIdx = { i0,i2,i1,-1 };
-    facets[1].vertexIdx = { i3,i4,i5,-1 };
-    facets[2].vertexIdx = { i0,i3,i5,i2 };
-    facets[3].vertexIdx = { i1,i2,i5,i4 };
-    facets[4].vertexIdx = { i0,i1,i4,i3 };
-  }
-  
-  /*! writes the five facets of a hexes; for degenerate hexes that may
-    end up with quads that become triangles, and/or entire faces
-    that collapse to points or lines - that's OK, as it'll be fixed
-    later on in computeUniqueVertexOrder() */
-  inline 
-  void writeHexFacets(Facet *facets,
-                      size_t hexIdx,
-                      InputMesh mesh
-                      )
-  {
-    for (int i=0;i<6;i++) facets[i].prim.primType = UMesh::HEX;
-    for (int i=0;i<6;i++) facets[i].prim.facetIdx = i;
-    for (int i=0;i<6;i++) facets[i].prim.primIdx  = hexIdx;
-    for (int i=0;i<6;i++) facets[i].orientation   = 0;
-    
-    UMesh::Hex hex = mesh.hexes[hexIdx];
-    int i0 = hex.base.x;
-    int i1 = hex.base.y;
-    int i2 = hex.base.z;
-    int i3 = hex.base.w;
-    int i4 = hex.top.x;
-    int i5 = hex.top.y;
-    int i6 = hex.top.z;
-    int i7 = hex.top.w;
-
-    facets[0].vertexIdx = { i0,i1,i2,i3 };
-    facets[1].vertexIdx = { i4,i7,i6,i5 };
-    facets[2].vertexIdx = { i0,i4,i5,i1 };
-    facets[3].vertexIdx = { i2,i6,i7,i3 };
-    facets[4].vertexIdx = { i1,i5,i6,i2 };
-    facets[5].vertexIdx = { i0,i3,i7,i4 };
-  }
-
-  /*! writes the facets given by the parallel launch that runs over
-    all facets in the model */
-  inline 
-  void writeFacets(Facet *facets, size_t jobIdx, const InputMesh &mesh)
-  {
-    // write tets
-    if (jobIdx < mesh.numTets) {
-      writeTetFacets(facets+4*jobIdx,jobIdx,mesh);
-      return;
-    }
-    facets += 4*mesh.numTets;
-    jobIdx -= mesh.numTets;
-  
-    // write pyramids
-    if (jobIdx < mesh.numPyrs) {
-      writePyrFacets(facets+5*jobIdx,jobIdx,mesh);
-      return;
-    }
-    facets += 5*mesh.numPyrs;
-    jobIdx -= mesh.numPyrs;
-  
-    // write wedges
-    if (jobIdx < mesh.numWedges) {
-      writeWedgeFacets(facets+5*jobIdx,jobIdx,mesh);
-      return;
-    }
-    facets += 5*mesh.numWedges;
-    jobIdx -= mesh.numWedges;
-  
-    // write hexes
-    if (jobIdx < mesh.numHexes) {
-      writeHexFacets(facets+6*jobIdx,jobIdx,mesh);
-      return;
-    }
-    return;
+    return blockMax.empty() ? -1 : *std::max_element(blockMax.begin(),blockMax.end());
   }
 
   /*! writes ALL facets in the mesh, even degenerate ones */
@@ -397,34 +100,32 @@ namespace umesh {
   // ==================================================================
   // sort facet array
   // ==================================================================
-  void sortFacets(Facet *facets, size_t numFacets)
+  /*! sorts facets in the same order as FacetComparator would, but
+      through a radix sort. Since all vertex indices are in
+      [-1,maxVertexIdx] we only need as many bits per index as that
+      range requires: if all four indices fit into 64 bits we need
+      only one sort, otherwise we first sort by the last two indices,
+      and then (stably) by the first two */
+  void sortFacets(Facet *facets, size_t numFacets, int maxVertexIdx)
   {
-# ifdef UMESH_HAVE_TBB
-    std::cout << "parallel face sorting" << std::endl;
-    tbb::parallel_sort(facets,facets+numFacets,FacetComparator());
-    std::cout << "done face sorting" << std::endl;
-# else
-    std::sort(facets,facets+numFacets,FacetComparator());
-# endif
-  }
-  
-  // ==================================================================
-  // set up / upload input mesh data
-  // ==================================================================
-  template<typename T>
-  inline void upload(T *&ptr, size_t &count,
-                     const std::vector<T> &vec)
-  {
-    ptr = (T*)vec.data();
-    count = vec.size();
-  }
-
-  void setupInput(InputMesh &mesh, UMesh::SP input)
-  {
-    upload(mesh.tets,mesh.numTets,input->tets);
-    upload(mesh.pyrs,mesh.numPyrs,input->pyrs);
-    upload(mesh.wedges,mesh.numWedges,input->wedges);
-    upload(mesh.hexes,mesh.numHexes,input->hexes);
+    int bits = 1;
+    while (bits < 32 && (uint64_t(maxVertexIdx)+1) >> bits) bits++;
+    
+    auto index = [](int idx) { return uint64_t(uint32_t(idx+1)); };
+    if (4*bits <= 64) {
+      parallel_radix_sort(facets,numFacets,[&](const Facet &facet){
+          const vec4i &v = facet.vertexIdx;
+          return (index(v.x) << (3*bits)) | (index(v.y) << (2*bits))
+            |    (index(v.z) << bits)     |  index(v.w);
+        });
+      return;
+    }
+    parallel_radix_sort(facets,numFacets,[&](const Facet &facet){
+        return (index(facet.vertexIdx.z) << bits) | index(facet.vertexIdx.w);
+      });
+    parallel_radix_sort(facets,numFacets,[&](const Facet &facet){
+        return (index(facet.vertexIdx.x) << bits) | index(facet.vertexIdx.y);
+      });
   }
   
 
@@ -477,19 +178,6 @@ namespace umesh {
   // compute face indices from (sorted) facet array
   // ==================================================================
 
-  inline 
-  void initFaceIndexKernel(uint64_t *faceIndices,
-                           Facet *facets,
-                           size_t facetIdx)
-  {
-    faceIndices[facetIdx]
-      =  (facetIdx == 0)
-      || (facets[facetIdx-1].vertexIdx.x != facets[facetIdx].vertexIdx.x)
-      || (facets[facetIdx-1].vertexIdx.y != facets[facetIdx].vertexIdx.y)
-      || (facets[facetIdx-1].vertexIdx.z != facets[facetIdx].vertexIdx.z)
-      || (facets[facetIdx-1].vertexIdx.w != facets[facetIdx].vertexIdx.w);
-  }
-
   void clearFaces(SharedFace *faces, size_t numFaces)
   {
     PrimFacetRef clearPrim = { 0,0,-1 };
@@ -539,17 +227,279 @@ namespace umesh {
   }
 
 
+  // ==================================================================
+  // hash-based face matching
+  // ==================================================================
+
+  /*! concurrent open-addressing (linear probing) hash table of
+      faces, keyed by the (unique-ordered) vertex indices of a
+      facet. Rather than first writing, and then sorting, all facets
+      of all prims, each prim inserts its facets directly into this
+      table, and the used slots then become the final faces. Each
+      slot fits into half a cache line, and gets claimed by
+      atomically swapping its first vertex index from 'empty' to
+      'busy'; the two sides get set through atomic compare-and-swaps,
+      which also detects sides that get used twice */
+  struct FaceHashTable {
+    enum { EMPTY = -1, BUSY = -2 };
+
+    struct UMESH_ALIGN(32) Slot {
+      std::atomic<int>      x;
+      int                   y, z, w;
+      /*! the PrimFacetRef's on front and back side, as 64-bit words */
+      std::atomic<uint64_t> front, back;
+    };
+
+    typedef enum { NEW_FACE, EXISTING_FACE, SIDE_USED_TWICE, TABLE_FULL } InsertResult;
+
+    static inline uint64_t pack(PrimFacetRef ref)
+    {
+      uint64_t bits;
+      memcpy(&bits,&ref,sizeof(bits));
+      return bits;
+    }
+
+    static inline PrimFacetRef unpack(uint64_t bits)
+    {
+      PrimFacetRef ref;
+      memcpy(&ref,&bits,sizeof(ref));
+      return ref;
+    }
+
+    FaceHashTable(size_t capacity)
+      : capacity(capacity),
+        slots(new Slot[capacity])
+    {
+      PrimFacetRef clearPrim = { 0,0,-1 };
+      clearPrim.primIdx = -1;
+      unused = pack(clearPrim);
+      parallel_for_blocked
+        (0,capacity,16*1024,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++) {
+             slots[i].x.store(EMPTY,std::memory_order_relaxed);
+             slots[i].front.store(unused,std::memory_order_relaxed);
+             slots[i].back.store(unused,std::memory_order_relaxed);
+           }
+         });
+    }
+
+    static inline uint64_t hash(const vec4i &idx)
+    {
+      uint64_t h
+        = uint64_t(uint32_t(idx.x)) * 0x9e3779b97f4a7c15ull
+        ^ uint64_t(uint32_t(idx.y)) * 0xc2b2ae3d27d4eb4full
+        ^ uint64_t(uint32_t(idx.z)) * 0x165667b19e3779f9ull
+        ^ uint64_t(uint32_t(idx.w)) * 0x27d4eb2f165667c5ull;
+      h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+      h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+      h ^= h >> 33;
+      return h;
+    }
+
+    /*! first slot to probe for given key; maps the hash value to
+        [0,capacity) without needing a power-of-two capacity */
+    inline size_t homeSlot(const vec4i &idx) const
+    {
+      const uint64_t h = hash(idx);
+#ifdef __SIZEOF_INT128__
+      return size_t(((unsigned __int128)h * capacity) >> 64);
+#else
+      return size_t(h % capacity);
+#endif
+    }
+
+    /*! hints the cpu that we're about to access given slot, so the
+        cache misses of multiple facets' inserts can overlap */
+    inline void prefetch(size_t slot) const
+    {
+#if defined(__GNUC__) || defined(__clang__)
+      __builtin_prefetch(&slots[slot],1);
+#endif
+    }
+
+    /*! inserts given (already unique-ordered, non-degenerate) facet,
+        starting at given home slot, and sets the corresponding side
+        of its face */
+    InsertResult insert(const Facet &facet, size_t slot)
+    {
+      const vec4i &key = facet.vertexIdx;
+      InsertResult result = EXISTING_FACE;
+      for (size_t numProbes=0;;numProbes++) {
+        if (numProbes == capacity) return TABLE_FULL;
+        Slot &s = slots[slot];
+        int x = s.x.load(std::memory_order_acquire);
+        if (x == EMPTY &&
+            s.x.compare_exchange_strong(x,BUSY,std::memory_order_acquire)) {
+          s.y = key.y;
+          s.z = key.z;
+          s.w = key.w;
+          s.x.store(key.x,std::memory_order_release);
+          result = NEW_FACE;
+          break;
+        }
+        // somebody else claimed this slot; wait until they have
+        // written its key
+        while (x == BUSY)
+          x = s.x.load(std::memory_order_acquire);
+        if (x == key.x && s.y == key.y && s.z == key.z && s.w == key.w)
+          break;
+        slot = (slot+1 == capacity) ? 0 : slot+1;
+      }
+
+      std::atomic<uint64_t> &side
+        = facet.orientation ? slots[slot].front : slots[slot].back;
+      uint64_t expected = unused;
+      if (!side.compare_exchange_strong(expected,pack(facet.prim),
+                                        std::memory_order_relaxed))
+        return SIDE_USED_TWICE;
+      return result;
+    }
+
+    /*! writes all used slots - in slot order - into the returned
+        faces array */
+    std::vector<SharedFace> extractFaces() const
+    {
+      const size_t blockSize = 64*1024;
+      const size_t numBlocks = divRoundUp(capacity,blockSize);
+      std::vector<size_t> blockOffset(numBlocks+1,0);
+      parallel_for(numBlocks,[&](size_t blockID){
+          const size_t begin = blockID*blockSize;
+          const size_t end   = std::min(begin+blockSize,capacity);
+          size_t numUsed = 0;
+          for (size_t i=begin;i<end;i++)
+            numUsed += (slots[i].x.load(std::memory_order_relaxed) != EMPTY);
+          blockOffset[blockID+1] = numUsed;
+        });
+      for (size_t blockID=0;blockID<numBlocks;blockID++)
+        blockOffset[blockID+1] += blockOffset[blockID];
+
+      std::vector<SharedFace> faces(blockOffset[numBlocks]);
+      parallel_for(numBlocks,[&](size_t blockID){
+          const size_t begin = blockID*blockSize;
+          const size_t end   = std::min(begin+blockSize,capacity);
+          size_t out = blockOffset[blockID];
+          for (size_t i=begin;i<end;i++) {
+            const Slot &s = slots[i];
+            const int x = s.x.load(std::memory_order_relaxed);
+            if (x == EMPTY) continue;
+            SharedFace &face = faces[out++];
+            face.vertexIdx = vec4i(x,s.y,s.z,s.w);
+            face.onFront   = unpack(s.front.load(std::memory_order_relaxed));
+            face.onBack    = unpack(s.back.load(std::memory_order_relaxed));
+          }
+        });
+      return faces;
+    }
+
+    const size_t             capacity;
+    std::unique_ptr<Slot[]>  slots;
+    uint64_t                 unused;
+  };
+
+  /*! tries to insert all facets of all prims into a hash table of
+      given capacity, giving up once more than 'maxFaces' faces got
+      created (to avoid long probe sequences in an almost full
+      table); returns false if it had to give up. Throws if any face
+      gets used twice from the same side */
+  bool hashFacets(std::vector<SharedFace> &result,
+                  const InputMesh &mesh,
+                  size_t capacity,
+                  size_t maxFaces)
+  {
+    const size_t numPrims
+      = mesh.numTets
+      + mesh.numPyrs
+      + mesh.numWedges
+      + mesh.numHexes;
+    FaceHashTable table(capacity);
+    std::atomic<size_t> numFaces(0);
+    std::atomic<bool>   full(false);
+    std::atomic<bool>   usedTwice(false);
+    parallel_for_blocked
+      (0,numPrims,1024,
+       [&](size_t begin, size_t end) {
+         if (full || usedTwice) return;
+         Facet facets[6];
+         size_t numNewFaces = 0;
+         for (size_t primIdx=begin;primIdx<end;primIdx++) {
+           const int numFacets = writePrimFacets(facets,primIdx,mesh);
+           size_t homeSlot[6];
+           for (int i=0;i<numFacets;i++) {
+             computeUniqueVertexOrder(facets[i]);
+             if (facets[i].vertexIdx.x < 0) continue;
+             homeSlot[i] = table.homeSlot(facets[i].vertexIdx);
+             table.prefetch(homeSlot[i]);
+           }
+           for (int i=0;i<numFacets;i++) {
+             if (facets[i].vertexIdx.x < 0) continue;
+             switch (table.insert(facets[i],homeSlot[i])) {
+             case FaceHashTable::NEW_FACE:
+               numNewFaces++;
+               break;
+             case FaceHashTable::EXISTING_FACE:
+               break;
+             case FaceHashTable::SIDE_USED_TWICE:
+               usedTwice = true;
+               return;
+             case FaceHashTable::TABLE_FULL:
+               full = true;
+               return;
+             }
+           }
+         }
+         if ((numFaces += numNewFaces) > maxFaces)
+           full = true;
+       });
+    if (usedTwice)
+      throw std::runtime_error("side is used twice!?");
+    if (full)
+      return false;
+    result = table.extractFaces();
+    return true;
+  }
+
+  /*! same as computeFaces(), but matches facets through a hash table
+      instead of sorting them: this is faster, and needs less memory
+      (no array of all facets, and no face index per facet), but
+      leaves the faces in unspecified order */
+  std::vector<SharedFace> computeFacesByHashing(const MeshView &input)
+  {
+    const InputMesh mesh = makeInputMesh(input);
+
+    const size_t numFacets
+      = 4 * mesh.numTets
+      + 5 * mesh.numPyrs
+      + 5 * mesh.numWedges
+      + 6 * mesh.numHexes;
+    if (numFacets == 0)
+      return {};
+
+    /* in a connected mesh (almost) all faces are shared by two
+       facets, so start with a table sized for that; if there are
+       more boundary faces than that table can hold, retry with one
+       that can hold every facet as a separate face */
+    std::vector<SharedFace> faces;
+    const size_t initialCapacity = numFacets - numFacets/4;
+    {
+      profile::ScopedTimer timer("FaceConn.hashFacets",0,numFacets);
+      if (!hashFacets(faces,mesh,initialCapacity,initialCapacity - initialCapacity/8)) {
+        profile::count("FaceConn.hashRetries",1);
+        hashFacets(faces,mesh,numFacets+1,numFacets);
+      }
+    }
+    return faces;
+  }
+
   // ==================================================================
   // aaaand ... wrap it all together
   // ==================================================================
 
-std::vector<SharedFace> computeFaces(UMesh::SP input)
+std::vector<SharedFace> computeFaces(const MeshView &input)
   {
-    assert(input);
     std::chrono::steady_clock::time_point
       begin_inc = std::chrono::steady_clock::now();
-    InputMesh mesh;
-    setupInput(mesh,input);
+    const InputMesh mesh = makeInputMesh(input);
 
     std::chrono::steady_clock::time_point
       begin_exc = std::chrono::steady_clock::now();
@@ -565,20 +515,34 @@ std::vector<SharedFace> computeFaces(UMesh::SP input)
           later on when it tries to access the "last" facet */
       return {};
     
-    std::vector<Facet> facets(numFacets);
-    writeFacets(facets.data(),mesh);
-    // for (int i=0;i<numFacets;i++)
-    //   std::cout << "facet " << i << " = " << facets[i] << std::endl;
-    computeUniqueVertexOrder(facets.data(),numFacets);
+    const size_t facetBytes = numFacets*sizeof(Facet);
+    ScratchVector<Facet> facets(numFacets);
+    int maxVertexIdx;
+    {
+      profile::ScopedTimer timer("FaceConn.writeFacets",facetBytes,numFacets);
+      writeFacets(facets.data(),mesh);
+      // for (int i=0;i<numFacets;i++)
+      //   std::cout << "facet " << i << " = " << facets[i] << std::endl;
+      maxVertexIdx = computeUniqueVertexOrder(facets.data(),numFacets);
+    }
 
     // -------------------------------------------------------
-    sortFacets(facets.data(),numFacets);
-    std::vector<uint64_t> faceIndices(numFacets);
-    initFaceIndices(faceIndices.data(),facets.data(),numFacets);
-    // prefixSum(faceIndices,numFacets);
-    postfixSum(faceIndices.data(),numFacets);
+    {
+      profile::ScopedTimer timer("FaceConn.sortFacets",facetBytes,numFacets);
+      sortFacets(facets.data(),numFacets,maxVertexIdx);
+    }
+    ScratchVector<uint64_t> faceIndices(numFacets);
+    {
+      profile::ScopedTimer timer("FaceConn.faceIndices",
+                                 numFacets*sizeof(uint64_t),numFacets);
+      initFaceIndices(faceIndices.data(),facets.data(),numFacets);
+      // prefixSum(faceIndices,numFacets);
+      postfixSum(faceIndices.data(),numFacets);
+    }
     // -------------------------------------------------------
     size_t numFaces = faceIndices[numFacets-1];
+    profile::ScopedTimer timer("FaceConn.writeFaces",
+                               numFaces*sizeof(SharedFace),numFaces);
     std::vector<SharedFace> faces(numFaces);
     // SharedFace *faces = result.data();//allocateFaces(result,numFaces);
     clearFaces(faces.data(),numFaces);
@@ -596,13 +560,51 @@ std::vector<SharedFace> computeFaces(UMesh::SP input)
     this mesh. Note this _sohuld_ work even for curved/bilinear faces,
     but will error out for meshes with bad connectivyt (faces with
     more than two owning prims) */
-  FaceConn::SP FaceConn::compute(UMesh::SP input)
+  FaceConn::SP FaceConn::compute(UMesh::SP input, Method method)
+  {
+    assert(input);
+    return compute(MeshView(*input),method);
+  }
+
+  FaceConn::SP FaceConn::compute(const MeshView &input, Method method)
   {
+    if (method == AUTO)
+#if UMESH_HAVE_CUDA
+      method = CUDA;
+#else
+      method = SORT;
+#endif
+    profile::ScopedTimer timer("FaceConn.compute");
     FaceConn::SP faceConn = std::make_shared<FaceConn>();
-    faceConn->faces = computeFaces(input);
+    switch (method) {
+    case HASH:
+      faceConn->faces = computeFacesByHashing(input);
+      break;
+    case CUDA:
+#if UMESH_HAVE_CUDA
+      faceConn->faces = computeFacesOnDevice(input);
+      break;
+#else
+      throw std::runtime_error("FaceConn::compute(): umesh was built without cuda support");
+#endif
+    default:
+      faceConn->faces = computeFaces(input);
+    }
+    timer.addItems(faceConn->faces.size());
     return faceConn;
   }
 
+#if UMESH_HAVE_CUDA
+  FaceConn::SP FaceConn::compute(const DeviceUMesh &mesh)
+  {
+    profile::ScopedTimer timer("FaceConn.compute");
+    FaceConn::SP faceConn = std::make_shared<FaceConn>();
+    faceConn->faces = computeFacesOnDevice(mesh);
+    timer.addItems(faceConn->faces.size());
+    return faceConn;
+  }
+#endif
+  
   /*! write - binary - to given file */
   void FaceConn::write(std::ostream &out) const
   {
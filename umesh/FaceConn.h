@@ -18,6 +18,8 @@
 #pragma once
 
 #include "umesh/UMesh.h"
+#include "umesh/DeviceUMesh.h"
+#include "umesh/MeshView.h"
 
 namespace umesh {
 
@@ -66,11 +68,33 @@ namespace umesh {
 
     typedef std::shared_ptr<FaceConn> SP;
 
+    /*! the algorithm used for finding the facets that belong to the
+        same face: SORT writes all facets of all prims into one array
+        and sorts that by vertex indices, which results in faces
+        sorted by (unique-ordered) vertex indices; HASH directly
+        inserts each prim's facets into a concurrent hash table keyed
+        by vertex indices, which is faster and needs less memory, but
+        leaves the faces in unspecified (and not necessarily
+        reproducible) order; CUDA runs the SORT algorithm on the
+        device, and produces the same faces in the same order as
+        SORT, but is only available if umesh was built with
+        UMESH_USE_CUDA. AUTO uses CUDA where available, and SORT
+        otherwise */
+    typedef enum { SORT, HASH, CUDA, AUTO } Method;
+
     /*! given a unstructured mesh, compute the face-connectivity for
         this mesh. Note this _sohuld_ work even for curved/bilinear
         faces, but will error out for meshes with bad connectivyt
         (faces with more than two owning prims) */
-    static FaceConn::SP compute(UMesh::SP mesh);
+    static FaceConn::SP compute(UMesh::SP mesh, Method method = SORT);
+    /*! same, for the (volume) elements of given view; the returned
+        faces' vertex and prim indices refer to the view's arrays */
+    static FaceConn::SP compute(const MeshView &mesh, Method method = SORT);
+#if UMESH_HAVE_CUDA
+    /*! same as compute(.., CUDA), for a mesh that already is on the
+        device */
+    static FaceConn::SP compute(const DeviceUMesh &mesh);
+#endif
 
     /*! write - binary - to given file */
     void saveTo(const std::string &fileName) const;
@@ -0,0 +1,166 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* device-side (cuda) engine for FaceConn::compute(): writes all
+   facets, sorts them, and merges the facets of each face, all on
+   the device; using the same per-facet code as the host-side
+   engines (FaceConnKernels.h) */
+
+#include "umesh/FaceConnKernels.h"
+#include "umesh/parallel_radix_sort.h"
+#ifdef __CUDACC__
+# include <thrust/sort.h>
+#endif
+
+namespace umesh {
+  namespace {
+
+  using SharedFace   = FaceConn::SharedFace;
+  using PrimFacetRef = FaceConn::PrimFacetRef;
+
+  /*! sorts facets by vertex indices, in the same order as
+      FacetComparator */
+  void sortFacets(Facet *facets, size_t numFacets)
+  {
+#ifdef __CUDACC__
+    thrust::sort(thrust::device,facets,facets+numFacets,FacetComparator());
+#else
+    auto index = [](int idx) { return uint64_t(uint32_t(idx+1)); };
+    parallel_radix_sort(facets,numFacets,[&](const Facet &facet){
+        return (index(facet.vertexIdx.z) << 32) | index(facet.vertexIdx.w);
+      });
+    parallel_radix_sort(facets,numFacets,[&](const Facet &facet){
+        return (index(facet.vertexIdx.x) << 32) | index(facet.vertexIdx.y);
+      });
+#endif
+  }
+
+  struct WriteFacets {
+    Facet     *facets;
+    InputMesh  mesh;
+    inline __umesh_gpu_device__ void operator()(size_t primIdx) const
+    { writeFacets(facets,primIdx,mesh); }
+  };
+
+  struct ComputeUniqueVertexOrder {
+    Facet *facets;
+    inline __umesh_gpu_device__ void operator()(size_t facetIdx) const
+    { computeUniqueVertexOrder(facets[facetIdx]); }
+  };
+
+  struct InitFaceIndices {
+    uint64_t    *faceIndices;
+    const Facet *facets;
+    inline __umesh_gpu_device__ void operator()(size_t facetIdx) const
+    { initFaceIndexKernel(faceIndices,facets,facetIdx); }
+  };
+
+  /*! marks both sides of all faces as unused */
+  struct ClearFaces {
+    SharedFace *faces;
+    inline __umesh_gpu_device__ void operator()(size_t faceIdx) const
+    {
+      SharedFace &face = faces[faceIdx];
+      face.vertexIdx = makeVertexIdx(-1,-1,-1,-1);
+      face.onFront.primType = face.onBack.primType = 0;
+      face.onFront.facetIdx = face.onBack.facetIdx = 0;
+      face.onFront.primIdx  = face.onBack.primIdx  = -1;
+    }
+  };
+
+  /*! lets each (non-degenerate) facet write itself into its side of
+      its face; sets 'sideUsedTwice' if that side already was in
+      use. Like on the host, this check is not thread safe, and will
+      only catch some of the faces with more than two prims */
+  struct WriteFaces {
+    SharedFace     *faces;
+    const Facet    *facets;
+    const uint64_t *faceIndices;
+    int            *sideUsedTwice;
+    inline __umesh_gpu_device__ void operator()(size_t facetIdx) const
+    {
+      const Facet facet = facets[facetIdx];
+      if (facet.vertexIdx.x < 0)
+        return;
+      SharedFace &face = faces[faceIndices[facetIdx]-1];
+      PrimFacetRef &side = facet.orientation ? face.onFront : face.onBack;
+      face.vertexIdx = facet.vertexIdx;
+      if (!(side.primIdx < 0))
+        *sideUsedTwice = 1;
+      side = facet.prim;
+    }
+  };
+
+  } // ::umesh::<anonymous>
+  
+  std::vector<SharedFace> computeFacesOnDevice(const MeshView &input)
+  {
+    return computeFacesOnDevice(*DeviceUMesh::upload(input));
+  }
+  
+  std::vector<SharedFace> computeFacesOnDevice(const DeviceUMesh &input)
+  {
+    // the kernels only ever read the elements
+    const DeviceUMeshView view = input.view();
+    InputMesh mesh;
+    mesh.tets   = (Tet   *)view.tets;   mesh.numTets   = view.numTets;
+    mesh.pyrs   = (Pyr   *)view.pyrs;   mesh.numPyrs   = view.numPyrs;
+    mesh.wedges = (Wedge *)view.wedges; mesh.numWedges = view.numWedges;
+    mesh.hexes  = (Hex   *)view.hexes;  mesh.numHexes  = view.numHexes;
+
+    const size_t numPrims
+      = mesh.numTets
+      + mesh.numPyrs
+      + mesh.numWedges
+      + mesh.numHexes;
+    const size_t numFacets
+      = 4 * mesh.numTets
+      + 5 * mesh.numPyrs
+      + 5 * mesh.numWedges
+      + 6 * mesh.numHexes;
+    if (numFacets == 0)
+      return {};
+
+    DeviceArray<Facet> facets;
+    facets.resize(numFacets);
+    launch(numPrims,WriteFacets{facets.ptr,mesh});
+    launch(numFacets,ComputeUniqueVertexOrder{facets.ptr});
+    sortFacets(facets.ptr,numFacets);
+
+    DeviceArray<uint64_t> faceIndices;
+    faceIndices.resize(numFacets);
+    launch(numFacets,InitFaceIndices{faceIndices.ptr,facets.ptr});
+    inclusiveScan(faceIndices.ptr,faceIndices.ptr,numFacets);
+    uint64_t numFaces = 0;
+    faceIndices.download(&numFaces,numFacets-1,1);
+
+    DeviceArray<SharedFace> faces;
+    faces.resize(numFaces);
+    launch(numFaces,ClearFaces{faces.ptr});
+    int sideUsedTwice = 0;
+    DeviceArray<int> error;
+    error.upload(&sideUsedTwice,1);
+    launch(numFacets,WriteFaces{faces.ptr,facets.ptr,faceIndices.ptr,error.ptr});
+    error.download(&sideUsedTwice,0,1);
+    if (sideUsedTwice)
+      throw std::runtime_error("side is used twice!?");
+
+    std::vector<SharedFace> result(numFaces);
+    faces.download(result.data(),0,numFaces);
+    return result;
+  }
+  
+} // ::umesh
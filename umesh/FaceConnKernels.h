@@ -0,0 +1,397 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* the per-facet building blocks of FaceConn::compute() - writing the
+   facets of each prim, bringing their vertices into a unique order,
+   and finding where new faces start in the sorted facets - shared by
+   the host (FaceConn.cpp) and device (FaceConnGPU.cu) engines. All
+   of these have to compile as device code, so they do not use any
+   vec4i constructors, std:: algorithms, or exceptions */
+
+#pragma once
+
+#include "umesh/FaceConn.h"
+#include "umesh/deviceHelpers.h"
+
+namespace umesh {
+
+  /*! one "face" of a given prim, defined through the (global) vertex
+      indices, the gloabl primitive index, and the (local to the prim)
+      facet index; orientation defines whether the given vertex
+      indices point inwards, or outwards, allowing to later keeping
+      track of which side of a face the given facet belons */
+  struct Facet {
+    vec4i                  vertexIdx;
+    FaceConn::PrimFacetRef prim;
+    int                    orientation;
+  };
+
+  /*! allows for sorting facets in a unqieu order based on their
+      indices, but _ignoring_ things like orientation; this allows to
+      later find facets belonding to the same face by first
+      re-ordering the facet's vertex indices ina unque way and then
+      sorting by that order (which means two facets for the same face
+      shold then end up next to each other after sorting) */
+  struct FacetComparator {
+    inline __umesh_gpu_both__
+    bool operator()(const Facet &a, const Facet &b) const {
+      return
+        (a.vertexIdx.x < b.vertexIdx.x)
+        ||
+        ((a.vertexIdx.x == b.vertexIdx.x) &&
+         (a.vertexIdx.y <  b.vertexIdx.y))
+        ||
+        ((a.vertexIdx.x == b.vertexIdx.x) &&
+         (a.vertexIdx.y == b.vertexIdx.y) &&
+         (a.vertexIdx.z <  b.vertexIdx.z))
+        ||
+        ((a.vertexIdx.x == b.vertexIdx.x) &&
+         (a.vertexIdx.y == b.vertexIdx.y) &&
+         (a.vertexIdx.z == b.vertexIdx.z) &&
+         (a.vertexIdx.w <  b.vertexIdx.w));
+    }
+  };
+
+  /*! describes input data through plain pointers, so we can run the
+    same algorithm once with std::vector::data() (on the host) or
+    cuda-malloced data (on gpu) */
+  struct InputMesh {
+    const Tet   *tets;
+    size_t       numTets;
+    const Pyr   *pyrs;
+    size_t       numPyrs;
+    const Wedge *wedges;
+    size_t       numWedges;
+    const Hex   *hexes;
+    size_t       numHexes;
+  };
+
+  /*! the input mesh for the elements of given (host-side) view */
+  inline InputMesh makeInputMesh(const MeshView &view)
+  {
+    InputMesh mesh;
+    mesh.tets   = view.tets.data();   mesh.numTets   = view.tets.size();
+    mesh.pyrs   = view.pyrs.data();   mesh.numPyrs   = view.pyrs.size();
+    mesh.wedges = view.wedges.data(); mesh.numWedges = view.wedges.size();
+    mesh.hexes  = view.hexes.data();  mesh.numHexes  = view.hexes.size();
+    return mesh;
+  }
+
+  inline __umesh_gpu_both__ vec4i makeVertexIdx(int x, int y, int z, int w)
+  {
+    vec4i idx;
+    idx.x = x; idx.y = y; idx.z = z; idx.w = w;
+    return idx;
+  }
+  
+  inline __umesh_gpu_both__ void swapIdx(int &a, int &b)
+  {
+    const int c = a; a = b; b = c;
+  }
+
+  /*! number of different values among the first N of given indices */
+  inline __umesh_gpu_both__ int numUniqueVertices(const vec4i &v, int N)
+  {
+    const int idx[4] = { v.x,v.y,v.z,v.w };
+    int cnt = 0;
+    for (int i=0;i<N;i++) {
+      bool seenBefore = false;
+      for (int j=0;j<i;j++)
+        seenBefore = seenBefore || (idx[j] == idx[i]);
+      cnt += !seenBefore;
+    }
+    return cnt;
+  }
+  
+  // ==================================================================
+  // compute vertex order stage
+  // ==================================================================
+  
+  /*! computes a unique vertex order such that two different prims
+    that share the same face - but have written thie facets with
+    differnetly ordered vertex indices - will end up with the same
+    vector of indices. of course, re-ordeirng indices can change
+    orientation, which this function keeps track of */
+  inline __umesh_gpu_both__
+  void computeUniqueVertexOrder(Facet &facet)
+  {
+    vec4i idx = facet.vertexIdx;
+    
+    if (idx.w < 0) {
+      int numUnique = numUniqueVertices(idx,3);
+      if (numUnique < 3) {
+        facet.vertexIdx = makeVertexIdx(-1,-1,-1,-1);
+        return;
+      }
+      if (idx.y < idx.x)
+        { swapIdx(idx.x,idx.y); facet.orientation = 1-facet.orientation; }
+      if (idx.z < idx.x)
+        { swapIdx(idx.x,idx.z); facet.orientation = 1-facet.orientation; }
+      if (idx.z < idx.y)
+        { swapIdx(idx.y,idx.z); facet.orientation = 1-facet.orientation; }
+    } else {
+      int numUnique = numUniqueVertices(idx,4);
+      
+      if (numUnique == 2) {
+        facet.vertexIdx = makeVertexIdx(-1,-1,-1,-1);
+        return;
+      }
+      
+      if (numUnique == 3) {
+        /* exactly one pair of indices is the same, so one of these
+           cases always applies */
+        if (idx.x==idx.y) {
+          idx = makeVertexIdx( idx.x, idx.z, idx.w, -1 );
+        } else if (idx.x == idx.z) {
+          // oooooh... this one is fishy
+          idx = makeVertexIdx( idx.x, idx.y, idx.w, -1 );
+        } else if (idx.x == idx.w) {
+          idx = makeVertexIdx( idx.x, idx.y, idx.z, -1 );
+        } else if (idx.y == idx.z) {
+          idx = makeVertexIdx( idx.x, idx.y, idx.w, -1 );
+        } else if (idx.y == idx.w) {
+          // oooooh... this one is fishy
+          idx = makeVertexIdx( idx.x, idx.y, idx.z, -1 );
+        } else {
+          idx = makeVertexIdx( idx.x, idx.y, idx.z, -1 );
+        }
+        
+        if (idx.y < idx.x)
+          { swapIdx(idx.x,idx.y); facet.orientation = 1-facet.orientation; }
+        if (idx.z < idx.x)
+          { swapIdx(idx.x,idx.z); facet.orientation = 1-facet.orientation; }
+        if (idx.z < idx.y)
+          { swapIdx(idx.y,idx.z); facet.orientation = 1-facet.orientation; }
+      } else {
+
+        int lv = idx.x, li=0;
+        if (idx.y < lv) { lv = idx.y; li = 1; }
+        if (idx.z < lv) { lv = idx.z; li = 2; }
+        if (idx.w < lv) { lv = idx.w; li = 3; }
+
+        switch (li) {
+        case 0: idx = makeVertexIdx( idx.x,idx.y,idx.z,idx.w ); break;
+        case 1: idx = makeVertexIdx( idx.y,idx.z,idx.w,idx.x ); break;
+        case 2: idx = makeVertexIdx( idx.z,idx.w,idx.x,idx.y ); break;
+        case 3: idx = makeVertexIdx( idx.w,idx.x,idx.y,idx.z ); break;
+        };
+
+        if (idx.w < idx.y) {
+          facet.orientation = 1-facet.orientation;
+          swapIdx(idx.w,idx.y);
+        }
+      }
+    }
+    facet.vertexIdx = idx;
+  }
+
+  // ==================================================================
+  // init faces
+  // ==================================================================
+  
+  /*! writes the four facets of a tet; for degenerate tets that may
+    end up with faces that collapse to points or lines - that's OK,
+    as it'll be fixed later on in computeUniqueVertexOrder() */
+  inline __umesh_gpu_both__
+  void writeTetFacets(Facet *facets,
+                      size_t tetIdx,
+                      InputMesh mesh
+                      )
+  {
+    for (int i=0;i<4;i++) facets[i].prim.primType = UMesh::TET;
+    for (int i=0;i<4;i++) facets[i].prim.facetIdx = i;
+    for (int i=0;i<4;i++) facets[i].prim.primIdx  = tetIdx;
+    for (int i=0;i<4;i++) facets[i].orientation   = 0;
+
+    vec4i tet = mesh.tets[tetIdx];
+
+    facets[0].vertexIdx = makeVertexIdx( tet.y,tet.w,tet.z,-1 );
+    facets[1].vertexIdx = makeVertexIdx( tet.x,tet.z,tet.w,-1 );
+    facets[2].vertexIdx = makeVertexIdx( tet.x,tet.w,tet.y,-1 );
+    facets[3].vertexIdx = makeVertexIdx( tet.x,tet.y,tet.z,-1 );
+  }
+  
+  /*! writes the five facets of a pyrs; for degenerate pyramids thta
+    may end up with quads that become triangles, and/or entire faces
+    that collapse to points or lines - that's OK, as it'll be fixed
+    later on in computeUniqueVertexOrder() */
+  inline __umesh_gpu_both__
+  void writePyrFacets(Facet *facets,
+                      size_t pyrIdx,
+                      InputMesh mesh
+                      )
+  {
+    for (int i=0;i<5;i++) facets[i].prim.primType = UMesh::PYR;
+    for (int i=0;i<5;i++) facets[i].prim.facetIdx = i;
+    for (int i=0;i<5;i++) facets[i].prim.primIdx  = pyrIdx;
+    for (int i=0;i<5;i++) facets[i].orientation   = 0;
+    
+    UMesh::Pyr pyr = mesh.pyrs[pyrIdx];
+    vec4i base = pyr.base;
+    facets[0].vertexIdx = makeVertexIdx( pyr.top,base.y,base.x,-1 );
+    facets[1].vertexIdx = makeVertexIdx( pyr.top,base.z,base.y,-1 );
+    facets[2].vertexIdx = makeVertexIdx( pyr.top,base.w,base.z,-1 );
+    facets[3].vertexIdx = makeVertexIdx( pyr.top,base.x,base.w,-1 );
+    facets[4].vertexIdx = makeVertexIdx( base.x,base.y,base.z,base.w );
+  }
+
+  /*! writes the five facets of a wedge; for degenerate wedges thta
+    may end up with quads that become triangles, and/or entire faces
+    that collapse to points or lines - that's OK, as it'll be fixed
+    later on in computeUniqueVertexOrder() */
+  inline __umesh_gpu_both__
+  void writeWedgeFacets(Facet *facets,
+                        size_t wedgeIdx,
+                        InputMesh mesh
+                        )
+  {
+    for (int i=0;i<5;i++) facets[i].prim.primType = UMesh::WEDGE;
+    for (int i=0;i<5;i++) facets[i].prim.facetIdx = i;
+    for (int i=0;i<5;i++) facets[i].prim.primIdx  = wedgeIdx;
+    for (int i=0;i<5;i++) facets[i].orientation   = 0;
+    
+    UMesh::Wedge wedge = mesh.wedges[wedgeIdx];
+    int i0 = wedge.front.x;
+    int i1 = wedge.front.y;
+    int i2 = wedge.front.z;
+    int i3 = wedge.back.x;
+    int i4 = wedge.back.y;
+    int i5 = wedge.back.z;
+
+    facets[0].vertexIdx = makeVertexIdx( i0,i2,i1,-1 );
+    facets[1].vertexIdx = makeVertexIdx( i3,i4,i5,-1 );
+    facets[2].vertexIdx = makeVertexIdx( i0,i3,i5,i2 );
+    facets[3].vertexIdx = makeVertexIdx( i1,i2,i5,i4 );
+    facets[4].vertexIdx = makeVertexIdx( i0,i1,i4,i3 );
+  }
+  
+  /*! writes the five facets of a hexes; for degenerate hexes that may
+    end up with quads that become triangles, and/or entire faces
+    that collapse to points or lines - that's OK, as it'll be fixed
+    later on in computeUniqueVertexOrder() */
+  inline __umesh_gpu_both__
+  void writeHexFacets(Facet *facets,
+                      size_t hexIdx,
+                      InputMesh mesh
+                      )
+  {
+    for (int i=0;i<6;i++) facets[i].prim.primType = UMesh::HEX;
+    for (int i=0;i<6;i++) facets[i].prim.facetIdx = i;
+    for (int i=0;i<6;i++) facets[i].prim.primIdx  = hexIdx;
+    for (int i=0;i<6;i++) facets[i].orientation   = 0;
+    
+    UMesh::Hex hex = mesh.hexes[hexIdx];
+    int i0 = hex.base.x;
+    int i1 = hex.base.y;
+    int i2 = hex.base.z;
+    int i3 = hex.base.w;
+    int i4 = hex.top.x;
+    int i5 = hex.top.y;
+    int i6 = hex.top.z;
+    int i7 = hex.top.w;
+
+    facets[0].vertexIdx = makeVertexIdx( i0,i1,i2,i3 );
+    facets[1].vertexIdx = makeVertexIdx( i4,i7,i6,i5 );
+    facets[2].vertexIdx = makeVertexIdx( i0,i4,i5,i1 );
+    facets[3].vertexIdx = makeVertexIdx( i2,i6,i7,i3 );
+    facets[4].vertexIdx = makeVertexIdx( i1,i5,i6,i2 );
+    facets[5].vertexIdx = makeVertexIdx( i0,i3,i7,i4 );
+  }
+
+  /*! writes the facets given by the parallel launch that runs over
+    all facets in the model */
+  inline __umesh_gpu_both__
+  void writeFacets(Facet *facets, size_t jobIdx, const InputMesh &mesh)
+  {
+    // write tets
+    if (jobIdx < mesh.numTets) {
+      writeTetFacets(facets+4*jobIdx,jobIdx,mesh);
+      return;
+    }
+    facets += 4*mesh.numTets;
+    jobIdx -= mesh.numTets;
+  
+    // write pyramids
+    if (jobIdx < mesh.numPyrs) {
+      writePyrFacets(facets+5*jobIdx,jobIdx,mesh);
+      return;
+    }
+    facets += 5*mesh.numPyrs;
+    jobIdx -= mesh.numPyrs;
+  
+    // write wedges
+    if (jobIdx < mesh.numWedges) {
+      writeWedgeFacets(facets+5*jobIdx,jobIdx,mesh);
+      return;
+    }
+    facets += 5*mesh.numWedges;
+    jobIdx -= mesh.numWedges;
+  
+    // write hexes
+    if (jobIdx < mesh.numHexes) {
+      writeHexFacets(facets+6*jobIdx,jobIdx,mesh);
+      return;
+    }
+    return;
+  }
+
+  /*! writes the facets of given prim (indexed the same way as in
+      writeFacets()) into the given array, and returns how many were
+      written */
+  inline __umesh_gpu_both__
+  int writePrimFacets(Facet *facets, size_t jobIdx, const InputMesh &mesh)
+  {
+    if (jobIdx < mesh.numTets)
+      { writeTetFacets(facets,jobIdx,mesh); return 4; }
+    jobIdx -= mesh.numTets;
+    if (jobIdx < mesh.numPyrs)
+      { writePyrFacets(facets,jobIdx,mesh); return 5; }
+    jobIdx -= mesh.numPyrs;
+    if (jobIdx < mesh.numWedges)
+      { writeWedgeFacets(facets,jobIdx,mesh); return 5; }
+    jobIdx -= mesh.numWedges;
+    writeHexFacets(facets,jobIdx,mesh);
+    return 6;
+  }
+
+  // ==================================================================
+  // compute face indices from (sorted) facet array
+  // ==================================================================
+
+  /*! flags each (sorted) facet whose vertices differ from those of
+      the facet before it, ie, that starts a new face */
+  inline __umesh_gpu_both__
+  void initFaceIndexKernel(uint64_t *faceIndices,
+                           const Facet *facets,
+                           size_t facetIdx)
+  {
+    faceIndices[facetIdx]
+      =  (facetIdx == 0)
+      || (facets[facetIdx-1].vertexIdx.x != facets[facetIdx].vertexIdx.x)
+      || (facets[facetIdx-1].vertexIdx.y != facets[facetIdx].vertexIdx.y)
+      || (facets[facetIdx-1].vertexIdx.z != facets[facetIdx].vertexIdx.z)
+      || (facets[facetIdx-1].vertexIdx.w != facets[facetIdx].vertexIdx.w);
+  }
+  
+#if UMESH_HAVE_CUDA
+  /*! the same (sort-based) algorithm as FaceConn::compute(.., SORT),
+      but running on the device; see FaceConnGPU.cu */
+  std::vector<FaceConn::SharedFace> computeFacesOnDevice(const MeshView &input);
+  /*! same, for a mesh that already is on the device */
+  std::vector<FaceConn::SharedFace> computeFacesOnDevice(const DeviceUMesh &input);
+#endif
+  
+} // ::umesh
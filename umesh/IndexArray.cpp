@@ -0,0 +1,183 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "umesh/IndexArray.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+namespace umesh {
+
+  /*! block size (in IndexArray blocks) for parallel encoding and
+      decoding */
+  const size_t blocksPerTask = 256;
+
+  template<typename Index>
+  IndexArray IndexArray::encode(const Index *indices, size_t count,
+                                IndexWidth minWidth)
+  {
+    IndexArray result;
+    result.count = count;
+    const size_t numBlocks = divRoundUp(count,blockSize);
+    result.blockBase.resize(numBlocks);
+
+    // first pass: each block's base, and the largest difference to
+    // it (over all blocks), to choose the width from
+    std::atomic<uint64_t> maxDelta(0);
+    std::atomic<uint64_t> maxIndex(0);
+    std::atomic<bool>     negative(false);
+    parallel_for_blocked
+      (0,numBlocks,blocksPerTask,
+       [&](size_t begin, size_t end) {
+         uint64_t taskMaxDelta = 0, taskMaxIndex = 0;
+         for (size_t blockID=begin;blockID<end;blockID++) {
+           const size_t blockBegin = blockID*blockSize;
+           const size_t blockEnd   = std::min(blockBegin+blockSize,count);
+           uint64_t lo = std::numeric_limits<uint64_t>::max(), hi = 0;
+           for (size_t i=blockBegin;i<blockEnd;i++) {
+             if (indices[i] < 0) negative = true;
+             const uint64_t idx = uint64_t(indices[i]);
+             lo = std::min(lo,idx);
+             hi = std::max(hi,idx);
+           }
+           result.blockBase[blockID] = lo;
+           taskMaxDelta = std::max(taskMaxDelta,hi-lo);
+           taskMaxIndex = std::max(taskMaxIndex,hi);
+         }
+         uint64_t current = maxDelta.load();
+         while (taskMaxDelta > current &&
+                !maxDelta.compare_exchange_weak(current,taskMaxDelta));
+         current = maxIndex.load();
+         while (taskMaxIndex > current &&
+                !maxIndex.compare_exchange_weak(current,taskMaxIndex));
+       });
+    if (negative)
+      throw std::runtime_error("#umesh.IndexArray: cannot encode negative indices");
+    result.maxIndex = maxIndex;
+    
+    result.width
+      = (maxDelta > std::numeric_limits<uint32_t>::max())
+      ? INDEX_WIDTH_64
+      : ((maxDelta > std::numeric_limits<uint16_t>::max())
+         ? INDEX_WIDTH_32
+         : INDEX_WIDTH_16);
+    result.width = std::max(result.width,minWidth);
+
+    // second pass: write the differences
+    result.deltas.resize(count*result.width);
+    parallel_for_blocked
+      (0,numBlocks,blocksPerTask,
+       [&](size_t begin, size_t end) {
+         for (size_t blockID=begin;blockID<end;blockID++) {
+           const size_t blockBegin = blockID*blockSize;
+           const size_t blockEnd   = std::min(blockBegin+blockSize,count);
+           const uint64_t base = result.blockBase[blockID];
+           for (size_t i=blockBegin;i<blockEnd;i++) {
+             const uint64_t delta = uint64_t(indices[i])-base;
+             uint8_t *ptr = result.deltas.data()+i*result.width;
+             switch (result.width) {
+             case INDEX_WIDTH_16: { const uint16_t d = uint16_t(delta); memcpy(ptr,&d,sizeof(d)); } break;
+             case INDEX_WIDTH_32: { const uint32_t d = uint32_t(delta); memcpy(ptr,&d,sizeof(d)); } break;
+             case INDEX_WIDTH_64: { memcpy(ptr,&delta,sizeof(delta)); } break;
+             }
+           }
+         }
+       });
+    return result;
+  }
+
+  template<typename Index>
+  void IndexArray::decode(Index *out) const
+  {
+    if (count && maxIndex > uint64_t(std::numeric_limits<Index>::max()))
+      throw std::runtime_error("#umesh.IndexArray: indices do not fit into "
+                               +std::to_string(8*sizeof(Index))+"-bit indices");
+    const size_t numBlocks = divRoundUp(count,blockSize);
+    parallel_for_blocked
+      (0,numBlocks,blocksPerTask,
+       [&](size_t begin, size_t end) {
+         for (size_t blockID=begin;blockID<end;blockID++) {
+           const size_t blockBegin = blockID*blockSize;
+           const size_t blockEnd   = std::min(blockBegin+blockSize,count);
+           for (size_t i=blockBegin;i<blockEnd;i++)
+             out[i] = Index((*this)[i]);
+         }
+       });
+  }
+
+  template IndexArray IndexArray::encode(const int32_t *, size_t, IndexWidth);
+  template IndexArray IndexArray::encode(const uint32_t *, size_t, IndexWidth);
+  template IndexArray IndexArray::encode(const int64_t *, size_t, IndexWidth);
+  template IndexArray IndexArray::encode(const uint64_t *, size_t, IndexWidth);
+  template void IndexArray::decode(int32_t *) const;
+  template void IndexArray::decode(uint32_t *) const;
+  template void IndexArray::decode(int64_t *) const;
+  template void IndexArray::decode(uint64_t *) const;
+
+  /*! all of the prims' indices are ints, and each prim is just its
+      numVertices indices, in order */
+  template<typename Prim>
+  IndexArray encodePrims(const std::vector<Prim> &prims, IndexWidth minWidth)
+  {
+    static_assert(sizeof(Prim) == Prim::numVertices*sizeof(int),
+                  "prims are expected to be plain arrays of int indices");
+    return IndexArray::encode((const int *)prims.data(),
+                              prims.size()*Prim::numVertices,minWidth);
+  }
+  
+  template<typename Prim>
+  void decodePrims(std::vector<Prim> &prims, const IndexArray &indices)
+  {
+    if (indices.size() % Prim::numVertices)
+      throw std::runtime_error("#umesh.CompactElements: number of indices "
+                               "is not a multiple of the prim's vertex count");
+    // decode first, so 'prims' remain unchanged if that fails
+    std::vector<Prim> decoded(indices.size()/Prim::numVertices);
+    indices.decode((int *)decoded.data());
+    prims = std::move(decoded);
+  }
+  
+  CompactElements CompactElements::encode(const UMesh &mesh, IndexWidth minWidth)
+  {
+    CompactElements result;
+    result.triangles = encodePrims(mesh.triangles,minWidth);
+    result.quads     = encodePrims(mesh.quads,minWidth);
+    result.tets      = encodePrims(mesh.tets,minWidth);
+    result.pyrs      = encodePrims(mesh.pyrs,minWidth);
+    result.wedges    = encodePrims(mesh.wedges,minWidth);
+    result.hexes     = encodePrims(mesh.hexes,minWidth);
+    return result;
+  }
+    
+  void CompactElements::decodeInto(UMesh &mesh) const
+  {
+    decodePrims(mesh.triangles,triangles);
+    decodePrims(mesh.quads,quads);
+    decodePrims(mesh.tets,tets);
+    decodePrims(mesh.pyrs,pyrs);
+    decodePrims(mesh.wedges,wedges);
+    decodePrims(mesh.hexes,hexes);
+  }
+
+  size_t CompactElements::numBytes() const
+  {
+    return triangles.numBytes() + quads.numBytes()
+      + tets.numBytes() + pyrs.numBytes()
+      + wedges.numBytes() + hexes.numBytes();
+  }
+  
+} // ::umesh
@@ -0,0 +1,110 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include <cstring>
+
+namespace umesh {
+
+  /*! number of bytes an IndexArray stores each index in */
+  typedef enum {
+    INDEX_WIDTH_16 = 2,
+    INDEX_WIDTH_32 = 4,
+    INDEX_WIDTH_64 = 8
+  } IndexWidth;
+  
+  /*! a compact array of vertex indices (of any width, up to 64 bits):
+      indices get stored in blocks of 'blockSize', each as the
+      difference to its block's smallest index, in the narrowest
+      width that fits all blocks' differences. Brick-local meshes
+      (as produced by the partitioners), and meshes whose elements
+      refer to nearby vertices, thus typically get away with 16 bits
+      per index; while meshes with more than 2^31 vertices - which
+      UMesh's int-based elements cannot address - can still be
+      stored with 64-bit ones */
+  struct IndexArray {
+    /*! number of indices that share the same base index */
+    static const size_t blockSize = 256;
+
+    /*! encodes the given indices; 'minWidth' is the narrowest width
+        to use even if the indices' differences would fit into fewer
+        bytes */
+    template<typename Index>
+    static IndexArray encode(const Index *indices, size_t count,
+                             IndexWidth minWidth = INDEX_WIDTH_16);
+    
+    /*! decodes all indices into 'out', which must have space for
+        size() indices; throws if any index does not fit into an
+        'Index' */
+    template<typename Index>
+    void decode(Index *out) const;
+    
+    /*! the i'th index */
+    inline uint64_t operator[](size_t i) const
+    {
+      const uint8_t *ptr = deltas.data()+i*width;
+      uint64_t delta = 0;
+      switch (width) {
+      case INDEX_WIDTH_16: { uint16_t d; memcpy(&d,ptr,sizeof(d)); delta = d; } break;
+      case INDEX_WIDTH_32: { uint32_t d; memcpy(&d,ptr,sizeof(d)); delta = d; } break;
+      case INDEX_WIDTH_64: { memcpy(&delta,ptr,sizeof(delta)); } break;
+      }
+      return blockBase[i/blockSize]+delta;
+    }
+
+    inline size_t size() const { return count; }
+    
+    /*! number of bytes used for storing the indices */
+    inline size_t numBytes() const
+    { return deltas.size()+blockBase.size()*sizeof(uint64_t); }
+    
+    IndexWidth            width    = INDEX_WIDTH_16;
+    size_t                count    = 0;
+    /*! largest index in the array (0 if empty) */
+    uint64_t              maxIndex = 0;
+    /*! smallest index of each block */
+    std::vector<uint64_t> blockBase;
+    /*! each index' difference to its block's base, 'width' bytes each */
+    std::vector<uint8_t>  deltas;
+  };
+
+  /*! the element connectivity of a mesh (all its surface and volume
+      elements' vertex indices, but not the grids, which don't have
+      any), stored as compact IndexArrays; eg, for keeping many
+      bricks in (host or device) memory, where index memory
+      dominates */
+  struct CompactElements {
+    /*! encodes all of given mesh's elements */
+    static CompactElements encode(const UMesh &mesh,
+                                  IndexWidth minWidth = INDEX_WIDTH_16);
+    
+    /*! replaces given mesh's surface and volume elements with the
+        decoded ones; throws if any index does not fit into the int's
+        that UMesh elements use */
+    void decodeInto(UMesh &mesh) const;
+
+    /*! number of bytes used for all elements' indices */
+    size_t numBytes() const;
+    
+    /*! the elements' vertex indices, in order - ie, numVertices
+        indices for the first element, then for the second, etc */
+    IndexArray triangles, quads, tets, pyrs, wedges, hexes;
+  };
+  
+} // ::umesh
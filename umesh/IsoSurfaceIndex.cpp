@@ -0,0 +1,216 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/IsoSurfaceIndex.h"
+#include "umesh/parallel_radix_sort.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace umesh {
+
+  typedef IsoSurfaceIndex::Cell Cell;
+
+  /*! max number of values we look at to determine the bin
+      boundaries */
+  const size_t maxBinningSamples = 64*1024;
+
+  IsoSurfaceIndex::IsoSurfaceIndex(UMesh::SP mesh)
+    : mesh(mesh)
+  {}
+
+  /*! computes the value range of given prim, with NaN values counting
+      as -infinity (the same way extractIsoSurface treats them) */
+  template<typename Prim>
+  inline void getValueRange(const UMesh &mesh, const Prim &prim,
+                            float &lo, float &hi)
+  {
+    lo = +std::numeric_limits<float>::infinity();
+    hi = -std::numeric_limits<float>::infinity();
+    for (int i=0;i<Prim::numVertices;i++) {
+      float value = mesh.perVertex->values[prim[i]];
+      if (std::isnan(value)) value = -std::numeric_limits<float>::infinity();
+      lo = std::min(lo,value);
+      hi = std::max(hi,value);
+    }
+  }
+
+  /*! computes the value range of all of given grid's scalars, with
+      NaN values counting as -infinity; note this can differ from the
+      grid's domain.lower.w, which ignores NaNs */
+  inline void getValueRange(const UMesh &mesh, const Grid &grid,
+                            float &lo, float &hi)
+  {
+    lo = +std::numeric_limits<float>::infinity();
+    hi = -std::numeric_limits<float>::infinity();
+    if (grid.numCells.x <= 0 || grid.numCells.y <= 0 || grid.numCells.z <= 0)
+      return;
+    if (grid.scalarsOffset < 0 ||
+        grid.scalarsOffset+grid.numScalars() > mesh.gridScalars.size())
+      throw std::runtime_error("grid scalars out of range");
+    const float *scalars = mesh.gridScalars.data()+grid.scalarsOffset;
+    for (size_t i=0;i<grid.numScalars();i++) {
+      float value = scalars[i];
+      if (std::isnan(value)) value = -std::numeric_limits<float>::infinity();
+      lo = std::min(lo,value);
+      hi = std::max(hi,value);
+    }
+  }
+
+  /*! appends all non-constant prims of given list to 'cells', in
+      order; each block of prims gathers its cells locally, which then
+      get concatenated in block order */
+  template<typename Prim>
+  void addCells(std::vector<Cell> &cells,
+                const UMesh &mesh,
+                const std::vector<Prim> &prims,
+                UMesh::PrimType type)
+  {
+    const size_t blockSize = 16*1024;
+    const size_t numBlocks = divRoundUp(prims.size(),blockSize);
+    std::vector<std::vector<Cell>> blockCells(numBlocks);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,prims.size());
+        for (size_t i=begin;i<end;i++) {
+          Cell cell;
+          getValueRange(mesh,prims[i],cell.lo,cell.hi);
+          if (!(cell.lo < cell.hi)) continue;
+          cell.primRef = UMesh::PrimRef(type,i);
+          blockCells[blockID].push_back(cell);
+        }
+      });
+
+    std::vector<size_t> blockOffset(numBlocks+1,cells.size());
+    for (size_t blockID=0;blockID<numBlocks;blockID++)
+      blockOffset[blockID+1] = blockOffset[blockID]+blockCells[blockID].size();
+    cells.resize(blockOffset[numBlocks]);
+    parallel_for(numBlocks,[&](size_t blockID){
+        std::vector<Cell> &local = blockCells[blockID];
+        std::copy(local.begin(),local.end(),cells.begin()+blockOffset[blockID]);
+        std::vector<Cell>().swap(local);
+      });
+  }
+
+  int IsoSurfaceIndex::binOf(float value) const
+  {
+    const int bin = int(std::upper_bound(binBoundary.begin(),binBoundary.end(),value)
+                        - binBoundary.begin()) - 1;
+    return std::max(0,std::min(numBins-1,bin));
+  }
+
+  IsoSurfaceIndex::SP IsoSurfaceIndex::build(UMesh::SP mesh)
+  {
+    if (!mesh) throw std::runtime_error("null input mesh");
+    if (!mesh->perVertex &&
+        !(mesh->tets.empty() && mesh->pyrs.empty() && mesh->wedges.empty() && mesh->hexes.empty()))
+      throw std::runtime_error("input mesh w/o scalar field");
+
+    IsoSurfaceIndex::SP index = std::make_shared<IsoSurfaceIndex>(mesh);
+    std::vector<Cell> &cells = index->cells;
+    addCells(cells,*mesh,mesh->tets,  UMesh::TET);
+    addCells(cells,*mesh,mesh->pyrs,  UMesh::PYR);
+    addCells(cells,*mesh,mesh->wedges,UMesh::WEDGE);
+    addCells(cells,*mesh,mesh->hexes, UMesh::HEX);
+    addCells(cells,*mesh,mesh->grids, UMesh::GRID);
+
+    // bin boundaries at the quantiles of (a sample of) all lo and hi
+    // values
+    std::vector<float> samples;
+    const size_t stride = std::max(size_t(1),2*cells.size()/maxBinningSamples);
+    for (size_t i=0;i<cells.size();i+=stride) {
+      samples.push_back(cells[i].lo);
+      samples.push_back(cells[i].hi);
+    }
+    std::sort(samples.begin(),samples.end());
+    index->binBoundary.resize(numBins+1,0.f);
+    if (!samples.empty()) {
+      for (int i=0;i<numBins;i++)
+        index->binBoundary[i] = samples[i*samples.size()/numBins];
+      index->binBoundary[numBins] = samples.back();
+    }
+
+    // sort cells into their buckets; the sort is stable, so within
+    // each bucket cells remain sorted by type and ID
+    auto bucketOf = [&](const Cell &cell) {
+      return uint32_t(index->binOf(cell.lo)*numBins+index->binOf(cell.hi));
+    };
+    parallel_radix_sort(cells,bucketOf);
+
+    index->bucketBegin.resize(numBins*numBins+1);
+    parallel_for(numBins*numBins+1,[&](size_t bucket){
+        index->bucketBegin[bucket]
+          = std::lower_bound(cells.begin(),cells.end(),uint32_t(bucket),
+                             [&](const Cell &cell, uint32_t bucket)
+                             { return bucketOf(cell) < bucket; })
+          - cells.begin();
+      });
+
+    if (verbose)
+      std::cout << "#umesh.iso: built iso-surface index over "
+                << prettyNumber(cells.size()) << " non-constant cells" << std::endl;
+    return index;
+  }
+
+  /*! sorts given prim refs by type, then ID */
+  void sortByTypeAndID(std::vector<UMesh::PrimRef> &primRefs)
+  {
+    parallel_radix_sort(primRefs,[](const UMesh::PrimRef &pr)
+                        { return (uint64_t(pr.type)<<60) | uint64_t(pr.ID); });
+  }
+
+  std::vector<UMesh::PrimRef>
+  IsoSurfaceIndex::findActiveCells(float isoValue) const
+  {
+    std::vector<UMesh::PrimRef> result;
+    if (std::isnan(isoValue)) return result;
+
+    const int bin = binOf(isoValue);
+    /* all buckets (lo,hi) with lo <= bin <= hi can contain active
+       cells; those with lo < bin < hi contain only active ones */
+    for (int lo=0;lo<=bin;lo++)
+      for (int hi=bin;hi<numBins;hi++) {
+        const size_t begin = bucketBegin[lo*numBins+hi];
+        const size_t end   = bucketBegin[lo*numBins+hi+1];
+        const bool allActive = (lo < bin && hi > bin);
+        for (size_t i=begin;i<end;i++)
+          if (allActive || (cells[i].lo <= isoValue && isoValue < cells[i].hi))
+            result.push_back(cells[i].primRef);
+      }
+    sortByTypeAndID(result);
+    return result;
+  }
+
+  std::vector<UMesh::PrimRef>
+  IsoSurfaceIndex::findActiveCells(const std::vector<float> &isoValues) const
+  {
+    if (isoValues.size() == 1)
+      return findActiveCells(isoValues[0]);
+
+    std::vector<UMesh::PrimRef> result;
+    for (float isoValue : isoValues) {
+      std::vector<UMesh::PrimRef> active = findActiveCells(isoValue);
+      result.insert(result.end(),active.begin(),active.end());
+    }
+    sortByTypeAndID(result);
+    result.erase(std::unique(result.begin(),result.end(),
+                             [](const UMesh::PrimRef &a, const UMesh::PrimRef &b)
+                             { return a.as_size_t == b.as_size_t; }),
+                 result.end());
+    return result;
+  }
+
+} // ::umesh
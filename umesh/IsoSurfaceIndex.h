@@ -0,0 +1,88 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! a "span space" index over the scalar value ranges of a mesh's
+      volumetric cells (tets, pyramids, wedges, hexes, and grids),
+      that allows for finding all cells that can produce iso-surface
+      triangles for a given iso-value (the "active" cells) without
+      having to look at all the others.
+
+      Each cell's value range [lo,hi] is a point in the 2D (lo,hi)
+      "span space"; we bin both axes into numBins bins (with bin
+      boundaries at quantiles of the values, so bins are roughly
+      equally populated), and store the cells in bucket order. For a
+      given iso-value, all cells in buckets that lie entirely on the
+      active side get returned without any test, and only the cells
+      in the iso-value's row and column of buckets have to be
+      tested. Cells with constant values can never be active, and
+      don't get stored at all.
+
+      The index refers to the mesh it was built for, and has to be
+      rebuilt if that mesh's elements or scalars change. */
+  struct IsoSurfaceIndex {
+    typedef std::shared_ptr<IsoSurfaceIndex> SP;
+
+    /*! number of bins along each axis of the span space */
+    static const int numBins = 64;
+
+    /*! builds the index over all volumetric cells of given mesh,
+        which must have a per-vertex scalar field if it has any
+        unstructured elements; grids get indexed as a whole */
+    static IsoSurfaceIndex::SP build(UMesh::SP mesh);
+
+    /*! returns all cells that can produce triangles for given
+        iso-value - ie, that have (at least) one vertex with a value
+        above the iso-value, and one that's not - sorted by type and
+        ID */
+    std::vector<UMesh::PrimRef> findActiveCells(float isoValue) const;
+
+    /*! same as findActiveCells(float), but returns all cells that are
+        active for any of the given iso-values, each only once */
+    std::vector<UMesh::PrimRef>
+    findActiveCells(const std::vector<float> &isoValues) const;
+
+    /*! the mesh this index was built for */
+    const UMesh::SP mesh;
+
+    IsoSurfaceIndex(UMesh::SP mesh);
+
+    struct Cell {
+      /*! the cell's value range, with NaN values counting as
+          -infinity  */
+      float   lo, hi;
+      UMesh::PrimRef primRef;
+    };
+
+    /*! the span-space bin that given value falls into */
+    int binOf(float value) const;
+
+    /*! the numBins+1 bin boundaries, in ascending order */
+    std::vector<float>    binBoundary;
+    /*! all non-constant cells, sorted by bucket */
+    std::vector<Cell>     cells;
+    /*! for each of the numBins x numBins buckets, the index of its
+        first cell in 'cells' (plus one final entry for the total
+        number of cells) */
+    std::vector<size_t>   bucketBegin;
+  };
+
+} // ::umesh
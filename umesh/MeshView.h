@@ -0,0 +1,95 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! a non-owning, read-only range of 'count' elements of type T,
+      starting at 'ptr': all or part of a std::vector, an array in a
+      memory-mapped file, or any other contiguous array the user
+      owns. Whoever creates a span has to keep the memory it points
+      to alive (and unchanged) for as long as the span is in use */
+  template<typename T>
+  struct Span {
+    inline Span() = default;
+    inline Span(const T *ptr, size_t count) : ptr(ptr), count(count) {}
+    inline Span(const std::vector<T> &vec) : ptr(vec.data()), count(vec.size()) {}
+
+    inline size_t   size()  const { return count; }
+    inline bool     empty() const { return count == 0; }
+    inline const T *data()  const { return ptr; }
+    inline const T *begin() const { return ptr; }
+    inline const T *end()   const { return ptr+count; }
+    inline const T &operator[](size_t i) const
+    { assert(i < count); return ptr[i]; }
+
+    /*! the 'count' elements starting at 'begin' */
+    inline Span sub(size_t begin, size_t count) const
+    { assert(begin+count <= this->count); return Span(ptr+begin,count); }
+
+    const T *ptr   = nullptr;
+    size_t   count = 0;
+  };
+
+  /*! a non-owning view of a mesh's vertices, per-vertex scalars, and
+      element arrays, for algorithms that only ever read those. Since
+      a view is just pointers and sizes, it can describe data that
+      is not in a UMesh - eg, a memory-mapped file
+      (io::MappedUMesh::view()), or sub-ranges of, or the user's own,
+      arrays - without copying any of it. Element vertex indices
+      refer to 'vertices'; 'scalars' is either empty, or has one value
+      per vertex. Unlike a UMesh a view does not have any names, tags,
+      or other attributes */
+  struct MeshView {
+    MeshView() = default;
+    /*! a view of all of given mesh's arrays, with its 'perVertex' (if
+        any) as the scalars; only valid as long as the mesh's arrays
+        don't change */
+    MeshView(const UMesh &mesh)
+      : vertices(mesh.vertices),
+        scalars(mesh.perVertex ? Span<float>(mesh.perVertex->values) : Span<float>()),
+        triangles(mesh.triangles),
+        quads(mesh.quads),
+        tets(mesh.tets),
+        pyrs(mesh.pyrs),
+        wedges(mesh.wedges),
+        hexes(mesh.hexes),
+        grids(mesh.grids),
+        gridScalars(mesh.gridScalars),
+        bounds(mesh.bounds)
+    {}
+
+    inline size_t numVolumeElements() const
+    { return tets.size()+pyrs.size()+wedges.size()+hexes.size()+grids.size(); }
+
+    Span<vec3f>    vertices;
+    Span<float>    scalars;
+    Span<Triangle> triangles;
+    Span<Quad>     quads;
+    Span<Tet>      tets;
+    Span<Pyr>      pyrs;
+    Span<Wedge>    wedges;
+    Span<Hex>      hexes;
+    Span<Grid>     grids;
+    Span<float>    gridScalars;
+    /*! bounds of the vertices, if known; empty otherwise */
+    box3f          bounds;
+  };
+
+} // ::umesh
@@ -0,0 +1,286 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/PointLocator.h"
+#include "umesh/sampleElements.h"
+#include "umesh/forEachElement.h"
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
+
+namespace umesh {
+
+  /*! max depth of the BVH; since nodes get split at their median
+      prim, this is way more than any mesh that can be indexed with
+      32-bit integers will ever need */
+  const int maxDepth = 32;
+
+  /*! ranges with more prims than this get their bounds computed in
+      parallel during the build */
+  const size_t parallelBuildThreshold = 64*1024;
+  
+  // ==================================================================
+  // BVH build
+  // ==================================================================
+
+  /*! a prim, and its bounds - which only get computed once */
+  struct BuildPrim {
+    UMesh::PrimRef ref;
+    box3f          bounds;
+  };
+
+  /*! the sizes of the (up to) four ranges a range of 'numPrims' prims
+      gets split into: first into two halves, then each half into two
+      quarters */
+  inline void splitSizes(size_t numPrims, size_t sizes[4])
+  {
+    const size_t left = numPrims/2, right = numPrims-left;
+    sizes[0] = left/2;  sizes[1] = left-sizes[0];
+    sizes[2] = right/2; sizes[3] = right-sizes[2];
+  }
+  
+  /*! computes the number of nodes in the subtree over a range of
+      given size, for all sizes that occur in the tree. Since the tree
+      shape only depends on the number of prims, this lets every node
+      know the index of each of its children (in depth-first order)
+      without having to build its siblings' subtrees first */
+  struct NodeCounts {
+    size_t subtreeSize(size_t numPrims)
+    {
+      if (numPrims <= PointLocator::maxLeafSize) return 0;
+      auto it = count.find(numPrims);
+      if (it != count.end()) return it->second;
+      size_t sizes[4];
+      splitSizes(numPrims,sizes);
+      size_t result = 1;
+      for (int i=0;i<4;i++) result += subtreeSize(sizes[i]);
+      return count[numPrims] = result;
+    }
+    /*! same as subtreeSize(), for sizes that are known to be already
+        counted; safe to call concurrently */
+    size_t lookup(size_t numPrims) const
+    {
+      if (numPrims <= PointLocator::maxLeafSize) return 0;
+      return count.find(numPrims)->second;
+    }
+    std::map<size_t,size_t> count;
+  };
+
+  /*! computes bounds and centroid bounds of given range of prims */
+  void computeBounds(const BuildPrim *prims, size_t numPrims,
+                     box3f &bounds, box3f &centBounds)
+  {
+    bounds = centBounds = box3f();
+    if (numPrims < parallelBuildThreshold) {
+      for (size_t i=0;i<numPrims;i++) {
+        bounds.extend(prims[i].bounds);
+        centBounds.extend(prims[i].bounds.center());
+      }
+      return;
+    }
+    std::mutex mutex;
+    parallel_for_blocked
+      (0,numPrims,16*1024,
+       [&](size_t begin, size_t end) {
+         box3f blockBounds, blockCentBounds;
+         for (size_t i=begin;i<end;i++) {
+           blockBounds.extend(prims[i].bounds);
+           blockCentBounds.extend(prims[i].bounds.center());
+         }
+         std::lock_guard<std::mutex> lock(mutex);
+         bounds.extend(blockBounds);
+         centBounds.extend(blockCentBounds);
+       });
+  }
+
+  /*! re-orders given range of prims such that the first 'numLeft'
+      ones are those with the smallest centroids along the widest
+      axis of the range's centroid bounds */
+  void medianSplit(BuildPrim *prims, size_t numPrims, size_t numLeft)
+  {
+    box3f bounds, centBounds;
+    computeBounds(prims,numPrims,bounds,centBounds);
+    const int dim = arg_max(centBounds.size());
+    std::nth_element(prims,prims+numLeft,prims+numPrims,
+                     [dim](const BuildPrim &a, const BuildPrim &b){
+                       return
+                         a.bounds.lower[dim]+a.bounds.upper[dim]
+                         < b.bounds.lower[dim]+b.bounds.upper[dim];
+                     });
+  }
+
+  /*! builds the subtree over given range of prims into node 'nodeID',
+      and (recursively) the nodes following it */
+  void buildNode(std::vector<PointLocator::Node> &nodes,
+                 BuildPrim *allPrims,
+                 size_t begin, size_t numPrims,
+                 size_t nodeID,
+                 const NodeCounts &nodeCounts)
+  {
+    size_t sizes[4] = { numPrims, 0, 0, 0 };
+    if (numPrims > PointLocator::maxLeafSize) {
+      splitSizes(numPrims,sizes);
+      BuildPrim *prims = allPrims+begin;
+      medianSplit(prims,numPrims,sizes[0]+sizes[1]);
+      medianSplit(prims,sizes[0]+sizes[1],sizes[0]);
+      medianSplit(prims+sizes[0]+sizes[1],sizes[2]+sizes[3],sizes[2]);
+    }
+
+    PointLocator::Node &node = nodes[nodeID];
+    size_t childBegin[4], childNodeID[4];
+    size_t nextBegin = begin, nextNodeID = nodeID+1;
+    for (int i=0;i<4;i++) {
+      childBegin[i]  = nextBegin;
+      childNodeID[i] = nextNodeID;
+      nextBegin  += sizes[i];
+      nextNodeID += nodeCounts.lookup(sizes[i]);
+      
+      box3f bounds, centBounds;
+      computeBounds(allPrims+childBegin[i],sizes[i],bounds,centBounds);
+      for (int dim=0;dim<3;dim++) {
+        node.lower[dim][i] = bounds.lower[dim];
+        node.upper[dim][i] = bounds.upper[dim];
+      }
+      const bool isLeaf = sizes[i] <= PointLocator::maxLeafSize;
+      node.offset[i] = uint32_t(isLeaf ? childBegin[i] : childNodeID[i]);
+      node.count[i]  = uint32_t(isLeaf ? sizes[i] : 0);
+    }
+
+    parallel_for(4,[&](int i){
+        if (sizes[i] > PointLocator::maxLeafSize)
+          buildNode(nodes,allPrims,childBegin[i],sizes[i],childNodeID[i],nodeCounts);
+      });
+  }
+
+  PointLocator::PointLocator(UMesh::SP mesh)
+    : mesh(mesh)
+  {}
+  
+  PointLocator::SP PointLocator::build(UMesh::SP mesh)
+  {
+    PointLocator::SP locator = std::make_shared<PointLocator>(mesh);
+    const size_t numPrims = mesh->numVolumeElements();
+    if (numPrims == 0) return locator;
+    if (numPrims > size_t(std::numeric_limits<uint32_t>::max()))
+      throw std::runtime_error("#umesh.PointLocator: too many prims");
+
+    // same order as createVolumePrimRefs(): all elements, then grids
+    std::vector<BuildPrim> buildPrims(numPrims);
+    parallelForEachElementRange
+      (*mesh,[&](const auto &prims, const ElementRange &range) {
+          for (size_t i=range.begin;i<range.end;i++) {
+            BuildPrim &prim = buildPrims[range.indexOf(i)];
+            prim.ref    = UMesh::PrimRef(range.type,i);
+            prim.bounds = elementBounds(prims[i],mesh->vertices);
+          }
+        },VOLUME_ELEMENTS,16*1024);
+    const size_t gridsBegin = numPrims-mesh->grids.size();
+    parallel_for_blocked
+      (0,mesh->grids.size(),16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           buildPrims[gridsBegin+i].ref    = UMesh::PrimRef(UMesh::GRID,i);
+           buildPrims[gridsBegin+i].bounds = mesh->getGridBounds(i);
+         }
+       });
+
+    NodeCounts nodeCounts;
+    const size_t numNodes = std::max(size_t(1),nodeCounts.subtreeSize(buildPrims.size()));
+    locator->nodes.resize(numNodes);
+    buildNode(locator->nodes,buildPrims.data(),0,buildPrims.size(),0,nodeCounts);
+
+    locator->prims.resize(buildPrims.size());
+    parallel_for_blocked
+      (0,buildPrims.size(),16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           locator->prims[i] = buildPrims[i].ref;
+       });
+    return locator;
+  }
+
+  // ==================================================================
+  // queries
+  // ==================================================================
+
+  /*! traverses the BVH with given point, and calls 'test(prim)' for
+      every prim in a leaf whose box contains the point, until it
+      returns true. Returns whether any test returned true */
+  template<typename Lambda>
+  inline bool traverse(const PointLocator &locator, const vec3f &P,
+                       const Lambda &test)
+  {
+    if (locator.nodes.empty()) return false;
+    uint32_t stack[3*maxDepth+1];
+    int stackPtr = 0;
+    stack[stackPtr++] = 0;
+    while (stackPtr > 0) {
+      const PointLocator::Node &node = locator.nodes[stack[--stackPtr]];
+      bool hit[4];
+      for (int i=0;i<4;i++)
+        hit[i]
+          =  (P.x >= node.lower[0][i]) & (P.x <= node.upper[0][i])
+          &  (P.y >= node.lower[1][i]) & (P.y <= node.upper[1][i])
+          &  (P.z >= node.lower[2][i]) & (P.z <= node.upper[2][i]);
+      for (int i=0;i<4;i++) {
+        if (!hit[i]) continue;
+        if (node.count[i] == 0) {
+          stack[stackPtr++] = node.offset[i];
+          continue;
+        }
+        for (uint32_t j=0;j<node.count[i];j++)
+          if (test(locator.prims[node.offset[i]+j])) return true;
+      }
+    }
+    return false;
+  }
+  
+  bool PointLocator::locate(const vec3f &P, UMesh::PrimRef &result) const
+  {
+    return traverse(*this,P,[&](const UMesh::PrimRef &prim){
+        if (!samplePrim(*mesh,prim,P,nullptr)) return false;
+        result = prim;
+        return true;
+      });
+  }
+
+  bool PointLocator::sample(const vec3f &P, float &value) const
+  {
+    return traverse(*this,P,[&](const UMesh::PrimRef &prim){
+        if (prim.type != UMesh::GRID && !mesh->perVertex)
+          throw std::runtime_error("#umesh.PointLocator: cannot sample a mesh without per-vertex scalars");
+        return samplePrim(*mesh,prim,P,&value);
+      });
+  }
+
+  void PointLocator::sample(const vec3f *points,
+                            float *values,
+                            size_t numPoints,
+                            float valueIfOutside) const
+  {
+    if (!mesh->perVertex && mesh->grids.size() != prims.size())
+      throw std::runtime_error("#umesh.PointLocator: cannot sample a mesh without per-vertex scalars");
+    parallel_for_blocked
+      (0,numPoints,4*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           if (!sample(points[i],values[i]))
+             values[i] = valueIfOutside;
+       });
+  }
+  
+} // ::umesh
@@ -0,0 +1,105 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! a BVH over the volumetric elements (tets, pyramids, wedges,
+      hexes, and grids) of a mesh, that allows for finding the element
+      that contains a given point, and for sampling the mesh's scalar
+      field at given points - eg, to resample unstructured data to
+      structured volumes, or to answer probe queries.
+
+      The BVH is 4-wide: each node stores the bounds of all its (up
+      to) four children in SoA layout, so that a point gets tested
+      against all of them in one (vectorizable) loop, and each node
+      fills exactly two cache lines. Nodes are in depth-first order,
+      and leaves refer to ranges of the locator's 'prims'.
+
+      Point-in-element tests are exact (up to a small tolerance, so
+      points on faces shared by two elements get found in either of
+      them): tets use barycentric coordinates; pyramids, wedges, and
+      hexes invert their (VTK) parametric mapping with a few Newton
+      steps, and then interpolate with the respective trilinear-type
+      shape functions; grids get located and trilinearly interpolated
+      directly.
+
+      The locator refers to the mesh it was built for, and has to be
+      rebuilt if that mesh's vertices or elements change. */
+  struct PointLocator {
+    typedef std::shared_ptr<PointLocator> SP;
+
+    /*! max number of prims in a leaf */
+    static const int maxLeafSize = 8;
+
+    /*! builds the BVH over all volumetric elements of given mesh; the
+        build runs in parallel */
+    static PointLocator::SP build(UMesh::SP mesh);
+
+    PointLocator(UMesh::SP mesh);
+
+    /*! finds an element that contains given point; returns false if
+        there isn't any. If elements overlap, it is undefined which of
+        them gets returned */
+    bool locate(const vec3f &P, UMesh::PrimRef &prim) const;
+
+    /*! interpolates the mesh's scalar field (ie, the per-vertex
+        scalars for unstructured elements, and the grid scalars for
+        grids) at given point; returns false if the point is not in
+        any element */
+    bool sample(const vec3f &P, float &value) const;
+
+    /*! samples the scalar field at all given points, in parallel;
+        points that are not in any element get 'valueIfOutside' */
+    void sample(const vec3f *points,
+                float *values,
+                size_t numPoints,
+                float valueIfOutside = NAN) const;
+    inline std::vector<float> sample(const std::vector<vec3f> &points,
+                                     float valueIfOutside = NAN) const
+    {
+      std::vector<float> values(points.size());
+      sample(points.data(),values.data(),points.size(),valueIfOutside);
+      return values;
+    }
+
+    struct Node {
+      /*! the children's bounds; empty for unused child slots */
+      float    lower[3][4];
+      float    upper[3][4];
+      /*! for inner-node children the index of their node, for leaves
+          the index of their first prim in 'prims' */
+      uint32_t offset[4];
+      /*! for leaves, their number of prims; 0 for inner nodes (and
+          unused slots) */
+      uint32_t count[4];
+    };
+
+    /*! the mesh this locator was built for */
+    const UMesh::SP mesh;
+
+    /*! all nodes, in depth-first order; the root is node 0. Empty if
+        the mesh doesn't have any volumetric elements */
+    std::vector<Node>           nodes;
+    /*! all volumetric elements, in the order the leaves refer to
+        them */
+    std::vector<UMesh::PrimRef> prims;
+  };
+
+} // ::umesh
@@ -0,0 +1,91 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/PrimBounds.h"
+#include "umesh/forEachElement.h"
+
+namespace umesh {
+
+  /*! block size for the parallel loops over prims */
+  const size_t primBoundsBlockSize = 16*1024;
+
+  PrimBounds::PrimBounds(UMesh::SP mesh)
+    : mesh(mesh)
+  {}
+
+  PrimBounds::SP PrimBounds::compute(UMesh::SP mesh,
+                                     bool withValueRanges)
+  {
+    if (withValueRanges && !mesh->perVertex
+        && mesh->size() != mesh->grids.size())
+      throw std::runtime_error("#umesh.PrimBounds: cannot compute value ranges "
+                               "for a mesh without per-vertex scalars");
+    
+    PrimBounds::SP result = std::make_shared<PrimBounds>(mesh);
+    // same order as createAllPrimRefs()
+    const UMesh::PrimType order[UMesh::INVALID] = {
+      UMesh::TET, UMesh::PYR, UMesh::WEDGE, UMesh::HEX, UMesh::GRID,
+      UMesh::TRI, UMesh::QUAD
+    };
+    const size_t numPrims[UMesh::INVALID] = {
+      mesh->triangles.size(), mesh->quads.size(), mesh->tets.size(),
+      mesh->pyrs.size(),      mesh->wedges.size(), mesh->hexes.size(),
+      mesh->grids.size()
+    };
+    size_t total = 0;
+    for (auto type : order) {
+      result->typeBegin[type] = total;
+      total += numPrims[type];
+    }
+    result->bounds.resize(total);
+    if (withValueRanges)
+      result->valueRanges.resize(total);
+
+    // the elements' bounds (and value ranges) come directly from
+    // each type's array, so there is no per-prim switch over types
+    const UMesh &m = *mesh;
+    const float *scalars
+      = withValueRanges && m.perVertex ? m.perVertex->values.data() : nullptr;
+    parallelForEachElementRange
+      (m,[&](const auto &prims, const ElementRange &range) {
+          const size_t begin = result->typeBegin[range.type];
+          for (size_t i=range.begin;i<range.end;i++) {
+            const auto &prim = prims[i];
+            box3f   box;
+            range1f valueRange;
+            for (int j=0;j<numVerticesOf(prim);j++) {
+              box.extend(m.vertices[prim[j]]);
+              if (scalars) valueRange.extend(scalars[prim[j]]);
+            }
+            result->bounds[begin+i] = box;
+            if (scalars) result->valueRanges[begin+i] = valueRange;
+          }
+        },ALL_ELEMENTS,primBoundsBlockSize);
+
+    const size_t gridsBegin = result->typeBegin[UMesh::GRID];
+    parallel_for_blocked
+      (0,m.grids.size(),primBoundsBlockSize,
+       [&](size_t blockBegin, size_t blockEnd) {
+         for (size_t i=blockBegin;i<blockEnd;i++) {
+           result->bounds[gridsBegin+i] = m.getGridBounds(i);
+           if (withValueRanges)
+             result->valueRanges[gridsBegin+i] = m.getGridValueRange(i);
+         }
+       });
+    return result;
+  }
+  
+} // ::umesh
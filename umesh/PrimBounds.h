@@ -0,0 +1,87 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/VertexArrays.h"
+
+namespace umesh {
+
+  /*! a cache of the bounding boxes (and optionally, value ranges) of
+      all of a mesh's prims, computed once (in parallel, type by type)
+      so algorithms that look at the same prims' bounds over and over
+      again get them with a streaming read, rather than having to
+      re-gather all of each prim's vertices through
+      UMesh::getBounds(). Prims are stored in the same order
+      UMesh::createAllPrimRefs() returns them in (volume prims first,
+      then surface prims), so the i'th entry belongs to the i'th prim
+      ref of that array; lookups by PrimRef work, too.
+
+      This is a copy, and does not get updated when the mesh changes;
+      it has to be re-computed if the mesh's vertices, elements, or
+      (for value ranges) scalars do. */
+  struct PrimBounds {
+    typedef std::shared_ptr<PrimBounds> SP;
+
+    /*! alignment (in bytes) of all arrays */
+    static const size_t alignment = 64;
+
+    template<typename T>
+    using Array = std::vector<T,AlignedAllocator<T,alignment>>;
+
+    /*! computes the bounds of all of given mesh's prims, plus - if
+        requested - their value ranges, which requires the mesh to
+        have a per-vertex scalar field if it has any (non-grid)
+        elements */
+    static PrimBounds::SP compute(UMesh::SP mesh,
+                                  bool withValueRanges = false);
+
+    /*! index of given prim in the arrays */
+    inline size_t indexOf(const UMesh::PrimRef &pr) const
+    { assert(pr.type < UMesh::INVALID); return typeBegin[pr.type]+pr.ID; }
+
+    inline const box3f &getBounds(const UMesh::PrimRef &pr) const
+    { return bounds[indexOf(pr)]; }
+    inline vec3f getCentroid(const UMesh::PrimRef &pr) const
+    { return getBounds(pr).center(); }
+    /*! only if computed with value ranges */
+    inline range1f getValueRange(const UMesh::PrimRef &pr) const
+    { assert(!valueRanges.empty()); return valueRanges[indexOf(pr)]; }
+    /*! only if computed with value ranges */
+    inline box4f getBounds4f(const UMesh::PrimRef &pr) const
+    {
+      const box3f   spatial = getBounds(pr);
+      const range1f value   = getValueRange(pr);
+      return box4f(vec4f(spatial.lower,value.lower),
+                   vec4f(spatial.upper,value.upper));
+    }
+    
+    inline size_t size() const { return bounds.size(); }
+
+    /*! the mesh these are the bounds of */
+    const UMesh::SP  mesh;
+    /*! for each prim type, the index of its first prim in the
+        arrays */
+    size_t           typeBegin[UMesh::INVALID];
+    Array<box3f>     bounds;
+    /*! empty unless computed with value ranges */
+    Array<range1f>   valueRanges;
+
+    PrimBounds(UMesh::SP mesh);
+  };
+  
+} // ::umesh
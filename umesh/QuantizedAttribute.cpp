@@ -0,0 +1,134 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/UMesh.h"
+#include "umesh/parallel_for.h"
+#include <cfloat>
+
+namespace umesh {
+
+  /*! block size for the parallel loops over values */
+  const size_t quantizeBlockSize = 64*1024;
+  
+  /*! range of given (non-NaN) values */
+  range1f computeRange(const std::vector<float> &values)
+  {
+    std::mutex mutex;
+    range1f range;
+    parallel_for_blocked
+      (0,values.size(),quantizeBlockSize,
+       [&](size_t begin, size_t end) {
+         range1f blockRange;
+         for (size_t i=begin;i<end;i++)
+           blockRange.extend(values[i]);
+         std::lock_guard<std::mutex> lock(mutex);
+         range.extend(blockRange);
+       });
+    // all-NaN (or no) values
+    if (range.empty()) range.lower = range.upper = 0.f;
+    return range;
+  }
+
+  /*! quantizes given values with given (already determined) range */
+  QuantizedAttribute::SP quantizeValues(const Attribute &attr,
+                                        int bits,
+                                        const range1f &range)
+  {
+    if (bits != 8 && bits != 16)
+      throw std::runtime_error("#umesh.quantize: can only quantize to 8 or 16 bits, not "
+                               +std::to_string(bits));
+    if (!std::isfinite(range.lower) || !std::isfinite(range.upper))
+      throw std::runtime_error("#umesh.quantize: attribute '"+attr.name
+                               +"' has non-finite values");
+    QuantizedAttribute::SP result = std::make_shared<QuantizedAttribute>();
+    result->name = attr.name;
+    result->setQuantization(bits,range);
+    const size_t N = attr.values.size();
+    if (bits == 8) result->codes8.resize(N);
+    else           result->codes16.resize(N);
+    
+    const uint32_t maxCode = result->maxCode();
+    const float    lower   = range.lower;
+    const float    rcpStep = result->step > 0.f ? 1.f/result->step : 0.f;
+    parallel_for_blocked
+      (0,N,quantizeBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           const float v = attr.values[i];
+           uint32_t code = maxCode;
+           if (!std::isnan(v))
+             code = std::min(uint32_t(std::max(roundf((v-lower)*rcpStep),0.f)),
+                             maxCode-1);
+           if (bits == 8) result->codes8[i]  = uint8_t(code);
+           else           result->codes16[i] = uint16_t(code);
+         }
+       });
+    return result;
+  }
+  
+  QuantizedAttribute::SP QuantizedAttribute::quantize(const Attribute &attr,
+                                                      int bits)
+  {
+    return quantizeValues(attr,bits,computeRange(attr.values));
+  }
+
+  QuantizedAttribute::SP QuantizedAttribute::quantize(const Attribute &attr,
+                                                      float maxError)
+  {
+    const range1f range = computeRange(attr.values);
+    // the error bound only depends on range and bits
+    for (int bits : { 8, 16 }) {
+      QuantizedAttribute probe;
+      probe.setQuantization(bits,range);
+      if (probe.maxError() <= maxError)
+        return quantizeValues(attr,bits,range);
+    }
+    throw std::runtime_error("#umesh.quantize: cannot quantize attribute '"+attr.name
+                             +"' to 16 bits or less with a max error of "
+                             +std::to_string(maxError));
+  }
+  
+  void QuantizedAttribute::setQuantization(int bits, const range1f &valueRange)
+  {
+    this->bits       = bits;
+    this->valueRange = valueRange;
+    // codes 0..maxCode()-1 span the range, maxCode() is NaN
+    step = (valueRange.upper-valueRange.lower)/float(maxCode()-1);
+  }
+  
+  float QuantizedAttribute::maxError() const
+  {
+    const float magnitude
+      = std::max(fabsf(valueRange.lower),fabsf(valueRange.upper));
+    return .5f*step + 4.f*FLT_EPSILON*magnitude;
+  }
+
+  Attribute::SP QuantizedAttribute::dequantize() const
+  {
+    Attribute::SP result = std::make_shared<Attribute>();
+    result->name = name;
+    result->values.resize(size());
+    parallel_for_blocked
+      (0,size(),quantizeBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           result->values[i] = (*this)[i];
+       });
+    result->finalize();
+    return result;
+  }
+  
+} // ::umesh
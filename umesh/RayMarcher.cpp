@@ -0,0 +1,377 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/RayMarcher.h"
+#include "umesh/sampleElements.h"
+#include <atomic>
+
+namespace umesh {
+
+  const int      RayMarcher::facetsPerElement[4] = { 4, 5, 5, 6 };
+  const uint32_t RayMarcher::noNeighbor;
+
+  /*! tolerance (in barycentric coordinates) for ray-face hits, so
+      rays through edges shared by two boundary faces don't slip
+      through between them */
+  const float hitEpsilon = 1e-6f;
+
+  /*! the vertex indices of given element, in the order of its prim
+      type; returns the number of vertices */
+  inline int elementVertices(const UMesh &mesh, const UMesh::PrimRef &prim,
+                             int idx[8])
+  {
+    switch (prim.type) {
+    case UMesh::TET:
+      for (int i=0;i<4;i++) idx[i] = mesh.tets[prim.ID][i];
+      return 4;
+    case UMesh::PYR:
+      for (int i=0;i<5;i++) idx[i] = mesh.pyrs[prim.ID][i];
+      return 5;
+    case UMesh::WEDGE:
+      for (int i=0;i<6;i++) idx[i] = mesh.wedges[prim.ID][i];
+      return 6;
+    case UMesh::HEX:
+      for (int i=0;i<8;i++) idx[i] = mesh.hexes[prim.ID][i];
+      return 8;
+    default:
+      throw std::runtime_error("#umesh.RayMarcher: not an unstructured volume element");
+    }
+  }
+
+  /*! the plane through given (tri or quad) face, with unit normal in
+      the direction given by the vertex order; zero for degenerate
+      faces. For quads the normal is the cross product of the
+      diagonals (ie, the Newell normal), and the plane goes through
+      the vertices' average */
+  inline vec4f facePlane(const UMesh &mesh, const vec4i &face)
+  {
+    const vec3f v0 = mesh.vertices[face.x];
+    const vec3f v1 = mesh.vertices[face.y];
+    const vec3f v2 = mesh.vertices[face.z];
+    vec3f N, center;
+    if (face.w < 0) {
+      N      = cross(v1-v0,v2-v0);
+      center = (v0+v1+v2)*(1.f/3.f);
+    } else {
+      const vec3f v3 = mesh.vertices[face.w];
+      N      = cross(v2-v0,v3-v1);
+      center = (v0+v1+v2+v3)*.25f;
+    }
+    const float len = length(N);
+    if (len == 0.f) return vec4f(0.f);
+    N = N*(1.f/len);
+    return vec4f(N.x,N.y,N.z,-dot(N,center));
+  }
+  
+  inline vec4f flipped(const vec4f &plane)
+  { return vec4f(-plane.x,-plane.y,-plane.z,-plane.w); }
+  
+  inline float planeDistance(const vec4f &plane, const vec3f &P)
+  { return plane.x*P.x+plane.y*P.y+plane.z*P.z+plane.w; }
+  
+  inline float planeDot(const vec4f &plane, const vec3f &dir)
+  { return plane.x*dir.x+plane.y*dir.y+plane.z*dir.z; }
+
+  /*! ray-triangle test (with some tolerance at the edges); returns
+      the hit distance, or infinity if there's no hit */
+  inline float intersectTriangle(const RayMarcher::Ray &ray,
+                                 const vec3f &v0, const vec3f &v1, const vec3f &v2)
+  {
+    const vec3f e1 = v1-v0, e2 = v2-v0;
+    const vec3f p = cross(ray.dir,e2);
+    const float det = dot(e1,p);
+    if (det == 0.f) return INFINITY;
+    const float rcpDet = 1.f/det;
+    const vec3f s = ray.org-v0;
+    const float u = dot(s,p)*rcpDet;
+    if (u < -hitEpsilon || u > 1.f+hitEpsilon) return INFINITY;
+    const vec3f q = cross(s,e1);
+    const float v = dot(ray.dir,q)*rcpDet;
+    if (v < -hitEpsilon || u+v > 1.f+hitEpsilon) return INFINITY;
+    return dot(e2,q)*rcpDet;
+  }
+  
+  template<typename Prim, typename Shape>
+  inline float interpolateShape(const UMesh &mesh, const Prim &prim,
+                                const vec3f &P, const float *scalars)
+  {
+    const int N = Prim::numVertices;
+    vec3f v[N];
+    for (int i=0;i<N;i++) v[i] = mesh.vertices[prim[i]];
+    float w[N];
+    // the point may be (very) slightly outside, so the result of the
+    // inside test doesn't matter - the weights still are those of
+    // the closest parametric coordinates found
+    shapeWeights<Shape>(v,P,w);
+    float value = 0.f;
+    for (int i=0;i<N;i++)
+      value += w[i]*scalars[prim[i]];
+    return value;
+  }
+  
+  RayMarcher::RayMarcher(UMesh::SP mesh)
+    : mesh(mesh)
+  {}
+
+  RayMarcher::SP RayMarcher::build(UMesh::SP mesh, FaceConn::Method method)
+  {
+    if (!mesh->grids.empty())
+      throw std::runtime_error("#umesh.RayMarcher: meshes with grids are not supported");
+    FaceConn::SP faceConn = FaceConn::compute(mesh,method);
+    return build(mesh,*faceConn);
+  }
+  
+  RayMarcher::SP RayMarcher::build(UMesh::SP mesh, const FaceConn &faceConn)
+  {
+    if (!mesh->grids.empty())
+      throw std::runtime_error("#umesh.RayMarcher: meshes with grids are not supported");
+    RayMarcher::SP marcher = std::make_shared<RayMarcher>(mesh);
+    const size_t count[4] = {
+      mesh->tets.size(), mesh->pyrs.size(), mesh->wedges.size(), mesh->hexes.size()
+    };
+    if (count[0]+count[1]+count[2]+count[3] >= (1ull<<29))
+      throw std::runtime_error("#umesh.RayMarcher: too many elements");
+    marcher->elementBegin[0] = 0;
+    marcher->facetBegin[0]   = 0;
+    for (int type=0;type<4;type++) {
+      marcher->elementBegin[type+1] = marcher->elementBegin[type]+uint32_t(count[type]);
+      marcher->facetBegin[type+1]   = marcher->facetBegin[type]+count[type]*facetsPerElement[type];
+    }
+    const size_t numFacets = marcher->facetBegin[4];
+    marcher->facetPlanes.assign(numFacets,vec4f(0.f));
+    marcher->neighbors.assign(numFacets,noNeighbor);
+
+    auto elementOf = [&](const FaceConn::PrimFacetRef &ref) {
+      return uint32_t(marcher->elementBegin[ref.primType-UMesh::TET]+ref.primIdx);
+    };
+    const std::vector<FaceConn::SharedFace> &faces = faceConn.faces;
+    parallel_for_blocked
+      (0,faces.size(),16*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t faceID=begin;faceID<end;faceID++) {
+           const FaceConn::SharedFace &face = faces[faceID];
+           const bool hasFront = !(face.onFront.primIdx < 0);
+           const bool hasBack  = !(face.onBack.primIdx < 0);
+           if (!hasFront && !hasBack) continue;
+
+           // orient the plane to point out of the front element (or,
+           // for boundary faces, the only one there is), by testing
+           // against that element's centroid
+           const FaceConn::PrimFacetRef &ref = hasFront ? face.onFront : face.onBack;
+           const uint32_t refElement = elementOf(ref);
+           int idx[8];
+           const int numVertices = elementVertices(*mesh,marcher->primOf(refElement),idx);
+           vec3f centroid(0.f);
+           for (int i=0;i<numVertices;i++)
+             centroid = centroid + mesh->vertices[idx[i]];
+           centroid = centroid * (1.f/numVertices);
+           vec4f plane = facePlane(*mesh,face.vertexIdx);
+           if (planeDistance(plane,centroid) > 0.f)
+             plane = flipped(plane);
+
+           const size_t refFacet = marcher->facetOf(refElement,ref.facetIdx);
+           marcher->facetPlanes[refFacet] = plane;
+           if (hasFront && hasBack) {
+             const uint32_t backElement = elementOf(face.onBack);
+             const size_t backFacet = marcher->facetOf(backElement,face.onBack.facetIdx);
+             marcher->facetPlanes[backFacet] = flipped(plane);
+             marcher->neighbors[refFacet]  = packFacet(backElement,face.onBack.facetIdx);
+             marcher->neighbors[backFacet] = packFacet(refElement,ref.facetIdx);
+           }
+         }
+       });
+
+    for (auto &face : faces) {
+      const bool hasFront = !(face.onFront.primIdx < 0);
+      const bool hasBack  = !(face.onBack.primIdx < 0);
+      if (hasFront == hasBack) continue;
+      const FaceConn::PrimFacetRef &ref = hasFront ? face.onFront : face.onBack;
+      BoundaryFace boundaryFace;
+      const uint32_t element = elementOf(ref);
+      boundaryFace.plane     = marcher->facetPlanes[marcher->facetOf(element,ref.facetIdx)];
+      boundaryFace.vertexIdx = face.vertexIdx;
+      boundaryFace.facet     = packFacet(element,ref.facetIdx);
+      marcher->boundaryFaces.push_back(boundaryFace);
+    }
+    return marcher;
+  }
+
+  UMesh::PrimRef RayMarcher::primOf(uint32_t element) const
+  {
+    int type = 0;
+    while (element >= elementBegin[type+1]) type++;
+    return UMesh::PrimRef(UMesh::PrimType(UMesh::TET+type),
+                          element-elementBegin[type]);
+  }
+
+  bool RayMarcher::findEntry(const Ray &ray, float tMin,
+                             uint32_t &element, int &entryFacet, float &t) const
+  {
+    t = ray.tMax;
+    bool found = false;
+    for (auto &face : boundaryFaces) {
+      // only faces the ray enters through, ie, that face it
+      if (!(planeDot(face.plane,ray.dir) < 0.f)) continue;
+      const vec4i v = face.vertexIdx;
+      const vec3f v0 = mesh->vertices[v.x];
+      const vec3f v2 = mesh->vertices[v.z];
+      float tHit = intersectTriangle(ray,v0,mesh->vertices[v.y],v2);
+      if (v.w >= 0)
+        tHit = std::min(tHit,intersectTriangle(ray,v0,v2,mesh->vertices[v.w]));
+      if (tHit > tMin && tHit < t) {
+        t          = tHit;
+        element    = face.facet >> 3;
+        entryFacet = face.facet & 7;
+        found      = true;
+      }
+    }
+    return found;
+  }
+  
+  float RayMarcher::interpolate(uint32_t element, const vec3f &P) const
+  {
+    if (!mesh->perVertex) return NAN;
+    const float *s = mesh->perVertex->values.data();
+    const UMesh::PrimRef prim = primOf(element);
+    switch (prim.type) {
+    case UMesh::TET: {
+      const Tet &tet = mesh->tets[prim.ID];
+      const vec3f v[4] = {
+        mesh->vertices[tet.x], mesh->vertices[tet.y],
+        mesh->vertices[tet.z], mesh->vertices[tet.w]
+      };
+      // (degenerate tets leave these as they are)
+      float w[4] = { .25f, .25f, .25f, .25f };
+      tetWeights(v,P,w);
+      return w[0]*s[tet.x]+w[1]*s[tet.y]+w[2]*s[tet.z]+w[3]*s[tet.w];
+    }
+    case UMesh::PYR:
+      return interpolateShape<Pyr,PyrShape>(*mesh,mesh->pyrs[prim.ID],P,s);
+    case UMesh::WEDGE:
+      return interpolateShape<Wedge,WedgeShape>(*mesh,mesh->wedges[prim.ID],P,s);
+    default:
+      return interpolateShape<Hex,HexShape>(*mesh,mesh->hexes[prim.ID],P,s);
+    }
+  }
+  
+  bool RayMarcher::march(const Ray &ray, std::vector<Segment> &segments) const
+  {
+    uint32_t element;
+    int      entryFacet = -1;
+    float    t = ray.tMin;
+    if (ray.startElement >= 0)
+      element = ray.startElement;
+    else {
+      std::call_once(locatorBuilt,[&]{ locator = PointLocator::build(mesh); });
+      UMesh::PrimRef prim;
+      if (locator->locate(ray.org+ray.tMin*ray.dir,prim))
+        element = elementBegin[prim.type-UMesh::TET]+uint32_t(prim.ID);
+      else if (!findEntry(ray,ray.tMin,element,entryFacet,t))
+        return true;
+    }
+
+    // a straight line can pass through each (convex) element at most
+    // once, so anything that takes more steps than that is going in
+    // circles
+    for (size_t step=0;step<=elementBegin[4];step++) {
+      if (!(t < ray.tMax)) return true;
+      
+      const size_t facet0 = facetOf(element,0);
+      const int numFacets = facetsPerElement[primOf(element).type-UMesh::TET];
+      float tExit = INFINITY;
+      int exitFacet = -1;
+      for (int i=0;i<numFacets;i++) {
+        if (i == entryFacet) continue;
+        const vec4f plane = facetPlanes[facet0+i];
+        const float denom = planeDot(plane,ray.dir);
+        if (!(denom > 0.f)) continue;
+        const float tPlane = -planeDistance(plane,ray.org)/denom;
+        if (tPlane < tExit) {
+          tExit     = tPlane;
+          exitFacet = i;
+        }
+      }
+      if (exitFacet < 0) return false;
+
+      tExit = std::max(tExit,t);
+      const bool done = !(tExit < ray.tMax);
+      if (done) tExit = ray.tMax;
+      if (tExit > t) {
+        Segment segment;
+        segment.element     = element;
+        segment.tEnter      = t;
+        segment.tExit       = tExit;
+        segment.scalarEnter = interpolate(element,ray.org+t*ray.dir);
+        segment.scalarExit  = interpolate(element,ray.org+tExit*ray.dir);
+        segments.push_back(segment);
+      }
+      if (done) return true;
+      
+      const uint32_t next = neighbors[facet0+exitFacet];
+      if (next == noNeighbor) {
+        // left the mesh; see if (and where) it comes back in
+        if (!findEntry(ray,tExit,element,entryFacet,t))
+          return true;
+      } else {
+        element    = next >> 3;
+        entryFacet = next & 7;
+        t          = tExit;
+      }
+    }
+    return false;
+  }
+  
+  RayMarcher::Result RayMarcher::march(const std::vector<Ray> &rays) const
+  {
+    Result result;
+    const size_t numRays   = rays.size();
+    const size_t blockSize = 64;
+    const size_t numBlocks = divRoundUp(numRays,blockSize);
+    result.segmentsBegin.resize(numRays+1);
+    std::vector<std::vector<Segment>> blockSegments(numBlocks);
+    std::atomic<size_t> numLost(0);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,numRays);
+        std::vector<Segment> &local = blockSegments[blockID];
+        for (size_t rayID=begin;rayID<end;rayID++) {
+          result.segmentsBegin[rayID] = local.size();
+          if (!march(rays[rayID],local)) numLost++;
+        }
+      });
+    result.numLost = numLost;
+
+    // concatenate the blocks' segments, and make the rays' offsets
+    // global
+    std::vector<size_t> blockOffset(numBlocks+1,0);
+    for (size_t blockID=0;blockID<numBlocks;blockID++)
+      blockOffset[blockID+1] = blockOffset[blockID]+blockSegments[blockID].size();
+    result.segments.resize(blockOffset[numBlocks]);
+    result.segmentsBegin[numRays] = blockOffset[numBlocks];
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,numRays);
+        for (size_t rayID=begin;rayID<end;rayID++)
+          result.segmentsBegin[rayID] += blockOffset[blockID];
+        std::vector<Segment> &local = blockSegments[blockID];
+        std::copy(local.begin(),local.end(),
+                  result.segments.begin()+blockOffset[blockID]);
+        local = std::vector<Segment>();
+      });
+    return result;
+  }
+  
+} // ::umesh
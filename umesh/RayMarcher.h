@@ -0,0 +1,179 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/FaceConn.h"
+#include "umesh/PointLocator.h"
+#include <mutex>
+
+namespace umesh {
+
+  /*! cell-to-cell ray traversal through the (unstructured) volume
+      elements of a mesh: starting from the element a ray enters the
+      mesh through (or starts in), the marcher steps from element to
+      element through the faces they share, and reports, in order,
+      each element the ray passes through, the ray parameters at which
+      it enters and leaves that element, and the mesh's scalars at
+      those two points. Once a ray leaves the mesh it gets tested for
+      re-entering it (for non-convex meshes) further along. This works
+      without any BVH, so is a simple reference for volume integration
+      and probe lines.
+
+      Element IDs are those of the Adjacency (ie, those of
+      writePrimFacets()): all tets, then all pyramids, wedges, and
+      hexes. Grids are not part of the face connectivity, so meshes
+      with grids are not supported.
+
+      The connectivity is stored in flat arrays, one entry per
+      element facet (with the facets of element i starting at
+      facetOf(i,0), in the order writePrimFacets() uses), that can
+      be uploaded to a device as they are: each facet's plane
+      (oriented to point out of its element), and the packed element
+      and facet on its other side. The planes of the two facets of a
+      shared face are computed once, from the shared face's vertices,
+      so a ray leaving one element is exactly where it enters the
+      next; curved (non-planar) quad faces get approximated by a
+      single plane.
+
+      Finding where a ray enters the mesh tests it against all
+      boundary faces, which is cheap only for (relatively) few rays
+      or small meshes; rays whose start element is known (eg, from a
+      shell hit) should set 'startElement'. Rays starting inside the
+      mesh get their start element from a PointLocator that gets
+      built on first use. */
+  struct RayMarcher {
+    typedef std::shared_ptr<RayMarcher> SP;
+
+    /*! a ray (or segment, if tMax is finite) to march */
+    struct Ray {
+      vec3f org;
+      vec3f dir;
+      float tMin = 0.f;
+      float tMax = INFINITY;
+      /*! the element that contains org+tMin*dir, if known; -1 makes
+          the marcher find that (or, if there isn't any, the point
+          the ray enters the mesh) itself */
+      int   startElement = -1;
+    };
+
+    /*! one element a ray passes through, with the ray parameters at
+        which the ray enters and leaves it, and the (per-vertex)
+        scalars at those points; the scalars are NaN for meshes
+        without per-vertex scalars */
+    struct Segment {
+      uint32_t element;
+      float    tEnter, tExit;
+      float    scalarEnter, scalarExit;
+    };
+
+    /*! the segments of a batch of rays, in CSR form: ray i's segments
+        are segments[segmentsBegin[i]..segmentsBegin[i+1]), in the
+        order the ray passes through them */
+    struct Result {
+      std::vector<size_t>  segmentsBegin;
+      std::vector<Segment> segments;
+      /*! number of rays whose traversal stopped early because no
+          exit face could be found in an element (ie, for degenerate
+          or inverted elements) */
+      size_t numLost = 0;
+    };
+
+    /*! marker for facets that are on the mesh's boundary */
+    static const uint32_t noNeighbor = ~0u;
+    
+    /*! computes the face connectivity of given mesh (with given
+        method), and builds the marcher from that */
+    static RayMarcher::SP build(UMesh::SP mesh,
+                                FaceConn::Method method = FaceConn::SORT);
+    /*! builds the marcher from an already-computed face connectivity
+        of given mesh */
+    static RayMarcher::SP build(UMesh::SP mesh, const FaceConn &faceConn);
+
+    RayMarcher(UMesh::SP mesh);
+
+    /*! marches all given rays, in parallel */
+    Result march(const std::vector<Ray> &rays) const;
+    /*! marches a single ray, appending its segments; returns false if
+        the traversal got lost (see Result::numLost) */
+    bool march(const Ray &ray, std::vector<Segment> &segments) const;
+
+    /*! the mesh element with given element ID */
+    UMesh::PrimRef primOf(uint32_t element) const;
+    
+    /*! index of the i'th facet of given element (in this marcher's
+        per-facet arrays) */
+    inline size_t facetOf(uint32_t element, int i) const
+    {
+      int type = 0;
+      while (element >= elementBegin[type+1]) type++;
+      return facetBegin[type] + size_t(element-elementBegin[type])*facetsPerElement[type] + i;
+    }
+
+    /*! packs a reference to an element's facet into a single 32-bit
+        value, see 'neighbors' */
+    static inline uint32_t packFacet(uint32_t element, int facet)
+    { return (element << 3) | uint32_t(facet); }
+    
+    /*! the mesh this marcher was built for */
+    const UMesh::SP mesh;
+
+    /*! number of facets of tets, pyramids, wedges, and hexes */
+    static const int facetsPerElement[4];
+    /*! the element ID of the first tet, pyramid, wedge, and hex,
+        plus the total number of elements */
+    uint32_t elementBegin[5];
+    /*! the index of the first tet, pyramid, wedge, and hex facet,
+        plus the total number of facets */
+    size_t   facetBegin[5];
+
+    /*! per facet, its plane (nx,ny,nz,d) with unit normal n pointing
+        out of its element, such that dot(n,x)+d = 0 on the plane;
+        degenerate facets have a zero plane */
+    std::vector<vec4f>    facetPlanes;
+    /*! per facet, the element and facet on the other side (packed
+        with packFacet()), or 'noNeighbor' for boundary facets */
+    std::vector<uint32_t> neighbors;
+
+    /*! a face on the mesh's boundary, for finding where rays enter
+        the mesh */
+    struct BoundaryFace {
+      /*! the plane of the element facet it belongs to (see
+          'facetPlanes') */
+      vec4f    plane;
+      /*! the face's vertices; w is -1 for triangles */
+      vec4i    vertexIdx;
+      /*! the element facet it belongs to, packed with
+          packFacet() */
+      uint32_t facet;
+    };
+    std::vector<BoundaryFace> boundaryFaces;
+
+  private:
+    /*! finds the boundary face a ray enters the mesh through, at the
+        smallest t in (tMin,tMax); returns false if there isn't any */
+    bool findEntry(const Ray &ray, float tMin,
+                   uint32_t &element, int &entryFacet, float &t) const;
+    /*! interpolates the per-vertex scalars in given element, at given
+        point (which should be in or on the element) */
+    float interpolate(uint32_t element, const vec3f &P) const;
+    
+    mutable std::once_flag      locatorBuilt;
+    mutable PointLocator::SP    locator;
+  };
+  
+} // ::umesh
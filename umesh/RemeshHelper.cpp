@@ -15,17 +15,102 @@
 // ======================================================================== //
 
 #include "RemeshHelper.h"
-# ifdef UMESH_HAVE_TBB
-#  include "tbb/parallel_sort.h"
-# endif
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/ScratchArena.h"
+#include "umesh/forEachElement.h"
+#include "umesh/profile.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
 
 namespace umesh {
 
+  /*! hash of a vertex position; -0 and +0 compare equal, so have to
+      hash the same, too */
+  inline uint64_t positionHash(const vec3f &v)
+  {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (int i=0;i<3;i++) {
+      const float f = (v[i] == 0.f) ? 0.f : v[i];
+      uint32_t bits;
+      memcpy(&bits,&f,sizeof(bits));
+      hash = (hash ^ bits) * 0x100000001b3ull;
+    }
+    return hash ^ (hash >> 29);
+  }
+
+  inline bool hasNaN(const vec3f &v)
+  { return std::isnan(v.x) || std::isnan(v.y) || std::isnan(v.z); }
+  
+  /*! block size for all the parallel loops over vertices and
+      elements below */
+  const size_t reindexBlockSize = 64*1024;
+
+  const uint32_t EMPTY_SLOT = uint32_t(-1);
+  
   RemeshHelper::RemeshHelper(UMesh &target,
                              bool createVertexTags)
     : target(target), createVertexTags(createVertexTags)
   {}
 
+  void RemeshHelper::reserve(size_t numVertices)
+  {
+    if (2*numVertices <= numKnownSlots) return;
+    size_t numSlots = std::max(numKnownSlots,size_t(1024));
+    while (numSlots < 2*numVertices) numSlots *= 2;
+    
+    std::unique_ptr<std::atomic<uint32_t>[]> slots(new std::atomic<uint32_t>[numSlots]);
+    parallel_for_blocked
+      (0,numSlots,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          slots[i].store(EMPTY_SLOT,std::memory_order_relaxed);
+      });
+    // all known vertices have different positions (or NaNs), so
+    // each just goes into the first free slot
+    const size_t mask = numSlots-1;
+    parallel_for_blocked
+      (0,numKnownSlots,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          const uint32_t ID = knownVertices[i].load(std::memory_order_relaxed);
+          if (ID == EMPTY_SLOT) continue;
+          for (size_t slot=positionHash(target.vertices[ID])&mask;;slot=(slot+1)&mask) {
+            uint32_t expected = EMPTY_SLOT;
+            if (slots[slot].compare_exchange_strong(expected,ID))
+              break;
+          }
+        }
+      });
+    knownVertices = std::move(slots);
+    numKnownSlots = numSlots;
+  }
+
+  bool RemeshHelper::findKnown(const vec3f &v, uint32_t &ID) const
+  {
+    if (numKnownSlots == 0) return false;
+    const size_t mask = numKnownSlots-1;
+    for (size_t slot=positionHash(v)&mask;;slot=(slot+1)&mask) {
+      ID = knownVertices[slot].load(std::memory_order_relaxed);
+      if (ID == EMPTY_SLOT) return false;
+      if (target.vertices[ID] == v) return true;
+    }
+  }
+  
+  void RemeshHelper::addKnown(const vec3f &v, uint32_t ID)
+  {
+    reserve(numKnown+1);
+    const size_t mask = numKnownSlots-1;
+    for (size_t slot=positionHash(v)&mask;;slot=(slot+1)&mask)
+      if (knownVertices[slot].load(std::memory_order_relaxed) == EMPTY_SLOT) {
+        knownVertices[slot].store(ID,std::memory_order_relaxed);
+        break;
+      }
+    ++numKnown;
+  }
+
   /*! given a vertex v, return its ID in the target mesh's vertex
     array (if present), or add it (if not). To afterwards allow the
     using libnray to look up which of the inptu vertices ended up
@@ -34,14 +119,13 @@ namespace umesh {
     functoin of the one that uses a float scalar, not mixed */
    uint32_t RemeshHelper::getID(const vec3f &v, size_t tag)
   {
-    auto it = knownVertices.find(v);
-    if (it != knownVertices.end()) {
-      return it->second;
-    }
-    int ID = (int)target.vertices.size();
-    knownVertices[v] = ID;
+    uint32_t ID;
+    if (findKnown(v,ID))
+      return ID;
+    ID = (uint32_t)target.vertices.size();
     target.vertexTags.push_back(tag);
     target.vertices.push_back(v);
+    addKnown(v,ID);
     return ID;
   }
 
@@ -51,13 +135,12 @@ namespace umesh {
    uint32_t RemeshHelper::getID(const vec3f &v)
   {
     assert(!target.perVertex);
-    auto it = knownVertices.find(v);
-    if (it != knownVertices.end()) {
-      return it->second;
-    }
-    int ID = (int)target.vertices.size();
-    knownVertices[v] = ID;
+    uint32_t ID;
+    if (findKnown(v,ID))
+      return ID;
+    ID = (uint32_t)target.vertices.size();
     target.vertices.push_back(v);
+    addKnown(v,ID);
     return ID;
   }
   
@@ -70,16 +153,15 @@ namespace umesh {
     uses a size_t tag, not mixed */
    uint32_t RemeshHelper::getID(const vec3f &v, float scalar)
   {
-    auto it = knownVertices.find(v);
-    if (it != knownVertices.end()) {
-      return it->second;
-    }
-    int ID = (int)target.vertices.size();
-    knownVertices[v] = ID;
+    uint32_t ID;
+    if (findKnown(v,ID))
+      return ID;
+    ID = (uint32_t)target.vertices.size();
     if (!target.perVertex)
       target.perVertex = std::make_shared<Attribute>();
     target.perVertex->values.push_back(scalar);
     target.vertices.push_back(v);
+    addKnown(v,ID);
     return ID;
   }
 
@@ -91,17 +173,16 @@ namespace umesh {
                                float scalar,
                                size_t existingVertexTag)
   {
-    auto it = knownVertices.find(v);
-    if (it != knownVertices.end()) {
-      return it->second;
-    }
-    int ID = (int)target.vertices.size();
-    knownVertices[v] = ID;
+    uint32_t ID;
+    if (findKnown(v,ID))
+      return ID;
+    ID = (uint32_t)target.vertices.size();
     if (!target.perVertex)
       target.perVertex = std::make_shared<Attribute>();
     target.perVertex->values.push_back(scalar);
     target.vertices.push_back(v);
     target.vertexTags.push_back(existingVertexTag);
+    addKnown(v,ID);
     return ID;
   }
 
@@ -236,222 +317,682 @@ namespace umesh {
 
 
 
-  struct BigVertex {
-    vec3f pos;
-    float scalar;
-    uint32_t orgID;
-    int active;;
-  };
+  /*! calls 'f(index)' (in parallel) for every vertex index of every
+      surface and volume element of given mesh */
+  template<typename Lambda>
+  void forEachVertexIndex(UMesh &mesh, const Lambda &f)
+  {
+    parallelForEachElement
+      (mesh,[&](auto &prim, UMesh::PrimType, size_t){
+          for (int i=0;i<numVerticesOf(prim);i++)
+            f(prim[i]);
+        },ALL_ELEMENTS,reindexBlockSize);
+  }
+
+  /*! returns, for each of the 'numVertices' vertices that the
+      mesh's elements refer to, whether it is used by any element;
+      the flags only ever get set to true, so relaxed atomics are all
+      we need */
+  ScratchVector<uint8_t> findUsedVertices(UMesh &mesh, size_t numVertices)
+  {
+    std::unique_ptr<std::atomic<uint8_t>[]> isUsed(new std::atomic<uint8_t>[numVertices]);
+    parallel_for_blocked
+      (0,numVertices,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          isUsed[i].store(false,std::memory_order_relaxed);
+      });
+    forEachVertexIndex(mesh,[&](int idx){
+        isUsed[idx].store(true,std::memory_order_relaxed);
+      });
+    ScratchVector<uint8_t> result(numVertices);
+    parallel_for_blocked
+      (0,numVertices,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          result[i] = isUsed[i].load(std::memory_order_relaxed);
+      });
+    return result;
+  }
+
+  ScratchVector<uint8_t> findUsedVertices(UMesh &mesh)
+  {
+    return findUsedVertices(mesh,mesh.vertices.size());
+  }
+
+  /*! returns the indices of all items for which 'selected(i)' is
+      true, in ascending order; computed in parallel, by first
+      counting the selected items per block, then doing a prefix sum
+      over the blocks, then writing each block's items */
+  template<typename Lambda>
+  std::vector<uint32_t> parallelCompact(size_t numItems, const Lambda &selected)
+  {
+    const size_t numBlocks = divRoundUp(numItems,reindexBlockSize);
+    std::vector<size_t> blockBegin(numBlocks+1,0);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*reindexBlockSize;
+        const size_t end   = std::min(begin+reindexBlockSize,numItems);
+        size_t count = 0;
+        for (size_t i=begin;i<end;i++)
+          if (selected(i)) ++count;
+        blockBegin[blockID+1] = count;
+      });
+    for (size_t blockID=0;blockID<numBlocks;blockID++)
+      blockBegin[blockID+1] += blockBegin[blockID];
+    std::vector<uint32_t> result(blockBegin[numBlocks]);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*reindexBlockSize;
+        const size_t end   = std::min(begin+reindexBlockSize,numItems);
+        size_t out = blockBegin[blockID];
+        for (size_t i=begin;i<end;i++)
+          if (selected(i)) result[out++] = uint32_t(i);
+      });
+    return result;
+  }
 
-  inline bool operator<(const BigVertex &a,
-                        const BigVertex &b)
+  /*! returns the array of 'array[source[i]]'s */
+  template<typename T>
+  std::vector<T> gather(Span<T> array,
+                        const std::vector<uint32_t> &source)
+  {
+    std::vector<T> result(source.size());
+    parallel_for_blocked
+      (0,source.size(),reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          result[i] = array[source[i]];
+      });
+    return result;
+  }
+
+  template<typename T>
+  std::vector<T> gather(const std::vector<T> &array,
+                        const std::vector<uint32_t> &source)
+  { return gather(Span<T>(array),source); }
+  
+  /*! a copy of given quantized attribute with only the values listed
+      in 'source' (in that order) */
+  QuantizedAttribute::SP gather(const QuantizedAttribute &attr,
+                                const std::vector<uint32_t> &source)
+  {
+    QuantizedAttribute::SP result = std::make_shared<QuantizedAttribute>();
+    result->name = attr.name;
+    result->setQuantization(attr.bits,attr.valueRange);
+    if (attr.bits == 8) result->codes8  = gather(attr.codes8,source);
+    else                result->codes16 = gather(attr.codes16,source);
+    return result;
+  }
+  
+  /*! replaces the mesh's vertices - along with all per-vertex
+      attributes, and the vertex tags (if present) - with those listed
+      in 'source', and makes all elements refer to their new indices,
+      as specified by 'newID' */
+  void reindexVertices(UMesh &mesh,
+                       const std::vector<uint32_t> &source,
+                       const std::vector<int> &newID)
   {
-    return a.pos < b.pos;
+    mesh.vertices = gather(mesh.vertices,source);
+    // 'perVertex' usually is one of 'attributes', but doesn't have to
+    std::vector<Attribute::SP> attributes = mesh.attributes;
+    if (mesh.perVertex &&
+        std::find(attributes.begin(),attributes.end(),mesh.perVertex) == attributes.end())
+      attributes.push_back(mesh.perVertex);
+    for (auto attribute : attributes)
+      if (attribute)
+        attribute->values = gather(attribute->values,source);
+    for (auto attribute : mesh.quantizedAttributes) {
+      if (attribute->bits == 8)
+        attribute->codes8  = gather(attribute->codes8,source);
+      else
+        attribute->codes16 = gather(attribute->codes16,source);
+    }
+    if (!mesh.vertexTags.empty())
+      mesh.vertexTags = gather(mesh.vertexTags,source);
+    
+    forEachVertexIndex(mesh,[&](int &idx){ idx = newID[idx]; });
   }
   
+  struct BigVertex {
+    vec3f    pos;
+    uint32_t orgID;
+  };
+
   void removeDuplicatesAndUnusedVertices(UMesh::SP mesh)
   {
     std::cout << "parallel reindexing : init for " << mesh->toString() << std::endl;
-    std::vector<BigVertex> vertices(mesh->vertices.size());
+    const ScratchVector<uint8_t> isUsed = findUsedVertices(*mesh);
 
-    // generate list of _all_ vertices, in 'fat' layout that can easily be re-ordered
+    // generate list of all _used_ vertices, in 'fat' layout that can easily be re-ordered
+    const std::vector<uint32_t> usedVertices
+      = parallelCompact(mesh->vertices.size(),[&](size_t i){ return isUsed[i]; });
+    ScratchVector<BigVertex> vertices(usedVertices.size());
     parallel_for_blocked
-      (0,vertices.size(),16*1024,
+      (0,vertices.size(),reindexBlockSize,
        [&](size_t begin, size_t end) {
          for (size_t i=begin;i<end;i++) {
-           vertices[i].pos = mesh->vertices[i];
-           vertices[i].scalar = mesh->perVertex->values[i];
-           vertices[i].orgID = (int)i;
-           vertices[i].active = false;
+           vertices[i].pos   = mesh->vertices[usedVertices[i]];
+           vertices[i].orgID = usedVertices[i];
          }
        });
+    
+    std::cout << "parallel reindexing - sorting vertices to find duplicates" << std::endl;
+    // least significant coordinate first, so we end up sorted by x, then y, then z
+    parallel_radix_sort(vertices,[](const BigVertex &v)
+                        { return radixKey(v.pos.z); });
+    parallel_radix_sort(vertices,[](const BigVertex &v)
+                        { return (uint64_t(radixKey(v.pos.x)) << 32) | radixKey(v.pos.y); });
 
-    // mark 
-    for (auto &prim : mesh->triangles) {
-      for (int i=0;i<prim.numVertices;i++)
-        vertices[prim[i]].active = true;
-    }
-    for (auto &prim : mesh->quads) {
-      for (int i=0;i<prim.numVertices;i++)
-        vertices[prim[i]].active = true;
-    }
+    std::cout << "parallel reindexing - finding unique used vertices" << std::endl;
+    // the last vertex of each run of equal positions is the one that
+    // survives (the sort is stable, so that's the last in input order)
+    const size_t numVertices = vertices.size();
+    auto isLastOfRun = [&](size_t i){
+      return (i+1 == numVertices) || (vertices[i+1].pos != vertices[i].pos);
+    };
+    const std::vector<uint32_t> lastOfRun = parallelCompact(numVertices,isLastOfRun);
+    const size_t numNewVertices = lastOfRun.size();
+    std::cout << "num vertices found : " << numNewVertices << std::endl;
+    
+    std::vector<uint32_t> source(numNewVertices);
+    std::vector<int> newID(mesh->vertices.size(),-1);
     parallel_for_blocked
-      (0,mesh->tets.size(),1024*64,
-       [&](size_t begin, size_t end){
-        for (size_t primID=begin;primID<end;primID++){
-          auto &prim = mesh->tets[primID];
-          for (int i=0;i<prim.numVertices;i++)
-            vertices[prim[i]].active = true;
-        }});
-    for (auto &prim : mesh->pyrs) {
-      for (int i=0;i<prim.numVertices;i++)
-        vertices[prim[i]].active = true;
-    }
-    for (auto &prim : mesh->wedges) {
-      for (int i=0;i<prim.numVertices;i++)
-        vertices[prim[i]].active = true;
-    }
-    for (auto &prim : mesh->hexes) {
-      for (int i=0;i<prim.numVertices;i++)
-        vertices[prim[i]].active = true;
-    }
+      (0,numNewVertices,reindexBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t runID=begin;runID<end;runID++) {
+           const size_t runEnd = lastOfRun[runID]+1;
+           const size_t runBegin = runID ? lastOfRun[runID-1]+1 : 0;
+           source[runID] = vertices[runEnd-1].orgID;
+           for (size_t i=runBegin;i<runEnd;i++)
+             newID[vertices[i].orgID] = int(runID);
+         }
+       });
+    vertices.clear();
+    vertices.shrink_to_fit();
 
+    std::cout << "parallel reindexing - translating indices" << std::endl;
+    reindexVertices(*mesh,source,newID);
+  }
 
+  void removeUnusedVertices(UMesh::SP mesh)
+  {
+    const ScratchVector<uint8_t> isUsed = findUsedVertices(*mesh);
+    const std::vector<uint32_t> source
+      = parallelCompact(mesh->vertices.size(),[&](size_t i){ return isUsed[i]; });
+    // unused vertices won't get referenced, anyway ...
+    std::vector<int> newID(mesh->vertices.size(),-1);
+    parallel_for_blocked
+      (0,source.size(),reindexBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           newID[source[i]] = int(i);
+       });
+    std::cout << "done compacting vertex array, num vertices found " << source.size() << std::endl;
+    reindexVertices(*mesh,source,newID);
+  }
 
+  void weldVertices(UMesh::SP mesh)
+  {
+    const size_t numVertices = mesh->vertices.size();
+    const std::vector<vec3f> &vertices = mesh->vertices;
+    if (numVertices >= size_t(INT_MAX))
+      throw std::runtime_error("#umesh.weldVertices: too many vertices");
 
+    // open-addressing hash table of vertex IDs, keyed by those
+    // vertices' positions. at most half full, so can never overflow;
+    // of all vertices with the same position the slot ends up with
+    // the lowest ID, no matter in which order they got inserted
+    const uint32_t EMPTY = uint32_t(-1);
+    size_t numSlots = 1;
+    while (numSlots < 2*numVertices) numSlots *= 2;
+    const size_t mask = numSlots-1;
+    std::unique_ptr<std::atomic<uint32_t>[]> slots(new std::atomic<uint32_t>[numSlots]);
+    parallel_for_blocked
+      (0,numSlots,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          slots[i].store(EMPTY,std::memory_order_relaxed);
+      });
     
+    parallel_for_blocked
+      (0,numVertices,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t vertexID=begin;vertexID<end;vertexID++) {
+          const vec3f v = vertices[vertexID];
+          // NaNs never compare equal, so never get welded
+          if (hasNaN(v)) continue;
+          for (size_t slot=positionHash(v)&mask;;slot=(slot+1)&mask) {
+            uint32_t owner = EMPTY;
+            if (slots[slot].compare_exchange_strong(owner,uint32_t(vertexID)))
+              break;
+            if (vertices[owner] != v)
+              continue;
+            while (vertexID < owner &&
+                   !slots[slot].compare_exchange_weak(owner,uint32_t(vertexID)))
+              ;
+            break;
+          }
+        }
+      });
 
+    // each vertex's representative - the lowest-ID vertex with the
+    // same position
+    std::vector<uint32_t> representative(numVertices);
+    parallel_for_blocked
+      (0,numVertices,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t vertexID=begin;vertexID<end;vertexID++) {
+          const vec3f v = vertices[vertexID];
+          representative[vertexID] = uint32_t(vertexID);
+          if (hasNaN(v)) continue;
+          for (size_t slot=positionHash(v)&mask;;slot=(slot+1)&mask) {
+            const uint32_t owner = slots[slot].load(std::memory_order_relaxed);
+            if (vertices[owner] != v) continue;
+            representative[vertexID] = owner;
+            break;
+          }
+        }
+      });
+    slots.reset();
 
+    const std::vector<uint32_t> source
+      = parallelCompact(numVertices,[&](size_t i){ return representative[i] == i; });
+    if (source.size() == numVertices)
+      return;
     
-    std::cout << "parallel reindexing - sorting vertices to find duplicates" << std::endl;
-# ifdef UMESH_HAVE_TBB
-    tbb::parallel_sort(vertices.data(),vertices.data()+vertices.size());
-# else
-    std::sort(vertices.data(),vertices.data()+vertices.size());
-# endif
+    std::vector<int> newID(numVertices);
+    parallel_for_blocked
+      (0,source.size(),reindexBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           newID[source[i]] = int(i);
+       });
+    parallel_for_blocked
+      (0,numVertices,reindexBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           if (representative[i] != i)
+             newID[i] = newID[representative[i]];
+       });
+    reindexVertices(*mesh,source,newID);
+  }
 
-    std::cout << "parallel reindexing - finding unique used vertices" << std::endl;
-    int curID = -1;
-    std::vector<int> newID(vertices.size());
-    for (size_t i=0;i<vertices.size();i++) {
-      if (!vertices[i].active) {
-        newID[vertices[i].orgID] = -1;
-        continue;
-      }
-      
-      if (i==0 || vertices[i].pos != vertices[i-1].pos)
-        ++curID;
-      
-      vertices[curID].pos = vertices[i].pos;
-      vertices[curID].scalar = vertices[i].scalar;
-      newID[vertices[i].orgID] = curID;
+  /*! for each prim type, the IDs of all of 'prims' that are of that
+      type, in the order they appear in 'prims'; computed in parallel
+      by counting each type per block, and then writing each block's
+      IDs to its (prefix-summed) position */
+  std::vector<std::vector<uint32_t>>
+  primIDsByType(const std::vector<UMesh::PrimRef> &prims)
+  {
+    const int    numTypes  = UMesh::INVALID;
+    const size_t numBlocks = divRoundUp(prims.size(),reindexBlockSize);
+    std::vector<size_t> blockBegin((numBlocks+1)*numTypes,0);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*reindexBlockSize;
+        const size_t end   = std::min(begin+reindexBlockSize,prims.size());
+        size_t *count = &blockBegin[(blockID+1)*numTypes];
+        for (size_t i=begin;i<end;i++) {
+          if (prims[i].type >= numTypes)
+            throw std::runtime_error("un-implemented prim type?");
+          count[prims[i].type]++;
+        }
+      });
+    for (size_t blockID=0;blockID<numBlocks;blockID++)
+      for (int type=0;type<numTypes;type++)
+        blockBegin[(blockID+1)*numTypes+type] += blockBegin[blockID*numTypes+type];
+    std::vector<std::vector<uint32_t>> result(numTypes);
+    for (int type=0;type<numTypes;type++)
+      result[type].resize(blockBegin[numBlocks*numTypes+type]);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*reindexBlockSize;
+        const size_t end   = std::min(begin+reindexBlockSize,prims.size());
+        size_t out[numTypes];
+        for (int type=0;type<numTypes;type++)
+          out[type] = blockBegin[blockID*numTypes+type];
+        for (size_t i=begin;i<end;i++)
+          result[prims[i].type][out[prims[i].type]++] = uint32_t(prims[i].ID);
+      });
+    return result;
+  }
+
+  /*! adds each vertex index of given prims to 'indices', starting at
+      'offset'; returns the offset after the last one */
+  template<typename Prim>
+  size_t appendVertexIndices(const std::vector<Prim> &prims,
+                             std::vector<uint32_t> &indices,
+                             size_t offset)
+  {
+    const int N = Prim::numVertices;
+    parallel_for_blocked
+      (0,prims.size(),reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t primID=begin;primID<end;primID++)
+          for (int i=0;i<N;i++)
+            indices[offset+primID*N+i] = uint32_t(prims[primID][i]);
+      });
+    return offset+prims.size()*N;
+  }
+
+  /*! returns, in ascending order, the indices of all vertices that are
+      used by any of given mesh's (non-grid) elements */
+  std::vector<uint32_t> collectUsedVertices(UMesh &mesh)
+  {
+    std::vector<uint32_t> indices(3*mesh.triangles.size()
+                                  +4*mesh.quads.size()
+                                  +4*mesh.tets.size()
+                                  +5*mesh.pyrs.size()
+                                  +6*mesh.wedges.size()
+                                  +8*mesh.hexes.size());
+    size_t offset = 0;
+    offset = appendVertexIndices(mesh.triangles,indices,offset);
+    offset = appendVertexIndices(mesh.quads,indices,offset);
+    offset = appendVertexIndices(mesh.tets,indices,offset);
+    offset = appendVertexIndices(mesh.pyrs,indices,offset);
+    offset = appendVertexIndices(mesh.wedges,indices,offset);
+    offset = appendVertexIndices(mesh.hexes,indices,offset);
+    parallel_radix_sort(indices,[](uint32_t idx){ return idx; });
+    const std::vector<uint32_t> firstOfRun
+      = parallelCompact(indices.size(),[&](size_t i){
+          return i == 0 || indices[i] != indices[i-1];
+        });
+    return gather(indices,firstOfRun);
+  }
+  
+  UMesh::SP extractPrims(UMesh::SP mesh,
+                         const std::vector<UMesh::PrimRef> &prims)
+  {
+    UMesh::SP out = std::make_shared<UMesh>();
+    const std::vector<std::vector<uint32_t>> primIDs = primIDsByType(prims);
+    out->triangles = gather(mesh->triangles,primIDs[UMesh::TRI]);
+    out->quads     = gather(mesh->quads,    primIDs[UMesh::QUAD]);
+    out->tets      = gather(mesh->tets,     primIDs[UMesh::TET]);
+    out->pyrs      = gather(mesh->pyrs,     primIDs[UMesh::PYR]);
+    out->wedges    = gather(mesh->wedges,   primIDs[UMesh::WEDGE]);
+    out->hexes     = gather(mesh->hexes,    primIDs[UMesh::HEX]);
+    for (auto attr : mesh->elementAttributes) {
+      Attribute::SP outAttr = std::make_shared<Attribute>();
+      outAttr->name   = attr.second->name;
+      outAttr->values = gather(attr.second->values,primIDs[attr.first]);
+      outAttr->finalize();
+      out->elementAttributes.push_back({attr.first,outAttr});
     }
-    int numNewVertices = curID;
-    std::cout << "num vertices found : " << numNewVertices << std::endl;
-    mesh->vertices.resize(numNewVertices);
-    mesh->perVertex->values.resize(numNewVertices);
-    for (int i=0;i<numNewVertices;i++) {
-      mesh->vertices[i] = vertices[i].pos;
-      mesh->perVertex->values[i] = vertices[i].scalar;
+
+    // grids don't refer to any vertices, but to their own scalars
+    for (auto gridID : primIDs[UMesh::GRID]) {
+      Grid grid = mesh->grids[gridID];
+      const float *scalars = mesh->gridScalars.data()+grid.scalarsOffset;
+      grid.scalarsOffset = int(out->gridScalars.size());
+      out->gridScalars.insert(out->gridScalars.end(),
+                              scalars,scalars+grid.numScalars());
+      out->grids.push_back(grid);
     }
-    vertices.clear();
 
-    std::cout << "parallel reindexing - translating indices" << std::endl;
-    for (auto &prim : mesh->triangles) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
+    // the used vertices keep their relative order, so an element's
+    // new vertex indices are the positions of its old ones in that
+    // (sorted) list of vertices
+    const std::vector<uint32_t> source = collectUsedVertices(*out);
+    forEachVertexIndex(*out,[&](int &idx){
+        idx = int(std::lower_bound(source.begin(),source.end(),uint32_t(idx))
+                  -source.begin());
+      });
+    out->vertices = gather(mesh->vertices,source);
+    for (auto attr : mesh->attributes) {
+      Attribute::SP outAttr = std::make_shared<Attribute>();
+      outAttr->name   = attr->name;
+      outAttr->values = gather(attr->values,source);
+      outAttr->finalize();
+      out->attributes.push_back(outAttr);
+      if (attr == mesh->perVertex)
+        out->perVertex = outAttr;
     }
-    for (auto &prim : mesh->quads) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
+    if (mesh->perVertex && !out->perVertex) {
+      out->perVertex = std::make_shared<Attribute>();
+      out->perVertex->name   = mesh->perVertex->name;
+      out->perVertex->values = gather(mesh->perVertex->values,source);
     }
+    for (auto attr : mesh->quantizedAttributes)
+      out->quantizedAttributes.push_back(gather(*attr,source));
+    if (!mesh->vertexTags.empty())
+      out->vertexTags = gather(mesh->vertexTags,source);
+
+    out->finalize();
+    return out;
+  }
+  
+  /*! re-indexes the elements of 'prims' - whose vertex indices refer
+      to an array of 'numInputVertices' vertices - to the compacted
+      array of only the used ones (in input order), and returns the
+      old indices of those */
+  std::vector<uint32_t> reindexUsedVertices(UMesh &prims, size_t numInputVertices)
+  {
+    const ScratchVector<uint8_t> isUsed = findUsedVertices(prims,numInputVertices);
+    std::vector<uint32_t> used
+      = parallelCompact(numInputVertices,[&](size_t i){ return isUsed[i]; });
+    ScratchVector<int> newID(numInputVertices);
     parallel_for_blocked
-      (0,mesh->tets.size(),1024*64,
-       [&](size_t begin, size_t end){
-        for (size_t primID=begin;primID<end;primID++){
-          auto &prim = mesh->tets[primID];
-          for (int i=0;i<prim.numVertices;i++)
-            prim[i] = newID[prim[i]];
-        }});
-    for (auto &prim : mesh->pyrs) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
+      (0,used.size(),reindexBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           newID[used[i]] = int(i);
+       });
+    forEachVertexIndex(prims,[&](int &idx){ idx = newID[idx]; });
+    return used;
+  }
+
+  void copyUsedVertices(UMesh &prims, const UMesh &source)
+  {
+    const std::vector<uint32_t> used = reindexUsedVertices(prims,source.vertices.size());
+    prims.vertices = gather(source.vertices,used);
+    prims.attributes.clear();
+    prims.perVertex = nullptr;
+    for (auto attr : source.attributes) {
+      Attribute::SP outAttr = std::make_shared<Attribute>();
+      outAttr->name   = attr->name;
+      outAttr->values = gather(attr->values,used);
+      prims.attributes.push_back(outAttr);
+      if (attr == source.perVertex)
+        prims.perVertex = outAttr;
     }
-    for (auto &prim : mesh->wedges) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
+    if (source.perVertex && !prims.perVertex) {
+      prims.perVertex = std::make_shared<Attribute>();
+      prims.perVertex->name   = source.perVertex->name;
+      prims.perVertex->values = gather(source.perVertex->values,used);
     }
-    for (auto &prim : mesh->hexes) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
+    prims.quantizedAttributes.clear();
+    for (auto attr : source.quantizedAttributes)
+      prims.quantizedAttributes.push_back(gather(*attr,used));
+    prims.vertexTags.clear();
+    if (!source.vertexTags.empty())
+      prims.vertexTags = gather(source.vertexTags,used);
+  }
+
+  void copyUsedVertices(UMesh &prims, const MeshView &source)
+  {
+    const std::vector<uint32_t> used = reindexUsedVertices(prims,source.vertices.size());
+    prims.vertices = gather(source.vertices,used);
+    prims.attributes.clear();
+    prims.perVertex = nullptr;
+    if (!source.scalars.empty()) {
+      prims.perVertex = std::make_shared<Attribute>();
+      prims.perVertex->values = gather(source.scalars,used);
+      prims.attributes.push_back(prims.perVertex);
     }
+    prims.quantizedAttributes.clear();
+    prims.vertexTags.clear();
   }
 
-  void removeUnusedVertices(UMesh::SP mesh)
+  /*! appends all of 'prims' to 'out' */
+  template<typename Prim>
+  void appendPrims(std::vector<Prim> &out, const std::vector<Prim> &prims)
+  {
+    out.insert(out.end(),prims.begin(),prims.end());
+  }
+  
+  /*! appends those of 'prims' to 'out' that don't use any vertex more
+      than once */
+  template<typename Prim>
+  void appendNonDegeneratePrims(std::vector<Prim> &out, const std::vector<Prim> &prims)
   {
-    std::vector<uint8_t> isUsed(mesh->vertices.size());
-    for (auto &flag : isUsed) flag = false;
+    const std::vector<uint32_t> good
+      = parallelCompact(prims.size(),[&](size_t i){ return noDuplicates(prims[i]); });
+    const size_t begin = out.size();
+    out.resize(begin+good.size());
+    parallel_for_blocked
+      (0,good.size(),reindexBlockSize,
+       [&](size_t b, size_t e){
+        for (size_t i=b;i<e;i++)
+          out[begin+i] = prims[good[i]];
+      });
+  }
+  
+  void RemeshHelper::addAll(UMesh::SP otherMesh,
+                            const std::vector<UMesh::PrimRef> &primRefs)
+  {
+    const std::vector<std::vector<uint32_t>> primIDs = primIDsByType(primRefs);
+    for (auto gridID : primIDs[UMesh::GRID])
+      add(otherMesh,UMesh::PrimRef(UMesh::GRID,gridID));
     
-    // mark 
-    for (auto &prim : mesh->triangles) {
-      for (int i=0;i<prim.numVertices;i++)
-        isUsed[prim[i]] = true;
-    }
-    for (auto &prim : mesh->quads) {
-      for (int i=0;i<prim.numVertices;i++)
-        isUsed[prim[i]] = true;
-    }
+    UMesh prims;
+    prims.triangles = gather(otherMesh->triangles,primIDs[UMesh::TRI]);
+    prims.quads     = gather(otherMesh->quads,    primIDs[UMesh::QUAD]);
+    prims.tets      = gather(otherMesh->tets,     primIDs[UMesh::TET]);
+    prims.pyrs      = gather(otherMesh->pyrs,     primIDs[UMesh::PYR]);
+    prims.wedges    = gather(otherMesh->wedges,   primIDs[UMesh::WEDGE]);
+    prims.hexes     = gather(otherMesh->hexes,    primIDs[UMesh::HEX]);
+    addAll(otherMesh,prims);
+  }
+  
+  void RemeshHelper::addAll(UMesh::SP otherMesh, UMesh &prims)
+  {
+    assert(otherMesh);
+    profile::ScopedTimer timer("remesh.addAll",0,prims.size());
+    const UMesh &other = *otherMesh;
+    const size_t numInputVertices = other.vertices.size();
+    const ScratchVector<uint8_t> isUsed = findUsedVertices(prims,numInputVertices);
+    const std::vector<uint32_t> used
+      = parallelCompact(numInputVertices,[&](size_t i){ return isUsed[i]; });
+    const size_t numUsed = used.size();
+    const size_t base    = target.vertices.size();
+    if (base+numUsed >= size_t(INT_MAX))
+      throw std::runtime_error("#umesh.RemeshHelper: too many vertices");
+
+    // until the new vertices are in the target, the hash table refers
+    // to used[k] with ID base+k; of all vertices with the same
+    // position the lowest ID wins, so vertices that already are in
+    // the target stay where they are, and new ones get added in input
+    // order
+    reserve(numKnown+numUsed);
+    const size_t mask = numKnownSlots-1;
+    auto position = [&](uint32_t ID) -> const vec3f & {
+      return ID < base ? target.vertices[ID] : other.vertices[used[ID-base]];
+    };
     parallel_for_blocked
-      (0,mesh->tets.size(),1024*64,
+      (0,numUsed,reindexBlockSize,
        [&](size_t begin, size_t end){
-        for (size_t primID=begin;primID<end;primID++){
-          auto &prim = mesh->tets[primID];
-          for (int i=0;i<prim.numVertices;i++)
-            isUsed[prim[i]] = true;
-        }});
-    for (auto &prim : mesh->pyrs) {
-      for (int i=0;i<prim.numVertices;i++)
-        isUsed[prim[i]] = true;
-    }
-    for (auto &prim : mesh->wedges) {
-      for (int i=0;i<prim.numVertices;i++)
-        isUsed[prim[i]] = true;
-    }
-    for (auto &prim : mesh->hexes) {
-      for (int i=0;i<prim.numVertices;i++)
-        isUsed[prim[i]] = true;
-    }
-
-    std::vector<int> newID(mesh->vertices.size());
-    int curID = 0;
-    for (int i=0;i<newID.size();i++) {
-      if (isUsed[i]) {
-        mesh->vertices[curID] = mesh->vertices[i];
-        if (mesh->perVertex)
-          mesh->perVertex->values[curID] = mesh->perVertex->values[i];
-        if (!mesh->vertexTags.empty())
-          mesh->vertexTags[curID] = mesh->vertexTags[i];
-        newID[i] = curID++;
-      } else {
-        // won't get used, anyway....
-        newID[i] = -1;
-      }
-    }
-    std::cout << "done compacting vertex array, num vertices found " << curID << std::endl;
-    mesh->vertices.resize(curID);
-    mesh->perVertex->values.resize(curID);
-    if (!mesh->vertexTags.empty())
-      mesh->vertexTags.resize(curID);
+        for (size_t k=begin;k<end;k++) {
+          const vec3f v = other.vertices[used[k]];
+          const uint32_t ID = uint32_t(base+k);
+          for (size_t slot=positionHash(v)&mask;;slot=(slot+1)&mask) {
+            uint32_t owner = EMPTY_SLOT;
+            if (knownVertices[slot].compare_exchange_strong(owner,ID))
+              break;
+            if (position(owner) != v)
+              continue;
+            while (ID < owner &&
+                   !knownVertices[slot].compare_exchange_weak(owner,ID))
+              ;
+            break;
+          }
+        }
+      });
 
+    std::vector<uint32_t> representative(numUsed);
+    parallel_for_blocked
+      (0,numUsed,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t k=begin;k<end;k++) {
+          const vec3f v = other.vertices[used[k]];
+          const uint32_t ID = uint32_t(base+k);
+          for (size_t slot=positionHash(v)&mask;;slot=(slot+1)&mask) {
+            const uint32_t owner = knownVertices[slot].load(std::memory_order_relaxed);
+            // (NaN vertices never compare equal, but do find themselves)
+            if (owner != ID && position(owner) != v) continue;
+            representative[k] = owner;
+            break;
+          }
+        }
+      });
+    const std::vector<uint32_t> newVertices
+      = parallelCompact(numUsed,[&](size_t k){ return representative[k] == base+k; });
+    const size_t numNew = newVertices.size();
     
-    for (auto &prim : mesh->triangles) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
-    }
-    for (auto &prim : mesh->quads) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
-    }
+    // final target ID of each used vertex
+    std::vector<uint32_t> finalID(numUsed);
     parallel_for_blocked
-      (0,mesh->tets.size(),1024*64,
+      (0,numNew,reindexBlockSize,
        [&](size_t begin, size_t end){
-        for (size_t primID=begin;primID<end;primID++){
-          auto &prim = mesh->tets[primID];
-          for (int i=0;i<prim.numVertices;i++)
-            prim[i] = newID[prim[i]];
-        }});
-    for (auto &prim : mesh->pyrs) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
-    }
-    for (auto &prim : mesh->wedges) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
-    }
-    for (auto &prim : mesh->hexes) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] = newID[prim[i]];
-    }
+        for (size_t i=begin;i<end;i++)
+          finalID[newVertices[i]] = uint32_t(base+i);
+      });
+    parallel_for_blocked
+      (0,numUsed,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t k=begin;k<end;k++) {
+          const uint32_t r = representative[k];
+          if (r != base+k)
+            finalID[k] = r < base ? r : finalID[r-base];
+        }
+      });
+    parallel_for_blocked
+      (0,numKnownSlots,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t slot=begin;slot<end;slot++) {
+          const uint32_t owner = knownVertices[slot].load(std::memory_order_relaxed);
+          if (owner != EMPTY_SLOT && owner >= base)
+            knownVertices[slot].store(finalID[owner-base],std::memory_order_relaxed);
+        }
+      });
+    numKnown += numNew;
+
+    // append the new vertices, with the same scalars and tags
+    // translate() would give them
+    const bool copyScalars = (bool)other.perVertex;
+    const bool copyTags    = !other.vertexTags.empty();
+    const bool writeTags   = copyTags || createVertexTags;
+    if (copyScalars && !target.perVertex)
+      target.perVertex = std::make_shared<Attribute>();
+    target.vertices.resize(base+numNew);
+    if (copyScalars)
+      target.perVertex->values.resize(base+numNew);
+    if (writeTags)
+      target.vertexTags.resize(base+numNew);
+    parallel_for_blocked
+      (0,numNew,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          const uint32_t in = used[newVertices[i]];
+          target.vertices[base+i] = other.vertices[in];
+          if (copyScalars)
+            target.perVertex->values[base+i] = other.perVertex->values[in];
+          if (writeTags)
+            target.vertexTags[base+i] = copyTags ? other.vertexTags[in] : size_t(in);
+        }
+      });
+
+    // translate and append the prims
+    ScratchVector<int> newID(numInputVertices);
+    parallel_for_blocked
+      (0,numUsed,reindexBlockSize,
+       [&](size_t begin, size_t end){
+        for (size_t k=begin;k<end;k++)
+          newID[used[k]] = int(finalID[k]);
+      });
+    forEachVertexIndex(prims,[&](int &idx){ idx = newID[idx]; });
+    appendNonDegeneratePrims(target.triangles,prims.triangles);
+    appendPrims(target.quads,prims.quads);
+    appendNonDegeneratePrims(target.tets,prims.tets);
+    appendPrims(target.pyrs,prims.pyrs);
+    appendPrims(target.wedges,prims.wedges);
+    appendPrims(target.hexes,prims.hexes);
   }
   
 } // ::umesh
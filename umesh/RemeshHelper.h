@@ -17,6 +17,8 @@
 #pragma once
 
 #include "UMesh.h"
+#include "MeshView.h"
+#include <atomic>
 
 namespace umesh {
   /*! helper clas that allows to create a new umesh's vertex array
@@ -76,20 +78,107 @@ namespace umesh {
     { translate((uint32_t*)indices,N,otherMesh); }
 
     void add(UMesh::SP otherMesh, UMesh::PrimRef primRef);
-    
-    std::map<vec3f,uint32_t> knownVertices;
+
+    /*! same as calling add() for each of the given prims (though
+        grids go first), but does all the work in parallel: the
+        prims' vertices get found through a flat array over the
+        other mesh's vertex indices, then get merged with those
+        already in the output - by position, just like add() does -
+        through a concurrent hash table, and get appended (with
+        their scalars and vertex tags) in the order of their index
+        in the other mesh. Meant for adding many prims at a time;
+        its cost is linear in the number of vertices and slots of
+        the other and the output mesh, respectively */
+    void addAll(UMesh::SP otherMesh,
+                const std::vector<UMesh::PrimRef> &primRefs);
+
+    /*! same as addAll(otherMesh,primRefs), for the surface and volume
+        elements (not grids) of 'prims', whose vertex indices refer to
+        'otherMesh's vertices. This translates 'prims' in place, then
+        appends them to the output */
+    void addAll(UMesh::SP otherMesh, UMesh &prims);
+
+    /*! number of (different) vertices that got added to the target
+        through this helper */
+    inline size_t numVertices() const { return numKnown; }
     
     UMesh &target;
     const bool createVertexTags;
-    // std::vector<size_t> vertexTag;
+
+  private:
+    /*! makes sure the hash table can hold (at least) given number of
+        vertices while being at most half full */
+    void reserve(size_t numVertices);
+    /*! looks up a vertex with given position among those already
+        added; returns false if there is none */
+    bool findKnown(const vec3f &v, uint32_t &ID) const;
+    /*! adds given (new) vertex of the target mesh to the hash
+        table */
+    void addKnown(const vec3f &v, uint32_t ID);
+    
+    /*! open-addressing hash table (with linear probing) of the IDs of
+        all vertices that got added to the target so far, keyed by
+        their position; the number of slots is 0 or a power of two */
+    std::unique_ptr<std::atomic<uint32_t>[]> knownVertices;
+    size_t numKnownSlots = 0;
+    size_t numKnown      = 0;
   };
   
+  /*! removes all vertices that are not used by any prim, merges all
+      vertices with the same position into one, and re-indexes all
+      prims accordingly. The remaining vertices get sorted by
+      position, and each takes its per-vertex attribute values and
+      tag from the last (in input order) of the used vertices it got
+      merged from */
   void removeDuplicatesAndUnusedVertices(UMesh::SP mesh);
 
   /*! removed all vertices that are not used by any prim, and
-      re-indexes all prims with the new vertex/value array indices
-      after this compaction. CAREFUL: this function assumes that the mesh does
-      NOT have duplicate vertices */
+      re-indexes all prims with the new vertex/attribute/tag array
+      indices after this compaction. CAREFUL: this function assumes
+      that the mesh does NOT have duplicate vertices */
   void removeUnusedVertices(UMesh::SP mesh);
 
+  /*! merges all vertices with the same position into one, and
+      re-indexes all prims accordingly. Unlike
+      removeDuplicatesAndUnusedVertices() this uses a hash table
+      rather than sorting, keeps the vertices in their input order,
+      and does not remove unused vertices; each remaining vertex
+      takes its attribute values and tag from the first (in input
+      order) of the vertices it got merged from */
+  void weldVertices(UMesh::SP mesh);
+
+  /*! replaces the mesh's vertices - along with all per-vertex
+      attributes, and the vertex tags (if present) - with those listed
+      in 'source' (ie, new vertex i is old vertex source[i]), and
+      makes all elements refer to their new indices, as specified by
+      'newID' (ie, old vertex j becomes new vertex newID[j]) */
+  void reindexVertices(UMesh &mesh,
+                       const std::vector<uint32_t> &source,
+                       const std::vector<int> &newID);
+
+  /*! gives the surface and volume elements of 'prims' - whose vertex
+      indices refer to the vertices of 'source' - their own copy of
+      exactly those vertices of 'source' they use (along with all
+      per-vertex attributes, and tags), in the order those had in
+      'source', and re-indexes the elements accordingly. Any vertices
+      'prims' had before get replaced. Uses a flat map over all of
+      source's vertices, and runs in parallel */
+  void copyUsedVertices(UMesh &prims, const UMesh &source);
+
+  /*! same as copyUsedVertices(prims,UMesh), for the vertices of given
+      view; the view's scalars (if any) become the 'perVertex'
+      attribute of 'prims' */
+  void copyUsedVertices(UMesh &prims, const MeshView &source);
+
+  /*! creates a new (finalized) mesh with copies of the given prims of
+      'mesh', and of exactly those vertices - with their attribute
+      values and tags - that those prims use. Unlike RemeshHelper,
+      this remaps vertices by their index rather than their position
+      (so vertices that are distinct in the input stay distinct in
+      the output), keeps the vertices in their input order, and does
+      all the work in parallel; it is thus also safe (and intended) to
+      extract many different sets of prims concurrently */
+  UMesh::SP extractPrims(UMesh::SP mesh,
+                         const std::vector<UMesh::PrimRef> &prims);
+
 } // ::tetty
@@ -0,0 +1,469 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/ScalarStats.h"
+#include "umesh/fixNegativeVolumes.h"
+#include "umesh/forEachElement.h"
+#include "umesh/profile.h"
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+namespace umesh {
+
+  /*! block size for the parallel passes over all values; blocks get
+      combined in order, so this - and not the number of threads -
+      is what determines the order of all floating point sums */
+  const size_t statsBlockSize = 64*1024;
+
+  /*! number of values each block's inner loop processes at once;
+      each of those 'lanes' has its own partial sums, so the loop
+      has no dependencies across values and can be vectorized */
+  const int statsLanes = 8;
+  
+  /*! what one block of values contributes to the stats */
+  struct StatsBlock {
+    size_t  numValues = 0, numNaNs = 0, numInfs = 0;
+    range1f valueRange;
+    /*! total weight, (weighted) mean, and (weighted) sum of squared
+        differences from that mean */
+    double  weight = 0., mean = 0., m2 = 0.;
+    std::vector<double> histogram;
+  };
+
+  /*! adds block 'b' to block 'a'; for mean and variance this is the
+      usual pairwise update (Chan et al) */
+  inline void merge(StatsBlock &a, const StatsBlock &b)
+  {
+    a.numValues += b.numValues;
+    a.numNaNs   += b.numNaNs;
+    a.numInfs   += b.numInfs;
+    a.valueRange.extend(b.valueRange);
+    if (b.weight > 0.) {
+      const double weight = a.weight+b.weight;
+      const double delta  = b.mean-a.mean;
+      a.mean   += delta*(b.weight/weight);
+      a.m2     += b.m2+delta*delta*(a.weight*b.weight/weight);
+      a.weight  = weight;
+    }
+    if (a.histogram.size() < b.histogram.size())
+      a.histogram.resize(b.histogram.size(),0.);
+    for (size_t i=0;i<b.histogram.size();i++)
+      a.histogram[i] += b.histogram[i];
+  }
+
+  /*! (partial) stats of values [begin,end), including their
+      histogram over given range if 'binned' */
+  template<bool weighted, bool binned>
+  void computeBlock(const float *values, const float *weights,
+                    size_t begin, size_t end,
+                    const range1f &histogramRange, int numBins,
+                    StatsBlock &block)
+  {
+    // sums are taken relative to the block's first finite value,
+    // which keeps the sums of squares accurate for values far from 0
+    float shift = 0.f;
+    for (size_t i=begin;i<end;i++)
+      if (std::isfinite(values[i])) { shift = values[i]; break; }
+
+    const float binLower = histogramRange.lower;
+    const float binScale
+      = histogramRange.upper > histogramRange.lower
+      ? numBins/(histogramRange.upper-histogramRange.lower)
+      : 0.f;
+    const float maxBin = float(std::max(numBins-1,0));
+    if (binned) block.histogram.assign(numBins,0.);
+    
+    float    lo[statsLanes], hi[statsLanes];
+    double   sumW[statsLanes], sum1[statsLanes], sum2[statsLanes];
+    uint32_t numNaNs[statsLanes], numInfs[statsLanes];
+    for (int j=0;j<statsLanes;j++) {
+      lo[j] = hi[j] = shift;
+      sumW[j] = sum1[j] = sum2[j] = 0.;
+      numNaNs[j] = numInfs[j] = 0;
+    }
+    // non-finite values count as 'shift' - which is one of the
+    // block's finite values - with zero weight, so all values go
+    // through the same, branch-free code
+    auto addValue = [&](int j, size_t k, int &bin, float &w) {
+      const float x = values[k];
+      const bool isNaN  = (x != x);
+      const bool finite = (x-x == 0.f);
+      numNaNs[j] += isNaN;
+      numInfs[j] += !finite && !isNaN;
+      const float v = finite ? x : shift;
+      const float weight = weighted ? weights[k] : 1.f;
+      w = finite ? weight : 0.f;
+      lo[j] = std::min(lo[j],v);
+      hi[j] = std::max(hi[j],v);
+      const double d = double(v)-double(shift);
+      sumW[j] += w;
+      sum1[j] += w*d;
+      sum2[j] += w*d*d;
+      bin = binned
+        ? int(std::max(0.f,std::min(maxBin,(v-binLower)*binScale)))
+        : 0;
+    };
+    size_t i = begin;
+    for (;i+statsLanes<=end;i+=statsLanes) {
+      int   bin[statsLanes];
+      float w[statsLanes];
+      for (int j=0;j<statsLanes;j++)
+        addValue(j,i+j,bin[j],w[j]);
+      if (binned)
+        for (int j=0;j<statsLanes;j++)
+          block.histogram[bin[j]] += w[j];
+    }
+    for (;i<end;i++) {
+      int   bin;
+      float w;
+      addValue(0,i,bin,w);
+      if (binned) block.histogram[bin] += w;
+    }
+
+    double weight = 0., s1 = 0., s2 = 0.;
+    for (int j=0;j<statsLanes;j++) {
+      block.numNaNs += numNaNs[j];
+      block.numInfs += numInfs[j];
+      weight += sumW[j];
+      s1     += sum1[j];
+      s2     += sum2[j];
+    }
+    block.numValues = (end-begin)-block.numNaNs-block.numInfs;
+    if (block.numValues) {
+      for (int j=0;j<statsLanes;j++) {
+        block.valueRange.lower = std::min(block.valueRange.lower,lo[j]);
+        block.valueRange.upper = std::max(block.valueRange.upper,hi[j]);
+      }
+    }
+    block.weight = weight;
+    if (weight > 0.) {
+      block.mean = shift+s1/weight;
+      block.m2   = std::max(0.,s2-s1*s1/weight);
+    }
+  }
+
+  /*! runs computeBlock() over all blocks of the values, in parallel,
+      and merges the blocks in order */
+  StatsBlock computeBlocks(const float *values, size_t numValues,
+                           const float *weights,
+                           const range1f &histogramRange, int numBins)
+  {
+    // with many bins, use bigger blocks, so the per-block histograms
+    // do not take more memory than the values themselves
+    const size_t blockSize = std::max(statsBlockSize,size_t(numBins)*64);
+    std::vector<StatsBlock> blocks(divRoundUp(numValues,blockSize));
+    parallel_for(blocks.size(),[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,numValues);
+        StatsBlock &block = blocks[blockID];
+        if (weights)
+          numBins
+            ? computeBlock<true,true>(values,weights,begin,end,histogramRange,numBins,block)
+            : computeBlock<true,false>(values,weights,begin,end,histogramRange,numBins,block);
+        else
+          numBins
+            ? computeBlock<false,true>(values,weights,begin,end,histogramRange,numBins,block)
+            : computeBlock<false,false>(values,weights,begin,end,histogramRange,numBins,block);
+      });
+    StatsBlock all;
+    if (numBins) all.histogram.assign(numBins,0.);
+    for (auto &block : blocks)
+      merge(all,block);
+    return all;
+  }
+  
+  ScalarStats::SP computeStats(const float *values,
+                               size_t numValues,
+                               const float *weights,
+                               const ScalarStatsOptions &options)
+  {
+    profile::ScopedTimer timer("computeStats",numValues*sizeof(float),numValues);
+    const int numBins = std::max(0,options.numBins);
+    range1f histogramRange = options.histogramRange;
+    StatsBlock all;
+    if (numBins && histogramRange.empty()) {
+      // need the range before we can bin anything
+      all = computeBlocks(values,numValues,weights,range1f(),0);
+      histogramRange = all.valueRange;
+      all.histogram = computeBlocks(values,numValues,weights,
+                                    histogramRange,numBins).histogram;
+    } else
+      all = computeBlocks(values,numValues,weights,histogramRange,numBins);
+
+    ScalarStats::SP stats = std::make_shared<ScalarStats>();
+    stats->numValues      = all.numValues;
+    stats->numNaNs        = all.numNaNs;
+    stats->numInfs        = all.numInfs;
+    stats->valueRange     = all.valueRange;
+    stats->totalWeight    = all.weight;
+    stats->mean           = all.mean;
+    stats->variance       = all.weight > 0. ? all.m2/all.weight : 0.;
+    stats->volumeWeighted = (weights != nullptr);
+    if (numBins) {
+      stats->histogramRange = histogramRange;
+      stats->histogram      = all.histogram;
+    }
+    return stats;
+  }
+
+  /*! the (six times) volume of the pyramid from given face to
+      'center'; positive for inward-facing faces. Quads get the
+      average of their two triangulations */
+  inline float faceVolume(const vec3f &center,
+                          const vec3f &a, const vec3f &b, const vec3f &c)
+  { return signedVolume(a,b,c,center); }
+  inline float faceVolume(const vec3f &center,
+                          const vec3f &a, const vec3f &b,
+                          const vec3f &c, const vec3f &d)
+  {
+    return 0.5f*(signedVolume(a,b,c,center)+signedVolume(a,c,d,center)
+                 +signedVolume(a,b,d,center)+signedVolume(b,c,d,center));
+  }
+
+  inline float volumeOf(const vec3f *, const Triangle &) { return 0.f; }
+  inline float volumeOf(const vec3f *, const Quad &)     { return 0.f; }
+  inline float volumeOf(const vec3f *v, const Tet &tet)
+  { return signedVolume(v[tet[0]],v[tet[1]],v[tet[2]],v[tet[3]])/6.f; }
+  inline float volumeOf(const vec3f *v, const Pyr &pyr)
+  {
+    // relative to the apex, only the base contributes
+    return faceVolume(v[pyr[4]],v[pyr[0]],v[pyr[1]],v[pyr[2]],v[pyr[3]])/6.f;
+  }
+  inline float volumeOf(const vec3f *v, const Wedge &wedge)
+  {
+    // relative to vertex 0, only the faces without it contribute
+    const vec3f &c = v[wedge[0]];
+    return (faceVolume(c,v[wedge[3]],v[wedge[4]],v[wedge[5]])
+            +faceVolume(c,v[wedge[1]],v[wedge[2]],v[wedge[5]],v[wedge[4]]))/6.f;
+  }
+  inline float volumeOf(const vec3f *v, const Hex &hex)
+  {
+    // relative to vertex 0, only the three faces without it contribute
+    const vec3f &c = v[hex[0]];
+    return (faceVolume(c,v[hex[4]],v[hex[7]],v[hex[6]],v[hex[5]])
+            +faceVolume(c,v[hex[2]],v[hex[6]],v[hex[7]],v[hex[3]])
+            +faceVolume(c,v[hex[1]],v[hex[5]],v[hex[6]],v[hex[2]]))/6.f;
+  }
+  
+  float elementVolume(const UMesh &mesh, const UMesh::PrimRef &prim)
+  {
+    const vec3f *v = mesh.vertices.data();
+    switch (prim.type) {
+    case UMesh::TET:   return volumeOf(v,mesh.tets[prim.ID]);
+    case UMesh::PYR:   return volumeOf(v,mesh.pyrs[prim.ID]);
+    case UMesh::WEDGE: return volumeOf(v,mesh.wedges[prim.ID]);
+    case UMesh::HEX:   return volumeOf(v,mesh.hexes[prim.ID]);
+    default:           return 0.f;
+    }
+  }
+
+  /*! the volume of each element of given type */
+  std::vector<float> elementVolumes(const UMesh &mesh, UMesh::PrimType type)
+  {
+    std::vector<float> volumes;
+    forEachElementType(mesh,[&](const auto &prims, UMesh::PrimType primType){
+        if (primType != type) return;
+        volumes.resize(prims.size());
+        parallel_for_blocked
+          (0,prims.size(),statsBlockSize,
+           [&](size_t begin, size_t end) {
+             for (size_t i=begin;i<end;i++)
+               volumes[i] = volumeOf(mesh.vertices.data(),prims[i]);
+           });
+      });
+    return volumes;
+  }
+
+  /*! the (lumped) volume each vertex stands for: each volume
+      element's volume, split evenly among its vertices. The volumes
+      get computed in parallel, but added up serially, in element
+      order, so the result is the same for any number of threads */
+  std::vector<float> vertexVolumes(const UMesh &mesh)
+  {
+    std::vector<double> sums(mesh.vertices.size(),0.);
+    forEachElementType(mesh,[&](const auto &prims, UMesh::PrimType type){
+        const std::vector<float> volumes = elementVolumes(mesh,type);
+        for (size_t i=0;i<prims.size();i++) {
+          const double share = volumes[i]/numVerticesOf(prims[i]);
+          for (int j=0;j<numVerticesOf(prims[i]);j++)
+            sums[prims[i][j]] += share;
+        }
+      },VOLUME_ELEMENTS);
+    std::vector<float> volumes(sums.size());
+    parallel_for_blocked
+      (0,sums.size(),statsBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           volumes[i] = (float)sums[i];
+       });
+    return volumes;
+  }
+  
+  ScalarStats::SP computeStats(UMesh::SP mesh,
+                               const Attribute &attribute,
+                               const ScalarStatsOptions &options)
+  {
+    assert(mesh);
+    // which of the mesh's attributes is this?
+    bool isVertexAttribute = (mesh->perVertex.get() == &attribute);
+    for (auto &attr : mesh->attributes)
+      isVertexAttribute |= (attr.get() == &attribute);
+    UMesh::PrimType elementType = UMesh::INVALID;
+    for (auto &attr : mesh->elementAttributes)
+      if (attr.second.get() == &attribute) elementType = attr.first;
+    if (!isVertexAttribute && elementType == UMesh::INVALID)
+      throw std::runtime_error("#umesh.computeStats: attribute '"+attribute.name
+                               +"' is not one of the mesh's attributes");
+
+    ScalarStatsOptions attributeOptions = options;
+    if (attributeOptions.histogramRange.empty() &&
+        !attribute.valueRange.empty() &&
+        std::isfinite(attribute.valueRange.lower) &&
+        std::isfinite(attribute.valueRange.upper))
+      attributeOptions.histogramRange = attribute.valueRange;
+    
+    if (!options.volumeWeighted)
+      return computeStats(attribute.values.data(),attribute.values.size(),
+                          nullptr,attributeOptions);
+
+    const std::vector<float> weights
+      = isVertexAttribute
+      ? vertexVolumes(*mesh)
+      : elementVolumes(*mesh,elementType);
+    if (weights.size() != attribute.values.size())
+      throw std::runtime_error("#umesh.computeStats: attribute '"+attribute.name
+                               +"' does not have one value per "
+                               +(isVertexAttribute?"vertex":"element"));
+    return computeStats(attribute.values.data(),attribute.values.size(),
+                        weights.data(),attributeOptions);
+  }
+
+  void computeAllStats(UMesh::SP mesh, const ScalarStatsOptions &options)
+  {
+    assert(mesh);
+    if (mesh->perVertex)
+      mesh->perVertex->stats = computeStats(mesh,*mesh->perVertex,options);
+    for (auto &attr : mesh->attributes)
+      if (attr != mesh->perVertex)
+        attr->stats = computeStats(mesh,*attr,options);
+    for (auto &attr : mesh->elementAttributes)
+      attr.second->stats = computeStats(mesh,*attr.second,options);
+  }
+  
+  float ScalarStats::percentile(float fraction) const
+  {
+    double total = 0.;
+    for (auto bin : histogram) total += bin;
+    if (histogram.empty() || total <= 0.)
+      return std::numeric_limits<float>::quiet_NaN();
+
+    const double binWidth
+      = (histogramRange.upper-histogramRange.lower)/histogram.size();
+    const double target = std::max(0.f,std::min(1.f,fraction))*total;
+    double before = 0.;
+    for (size_t i=0;i<histogram.size();i++) {
+      if (before+histogram[i] >= target && histogram[i] > 0.)
+        return float(histogramRange.lower
+                     +(i+(target-before)/histogram[i])*binWidth);
+      before += histogram[i];
+    }
+    return histogramRange.upper;
+  }
+    
+  std::string ScalarStats::toString() const
+  {
+    std::stringstream ss;
+    ss << prettyNumber(numValues) << " finite values";
+    if (numNaNs || numInfs)
+      ss << " (plus " << prettyNumber(numNaNs) << " NaNs, "
+         << prettyNumber(numInfs) << " infs)";
+    if (numValues) {
+      ss << ", range " << valueRange
+         << ", mean " << mean << ", stddev " << sqrt(variance);
+      if (!histogram.empty())
+        ss << ", median " << percentile(.5f);
+    }
+    if (volumeWeighted)
+      ss << " (volume-weighted)";
+    if (!histogram.empty())
+      ss << ", " << histogram.size() << "-bin histogram";
+    return ss.str();
+  }
+
+  /*! the fixed-size part of the encoded stats; followed by one double
+      per histogram bin */
+  struct EncodedStats {
+    uint32_t version = 1;
+    uint32_t numBins = 0;
+    uint64_t numValues, numNaNs, numInfs;
+    range1f  valueRange;
+    range1f  histogramRange;
+    double   mean, variance, totalWeight;
+    uint32_t volumeWeighted;
+    uint32_t unused = 0;
+  };
+  
+  void ScalarStats::encode(std::vector<uint8_t> &bytes) const
+  {
+    EncodedStats encoded;
+    encoded.numBins        = (uint32_t)histogram.size();
+    encoded.numValues      = numValues;
+    encoded.numNaNs        = numNaNs;
+    encoded.numInfs        = numInfs;
+    encoded.valueRange     = valueRange;
+    encoded.histogramRange = histogramRange;
+    encoded.mean           = mean;
+    encoded.variance       = variance;
+    encoded.totalWeight    = totalWeight;
+    encoded.volumeWeighted = volumeWeighted;
+    const size_t begin = bytes.size();
+    bytes.resize(begin+sizeof(encoded)+histogram.size()*sizeof(double));
+    memcpy(bytes.data()+begin,&encoded,sizeof(encoded));
+    if (!histogram.empty())
+      memcpy(bytes.data()+begin+sizeof(encoded),histogram.data(),
+             histogram.size()*sizeof(double));
+  }
+  
+  ScalarStats::SP ScalarStats::decode(const uint8_t *bytes, size_t numBytes)
+  {
+    EncodedStats encoded;
+    if (numBytes < sizeof(encoded))
+      throw std::runtime_error("#umesh.ScalarStats: encoded stats too small");
+    memcpy(&encoded,bytes,sizeof(encoded));
+    if (encoded.version != 1)
+      throw std::runtime_error("#umesh.ScalarStats: unsupported stats version "
+                               +std::to_string(encoded.version));
+    if (numBytes != sizeof(encoded)+encoded.numBins*sizeof(double))
+      throw std::runtime_error("#umesh.ScalarStats: encoded stats have wrong size");
+    ScalarStats::SP stats = std::make_shared<ScalarStats>();
+    stats->numValues      = encoded.numValues;
+    stats->numNaNs        = encoded.numNaNs;
+    stats->numInfs        = encoded.numInfs;
+    stats->valueRange     = encoded.valueRange;
+    stats->histogramRange = encoded.histogramRange;
+    stats->mean           = encoded.mean;
+    stats->variance       = encoded.variance;
+    stats->totalWeight    = encoded.totalWeight;
+    stats->volumeWeighted = encoded.volumeWeighted;
+    stats->histogram.resize(encoded.numBins);
+    if (encoded.numBins)
+      memcpy(stats->histogram.data(),bytes+sizeof(encoded),
+             encoded.numBins*sizeof(double));
+    return stats;
+  }
+  
+} // ::umesh
@@ -0,0 +1,110 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! what to compute in computeStats() */
+  struct ScalarStatsOptions {
+    /*! number of histogram bins; 0 for no histogram */
+    int     numBins = 256;
+    /*! weight each value by the volume it stands for: the volume of
+        its element for per-element attributes, and for per-vertex
+        attributes the (lumped) share of the volumes of the elements
+        that use the vertex, ie, each element's volume split evenly
+        among its vertices. Without this, all values have weight 1 */
+    bool    volumeWeighted = false;
+    /*! range the histogram bins cover; if empty, that's the range of
+        the (finite) values - which, if not already known, takes one
+        more pass over the values */
+    range1f histogramRange;
+  };
+  
+  /*! statistics of an array of scalars: range, mean, and variance of
+      its finite values, how many values are NaN or infinite, and
+      (optionally) a histogram */
+  struct ScalarStats {
+    typedef std::shared_ptr<ScalarStats> SP;
+
+    /*! the value below which lies given fraction (0..1) of the total
+        weight of all finite values, interpolated within the
+        histogram's bins (so only as accurate as those); NaN if
+        there's no histogram */
+    float percentile(float fraction) const;
+    
+    /*! a one-line summary, for things like umeshInfo */
+    std::string toString() const;
+
+    /*! appends a (binary) encoding of these stats to given array;
+        this is what gets stored in .umesh files */
+    void encode(std::vector<uint8_t> &bytes) const;
+    /*! decodes what encode() produced; throws if it's not valid */
+    static ScalarStats::SP decode(const uint8_t *bytes, size_t numBytes);
+    
+    /*! number of finite values */
+    size_t  numValues = 0;
+    size_t  numNaNs   = 0;
+    size_t  numInfs   = 0;
+    /*! range of the finite values */
+    range1f valueRange;
+    /*! (weighted) mean and variance of the finite values */
+    double  mean        = 0.;
+    double  variance    = 0.;
+    /*! sum of the weights of all finite values; their number without
+        volume weighting */
+    double  totalWeight = 0.;
+    bool    volumeWeighted = false;
+    /*! the histogram: the range it covers, and the total weight of
+        the finite values in each of its equally sized bins; values
+        outside that range count towards the first or last bin */
+    range1f histogramRange;
+    std::vector<double> histogram;
+  };
+
+  /*! computes the stats of given values - if 'weights' is not null,
+      weighted by those - in one parallel pass over fixed-size blocks
+      (or two, if the histogram range has to be computed first). The
+      blocks get combined in order, so the result does not depend on
+      the number of threads. Options other than the histogram ones
+      get ignored */
+  ScalarStats::SP computeStats(const float *values,
+                               size_t numValues,
+                               const float *weights,
+                               const ScalarStatsOptions &options = ScalarStatsOptions());
+
+  /*! computes the stats of given attribute of given mesh (either one
+      of its per-vertex or per-element attributes); for volume
+      weights, see ScalarStatsOptions::volumeWeighted. If no
+      histogram range is given, the attribute's valueRange gets used
+      if that's known (and finite) */
+  ScalarStats::SP computeStats(UMesh::SP mesh,
+                               const Attribute &attribute,
+                               const ScalarStatsOptions &options = ScalarStatsOptions());
+
+  /*! computes - and stores with each attribute - the stats of all of
+      given mesh's per-vertex and per-element attributes */
+  void computeAllStats(UMesh::SP mesh,
+                       const ScalarStatsOptions &options = ScalarStatsOptions());
+
+  /*! the volume of given element; computed from its (triangulated)
+      faces, with each (bilinear) quad face taken as the average of
+      its two triangulations */
+  float elementVolume(const UMesh &mesh, const UMesh::PrimRef &prim);
+  
+} // ::umesh
@@ -0,0 +1,255 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/ScratchArena.h"
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#ifndef _WIN32
+# include <sys/mman.h>
+#endif
+
+namespace umesh {
+
+  /*! size classes are powers of two, from 64 bytes (class 6) up to
+      class numSizeClasses-1 */
+  const int minSizeClass    = 6;
+  const int numSizeClasses  = 8*sizeof(size_t);
+  /*! largest class that gets cached per thread */
+  const int maxThreadClass  = 20;
+  /*! maximum number of buffers a thread caches per size class */
+  const int maxThreadCached = 8;
+
+  static_assert((size_t(1) << maxThreadClass) == ScratchArena::maxThreadCachedSize,
+                "thread cache classes do not match maxThreadCachedSize");
+  
+  inline int sizeClassOf(size_t numBytes)
+  {
+    int sizeClass = minSizeClass;
+    while ((size_t(1) << sizeClass) < numBytes) sizeClass++;
+    return sizeClass;
+  }
+
+  /*! a fresh buffer of the size of given class */
+  void *allocateBuffer(int sizeClass)
+  {
+    const size_t numBytes = size_t(1) << sizeClass;
+#ifndef _WIN32
+    if (numBytes >= ScratchArena::hugePageSize) {
+      void *ptr = mmap(nullptr,numBytes,PROT_READ|PROT_WRITE,
+                       MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+      if (ptr == MAP_FAILED) throw std::bad_alloc();
+# ifdef MADV_HUGEPAGE
+      madvise(ptr,numBytes,MADV_HUGEPAGE);
+# endif
+      return ptr;
+    }
+    void *ptr = std::aligned_alloc(ScratchArena::alignment,numBytes);
+#else
+    void *ptr = _aligned_malloc(numBytes,ScratchArena::alignment);
+#endif
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+  }
+
+  void freeBuffer(void *ptr, int sizeClass)
+  {
+    const size_t numBytes = size_t(1) << sizeClass;
+#ifndef _WIN32
+    if (numBytes >= ScratchArena::hugePageSize)
+      munmap(ptr,numBytes);
+    else
+      std::free(ptr);
+#else
+    _aligned_free(ptr);
+#endif
+  }
+
+  /*! the buffers (of the small size classes) cached by one thread */
+  struct ThreadCache {
+    std::vector<void *> buffers[maxThreadClass+1];
+  };
+
+  /*! every arena ever created gets a different ID, so threads can
+      find their cache for a given arena without ever confusing a
+      dead arena with a new one at the same address */
+  std::atomic<uint64_t> nextArenaID(0);
+  thread_local std::unordered_map<uint64_t,ThreadCache *> threadCaches;
+  /*! the arena (ID) and cache of this thread's last lookup; usually
+      the only arena in use */
+  thread_local uint64_t     lastArenaID    = uint64_t(-1);
+  thread_local ThreadCache *lastThreadCache = nullptr;
+  
+  struct ScratchArena::Impl {
+    ThreadCache &threadCache()
+    {
+      if (lastArenaID == ID)
+        return *lastThreadCache;
+      ThreadCache *&cache = threadCaches[ID];
+      if (!cache) {
+        std::lock_guard<std::mutex> lock(mutex);
+        allThreadCaches.emplace_back(new ThreadCache);
+        cache = allThreadCaches.back().get();
+      }
+      lastArenaID     = ID;
+      lastThreadCache = cache;
+      return *cache;
+    }
+
+    void freeAll(std::vector<void *> &buffers, int sizeClass)
+    {
+      for (auto ptr : buffers) freeBuffer(ptr,sizeClass);
+      cachedBytes -= buffers.size() << sizeClass;
+      buffers.clear();
+    }
+    
+    const uint64_t       ID = nextArenaID++;
+    std::mutex           mutex;
+    /*! the shared pool */
+    std::vector<void *>  buffers[numSizeClasses];
+    /*! bytes in the shared pool */
+    size_t               pooledBytes = 0;
+    std::vector<std::unique_ptr<ThreadCache>> allThreadCaches;
+    
+    std::atomic<size_t>  numAllocations { 0 };
+    std::atomic<size_t>  numReused { 0 };
+    std::atomic<size_t>  cachedBytes { 0 };
+  };
+
+  ScratchArena::SP ScratchArena::create(size_t maxCachedBytes)
+  {
+    return std::make_shared<ScratchArena>(maxCachedBytes);
+  }
+  
+  ScratchArena::ScratchArena(size_t maxCachedBytes)
+    : maxCachedBytes(maxCachedBytes),
+      impl(new Impl)
+  {}
+
+  ScratchArena::~ScratchArena()
+  {
+    trim();
+  }
+
+  void *ScratchArena::allocate(size_t numBytes)
+  {
+    const int sizeClass = sizeClassOf(numBytes);
+    impl->numAllocations++;
+    if (sizeClass <= maxThreadClass) {
+      std::vector<void *> &cached = impl->threadCache().buffers[sizeClass];
+      if (!cached.empty()) {
+        void *ptr = cached.back();
+        cached.pop_back();
+        impl->cachedBytes -= size_t(1) << sizeClass;
+        impl->numReused++;
+        return ptr;
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      std::vector<void *> &pooled = impl->buffers[sizeClass];
+      if (!pooled.empty()) {
+        void *ptr = pooled.back();
+        pooled.pop_back();
+        impl->pooledBytes -= size_t(1) << sizeClass;
+        impl->cachedBytes -= size_t(1) << sizeClass;
+        impl->numReused++;
+        return ptr;
+      }
+    }
+    return allocateBuffer(sizeClass);
+  }
+
+  void ScratchArena::release(void *ptr, size_t numBytes)
+  {
+    if (!ptr) return;
+    const int sizeClass = sizeClassOf(numBytes);
+    const size_t classBytes = size_t(1) << sizeClass;
+    if (sizeClass <= maxThreadClass) {
+      std::vector<void *> &cached = impl->threadCache().buffers[sizeClass];
+      if (cached.size() < maxThreadCached) {
+        cached.push_back(ptr);
+        impl->cachedBytes += classBytes;
+        return;
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(impl->mutex);
+      if (impl->pooledBytes+classBytes <= maxCachedBytes) {
+        impl->buffers[sizeClass].push_back(ptr);
+        impl->pooledBytes += classBytes;
+        impl->cachedBytes += classBytes;
+        return;
+      }
+    }
+    freeBuffer(ptr,sizeClass);
+  }
+
+  void ScratchArena::trim()
+  {
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    for (int sizeClass=0;sizeClass<numSizeClasses;sizeClass++)
+      impl->freeAll(impl->buffers[sizeClass],sizeClass);
+    impl->pooledBytes = 0;
+    for (auto &cache : impl->allThreadCaches)
+      for (int sizeClass=0;sizeClass<=maxThreadClass;sizeClass++)
+        impl->freeAll(cache->buffers[sizeClass],sizeClass);
+  }
+
+  ScratchArena::Stats ScratchArena::stats() const
+  {
+    Stats stats;
+    stats.numAllocations = impl->numAllocations;
+    stats.numReused      = impl->numReused;
+    stats.cachedBytes    = impl->cachedBytes;
+    return stats;
+  }
+
+  // ==================================================================
+  // selecting the arena
+  // ==================================================================
+
+  thread_local ScratchArena *scopedScratchArena = nullptr;
+  ScratchArena::SP           defaultScratchArenaSP;
+  std::atomic<ScratchArena*> defaultScratchArena(nullptr);
+
+  void setDefaultScratchArena(ScratchArena::SP arena)
+  {
+    defaultScratchArena   = arena.get();
+    defaultScratchArenaSP = arena;
+  }
+
+  ScratchArena *currentScratchArena()
+  {
+    if (scopedScratchArena)
+      return scopedScratchArena;
+    return defaultScratchArena.load(std::memory_order_relaxed);
+  }
+
+  ScopedScratchArena::ScopedScratchArena(ScratchArena::SP arena)
+    : arena(arena),
+      previous(scopedScratchArena)
+  {
+    scopedScratchArena = arena.get();
+  }
+
+  ScopedScratchArena::~ScopedScratchArena()
+  {
+    scopedScratchArena = previous;
+  }
+
+} // ::umesh
@@ -0,0 +1,191 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* reusable memory for the large, short-lived arrays that algorithms
+   allocate on every call (facet arrays, re-indexing tables, sort
+   buffers, ...). By default umesh allocates those the usual way;
+   applications that call umesh over and over again - eg, a
+   long-running service - can instead have them drawn from (and
+   returned to) a scratch arena, either globally
+   (setDefaultScratchArena()), or for all umesh calls made by one
+   thread within a given scope (ScopedScratchArena):
+
+     ScratchArena::SP scratch = ScratchArena::create();
+     for (auto mesh : meshes) {
+       ScopedScratchArena use(scratch);
+       FaceConn::compute(mesh);  // re-uses the previous call's buffers
+     }
+
+   This avoids having to fault-in fresh pages for every call, and
+   keeps the process' memory from fragmenting. Only the temporary
+   arrays of an algorithm come from the arena; its results are
+   regular, owning objects. */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace umesh {
+
+  /*! a thread-safe cache of freed buffers, grouped by (power-of-two)
+      size class. Buffers of up to maxThreadCachedSize bytes first
+      go to a small cache of the thread that released them, so small
+      per-block buffers get re-used without any locking; larger ones
+      go to a shared pool of at most maxCachedBytes bytes, and get
+      freed once that is full. Buffers of hugePageSize bytes and more
+      get mapped directly from the OS, and (on linux) get backed by
+      transparent huge pages. All buffers are 'alignment'-byte
+      aligned */
+  struct ScratchArena {
+    typedef std::shared_ptr<ScratchArena> SP;
+
+    static const size_t alignment           = 64;
+    static const size_t hugePageSize        = size_t(2)<<20;
+    static const size_t maxThreadCachedSize = size_t(1)<<20;
+    static const size_t defaultMaxCachedBytes = size_t(4)<<30;
+
+    struct Stats {
+      /*! number of buffers handed out */
+      size_t numAllocations = 0;
+      /*! how many of those were re-used (rather than freshly
+          allocated) buffers */
+      size_t numReused      = 0;
+      /*! bytes currently held in the arena's caches */
+      size_t cachedBytes    = 0;
+    };
+
+    static ScratchArena::SP create(size_t maxCachedBytes = defaultMaxCachedBytes);
+
+    ScratchArena(size_t maxCachedBytes = defaultMaxCachedBytes);
+    ScratchArena(const ScratchArena &) = delete;
+    /*! frees all cached buffers; all buffers handed out have to have
+        been released by then */
+    ~ScratchArena();
+
+    /*! a buffer of at least 'numBytes' bytes, with undefined
+        content */
+    void *allocate(size_t numBytes);
+    /*! returns a buffer that allocate(numBytes) returned (with the
+        same numBytes) to the arena */
+    void release(void *ptr, size_t numBytes);
+
+    /*! frees all cached buffers, including those in the threads'
+        caches; must not be called while any other thread uses the
+        arena */
+    void trim();
+
+    Stats stats() const;
+
+    /*! maximum number of bytes in the shared pool */
+    const size_t maxCachedBytes;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+  };
+
+  /*! sets the arena that all umesh algorithms draw their scratch
+      memory from, unless overridden by a ScopedScratchArena; nullptr
+      (the default) means regular allocations. Should not be changed
+      while any umesh function is running */
+  void setDefaultScratchArena(ScratchArena::SP arena);
+
+  /*! the arena that scratch memory allocated by this thread currently
+      comes from, or nullptr for regular allocations */
+  ScratchArena *currentScratchArena();
+
+  /*! makes all scratch memory that umesh algorithms started by the
+      current thread allocate within this object's lifetime come from
+      given arena (nullptr meaning the default one); scopes can be
+      nested. Worker threads of those algorithms' parallel loops use
+      the same arena for scratch arrays their caller set up */
+  struct ScopedScratchArena {
+    ScopedScratchArena(ScratchArena::SP arena);
+    ~ScopedScratchArena();
+    ScopedScratchArena(const ScopedScratchArena &) = delete;
+  private:
+    ScratchArena::SP const arena;
+    ScratchArena          *previous;
+  };
+
+  /*! allocator for containers of scratch data: draws from the arena
+      that was current (on the constructing thread) when the
+      allocator got created - or, if there was none, from the
+      regular heap. Containers that get copied from one keep using
+      that same arena, even in other threads */
+  template<typename T>
+  struct ScratchAllocator {
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ScratchAllocator() : arena(currentScratchArena()) {}
+    ScratchAllocator(ScratchArena *arena) : arena(arena) {}
+    template<typename U>
+    ScratchAllocator(const ScratchAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t n)
+    {
+      return (T*)(arena
+                  ? arena->allocate(n*sizeof(T))
+                  : ::operator new(n*sizeof(T)));
+    }
+    void deallocate(T *ptr, size_t n)
+    {
+      if (arena)
+        arena->release(ptr,n*sizeof(T));
+      else
+        ::operator delete(ptr);
+    }
+
+    template<typename U>
+    bool operator==(const ScratchAllocator<U> &other) const { return arena == other.arena; }
+    template<typename U>
+    bool operator!=(const ScratchAllocator<U> &other) const { return arena != other.arena; }
+
+    ScratchArena *arena;
+  };
+
+  /*! a std::vector for scratch data; see ScratchAllocator */
+  template<typename T>
+  using ScratchVector = std::vector<T,ScratchAllocator<T>>;
+
+  /*! a fixed-size array of 'size' (trivially copyable) elements of
+      scratch memory, from the current arena (see ScratchAllocator);
+      unlike a ScratchVector this does not initialize its content */
+  template<typename T>
+  struct ScratchBuffer {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "scratch buffers can only hold trivially copyable types");
+
+    ScratchBuffer(size_t size)
+      : size(size), ptr(size ? allocator.allocate(size) : nullptr)
+    {}
+    ~ScratchBuffer() { if (ptr) allocator.deallocate(ptr,size); }
+    ScratchBuffer(const ScratchBuffer &) = delete;
+
+    inline T *data() const { return ptr; }
+    inline T &operator[](size_t i) const { return ptr[i]; }
+
+    ScratchAllocator<T> allocator;
+    const size_t        size;
+    T            *const ptr;
+  };
+
+} // ::umesh
@@ -16,39 +16,97 @@
 
 #include "TetConn.h"
 #include "umesh/io/IO.h"
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/profile.h"
+#include <atomic>
 #include <fstream>
 
 namespace umesh {
 
-  /*! helper class that maintains all temporary helper data structures */
+  /*! one facet of a tet: its vertex indices, sorted (so both facets
+      of a shared face have the same ones), and which tet/facet it
+      came from; the lowest bit of 'code' is the side of the face
+      that this facet is on (ie, the parity of the permutation that
+      sorted its indices), the other bits are 4*tetIdx+facetIdx */
+  struct TetFacet {
+    vec3i    index;
+    uint64_t code;
+  };
+
+  inline uint64_t facetID(const TetFacet &facet) { return facet.code >> 1; }
+  inline int      sideOf (const TetFacet &facet) { return int(facet.code & 1); }
+
+  inline bool sameIndices(const TetFacet &a, const TetFacet &b)
+  {
+    return a.index.x == b.index.x && a.index.y == b.index.y && a.index.z == b.index.z;
+  }
+
+  /*! computes the sorted indices and the side for given facet
+      (oriented to point *towards* the given tet); returns false if
+      the facet is degenerate */
+  inline bool makeFacet(TetFacet &facet, size_t tetIdx, int facetIdx, vec3i indices)
+  {
+    int side = 0;
+    for (int i=0;i<3;i++) 
+      for (int j=0;j<i;j++) 
+        if (indices[i] < indices[j]) {
+          std::swap(indices[i],indices[j]);
+          side = 1-side;
+        }
+    facet.index = indices;
+    facet.code  = ((4*uint64_t(tetIdx)+facetIdx) << 1) | side;
+    return indices.x < indices.y && indices.y < indices.z;
+  }
+
+  /*! number of bits required to store values in [0,range] */
+  inline int bitsFor(uint64_t range)
+  {
+    int bits = 1;
+    while (bits < 64 && (range >> bits)) bits++;
+    return bits;
+  }
+
+  /*! computes tet connectivity in parallel, in a few passes over all
+      facets: generate all facets with sorted vertex indices, (radix)
+      sort them by those indices, so facets of the same face end up
+      next to each other, and let each such group of same-face facets
+      write its face. Since the sort is stable, the first facet of
+      each group is the first one (in tet order) using that face,
+      which allows for numbering the faces in the order they are
+      first used */
   struct TetConnHelper
   {
     /*! constructor will compute the given 'out' struct, from given 'in' mesh */
-    TetConnHelper(TetConn &out, const UMesh &in);
+    TetConnHelper(TetConn &out, const UMesh &in, TetConn::FaceOrder faceOrder);
 
   private:
-    /*! push facet #facetIdx of tet #tetIdx, with given vertex indices
-      (oriented to point *towards* tet the given tet */
-    void pushFacet(int tetIdx, int facetIdx, vec3i indices);
-    /*! push tet #tetIdx from input mesh in, and fill in all respective
-      values in the 'out' field */
-    void pushTet(int tetIdx);
-
-    /*! find (or allocate) face that shars these indices (in any
-      order), and return Idx in 'perFace' vectors, as well as whether
-      given indices refer to the front- or back-side of this found
-      face */
-    int findFace(vec3i indices, int &side);
-    
+    void makeFacets();
+    void sortFacets();
+    /*! marks the first facet of each face, and checks that no face has
+        more than one facet on the same side */
+    void findFaces();
+    /*! computes, for each face, its index in the output */
+    void numberFaces(TetConn::FaceOrder faceOrder);
+    void writeFaces();
+
     const UMesh &in;
     TetConn &out;
-    
-    std::map<vec3i,int> faceIndex;
+
+    std::vector<TetFacet> facets;
+    /*! for each (sorted) facet, whether it's the first of its face */
+    std::vector<uint8_t>  isFirst;
+    /*! for the first facet of each face: the index of this face,
+        indexed by the facet's position in the sorted array
+        (SORTED_BY_VERTICES) or by its facet ID (FIRST_USE) */
+    std::vector<int>      faceIdx;
+    TetConn::FaceOrder    faceOrder;
+    int                   minIndex = 0, maxIndex = 0;
   };
   
   TetConnHelper::TetConnHelper(TetConn &out,
-                               const UMesh &in)
-    : out(out), in(in)
+                               const UMesh &in,
+                               TetConn::FaceOrder faceOrder)
+    : out(out), in(in), faceOrder(faceOrder)
   {
     if (!in.wedges.empty() ||
         !in.pyrs.empty() ||
@@ -63,127 +121,187 @@ namespace umesh {
       throw std::runtime_error("number of input vertices too large - would overflow");
       
     out.faces.clear();
-      
     out.tetFaces.clear();
-      
-    for (size_t i=0;i<in.tets.size();i++)
-      pushTet((int)i);
+    if (in.tets.empty()) return;
+
+    makeFacets();
+    sortFacets();
+    findFaces();
+    numberFaces(faceOrder);
+    writeFaces();
   }
 
-  /*! find (or allocate) face that shars these indices (in any
-    order), and return Idx in 'perFace' vectors, as well as whether
-    given indices refer to the front- or back-side of this found
-    face */
-  int TetConnHelper::findFace(vec3i indices, int &side)
+  void TetConnHelper::makeFacets()
   {
-    side = 0;
-      
-    /* first - compute unique indexing key (by sorting), and
-       orientation of input face relative to that indexing */
-    for (int i=0;i<3;i++) 
-      for (int j=0;j<i;j++) 
-        if (indices[i] < indices[j]) {
-          std::swap(indices[i],indices[j]);
-          side = 1-side;
+    const size_t blockSize = 16*1024;
+    const size_t numBlocks = divRoundUp(in.tets.size(),blockSize);
+    std::vector<vec2i> blockRange(numBlocks);
+    std::atomic<bool> degenerate(false);
+    facets.resize(4*in.tets.size());
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,in.tets.size());
+        vec2i range(in.tets[begin].x,in.tets[begin].x);
+        bool ok = true;
+        for (size_t tetIdx=begin;tetIdx<end;tetIdx++) {
+          const vec4i index = in.tets[tetIdx];
+          TetFacet *facet = facets.data()+4*tetIdx;
+          ok &= makeFacet(facet[0],tetIdx,0,{index[1],index[3],index[2]});
+          ok &= makeFacet(facet[1],tetIdx,1,{index[0],index[2],index[3]});
+          ok &= makeFacet(facet[2],tetIdx,2,{index[0],index[3],index[1]});
+          ok &= makeFacet(facet[3],tetIdx,3,{index[0],index[1],index[2]});
+          for (int i=0;i<4;i++) {
+            range.x = std::min(range.x,index[i]);
+            range.y = std::max(range.y,index[i]);
+          }
         }
-
-    if (indices.x >= indices.y || indices.x >= indices.z
-        || indices.y > indices.z)
+        if (!ok) degenerate = true;
+        blockRange[blockID] = range;
+      });
+    if (degenerate)
       throw std::runtime_error("not sorted indices!?");
-    
-    /* now see if we have this face already */
-    auto it = faceIndex.find(indices);
-    if (it != faceIndex.end()) {
-      if (out.faces[it->second].index != indices)
-        throw std::runtime_error("wrong face index mapping!?");
-      /* ... and if so, return it */
-      return it->second;
+    minIndex = blockRange[0].x;
+    maxIndex = blockRange[0].y;
+    for (auto range : blockRange) {
+      minIndex = std::min(minIndex,range.x);
+      maxIndex = std::max(maxIndex,range.y);
     }
-
-    /* ... and if not, allocate ... */
-    if (out.faces.size() >= (1ull<<31))
-      throw std::runtime_error
-        ("too many faces - can't index with 32-bit (signed) ints");
-
-    int newIdx = int(out.faces.size());
-    /* ... and add */
-    TetConn::Face newFace;
-    newFace.index = { indices };
-    out.faces.push_back(newFace);
-    faceIndex[indices] = newIdx;
-    return newIdx;
   }
 
-  float volume(const std::vector<vec3f> &pos,
-               const vec4i &idx)
+  /*! sorts facets by their (sorted) indices, using as few bits per
+      index as the range of indices in the mesh requires */
+  void TetConnHelper::sortFacets()
   {
-    const vec3f a = pos[idx.x];
-    const vec3f b = pos[idx.y];
-    const vec3f c = pos[idx.z];
-    const vec3f d = pos[idx.w];
-    return dot(d-a,cross(b-a,c-a));
+    const int bits = bitsFor(uint64_t(int64_t(maxIndex)-minIndex));
+    const int64_t base = minIndex;
+    auto index = [base](int idx) { return uint64_t(int64_t(idx)-base); };
+    if (3*bits <= 64) {
+      parallel_radix_sort(facets,[&](const TetFacet &f){
+          return (index(f.index.x) << (2*bits)) | (index(f.index.y) << bits) | index(f.index.z);
+        });
+    } else {
+      parallel_radix_sort(facets,[&](const TetFacet &f){
+          return index(f.index.z);
+        });
+      parallel_radix_sort(facets,[&](const TetFacet &f){
+          return (index(f.index.x) << bits) | index(f.index.y);
+        });
+    }
   }
-  
-  /*! push facet #facetIdx of tet #tetIdx, with given vertex indices
-    (oriented to point *towards* tet the given tet */
-  void TetConnHelper::pushFacet(int tetIdx,
-                                int facetIdx,
-                                vec3i indices)
-  {
-    int side;
-    int faceIdx = findFace(indices,side);
-    TetConn::Face &face = out.faces[faceIdx];
-    if (face.tetIdx[side] != -1) {
-      // PRINT(indices);
-      // PRINT(faceIdx);
-      // PRINT(side);
-      // PRINT(in.tets[face.tetIdx[side]]);
-      // PRINT(volume(in.vertices,in.tets[face.tetIdx[side]]));
-      // PRINT(volume(in.vertices,in.tets[tetIdx]));
-      // PRINT(face.tetIdx[0]);
-      // PRINT(face.tetIdx[1]);
-      // PRINT(in.vertices[in.tets[face.tetIdx[side]].x]);
-      // PRINT(in.vertices[in.tets[face.tetIdx[side]].y]);
-      // PRINT(in.vertices[in.tets[face.tetIdx[side]].z]);
-
-      // PRINT(in.vertices[in.tets[tetIdx].x]);
-      // PRINT(in.vertices[in.tets[tetIdx].y]);
-      // PRINT(in.vertices[in.tets[tetIdx].z]);
 
+  void TetConnHelper::findFaces()
+  {
+    const size_t numFacets = facets.size();
+    isFirst.resize(numFacets);
+    std::atomic<bool> sameSide(false);
+    parallel_for_blocked(0,numFacets,64*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          isFirst[i] = (i == 0) || !sameIndices(facets[i],facets[i-1]);
+          /* a valid face has at most two facets, on different sides;
+             so any facet that has the same indices as the facet two
+             before it, or the same indices _and_ side as the one
+             right before it, is invalid */
+          if (i >= 1 && sameIndices(facets[i],facets[i-1]) &&
+              (sideOf(facets[i]) == sideOf(facets[i-1]) ||
+               (i >= 2 && sameIndices(facets[i],facets[i-2]))))
+            sameSide = true;
+        }
+      });
+    if (sameSide)
       throw std::runtime_error("face with more than one tet on same side!?");
-    }
-    // std::cout <<" writing tet " << tetIdx << " / facet " << facetIdx << " to side " << side << " of face " << faceIdx << std::endl;
-    face.tetIdx[side] = tetIdx;
-    face.facetIdx[side] = facetIdx;
-
-    out.tetFaces[tetIdx][facetIdx] = faceIdx;
   }
-  
-  /*! push tet #tetIdx from input mesh in, and fill in all respective
-    values in the 'out' field */
-  void TetConnHelper::pushTet(int tetIdx)
+
+  /*! exclusive prefix sum over given values, in parallel */
+  template<typename T>
+  size_t exclusivePrefixSum(std::vector<T> &values)
   {
-    // int   sideOfFoundFace = /* will be filled in by 'findFace()1 */-1;
-    vec4i index = in.tets[tetIdx];
+    const size_t blockSize = 64*1024;
+    const size_t numBlocks = divRoundUp(values.size(),blockSize);
+    std::vector<size_t> blockOffset(numBlocks+1,0);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,values.size());
+        size_t sum = 0;
+        for (size_t i=begin;i<end;i++) sum += values[i];
+        blockOffset[blockID+1] = sum;
+      });
+    for (size_t blockID=0;blockID<numBlocks;blockID++)
+      blockOffset[blockID+1] += blockOffset[blockID];
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,values.size());
+        size_t sum = blockOffset[blockID];
+        for (size_t i=begin;i<end;i++) {
+          const size_t value = values[i];
+          values[i] = T(sum);
+          sum += value;
+        }
+      });
+    return blockOffset[numBlocks];
+  }
 
-    out.tetFaces.push_back(vec4i(-1));
+  void TetConnHelper::numberFaces(TetConn::FaceOrder faceOrder)
+  {
+    const size_t numFacets = facets.size();
+    faceIdx.resize(numFacets);
+    if (faceOrder == TetConn::SORTED_BY_VERTICES) {
+      parallel_for_blocked(0,numFacets,64*1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) faceIdx[i] = isFirst[i];
+        });
+    } else {
+      parallel_for_blocked(0,numFacets,64*1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) faceIdx[i] = 0;
+        });
+      parallel_for_blocked(0,numFacets,64*1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            if (isFirst[i]) faceIdx[facetID(facets[i])] = 1;
+        });
+    }
+    const size_t numFaces = exclusivePrefixSum(faceIdx);
+    if (numFaces >= (1ull<<31))
+      throw std::runtime_error
+        ("too many faces - can't index with 32-bit (signed) ints");
+    out.faces.resize(numFaces);
+  }
 
-    pushFacet(tetIdx,0,{index[1],index[3],index[2]});
-    pushFacet(tetIdx,1,{index[0],index[2],index[3]});
-    pushFacet(tetIdx,2,{index[0],index[3],index[1]});
-    pushFacet(tetIdx,3,{index[0],index[1],index[2]});
+  void TetConnHelper::writeFaces()
+  {
+    const size_t numFacets = facets.size();
+    out.tetFaces.resize(in.tets.size());
+    parallel_for_blocked(0,numFacets,64*1024,[&](size_t begin, size_t end){
+        /* each face is written by the block that contains its first
+           facet, so skip the facets of a face that started in the
+           previous block */
+        while (begin < end && !isFirst[begin]) begin++;
+        for (size_t i=begin;i<end;) {
+          const TetFacet &first = facets[i];
+          const int faceID
+            = faceOrder == TetConn::SORTED_BY_VERTICES
+            ? faceIdx[i]
+            : faceIdx[facetID(first)];
+          TetConn::Face &face = out.faces[faceID];
+          face.index = first.index;
+          do {
+            const TetFacet &facet = facets[i];
+            const uint64_t id = facetID(facet);
+            face.tetIdx[sideOf(facet)]   = int(id / 4);
+            face.facetIdx[sideOf(facet)] = uint8_t(id % 4);
+            out.tetFaces[id/4][id%4] = faceID;
+            i++;
+          } while (i < numFacets && !isFirst[i]);
+        }
+      });
   }
-    
 
   /*! compute connectivity from given umesh; the original umesh will
     not be altered, and vertex and tet IDs in connectivity will
     refer to original umesh. Will throw an error for umeshes with
     any volume prims that are not tets */
-  TetConn::SP TetConn::computeFrom(UMesh::SP umesh)
+  TetConn::SP TetConn::computeFrom(UMesh::SP umesh, FaceOrder faceOrder)
   {
     assert(umesh);
     TetConn::SP conn = std::make_shared<TetConn>();
-    conn->computeFrom(*umesh);
+    conn->computeFrom(*umesh,faceOrder);
     return conn;
   }
   
@@ -191,9 +309,10 @@ namespace umesh {
     not be altered, and vertex and tet IDs in connectivity will
     refer to original umesh. Will throw an error for umeshes with
     any volume prims that are not tets */
-  void TetConn::computeFrom(const UMesh &umesh)
+  void TetConn::computeFrom(const UMesh &umesh, FaceOrder faceOrder)
   {
-    TetConnHelper(*this,umesh);
+    profile::ScopedTimer timer("TetConn.compute",0,umesh.tets.size());
+    TetConnHelper(*this,umesh,faceOrder);
   }
   
   /*! write - binary - to given file */
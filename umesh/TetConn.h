@@ -35,17 +35,26 @@ namespace umesh {
     /*! read from given file, assuming file format as used by saveTo() */
     void read(std::istream &in);
 
+    /*! the order in which faces get stored: FIRST_USE numbers faces
+        in the order the tets (and, within a tet, facets) first use
+        them; SORTED_BY_VERTICES orders them by their (sorted) vertex
+        indices, which is slightly cheaper to compute. Both are
+        deterministic, no matter how many threads are used */
+    typedef enum { FIRST_USE, SORTED_BY_VERTICES } FaceOrder;
+    
     /*! compute connectivity from given umesh; the original umesh will
         not be altered, and vertex and tet IDs in connectivity will
         refer to original umesh. Will throw an error for umeshes with
         any volume prims that are not tets */
-    static TetConn::SP computeFrom(UMesh::SP umesh);
+    static TetConn::SP computeFrom(UMesh::SP umesh,
+                                   FaceOrder faceOrder = FIRST_USE);
 
     /*! compute connectivity from given umesh; the original umesh will
         not be altered, and vertex and tet IDs in connectivity will
         refer to original umesh. Will throw an error for umeshes with
         any volume prims that are not tets */
-    void computeFrom(const UMesh &umesh);
+    void computeFrom(const UMesh &umesh,
+                     FaceOrder faceOrder = FIRST_USE);
 
     struct Face {
       /*! vertex indices */
@@ -18,7 +18,20 @@
 #include "UMesh.h"
 #include "io/UMesh.h"
 #include "io/IO.h"
+#include "io/Container.h"
+#include "io/ParallelIO.h"
+#include "io/Compression.h"
+#include "RemeshHelper.h"
+#include "ScalarStats.h"
+#include "CompactBrick.h"
+#include "check.h"
+#include "forEachElement.h"
+#include "profile.h"
 #include <sstream>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <cmath>
 
 
 #ifndef PRINT
@@ -37,6 +50,9 @@
 
 namespace umesh {
   
+  /*! magic of the last pre-container format; files are now written
+      as version-2 containers (see io/Container.h), but this format
+      (as well as older ones) can still be read */
   const size_t bum_magic = 0x234235568ULL;
   
   /*! can be used to turn on/off logging/diagnostic messages in entire
@@ -57,64 +73,231 @@ namespace umesh {
   }
   
 
+  /*! returns the list of per-vertex attributes that get written to
+      file; making sure that 'perVertex' - if set - is the first */
+  std::vector<Attribute::SP> vertexAttributesToWrite(const UMesh *mesh)
+  {
+    std::vector<Attribute::SP> attrs = mesh->attributes;
+    if (mesh->perVertex &&
+        std::find(attrs.begin(),attrs.end(),mesh->perVertex) == attrs.end())
+      attrs.insert(attrs.begin(),mesh->perVertex);
+    else if (mesh->perVertex && attrs[0] != mesh->perVertex) {
+      attrs.erase(std::find(attrs.begin(),attrs.end(),mesh->perVertex));
+      attrs.insert(attrs.begin(),mesh->perVertex);
+    }
+    return attrs;
+  }
+  
+  /*! creates the (version-2 container) list of sections to write for
+      given mesh; the sections point to the mesh's own arrays, except
+      for the attributes' stats, which get encoded into
+      'encodedStats', and - if 'compact' is given - the vertices and
+      element indices, which then are those of 'compact' */
+  std::vector<io::container::OutputSection>
+  createSections(const UMesh *mesh,
+                 std::vector<std::vector<uint8_t>> &encodedStats,
+                 const CompactBrick *compact = nullptr)
+  {
+    using namespace io::container;
+    std::vector<OutputSection> sections;
+    if (compact) {
+      if (compact->numVertices() != mesh->vertices.size())
+        throw std::runtime_error("#umesh.io: compact brick does not match the mesh");
+      for (int axis=0;axis<3;axis++) {
+        sections.push_back(makeSection(QUANTIZED_VERTICES,compact->codes[axis],"",axis));
+        sections.back().desc.valueRange = compact->range[axis];
+      }
+    } else
+      sections.push_back(makeSection(VERTICES,mesh->vertices));
+    for (auto attr : vertexAttributesToWrite(mesh)) {
+      sections.push_back(makeSection(VERTEX_ATTRIBUTE,attr->values,attr->name));
+      sections.back().desc.valueRange = attr->valueRange;
+    }
+    for (auto attr : mesh->elementAttributes) {
+      sections.push_back(makeSection(ELEMENT_ATTRIBUTE,attr.second->values,
+                                     attr.second->name,(uint32_t)attr.first));
+      sections.back().desc.valueRange = attr.second->valueRange;
+    }
+    for (auto attr : mesh->quantizedAttributes) {
+      if (attr->bits == 8)
+        sections.push_back(makeSection(QUANTIZED_ATTRIBUTE,attr->codes8,attr->name,8));
+      else
+        sections.push_back(makeSection(QUANTIZED_ATTRIBUTE,attr->codes16,attr->name,16));
+      sections.back().desc.valueRange = attr->valueRange;
+    }
+    if (compact && compact->hasIndices16) {
+      for (int type=UMesh::TRI;type<=UMesh::HEX;type++)
+        sections.push_back(makeSection(INDICES_16,compact->indices[type],"",type));
+    } else {
+      sections.push_back(makeSection(TRIANGLES,   mesh->triangles));
+      sections.push_back(makeSection(QUADS,       mesh->quads));
+      sections.push_back(makeSection(TETS,        mesh->tets));
+      sections.push_back(makeSection(PYRS,        mesh->pyrs));
+      sections.push_back(makeSection(WEDGES,      mesh->wedges));
+      sections.push_back(makeSection(HEXES,       mesh->hexes));
+    }
+    sections.push_back(makeSection(GRIDS,       mesh->grids));
+    sections.push_back(makeSection(GRID_SCALARS,mesh->gridScalars));
+    sections.push_back(makeSection(VERTEX_TAGS, mesh->vertexTags));
+
+    std::vector<std::pair<uint32_t,Attribute::SP>> withStats;
+    for (auto attr : vertexAttributesToWrite(mesh))
+      if (attr->stats) withStats.push_back({(uint32_t)UMesh::INVALID,attr});
+    for (auto attr : mesh->elementAttributes)
+      if (attr.second->stats) withStats.push_back({(uint32_t)attr.first,attr.second});
+    encodedStats.resize(withStats.size());
+    for (size_t i=0;i<withStats.size();i++) {
+      withStats[i].second->stats->encode(encodedStats[i]);
+      sections.push_back(makeSection(ATTRIBUTE_STATS,encodedStats[i],
+                                     withStats[i].second->name,
+                                     withStats[i].first));
+    }
+    return sections;
+  }
+
   /*! write - binary - to given (bianry) stream */
   void UMesh::writeTo(std::ostream &out) const
   {
-    io::writeElement(out,bum_magic);
-    io::writeVector(out,vertices);
+    io::container::Header header;
+    header.bounds           = bounds;
+    header.gridsScalarRange = gridsScalarRange;
+    std::vector<std::vector<uint8_t>> encodedStats;
+    std::vector<io::container::OutputSection> sections = createSections(this,encodedStats);
+    io::container::layout(header,sections);
+    io::container::write(out,header,sections);
+  }
+  
+  /*! writes given mesh - with the vertices and indices of 'compact',
+      if given - to given file, in parallel */
+  void saveContainer(const UMesh *mesh,
+                     const std::string &fileName,
+                     const CompactBrick *compact,
+                     bool compress)
+  {
+    if (mesh->size() > 0 && mesh->bounds.empty()) {
+      throw std::runtime_error("invalid mesh bounds value when saving umesh - did you forget some finalize() somewhere?");
+    }
 
-    // iw - changed that to write 'numPerVertex' rather than always
-    // write one - this allows for later switching to more than one
-    // attribute
-    std::vector<Attribute::SP> attrs = attributes;
-    if (perVertex && attributes.empty())
-      attrs.push_back(perVertex);
+    io::container::Header header;
+    header.bounds           = mesh->bounds;
+    header.gridsScalarRange = mesh->gridsScalarRange;
+    std::vector<std::vector<uint8_t>> encodedStats;
+    std::vector<io::container::OutputSection> sections
+      = createSections(mesh,encodedStats,compact);
+    std::vector<std::vector<uint8_t>> compressed(sections.size());
+    if (compress) {
+      profile::ScopedTimer timer("io.compress");
+      for (size_t i=0;i<sections.size();i++) {
+        timer.addBytes(sections[i].desc.numBytes);
+        if (io::compression::compressSection(sections[i].desc,sections[i].data,
+                                             compressed[i]))
+          sections[i].data = compressed[i].data();
+      }
+    }
+    io::container::layout(header,sections);
 
+    // header and TOC go first, in one block ...
+    std::vector<uint8_t> headerAndTOC(sizeof(header)
+                                      +sections.size()*sizeof(io::container::Section));
+    memcpy(headerAndTOC.data(),&header,sizeof(header));
+    for (size_t i=0;i<sections.size();i++)
+      memcpy(headerAndTOC.data()+sizeof(header)+i*sizeof(io::container::Section),
+             &sections[i].desc,sizeof(io::container::Section));
+    std::vector<io::IORequest> requests;
+    requests.push_back({0,headerAndTOC.data(),headerAndTOC.size()});
     
-    size_t numPerVertexAttributes = attrs.size();
-    io::writeElement(out,numPerVertexAttributes);
-    for (int i=0;i<numPerVertexAttributes;i++) {
-      io::writeString(out,attrs[i]->name);
-      io::writeVector(out,attrs[i]->values);
-    } 
-    size_t numPerElementAttributes = 0;
-    io::writeElement(out,numPerElementAttributes);
-    
-    io::writeVector(out,triangles);
-    io::writeVector(out,quads);
-    io::writeVector(out,tets);
-    io::writeVector(out,pyrs);
-    io::writeVector(out,wedges);
-    io::writeVector(out,hexes);
-    io::writeVector(out,grids);
-    io::writeVector(out,gridScalars);
-    io::writeVector(out,vertexTags);
+    // ... then all sections' data; the padding between sections is
+    // left as holes in the file, which read back as zeroes
+    uint64_t dataEnd = headerAndTOC.size();
+    uint64_t fileEnd = headerAndTOC.size();
+    for (auto &section : sections) {
+      requests.push_back({section.desc.offset,
+                          (void *)section.data,
+                          section.desc.numBytes});
+      fileEnd = std::max(fileEnd,section.desc.offset+section.desc.numBytes);
+      if (section.desc.numBytes)
+        dataEnd = std::max(dataEnd,section.desc.offset+section.desc.numBytes);
+    }
+    // trailing empty sections still have to lie within the file
+    std::vector<uint8_t> tailPadding(fileEnd-dataEnd,0);
+    requests.push_back({dataEnd,tailPadding.data(),tailPadding.size()});
+
+    profile::ScopedTimer timer("io.save",fileEnd,sections.size());
+    io::PositionalFile::SP file = io::PositionalFile::openForWriting(fileName);
+    io::parallelWrite(*file,requests);
   }
-  
+
   /*! write - binary - to given file */
-  void UMesh::saveTo(const std::string &fileName) const
+  void UMesh::saveTo(const std::string &fileName, bool compress) const
   {
-    if (size() > 0 && bounds.empty()) {
-      throw std::runtime_error("invalid mesh bounds value when saving umesh - did you forget some finalize() somewhere?");
-    }
+    saveContainer(this,fileName,nullptr,compress);
+  }
+  
+  void UMesh::saveTo(const std::string &fileName,
+                     const CompactBrick &compact,
+                     bool compress) const
+  {
+    saveContainer(this,fileName,&compact,compress);
+  }
 
-    std::ofstream out(fileName, std::ios_base::binary);
-    writeTo(out);
+  /*! reads given vector if 'wanted' is true, else skips over it in
+      the stream, without reading its data */
+  template<typename T>
+  void readOrSkipVector(std::istream &in,
+                        std::vector<T> &vec,
+                        bool wanted,
+                        const std::string &description="<no description>")
+  {
+    if (wanted) {
+      io::readVector(in,vec,description);
+      return;
+    }
+    size_t N;
+    io::readElement(in,N);
+    in.seekg(N*sizeof(T),std::ios::cur);
   }
 
+  /*! reads (or skips) the element arrays and vertex tags shared by
+      all pre-container file formats */
+  void readElementVectors(UMesh *mesh, std::istream &in,
+                          const LoadSelection &selection,
+                          bool hasGrids)
+  {
+    readOrSkipVector(in,mesh->triangles,selection.wants(LoadSelection::TRIANGLES),"triangles");
+    readOrSkipVector(in,mesh->quads,selection.wants(LoadSelection::QUADS),"quads");
+    readOrSkipVector(in,mesh->tets,selection.wants(LoadSelection::TETS),"tets");
+    readOrSkipVector(in,mesh->pyrs,selection.wants(LoadSelection::PYRS),"pyramids");
+    readOrSkipVector(in,mesh->wedges,selection.wants(LoadSelection::WEDGES),"wedges");
+    readOrSkipVector(in,mesh->hexes,selection.wants(LoadSelection::HEXES),"hexes");
+    if (hasGrids) {
+      readOrSkipVector(in,mesh->grids,selection.wants(LoadSelection::GRIDS),"grids");
+      readOrSkipVector(in,mesh->gridScalars,selection.wants(LoadSelection::GRIDS),"gridScalars");
+    }
+    // try {
+    if (!in.eof() && selection.wants(LoadSelection::VERTEX_TAGS))
+      try {
+        io::readVector(in,mesh->vertexTags,"vertexTags");
+      } catch (...) {
+        /* ignore ... */
+      }
+  }
+  
   /*! reads format encoded by version tag '0x234235566ULL' - magic has
       already been read */
-  void read_566(UMesh *mesh, std::istream &in)
+  void read_566(UMesh *mesh, std::istream &in, const LoadSelection &selection)
   {
-    io::readVector(in,mesh->vertices,"vertices");
+    readOrSkipVector(in,mesh->vertices,selection.wants(LoadSelection::VERTICES),"vertices");
     size_t numPerVertexAttributes = 1;
     if (numPerVertexAttributes) {
       Attribute::SP attr = std::make_shared<Attribute>();
       // io::readString(in,attr->name);
       // PRINT(attr->name);
-      io::readVector(in,attr->values,"scalars");
-      attr->finalize();
-      mesh->attributes.push_back(attr);
+      if (selection.wantsAttribute(attr->name)) {
+        io::readVector(in,attr->values,"scalars");
+        attr->finalize();
+        mesh->attributes.push_back(attr);
+      } else
+        readOrSkipVector(in,attr->values,false);
     }
     if (!mesh->attributes.empty())
       mesh->perVertex = mesh->attributes[0];
@@ -123,31 +306,405 @@ namespace umesh {
     // io::readElement(in,numPerElementAttributes);
     assert(numPerElementAttributes == 0);
     
-    io::readVector(in,mesh->triangles,"triangles");
-    io::readVector(in,mesh->quads,"quads");
-    io::readVector(in,mesh->tets,"tets");
-    io::readVector(in,mesh->pyrs,"pyramids");
-    io::readVector(in,mesh->wedges,"wedges");
-    io::readVector(in,mesh->hexes,"hexes");
-    // try {
-    if (!in.eof())
-      try {
-        io::readVector(in,mesh->vertexTags,"vertexTags");
-      } catch (...) {
-        /* ignore ... */
+    readElementVectors(mesh,in,selection,false);
+    if (selection.selectsAll() || selection.wants(LoadSelection::VERTICES)) {
+      mesh->markDirty();
+      mesh->finalize();
+    }
+  }
+  
+  /*! find attribute of given name in list, or create a new one */
+  Attribute::SP findOrCreate(std::vector<Attribute::SP> &attributes,
+                             const std::string &name)
+  {
+    for (auto attr : attributes)
+      if (attr->name == name) return attr;
+    Attribute::SP attr = std::make_shared<Attribute>();
+    attr->name = name;
+    attributes.push_back(attr);
+    return attr;
+  }
+
+  /*! find per-element attribute of given name and prim type, or
+      create a new one */
+  Attribute::SP findOrCreate(std::vector<std::pair<UMesh::PrimType,Attribute::SP>> &attributes,
+                             UMesh::PrimType primType,
+                             const std::string &name)
+  {
+    for (auto it : attributes)
+      if (it.first == primType && it.second->name == name) return it.second;
+    Attribute::SP attr = std::make_shared<Attribute>();
+    attr->name = name;
+    attributes.push_back({primType,attr});
+    return attr;
+  }
+
+  /*! find quantized attribute of given name, or create a new one; a
+      new one gets the quantization of given section, an existing one
+      has to already have it */
+  QuantizedAttribute::SP findOrCreate(std::vector<QuantizedAttribute::SP> &attributes,
+                                      const io::container::Section &section)
+  {
+    if (section.flags != 8 && section.flags != 16)
+      throw std::runtime_error("#umesh.io: invalid number of bits for quantized attribute '"
+                               +section.getName()+"'");
+    for (auto attr : attributes)
+      if (attr->name == section.getName()) {
+        if (attr->bits != (int)section.flags ||
+            attr->valueRange.lower != section.valueRange.lower ||
+            attr->valueRange.upper != section.valueRange.upper)
+          throw std::runtime_error("#umesh.io: sections of quantized attribute '"
+                                   +attr->name+"' have different quantizations");
+        return attr;
+      }
+    QuantizedAttribute::SP attr = std::make_shared<QuantizedAttribute>();
+    attr->name = section.getName();
+    attr->setQuantization(section.flags,section.valueRange);
+    attributes.push_back(attr);
+    return attr;
+  }
+  
+  /*! calls given lambda with the mesh array that the data of given
+      container section belongs to - or, for compact vertices and
+      indices, the array of 'compact' that it belongs to; sections of
+      unknown type get skipped */
+  template<typename Lambda>
+  void withSectionArray(UMesh *mesh,
+                        CompactBrick &compact,
+                        const io::container::Section &section,
+                        const Lambda &lambda)
+  {
+    using namespace io::container;
+    switch (section.type) {
+    case VERTICES:
+      lambda(mesh->vertices); break;
+    case VERTEX_ATTRIBUTE:
+      lambda(findOrCreate(mesh->attributes,section.getName())->values); break;
+    case ELEMENT_ATTRIBUTE:
+      lambda(findOrCreate(mesh->elementAttributes,(UMesh::PrimType)section.flags,
+                          section.getName())->values);
+      break;
+    case TRIANGLES:
+      lambda(mesh->triangles); break;
+    case QUADS:
+      lambda(mesh->quads); break;
+    case TETS:
+      lambda(mesh->tets); break;
+    case PYRS:
+      lambda(mesh->pyrs); break;
+    case WEDGES:
+      lambda(mesh->wedges); break;
+    case HEXES:
+      lambda(mesh->hexes); break;
+    case GRIDS:
+      lambda(mesh->grids); break;
+    case GRID_SCALARS:
+      lambda(mesh->gridScalars); break;
+    case VERTEX_TAGS:
+      lambda(mesh->vertexTags); break;
+    case QUANTIZED_ATTRIBUTE: {
+      QuantizedAttribute::SP attr = findOrCreate(mesh->quantizedAttributes,section);
+      if (attr->bits == 8) lambda(attr->codes8);
+      else                 lambda(attr->codes16);
+    } break;
+    case QUANTIZED_VERTICES:
+      if (section.flags > 2)
+        throw std::runtime_error("#umesh.io: invalid axis for quantized vertices");
+      lambda(compact.codes[section.flags]); break;
+    case INDICES_16:
+      if (section.flags > UMesh::HEX)
+        throw std::runtime_error("#umesh.io: invalid prim type for 16-bit indices");
+      lambda(compact.indices[section.flags]); break;
+    default:
+      /* unknown section type - skip */
+      break;
+    }
+  }
+
+  /*! a container section, and where in the mesh its data has to go */
+  struct SectionTarget {
+    const io::container::Section *section;
+    void                         *dst;
+    /*! size of the data in the mesh; for compressed sections that
+        is not what's stored in the file */
+    size_t                        numBytes;
+  };
+  
+  /*! resizes all of the mesh's arrays (and those of 'compact') to
+      hold the data of all given sections (split sections get
+      concatenated in TOC order), and returns, for each section, where
+      its data has to go. Having all destinations known up front
+      allows for reading all sections in parallel */
+  std::vector<SectionTarget>
+  allocateSections(UMesh *mesh,
+                   CompactBrick &compact,
+                   const std::vector<io::container::Section> &sections)
+  {
+    std::map<void *,size_t> arraySize;
+    bool quantized[3] = { false, false, false };
+    for (auto &section : sections) {
+      if (section.type == io::container::QUANTIZED_VERTICES && section.flags <= 2) {
+        const int axis = section.flags;
+        if (quantized[axis] &&
+            (compact.range[axis].lower != section.valueRange.lower ||
+             compact.range[axis].upper != section.valueRange.upper))
+          throw std::runtime_error("#umesh.io: sections of quantized vertices "
+                                   "have different quantizations");
+        compact.setQuantization(axis,section.valueRange);
+        quantized[axis] = true;
+      }
+      if (section.type == io::container::INDICES_16)
+        compact.hasIndices16 = true;
+    }
+    for (auto &section : sections)
+      withSectionArray(mesh,compact,section,[&](auto &vec){
+        typedef typename std::decay<decltype(vec)>::type::value_type T;
+        if (!section.compression && section.numBytes != section.count*sizeof(T))
+          throw std::runtime_error("#umesh.io: section '"
+                                   +io::container::toString(section.type)
+                                   +"' has wrong element size");
+        arraySize[&vec] += section.count;
+      });
+    
+    std::map<void *,size_t> arrayFill;
+    std::vector<SectionTarget> targets;
+    for (auto &section : sections)
+      withSectionArray(mesh,compact,section,[&](auto &vec){
+        if (arrayFill.find(&vec) == arrayFill.end()) {
+          vec.resize(arraySize[&vec]);
+          arrayFill[&vec] = 0;
+        }
+        typedef typename std::decay<decltype(vec)>::type::value_type T;
+        targets.push_back({&section,vec.data()+arrayFill[&vec],
+                           section.count*sizeof(T)});
+        arrayFill[&vec] += section.count;
+      });
+    return targets;
+  }
+
+  /*! returns whether given container section is part of the
+      selection */
+  bool isSelected(const io::container::Section &section,
+                  const LoadSelection &selection)
+  {
+    using namespace io::container;
+    switch (section.type) {
+    case VERTICES:          return selection.wants(LoadSelection::VERTICES);
+    case VERTEX_ATTRIBUTE:  return selection.wantsAttribute(section.getName());
+    case ELEMENT_ATTRIBUTE: return selection.wants(LoadSelection::ELEMENT_ATTRIBUTES);
+    case TRIANGLES:         return selection.wants(LoadSelection::TRIANGLES);
+    case QUADS:             return selection.wants(LoadSelection::QUADS);
+    case TETS:              return selection.wants(LoadSelection::TETS);
+    case PYRS:              return selection.wants(LoadSelection::PYRS);
+    case WEDGES:            return selection.wants(LoadSelection::WEDGES);
+    case HEXES:             return selection.wants(LoadSelection::HEXES);
+    case GRIDS:
+    case GRID_SCALARS:      return selection.wants(LoadSelection::GRIDS);
+    case VERTEX_TAGS:       return selection.wants(LoadSelection::VERTEX_TAGS);
+    case QUANTIZED_ATTRIBUTE: return selection.wantsAttribute(section.getName());
+    case QUANTIZED_VERTICES: return selection.wants(LoadSelection::VERTICES);
+    case INDICES_16: {
+      static const uint32_t parts[] = {
+        LoadSelection::TRIANGLES, LoadSelection::QUADS, LoadSelection::TETS,
+        LoadSelection::PYRS, LoadSelection::WEDGES, LoadSelection::HEXES
+      };
+      return section.flags <= UMesh::HEX && selection.wants(parts[section.flags]);
+    }
+    default:                return false;
+    }
+  }
+
+  /*! returns those of the given sections that are part of the
+      selection */
+  std::vector<io::container::Section>
+  selectSections(const std::vector<io::container::Section> &sections,
+                 const LoadSelection &selection)
+  {
+    std::vector<io::container::Section> selected;
+    for (auto &section : sections)
+      if (isSelected(section,selection))
+        selected.push_back(section);
+    return selected;
+  }
+  
+  /*! final step of reading a container, once all sections' data
+      have been read. if only parts of the mesh got loaded we cannot
+      (always) recompute bounds and value ranges, so take the ones
+      stored in the header */
+  void finishReading(UMesh *mesh,
+                     const io::container::Header &header,
+                     const LoadSelection &selection)
+  {
+    for (auto attr : mesh->attributes)
+      attr->finalize();
+    for (auto attr : mesh->elementAttributes)
+      attr.second->finalize();
+    if (!mesh->attributes.empty())
+      mesh->perVertex = mesh->attributes[0];
+    if (selection.selectsAll())
+      mesh->finalize();
+    else {
+      mesh->bounds           = header.bounds;
+      mesh->gridsScalarRange = header.gridsScalarRange;
+    }
+  }
+  
+  /*! once all (selected) sections' data have been read: decodes the
+      compact vertices and indices of those sections, if any, into
+      the mesh */
+  void decodeCompact(UMesh *mesh,
+                     const CompactBrick &compact,
+                     const std::vector<io::container::Section> &sections)
+  {
+    for (auto &section : sections)
+      if (section.type == io::container::QUANTIZED_VERTICES) {
+        compact.decodeVertices(mesh->vertices);
+        break;
+      }
+    compact.decodeElements(*mesh);
+  }
+  
+  /*! attaches the stats in given ATTRIBUTE_STATS sections to the
+      mesh's attributes they belong to - if those got loaded - with
+      'read(section,dst)' reading a section's data */
+  template<typename ReadSection>
+  void readAttributeStats(UMesh *mesh,
+                          const std::vector<io::container::Section> &sections,
+                          const ReadSection &read)
+  {
+    for (auto &section : sections) {
+      if (section.type != io::container::ATTRIBUTE_STATS || section.compression)
+        continue;
+      Attribute::SP attr;
+      if (section.flags == UMesh::INVALID) {
+        for (auto existing : mesh->attributes)
+          if (existing->name == section.getName()) attr = existing;
+      } else {
+        for (auto &existing : mesh->elementAttributes)
+          if (existing.first == (UMesh::PrimType)section.flags &&
+              existing.second->name == section.getName())
+            attr = existing.second;
+      }
+      if (!attr) continue;
+      std::vector<uint8_t> bytes(section.numBytes);
+      read(section,bytes.data());
+      attr->stats = ScalarStats::decode(bytes.data(),bytes.size());
+    }
+  }
+  
+  /*! reads a version-2 container - magic has already been read */
+  void read_v2(UMesh *mesh, std::istream &in, size_t magic,
+               const LoadSelection &selection)
+  {
+    using namespace io::container;
+    Header header;
+    std::vector<Section> allSections;
+    SectionReader reader(in,readTOC(in,magic,header,allSections));
+
+    const std::vector<Section> sections = selectSections(allSections,selection);
+    CompactBrick compact;
+    for (auto &target : allocateSections(mesh,compact,sections)) {
+      if (!target.section->compression) {
+        reader.read(*target.section,target.dst);
+        continue;
+      }
+      std::vector<uint8_t> compressed(target.section->numBytes);
+      reader.read(*target.section,compressed.data());
+      io::compression::decompress(compressed.data(),compressed.size(),
+                                  target.dst,target.numBytes);
+    }
+    decodeCompact(mesh,compact,sections);
+    readAttributeStats(mesh,allSections,[&](const Section &section, void *dst){
+        reader.read(section,dst);
+      });
+    finishReading(mesh,header,selection);
+  }
+  
+  /*! reads a version-2 container from given file, using multiple
+      threads that each read different chunks of the sections'
+      data */
+  void read_v2(UMesh *mesh, io::PositionalFile &file,
+               const LoadSelection &selection)
+  {
+    using namespace io::container;
+    Header header;
+    file.read(0,&header,sizeof(header));
+    if (!isContainer(header.magic))
+      throw std::runtime_error("#umesh.io: not a umesh container (wrong magic)");
+    if (header.version != io::container::version)
+      throw std::runtime_error("#umesh.io: unsupported container version "
+                               +std::to_string(header.version));
+    std::vector<Section> sections(header.numSections);
+    file.read(header.tocOffset,sections.data(),sections.size()*sizeof(Section));
+    if (checksum(sections.data(),sections.size()*sizeof(Section))
+        != header.tocChecksum)
+      throw std::runtime_error("#umesh.io: checksum mismatch in container TOC");
+
+    const std::vector<Section> allSections = sections;
+    sections = selectSections(sections,selection);
+    CompactBrick compact;
+    const std::vector<SectionTarget> targets = allocateSections(mesh,compact,sections);
+    /*! compressed sections get read into these first, then
+        decompressed into the mesh */
+    std::vector<std::vector<uint8_t>> compressed(targets.size());
+    std::vector<void *> stored(targets.size());
+    std::vector<io::IORequest> requests;
+    uint64_t numBytes = 0;
+    uint64_t numCompressedBytes = 0;
+    for (size_t i=0;i<targets.size();i++) {
+      const Section &section = *targets[i].section;
+      stored[i] = targets[i].dst;
+      if (section.compression) {
+        compressed[i].resize(section.numBytes);
+        stored[i] = compressed[i].data();
+        numCompressedBytes += section.numBytes;
+      }
+      requests.push_back({section.offset,stored[i],section.numBytes});
+      numBytes += section.numBytes;
+    }
+    {
+      profile::ScopedTimer timer("io.readSections",numBytes,targets.size());
+      io::parallelRead(file,requests);
+    }
+    {
+      profile::ScopedTimer timer("io.verifyChecksums",numBytes,targets.size());
+      for (size_t i=0;i<targets.size();i++)
+        if (checksum(stored[i],targets[i].section->numBytes) != targets[i].section->checksum)
+          throw std::runtime_error("#umesh.io: checksum mismatch in section '"
+                                   +toString(targets[i].section->type)+"'");
+    }
+    if (numCompressedBytes) {
+      profile::ScopedTimer timer("io.decompress",numCompressedBytes);
+      for (size_t i=0;i<targets.size();i++) {
+        if (!targets[i].section->compression) continue;
+        io::compression::decompress(compressed[i].data(),compressed[i].size(),
+                                    targets[i].dst,targets[i].numBytes);
+        compressed[i].clear();
+        compressed[i].shrink_to_fit();
       }
-    mesh->finalize();
+    }
+    decodeCompact(mesh,compact,sections);
+    readAttributeStats(mesh,allSections,[&](const Section &section, void *dst){
+        file.read(section.offset,dst,section.numBytes);
+        if (checksum(dst,section.numBytes) != section.checksum)
+          throw std::runtime_error("#umesh.io: checksum mismatch in section '"
+                                   +toString(section.type)+"'");
+      });
+    finishReading(mesh,header,selection);
   }
   
   /*! read from given (binary) stream */
-  void UMesh::readFrom(std::istream &in)
+  void UMesh::readFrom(std::istream &in, const LoadSelection &selection)
   {
     const size_t bum_magic_old = 0x234235567ULL;
     bool hasGrids = true;
     size_t magic;
     io::readElement(in,magic);
     if (magic == 0x234235566ULL) {
-      read_566(this,in); return;
+      read_566(this,in,selection); return;
+    }
+    if (io::container::isContainer(magic)) {
+      read_v2(this,in,magic,selection); return;
     }
     
     if (magic != bum_magic)
@@ -156,15 +713,18 @@ namespace umesh {
           throw std::runtime_error("wrong magic number in umesh file ...");
         hasGrids = false;
       }
-    io::readVector(in,this->vertices,"vertices");
+    readOrSkipVector(in,this->vertices,selection.wants(LoadSelection::VERTICES),"vertices");
     size_t numPerVertexAttributes = 1;
     io::readElement(in,numPerVertexAttributes);
     if (numPerVertexAttributes) {
       Attribute::SP attr = std::make_shared<Attribute>();
       io::readString(in,attr->name);
-      io::readVector(in,attr->values,"scalars");
-      attr->finalize();
-      attributes.push_back(attr);
+      if (selection.wantsAttribute(attr->name)) {
+        io::readVector(in,attr->values,"scalars");
+        attr->finalize();
+        attributes.push_back(attr);
+      } else
+        readOrSkipVector(in,attr->values,false);
     }
     if (!attributes.empty())
       perVertex = attributes[0];
@@ -173,54 +733,130 @@ namespace umesh {
     io::readElement(in,numPerElementAttributes);
     assert(numPerElementAttributes == 0);
     
-    io::readVector(in,this->triangles,"triangles");
-    io::readVector(in,this->quads,"quads");
-    io::readVector(in,this->tets,"tets");
-    io::readVector(in,this->pyrs,"pyramids");
-    io::readVector(in,this->wedges,"wedges");
-    io::readVector(in,this->hexes,"hexes");
-    if (hasGrids) {
-      io::readVector(in,this->grids,"grids");
-      io::readVector(in,this->gridScalars,"gridScalars");
-    }
-    // try {
-    if (!in.eof())
-      try {
-        io::readVector(in,this->vertexTags,"vertexTags");
-      } catch (...) {
-        /* ignore ... */
-      }
+    readElementVectors(this,in,selection,hasGrids);
   
-    this->finalize();
+    // (this may have replaced arrays of an already finalized mesh)
+    if (selection.selectsAll() || selection.wants(LoadSelection::VERTICES)) {
+      this->markDirty();
+      this->finalize();
+    }
   }
 
   /*! read from given file, assuming file format as used by saveTo() */
-  UMesh::SP UMesh::loadFrom(const std::string &fileName)
+  UMesh::SP UMesh::loadFrom(const std::string &fileName,
+                            const LoadSelection &selection)
   {
     UMesh::SP mesh = std::make_shared<UMesh>();
+    profile::ScopedTimer timer("io.load");
+    {
+      io::PositionalFile::SP file = io::PositionalFile::openForReading(fileName);
+      timer.addBytes(file->size());
+      uint64_t magic = 0;
+      if (file->size() >= sizeof(io::container::Header))
+        file->read(0,&magic,sizeof(magic));
+      if (io::container::isContainer(magic)) {
+        read_v2(mesh.get(),*file,selection);
+        return mesh;
+      }
+    }
+    
+    // older file formats, which have to be read sequentially
     std::ifstream in(fileName, std::ios_base::binary);
     if (!in.good())
       throw std::runtime_error("#umesh: could not open '"+fileName+"'");
-    mesh->readFrom(in);
-    mesh->finalize();
+    mesh->readFrom(in,selection);
+    if (selection.selectsAll())
+      mesh->finalize();
     return mesh;
   }
   
 
   /*! tells this attribute that its values are set, and precomputations can be done */
+  /*! lowers 'target' to 'value' if that is smaller; NaNs never get
+      written, just like in range1f/box3f::extend() */
+  inline void atomicMin(std::atomic<float> &target, float value)
+  {
+    float current = target.load(std::memory_order_relaxed);
+    while (value < current &&
+           !target.compare_exchange_weak(current,value,std::memory_order_relaxed))
+      ;
+  }
+
+  /*! raises 'target' to 'value' if that is larger */
+  inline void atomicMax(std::atomic<float> &target, float value)
+  {
+    float current = target.load(std::memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current,value,std::memory_order_relaxed))
+      ;
+  }
+
+  /*! a range1f that multiple threads can extend concurrently, without
+      locking */
+  struct AtomicRange1f {
+    AtomicRange1f(const range1f &init = range1f())
+      : lower(init.lower), upper(init.upper)
+    {}
+    inline void extend(const range1f &other)
+    { atomicMin(lower,other.lower); atomicMax(upper,other.upper); }
+    inline range1f get() const
+    {
+      range1f result;
+      result.lower = lower.load();
+      result.upper = upper.load();
+      return result;
+    }
+    std::atomic<float> lower, upper;
+  };
+
+  /*! a box3f that multiple threads can extend concurrently, without
+      locking */
+  struct AtomicBox3f {
+    inline void extend(const box3f &other)
+    {
+      for (int dim=0;dim<3;dim++) {
+        range1f r;
+        r.lower = other.lower[dim];
+        r.upper = other.upper[dim];
+        range[dim].extend(r);
+      }
+    }
+    inline box3f get() const
+    {
+      box3f result;
+      for (int dim=0;dim<3;dim++) {
+        const range1f r = range[dim].get();
+        result.lower[dim] = r.lower;
+        result.upper[dim] = r.upper;
+      }
+      return result;
+    }
+    AtomicRange1f range[3];
+  };
+
+  /*! block size for the parallel reductions in the finalize()'s; each
+      block reduces locally, and only merges its result into the
+      shared one at the end */
+  const size_t finalizeBlockSize = 16*1024;
+  
   void Attribute::finalize()
   {
-    std::mutex mutex;
+    valueRange = range1f();
+    finalize(0);
+  }
+
+  void Attribute::finalize(size_t begin)
+  {
+    AtomicRange1f range(valueRange);
     parallel_for_blocked
-      (0,values.size(),16*1024,
+      (begin,values.size(),finalizeBlockSize,
        [&](size_t begin, size_t end) {
-         range1f rangeValueRange;
+         range1f blockRange;
          for (size_t i=begin;i<end;i++)
-           rangeValueRange.extend(values[i]);
-         std::lock_guard<std::mutex> lock(mutex);
-         valueRange.extend(rangeValueRange.lower);
-         valueRange.extend(rangeValueRange.upper);
+           blockRange.extend(values[i]);
+         range.extend(blockRange);
        });
+    valueRange = range.get();
   }
 
 
@@ -301,35 +937,91 @@ namespace umesh {
   }
 
 
-  /*! finalize a mesh, and compute min/max ranges where required */
+  /*! finalize a mesh, and compute min/max ranges where required. This
+      reduces directly over each element type's array (in parallel
+      over blocks of all elements, see parallelForEachElementRange(),
+      then over blocks of grids), so does not need any temporary
+      (per-prim) memory. Only elements
+      (and scalars) past those seen by the last finalize() get looked
+      at, unless something got marked dirty, or arrays shrank */
   void UMesh::finalize()
   {
-    if (perVertex) perVertex->finalize();
-    bounds = box3f();
-
-    std::vector<UMesh::PrimRef> allPrims = createAllPrimRefs();
+    const size_t numPrims[GRID+1] = {
+      triangles.size(), quads.size(), tets.size(), pyrs.size(),
+      wedges.size(), hexes.size(), grids.size()
+    };
+    bool shrunk = false;
+    for (int type=0;type<=GRID;type++)
+      shrunk |= finalized.valid && numPrims[type] < finalized.numPrims[type];
+    shrunk |= finalized.valid && gridScalars.size() < finalized.numGridScalars;
     
-    std::mutex mutex;
-    parallel_for_blocked
-      (0,allPrims.size(),16*1024,
-       [&](size_t begin, size_t end) {
-         box3f rangeBounds;
-         for (size_t i=begin;i<end;i++)
-           rangeBounds.extend(getBounds(allPrims[i]));
-         std::lock_guard<std::mutex> lock(mutex);
-         bounds.extend(rangeBounds);
-       });
+    const bool allPrims
+      =  !finalized.valid || shrunk
+      || (dirty & (VERTICES_CHANGED|ELEMENTS_CHANGED));
+    const bool allGrids = allPrims || (dirty & SCALARS_CHANGED);
+    size_t begin[GRID+1];
+    size_t numFinalized = 0;
+    for (int type=0;type<=GRID;type++) {
+      begin[type] = allPrims ? 0 : finalized.numPrims[type];
+      numFinalized += numPrims[type]-begin[type];
+    }
+    if (allGrids) {
+      numFinalized += begin[GRID];
+      begin[GRID]   = 0;
+    }
+    profile::ScopedTimer timer("UMesh.finalize",0,numFinalized);
+    
+    if (perVertex) {
+      if (!finalized.valid
+          || perVertex != finalized.perVertex.lock()
+          || perVertex->values.size() < finalized.numScalars
+          || (dirty & SCALARS_CHANGED))
+        perVertex->finalize();
+      else
+        perVertex->finalize(finalized.numScalars);
+    }
 
-    gridsScalarRange = range1f();
+    AtomicBox3f   primBounds;
+    AtomicRange1f gridsRange;
+    if (!allPrims)
+      primBounds.extend(bounds);
+    if (!allGrids)
+      gridsRange.extend(gridsScalarRange);
+    parallelForEachElementRange
+      (*this,[&](const auto &prims, const ElementRange &range) {
+          // skip elements that were already finalized
+          const size_t first = std::max(range.begin,begin[range.type]);
+          if (first >= range.end) return;
+          box3f blockBounds;
+          for (size_t i=first;i<range.end;i++) {
+            const auto &prim = prims[i];
+            for (int j=0;j<numVerticesOf(prim);j++)
+              blockBounds.extend(vertices[prim[j]]);
+          }
+          primBounds.extend(blockBounds);
+        },ALL_ELEMENTS,finalizeBlockSize);
     parallel_for_blocked
-      (0,grids.size(),16*1024,
+      (begin[GRID],grids.size(),finalizeBlockSize,
        [&](size_t begin, size_t end) {
-         range1f rangeBounds;
-         for (size_t i=begin;i<end;i++)
-           rangeBounds.extend(getGridValueRange(i));
-         std::lock_guard<std::mutex> lock(mutex);
-         gridsScalarRange.extend(rangeBounds);
+         box3f   blockBounds;
+         range1f blockRange;
+         for (size_t i=begin;i<end;i++) {
+           blockBounds.extend(getGridBounds(i));
+           blockRange.extend(getGridValueRange(i));
+         }
+         primBounds.extend(blockBounds);
+         gridsRange.extend(blockRange);
        });
+    bounds           = primBounds.get();
+    gridsScalarRange = gridsRange.get();
+
+    finalized.valid = true;
+    for (int type=0;type<=GRID;type++)
+      finalized.numPrims[type] = numPrims[type];
+    finalized.numGridScalars = gridScalars.size();
+    finalized.perVertex      = perVertex;
+    finalized.numScalars     = perVertex ? perVertex->values.size() : 0;
+    dirty = 0;
   }
   
   /*! create std::vector of ALL primitmive references, includign
@@ -342,184 +1034,441 @@ namespace umesh {
     return allPRs;
   }
 
-  /*! merge mulitple meshes into one. will _not_ try to find shared
-    vertices, will just append all other elements and change their
-    indices to correctly point to the appended other vertices */
-  UMesh::SP mergeMeshes(const std::vector<UMesh::SP> &inputs)
-  {
-    size_t numVtx=0,
-      numTet=0,
-      numWdg=0,
-      numPyr=0,
-      numHex=0,
-      numTri=0,
-      numQud=0,
-      numGsc=0,
-      numGrd=0;
-    std::vector<int> vtxOffsets;
-    std::vector<int> tetOffsets;
-    std::vector<int> triOffsets;
-    std::vector<int> qudOffsets;
-    std::vector<int> wdgOffsets;
-    std::vector<int> pyrOffsets;
-    std::vector<int> hexOffsets;
-    std::vector<int> grdOffsets;
-    std::vector<int> gscOffsets;
+  /*! block size for the parallel copies in mergeMeshes() */
+  const size_t mergeBlockSize = 64*1024;
+
+  /*! number of prims of given type in given mesh */
+  size_t numPrimsOfType(const UMesh &mesh, UMesh::PrimType type)
+  {
+    switch (type) {
+    case UMesh::TRI:   return mesh.triangles.size();
+    case UMesh::QUAD:  return mesh.quads.size();
+    case UMesh::TET:   return mesh.tets.size();
+    case UMesh::PYR:   return mesh.pyrs.size();
+    case UMesh::WEDGE: return mesh.wedges.size();
+    case UMesh::HEX:   return mesh.hexes.size();
+    case UMesh::GRID:  return mesh.grids.size();
+    default: return 0;
+    }
+  }
+
+  /*! copies all of 'in' to 'out', starting at 'offset' */
+  template<typename T>
+  void copyInto(std::vector<T> &out, size_t offset, const std::vector<T> &in)
+  {
+    parallel_for_blocked
+      (0,in.size(),mergeBlockSize,
+       [&](size_t begin, size_t end){
+         std::copy(in.begin()+begin,in.begin()+end,out.begin()+offset+begin);
+       });
+  }
+
+  /*! sets 'count' elements of 'out', starting at 'offset', to 'value' */
+  template<typename T>
+  void fillInto(std::vector<T> &out, size_t offset, size_t count, const T &value)
+  {
+    parallel_for_blocked
+      (0,count,mergeBlockSize,
+       [&](size_t begin, size_t end){
+         std::fill(out.begin()+offset+begin,out.begin()+offset+end,value);
+       });
+  }
+  
+  /*! copies all of 'in' to 'out' starting at 'offset', and shifts
+      the copied prims' vertex indices by 'vertexOffset' */
+  template<typename Prim>
+  void copyPrimsInto(std::vector<Prim> &out, size_t offset,
+                     const std::vector<Prim> &in, int vertexOffset)
+  {
+    parallel_for_blocked
+      (0,in.size(),mergeBlockSize,
+       [&](size_t begin, size_t end){
+         for (size_t i=begin;i<end;i++) {
+           Prim prim = in[i];
+           for (int j=0;j<Prim::numVertices;j++)
+             prim[j] += vertexOffset;
+           out[offset+i] = prim;
+         }
+       });
+  }
+
+  /*! carries the inputs' quantized attributes (by name) over to the
+      merged mesh 'out': if all inputs that have one of a given name
+      use the same quantization their codes get concatenated (with
+      the NaN code for the vertices of inputs that do not have it),
+      otherwise they all get dequantized into a (not yet finalized)
+      regular per-vertex attribute, with NaNs for those vertices */
+  void mergeQuantizedAttributes(const std::vector<UMesh::SP> &inputs,
+                                const std::vector<size_t> &vertexOffset,
+                                UMesh &out)
+  {
+    const size_t numInputs   = inputs.size();
+    const size_t numVertices = vertexOffset[numInputs];
+    std::vector<std::string> names;
+    for (auto input : inputs)
+      for (auto attr : input->quantizedAttributes)
+        if (std::find(names.begin(),names.end(),attr->name) == names.end())
+          names.push_back(attr->name);
+    
+    for (auto &name : names) {
+      std::vector<QuantizedAttribute::SP> in(numInputs);
+      QuantizedAttribute::SP first;
+      bool sameQuantization = true;
+      for (size_t meshID=0;meshID<numInputs;meshID++) {
+        for (auto attr : inputs[meshID]->quantizedAttributes)
+          if (attr->name == name && !in[meshID]) in[meshID] = attr;
+        const QuantizedAttribute::SP attr = in[meshID];
+        if (!attr) continue;
+        if (attr->size() != inputs[meshID]->vertices.size())
+          throw std::runtime_error
+            ("#umesh.mergeMeshes: quantized attribute '"+name
+             +"' does not have one value per vertex");
+        if (!first) first = attr;
+        sameQuantization
+          &=  attr->bits == first->bits
+          &&  attr->valueRange.lower == first->valueRange.lower
+          &&  attr->valueRange.upper == first->valueRange.upper;
+      }
+
+      if (sameQuantization) {
+        QuantizedAttribute::SP merged = std::make_shared<QuantizedAttribute>();
+        merged->name = name;
+        merged->setQuantization(first->bits,first->valueRange);
+        if (merged->bits == 8) merged->codes8.resize(numVertices);
+        else                   merged->codes16.resize(numVertices);
+        parallel_for
+          (numInputs,
+           [&](size_t meshID) {
+             const QuantizedAttribute::SP attr = in[meshID];
+             const size_t offset = vertexOffset[meshID];
+             const size_t count  = inputs[meshID]->vertices.size();
+             if (merged->bits == 8) {
+               if (attr) copyInto(merged->codes8,offset,attr->codes8);
+               else      fillInto(merged->codes8,offset,count,uint8_t(merged->maxCode()));
+             } else {
+               if (attr) copyInto(merged->codes16,offset,attr->codes16);
+               else      fillInto(merged->codes16,offset,count,uint16_t(merged->maxCode()));
+             }
+           });
+        out.quantizedAttributes.push_back(merged);
+      } else {
+        Attribute::SP merged = std::make_shared<Attribute>(numVertices);
+        merged->name = name;
+        parallel_for
+          (numInputs,
+           [&](size_t meshID) {
+             const QuantizedAttribute::SP attr = in[meshID];
+             const size_t offset = vertexOffset[meshID];
+             const size_t count  = inputs[meshID]->vertices.size();
+             if (!attr) {
+               fillInto(merged->values,offset,count,float(NAN));
+               return;
+             }
+             parallel_for_blocked
+               (0,count,mergeBlockSize,
+                [&](size_t begin, size_t end){
+                  for (size_t i=begin;i<end;i++)
+                    merged->values[offset+i] = (*attr)[i];
+                });
+           });
+        out.attributes.push_back(merged);
+      }
+    }
+  }
+  
+  /*! one attribute of a merged mesh, and the attribute (if any) each
+      input contributes to it */
+  struct MergedAttribute {
+    UMesh::PrimType            type;
+    Attribute::SP              out;
+    std::vector<Attribute::SP> in;
+  };
+
+  /*! does all of mergeMeshes() except for finalizing the result (or
+      its attributes) */
+  UMesh::SP mergeWithoutFinalizing(const std::vector<UMesh::SP> &inputs,
+                                   bool weldVertices)
+  {
+    const size_t numInputs = inputs.size();
+    // where each input's vertices (index 0) and grid scalars (index
+    // 1) go in the merged arrays; plus the respective totals
+    std::vector<size_t> vertexOffset(numInputs+1,0);
+    std::vector<size_t> gridScalarOffset(numInputs+1,0);
+    // same, for each prim type
+    std::vector<std::array<size_t,UMesh::INVALID>> primOffset(numInputs+1);
+    primOffset[0].fill(0);
+    for (size_t meshID=0;meshID<numInputs;meshID++) {
+      const UMesh &input = *inputs[meshID];
+      vertexOffset[meshID+1]
+        = vertexOffset[meshID] + input.vertices.size();
+      gridScalarOffset[meshID+1]
+        = gridScalarOffset[meshID] + input.gridScalars.size();
+      for (int type=0;type<UMesh::INVALID;type++)
+        primOffset[meshID+1][type]
+          = primOffset[meshID][type] + numPrimsOfType(input,UMesh::PrimType(type));
+    }
+    const size_t numVertices = vertexOffset[numInputs];
+    const size_t numGridScalars = gridScalarOffset[numInputs];
+    const std::array<size_t,UMesh::INVALID> &numPrims = primOffset[numInputs];
+    if (numVertices > INT_MAX)
+      throw std::runtime_error
+        ("#umesh.mergeMeshes: cannot merge meshes - merged mesh would have too "
+         "many vertices to be addressable by 32-bit (signed) integers");
+    if (numGridScalars > INT_MAX)
+      throw std::runtime_error
+        ("#umesh.mergeMeshes: cannot merge meshes - merged mesh would have too "
+         "many grid scalars to be addressable by 32-bit (signed) integers");
+
+    // ------------------------------------------------------------------
+    // gather the union of all inputs' attributes: per-vertex ones by
+    // name (with 'perVertex' always first, and named after the first
+    // input that has one), per-element ones by prim type and name
+    // ------------------------------------------------------------------
+    std::vector<MergedAttribute> attributes;
+    auto findOrAdd = [&](UMesh::PrimType type,
+                         const std::string &name) -> MergedAttribute & {
+      for (auto &merged : attributes)
+        if (merged.type == type && merged.out->name == name)
+          return merged;
+      MergedAttribute merged;
+      merged.type = type;
+      merged.out  = std::make_shared<Attribute>();
+      merged.out->name = name;
+      merged.in.resize(numInputs);
+      attributes.push_back(merged);
+      return attributes.back();
+    };
+    for (size_t meshID=0;meshID<numInputs;meshID++)
+      if (inputs[meshID]->perVertex) {
+        MergedAttribute perVertex;
+        perVertex.type = UMesh::INVALID;
+        perVertex.out  = std::make_shared<Attribute>();
+        perVertex.out->name = inputs[meshID]->perVertex->name;
+        perVertex.in.resize(numInputs);
+        for (size_t i=0;i<numInputs;i++)
+          perVertex.in[i] = inputs[i]->perVertex;
+        attributes.push_back(perVertex);
+        break;
+      }
+    const bool hasPerVertex = !attributes.empty();
+    for (size_t meshID=0;meshID<numInputs;meshID++) {
+      const UMesh &input = *inputs[meshID];
+      for (auto attribute : input.attributes)
+        if (attribute && attribute != input.perVertex) {
+          // (this may also be 'perVertex' of the merged mesh, if
+          // this input has it under another name)
+          MergedAttribute &merged = findOrAdd(UMesh::INVALID,attribute->name);
+          if (!merged.in[meshID])
+            merged.in[meshID] = attribute;
+        }
+    }
+    for (size_t meshID=0;meshID<numInputs;meshID++)
+      for (auto &typeAndAttribute : inputs[meshID]->elementAttributes)
+        findOrAdd(typeAndAttribute.first,typeAndAttribute.second->name)
+          .in[meshID] = typeAndAttribute.second;
+    for (size_t meshID=0;meshID<numInputs;meshID++)
+      for (auto &merged : attributes) {
+        const Attribute::SP in = merged.in[meshID];
+        const size_t expected
+          = (merged.type == UMesh::INVALID)
+          ? inputs[meshID]->vertices.size()
+          : numPrimsOfType(*inputs[meshID],merged.type);
+        if (in && in->values.size() != expected)
+          throw std::runtime_error
+            ("#umesh.mergeMeshes: attribute '"+in->name
+             +"' does not have one value per vertex/element");
+        merged.out->values.resize(merged.type == UMesh::INVALID
+                                  ? numVertices : numPrims[merged.type]);
+      }
+    
+    bool hasVertexTags = false;
     for (auto input : inputs) {
-      
-      vtxOffsets.push_back((int)numVtx);
-      triOffsets.push_back((int)numTri);
-      qudOffsets.push_back((int)numQud);
-      tetOffsets.push_back((int)numTet);
-      pyrOffsets.push_back((int)numPyr);
-      wdgOffsets.push_back((int)numWdg);
-      hexOffsets.push_back((int)numHex);
-      grdOffsets.push_back((int)numGrd);
-      gscOffsets.push_back((int)numGsc);
-
-      numVtx += input->vertices.size();
-      if (numVtx > INT_MAX)
+      if (input->vertexTags.empty()) continue;
+      if (input->vertexTags.size() != input->vertices.size())
         throw std::runtime_error
-          ("cannot merge meshes - merged mesh would have to "
-           "many vertices to be addressable by 32-bit (signed) integers");
-      numTri += input->triangles.size();
-      numQud += input->quads.size();
-      numTet += input->tets.size();
-      numPyr += input->pyrs.size();
-      numWdg += input->wedges.size();
-      numHex += input->hexes.size();
-      numGrd += input->grids.size();
-      numGsc += input->gridScalars.size();
+          ("#umesh.mergeMeshes: input mesh does not have one tag per vertex");
+      hasVertexTags = true;
     }
+
     UMesh::SP out = std::make_shared<UMesh>();
-    out->perVertex = std::make_shared<Attribute>();
-    out->perVertex->values.resize(numVtx);
-    out->vertices.resize(numVtx);
-    out->triangles.resize(numTri);
-    out->quads.resize(numQud);
-    out->tets.resize(numTet);
-    out->pyrs.resize(numPyr);
-    out->wedges.resize(numWdg);
-    out->hexes.resize(numHex);
-    out->grids.resize(numGrd);
-    out->gridScalars.resize(numGsc);
-    
-    serial_for
-      ((int)inputs.size(),
-       [&](int meshID) {
-         auto input = inputs[meshID];
-         for (int i=0;i<input->vertices.size();i++) {
-           auto v = input->vertices[i];
-           auto s = input->perVertex->values[i];
-           out->vertices[vtxOffsets[meshID]+i] = v;
-           out->perVertex->values[vtxOffsets[meshID]+i] = s;
-         }
+    out->vertices.resize(numVertices);
+    out->triangles.resize(numPrims[UMesh::TRI]);
+    out->quads.resize(numPrims[UMesh::QUAD]);
+    out->tets.resize(numPrims[UMesh::TET]);
+    out->pyrs.resize(numPrims[UMesh::PYR]);
+    out->wedges.resize(numPrims[UMesh::WEDGE]);
+    out->hexes.resize(numPrims[UMesh::HEX]);
+    out->grids.resize(numPrims[UMesh::GRID]);
+    out->gridScalars.resize(numGridScalars);
+    if (hasVertexTags)
+      out->vertexTags.resize(numVertices);
+    for (auto &merged : attributes)
+      if (merged.type == UMesh::INVALID)
+        out->attributes.push_back(merged.out);
+      else
+        out->elementAttributes.push_back({merged.type,merged.out});
+    if (hasPerVertex)
+      out->perVertex = attributes[0].out;
 
-         for (int i=0;i<input->triangles.size();i++) {
-           auto prim = input->triangles[i];
-           for (int j=0;j<prim.numVertices;j++)
-             prim[j] += vtxOffsets[meshID];
-           out->triangles[triOffsets[meshID]+i] = prim;
-         }
-         for (int i=0;i<input->quads.size();i++) {
-           auto prim = input->quads[i];
-           for (int j=0;j<prim.numVertices;j++)
-             prim[j] += vtxOffsets[meshID];
-           out->quads[qudOffsets[meshID]+i] = prim;
-         }
-         for (int i=0;i<input->tets.size();i++) {
-           auto prim = input->tets[i];
-           for (int j=0;j<prim.numVertices;j++)
-             prim[j] += vtxOffsets[meshID];
-           out->tets[tetOffsets[meshID]+i] = prim;
-         }
-         for (int i=0;i<input->pyrs.size();i++) {
-           auto prim = input->pyrs[i];
-           for (int j=0;j<prim.numVertices;j++)
-             prim[j] += vtxOffsets[meshID];
-           out->pyrs[pyrOffsets[meshID]+i] = prim;
-         }
-         for (int i=0;i<input->wedges.size();i++) {
-           auto prim = input->wedges[i];
-           for (int j=0;j<prim.numVertices;j++)
-             prim[j] += vtxOffsets[meshID];
-           out->wedges[wdgOffsets[meshID]+i] = prim;
-         }
-         for (int i=0;i<input->hexes.size();i++) {
-           auto prim = input->hexes[i];
-           for (int j=0;j<prim.numVertices;j++)
-             prim[j] += vtxOffsets[meshID];
-           out->hexes[hexOffsets[meshID]+i] = prim;
-         }
-         for (int i=0;i<input->grids.size();i++) {
-           auto prim = input->grids[i];
-           prim.scalarsOffset += gscOffsets[meshID];
-           out->grids[grdOffsets[meshID]+i] = prim;
-         }
-         for (int i=0;i<input->gridScalars.size();i++) {
-           out->gridScalars[gscOffsets[meshID]+i] = input->gridScalars[i];
+    // ------------------------------------------------------------------
+    // copy - in parallel over all inputs, and over each input's
+    // arrays' elements
+    // ------------------------------------------------------------------
+    parallel_for
+      (numInputs,
+       [&](size_t meshID) {
+         const UMesh &input = *inputs[meshID];
+         const size_t vtxOfs = vertexOffset[meshID];
+         const std::array<size_t,UMesh::INVALID> &ofs = primOffset[meshID];
+         copyInto(out->vertices,vtxOfs,input.vertices);
+         copyPrimsInto(out->triangles,ofs[UMesh::TRI],  input.triangles,int(vtxOfs));
+         copyPrimsInto(out->quads,    ofs[UMesh::QUAD], input.quads,    int(vtxOfs));
+         copyPrimsInto(out->tets,     ofs[UMesh::TET],  input.tets,     int(vtxOfs));
+         copyPrimsInto(out->pyrs,     ofs[UMesh::PYR],  input.pyrs,     int(vtxOfs));
+         copyPrimsInto(out->wedges,   ofs[UMesh::WEDGE],input.wedges,   int(vtxOfs));
+         copyPrimsInto(out->hexes,    ofs[UMesh::HEX],  input.hexes,    int(vtxOfs));
+         parallel_for_blocked
+           (0,input.grids.size(),mergeBlockSize,
+            [&](size_t begin, size_t end){
+              for (size_t i=begin;i<end;i++) {
+                Grid grid = input.grids[i];
+                grid.scalarsOffset += int(gridScalarOffset[meshID]);
+                out->grids[ofs[UMesh::GRID]+i] = grid;
+              }
+            });
+         copyInto(out->gridScalars,gridScalarOffset[meshID],input.gridScalars);
+         
+         for (auto &merged : attributes) {
+           const size_t offset
+             = (merged.type == UMesh::INVALID) ? vtxOfs : ofs[merged.type];
+           const Attribute::SP in = merged.in[meshID];
+           if (in)
+             copyInto(merged.out->values,offset,in->values);
+           else
+             fillInto(merged.out->values,offset,
+                      (merged.type == UMesh::INVALID)
+                      ? input.vertices.size()
+                      : numPrimsOfType(input,merged.type),
+                      NAN);
          }
+         if (!hasVertexTags)
+           return;
+         if (input.vertexTags.empty())
+           fillInto(out->vertexTags,vtxOfs,input.vertices.size(),size_t(-1));
+         else
+           copyInto(out->vertexTags,vtxOfs,input.vertexTags);
        });
+    mergeQuantizedAttributes(inputs,vertexOffset,*out);
+
+    if (weldVertices)
+      umesh::weldVertices(out);
+    return out;
+  }
+
+  /*! merge mulitple meshes into one, see UMesh.h */
+  UMesh::SP mergeMeshes(const std::vector<UMesh::SP> &inputs,
+                        bool weldVertices)
+  {
+    UMesh::SP out = mergeWithoutFinalizing(inputs,weldVertices);
+    for (auto attr : out->attributes)
+      attr->finalize();
+    for (auto attr : out->elementAttributes)
+      attr.second->finalize();
     out->finalize();
     return out;
   }
     
   
-  /*! appends another mesh's vertices and primitmives to this
-    current mesh. will _not_ try to find shared vertices, will
-    just append all other elements and change their indices to
-    correctly point to the appended other vertices */
+#if UMESH_ENABLE_SANITY_CHECKS
+  /*! throws if the incrementally finalized result of append() does
+      not have the same bounds and value ranges as the (fully
+      finalized) result of mergeMeshes() on the same inputs */
+  void checkSameBoundsAndRanges(const UMesh &appended, const UMesh &merged)
+  {
+    auto sameRange = [](const range1f &a, const range1f &b) {
+      return (a.lower == b.lower && a.upper == b.upper)
+        || (a.lower > a.upper && b.lower > b.upper);
+    };
+    bool same
+      =  appended.bounds.lower == merged.bounds.lower
+      && appended.bounds.upper == merged.bounds.upper
+      && sameRange(appended.gridsScalarRange,merged.gridsScalarRange)
+      && appended.attributes.size() == merged.attributes.size()
+      && appended.elementAttributes.size() == merged.elementAttributes.size()
+      && !appended.perVertex == !merged.perVertex;
+    for (size_t i=0;same && i<appended.attributes.size();i++)
+      same = sameRange(appended.attributes[i]->valueRange,
+                       merged.attributes[i]->valueRange);
+    for (size_t i=0;same && i<appended.elementAttributes.size();i++)
+      same = sameRange(appended.elementAttributes[i].second->valueRange,
+                       merged.elementAttributes[i].second->valueRange);
+    if (same && appended.perVertex)
+      same = sameRange(appended.perVertex->valueRange,merged.perVertex->valueRange);
+    if (!same)
+      throw std::runtime_error("#umesh.append: bounds or value ranges of appended "
+                               "mesh do not match those of merged mesh");
+  }
+#endif
+  
+  /*! appends another mesh's vertices and primitives to this current
+      mesh, see UMesh.h */
   void UMesh::append(UMesh::SP other)
   {
-    size_t oldNumVertices = vertices.size();
-    // ----------- vertices -----------
-    for (auto v : other->vertices)
-      vertices.push_back(v);
-    // ----------- scalars -----------
-    if (perVertex) {
-      assert(other->perVertex);
-      for (auto v : other->perVertex->values)
-        perVertex->values.push_back(v);
-    }
-    // ----------- tets -----------
-    for (auto prim : other->tets) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] += (int)oldNumVertices;
-      tets.push_back(prim);
-    }
-    // ----------- hexes -----------
-    for (auto prim : other->hexes) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] += (int)oldNumVertices;
-      hexes.push_back(prim);
-    }
-    // ----------- pyrs -----------
-    for (auto prim : other->pyrs) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] += (int)oldNumVertices;
-      pyrs.push_back(prim);
-    }
-    // ----------- wedges -----------
-    for (auto prim : other->wedges) {
-      for (int i=0;i<prim.numVertices;i++)
-        prim[i] += (int)oldNumVertices;
-      wedges.push_back(prim);
+    UMesh::SP self = std::make_shared<UMesh>();
+    std::swap(*self,*this);
+    if (!self->finalized.valid || self->dirty) {
+      *this = std::move(*mergeMeshes({self,other}));
+      return;
     }
-
     
-    // ----------- grid-scalars -----------
-    size_t oldNumGridScalars = gridScalars.size();
-    for (auto s : other->gridScalars)
-      gridScalars.push_back(s);
-    // ----------- grids -----------
-    for (auto prim : other->grids) {
-      prim.scalarsOffset += (int)oldNumGridScalars;
-      grids.push_back(prim);
-    }
-
+    // the merged mesh starts with all of self's data, so its bounds
+    // and ranges only have to get extended by those of other's data
+    UMesh::SP merged = mergeWithoutFinalizing({self,other},false);
+    auto finalizeAppended = [&](Attribute::SP attr, PrimType type) {
+      Attribute::SP before;
+      bool dequantized = false;
+      if (attr == merged->perVertex && self->perVertex)
+        // (which many loaders set without adding it to 'attributes')
+        before = self->perVertex;
+      else {
+        // (quantized attributes of different quantizations get
+        // dequantized into regular ones, see mergeMeshes())
+        for (auto it : self->quantizedAttributes)
+          if (type == INVALID && it->name == attr->name) dequantized = true;
+        for (auto it : self->attributes)
+          if (type == INVALID && it != self->perVertex && it->name == attr->name)
+            before = it;
+        for (auto it : self->elementAttributes)
+          if (type == it.first && it.second->name == attr->name) before = it.second;
+      }
+      // (for attributes self did not have, its part is all NaNs,
+      // which do not affect the range; those other than perVertex
+      // may never have been finalized, so an empty range means self's
+      // part has to be looked at, too)
+      attr->valueRange = before ? before->valueRange : range1f();
+      const size_t begin
+        = ((before && before->valueRange.empty()) || (!before && dequantized))
+        ? 0
+        : (type == INVALID ? self->vertices.size() : numPrimsOfType(*self,type));
+      if (attr != merged->perVertex)
+        attr->finalize(begin);
+    };
+    for (auto attr : merged->attributes)
+      finalizeAppended(attr,INVALID);
+    for (auto attr : merged->elementAttributes)
+      finalizeAppended(attr.second,attr.first);
 
-    // =========== done ===========
-    finalize();
+    merged->bounds               = self->bounds;
+    merged->gridsScalarRange     = self->gridsScalarRange;
+    merged->finalized            = self->finalized;
+    merged->finalized.perVertex  = merged->perVertex;
+    merged->finalized.numScalars = self->vertices.size();
+    merged->dirty                = 0;
+    merged->finalize();
+    *this = std::move(*merged);
+#if UMESH_ENABLE_SANITY_CHECKS
+    checkSameBoundsAndRanges(*this,*mergeMeshes({self,other}));
+#endif
   }
     
   
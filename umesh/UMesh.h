@@ -82,6 +82,11 @@ namespace umesh {
   /*! can be used to turn on/off logging/diagnostic messages in entire
     umesh library */
   extern bool verbose;
+
+  /*! see umesh/ScalarStats.h */
+  struct ScalarStats;
+  /*! see umesh/CompactBrick.h */
+  struct CompactBrick;
   
   struct Attribute {
     typedef std::shared_ptr<Attribute> SP;
@@ -90,6 +95,9 @@ namespace umesh {
     
     /*! tells this attribute that its values are set, and precomputations can be done */
     void finalize();
+    /*! extends valueRange by the values from 'begin' on only; for
+        when values got appended since the last finalize() */
+    void finalize(size_t begin);
     
     std::string name;
     /*! for now lets implement only float attributes. node/ele files
@@ -100,6 +108,65 @@ namespace umesh {
       mean. */
     std::vector<float> values;
     range1f valueRange;
+    /*! statistics (range, moments, histogram) of the values, if
+        computed (see computeStats() in umesh/ScalarStats.h); get
+        stored in, and read back from, .umesh files. These are not
+        updated when the values change - recompute them then */
+    std::shared_ptr<ScalarStats> stats;
+  };
+
+  /*! a per-vertex attribute whose values are stored as 8- or 16-bit
+      codes relative to its value range, for when full float precision
+      isn't needed (eg, for visualization): code 'k' stands for
+      'valueRange.lower+k*step', and the largest code for NaN. This is
+      a separate attribute type, not a mode of Attribute, so code that
+      expects float values can never see codes; kernels that can work
+      on quantized scalars directly (resampleToGrid(), iso-surface
+      extraction via IsoSurfaceOptions::quantizedScalars) take one
+      explicitly. Stored in UMesh::quantizedAttributes, and in .umesh
+      files as QUANTIZED_ATTRIBUTE sections */
+  struct QuantizedAttribute {
+    typedef std::shared_ptr<QuantizedAttribute> SP;
+
+    /*! quantizes given (finalized) attribute to given number of bits
+        (8 or 16); throws if its value range is not finite */
+    static QuantizedAttribute::SP quantize(const Attribute &attr, int bits);
+    /*! quantizes given attribute to the fewest bits (8 or 16) for
+        which maxError() is <= the given error bound; throws if even 16
+        bits do not suffice */
+    static QuantizedAttribute::SP quantize(const Attribute &attr, float maxError);
+
+    /*! a float copy of this attribute's (dequantized) values */
+    Attribute::SP dequantize() const;
+
+    /*! sets number of bits and value range, and with that the step
+        between codes; does not change any codes */
+    void setQuantization(int bits, const range1f &valueRange);
+    
+    inline uint32_t maxCode() const { return (1u << bits)-1; }
+    inline size_t   size()    const
+    { return bits == 8 ? codes8.size() : codes16.size(); }
+    inline uint32_t code(size_t i) const
+    { return bits == 8 ? uint32_t(codes8[i]) : uint32_t(codes16[i]); }
+    inline float decode(uint32_t code) const
+    { return code == maxCode() ? NAN : valueRange.lower+code*step; }
+    /*! dequantized value of vertex 'i' */
+    inline float operator[](size_t i) const { return decode(code(i)); }
+    
+    /*! upper bound for the difference between any original value
+        and its dequantized value (NaNs stay NaNs) - half a step,
+        plus some slack for the rounding in decode() */
+    float maxError() const;
+
+    std::string           name;
+    /*! 8 or 16 */
+    int                   bits = 16;
+    /*! range of the codes' values; the original values' range */
+    range1f               valueRange;
+    float                 step = 0.f;
+    /*! the codes; only the one for 'bits' is used */
+    std::vector<uint8_t>  codes8;
+    std::vector<uint16_t> codes16;
   };
 
   struct Triangle {
@@ -268,6 +335,52 @@ namespace umesh {
     int   scalarsOffset;
   };
   
+  /*! selects which parts of a .umesh file get loaded by
+      UMesh::loadFrom(); whatever is not selected gets skipped without
+      reading (or allocating memory for) its data */
+  struct LoadSelection {
+    typedef enum : uint32_t {
+      VERTICES           = (1<<0),
+      VERTEX_ATTRIBUTES  = (1<<1),
+      ELEMENT_ATTRIBUTES = (1<<2),
+      TRIANGLES          = (1<<3),
+      QUADS              = (1<<4),
+      TETS               = (1<<5),
+      PYRS               = (1<<6),
+      WEDGES             = (1<<7),
+      HEXES              = (1<<8),
+      /*! grids, including their grid scalars */
+      GRIDS              = (1<<9),
+      VERTEX_TAGS        = (1<<10),
+      SURFACE_ELEMENTS   = TRIANGLES|QUADS,
+      VOLUME_ELEMENTS    = TETS|PYRS|WEDGES|HEXES|GRIDS,
+      ALL                = 0xffffffffu
+    } Part;
+
+    LoadSelection(uint32_t parts = ALL) : parts(parts) {}
+
+    /*! whether any of the given parts is to be loaded */
+    inline bool wants(uint32_t part) const { return (parts & part) != 0; }
+    
+    /*! whether the per-vertex attribute of given name is to be loaded */
+    inline bool wantsAttribute(const std::string &name) const
+    {
+      return wants(VERTEX_ATTRIBUTES)
+        && (attributeNames.empty()
+            || std::find(attributeNames.begin(),attributeNames.end(),name)
+            != attributeNames.end());
+    }
+
+    /*! whether this selects the entire file */
+    inline bool selectsAll() const
+    { return parts == ALL && attributeNames.empty(); }
+    
+    uint32_t parts = ALL;
+    /*! if non-empty, only the per-vertex attributes of these names
+        get loaded - all others get skipped */
+    std::vector<std::string> attributeNames;
+  };
+  
   /*! basic unstructured mesh class - one set of 3-float vertices, and
     one std::vector each for tets, wedges, pyramids, and hexes, all
     using VTK format for the vertex index ordering (see
@@ -305,13 +418,12 @@ namespace umesh {
     /*! returns total numer of volume elements */
     inline size_t numVolumeElements() const
     {
-      return size()+pyrs.size()+wedges.size()+hexes.size()+grids.size();
+      return tets.size()+pyrs.size()+wedges.size()+hexes.size()+grids.size();
     }
 
-    /*! appends another mesh's vertices and primitmives to this
-        current mesh. will _not_ try to find shared vertices, will
-        just append all other elements and change their indices to
-        correctly point to the appended other vertices */
+    /*! appends another mesh's vertices, primitives, grids, and
+        attributes to this current mesh, in the same way as
+        mergeMeshes() does; will _not_ try to find shared vertices */
     void append(UMesh::SP other);
 
     /*! returns total numer of *cells*, which for meshes with grids
@@ -330,16 +442,35 @@ namespace umesh {
     /*! print some basic info of this mesh to std::cout */
     void print();
 
-    /*! write - binary - to given file */
-    void saveTo(const std::string &fileName) const;
+    /*! write - binary - to given file; the sections of the file get
+        written by multiple threads in parallel (see
+        io/ParallelIO.h). If 'compress' is set, sections get
+        compressed (see io/Compression.h) where that makes them
+        smaller */
+    void saveTo(const std::string &fileName, bool compress = false) const;
+    /*! same as saveTo(fileName,compress), but writes the vertices
+        and (if it has those) element indices of given CompactBrick -
+        which has to be this mesh's, as returned by
+        CompactBrick::encode() - instead of the mesh's own */
+    void saveTo(const std::string &fileName,
+                const CompactBrick &compact,
+                bool compress = false) const;
     /*! write - binary - to given (bianry) stream */
     void writeTo(std::ostream &out) const;
     
     
-    /*! read from given file, assuming file format as used by saveTo() */
-    static UMesh::SP loadFrom(const std::string &fileName);
+    /*! read from given file, assuming file format as used by
+        saveTo(); version-2 containers get read by multiple threads in
+        parallel, older formats sequentially. If a selection is
+        given, only the selected parts get read; in that case the
+        mesh's bounds only get computed if vertices and elements were
+        loaded (or, for version-2 files, get taken from the file's
+        header) */
+    static UMesh::SP loadFrom(const std::string &fileName,
+                              const LoadSelection &selection = LoadSelection());
     /*! read from given (binary) stream */
-    void readFrom(std::istream &in);
+    void readFrom(std::istream &in,
+                  const LoadSelection &selection = LoadSelection());
     
     /*! create std::vector of primitmive references (bounding box plus
       tag) for every volumetric prim in this mesh */
@@ -362,12 +493,14 @@ namespace umesh {
     std::vector<PrimRef> createSurfacePrimRefs();
 
     /*! sets given vertex's scalar field value to the value specified;
-        this will _not_ update the attributes' min/max valuerange */
+        this will _not_ update the attributes' min/max valuerange, but
+        marks the scalars as changed, so the next finalize() does */
     void setScalar(size_t scalarID, float value)
     {
       assert(perVertex);
       assert(scalarID < perVertex->values.size());
       perVertex->values[scalarID] = value;
+      dirty |= SCALARS_CHANGED;
     }
     
     inline size_t size() const
@@ -620,12 +753,42 @@ namespace umesh {
                    vec4f(spatial.upper,value.upper));
     }
 
-    /*! finalize a mesh, and compute min/max ranges where required */
+    /*! what finalize() cannot detect on its own; see markDirty() */
+    typedef enum : uint32_t {
+      /*! (some of the) existing vertices have moved */
+      VERTICES_CHANGED = (1<<0),
+      /*! existing values of perVertex or gridScalars have changed */
+      SCALARS_CHANGED  = (1<<1),
+      /*! existing elements (or grids) have been changed, or removed */
+      ELEMENTS_CHANGED = (1<<2),
+      ALL_CHANGED      = 0xffffffffu
+    } DirtyFlags;
+
+    /*! finalize a mesh, and compute min/max ranges where required.
+        This is incremental: vertices, scalars, and elements that
+        were appended since the last finalize() (eg, by append()) only
+        get merged into the existing bounds and ranges, and arrays
+        that did not change do not get looked at. In-place changes
+        to existing data cannot be detected, and have to be announced
+        by markDirty() (setScalar() does that automatically); arrays
+        that got smaller, and a replaced perVertex attribute, get
+        recomputed from scratch */
     void finalize();
+
+    /*! tells the next finalize() that the given parts of the mesh
+        (a combination of DirtyFlags) got changed in place, and have
+        to be looked at again */
+    inline void markDirty(uint32_t what = ALL_CHANGED) { dirty |= what; }
     
     std::vector<vec3f> vertices;
     Attribute::SP      perVertex;
     std::vector<Attribute::SP> attributes;
+    /*! per-element attributes; each is associated with exactly one
+        prim type, and has one value per element of that type */
+    std::vector<std::pair<PrimType,Attribute::SP>> elementAttributes;
+    /*! per-vertex attributes stored in quantized form; these are
+        separate from 'attributes', and never become 'perVertex' */
+    std::vector<QuantizedAttribute::SP> quantizedAttributes;
     // Attribute::SP      perTet;
     // Attribute::SP      perHex;
     
@@ -656,12 +819,43 @@ namespace umesh {
     
     box3f   bounds;
     range1f gridsScalarRange;
+
+  private:
+    /*! how much of each array the last finalize() looked at */
+    struct FinalizedState {
+      bool        valid = false;
+      size_t      numPrims[GRID+1] = {};
+      size_t      numScalars = 0;
+      size_t      numGridScalars = 0;
+      /*! the perVertex attribute whose range got computed (weak, so
+          a new attribute can never end up at the same address) */
+      std::weak_ptr<Attribute> perVertex;
+    };
+    FinalizedState finalized;
+    uint32_t       dirty = ALL_CHANGED;
   };
 
-  /*! merge mulitple meshes into one. will _not_ try to find shared
-    vertices, will just append all other elements and change their
-    indices to correctly point to the appended other vertices */
-  UMesh::SP mergeMeshes(const std::vector<UMesh::SP> &inputs);
+  /*! merge mulitple meshes into one, by appending all inputs'
+    vertices and elements (in input order), and changing their indices
+    to correctly point to the appended vertices; grids get their
+    scalars offsets adjusted the same way. The merged mesh carries
+    the union of all inputs' vertex attributes (by name, with
+    'perVertex' being the first input's 'perVertex', if any) and
+    element attributes (by prim type and name), and - if any input
+    has them - vertex tags; inputs that lack an attribute get NaNs
+    for it, and inputs without tags get size_t(-1) tags. Quantized
+    attributes (by name) stay quantized if all inputs that have one
+    of that name use the same bits and value range, with NaN codes
+    for the inputs without it; otherwise they get dequantized into a
+    regular vertex attribute. All copying
+    happens in parallel, over inputs and over each input's elements.
+
+    If 'weldVertices' is set, all vertices with the same position
+    (eg, those shared across the boundaries of neighboring bricks)
+    get merged into one afterwards, see umesh::weldVertices(); else
+    this will _not_ try to find shared vertices */
+  UMesh::SP mergeMeshes(const std::vector<UMesh::SP> &inputs,
+                        bool weldVertices = false);
     
   
   /*! helper functoin for printf debugging - puts the four elemnt
@@ -0,0 +1,85 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "umesh/VertexArrays.h"
+#include <cmath>
+
+namespace umesh {
+
+  /*! creates the arrays, with vertex i's scalar being 'scalarOf(i)' */
+  template<typename ScalarOf>
+  VertexArrays::SP createArrays(const UMesh &mesh,
+                                VertexArraysLayout layout,
+                                const ScalarOf &scalarOf)
+  {
+    const size_t numVertices = mesh.vertices.size();
+    VertexArrays::SP result = std::make_shared<VertexArrays>();
+    result->layout      = layout;
+    result->numVertices = numVertices;
+    if (layout == VERTEX_ARRAYS_PACKED)
+      result->xyzs.resize(numVertices);
+    else {
+      result->x.resize(numVertices);
+      result->y.resize(numVertices);
+      result->z.resize(numVertices);
+      result->s.resize(numVertices);
+    }
+    
+    parallel_for_blocked
+      (0,numVertices,64*1024,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           const vec3f pos = mesh.vertices[i];
+           const float value = scalarOf(i);
+           if (layout == VERTEX_ARRAYS_PACKED)
+             result->xyzs[i] = vec4f(pos,value);
+           else {
+             result->x[i] = pos.x;
+             result->y[i] = pos.y;
+             result->z[i] = pos.z;
+             result->s[i] = value;
+           }
+         }
+       });
+    return result;
+  }
+  
+  VertexArrays::SP VertexArrays::create(const UMesh &mesh,
+                                        VertexArraysLayout layout,
+                                        Attribute::SP scalars)
+  {
+    if (!scalars) scalars = mesh.perVertex;
+    if (scalars && scalars->values.size() != mesh.vertices.size())
+      throw std::runtime_error("#umesh.VertexArrays: scalars do not have one "
+                               "value per vertex");
+    const float *values = scalars ? scalars->values.data() : nullptr;
+    return createArrays(mesh,layout,[&](size_t i){
+        return values ? values[i] : NAN;
+      });
+  }
+  
+  VertexArrays::SP VertexArrays::create(const UMesh &mesh,
+                                        VertexArraysLayout layout,
+                                        const QuantizedAttribute &scalars)
+  {
+    if (scalars.size() != mesh.vertices.size())
+      throw std::runtime_error("#umesh.VertexArrays: scalars do not have one "
+                               "value per vertex");
+    return createArrays(mesh,layout,[&](size_t i){ return scalars[i]; });
+  }
+  
+} // ::umesh
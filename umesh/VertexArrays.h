@@ -0,0 +1,124 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include <cstdlib>
+#ifdef _WIN32
+# include <malloc.h>
+#endif
+#include <new>
+
+namespace umesh {
+
+  /*! std::allocator replacement that aligns all arrays to 'alignment'
+      bytes, so vector loads of (groups of) elements never straddle
+      cache lines */
+  template<typename T, size_t alignment>
+  struct AlignedAllocator {
+    typedef T value_type;
+    template<typename U> struct rebind { typedef AlignedAllocator<U,alignment> other; };
+
+    AlignedAllocator() = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U,alignment> &) {}
+
+    T *allocate(size_t n)
+    {
+      const size_t numBytes = (n*sizeof(T)+alignment-1)/alignment*alignment;
+#ifdef _WIN32
+      void *ptr = _aligned_malloc(numBytes,alignment);
+#else
+      void *ptr = std::aligned_alloc(alignment,numBytes);
+#endif
+      if (!ptr) throw std::bad_alloc();
+      return (T*)ptr;
+    }
+    void deallocate(T *ptr, size_t)
+    {
+#ifdef _WIN32
+      _aligned_free(ptr);
+#else
+      std::free(ptr);
+#endif
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U,alignment> &) const { return true; }
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U,alignment> &) const { return false; }
+  };
+
+  /*! the ways VertexArrays can store vertex positions and scalars */
+  typedef enum {
+    /*! one array each for x, y, z, and scalar; for kernels that
+        process many vertices at once (eg, one per SIMD lane) */
+    VERTEX_ARRAYS_SOA,
+    /*! one array of (x,y,z,scalar) vec4f's; for kernels that gather
+        all of an element's corners, which then takes a single
+        16-byte load per corner */
+    VERTEX_ARRAYS_PACKED
+  } VertexArraysLayout;
+
+  /*! a copy of a mesh's vertex positions, along with one per-vertex
+      scalar field, in a layout that is easier for vectorized kernels
+      to consume than UMesh's array of vec3f's plus separate
+      attribute arrays. All arrays are 64-byte aligned.
+
+      This is a copy, and does not get updated when the mesh changes;
+      it has to be re-created if the mesh's vertices or scalars do */
+  struct VertexArrays {
+    typedef std::shared_ptr<VertexArrays> SP;
+
+    /*! alignment (in bytes) of all arrays */
+    static const size_t alignment = 64;
+
+    template<typename T>
+    using Array = std::vector<T,AlignedAllocator<T,alignment>>;
+
+    /*! creates arrays of given layout, for given mesh's vertices and
+        given scalars; these default to the mesh's 'perVertex'. If
+        there are no scalars, they get set to NaN */
+    static VertexArrays::SP create(const UMesh &mesh,
+                                   VertexArraysLayout layout = VERTEX_ARRAYS_PACKED,
+                                   Attribute::SP scalars = nullptr);
+    /*! same as create(), for given quantized scalars, which get
+        dequantized into the arrays */
+    static VertexArrays::SP create(const UMesh &mesh,
+                                   VertexArraysLayout layout,
+                                   const QuantizedAttribute &scalars);
+
+    /*! position and scalar of given vertex, for either layout */
+    inline vec4f get(size_t vertexID) const
+    {
+      return (layout == VERTEX_ARRAYS_PACKED)
+        ? xyzs[vertexID]
+        : vec4f(x[vertexID],y[vertexID],z[vertexID],s[vertexID]);
+    }
+
+    inline size_t size() const { return numVertices; }
+    
+    VertexArraysLayout layout;
+    size_t             numVertices = 0;
+    /*! for VERTEX_ARRAYS_SOA layout, empty otherwise */
+    Array<float>       x, y, z, s;
+    /*! for VERTEX_ARRAYS_PACKED layout, empty otherwise */
+    Array<vec4f>       xyzs;
+  };
+  
+} // ::umesh
@@ -15,6 +15,12 @@
 // ======================================================================== //
 
 #include "umesh/check.h"
+#include "umesh/FaceConnKernels.h"
+#include "umesh/fixNegativeVolumes.h"
+#include "umesh/profile.h"
+#include <atomic>
+#include <memory>
+#include <sstream>
 
 namespace umesh {
 
@@ -33,145 +39,352 @@ namespace umesh {
 #endif
 
   
-#if UMESH_ENABLE_SANITY_CHECKS
-  /*! perform some sanity checking of the given mesh (checking indices
-    are valid, etc) */
-  void sanityCheck(UMesh::SP mesh, uint32_t flags)
+/*! block size for the parallel checks */
+  const size_t checkBlockSize = 64*1024;
+
+  inline const char *primTypeName(UMesh::PrimType type)
   {
-    if (!mesh) throw std::runtime_error("#check: null umesh");
-    if ((mesh->numVolumeElements() == 0)
-        &&
-        !(flags & CHECK_FLAG_MESH_IS_SURFACE)
-        )
-      std::cout <<"#check - WARNING: "
-                << "num volume elements in mesh is 0!?" << std::endl;
-    if (mesh->perVertex && mesh->perVertex->values.size() != mesh->vertices.size())
-      throw std::runtime_error("attribute size doesn't match vertex array size");
-    
-    for (auto p : mesh->tets) {
-      for (int i=0;i<p.numVertices;i++) {
-        if (p[i] < 0) {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-          throw std::runtime_error("#check: mesh has negative index!?");
-        }
-        if (p[i] >= mesh->vertices.size()) {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-          throw std::runtime_error("#check: mesh has index greater than vertex array size!?");
-        }
-      }
+    switch (type) {
+    case UMesh::TRI:   return "triangle";
+    case UMesh::QUAD:  return "quad";
+    case UMesh::TET:   return "tet";
+    case UMesh::PYR:   return "pyramid";
+    case UMesh::WEDGE: return "wedge";
+    case UMesh::HEX:   return "hex";
+    case UMesh::GRID:  return "grid";
+    default:           return "invalid";
     }
+  }
+  
+  // ==================================================================
+  // per-element checks
+  // ==================================================================
 
-    for (auto p : mesh->pyrs) {
-      for (int i=0;i<p.numVertices;i++) {
-        if (p[i] < 0) {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-          throw std::runtime_error("#check: mesh has negative index!?");
-        }
-        if (p[i] >= mesh->vertices.size()) {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-           throw std::runtime_error("#check: mesh has index greater than vertex array size!?");
+  /*! records one more element with given problem */
+  inline void found(CheckReport::Problem &problem,
+                    const UMesh::PrimRef &prim,
+                    size_t maxOffenders)
+  {
+    if (problem.offenders.size() < maxOffenders)
+      problem.offenders.push_back(prim);
+    problem.count++;
+  }
+
+  /*! appends the problems found in one block to those of all blocks
+      before it, so offenders stay in order of their IDs */
+  inline void merge(CheckReport::Problem &problem,
+                    const CheckReport::Problem &blockProblem,
+                    size_t maxOffenders)
+  {
+    problem.count += blockProblem.count;
+    for (auto prim : blockProblem.offenders)
+      if (problem.offenders.size() < maxOffenders)
+        problem.offenders.push_back(prim);
+  }
+
+  struct BlockProblems {
+    CheckReport::Problem invalidIndices, degenerate, negativeVolume;
+  };
+  
+  /*! checks all prims of one type for invalid indices, repeated
+      vertices, and (for those with neither) negative volume */
+  template<typename Prim>
+  void checkPrims(CheckReport &report,
+                  const UMesh &mesh,
+                  UMesh::PrimType type,
+                  const std::vector<Prim> &prims,
+                  size_t maxOffenders)
+  {
+    const int    N = Prim::numVertices;
+    const size_t numVertices = mesh.vertices.size();
+    const size_t numBlocks = divRoundUp(prims.size(),checkBlockSize);
+    std::vector<BlockProblems> blockProblems(numBlocks);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*checkBlockSize;
+        const size_t end   = std::min(begin+checkBlockSize,prims.size());
+        BlockProblems &problems = blockProblems[blockID];
+        for (size_t primID=begin;primID<end;primID++) {
+          const Prim &prim = prims[primID];
+          const UMesh::PrimRef primRef(type,primID);
+          bool valid = true;
+          for (int i=0;i<N;i++)
+            valid = valid && prim[i] >= 0 && size_t(prim[i]) < numVertices;
+          if (!valid) {
+            found(problems.invalidIndices,primRef,maxOffenders);
+            continue;
+          }
+          bool repeated = false;
+          for (int i=0;i<N;i++)
+            for (int j=0;j<i;j++)
+              repeated = repeated || (prim[i] == prim[j]);
+          if (repeated)
+            found(problems.degenerate,primRef,maxOffenders);
+          else if (hasNegativeVolume(mesh.vertices.data(),prim))
+            found(problems.negativeVolume,primRef,maxOffenders);
         }
-      }
+      });
+    for (auto &problems : blockProblems) {
+      merge(report.invalidIndices,problems.invalidIndices,maxOffenders);
+      merge(report.degenerate,problems.degenerate,maxOffenders);
+      merge(report.negativeVolume,problems.negativeVolume,maxOffenders);
     }
+  }
 
-    for (auto p : mesh->wedges) {
-      for (int i=0;i<p.numVertices;i++) {
-        if (p[i] < 0) {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-          throw std::runtime_error("#check: mesh has negative index!?");
-        }
-        if (p[i] >= mesh->vertices.size())  {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-          throw std::runtime_error("#check: mesh has index greater than vertex array size!?");
-        }
-      }
+  /*! grids only get checked for whether their scalars are all inside
+      the grid scalars array */
+  void checkGrids(CheckReport &report, const UMesh &mesh, size_t maxOffenders)
+  {
+    for (size_t gridID=0;gridID<mesh.grids.size();gridID++) {
+      const Grid &grid = mesh.grids[gridID];
+      if (grid.numCells.x <= 0 || grid.numCells.y <= 0 || grid.numCells.z <= 0 ||
+          grid.scalarsOffset < 0 ||
+          grid.scalarsOffset+grid.numScalars() > mesh.gridScalars.size())
+        found(report.invalidIndices,UMesh::PrimRef(UMesh::GRID,gridID),maxOffenders);
     }
+  }
 
-    for (auto p : mesh->hexes) {
-      for (int i=0;i<p.numVertices;i++) {
-        if (p[i] < 0)  {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-          throw std::runtime_error("#check: mesh has negative index!?");
-        }
-        if (p[i] >= mesh->vertices.size()) {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-           throw std::runtime_error("#check: mesh has index greater than vertex array size!?");
-        }
+  void checkAttributeSize(CheckReport &report,
+                          const std::string &what,
+                          size_t size,
+                          size_t expectedSize)
+  {
+    if (size == expectedSize) return;
+    report.attributeErrors.push_back
+      (what+" has "+std::to_string(size)+" values, but should have "
+       +std::to_string(expectedSize));
+  }
+  
+  void checkAttributes(CheckReport &report, const UMesh &mesh)
+  {
+    const size_t numVertices = mesh.vertices.size();
+    if (mesh.perVertex)
+      checkAttributeSize(report,"per-vertex scalar field",
+                         mesh.perVertex->values.size(),numVertices);
+    for (auto attribute : mesh.attributes)
+      if (attribute && attribute != mesh.perVertex)
+        checkAttributeSize(report,"vertex attribute '"+attribute->name+"'",
+                           attribute->values.size(),numVertices);
+    for (auto &it : mesh.elementAttributes) {
+      size_t numPrims = 0;
+      switch (it.first) {
+      case UMesh::TRI:   numPrims = mesh.triangles.size(); break;
+      case UMesh::QUAD:  numPrims = mesh.quads.size();     break;
+      case UMesh::TET:   numPrims = mesh.tets.size();      break;
+      case UMesh::PYR:   numPrims = mesh.pyrs.size();      break;
+      case UMesh::WEDGE: numPrims = mesh.wedges.size();    break;
+      case UMesh::HEX:   numPrims = mesh.hexes.size();     break;
+      case UMesh::GRID:  numPrims = mesh.grids.size();     break;
+      default: break;
       }
+      if (it.second)
+        checkAttributeSize(report,std::string(primTypeName(it.first))
+                           +" attribute '"+it.second->name+"'",
+                           it.second->values.size(),numPrims);
     }
+    if (!mesh.vertexTags.empty())
+      checkAttributeSize(report,"vertex tags",mesh.vertexTags.size(),numVertices);
+  }
 
-    for (auto p : mesh->triangles) {
-      for (int i=0;i<p.numVertices;i++) {
-        if (p[i] < 0)  {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-          throw std::runtime_error("#check: mesh has negative index!?");
-        }
-        if (p[i] >= mesh->vertices.size()) {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-           throw std::runtime_error("#check: mesh has index greater than vertex array size!?");
-        }
-      }
+  // ==================================================================
+  // face multiplicity
+  // ==================================================================
+
+  /*! concurrent open-addressing hash table that counts how many
+      facets of the mesh's volume elements map to each face, keyed by
+      the facets' unique-ordered vertex indices (the same way
+      FaceConn matches facets, but without keeping track of which
+      prims they belong to) */
+  struct FaceCountTable {
+    enum { EMPTY = -1, BUSY = -2 };
+    
+    struct Slot {
+      std::atomic<int> x;
+      int              y, z, w;
+      std::atomic<int> count;
+    };
+    
+    FaceCountTable(size_t capacity)
+      : capacity(capacity),
+        slots(new Slot[capacity])
+    {
+      parallel_for_blocked
+        (0,capacity,checkBlockSize,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++) {
+             slots[i].x.store(EMPTY,std::memory_order_relaxed);
+             slots[i].count.store(0,std::memory_order_relaxed);
+           }
+         });
     }
-      
-    for (auto p : mesh->quads) {
-      for (int i=0;i<p.numVertices;i++) {
-        if (p[i] < 0) {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-           throw std::runtime_error("#check: mesh has negative index!?");
-        }
-        if (p[i] >= mesh->vertices.size()) {
-          PRINT(mesh->vertices.size());
-          PRINT(p);
-           throw std::runtime_error("#check: mesh has index greater than vertex array size!?");
+
+    inline size_t homeSlot(const vec4i &idx) const
+    {
+      uint64_t h
+        = uint64_t(uint32_t(idx.x)) * 0x9e3779b97f4a7c15ull
+        ^ uint64_t(uint32_t(idx.y)) * 0xc2b2ae3d27d4eb4full
+        ^ uint64_t(uint32_t(idx.z)) * 0x165667b19e3779f9ull
+        ^ uint64_t(uint32_t(idx.w)) * 0x27d4eb2f165667c5ull;
+      h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+      h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+      h ^= h >> 33;
+#ifdef __SIZEOF_INT128__
+      return size_t(((unsigned __int128)h * capacity) >> 64);
+#else
+      return size_t(h % capacity);
+#endif
+    }
+
+    /*! counts one more facet for given face, and returns how many
+        facets that face has now. The table has more slots than there
+        are facets, so this always finds a slot */
+    int add(const vec4i &key)
+    {
+      size_t slot = homeSlot(key);
+      for (;;) {
+        Slot &s = slots[slot];
+        int x = s.x.load(std::memory_order_acquire);
+        if (x == EMPTY &&
+            s.x.compare_exchange_strong(x,BUSY,std::memory_order_acquire)) {
+          s.y = key.y;
+          s.z = key.z;
+          s.w = key.w;
+          s.x.store(key.x,std::memory_order_release);
+          return s.count.fetch_add(1,std::memory_order_relaxed)+1;
         }
+        while (x == BUSY)
+          x = s.x.load(std::memory_order_acquire);
+        if (x == key.x && s.y == key.y && s.z == key.z && s.w == key.w)
+          return s.count.fetch_add(1,std::memory_order_relaxed)+1;
+        slot = (slot+1 == capacity) ? 0 : slot+1;
       }
     }
 
-    // ok, let's go crazy here - create list of all tet faces, and
-    // check that none is used more than twice.
-    std::cout << "sanity checking for duplicate tri faces..." << std::flush;
-    std::map<vec3i,int> triFaceCounts;
-    for (auto p : mesh->tets) {
-      std::vector<vec3i> faces;
-      faces.push_back({p.x,p.y,p.z});
-      faces.push_back({p.x,p.y,p.w});
-      faces.push_back({p.x,p.z,p.w});
-      faces.push_back({p.y,p.z,p.w});
-      for (auto face : faces) {
-        std::sort(&face.x,&face.x+3);
-        triFaceCounts[face]++;
-        if (triFaceCounts[face] > 2)
-          throw std::runtime_error("tri face is used more than twice...");
-      }
+    const size_t            capacity;
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  /*! counts the faces that are shared by more than two volume
+      elements, and records the first of them (in table order) */
+  void checkFaces(CheckReport &report, const UMesh &mesh, size_t maxOffenders)
+  {
+    const InputMesh input = makeInputMesh(MeshView(mesh));
+    const size_t numPrims
+      = input.numTets + input.numPyrs + input.numWedges + input.numHexes;
+    const size_t numFacets
+      = 4 * input.numTets
+      + 5 * input.numPyrs
+      + 5 * input.numWedges
+      + 6 * input.numHexes;
+    if (numFacets == 0) return;
+
+    FaceCountTable table(numFacets + numFacets/4 + 1);
+    std::atomic<size_t> numOverused(0);
+    parallel_for_blocked
+      (0,numPrims,1024,
+       [&](size_t begin, size_t end) {
+         Facet facets[6];
+         size_t blockOverused = 0;
+         for (size_t primIdx=begin;primIdx<end;primIdx++) {
+           const int numFacets = writePrimFacets(facets,primIdx,input);
+           for (int i=0;i<numFacets;i++) {
+             computeUniqueVertexOrder(facets[i]);
+             if (facets[i].vertexIdx.x < 0) continue;
+             // count each overused face only once
+             if (table.add(facets[i].vertexIdx) == 3)
+               blockOverused++;
+           }
+         }
+         numOverused += blockOverused;
+       });
+    report.numOverusedFaces = numOverused;
+    if (numOverused == 0) return;
+
+    for (size_t i=0;i<table.capacity && report.overusedFaces.size() < maxOffenders;i++) {
+      const FaceCountTable::Slot &s = table.slots[i];
+      if (s.count.load() > 2)
+        report.overusedFaces.push_back(vec4i(s.x.load(),s.y,s.z,s.w));
     }
+  }
+
+  // ==================================================================
+  // the report
+  // ==================================================================
 
+  bool CheckReport::hasErrors() const
+  {
+    return invalidIndices.count > 0
+      || numOverusedFaces > 0
+      || !attributeErrors.empty();
+  }
 
-    for (auto p : mesh->pyrs) {
-      std::vector<vec3i> faces;
-      faces.push_back({p[0],p[1],p[4]});
-      faces.push_back({p[1],p[2],p[4]});
-      faces.push_back({p[2],p[3],p[4]});
-      faces.push_back({p[3],p[0],p[4]});
-      for (auto face : faces) {
-        std::sort(&face.x,&face.x+3);
-        triFaceCounts[face]++;
-        if (triFaceCounts[face] > 2)
-          throw std::runtime_error("tri face is used more than twice...");
+  std::string CheckReport::toString() const
+  {
+    std::stringstream ss;
+    auto printProblem = [&](const Problem &problem, const std::string &what) {
+      if (problem.count == 0) return;
+      ss << "#check: " << prettyNumber(problem.count) << " " << what;
+      if (!problem.offenders.empty()) {
+        ss << " (first:";
+        for (auto prim : problem.offenders)
+          ss << " " << primTypeName(UMesh::PrimType(prim.type)) << " " << size_t(prim.ID);
+        ss << ")";
       }
+      ss << std::endl;
+    };
+    for (auto &error : attributeErrors)
+      ss << "#check: ERROR: " << error << std::endl;
+    printProblem(invalidIndices,"ERROR: elements with invalid indices");
+    if (numOverusedFaces > 0) {
+      ss << "#check: ERROR: " << prettyNumber(numOverusedFaces)
+         << " faces used by more than two elements (first:";
+      for (auto face : overusedFaces)
+        ss << " " << face;
+      ss << ")" << std::endl;
     }
-    std::cout << " passed" << std::endl;
+    printProblem(degenerate,"WARNING: elements with repeated vertices");
+    printProblem(negativeVolume,"WARNING: elements with negative volume");
+    if (noVolumeElements)
+      ss << "#check: WARNING: num volume elements in mesh is 0!?" << std::endl;
+    if (ss.str().empty())
+      ss << "#check: no problems found" << std::endl;
+    return ss.str();
+  }
 
+  /*! checks given mesh for invalid indices, degenerate and inverted
+      elements, faces that are used by more than two elements, and
+      attribute arrays of the wrong size. Faces only get checked if
+      all indices are valid */
+  CheckReport checkMesh(UMesh::SP mesh, uint32_t flags, size_t maxOffenders)
+  {
+    if (!mesh) throw std::runtime_error("#check: null umesh");
+    profile::ScopedTimer timer("checkMesh",0,mesh->size());
+    CheckReport report;
+    report.noVolumeElements
+      =  (mesh->numVolumeElements() == 0)
+      && !(flags & CHECK_FLAG_MESH_IS_SURFACE);
+
+    checkAttributes(report,*mesh);
+    checkPrims(report,*mesh,UMesh::TRI,  mesh->triangles,maxOffenders);
+    checkPrims(report,*mesh,UMesh::QUAD, mesh->quads,    maxOffenders);
+    checkPrims(report,*mesh,UMesh::TET,  mesh->tets,     maxOffenders);
+    checkPrims(report,*mesh,UMesh::PYR,  mesh->pyrs,     maxOffenders);
+    checkPrims(report,*mesh,UMesh::WEDGE,mesh->wedges,   maxOffenders);
+    checkPrims(report,*mesh,UMesh::HEX,  mesh->hexes,    maxOffenders);
+    checkGrids(report,*mesh,maxOffenders);
+    if (report.invalidIndices.count == 0)
+      checkFaces(report,*mesh,maxOffenders);
+    return report;
+  }
+  
+#if UMESH_ENABLE_SANITY_CHECKS
+  /*! perform some sanity checking of the given mesh (checking indices
+    are valid, etc) */
+  void sanityCheck(UMesh::SP mesh, uint32_t flags)
+  {
+    CheckReport report = checkMesh(mesh,flags);
+    std::cout << report.toString();
+    if (report.hasErrors())
+      throw std::runtime_error("#check: mesh failed sanity check");
   }
 #endif
   
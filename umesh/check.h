@@ -27,9 +27,59 @@ namespace umesh {
   /* if specified, the sanity checker will ignore 'no volume prims' */
 #define CHECK_FLAG_MESH_IS_SURFACE (1<<0)
 
+  /*! result of checkMesh(): for each kind of problem, how many
+      elements have it, and (up to a given number of) the first ones
+      that do. Invalid indices, overused faces, and attribute arrays
+      of the wrong size are errors; degenerate and negative-volume
+      elements are not (many meshes have some), but get reported */
+  struct CheckReport {
+    /*! one kind of problem, and (in order of type and ID) the first
+        elements that have it */
+    struct Problem {
+      size_t count = 0;
+      std::vector<UMesh::PrimRef> offenders;
+    };
+
+    /*! whether there are any errors (warnings do not count) */
+    bool hasErrors() const;
+    /*! returns a (multi-line) human-readable summary of all problems
+        found; or "no problems found" */
+    std::string toString() const;
+
+    /*! elements with vertex indices outside the vertex array (or, for
+        grids, with scalars outside the grid scalars array) */
+    Problem invalidIndices;
+    /*! elements that use the same vertex multiple times */
+    Problem degenerate;
+    /*! volume elements whose vertices are in inside-out order */
+    Problem negativeVolume;
+    /*! number of faces shared by more than two volume elements, and
+        the first of those faces */
+    size_t             numOverusedFaces = 0;
+    std::vector<vec4i> overusedFaces;
+    /*! one entry per attribute (or tag) array whose size does not
+        match that of what it is attached to */
+    std::vector<std::string> attributeErrors;
+    /*! whether the mesh has no volume elements (only a warning, and
+        only if the check was not told the mesh is a surface) */
+    bool noVolumeElements = false;
+  };
+
+  /*! checks given mesh for invalid indices, degenerate and inverted
+      elements, faces that are used by more than two elements, and
+      attribute arrays of the wrong size; all in parallel. Rather
+      than stopping at the first problem, this returns counts of all
+      problems found, plus up to 'maxOffenders' offending elements
+      (or faces) per kind of problem. Unlike sanityCheck() this is
+      available in all builds */
+  CheckReport checkMesh(UMesh::SP umesh,
+                        uint32_t flags = 0,
+                        size_t maxOffenders = 10);
+
 #if UMESH_ENABLE_SANITY_CHECKS
   /*! perform some sanity checking of the given mesh (checking indices
-    are valid, etc) */
+    are valid, etc) through checkMesh(), and throw if that found any
+    errors */
   void sanityCheck(UMesh::SP umesh, uint32_t flags = 0);
 #else
   inline void sanityCheck(UMesh::SP umesh, uint32_t flags = 0)
@@ -0,0 +1,158 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "umesh/computeNormals.h"
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/profile.h"
+#include <atomic>
+#include <limits>
+
+namespace umesh {
+
+  const char *normalAttributeNames[3] = { "normal.x", "normal.y", "normal.z" };
+
+  /*! block size for the parallel loops over faces, corners, and
+      vertices */
+  const size_t normalsBlockSize = 16*1024;
+  
+  std::vector<vec3f> computeVertexNormals(const UMesh &mesh)
+  {
+    profile::ScopedTimer timer("normals.compute");
+    const size_t numVertices   = mesh.vertices.size();
+    const size_t numTris       = mesh.triangles.size();
+    const size_t numQuads      = mesh.quads.size();
+    const size_t numFaces      = numTris+numQuads;
+    const size_t numTriCorners = 3*numTris;
+    const size_t numCorners    = numTriCorners+4*numQuads;
+    if (numCorners > size_t(std::numeric_limits<uint32_t>::max())
+        || numVertices >= size_t(std::numeric_limits<uint32_t>::max()))
+      throw std::runtime_error("#umesh.normals: mesh too large for 32-bit corner IDs");
+    timer.addItems(numFaces);
+
+    // all triangles' corners first, then all quads'
+    const int *triIndices  = (const int *)mesh.triangles.data();
+    const int *quadIndices = (const int *)mesh.quads.data();
+    auto vertexOf = [&](uint32_t corner) -> uint32_t {
+      return uint32_t(corner < numTriCorners
+                      ? triIndices[corner]
+                      : quadIndices[corner-numTriCorners]);
+    };
+    auto faceOf = [&](uint32_t corner) -> size_t {
+      return corner < numTriCorners
+        ? size_t(corner/3)
+        : numTris+(corner-numTriCorners)/4;
+    };
+    
+    // each face's normal, scaled by its area
+    ScratchBuffer<vec3f> faceNormals(numFaces);
+    std::atomic<bool> invalid(false);
+    parallel_for_blocked
+      (0,numFaces,normalsBlockSize,
+       [&](size_t begin, size_t end) {
+         bool blockInvalid = false;
+         for (size_t faceID=begin;faceID<end;faceID++) {
+           const int  numCornersOfFace = faceID < numTris ? 3 : 4;
+           const int *idx = faceID < numTris
+             ? triIndices+3*faceID
+             : quadIndices+4*(faceID-numTris);
+           bool valid = true;
+           for (int i=0;i<numCornersOfFace;i++)
+             valid &= (idx[i] >= 0 && size_t(idx[i]) < numVertices);
+           if (!valid) {
+             blockInvalid = true;
+             continue;
+           }
+           const vec3f v0 = mesh.vertices[idx[0]];
+           const vec3f v1 = mesh.vertices[idx[1]];
+           const vec3f v2 = mesh.vertices[idx[2]];
+           faceNormals[faceID]
+             = (numCornersOfFace == 3)
+             ? .5f*cross(v1-v0,v2-v0)
+             // (the vector area of a - possibly non-planar - quad)
+             : .5f*cross(v2-v0,mesh.vertices[idx[3]]-v1);
+         }
+         if (blockInvalid) invalid = true;
+       });
+    if (invalid)
+      throw std::runtime_error("#umesh.normals: mesh has invalid vertex indices");
+
+    // the CSR: all corners, (stably) sorted by vertex, and where each
+    // vertex' corners begin in that list
+    ScratchBuffer<uint32_t> corners(numCorners);
+    parallel_for_blocked
+      (0,numCorners,normalsBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           corners[i] = uint32_t(i);
+       });
+    parallel_radix_sort(corners.data(),numCorners,vertexOf);
+    ScratchBuffer<uint32_t> cornersBegin(numVertices+1);
+    parallel_for_blocked
+      (0,numCorners+1,normalsBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++) {
+           // all vertices in (prev,next] begin at corner 'i'
+           const int64_t prev = (i == 0) ? -1 : int64_t(vertexOf(corners[i-1]));
+           const int64_t next
+             = (i == numCorners) ? int64_t(numVertices) : int64_t(vertexOf(corners[i]));
+           for (int64_t v=prev+1;v<=next;v++)
+             cornersBegin[v] = uint32_t(i);
+         }
+       });
+
+    std::vector<vec3f> normals(numVertices);
+    parallel_for_blocked
+      (0,numVertices,normalsBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t v=begin;v<end;v++) {
+           vec3f sum(0.f);
+           for (uint32_t i=cornersBegin[v];i<cornersBegin[v+1];i++)
+             sum = sum + faceNormals[faceOf(corners[i])];
+           const float len2 = dot(sum,sum);
+           normals[v] = (len2 > 0.f) ? sum*(1.f/sqrtf(len2)) : vec3f(0.f);
+         }
+       });
+    return normals;
+  }
+
+  void addNormalAttributes(UMesh &mesh, const std::vector<vec3f> &normals)
+  {
+    if (normals.size() != mesh.vertices.size())
+      throw std::runtime_error("#umesh.normals: number of normals does not match "
+                               "number of vertices");
+    for (int axis=0;axis<3;axis++) {
+      Attribute::SP attr;
+      for (auto existing : mesh.attributes)
+        if (existing->name == normalAttributeNames[axis]) attr = existing;
+      if (!attr) {
+        attr = std::make_shared<Attribute>();
+        attr->name = normalAttributeNames[axis];
+        mesh.attributes.push_back(attr);
+      }
+      attr->values.resize(normals.size());
+      parallel_for_blocked
+        (0,normals.size(),normalsBlockSize,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++)
+             attr->values[i] = normals[i][axis];
+         });
+      attr->stats = nullptr;
+      attr->finalize();
+    }
+  }
+  
+} // ::umesh
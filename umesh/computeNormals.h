@@ -0,0 +1,54 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! names of the three per-vertex attributes that
+      addNormalAttributes() stores the normals' x, y, and z
+      components in */
+  extern const char *normalAttributeNames[3];
+
+  /*! computes area-weighted per-vertex normals of given mesh's
+      surface elements (triangles and quads; volume elements get
+      ignored): each vertex' normal is the normalized sum of the
+      normals of all faces that use it, each scaled by its face's
+      area, and oriented by the face's winding order. Vertices that
+      are not used by any face (or only by faces of zero area) get
+      (0,0,0).
+
+      Rather than scattering each face's normal to its vertices
+      (which would need atomics), this builds a vertex-to-face CSR -
+      by radix-sorting all face corners by their vertex - and then
+      gathers each vertex' face normals, in parallel over the
+      vertices. Each vertex' faces get summed up in face order, so
+      the result does not depend on the number of threads */
+  std::vector<vec3f> computeVertexNormals(const UMesh &mesh);
+
+  /*! stores given per-vertex normals in given mesh, as three
+      per-vertex attributes named 'normalAttributeNames', which
+      replace any existing ones of those names; other attributes
+      (and the perVertex one) remain unchanged. Note that when a
+      mesh without any other per-vertex attributes gets saved and
+      loaded again, the normals' x component becomes its
+      perVertex */
+  void addNormalAttributes(UMesh &mesh, const std::vector<vec3f> &normals);
+  
+} // ::umesh
@@ -0,0 +1,711 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "umesh/decimate.h"
+#include "umesh/parallel_radix_sort.h"
+#include <algorithm>
+#include <atomic>
+
+namespace umesh {
+
+  /*! block size for all parallel loops */
+  const size_t decimateBlockSize = 16*1024;
+  /*! how often each round picks more edges to collapse, before the
+      mesh's topology gets updated */
+  const int selectionPassesPerRound = 8;
+
+  /*! parallel, order-preserving stream compaction: counts the items
+      in [0,numItems) for which 'keep(i)' is true, calls
+      'allocate(numKept)', and then (in parallel) 'emit(i,outID)' for
+      each kept item, with outIDs consecutive in the order of the
+      items. Returns the number of kept items */
+  template<typename Keep, typename Allocate, typename Emit>
+  size_t compact(size_t numItems,
+                 const Keep &keep,
+                 const Allocate &allocate,
+                 const Emit &emit)
+  {
+    const size_t numBlocks = divRoundUp(numItems,decimateBlockSize);
+    std::vector<size_t> blockBegin(numBlocks+1,0);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*decimateBlockSize;
+        const size_t end   = std::min(begin+decimateBlockSize,numItems);
+        size_t count = 0;
+        for (size_t i=begin;i<end;i++)
+          if (keep(i)) count++;
+        blockBegin[blockID+1] = count;
+      });
+    for (size_t blockID=0;blockID<numBlocks;blockID++)
+      blockBegin[blockID+1] += blockBegin[blockID];
+    allocate(blockBegin[numBlocks]);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*decimateBlockSize;
+        const size_t end   = std::min(begin+decimateBlockSize,numItems);
+        size_t outID = blockBegin[blockID];
+        for (size_t i=begin;i<end;i++)
+          if (keep(i)) emit(i,outID++);
+      });
+    return blockBegin[numBlocks];
+  }
+
+  inline void atomicMin(std::atomic<uint64_t> &value, uint64_t candidate)
+  {
+    uint64_t current = value.load(std::memory_order_relaxed);
+    while (candidate < current
+           && !value.compare_exchange_weak(current,candidate,
+                                           std::memory_order_relaxed));
+  }
+
+  /*! a bijective hash of an edge ID. Edges with the same cost (which,
+      on flat or regular regions, can be most of them) get ordered by
+      this, rather than by ID - which, if neighboring edges have
+      consecutive IDs, would only let very few of them be the
+      cheapest within their 2-ring */
+  inline uint32_t scrambleEdgeID(uint32_t e)
+  {
+    e *= 0x9E3779B1u;
+    e ^= e >> 16;
+    e *= 0x85EBCA6Bu;
+    e ^= e >> 13;
+    return e;
+  }
+
+  /*! symmetric 4x4 matrix of a quadric error metric: Q(v) = v^T Q v
+      is the (weighted) sum of squared distances of v to a set of
+      planes */
+  struct Quadric {
+    Quadric() = default;
+
+    /*! 'weight' times the squared distance to the plane
+        n.x+d=0, for unit-length n */
+    Quadric(double nx, double ny, double nz, double d, double weight)
+      : a2(weight*nx*nx), ab(weight*nx*ny), ac(weight*nx*nz), ad(weight*nx*d),
+        b2(weight*ny*ny), bc(weight*ny*nz), bd(weight*ny*d),
+        c2(weight*nz*nz), cd(weight*nz*d),
+        d2(weight*d*d)
+    {}
+
+    inline Quadric &operator+=(const Quadric &o)
+    {
+      a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+      b2 += o.b2; bc += o.bc; bd += o.bd;
+      c2 += o.c2; cd += o.cd;
+      d2 += o.d2;
+      return *this;
+    }
+
+    /*! u^T Q v, for homogeneous (4-component) u and v */
+    inline double eval(const double *u, const double *v) const
+    {
+      return
+        u[0]*(a2*v[0]+ab*v[1]+ac*v[2]+ad*v[3]) +
+        u[1]*(ab*v[0]+b2*v[1]+bc*v[2]+bd*v[3]) +
+        u[2]*(ac*v[0]+bc*v[1]+c2*v[2]+cd*v[3]) +
+        u[3]*(ad*v[0]+bd*v[1]+cd*v[2]+d2*v[3]);
+    }
+
+    double a2=0, ab=0, ac=0, ad=0, b2=0, bc=0, bd=0, c2=0, cd=0, d2=0;
+  };
+
+  /*! quadric of the plane through given unit normal and point */
+  inline Quadric planeQuadric(const vec3f &n, const vec3f &p, double weight)
+  {
+    return Quadric(n.x,n.y,n.z,-(double(n.x)*p.x+double(n.y)*p.y+double(n.z)*p.z),
+                   weight);
+  }
+
+  /*! a (unique) edge of the current mesh, with v0 < v1 */
+  struct Edge {
+    int      v0, v1;
+    /*! number of triangles that share this edge */
+    uint32_t numTris;
+  };
+
+  /*! per-vertex flags; vertices on non-manifold edges, or where
+      multiple fans of triangles meet, are LOCKED, and never get
+      collapsed */
+  enum { BOUNDARY = 1, LOCKED = 2 };
+
+  /*! the state of one decimate() */
+  struct Decimator {
+    Decimator(UMesh::SP mesh, const DecimateOptions &options);
+
+    /*! one round of (independent, parallel) edge collapses; returns
+        the number of edges collapsed */
+    size_t collapseRound(size_t targetTriangles);
+
+    UMesh::SP getResult(UMesh::SP input) const;
+
+  private:
+    /*! computes all per-round topology - vertex-to-triangle lists,
+        per-vertex flags, and edges - from the current triangles */
+    void buildTopology();
+    /*! initial quadrics of all vertices */
+    void computeQuadrics();
+    /*! calls 'lambda(otherVertex,numSharedTris,someSharedTri)' for
+        each edge of given vertex, in order of the other vertex;
+        'scratch' is a per-thread scratch buffer */
+    template<typename Lambda>
+    void forEachEdgeOf(int vertexID,
+                       std::vector<std::pair<int,uint32_t>> &scratch,
+                       const Lambda &lambda) const;
+    /*! checks whether the triangles of given vertex form a single
+        fan - ie, are all connected through edges of that vertex -
+        rather than multiple fans that only share the vertex; needs
+        the vertex's (sorted) edges as computed by forEachEdgeOf() */
+    bool isSingleFan(int vertexID,
+                     const std::vector<std::pair<int,uint32_t>> &edgesOfVertex,
+                     std::vector<int> &scratch) const;
+    /*! returns where collapsing given edge would put its first
+        vertex (as parameter along the edge), and at which cost */
+    double collapseCost(const Edge &edge, float &t) const;
+    /*! checks whether collapsing given edge to given point along it
+        would flip any triangles, or change the topology */
+    bool canCollapse(const Edge &edge, float t) const;
+
+    const DecimateOptions options;
+    std::vector<vec3f>               positions;
+    /*! the values of all per-vertex attributes */
+    std::vector<std::vector<float>>  attributes;
+    std::vector<vec3i>               triangles;
+    std::vector<Quadric>             quadrics;
+
+    std::vector<size_t>              vertexTrisBegin;
+    std::vector<uint32_t>            vertexTris;
+    std::vector<uint8_t>             flags;
+    std::vector<Edge>                edges;
+  };
+
+  /*! the attributes decimate() carries over: all of the mesh's
+      per-vertex attributes, plus its perVertex one if that's not
+      among those */
+  std::vector<Attribute::SP> vertexAttributesOf(UMesh::SP mesh)
+  {
+    std::vector<Attribute::SP> result = mesh->attributes;
+    if (mesh->perVertex
+        && std::find(result.begin(),result.end(),mesh->perVertex) == result.end())
+      result.push_back(mesh->perVertex);
+    return result;
+  }
+
+  Decimator::Decimator(UMesh::SP mesh, const DecimateOptions &options)
+    : options(options),
+      positions(mesh->vertices)
+  {
+    for (auto attr : vertexAttributesOf(mesh)) {
+      if (attr->values.size() != mesh->vertices.size())
+        throw std::runtime_error("#umesh.decimate: attribute '"+attr->name
+                                 +"' does not have one value per vertex");
+      attributes.push_back(attr->values);
+    }
+
+    // triangles, and quads split into two triangles each; drop
+    // anything degenerate right away
+    std::vector<vec3i> input;
+    for (auto &tri : mesh->triangles)
+      input.push_back(vec3i(tri.x,tri.y,tri.z));
+    for (auto &quad : mesh->quads) {
+      input.push_back(vec3i(quad.x,quad.y,quad.z));
+      input.push_back(vec3i(quad.x,quad.z,quad.w));
+    }
+    compact(input.size(),
+            [&](size_t i) {
+              const vec3i t = input[i];
+              return t.x != t.y && t.y != t.z && t.z != t.x;
+            },
+            [&](size_t numTris) { triangles.resize(numTris); },
+            [&](size_t i, size_t outID) { triangles[outID] = input[i]; });
+  }
+
+  template<typename Lambda>
+  void Decimator::forEachEdgeOf(int vertexID,
+                                std::vector<std::pair<int,uint32_t>> &scratch,
+                                const Lambda &lambda) const
+  {
+    scratch.clear();
+    for (size_t i=vertexTrisBegin[vertexID];i<vertexTrisBegin[vertexID+1];i++) {
+      const uint32_t triID = vertexTris[i];
+      const vec3i tri = triangles[triID];
+      for (int j=0;j<3;j++)
+        if (tri[j] != vertexID) scratch.push_back({tri[j],triID});
+    }
+    std::sort(scratch.begin(),scratch.end());
+    for (size_t i=0;i<scratch.size();) {
+      size_t end = i+1;
+      while (end < scratch.size() && scratch[end].first == scratch[i].first)
+        end++;
+      lambda(scratch[i].first,uint32_t(end-i),scratch[i].second);
+      i = end;
+    }
+  }
+
+  bool Decimator::isSingleFan(int vertexID,
+                              const std::vector<std::pair<int,uint32_t>> &edgesOfVertex,
+                              std::vector<int> &parent) const
+  {
+    const size_t begin   = vertexTrisBegin[vertexID];
+    const size_t numTris = vertexTrisBegin[vertexID+1]-begin;
+    parent.resize(numTris);
+    for (size_t i=0;i<numTris;i++) parent[i] = (int)i;
+    auto find = [&](int i) {
+      while (parent[i] != i) i = parent[i] = parent[parent[i]];
+      return i;
+    };
+    auto local = [&](uint32_t triID) {
+      return int(std::lower_bound(vertexTris.begin()+begin,
+                                  vertexTris.begin()+begin+numTris,triID)
+                 -(vertexTris.begin()+begin));
+    };
+    size_t numFans = numTris;
+    // triangles that share an edge are in the same fan
+    for (size_t i=1;i<edgesOfVertex.size();i++) {
+      if (edgesOfVertex[i].first != edgesOfVertex[i-1].first) continue;
+      const int x = find(local(edgesOfVertex[i-1].second));
+      const int y = find(local(edgesOfVertex[i].second));
+      if (x != y) { parent[x] = y; numFans--; }
+    }
+    return numFans <= 1;
+  }
+
+  void Decimator::buildTopology()
+  {
+    const size_t numVertices = positions.size();
+
+    // vertex-to-triangle lists
+    vertexTrisBegin.resize(numVertices+1);
+    {
+      std::unique_ptr<std::atomic<uint32_t>[]>
+        count(new std::atomic<uint32_t>[numVertices]);
+      parallel_for_blocked(0,numVertices,decimateBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) count[i] = 0;
+        });
+      parallel_for_blocked(0,triangles.size(),decimateBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            for (int j=0;j<3;j++)
+              count[triangles[i][j]]++;
+        });
+      size_t sum = 0;
+      for (size_t i=0;i<numVertices;i++) {
+        vertexTrisBegin[i] = sum;
+        sum += count[i];
+        // reuse as fill cursor, relative to the list's begin
+        count[i] = 0;
+      }
+      vertexTrisBegin[numVertices] = sum;
+      vertexTris.resize(sum);
+      parallel_for_blocked(0,triangles.size(),decimateBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            for (int j=0;j<3;j++) {
+              const int v = triangles[i][j];
+              vertexTris[vertexTrisBegin[v]+count[v]++] = (uint32_t)i;
+            }
+        });
+      parallel_for_blocked(0,numVertices,decimateBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            std::sort(vertexTris.begin()+vertexTrisBegin[i],
+                      vertexTris.begin()+vertexTrisBegin[i+1]);
+        });
+    }
+
+    // per-vertex flags, and each vertex's edges to higher-numbered
+    // vertices
+    flags.resize(numVertices);
+    std::vector<size_t> edgesBegin(numVertices+1,0);
+    parallel_for_blocked(0,numVertices,decimateBlockSize,[&](size_t begin, size_t end){
+        std::vector<std::pair<int,uint32_t>> scratch;
+        std::vector<int> fan;
+        for (size_t v=begin;v<end;v++) {
+          uint8_t vertexFlags = 0;
+          size_t numEdges = 0;
+          forEachEdgeOf((int)v,scratch,[&](int other, uint32_t numTris, uint32_t){
+              if (numTris == 1) vertexFlags |= BOUNDARY;
+              if (numTris > 2)  vertexFlags |= LOCKED;
+              if (other > (int)v) numEdges++;
+            });
+          if (!isSingleFan((int)v,scratch,fan))
+            vertexFlags |= LOCKED;
+          flags[v] = vertexFlags;
+          edgesBegin[v+1] = numEdges;
+        }
+      });
+    for (size_t i=0;i<numVertices;i++)
+      edgesBegin[i+1] += edgesBegin[i];
+    edges.resize(edgesBegin[numVertices]);
+    if (edges.size() >= (size_t(1)<<32))
+      throw std::runtime_error("#umesh.decimate: too many edges");
+    parallel_for_blocked(0,numVertices,decimateBlockSize,[&](size_t begin, size_t end){
+        std::vector<std::pair<int,uint32_t>> scratch;
+        for (size_t v=begin;v<end;v++) {
+          size_t edgeID = edgesBegin[v];
+          forEachEdgeOf((int)v,scratch,[&](int other, uint32_t numTris, uint32_t){
+              if (other > (int)v) edges[edgeID++] = { (int)v, other, numTris };
+            });
+        }
+      });
+  }
+
+  void Decimator::computeQuadrics()
+  {
+    quadrics.resize(positions.size());
+    const double boundaryWeight = options.boundaryWeight;
+    parallel_for_blocked(0,positions.size(),decimateBlockSize,[&](size_t begin, size_t end){
+        std::vector<std::pair<int,uint32_t>> scratch;
+        for (size_t v=begin;v<end;v++) {
+          Quadric Q;
+          // planes of all triangles, weighted by their area ...
+          for (size_t i=vertexTrisBegin[v];i<vertexTrisBegin[v+1];i++) {
+            const vec3i tri = triangles[vertexTris[i]];
+            const vec3f n = cross(positions[tri.y]-positions[tri.x],
+                                  positions[tri.z]-positions[tri.x]);
+            const float len = length(n);
+            if (len == 0.f) continue;
+            Q += planeQuadric(n*(1.f/len),positions[tri.x],.5*len);
+          }
+          // ... plus, for each boundary edge, a plane through the
+          // edge that's perpendicular to its triangle
+          forEachEdgeOf((int)v,scratch,[&](int other, uint32_t numTris, uint32_t triID){
+              if (numTris != 1) return;
+              const vec3i tri = triangles[triID];
+              const vec3f e = positions[other]-positions[v];
+              const vec3f n = cross(positions[tri.y]-positions[tri.x],
+                                    positions[tri.z]-positions[tri.x]);
+              const vec3f perp = cross(e,n);
+              const float len = length(perp);
+              if (len == 0.f) return;
+              Q += planeQuadric(perp*(1.f/len),positions[v],
+                                boundaryWeight*dot(e,e));
+            });
+          quadrics[v] = Q;
+        }
+      });
+  }
+
+  double Decimator::collapseCost(const Edge &edge, float &t) const
+  {
+    Quadric Q = quadrics[edge.v0];
+    Q += quadrics[edge.v1];
+    const vec3f a = positions[edge.v0];
+    const vec3f b = positions[edge.v1];
+    // Q(a+t*(b-a)) = A*t^2 + 2*B*t + C
+    const double p[4] = { a.x, a.y, a.z, 1. };
+    const double d[4] = { double(b.x)-a.x, double(b.y)-a.y, double(b.z)-a.z, 0. };
+    const double A = Q.eval(d,d);
+    const double B = Q.eval(d,p);
+    const double C = Q.eval(p,p);
+    double tMin;
+    if (A > 0.)
+      tMin = std::min(1.,std::max(0.,-B/A));
+    else
+      tMin = (A+2.*B < 0.) ? 1. : 0.;
+    t = float(tMin);
+    return std::max(0.,(A*tMin+2.*B)*tMin+C);
+  }
+
+  bool Decimator::canCollapse(const Edge &edge, float t) const
+  {
+    const int a = edge.v0, b = edge.v1;
+    const vec3f p = (1.f-t)*positions[a]+t*positions[b];
+
+    std::vector<int> neighborsOfA, neighborsOfB;
+    uint32_t numShared = 0;
+    for (int k=0;k<2;k++) {
+      const int v = k ? b : a;
+      std::vector<int> &neighbors = k ? neighborsOfB : neighborsOfA;
+      for (size_t i=vertexTrisBegin[v];i<vertexTrisBegin[v+1];i++) {
+        const vec3i tri = triangles[vertexTris[i]];
+        const bool hasA = tri.x == a || tri.y == a || tri.z == a;
+        const bool hasB = tri.x == b || tri.y == b || tri.z == b;
+        for (int j=0;j<3;j++)
+          if (tri[j] != a && tri[j] != b) neighbors.push_back(tri[j]);
+        if (hasA && hasB) {
+          // shared triangles get removed; count them only once
+          if (k == 0) numShared++;
+          continue;
+        }
+        // make sure the triangle doesn't flip
+        const vec3f oldN = cross(positions[tri.y]-positions[tri.x],
+                                 positions[tri.z]-positions[tri.x]);
+        vec3f q[3];
+        for (int j=0;j<3;j++)
+          q[j] = (tri[j] == a || tri[j] == b) ? p : positions[tri[j]];
+        const vec3f newN = cross(q[1]-q[0],q[2]-q[0]);
+        if (dot(oldN,newN) < 0.f) return false;
+        if (dot(newN,newN) == 0.f && dot(oldN,oldN) > 0.f) return false;
+      }
+      std::sort(neighbors.begin(),neighbors.end());
+      neighbors.erase(std::unique(neighbors.begin(),neighbors.end()),neighbors.end());
+    }
+    if (numShared != edge.numTris) return false;
+    // don't remove isolated triangles, or the last triangle of any
+    // of the shared triangles' opposite vertices (which would make
+    // those vertices disappear)
+    const size_t numTrisOfA = vertexTrisBegin[a+1]-vertexTrisBegin[a];
+    const size_t numTrisOfB = vertexTrisBegin[b+1]-vertexTrisBegin[b];
+    if (numTrisOfA+numTrisOfB == 2*numShared) return false;
+    for (size_t i=vertexTrisBegin[a];i<vertexTrisBegin[a+1];i++) {
+      const vec3i tri = triangles[vertexTris[i]];
+      for (int j=0;j<3;j++)
+        if (tri[j] != a && tri[j] != b
+            && vertexTrisBegin[tri[j]+1]-vertexTrisBegin[tri[j]] == 1)
+          return false;
+    }
+
+    // link condition: the only vertices that a and b have in common
+    // are the opposite vertices of their shared triangles
+    std::vector<int> common;
+    std::set_intersection(neighborsOfA.begin(),neighborsOfA.end(),
+                          neighborsOfB.begin(),neighborsOfB.end(),
+                          std::back_inserter(common));
+    return common.size() == numShared;
+  }
+
+  size_t Decimator::collapseRound(size_t targetTriangles)
+  {
+    if (triangles.size() <= targetTriangles) return 0;
+    buildTopology();
+    if (quadrics.empty())
+      computeQuadrics();
+    const size_t numVertices = positions.size();
+    const size_t numEdges    = edges.size();
+
+    // ------------------------------------------------------------------
+    // cost of each edge that may get collapsed at all, as a (unique)
+    // key that sorts by cost, with ties broken pseudo-randomly
+    // ------------------------------------------------------------------
+    const uint64_t invalidKey = ~uint64_t(0);
+    std::vector<uint64_t> key(numEdges);
+    std::vector<float>    collapseT(numEdges);
+    parallel_for_blocked(0,numEdges,decimateBlockSize,[&](size_t begin, size_t end){
+        for (size_t e=begin;e<end;e++) {
+          const Edge &edge = edges[e];
+          const uint8_t fa = flags[edge.v0], fb = flags[edge.v1];
+          const bool collapsible
+            =  edge.numTris <= 2
+            && !((fa|fb) & LOCKED)
+            // an interior edge between two boundary vertices would
+            // pinch the surface
+            && !(edge.numTris == 2 && (fa & BOUNDARY) && (fb & BOUNDARY));
+          if (!collapsible) { key[e] = invalidKey; continue; }
+          const float cost = float(collapseCost(edge,collapseT[e]));
+          key[e] = (uint64_t(radixKey(cost)) << 32) | scrambleEdgeID(uint32_t(e));
+        }
+      });
+
+    // ------------------------------------------------------------------
+    // an edge gets collapsed if it's the cheapest of all edges within
+    // the 2-ring of both its vertices; no two such edges can touch
+    // the same triangle, or even neighboring vertices. Since that
+    // only picks few edges at a time, we repeat this a few times,
+    // each time only among the edges whose vertices are neither part
+    // of, nor neighbors of, any already picked collapse
+    // ------------------------------------------------------------------
+    std::unique_ptr<std::atomic<uint64_t>[]> minOfRing(new std::atomic<uint64_t>[numVertices]);
+    std::unique_ptr<std::atomic<uint64_t>[]> minOf2Ring(new std::atomic<uint64_t>[numVertices]);
+    std::unique_ptr<std::atomic<uint8_t>[]>  blocked(new std::atomic<uint8_t>[numVertices]);
+    parallel_for_blocked(0,numVertices,decimateBlockSize,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) blocked[i] = 0;
+      });
+    auto eligible = [&](size_t e) {
+      return key[e] != invalidKey && !blocked[edges[e].v0] && !blocked[edges[e].v1];
+    };
+    std::vector<uint32_t> collapses;
+    std::vector<uint8_t>  accept(numEdges,0);
+    std::atomic<size_t>   numRemovedCounter(0);
+    size_t numRemoved = 0;
+    for (int pass=0;pass<selectionPassesPerRound;pass++) {
+      parallel_for_blocked(0,numVertices,decimateBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) minOfRing[i] = invalidKey;
+        });
+      parallel_for_blocked(0,numEdges,decimateBlockSize,[&](size_t begin, size_t end){
+          for (size_t e=begin;e<end;e++) {
+            if (!eligible(e)) continue;
+            atomicMin(minOfRing[edges[e].v0],key[e]);
+            atomicMin(minOfRing[edges[e].v1],key[e]);
+          }
+        });
+      parallel_for_blocked(0,numVertices,decimateBlockSize,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) minOf2Ring[i] = minOfRing[i].load();
+        });
+      parallel_for_blocked(0,numEdges,decimateBlockSize,[&](size_t begin, size_t end){
+          for (size_t e=begin;e<end;e++) {
+            atomicMin(minOf2Ring[edges[e].v0],minOfRing[edges[e].v1]);
+            atomicMin(minOf2Ring[edges[e].v1],minOfRing[edges[e].v0]);
+          }
+        });
+      parallel_for_blocked(0,numEdges,decimateBlockSize,[&](size_t begin, size_t end){
+          for (size_t e=begin;e<end;e++) {
+            accept[e] = 0;
+            if (!eligible(e)
+                || key[e] != minOf2Ring[edges[e].v0]
+                || key[e] != minOf2Ring[edges[e].v1])
+              continue;
+            if (canCollapse(edges[e],collapseT[e]))
+              accept[e] = 1;
+            else
+              // don't try again in this round
+              key[e] = invalidKey;
+          }
+        });
+      const size_t numBefore = collapses.size();
+      compact(numEdges,
+              [&](size_t e) { return accept[e] != 0; },
+              [&](size_t count) { collapses.resize(numBefore+count); },
+              [&](size_t e, size_t outID) { collapses[numBefore+outID] = (uint32_t)e; });
+      if (collapses.size() == numBefore) break;
+      parallel_for_blocked(numBefore,collapses.size(),1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            const Edge &edge = edges[collapses[i]];
+            numRemovedCounter += edge.numTris;
+            for (int k=0;k<2;k++) {
+              const int v = k ? edge.v1 : edge.v0;
+              for (size_t j=vertexTrisBegin[v];j<vertexTrisBegin[v+1];j++)
+                for (int l=0;l<3;l++)
+                  blocked[triangles[vertexTris[j]][l]].store(1,std::memory_order_relaxed);
+            }
+          }
+        });
+      numRemoved = numRemovedCounter;
+      if (triangles.size()-numRemoved <= targetTriangles) break;
+    }
+
+    // don't collapse (much) more than required to get to the target
+    if (triangles.size()-numRemoved < targetTriangles) {
+      std::sort(collapses.begin(),collapses.end(),
+                [&](uint32_t a, uint32_t b){ return key[a] < key[b]; });
+      size_t numKept = 0;
+      numRemoved = 0;
+      while (triangles.size()-numRemoved > targetTriangles)
+        numRemoved += edges[collapses[numKept++]].numTris;
+      collapses.resize(numKept);
+    }
+
+    // ------------------------------------------------------------------
+    // do the collapses, then remove the triangles that became
+    // degenerate
+    // ------------------------------------------------------------------
+    std::vector<int> remap(numVertices);
+    parallel_for_blocked(0,numVertices,decimateBlockSize,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) remap[i] = (int)i;
+      });
+    parallel_for_blocked(0,collapses.size(),1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          const Edge &edge = edges[collapses[i]];
+          const float t = collapseT[collapses[i]];
+          const int a = edge.v0, b = edge.v1;
+          positions[a] = (1.f-t)*positions[a]+t*positions[b];
+          for (auto &values : attributes)
+            values[a] = (1.f-t)*values[a]+t*values[b];
+          quadrics[a] += quadrics[b];
+          remap[b] = a;
+        }
+      });
+    std::vector<vec3i> remaining;
+    compact(triangles.size(),
+            [&](size_t i) {
+              const vec3i t = triangles[i];
+              const int x = remap[t.x], y = remap[t.y], z = remap[t.z];
+              return x != y && y != z && z != x;
+            },
+            [&](size_t count) { remaining.resize(count); },
+            [&](size_t i, size_t outID) {
+              const vec3i t = triangles[i];
+              remaining[outID] = vec3i(remap[t.x],remap[t.y],remap[t.z]);
+            });
+    triangles.swap(remaining);
+    return collapses.size();
+  }
+
+  UMesh::SP Decimator::getResult(UMesh::SP input) const
+  {
+    const size_t numVertices = positions.size();
+    std::unique_ptr<std::atomic<uint8_t>[]> used(new std::atomic<uint8_t>[numVertices]);
+    parallel_for_blocked(0,numVertices,decimateBlockSize,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) used[i] = 0;
+      });
+    parallel_for_blocked(0,triangles.size(),decimateBlockSize,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          for (int j=0;j<3;j++)
+            used[triangles[i][j]].store(1,std::memory_order_relaxed);
+      });
+
+    UMesh::SP result = std::make_shared<UMesh>();
+    const std::vector<Attribute::SP> inputAttributes = vertexAttributesOf(input);
+    std::vector<Attribute::SP> outputAttributes;
+    for (auto attr : inputAttributes) {
+      Attribute::SP out = std::make_shared<Attribute>();
+      out->name = attr->name;
+      outputAttributes.push_back(out);
+      if (attr == input->perVertex)
+        result->perVertex = out;
+      if (std::find(input->attributes.begin(),input->attributes.end(),attr)
+          != input->attributes.end())
+        result->attributes.push_back(out);
+    }
+
+    std::vector<int> newID(numVertices,-1);
+    compact(numVertices,
+            [&](size_t i) { return used[i].load() != 0; },
+            [&](size_t count) {
+              result->vertices.resize(count);
+              for (auto attr : outputAttributes) attr->values.resize(count);
+            },
+            [&](size_t i, size_t outID) {
+              newID[i] = (int)outID;
+              result->vertices[outID] = positions[i];
+              for (size_t k=0;k<attributes.size();k++)
+                outputAttributes[k]->values[outID] = attributes[k][i];
+            });
+    result->triangles.resize(triangles.size());
+    parallel_for_blocked(0,triangles.size(),decimateBlockSize,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          const vec3i t = triangles[i];
+          result->triangles[i] = Triangle(newID[t.x],newID[t.y],newID[t.z]);
+        }
+      });
+    result->finalize();
+    return result;
+  }
+
+  UMesh::SP decimate(UMesh::SP mesh,
+                     size_t targetTriangles,
+                     const DecimateOptions &options)
+  {
+    if (mesh->vertices.empty() && (!mesh->triangles.empty() || !mesh->quads.empty()))
+      throw std::runtime_error("#umesh.decimate: mesh does not have any vertices");
+    Decimator decimator(mesh,options);
+    while (decimator.collapseRound(targetTriangles) > 0)
+      /* keep going */;
+    return decimator.getResult(mesh);
+  }
+
+  std::vector<UMesh::SP> computeLODs(UMesh::SP mesh,
+                                     const DecimateOptions &options)
+  {
+    std::vector<UMesh::SP> levels = { mesh };
+    size_t numTris = mesh->triangles.size()+2*mesh->quads.size();
+    while ((int)levels.size() < options.maxLevels) {
+      const size_t target = size_t(numTris*double(options.reduction));
+      if (target < options.minTriangles || target >= numTris) break;
+      UMesh::SP next = decimate(levels.back(),target,options);
+      if (next->triangles.size() >= numTris) break;
+      levels.push_back(next);
+      numTris = next->triangles.size();
+    }
+    return levels;
+  }
+
+} // ::umesh
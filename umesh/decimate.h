@@ -0,0 +1,75 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! settings for decimate() and computeLODs() */
+  struct DecimateOptions {
+    /*! each level of a LOD chain gets (about) this fraction of the
+        previous level's triangles */
+    float  reduction      = .25f;
+    /*! computeLODs() stops once the next level would have fewer
+        triangles than this */
+    size_t minTriangles   = 1000;
+    /*! max number of levels computeLODs() returns, including the
+        input itself */
+    int    maxLevels      = 8;
+    /*! weight of the constraint quadrics that keep boundary edges
+        (those with only one triangle) in place, relative to those of
+        the triangles' planes */
+    float  boundaryWeight = 1000.f;
+  };
+
+  /*! simplifies given surface mesh (the triangles and quads of
+      given mesh, with quads getting split into two triangles each)
+      down to (about) 'targetTriangles' triangles, by repeated edge
+      collapses with quadric error metrics (Garland-Heckbert). Each
+      round computes every edge's cost, and then collapses - in
+      parallel - all edges that are the cheapest within the 2-ring
+      of both their vertices; those never touch the same triangles,
+      so each round's collapses are independent of each other. Each
+      collapse moves the edge's first vertex to the point on the edge
+      with the lowest error, and interpolates all per-vertex
+      attributes accordingly; collapses that would flip a triangle,
+      or change the surface's topology, get skipped. Boundary edges
+      are constrained to stay in place (see DecimateOptions), and
+      non-manifold edges never get collapsed.
+
+      Returns a new, finalized mesh with only triangles and the
+      vertices they use; element attributes do not get carried
+      over. The input has to have its own vertices (eg,
+      extractShellFaces() with 'remeshVertices') */
+  UMesh::SP decimate(UMesh::SP mesh,
+                     size_t targetTriangles,
+                     const DecimateOptions &options = DecimateOptions());
+
+  /*! computes a chain of levels of detail of given surface mesh,
+      finest first: level 0 is the input itself, and each next level
+      is decimate()'d from the previous one, to 'options.reduction'
+      times its number of triangles. Stops after 'options.maxLevels'
+      levels, once a level would have fewer than
+      'options.minTriangles' triangles, or once decimating doesn't
+      make any progress */
+  std::vector<UMesh::SP>
+  computeLODs(UMesh::SP mesh,
+              const DecimateOptions &options = DecimateOptions());
+
+} // ::umesh
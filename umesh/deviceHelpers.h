@@ -0,0 +1,254 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* helpers for the library's cuda code: device memory, kernel
+   launches, and scans. When compiled w/o cuda (ie, as plain C++) all
+   of these operate on host memory, and "kernels" run through
+   parallel_for, so the same algorithms can also be run - and
+   debugged - on machines without a GPU */
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#ifdef __CUDACC__
+# include <cuda_runtime.h>
+# include <thrust/execution_policy.h>
+# include <thrust/scan.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __CUDACC__
+#define CUDA_CHECK( call )                                              \
+  {                                                                     \
+    cudaError_t rc = call;                                              \
+    if (rc != cudaSuccess) {                                            \
+      fprintf(stderr,                                                   \
+              "CUDA call (%s) failed with code %d (line %d): %s\n",     \
+              #call, rc, __LINE__, cudaGetErrorString(rc));             \
+      throw std::runtime_error("fatal cuda error");                     \
+    }                                                                   \
+  }
+
+#define CUDA_CALL(call) CUDA_CHECK(cuda##call)
+
+#define CUDA_SYNC_CHECK()                                       \
+  {                                                             \
+    cudaDeviceSynchronize();                                    \
+    cudaError_t rc = cudaGetLastError();                        \
+    if (rc != cudaSuccess) {                                    \
+      fprintf(stderr, "error (%s: line %d): %s\n",              \
+              __FILE__, __LINE__, cudaGetErrorString(rc));      \
+      throw std::runtime_error("fatal cuda error");             \
+    }                                                           \
+  }
+#endif
+
+/* functions that (when compiled w/ cuda) only ever run on the
+   device, and those that run on both device and host */
+#ifdef __CUDACC__
+# define __umesh_gpu_device__ __device__
+# define __umesh_gpu_both__   __host__ __device__
+#else
+# define __umesh_gpu_device__ /* host only */
+# define __umesh_gpu_both__   /* host only */
+#endif
+
+namespace umesh {
+
+  /*! a growable array in device memory (or, when compiled w/o cuda,
+      in host memory); only ever grows, so repeated extractions can
+      re-use the memory of earlier ones */
+  template<typename T>
+  struct DeviceArray {
+    DeviceArray() = default;
+    DeviceArray(const DeviceArray &) = delete;
+#ifdef __CUDACC__
+    ~DeviceArray() { if (ptr) cudaFree(ptr); }
+    void resize(size_t count)
+    {
+      if (count <= capacity) return;
+      if (ptr) CUDA_CALL(Free(ptr));
+      ptr = nullptr;
+      CUDA_CALL(Malloc(&ptr,count*sizeof(T)));
+      capacity = count;
+    }
+    void upload(const T *src, size_t count)
+    {
+      if (count == 0) return;
+      resize(count);
+      CUDA_CALL(Memcpy(ptr,src,count*sizeof(T),cudaMemcpyHostToDevice));
+    }
+    void download(T *dst, size_t begin, size_t count) const
+    {
+      CUDA_CALL(Memcpy(dst,ptr+begin,count*sizeof(T),cudaMemcpyDeviceToHost));
+    }
+#else
+    void resize(size_t count)
+    {
+      if (count <= capacity) return;
+      storage.resize(count);
+      ptr = storage.data();
+      capacity = count;
+    }
+    void upload(const T *src, size_t count)
+    {
+      resize(count);
+      std::copy(src,src+count,ptr);
+    }
+    void download(T *dst, size_t begin, size_t count) const
+    {
+      std::copy(ptr+begin,ptr+begin+count,dst);
+    }
+    std::vector<T> storage;
+#endif
+    template<typename Vector>
+    void upload(const Vector &v)
+    { upload((const T *)v.data(),v.size()*sizeof(v[0])/sizeof(T)); }
+
+    T     *ptr      = nullptr;
+    size_t capacity = 0;
+  };
+
+  /*! a stream that asynchronous copies get queued in (or, when
+      compiled w/o cuda, a no-op: all copies happen right away) */
+  struct DeviceStream {
+#ifdef __CUDACC__
+    DeviceStream() { CUDA_CALL(StreamCreateWithFlags(&stream,cudaStreamNonBlocking)); }
+    ~DeviceStream() { cudaStreamDestroy(stream); }
+    void sync() { CUDA_CALL(StreamSynchronize(stream)); }
+    cudaStream_t stream;
+#else
+    DeviceStream() = default;
+    void sync() {}
+#endif
+    DeviceStream(const DeviceStream &) = delete;
+  };
+
+  /*! marks a point in a stream, to wait for everything queued in
+      that stream before it */
+  struct DeviceEvent {
+#ifdef __CUDACC__
+    DeviceEvent() { CUDA_CALL(EventCreateWithFlags(&event,cudaEventDisableTiming)); }
+    ~DeviceEvent() { cudaEventDestroy(event); }
+    void record(DeviceStream &stream) { CUDA_CALL(EventRecord(event,stream.stream)); }
+    void sync() { CUDA_CALL(EventSynchronize(event)); }
+    cudaEvent_t event;
+#else
+    DeviceEvent() = default;
+    void record(DeviceStream &) {}
+    void sync() {}
+#endif
+    DeviceEvent(const DeviceEvent &) = delete;
+  };
+
+  /*! page-locked host memory, which (unlike regular host memory) can
+      be copied to the device asynchronously */
+  struct PinnedBuffer {
+    PinnedBuffer(size_t numBytes) : numBytes(numBytes)
+    {
+#ifdef __CUDACC__
+      CUDA_CALL(MallocHost(&ptr,numBytes));
+#else
+      storage.resize(numBytes);
+      ptr = storage.data();
+#endif
+    }
+#ifdef __CUDACC__
+    ~PinnedBuffer() { cudaFreeHost(ptr); }
+#endif
+    PinnedBuffer(const PinnedBuffer &) = delete;
+    
+    void        *ptr = nullptr;
+    const size_t numBytes;
+#ifndef __CUDACC__
+  private:
+    std::vector<uint8_t> storage;
+#endif
+  };
+
+  /*! queues a copy of 'numBytes' bytes from (pinned) host memory to
+      the device in given stream; 'src' must not be touched until the
+      stream has gotten past the copy */
+  inline void uploadAsync(void *dst, const void *src, size_t numBytes,
+                          DeviceStream &stream)
+  {
+    if (numBytes == 0) return;
+#ifdef __CUDACC__
+    CUDA_CALL(MemcpyAsync(dst,src,numBytes,cudaMemcpyHostToDevice,stream.stream));
+#else
+    memcpy(dst,src,numBytes);
+#endif
+  }
+  
+#ifdef __CUDACC__
+  template<typename Kernel>
+  __global__ void runKernel(Kernel kernel, size_t numItems)
+  {
+    const size_t i = size_t(blockIdx.x)*blockDim.x+threadIdx.x;
+    if (i < numItems) kernel(i);
+  }
+#endif
+
+  /*! runs given kernel for all items in [0,numItems) */
+  template<typename Kernel>
+  void launch(size_t numItems, const Kernel &kernel)
+  {
+    if (numItems == 0) return;
+#ifdef __CUDACC__
+    const int blockSize = 128;
+    runKernel<<<(unsigned)divRoundUp(numItems,size_t(blockSize)),blockSize>>>
+      (kernel,numItems);
+    CUDA_SYNC_CHECK();
+#else
+    parallel_for_blocked(0,numItems,16*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          kernel(i);
+      });
+#endif
+  }
+
+  /*! out[i] = sum of in[0..i); 'in' and 'out' may be the same */
+  template<typename T>
+  inline void exclusiveScan(const T *in, T *out, size_t numItems)
+  {
+#ifdef __CUDACC__
+    thrust::exclusive_scan(thrust::device,in,in+numItems,out,T(0));
+#else
+    T sum = 0;
+    for (size_t i=0;i<numItems;i++) {
+      const T count = in[i];
+      out[i] = sum;
+      sum += count;
+    }
+#endif
+  }
+
+  /*! out[i] = sum of in[0..i]; 'in' and 'out' may be the same */
+  template<typename T>
+  inline void inclusiveScan(const T *in, T *out, size_t numItems)
+  {
+#ifdef __CUDACC__
+    thrust::inclusive_scan(thrust::device,in,in+numItems,out);
+#else
+    T sum = 0;
+    for (size_t i=0;i<numItems;i++)
+      out[i] = (sum += in[i]);
+#endif
+  }
+
+} // ::umesh
@@ -0,0 +1,611 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/exaToUMesh.h"
+#include "umesh/parallel_radix_sort.h"
+#include <array>
+#include <map>
+
+namespace umesh {
+
+  /*! number of cells each parallel task generates the dual cells
+      of, into its own output mesh */
+  const size_t exaBlockSize = 1024;
+
+  /*! the order of cells in the sorted cell list: by (unsigned)
+      pos.x, pos.y, pos.z, level, then scalar */
+  inline bool operator<(const ExaCell &a, const ExaCell &b)
+  {
+    const uint32_t *pa = (const uint32_t *)&a;
+    const uint32_t *pb = (const uint32_t *)&b;
+    for (int i=0;i<4;i++) {
+      if (pa[i] < pb[i]) return true;
+      if (pa[i] > pb[i]) return false;
+    }
+    return a.scalar < b.scalar;
+  }
+
+  inline bool operator==(const ExaCell &a, const ExaCell &b)
+  {
+    return a.pos == b.pos && a.level == b.level && a.scalar == b.scalar;
+  }
+
+  inline bool operator!=(const ExaCell &a, const ExaCell &b)
+  {
+    return !(a == b);
+  }
+
+  /*! sorts the cells in the order of operator<, for better locality
+      of the cells (and thus, elements and vertices) each block
+      works on: since radix sort is stable, that's one pass for the
+      scalar, one for (z,level), and one for (x,y) */
+  void sortCells(std::vector<ExaCell> &cells)
+  {
+    parallel_radix_sort(cells,[](const ExaCell &c)
+                        { return radixKey(c.scalar); });
+    parallel_radix_sort(cells,[](const ExaCell &c)
+                        { return (uint64_t(uint32_t(c.pos.z))<<32) | uint32_t(c.level); });
+    parallel_radix_sort(cells,[](const ExaCell &c)
+                        { return (uint64_t(uint32_t(c.pos.x))<<32) | uint32_t(c.pos.y); });
+  }
+
+  /*! tests if the given four vertices are a plar dual-grid face - note
+    this will ONLY wok for (possibly degen) dual cells, it will _NOT_
+    do a general planarity test (eg, it would not detect rotations of
+    the vertices) */
+  template<int U, int V>
+  inline bool isPlanarQuadFaceT(const vec4f v0,
+                                const vec4f v1,
+                                const vec4f v2,
+                                const vec4f v3)
+  {
+    const vec2f v00 = vec2f(v0[U],v0[V]);
+    const vec2f v01 = vec2f(v1[U],v1[V]);
+    const vec2f v10 = vec2f(v3[U],v3[V]);
+    const vec2f v11 = vec2f(v2[U],v2[V]);
+    return
+      (v00 == v01 && v10 == v11) ||
+      (v00 == v10 && v01 == v11);
+  }
+
+  /*! tests if the given four vertices are a plar dual-grid face - note
+    this will ONLY wok for (possibly degen) dual cells, it will _NOT_
+    do a general planarity test (eg, it would not detect rotations of
+    the vertices) */
+  inline bool isPlanarQuadFace(const vec4f base00,
+                               const vec4f base01,
+                               const vec4f base11,
+                               const vec4f base10)
+  {
+    return
+      isPlanarQuadFaceT<0,1>(base00,base01,base11,base10) ||
+      isPlanarQuadFaceT<0,2>(base00,base01,base11,base10) ||
+      isPlanarQuadFaceT<1,2>(base00,base01,base11,base10) ||
+      // mirror
+      isPlanarQuadFaceT<1,0>(base00,base01,base11,base10) ||
+      isPlanarQuadFaceT<2,0>(base00,base01,base11,base10) ||
+      isPlanarQuadFaceT<2,1>(base00,base01,base11,base10);
+  }
+
+  inline bool allSame(const vec4f &a, const vec4f &b, const vec4f &c, const vec4f &d)
+  {
+    return (a==b) && (a==c) && (a==d);
+  }
+
+  inline bool same(const vec4f &a, const vec4f &b)
+  {
+    return (a==b);
+  }
+
+  /*! generates the dual cells for one block of cells, into its own
+      mesh; vertices only get shared with other elements of the same
+      block */
+  struct ExaDualBlock {
+    ExaDualBlock(const ExaCellIndex &cells, bool boundaryOnly)
+      : cells(cells),
+        boundaryOnly(boundaryOnly),
+        mesh(std::make_shared<UMesh>())
+    {
+      mesh->perVertex = std::make_shared<Attribute>();
+    }
+
+    void doCell(const ExaCell &cell);
+
+    /*! if this gets called we know that one side of a general dual
+      cell has collapsed into a single vertex (the 'top' here), but
+      the other four could still have duplicates .... we further do
+      know that the base face has NOT collapsed completely (else
+      we'd have had more than 5 duplicates, which gets tested
+      first) */
+    void tryPyramid(const std::array<vec4f,4> &base,
+                    const vec4f &top,
+                    int numUniqueVertices);
+    
+    // ##################################################################
+    // actual 'emit' functions - these *will* write the specified prim
+    // w/o any other tests
+    // ##################################################################
+    void emitTet(const std::array<vec4f,4> &vertices);
+    void emitPyramid(const std::array<vec4f,4> &base,
+                     const vec4f &top);
+    void emitWedge(const std::array<vec4f,3> &front,
+                   const std::array<vec4f,3> &back);
+    void emitHex(const std::array<vec4f,8> &corner, bool perfect);
+
+    /*! if this gets called we know that at least one face has collapsed
+      to an edge, but that NOT an entire face has collapsed (the
+      latter was tested before testing for edges). so we know that the
+      front[2] and back[2] must be different (else that face would
+      have collapsed)...BUT we could still have other collapses going
+      on on the 'base' spanned by front[0],front[1],back[0],back[1]
+      (vertices 0,1,3,4 in vtk corder). Having 6 vertices, and
+      already knowing the two that collapsed, that MUST be a wedge -
+      possibly with curved faces, but that's a differnt story */
+    void tryWedge(const std::array<vec4f,8> &corner,
+                  const vec3i &frontIdx,
+                  const vec3i &backIdx)
+    {
+      emitWedge
+        ({corner[frontIdx.x],
+          corner[frontIdx.y],
+          corner[frontIdx.z]},
+          {corner[backIdx.x],
+           corner[backIdx.y],
+           corner[backIdx.z]});
+    }
+
+    int findOrEmitVertex(const vec4f &v);
+    
+    const ExaCellIndex &cells;
+    const bool      boundaryOnly;
+    UMesh::SP       mesh;
+    /*! block-local vertex IDs, by position */
+    std::map<vec3f,int> vertexIndex;
+    ExaToUMeshStats stats;
+  };
+
+  int ExaDualBlock::findOrEmitVertex(const vec4f &v)
+  {
+    auto it = vertexIndex.find((const vec3f&)v);
+    if (it != vertexIndex.end()) return it->second;
+  
+    const int newID = (int)mesh->vertices.size();
+    mesh->vertices.push_back(vec3f{v.x, v.y, v.z});
+    mesh->perVertex->values.push_back(v.w);
+    vertexIndex[(const vec3f&)v] = newID;
+    return newID;
+  }
+  
+  void ExaDualBlock::emitTet(const std::array<vec4f,4> &vertices)
+  {
+    const Tet tet(findOrEmitVertex(vertices[0]),
+                  findOrEmitVertex(vertices[1]),
+                  findOrEmitVertex(vertices[2]),
+                  findOrEmitVertex(vertices[3]));
+    assert(tet.x != tet.y);
+    assert(tet.x != tet.z);
+    assert(tet.x != tet.w);
+    assert(tet.y != tet.z);
+    assert(tet.y != tet.w);
+    assert(tet.z != tet.w);
+    mesh->tets.push_back(tet);
+    stats.numTets++;
+  }
+
+  void ExaDualBlock::emitPyramid(const std::array<vec4f,4> &base,
+                                 const vec4f &top)
+  {
+    Pyr pyr;
+    pyr[4] = findOrEmitVertex(top);
+    pyr[0] = findOrEmitVertex(base[0]);
+    pyr[1] = findOrEmitVertex(base[1]);
+    pyr[2] = findOrEmitVertex(base[2]);
+    pyr[3] = findOrEmitVertex(base[3]);
+
+    if (isPlanarQuadFace(base[0],base[1],base[2],base[3]))
+      stats.numPyramidsPerfect++;
+    else
+      stats.numPyramidsTwisted++;
+
+    mesh->pyrs.push_back(pyr);
+    stats.numPyramids++;
+  }
+
+  void ExaDualBlock::emitWedge(const std::array<vec4f,3> &front,
+                               const std::array<vec4f,3> &back)
+  {
+    Wedge wedge;
+    wedge[0] = findOrEmitVertex(front[0]);
+    wedge[1] = findOrEmitVertex(front[1]);
+    wedge[2] = findOrEmitVertex(front[2]);
+    wedge[3] = findOrEmitVertex(back[0]);
+    wedge[4] = findOrEmitVertex(back[1]);
+    wedge[5] = findOrEmitVertex(back[2]);
+
+    if (isPlanarQuadFace(front[0],front[1],back[0],back[1]) &&
+        isPlanarQuadFace(front[0],front[2],back[0],back[2]) &&
+        isPlanarQuadFace(front[1],front[2],back[1],back[2]))
+      stats.numWedgesPerfect++;
+    else
+      stats.numWedgesTwisted++;
+    
+    mesh->wedges.push_back(wedge);
+    stats.numWedges++;
+  }
+
+  void ExaDualBlock::emitHex(const std::array<vec4f,8> &corner, bool perfect)
+  {
+    Hex hex;
+    // vtk order:
+    for (int i=0;i<8;i++)
+      hex[i] = findOrEmitVertex(corner[i]);
+    mesh->hexes.push_back(hex);
+
+    if (perfect)
+      stats.numHexesPerfect++;
+    else
+      stats.numHexesTwisted++;
+    stats.numHexes++;
+  }
+
+  void ExaDualBlock::tryPyramid(const std::array<vec4f,4> &base,
+                                const vec4f &top,
+                                int numUniqueVertices)
+  {
+    if (numUniqueVertices == 5) {
+      // MUST be a pyramid
+      emitPyramid(base,top);
+      return;
+    }
+
+    if (numUniqueVertices == 4) {
+      // check if any of the EDGES of the base collapsed, then it's a tet.
+      if (base[0]==base[1]) {
+        emitTet({base[1],base[2],base[3],top});
+        return;
+      }
+      if (base[1]==base[2]) {
+        emitTet({base[2],base[3],base[0],top});
+        return;
+      }
+      if (base[2]==base[3]) {
+        emitTet({base[3],base[0],base[1],top});
+        return;
+      }
+      if (base[3]==base[0]) {
+        emitTet({base[0],base[1],base[2],top});
+        return;
+      }
+      
+      // if not, it must be to opposite vertice in the bottom face
+      // that collapsed, then this is totally degen.
+      if (base[0] == base[2])
+        // degen, ignore
+        return;
+      if (base[1] == base[3])
+        // degen, ignore
+        return;
+      
+      throw std::runtime_error("#umesh.exaToUMesh: this case should not happen!?");
+    }
+    
+    throw std::runtime_error("#umesh.exaToUMesh: this cannot happen!?");
+  }
+
+  /*! number of different values among the given ones */
+  inline int numUnique(const std::array<vec4f,8> &v)
+  {
+    int count = 0;
+    for (int i=0;i<8;i++) {
+      bool isNew = true;
+      for (int j=0;j<i && isNew;j++)
+        isNew = !(v[j] == v[i]);
+      count += isNew;
+    }
+    return count;
+  }
+  
+  // ##################################################################
+  // code that actually generates the (possibly-degenerate) dual cells
+  // ##################################################################
+  void ExaDualBlock::doCell(const ExaCell &cell)
+  {
+    const std::vector<ExaCell> &cellList = cells.cells;
+    // the cells containing the centers of this cell's 26 same-level
+    // neighbors (and of the cell itself); each of the eight dual
+    // cells around this cell's corners uses eight of those
+    int neighborID[3][3][3];
+    for (int iz=0;iz<3;iz++)
+      for (int iy=0;iy<3;iy++)
+        for (int ix=0;ix<3;ix++)
+          cells.find(neighborID[iz][iy][ix],
+                     cell.neighbor(vec3i(ix-1,iy-1,iz-1)).center());
+    const int selfID = neighborID[1][1][1];
+    if (selfID < 0 || cellList[selfID] != cell)
+      throw std::runtime_error("#umesh.exaToUMesh: bug in find()");
+
+    for (int dz=-1;dz<=1;dz+=2)
+      for (int dy=-1;dy<=1;dy+=2)
+        for (int dx=-1;dx<=1;dx+=2) {
+          int corner[2][2][2];
+          int minLevel = 1000;
+          int maxLevel = -1;
+          int numFound = 0;
+          for (int iz=0;iz<2;iz++)
+            for (int iy=0;iy<2;iy++)
+              for (int ix=0;ix<2;ix++) {
+                corner[iz][iy][ix] = neighborID[1+dz*iz][1+dy*iy][1+dx*ix];
+                if (corner[iz][iy][ix] < 0)
+                  // corner does not exist, this is not a dual cell
+                  continue;
+              
+                minLevel = std::min(minLevel,cellList[corner[iz][iy][ix]].level);
+                maxLevel = std::max(maxLevel,cellList[corner[iz][iy][ix]].level);
+                ++numFound;
+              }
+
+          if (numFound < 8)
+            continue;
+          
+          if (minLevel < cell.level)
+            // somebody else will generate this same cell from a finer
+            // level...
+            continue;
+
+          ExaCell minCell = cell;
+          for (int iz=0;iz<2;iz++)
+            for (int iy=0;iy<2;iy++)
+              for (int ix=0;ix<2;ix++) {
+                const ExaCell &cc = cellList[corner[iz][iy][ix]];
+                if (cc.level == cell.level && cc < minCell)
+                  minCell = cc;
+              }
+          
+          if (minCell != cell)
+            // some other cell will generate this
+            continue;
+
+          vec4f vertex[2][2][2];
+          for (int iz=0;iz<2;iz++)
+            for (int iy=0;iy<2;iy++)
+              for (int ix=0;ix<2;ix++) {
+                const ExaCell &c = cellList[corner[iz][iy][ix]];
+                vertex[iz][iy][ix] = vec4f(c.center(),c.scalar);
+              }
+
+          // VTK order
+          std::array<vec4f,8> v;
+          if ((dx<0) ^ (dy<0) ^ (dz<0)) {
+            // hex is mirrored an un-even time, so has negative volume... swap
+            v[0] = vertex[1][0][0];
+            v[1] = vertex[1][0][1];
+            v[2] = vertex[1][1][1];
+            v[3] = vertex[1][1][0];
+            v[4] = vertex[0][0][0];
+            v[5] = vertex[0][0][1];
+            v[6] = vertex[0][1][1];
+            v[7] = vertex[0][1][0];
+          } else {
+            v[0] = vertex[0][0][0];
+            v[1] = vertex[0][0][1];
+            v[2] = vertex[0][1][1];
+            v[3] = vertex[0][1][0];
+            v[4] = vertex[1][0][0];
+            v[5] = vertex[1][0][1];
+            v[6] = vertex[1][1][1];
+            v[7] = vertex[1][1][0];
+          }
+
+          const auto &v0 = v[0];
+          const auto &v1 = v[1];
+          const auto &v2 = v[2];
+          const auto &v3 = v[3];
+          const auto &v4 = v[4];
+          const auto &v5 = v[5];
+          const auto &v6 = v[6];
+          const auto &v7 = v[7];
+
+          // ==================================================================
+          // check for regular cube
+          // ==================================================================
+          if (minLevel == maxLevel) {
+            if (!boundaryOnly)
+              emitHex(v,/*perfect:*/true);
+            continue;
+          }
+          
+          const int numUniqueVertices = numUnique(v);
+          // ==================================================================
+          // check for general hex (with possibly twisted sides)
+          // ==================================================================
+          // no duplicates, MUST be a general hex
+          if (numUniqueVertices == 8) {
+            emitHex(v,/*perfect:*/false);
+            continue;
+          }
+
+          // ==================================================================
+          // check for totally degenerate
+          // ==================================================================
+          if (numUniqueVertices < 4) {
+            // check for less than four vertices .... that cannot even
+            // be a tet ... though even for exactly four it's not sure
+            // it's a tet, so let's handle that int the other cases
+            continue;
+          }
+
+          // from here on, numunique = 4,5,6,or 7 are still all valid
+          
+          // ==================================================================
+          // check whether an entire face completely collapsed - then
+          // it's a pyramid (numunique==5), or a tet
+          // (numunique==4). (less than pyramid or tet would mean
+          // numunique<4, which has already been tested above)
+          // ==================================================================
+          // bottom:
+          if (allSame(v0,v1,v2,v3)) {
+            tryPyramid(/*facing down:*/{ v4,v7,v6,v5 }, v0, numUniqueVertices);
+            continue;
+          }
+          // top:
+          if (allSame(v4,v5,v6,v7)) {
+            tryPyramid(/* up:*/{ v0,v1,v2,v3 }, v4, numUniqueVertices);
+            continue;
+          }
+          // front:
+          if (allSame(v0,v1,v4,v5)) {
+            tryPyramid(/* face forward*/{v2,v6,v7,v3}, v0, numUniqueVertices);
+            continue;
+          }
+          // back:
+          if (allSame(v2,v3,v6,v7)) {
+            tryPyramid(/* face back*/{v0,v4,v5,v1}, v2, numUniqueVertices);
+            continue;
+          }
+          //left:
+          if (allSame(v0,v3,v4,v7)) {
+            tryPyramid(/* face right*/{v1,v5,v6,v2}, v0, numUniqueVertices);
+            continue;
+          }
+          //right:
+          if (allSame(v1,v2,v5,v6)) {
+            tryPyramid(/* face left*/{v0,v3,v7,v4}, v1, numUniqueVertices);
+            continue;
+          }
+        
+          // ==================================================================
+          // no face that completely collapsed to a single vertex -
+          // now check if any one face collapsed two edges to form the
+          // top of a tent - then based on what happens at the bottom
+          // face it's either a wedge, a tet, or degenerate
+          // ==================================================================
+
+          // check front side:
+          if (same(v0,v1) && same(v4,v5)) {
+            tryWedge(v,{3,2,0},{7,6,4});
+            continue;
+          }
+          if (same(v0,v4) && same(v1,v5)) {
+            tryWedge(v,{2,6,5},{3,7,4});
+            continue;
+          }
+
+          // check back side:
+          if (same(v3,v7) && same(v2,v6)) {
+            tryWedge(v,{5,1,2},{4,0,3});
+            continue;
+          }
+          if (same(v2,v3) && same(v6,v7)) {
+            tryWedge(v,{1,0,3},{5,4,7});
+            continue;
+          }
+
+          // check top side:
+          if (same(v4,v7) && same(v5,v6)) {
+            tryWedge(v,{3,0,4},{2,1,6});
+            continue;
+          }
+          if (same(v4,v5) && same(v6,v7)) {
+            tryWedge(v,{0,1,4},{3,2,7});
+            continue;
+          }
+
+          // check bottom side:
+          if (same(v0,v1) && same(v3,v2)) {
+            tryWedge(v,{5,4,0},{6,7,3});
+            continue;
+          }
+          if (same(v0,v3) && same(v1,v2)) {
+            tryWedge(v,{4,7,3},{5,6,2});
+            continue;
+          }
+
+          // check left side:
+          if (same(v0,v3) && same(v4,v7)) {
+            tryWedge(v,{5,6,7},{1,2,3});
+            continue;
+          }
+          if (same(v0,v4) && same(v3,v7)) {
+            tryWedge(v,{1,5,4},{2,6,7});
+            continue;
+          }
+
+          // check right side:
+          if (same(v1,v2) && same(v5,v6)) {
+            tryWedge(v,{7,4,5},{3,0,1});
+            continue;
+          }
+          if (same(v1,v5) && same(v2,v6)) {
+            tryWedge(v,{4,0,1},{7,3,2});
+            continue;
+          }
+          
+          // ==================================================================
+          // fallback - there's still cases of only ONE collapsed vertex,
+          // for example, so let's just make this into a deformed hex 
+          // ==================================================================
+          emitHex(v,/*perfect:*/false);
+        }
+  }
+
+  UMesh::SP exaToUMesh(std::vector<ExaCell> cellVector,
+                       bool boundaryOnly,
+                       ExaToUMeshStats *stats)
+  {
+    if (cellVector.size() >= 0x7fffffffull)
+      throw std::runtime_error("#umesh.exaToUMesh: too many cells");
+    sortCells(cellVector);
+    const ExaCellIndex cells(std::move(cellVector));
+    const size_t numCells  = cells.cells.size();
+    const size_t numBlocks = divRoundUp(numCells,exaBlockSize);
+    
+    std::vector<UMesh::SP>       blockMeshes(numBlocks);
+    std::vector<ExaToUMeshStats> blockStats(numBlocks);
+    parallel_for(numBlocks,[&](size_t blockID){
+        ExaDualBlock block(cells,boundaryOnly);
+        const size_t begin = blockID*exaBlockSize;
+        const size_t end   = std::min(begin+exaBlockSize,numCells);
+        for (size_t cellID=begin;cellID<end;cellID++)
+          block.doCell(cells.cells[cellID]);
+        blockMeshes[blockID] = block.mesh;
+        blockStats[blockID]  = block.stats;
+      });
+
+    if (stats) {
+      *stats = ExaToUMeshStats();
+      for (auto &bs : blockStats) {
+        stats->numTets            += bs.numTets;
+        stats->numPyramids        += bs.numPyramids;
+        stats->numPyramidsPerfect += bs.numPyramidsPerfect;
+        stats->numPyramidsTwisted += bs.numPyramidsTwisted;
+        stats->numWedges          += bs.numWedges;
+        stats->numWedgesPerfect   += bs.numWedgesPerfect;
+        stats->numWedgesTwisted   += bs.numWedgesTwisted;
+        stats->numHexes           += bs.numHexes;
+        stats->numHexesPerfect    += bs.numHexesPerfect;
+        stats->numHexesTwisted    += bs.numHexesTwisted;
+      }
+    }
+
+    if (blockMeshes.empty()) {
+      UMesh::SP result = std::make_shared<UMesh>();
+      result->perVertex = std::make_shared<Attribute>();
+      return result;
+    }
+    return mergeMeshes(blockMeshes,/*weldVertices:*/true);
+  }
+  
+} // ::umesh
@@ -0,0 +1,56 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/ExaCellIndex.h"
+
+namespace umesh {
+
+  /*! number of elements of each kind exaToUMesh() generated */
+  struct ExaToUMeshStats {
+    size_t numTets            = 0;
+    size_t numPyramids        = 0;
+    size_t numPyramidsPerfect = 0;
+    size_t numPyramidsTwisted = 0;
+    size_t numWedges          = 0;
+    size_t numWedgesPerfect   = 0;
+    size_t numWedgesTwisted   = 0;
+    size_t numHexes           = 0;
+    size_t numHexesPerfect    = 0;
+    size_t numHexesTwisted    = 0;
+  };
+  
+  /*! computes the dual mesh of given AMR cells: one vertex per cell
+      center (with the cell's scalar as perVertex value), and one -
+      possibly degenerate, and then reduced to a tet, pyramid, or
+      wedge - hex for each set of 2x2x2 cells that touch in a common
+      corner. If 'boundaryOnly' is set, the 'perfect' hexes between
+      eight cells of the same level don't get emitted, only the
+      elements that stitch different levels together. If 'stats' is
+      specified, it gets the number of generated elements.
+
+      Cells get processed in parallel, in blocks that each write
+      their elements and vertices to their own (small) mesh, with
+      only block-local vertex sharing; these get concatenated - and
+      vertices with the same position welded - by mergeMeshes()
+      afterwards, so there are no locks on the output. The result is
+      the same for any number of threads, and is not finalized. */
+  UMesh::SP exaToUMesh(std::vector<ExaCell> cells,
+                       bool boundaryOnly = false,
+                       ExaToUMeshStats *stats = nullptr);
+  
+} // ::umesh
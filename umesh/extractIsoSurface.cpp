@@ -15,301 +15,77 @@
 // ======================================================================== //
 
 #include "umesh/extractIsoSurface.h"
-#include <iterator>
-#if UMESH_HAVE_TBB
-# include "tbb/parallel_sort.h"
-#endif
+#include "umesh/computeNormals.h"
+#include "umesh/marchingCubesTables.h"
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/ScratchArena.h"
+#include "umesh/profile.h"
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
 #include <string.h>
 
 namespace umesh {
 
-  /*! marching-cubes case tables, from VTK */
-  const int8_t vtkMarchingCubesTriangleCases[256][16]
-  = {
-     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 0 0 */
-     { 0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 1 1 */
-     { 0, 9, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 2 1 */
-     { 1, 3, 8, 9, 1, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 3 2 */
-     { 1, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 4 1 */
-     { 0, 3, 8, 1, 11, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 5 3 */
-     { 9, 11, 2, 0, 9, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 6 2 */
-     { 2, 3, 8, 2, 8, 11, 11, 8, 9, -1, -1, -1, -1, -1, -1, -1}, /* 7 5 */
-     { 3, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 8 1 */
-     { 0, 2, 10, 8, 0, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 9 2 */
-     { 1, 0, 9, 2, 10, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 10 3 */
-     { 1, 2, 10, 1, 10, 9, 9, 10, 8, -1, -1, -1, -1, -1, -1, -1}, /* 11 5 */
-     { 3, 1, 11, 10, 3, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 12 2 */
-     { 0, 1, 11, 0, 11, 8, 8, 11, 10, -1, -1, -1, -1, -1, -1, -1}, /* 13 5 */
-     { 3, 0, 9, 3, 9, 10, 10, 9, 11, -1, -1, -1, -1, -1, -1, -1}, /* 14 5 */
-     { 9, 11, 8, 11, 10, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 15 8 */
-     { 4, 8, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 16 1 */
-     { 4, 0, 3, 7, 4, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 17 2 */
-     { 0, 9, 1, 8, 7, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 18 3 */
-     { 4, 9, 1, 4, 1, 7, 7, 1, 3, -1, -1, -1, -1, -1, -1, -1}, /* 19 5 */
-     { 1, 11, 2, 8, 7, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 20 4 */
-     { 3, 7, 4, 3, 4, 0, 1, 11, 2, -1, -1, -1, -1, -1, -1, -1}, /* 21 7 */
-     { 9, 11, 2, 9, 2, 0, 8, 7, 4, -1, -1, -1, -1, -1, -1, -1}, /* 22 7 */
-     { 2, 9, 11, 2, 7, 9, 2, 3, 7, 7, 4, 9, -1, -1, -1, -1}, /* 23 14 */
-     { 8, 7, 4, 3, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 24 3 */
-     {10, 7, 4, 10, 4, 2, 2, 4, 0, -1, -1, -1, -1, -1, -1, -1}, /* 25 5 */
-     { 9, 1, 0, 8, 7, 4, 2, 10, 3, -1, -1, -1, -1, -1, -1, -1}, /* 26 6 */
-     { 4, 10, 7, 9, 10, 4, 9, 2, 10, 9, 1, 2, -1, -1, -1, -1}, /* 27 9 */
-     { 3, 1, 11, 3, 11, 10, 7, 4, 8, -1, -1, -1, -1, -1, -1, -1}, /* 28 7 */
-     { 1, 11, 10, 1, 10, 4, 1, 4, 0, 7, 4, 10, -1, -1, -1, -1}, /* 29 11 */
-     { 4, 8, 7, 9, 10, 0, 9, 11, 10, 10, 3, 0, -1, -1, -1, -1}, /* 30 12 */
-     { 4, 10, 7, 4, 9, 10, 9, 11, 10, -1, -1, -1, -1, -1, -1, -1}, /* 31 5 */
-     { 9, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 32 1 */
-     { 9, 4, 5, 0, 3, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 33 3 */
-     { 0, 4, 5, 1, 0, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 34 2 */
-     { 8, 4, 5, 8, 5, 3, 3, 5, 1, -1, -1, -1, -1, -1, -1, -1}, /* 35 5 */
-     { 1, 11, 2, 9, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 36 3 */
-     { 3, 8, 0, 1, 11, 2, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1}, /* 37 6 */
-     { 5, 11, 2, 5, 2, 4, 4, 2, 0, -1, -1, -1, -1, -1, -1, -1}, /* 38 5 */
-     { 2, 5, 11, 3, 5, 2, 3, 4, 5, 3, 8, 4, -1, -1, -1, -1}, /* 39 9 */
-     { 9, 4, 5, 2, 10, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 40 4 */
-     { 0, 2, 10, 0, 10, 8, 4, 5, 9, -1, -1, -1, -1, -1, -1, -1}, /* 41 7 */
-     { 0, 4, 5, 0, 5, 1, 2, 10, 3, -1, -1, -1, -1, -1, -1, -1}, /* 42 7 */
-     { 2, 5, 1, 2, 8, 5, 2, 10, 8, 4, 5, 8, -1, -1, -1, -1}, /* 43 11 */
-     {11, 10, 3, 11, 3, 1, 9, 4, 5, -1, -1, -1, -1, -1, -1, -1}, /* 44 7 */
-     { 4, 5, 9, 0, 1, 8, 8, 1, 11, 8, 11, 10, -1, -1, -1, -1}, /* 45 12 */
-     { 5, 0, 4, 5, 10, 0, 5, 11, 10, 10, 3, 0, -1, -1, -1, -1}, /* 46 14 */
-     { 5, 8, 4, 5, 11, 8, 11, 10, 8, -1, -1, -1, -1, -1, -1, -1}, /* 47 5 */
-     { 9, 8, 7, 5, 9, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 48 2 */
-     { 9, 0, 3, 9, 3, 5, 5, 3, 7, -1, -1, -1, -1, -1, -1, -1}, /* 49 5 */
-     { 0, 8, 7, 0, 7, 1, 1, 7, 5, -1, -1, -1, -1, -1, -1, -1}, /* 50 5 */
-     { 1, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 51 8 */
-     { 9, 8, 7, 9, 7, 5, 11, 2, 1, -1, -1, -1, -1, -1, -1, -1}, /* 52 7 */
-     {11, 2, 1, 9, 0, 5, 5, 0, 3, 5, 3, 7, -1, -1, -1, -1}, /* 53 12 */
-     { 8, 2, 0, 8, 5, 2, 8, 7, 5, 11, 2, 5, -1, -1, -1, -1}, /* 54 11 */
-     { 2, 5, 11, 2, 3, 5, 3, 7, 5, -1, -1, -1, -1, -1, -1, -1}, /* 55 5 */
-     { 7, 5, 9, 7, 9, 8, 3, 2, 10, -1, -1, -1, -1, -1, -1, -1}, /* 56 7 */
-     { 9, 7, 5, 9, 2, 7, 9, 0, 2, 2, 10, 7, -1, -1, -1, -1}, /* 57 14 */
-     { 2, 10, 3, 0, 8, 1, 1, 8, 7, 1, 7, 5, -1, -1, -1, -1}, /* 58 12 */
-     {10, 1, 2, 10, 7, 1, 7, 5, 1, -1, -1, -1, -1, -1, -1, -1}, /* 59 5 */
-     { 9, 8, 5, 8, 7, 5, 11, 3, 1, 11, 10, 3, -1, -1, -1, -1}, /* 60 10 */
-     { 5, 0, 7, 5, 9, 0, 7, 0, 10, 1, 11, 0, 10, 0, 11, -1}, /* 61 7 */
-     {10, 0, 11, 10, 3, 0, 11, 0, 5, 8, 7, 0, 5, 0, 7, -1}, /* 62 7 */
-     {10, 5, 11, 7, 5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 63 2 */
-     {11, 5, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 64 1 */
-     { 0, 3, 8, 5, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 65 4 */
-     { 9, 1, 0, 5, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 66 3 */
-     { 1, 3, 8, 1, 8, 9, 5, 6, 11, -1, -1, -1, -1, -1, -1, -1}, /* 67 7 */
-     { 1, 5, 6, 2, 1, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 68 2 */
-     { 1, 5, 6, 1, 6, 2, 3, 8, 0, -1, -1, -1, -1, -1, -1, -1}, /* 69 7 */
-     { 9, 5, 6, 9, 6, 0, 0, 6, 2, -1, -1, -1, -1, -1, -1, -1}, /* 70 5 */
-     { 5, 8, 9, 5, 2, 8, 5, 6, 2, 3, 8, 2, -1, -1, -1, -1}, /* 71 11 */
-     { 2, 10, 3, 11, 5, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 72 3 */
-     {10, 8, 0, 10, 0, 2, 11, 5, 6, -1, -1, -1, -1, -1, -1, -1}, /* 73 7 */
-     { 0, 9, 1, 2, 10, 3, 5, 6, 11, -1, -1, -1, -1, -1, -1, -1}, /* 74 6 */
-     { 5, 6, 11, 1, 2, 9, 9, 2, 10, 9, 10, 8, -1, -1, -1, -1}, /* 75 12 */
-     { 6, 10, 3, 6, 3, 5, 5, 3, 1, -1, -1, -1, -1, -1, -1, -1}, /* 76 5 */
-     { 0, 10, 8, 0, 5, 10, 0, 1, 5, 5, 6, 10, -1, -1, -1, -1}, /* 77 14 */
-     { 3, 6, 10, 0, 6, 3, 0, 5, 6, 0, 9, 5, -1, -1, -1, -1}, /* 78 9 */
-     { 6, 9, 5, 6, 10, 9, 10, 8, 9, -1, -1, -1, -1, -1, -1, -1}, /* 79 5 */
-     { 5, 6, 11, 4, 8, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 80 3 */
-     { 4, 0, 3, 4, 3, 7, 6, 11, 5, -1, -1, -1, -1, -1, -1, -1}, /* 81 7 */
-     { 1, 0, 9, 5, 6, 11, 8, 7, 4, -1, -1, -1, -1, -1, -1, -1}, /* 82 6 */
-     {11, 5, 6, 1, 7, 9, 1, 3, 7, 7, 4, 9, -1, -1, -1, -1}, /* 83 12 */
-     { 6, 2, 1, 6, 1, 5, 4, 8, 7, -1, -1, -1, -1, -1, -1, -1}, /* 84 7 */
-     { 1, 5, 2, 5, 6, 2, 3, 4, 0, 3, 7, 4, -1, -1, -1, -1}, /* 85 10 */
-     { 8, 7, 4, 9, 5, 0, 0, 5, 6, 0, 6, 2, -1, -1, -1, -1}, /* 86 12 */
-     { 7, 9, 3, 7, 4, 9, 3, 9, 2, 5, 6, 9, 2, 9, 6, -1}, /* 87 7 */
-     { 3, 2, 10, 7, 4, 8, 11, 5, 6, -1, -1, -1, -1, -1, -1, -1}, /* 88 6 */
-     { 5, 6, 11, 4, 2, 7, 4, 0, 2, 2, 10, 7, -1, -1, -1, -1}, /* 89 12 */
-     { 0, 9, 1, 4, 8, 7, 2, 10, 3, 5, 6, 11, -1, -1, -1, -1}, /* 90 13 */
-     { 9, 1, 2, 9, 2, 10, 9, 10, 4, 7, 4, 10, 5, 6, 11, -1}, /* 91 6 */
-     { 8, 7, 4, 3, 5, 10, 3, 1, 5, 5, 6, 10, -1, -1, -1, -1}, /* 92 12 */
-     { 5, 10, 1, 5, 6, 10, 1, 10, 0, 7, 4, 10, 0, 10, 4, -1}, /* 93 7 */
-     { 0, 9, 5, 0, 5, 6, 0, 6, 3, 10, 3, 6, 8, 7, 4, -1}, /* 94 6 */
-     { 6, 9, 5, 6, 10, 9, 4, 9, 7, 7, 9, 10, -1, -1, -1, -1}, /* 95 3 */
-     {11, 9, 4, 6, 11, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 96 2 */
-     { 4, 6, 11, 4, 11, 9, 0, 3, 8, -1, -1, -1, -1, -1, -1, -1}, /* 97 7 */
-     {11, 1, 0, 11, 0, 6, 6, 0, 4, -1, -1, -1, -1, -1, -1, -1}, /* 98 5 */
-     { 8, 1, 3, 8, 6, 1, 8, 4, 6, 6, 11, 1, -1, -1, -1, -1}, /* 99 14 */
-     { 1, 9, 4, 1, 4, 2, 2, 4, 6, -1, -1, -1, -1, -1, -1, -1}, /* 100 5 */
-     { 3, 8, 0, 1, 9, 2, 2, 9, 4, 2, 4, 6, -1, -1, -1, -1}, /* 101 12 */
-     { 0, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 102 8 */
-     { 8, 2, 3, 8, 4, 2, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1}, /* 103 5 */
-     {11, 9, 4, 11, 4, 6, 10, 3, 2, -1, -1, -1, -1, -1, -1, -1}, /* 104 7 */
-     { 0, 2, 8, 2, 10, 8, 4, 11, 9, 4, 6, 11, -1, -1, -1, -1}, /* 105 10 */
-     { 3, 2, 10, 0, 6, 1, 0, 4, 6, 6, 11, 1, -1, -1, -1, -1}, /* 106 12 */
-     { 6, 1, 4, 6, 11, 1, 4, 1, 8, 2, 10, 1, 8, 1, 10, -1}, /* 107 7 */
-     { 9, 4, 6, 9, 6, 3, 9, 3, 1, 10, 3, 6, -1, -1, -1, -1}, /* 108 11 */
-     { 8, 1, 10, 8, 0, 1, 10, 1, 6, 9, 4, 1, 6, 1, 4, -1}, /* 109 7 */
-     { 3, 6, 10, 3, 0, 6, 0, 4, 6, -1, -1, -1, -1, -1, -1, -1}, /* 110 5 */
-     { 6, 8, 4, 10, 8, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 111 2 */
-     { 7, 6, 11, 7, 11, 8, 8, 11, 9, -1, -1, -1, -1, -1, -1, -1}, /* 112 5 */
-     { 0, 3, 7, 0, 7, 11, 0, 11, 9, 6, 11, 7, -1, -1, -1, -1}, /* 113 11 */
-     {11, 7, 6, 1, 7, 11, 1, 8, 7, 1, 0, 8, -1, -1, -1, -1}, /* 114 9 */
-     {11, 7, 6, 11, 1, 7, 1, 3, 7, -1, -1, -1, -1, -1, -1, -1}, /* 115 5 */
-     { 1, 6, 2, 1, 8, 6, 1, 9, 8, 8, 7, 6, -1, -1, -1, -1}, /* 116 14 */
-     { 2, 9, 6, 2, 1, 9, 6, 9, 7, 0, 3, 9, 7, 9, 3, -1}, /* 117 7 */
-     { 7, 0, 8, 7, 6, 0, 6, 2, 0, -1, -1, -1, -1, -1, -1, -1}, /* 118 5 */
-     { 7, 2, 3, 6, 2, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 119 2 */
-     { 2, 10, 3, 11, 8, 6, 11, 9, 8, 8, 7, 6, -1, -1, -1, -1}, /* 120 12 */
-     { 2, 7, 0, 2, 10, 7, 0, 7, 9, 6, 11, 7, 9, 7, 11, -1}, /* 121 7 */
-     { 1, 0, 8, 1, 8, 7, 1, 7, 11, 6, 11, 7, 2, 10, 3, -1}, /* 122 6 */
-     {10, 1, 2, 10, 7, 1, 11, 1, 6, 6, 1, 7, -1, -1, -1, -1}, /* 123 3 */
-     { 8, 6, 9, 8, 7, 6, 9, 6, 1, 10, 3, 6, 1, 6, 3, -1}, /* 124 7 */
-     { 0, 1, 9, 10, 7, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 125 4 */
-     { 7, 0, 8, 7, 6, 0, 3, 0, 10, 10, 0, 6, -1, -1, -1, -1}, /* 126 3 */
-     { 7, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 127 1 */
-     { 7, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 128 1 */
-     { 3, 8, 0, 10, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 129 3 */
-     { 0, 9, 1, 10, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 130 4 */
-     { 8, 9, 1, 8, 1, 3, 10, 6, 7, -1, -1, -1, -1, -1, -1, -1}, /* 131 7 */
-     {11, 2, 1, 6, 7, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 132 3 */
-     { 1, 11, 2, 3, 8, 0, 6, 7, 10, -1, -1, -1, -1, -1, -1, -1}, /* 133 6 */
-     { 2, 0, 9, 2, 9, 11, 6, 7, 10, -1, -1, -1, -1, -1, -1, -1}, /* 134 7 */
-     { 6, 7, 10, 2, 3, 11, 11, 3, 8, 11, 8, 9, -1, -1, -1, -1}, /* 135 12 */
-     { 7, 3, 2, 6, 7, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 136 2 */
-     { 7, 8, 0, 7, 0, 6, 6, 0, 2, -1, -1, -1, -1, -1, -1, -1}, /* 137 5 */
-     { 2, 6, 7, 2, 7, 3, 0, 9, 1, -1, -1, -1, -1, -1, -1, -1}, /* 138 7 */
-     { 1, 2, 6, 1, 6, 8, 1, 8, 9, 8, 6, 7, -1, -1, -1, -1}, /* 139 14 */
-     {11, 6, 7, 11, 7, 1, 1, 7, 3, -1, -1, -1, -1, -1, -1, -1}, /* 140 5 */
-     {11, 6, 7, 1, 11, 7, 1, 7, 8, 1, 8, 0, -1, -1, -1, -1}, /* 141 9 */
-     { 0, 7, 3, 0, 11, 7, 0, 9, 11, 6, 7, 11, -1, -1, -1, -1}, /* 142 11 */
-     { 7, 11, 6, 7, 8, 11, 8, 9, 11, -1, -1, -1, -1, -1, -1, -1}, /* 143 5 */
-     { 6, 4, 8, 10, 6, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 144 2 */
-     { 3, 10, 6, 3, 6, 0, 0, 6, 4, -1, -1, -1, -1, -1, -1, -1}, /* 145 5 */
-     { 8, 10, 6, 8, 6, 4, 9, 1, 0, -1, -1, -1, -1, -1, -1, -1}, /* 146 7 */
-     { 9, 6, 4, 9, 3, 6, 9, 1, 3, 10, 6, 3, -1, -1, -1, -1}, /* 147 11 */
-     { 6, 4, 8, 6, 8, 10, 2, 1, 11, -1, -1, -1, -1, -1, -1, -1}, /* 148 7 */
-     { 1, 11, 2, 3, 10, 0, 0, 10, 6, 0, 6, 4, -1, -1, -1, -1}, /* 149 12 */
-     { 4, 8, 10, 4, 10, 6, 0, 9, 2, 2, 9, 11, -1, -1, -1, -1}, /* 150 10 */
-     {11, 3, 9, 11, 2, 3, 9, 3, 4, 10, 6, 3, 4, 3, 6, -1}, /* 151 7 */
-     { 8, 3, 2, 8, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1}, /* 152 5 */
-     { 0, 2, 4, 4, 2, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 153 8 */
-     { 1, 0, 9, 2, 4, 3, 2, 6, 4, 4, 8, 3, -1, -1, -1, -1}, /* 154 12 */
-     { 1, 4, 9, 1, 2, 4, 2, 6, 4, -1, -1, -1, -1, -1, -1, -1}, /* 155 5 */
-     { 8, 3, 1, 8, 1, 6, 8, 6, 4, 6, 1, 11, -1, -1, -1, -1}, /* 156 14 */
-     {11, 0, 1, 11, 6, 0, 6, 4, 0, -1, -1, -1, -1, -1, -1, -1}, /* 157 5 */
-     { 4, 3, 6, 4, 8, 3, 6, 3, 11, 0, 9, 3, 11, 3, 9, -1}, /* 158 7 */
-     {11, 4, 9, 6, 4, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 159 2 */
-     { 4, 5, 9, 7, 10, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 160 3 */
-     { 0, 3, 8, 4, 5, 9, 10, 6, 7, -1, -1, -1, -1, -1, -1, -1}, /* 161 6 */
-     { 5, 1, 0, 5, 0, 4, 7, 10, 6, -1, -1, -1, -1, -1, -1, -1}, /* 162 7 */
-     {10, 6, 7, 8, 4, 3, 3, 4, 5, 3, 5, 1, -1, -1, -1, -1}, /* 163 12 */
-     { 9, 4, 5, 11, 2, 1, 7, 10, 6, -1, -1, -1, -1, -1, -1, -1}, /* 164 6 */
-     { 6, 7, 10, 1, 11, 2, 0, 3, 8, 4, 5, 9, -1, -1, -1, -1}, /* 165 13 */
-     { 7, 10, 6, 5, 11, 4, 4, 11, 2, 4, 2, 0, -1, -1, -1, -1}, /* 166 12 */
-     { 3, 8, 4, 3, 4, 5, 3, 5, 2, 11, 2, 5, 10, 6, 7, -1}, /* 167 6 */
-     { 7, 3, 2, 7, 2, 6, 5, 9, 4, -1, -1, -1, -1, -1, -1, -1}, /* 168 7 */
-     { 9, 4, 5, 0, 6, 8, 0, 2, 6, 6, 7, 8, -1, -1, -1, -1}, /* 169 12 */
-     { 3, 2, 6, 3, 6, 7, 1, 0, 5, 5, 0, 4, -1, -1, -1, -1}, /* 170 10 */
-     { 6, 8, 2, 6, 7, 8, 2, 8, 1, 4, 5, 8, 1, 8, 5, -1}, /* 171 7 */
-     { 9, 4, 5, 11, 6, 1, 1, 6, 7, 1, 7, 3, -1, -1, -1, -1}, /* 172 12 */
-     { 1, 11, 6, 1, 6, 7, 1, 7, 0, 8, 0, 7, 9, 4, 5, -1}, /* 173 6 */
-     { 4, 11, 0, 4, 5, 11, 0, 11, 3, 6, 7, 11, 3, 11, 7, -1}, /* 174 7 */
-     { 7, 11, 6, 7, 8, 11, 5, 11, 4, 4, 11, 8, -1, -1, -1, -1}, /* 175 3 */
-     { 6, 5, 9, 6, 9, 10, 10, 9, 8, -1, -1, -1, -1, -1, -1, -1}, /* 176 5 */
-     { 3, 10, 6, 0, 3, 6, 0, 6, 5, 0, 5, 9, -1, -1, -1, -1}, /* 177 9 */
-     { 0, 8, 10, 0, 10, 5, 0, 5, 1, 5, 10, 6, -1, -1, -1, -1}, /* 178 14 */
-     { 6, 3, 10, 6, 5, 3, 5, 1, 3, -1, -1, -1, -1, -1, -1, -1}, /* 179 5 */
-     { 1, 11, 2, 9, 10, 5, 9, 8, 10, 10, 6, 5, -1, -1, -1, -1}, /* 180 12 */
-     { 0, 3, 10, 0, 10, 6, 0, 6, 9, 5, 9, 6, 1, 11, 2, -1}, /* 181 6 */
-     {10, 5, 8, 10, 6, 5, 8, 5, 0, 11, 2, 5, 0, 5, 2, -1}, /* 182 7 */
-     { 6, 3, 10, 6, 5, 3, 2, 3, 11, 11, 3, 5, -1, -1, -1, -1}, /* 183 3 */
-     { 5, 9, 8, 5, 8, 2, 5, 2, 6, 3, 2, 8, -1, -1, -1, -1}, /* 184 11 */
-     { 9, 6, 5, 9, 0, 6, 0, 2, 6, -1, -1, -1, -1, -1, -1, -1}, /* 185 5 */
-     { 1, 8, 5, 1, 0, 8, 5, 8, 6, 3, 2, 8, 6, 8, 2, -1}, /* 186 7 */
-     { 1, 6, 5, 2, 6, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 187 2 */
-     { 1, 6, 3, 1, 11, 6, 3, 6, 8, 5, 9, 6, 8, 6, 9, -1}, /* 188 7 */
-     {11, 0, 1, 11, 6, 0, 9, 0, 5, 5, 0, 6, -1, -1, -1, -1}, /* 189 3 */
-     { 0, 8, 3, 5, 11, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 190 4 */
-     {11, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 191 1 */
-     {10, 11, 5, 7, 10, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 192 2 */
-     {10, 11, 5, 10, 5, 7, 8, 0, 3, -1, -1, -1, -1, -1, -1, -1}, /* 193 7 */
-     { 5, 7, 10, 5, 10, 11, 1, 0, 9, -1, -1, -1, -1, -1, -1, -1}, /* 194 7 */
-     {11, 5, 7, 11, 7, 10, 9, 1, 8, 8, 1, 3, -1, -1, -1, -1}, /* 195 10 */
-     {10, 2, 1, 10, 1, 7, 7, 1, 5, -1, -1, -1, -1, -1, -1, -1}, /* 196 5 */
-     { 0, 3, 8, 1, 7, 2, 1, 5, 7, 7, 10, 2, -1, -1, -1, -1}, /* 197 12 */
-     { 9, 5, 7, 9, 7, 2, 9, 2, 0, 2, 7, 10, -1, -1, -1, -1}, /* 198 14 */
-     { 7, 2, 5, 7, 10, 2, 5, 2, 9, 3, 8, 2, 9, 2, 8, -1}, /* 199 7 */
-     { 2, 11, 5, 2, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1}, /* 200 5 */
-     { 8, 0, 2, 8, 2, 5, 8, 5, 7, 11, 5, 2, -1, -1, -1, -1}, /* 201 11 */
-     { 9, 1, 0, 5, 3, 11, 5, 7, 3, 3, 2, 11, -1, -1, -1, -1}, /* 202 12 */
-     { 9, 2, 8, 9, 1, 2, 8, 2, 7, 11, 5, 2, 7, 2, 5, -1}, /* 203 7 */
-     { 1, 5, 3, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 204 8 */
-     { 0, 7, 8, 0, 1, 7, 1, 5, 7, -1, -1, -1, -1, -1, -1, -1}, /* 205 5 */
-     { 9, 3, 0, 9, 5, 3, 5, 7, 3, -1, -1, -1, -1, -1, -1, -1}, /* 206 5 */
-     { 9, 7, 8, 5, 7, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 207 2 */
-     { 5, 4, 8, 5, 8, 11, 11, 8, 10, -1, -1, -1, -1, -1, -1, -1}, /* 208 5 */
-     { 5, 4, 0, 5, 0, 10, 5, 10, 11, 10, 0, 3, -1, -1, -1, -1}, /* 209 14 */
-     { 0, 9, 1, 8, 11, 4, 8, 10, 11, 11, 5, 4, -1, -1, -1, -1}, /* 210 12 */
-     {11, 4, 10, 11, 5, 4, 10, 4, 3, 9, 1, 4, 3, 4, 1, -1}, /* 211 7 */
-     { 2, 1, 5, 2, 5, 8, 2, 8, 10, 4, 8, 5, -1, -1, -1, -1}, /* 212 11 */
-     { 0, 10, 4, 0, 3, 10, 4, 10, 5, 2, 1, 10, 5, 10, 1, -1}, /* 213 7 */
-     { 0, 5, 2, 0, 9, 5, 2, 5, 10, 4, 8, 5, 10, 5, 8, -1}, /* 214 7 */
-     { 9, 5, 4, 2, 3, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 215 4 */
-     { 2, 11, 5, 3, 2, 5, 3, 5, 4, 3, 4, 8, -1, -1, -1, -1}, /* 216 9 */
-     { 5, 2, 11, 5, 4, 2, 4, 0, 2, -1, -1, -1, -1, -1, -1, -1}, /* 217 5 */
-     { 3, 2, 11, 3, 11, 5, 3, 5, 8, 4, 8, 5, 0, 9, 1, -1}, /* 218 6 */
-     { 5, 2, 11, 5, 4, 2, 1, 2, 9, 9, 2, 4, -1, -1, -1, -1}, /* 219 3 */
-     { 8, 5, 4, 8, 3, 5, 3, 1, 5, -1, -1, -1, -1, -1, -1, -1}, /* 220 5 */
-     { 0, 5, 4, 1, 5, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 221 2 */
-     { 8, 5, 4, 8, 3, 5, 9, 5, 0, 0, 5, 3, -1, -1, -1, -1}, /* 222 3 */
-     { 9, 5, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 223 1 */
-     { 4, 7, 10, 4, 10, 9, 9, 10, 11, -1, -1, -1, -1, -1, -1, -1}, /* 224 5 */
-     { 0, 3, 8, 4, 7, 9, 9, 7, 10, 9, 10, 11, -1, -1, -1, -1}, /* 225 12 */
-     { 1, 10, 11, 1, 4, 10, 1, 0, 4, 7, 10, 4, -1, -1, -1, -1}, /* 226 11 */
-     { 3, 4, 1, 3, 8, 4, 1, 4, 11, 7, 10, 4, 11, 4, 10, -1}, /* 227 7 */
-     { 4, 7, 10, 9, 4, 10, 9, 10, 2, 9, 2, 1, -1, -1, -1, -1}, /* 228 9 */
-     { 9, 4, 7, 9, 7, 10, 9, 10, 1, 2, 1, 10, 0, 3, 8, -1}, /* 229 6 */
-     {10, 4, 7, 10, 2, 4, 2, 0, 4, -1, -1, -1, -1, -1, -1, -1}, /* 230 5 */
-     {10, 4, 7, 10, 2, 4, 8, 4, 3, 3, 4, 2, -1, -1, -1, -1}, /* 231 3 */
-     { 2, 11, 9, 2, 9, 7, 2, 7, 3, 7, 9, 4, -1, -1, -1, -1}, /* 232 14 */
-     { 9, 7, 11, 9, 4, 7, 11, 7, 2, 8, 0, 7, 2, 7, 0, -1}, /* 233 7 */
-     { 3, 11, 7, 3, 2, 11, 7, 11, 4, 1, 0, 11, 4, 11, 0, -1}, /* 234 7 */
-     { 1, 2, 11, 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 235 4 */
-     { 4, 1, 9, 4, 7, 1, 7, 3, 1, -1, -1, -1, -1, -1, -1, -1}, /* 236 5 */
-     { 4, 1, 9, 4, 7, 1, 0, 1, 8, 8, 1, 7, -1, -1, -1, -1}, /* 237 3 */
-     { 4, 3, 0, 7, 3, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 238 2 */
-     { 4, 7, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 239 1 */
-     { 9, 8, 11, 11, 8, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 240 8 */
-     { 3, 9, 0, 3, 10, 9, 10, 11, 9, -1, -1, -1, -1, -1, -1, -1}, /* 241 5 */
-     { 0, 11, 1, 0, 8, 11, 8, 10, 11, -1, -1, -1, -1, -1, -1, -1}, /* 242 5 */
-     { 3, 11, 1, 10, 11, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 243 2 */
-     { 1, 10, 2, 1, 9, 10, 9, 8, 10, -1, -1, -1, -1, -1, -1, -1}, /* 244 5 */
-     { 3, 9, 0, 3, 10, 9, 1, 9, 2, 2, 9, 10, -1, -1, -1, -1}, /* 245 3 */
-     { 0, 10, 2, 8, 10, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 246 2 */
-     { 3, 10, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 247 1 */
-     { 2, 8, 3, 2, 11, 8, 11, 9, 8, -1, -1, -1, -1, -1, -1, -1}, /* 248 5 */
-     { 9, 2, 11, 0, 2, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 249 2 */
-     { 2, 8, 3, 2, 11, 8, 0, 8, 1, 1, 8, 11, -1, -1, -1, -1}, /* 250 3 */
-     { 1, 2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 251 1 */
-     { 1, 8, 3, 9, 8, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 252 2 */
-     { 0, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 253 1 */
-     { 0, 8, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}, /* 254 1 */
-     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1}
-  }; /* 255 0 */
-
-  /*! marching-cubes case tables, from VTK */
-  const int8_t vtkMarchingCubes_edges[12][2]
-  = { {0,1}, {1,2}, {3,2}, {0,3},
-      {4,5}, {5,6}, {7,6}, {4,7},
-      {0,4}, {1,5}, {3,7}, {2,6}};
-
   struct FatVertex {
     vec3f pos;
     uint32_t idx;
   };
 
-  struct FatVertexCompare {
-    inline bool operator()(const FatVertex &a, const FatVertex &b) const
-    {
-      return memcmp(&a,&b,sizeof(a)) < 0; // a.pos < b.pos;
-    }
+  /*! the edge of the input mesh that a fat vertex got generated on:
+      the mesh vertex indices of the edge's two end points, and the
+      interpolation weight of the second one. Vertices that are
+      exactly on one of the end points refer to only that vertex (in
+      both indices); vertices generated by grid cells (which don't
+      have any mesh vertex indices) use -1 */
+  struct EdgeRef {
+    int   v0, v1;
+    float t;
   };
+
+  /*! the output of marching cells: three fat vertices per triangle,
+      and - only if 'withEdges' is set - one edge ref for each of
+      those */
+  struct MarchedVertices {
+    MarchedVertices(bool withEdges=false) : withEdges(withEdges) {}
+    ScratchVector<FatVertex> fat;
+    ScratchVector<EdgeRef>   edges;
+    bool                   withEdges;
+  };
+
+  /*! the i'th four bytes of a fat vertex's position, as a radix sort
+      key that orders the same way memcmp() orders these bytes */
+  inline uint32_t memcmpKey(const FatVertex &v, int i)
+  {
+    const uint8_t *bytes = (const uint8_t *)&v.pos + 4*i;
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16)
+      |    (uint32_t(bytes[2]) <<  8) |  uint32_t(bytes[3]);
+  }
+
+  /*! sorts fat vertices the same way as memcmp()'ing their positions
+      would (which, unlike comparing floats, is a total order even for
+      NaNs), so all vertices with the same position end up next to
+      each other */
+  void sortFatVertices(ScratchVector<FatVertex> &fatVertices)
+  {
+    parallel_radix_sort(fatVertices,[](const FatVertex &v)
+                        { return memcmpKey(v,2); });
+    parallel_radix_sort(fatVertices,[](const FatVertex &v)
+                        { return (uint64_t(memcmpKey(v,0)) << 32) | memcmpKey(v,1); });
+  }
   
   /*! run marhing-cubes on given 8-vertex hexahedraon, in VTK vertex
       ordering; and write every potentially gnerated triangle into the
       'out' array, using three full vertices for each triangle (we'll
-      worry about vertex indexing later on */
-  void process(std::vector<FatVertex> &out,
+      worry about vertex indexing later on. Each vertex' 'idx' gets
+      set to given tag. 'vertexIdx' are the corners' mesh vertex
+      indices (if any), for the edge refs */
+  void process(MarchedVertices &out,
                const vec4f vertex[8],
-               const float isoValue)
+               const int *vertexIdx,
+               const float isoValue,
+               const uint32_t tag)
   {
     int index = 0;
     for (int i=0;i<8;i++)
@@ -320,7 +96,8 @@ namespace umesh {
     for (const int8_t *edge = &vtkMarchingCubesTriangleCases[index][0];
          edge[0] > -1;
          edge += 3 ) {
-      vec3f triVertex[3];
+      vec3f   triVertex[3];
+      EdgeRef triEdge[3];
       for (int ii=0; ii<3; ii++) {
         const int8_t *vert = vtkMarchingCubes_edges[edge[ii]];
         const vec4f v0 = ((vertex[vert[0]]));
@@ -333,6 +110,14 @@ namespace umesh {
         triVertex[ii].x = float((1.f-t)*v0.x+t*v1.x);
         triVertex[ii].y = float((1.f-t)*v0.y+t*v1.y);
         triVertex[ii].z = float((1.f-t)*v0.z+t*v1.z);
+        if (!vertexIdx)
+          triEdge[ii] = { -1,-1,0.f };
+        else if (t == 0.)
+          triEdge[ii] = { vertexIdx[vert[0]],vertexIdx[vert[0]],0.f };
+        else if (t == 1.)
+          triEdge[ii] = { vertexIdx[vert[1]],vertexIdx[vert[1]],0.f };
+        else
+          triEdge[ii] = { vertexIdx[vert[0]],vertexIdx[vert[1]],float(t) };
       }
       
       if (triVertex[1] == triVertex[0]) continue;
@@ -340,245 +125,365 @@ namespace umesh {
       if (triVertex[1] == triVertex[2]) continue;
       
       for (int j=0;j<3;j++)
-        out.push_back({triVertex[j],0});
+        out.fat.push_back({triVertex[j],tag});
+      if (out.withEdges)
+        for (int j=0;j<3;j++)
+          out.edges.push_back(triEdge[j]);
     }
   }
 
-  /*! blow a tet up into a hex (by replicating vertices), then run MC
-      tables on that hex */
-  void process(std::vector<FatVertex> &out,
-               UMesh::SP in,
-               const UMesh::Tet &tet,
-               const float isoValue)
-  {
-    const vec4f a(in->vertices[tet.x],in->perVertex->values[tet.x]);
-    const vec4f b(in->vertices[tet.y],in->perVertex->values[tet.y]);
-    const vec4f c(in->vertices[tet.z],in->perVertex->values[tet.z]);
-    const vec4f d(in->vertices[tet.w],in->perVertex->values[tet.w]);
-    vec4f asHex[8] = { a,b,c,c, d,d,d,d };
-#if 0
-    float lo = min(min(a.w,b.w),min(c.w,d.w));
-    float hi = max(max(a.w,b.w),max(c.w,d.w));
-    if (isoValue >= lo && isoValue <= hi) {
-      out.push_back({vec3f(a),0});
-      out.push_back({vec3f(b),0});
-      out.push_back({vec3f(c),0});
-
-      out.push_back({vec3f(a),0});
-      out.push_back({vec3f(b),0});
-      out.push_back({vec3f(d),0});
-
-      out.push_back({vec3f(a),0});
-      out.push_back({vec3f(c),0});
-      out.push_back({vec3f(d),0});
-
-      out.push_back({vec3f(b),0});
-      out.push_back({vec3f(c),0});
-      out.push_back({vec3f(d),0});
-    }
-#else
-    process(out,asHex,isoValue);
-#endif
-  }
-
-  /*! blow a pyr up into a hex (by replicating vertices), then run MC
-      tables on that hex */
-  void process(std::vector<FatVertex> &out,
-               UMesh::SP in,
-               const UMesh::Pyr &pyr,
-               const float isoValue)
-  {
-    const vec4f v0(in->vertices[pyr[0]],in->perVertex->values[pyr[0]]);
-    const vec4f v1(in->vertices[pyr[1]],in->perVertex->values[pyr[1]]);
-    const vec4f v2(in->vertices[pyr[2]],in->perVertex->values[pyr[2]]);
-    const vec4f v3(in->vertices[pyr[3]],in->perVertex->values[pyr[3]]);
-    const vec4f v4(in->vertices[pyr[4]],in->perVertex->values[pyr[4]]);
-    vec4f asHex[8] = { v0,v1,v2,v3, v4,v4,v4,v4 };
-    process(out,asHex,isoValue);
-  }
-  
-  /*! blow a wedge up into a hex (by replicating vertices), then run MC
-      tables on that hex */
-  void process(std::vector<FatVertex> &out,
-               UMesh::SP in,
-               const UMesh::Wedge &wedge,
-               const float isoValue)
-  {
-    const vec4f v0(in->vertices[wedge[0]],in->perVertex->values[wedge[0]]);
-    const vec4f v1(in->vertices[wedge[1]],in->perVertex->values[wedge[1]]);
-    const vec4f v2(in->vertices[wedge[2]],in->perVertex->values[wedge[2]]);
-    const vec4f v3(in->vertices[wedge[3]],in->perVertex->values[wedge[3]]);
-    const vec4f v4(in->vertices[wedge[4]],in->perVertex->values[wedge[4]]);
-    const vec4f v5(in->vertices[wedge[5]],in->perVertex->values[wedge[5]]);
-    vec4f asHex[8] = { v0,v1,v4,v3,v2,v2,v5,v5 };
-    process(out,asHex,isoValue);
+  /*! blow a tet up into a hex (by replicating vertices) */
+  void gatherCorners(int idx[8], const UMesh::Tet &tet)
+  {
+    const int corners[8] = { tet.x,tet.y,tet.z,tet.z, tet.w,tet.w,tet.w,tet.w };
+    std::copy(corners,corners+8,idx);
   }
-  
-  /*! convert our hex representation to 8x{vec3f+scalar}, then run MC
-      tabless */
-  void process(std::vector<FatVertex> &out,
-               UMesh::SP in,
-               const UMesh::Hex &hex,
-               const float isoValue)
-  {
-    const vec4f v0(in->vertices[hex[0]],in->perVertex->values[hex[0]]);
-    const vec4f v1(in->vertices[hex[1]],in->perVertex->values[hex[1]]);
-    const vec4f v2(in->vertices[hex[2]],in->perVertex->values[hex[2]]);
-    const vec4f v3(in->vertices[hex[3]],in->perVertex->values[hex[3]]);
-    const vec4f v4(in->vertices[hex[4]],in->perVertex->values[hex[4]]);
-    const vec4f v5(in->vertices[hex[5]],in->perVertex->values[hex[5]]);
-    const vec4f v6(in->vertices[hex[6]],in->perVertex->values[hex[6]]);
-    const vec4f v7(in->vertices[hex[7]],in->perVertex->values[hex[7]]);
-    vec4f asHex[8] = { v0,v1,v2,v3,v4,v5,v6,v7 };
-    process(out,asHex,isoValue);
+
+  /*! blow a pyr up into a hex (by replicating vertices) */
+  void gatherCorners(int idx[8], const UMesh::Pyr &pyr)
+  {
+    const int corners[8] = { pyr[0],pyr[1],pyr[2],pyr[3], pyr[4],pyr[4],pyr[4],pyr[4] };
+    std::copy(corners,corners+8,idx);
   }
   
-  void doIsoSurfacePyrs(std::vector<FatVertex> &out,
-                        std::mutex &mutex,
-                        UMesh::SP in,
-                        size_t begin,
-                        size_t end,
-                        const float isoValue)
+  /*! blow a wedge up into a hex (by replicating vertices) */
+  void gatherCorners(int idx[8], const UMesh::Wedge &wedge)
   {
-    std::vector<FatVertex> localVertices;
-    for (size_t i=begin;i<end;i++)
-      process(localVertices,in,in->pyrs[i],isoValue);
-
-    std::lock_guard<std::mutex> lock(mutex);
-    std::copy(localVertices.begin(),
-              localVertices.end(),
-              std::back_insert_iterator<std::vector<FatVertex>>(out));
+    const int corners[8] = { wedge[0],wedge[1],wedge[4],wedge[3],
+                             wedge[2],wedge[2],wedge[5],wedge[5] };
+    std::copy(corners,corners+8,idx);
   }
   
-  void doIsoSurfaceWedges(std::vector<FatVertex> &out,std::mutex &mutex,
-                          UMesh::SP in,
-                          size_t begin,
-                          size_t end,
-                          const float isoValue)
+  /*! hexes already are in the right order */
+  void gatherCorners(int idx[8], const UMesh::Hex &hex)
   {
-    std::vector<FatVertex> localVertices;
-    for (size_t i=begin;i<end;i++)
-      process(localVertices,in,in->wedges[i],isoValue);
+    for (int i=0;i<8;i++)
+      idx[i] = hex[i];
+  }
+
+  /*! the iso-values to extract, sorted by value, so each cell can
+      quickly find the ones within its value range */
+  struct IsoValues {
+    IsoValues(const std::vector<float> &isoValues)
+    {
+      // NaN iso-values can never produce any triangles
+      for (size_t i=0;i<isoValues.size();i++)
+        if (!std::isnan(isoValues[i]))
+          sorted.push_back({isoValues[i],uint32_t(i)});
+      std::stable_sort(sorted.begin(),sorted.end(),
+                       [](const Entry &a, const Entry &b){ return a.value < b.value; });
+    }
+    struct Entry {
+      float    value;
+      /*! index of this value in the list the user specified */
+      uint32_t index;
+    };
+    std::vector<Entry> sorted;
 
-    std::lock_guard<std::mutex> lock(mutex);
-    std::copy(localVertices.begin(),
-              localVertices.end(),
-              std::back_insert_iterator<std::vector<FatVertex>>(out));
+    typedef std::vector<Entry>::const_iterator Iterator;
+
+    /*! finds the (sorted) iso-values that a cell with given corner
+        values can produce triangles for: a cell has triangles for
+        iso-value v only if at least one corner is above (> v) and at
+        least one is not; NaN values count as "not above" any
+        iso-value */
+    inline void findActive(const float w[8], Iterator &begin, Iterator &end) const
+    {
+      float lo = +std::numeric_limits<float>::infinity();
+      float hi = -std::numeric_limits<float>::infinity();
+      for (int i=0;i<8;i++) {
+        const float v = std::isnan(w[i]) ? -std::numeric_limits<float>::infinity() : w[i];
+        lo = std::min(lo,v);
+        hi = std::max(hi,v);
+      }
+      begin = std::lower_bound(sorted.begin(),sorted.end(),lo,
+                               [](const Entry &e, float v){ return e.value < v; });
+      end = begin;
+      while (end != sorted.end() && end->value < hi) ++end;
+    }
+  };
+
+  /*! what marching cubes classifies a cell's corners by, given their
+      (x,y,z,scalar) values: for iso-surfaces, the scalar */
+  struct ScalarClassifier {
+    inline float operator()(const vec4f &v) const { return v.w; }
+  };
+
+  /*! same, for slices: the corner's signed distance to the plane
+      (a,b,c,d), which is 0 on the plane, so slices are iso-surfaces
+      for iso-value 0. This is monotonic in each coordinate, so a box's
+      distance range can be computed from two of its corners */
+  struct PlaneClassifier {
+    PlaneClassifier(const vec4f &plane) : plane(plane) {}
+    inline float operator()(const vec4f &v) const
+    { return plane.x*v.x+plane.y*v.y+plane.z*v.z+plane.w; }
+    const vec4f plane;
+  };
+
+  /*! gathers the prim's corners (only once), and runs marching cubes
+      on them for each iso-value the prim can produce triangles for */
+  template<typename Prim, typename Classifier>
+  void process(MarchedVertices &out,
+               const vec4f *xyzs,
+               const Prim &prim,
+               const IsoValues &isoValues,
+               const Classifier &classify)
+  {
+    int idx[8];
+    gatherCorners(idx,prim);
+    vec4f asHex[8];
+    for (int i=0;i<8;i++) {
+      asHex[i] = xyzs[idx[i]];
+      asHex[i].w = classify(asHex[i]);
+    }
+    const float w[8] = { asHex[0].w,asHex[1].w,asHex[2].w,asHex[3].w,
+                         asHex[4].w,asHex[5].w,asHex[6].w,asHex[7].w };
+    IsoValues::Iterator begin, end;
+    isoValues.findActive(w,begin,end);
+    for (auto it = begin; it != end; ++it)
+      process(out,asHex,idx,it->value,it->index);
   }
-  
-  void doIsoSurfaceHexes(std::vector<FatVertex> &out,std::mutex &mutex,
-                         UMesh::SP in,
-                         size_t begin,
-                         size_t end,
-                         const float isoValue)
+
+  /*! concatenates - in order, in parallel, and without any locking -
+      all given blocks' fat vertices (and edge refs) to 'out', at
+      offsets computed through a prefix sum over the blocks' output
+      sizes; and frees the blocks' vertices */
+  void appendBlocks(MarchedVertices &out,
+                    std::vector<MarchedVertices> &blockVertices)
   {
-    std::vector<FatVertex> localVertices;
-    for (size_t i=begin;i<end;i++)
-      process(localVertices,in,in->hexes[i],isoValue);
+    const size_t numBlocks = blockVertices.size();
+    std::vector<size_t> blockOffset(numBlocks+1,out.fat.size());
+    for (size_t blockID=0;blockID<numBlocks;blockID++)
+      blockOffset[blockID+1] = blockOffset[blockID]+blockVertices[blockID].fat.size();
+    out.fat.resize(blockOffset[numBlocks]);
+    if (out.withEdges)
+      out.edges.resize(blockOffset[numBlocks]);
+    parallel_for(numBlocks,[&](size_t blockID){
+        MarchedVertices &local = blockVertices[blockID];
+        std::copy(local.fat.begin(),local.fat.end(),
+                  out.fat.begin()+blockOffset[blockID]);
+        std::copy(local.edges.begin(),local.edges.end(),
+                  out.edges.begin()+blockOffset[blockID]);
+        local = MarchedVertices();
+      });
+  }
 
-    std::lock_guard<std::mutex> lock(mutex);
-    std::copy(localVertices.begin(),
-              localVertices.end(),
-              std::back_insert_iterator<std::vector<FatVertex>>(out));
+  /*! finds the range of prims of given type in a list of prim refs
+      that is sorted by type */
+  void findPrimsOfType(const std::vector<UMesh::PrimRef> &primRefs,
+                       UMesh::PrimType type,
+                       const UMesh::PrimRef *&begin,
+                       const UMesh::PrimRef *&end)
+  {
+    auto byType = [](const UMesh::PrimRef &pr, UMesh::PrimType type)
+    { return UMesh::PrimType(pr.type) < type; };
+    auto first = std::lower_bound(primRefs.begin(),primRefs.end(),type,byType);
+    auto last  = std::lower_bound(first,primRefs.end(),UMesh::PrimType(type+1),byType);
+    begin = primRefs.data()+(first-primRefs.begin());
+    end   = primRefs.data()+(last-primRefs.begin());
   }
-  
-  void doIsoSurfaceTets(std::vector<FatVertex> &out,
-                        std::mutex &mutex,
-                        UMesh::SP in,
-                        size_t begin,
-                        size_t end,
-                        const float isoValue)
+
+  /*! runs marching cubes on the given prims (either all of them, or
+      - if 'activeIDs' is specified - only those with the 'numActive'
+      given IDs), and appends the resulting fat vertices to
+      'out'. Each block of prims writes to its own (local) output
+      array; once all are done, those get appended to 'out'. 'xyzs'
+      are the mesh's (packed) vertices and scalars */
+  template<typename Prim, typename Classifier>
+  void doIsoSurface(MarchedVertices &out,
+                    const vec4f *xyzs,
+                    const std::vector<Prim> &prims,
+                    const UMesh::PrimRef *activeIDs,
+                    size_t numActive,
+                    const IsoValues &isoValues,
+                    const Classifier &classify)
   {
-    std::vector<FatVertex> localVertices;
-    for (size_t i=begin;i<end;i++)
-      process(localVertices,in,in->tets[i],isoValue);
+    const size_t numPrims  = activeIDs ? numActive : prims.size();
+    const size_t blockSize = 1024;
+    const size_t numBlocks = divRoundUp(numPrims,blockSize);
+    std::vector<MarchedVertices> blockVertices(numBlocks,
+                                               MarchedVertices(out.withEdges));
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*blockSize;
+        const size_t end   = std::min(begin+blockSize,numPrims);
+        for (size_t i=begin;i<end;i++)
+          process(blockVertices[blockID],xyzs,
+                  prims[activeIDs ? size_t(activeIDs[i].ID) : i],isoValues,classify);
+      });
+    appendBlocks(out,blockVertices);
+  }
 
-    std::lock_guard<std::mutex> lock(mutex);
-    std::copy(localVertices.begin(),
-              localVertices.end(),
-              std::back_insert_iterator<std::vector<FatVertex>>(out));
+  /*! same as doIsoSurface(), for prims of given type; 'active' (if
+      specified) are the cells to process, sorted by type and ID */
+  template<typename Prim, typename Classifier>
+  void doIsoSurface(MarchedVertices &out,
+                    const vec4f *xyzs,
+                    const std::vector<Prim> &prims,
+                    UMesh::PrimType type,
+                    const std::vector<UMesh::PrimRef> *active,
+                    const IsoValues &isoValues,
+                    const Classifier &classify)
+  {
+    if (!active) {
+      doIsoSurface(out,xyzs,prims,nullptr,0,isoValues,classify);
+      return;
+    }
+    const UMesh::PrimRef *begin, *end;
+    findPrimsOfType(*active,type,begin,end);
+    if (begin == end) return;
+    doIsoSurface(out,xyzs,prims,begin,end-begin,isoValues,classify);
   }
-  
-  /*! given a umesh with volumetric elemnets (any sort), compute a new
-    umesh (containing only triangles) that contains the triangular
-    iso-surface for given iso-value. Input *must* have a per-vertex
-    scalar field, but can have any combinatoin of volumetric
-    elemnets; tris and quads in the input get ignored; input remains
-    unchanged. */
-  UMesh::SP extractIsoSurface(UMesh::SP in, float isoValue)
+
+  /*! position of vertex (ix,iy,iz) of given grid, interpolated such
+      that the grid's outermost vertices are exactly on its domain's
+      boundary (and thus match those of neighboring grids) */
+  inline float gridCoord(float lower, float upper, int i, int numCells)
   {
-    if (!in) throw std::runtime_error("null input mesh");
-    if (!in->perVertex) throw std::runtime_error("input mesh w/o scalar field");
-    
-    UMesh::SP out = std::make_shared<UMesh>();
-    std::mutex mutex;
+    const float t = i/float(numCells);
+    return (1.f-t)*lower + t*upper;
+  }
 
-    std::vector<FatVertex> fatVertices;
-    
-    if (verbose)
-      std::cout << "#umesh.iso: pushing " << prettyNumber(in->tets.size())
-              << " tets" << std::endl;
-    parallel_for_blocked
-      (0,in->tets.size(),1024,
-       [&](size_t begin, size_t end){
-        doIsoSurfaceTets(fatVertices,mutex,in,begin,end,isoValue);
-      });
+  /*! runs marching cubes on all cells in slice 'iz' of given grid;
+      since grid vertices are in VTK hex order this produces exactly
+      the same triangles as if each cell was a hex */
+  template<typename Classifier>
+  void processGridSlice(MarchedVertices &out,
+                        UMesh::SP in,
+                        const Grid &grid,
+                        int iz,
+                        const IsoValues &isoValues,
+                        const Classifier &classify)
+  {
+    const vec3i n  = grid.numCells;
+    const size_t sx  = n.x+1;
+    const size_t sxy = sx*(n.y+1);
+    const float *slice = in->gridScalars.data()+grid.scalarsOffset+iz*sxy;
+    const box4f &domain = grid.domain;
+    std::vector<float> xs(n.x+1), ys(n.y+1);
+    for (int i=0;i<=n.x;i++) xs[i] = gridCoord(domain.lower.x,domain.upper.x,i,n.x);
+    for (int i=0;i<=n.y;i++) ys[i] = gridCoord(domain.lower.y,domain.upper.y,i,n.y);
+    const float z0 = gridCoord(domain.lower.z,domain.upper.z,iz,  n.z);
+    const float z1 = gridCoord(domain.lower.z,domain.upper.z,iz+1,n.z);
+    for (int iy=0;iy<n.y;iy++)
+      for (int ix=0;ix<n.x;ix++) {
+        const float *s = slice+ix+iy*sx;
+        const float x0 = xs[ix], x1 = xs[ix+1];
+        const float y0 = ys[iy], y1 = ys[iy+1];
+        vec4f asHex[8] = {
+          vec4f(x0,y0,z0,s[0]),     vec4f(x1,y0,z0,s[1]),
+          vec4f(x1,y1,z0,s[sx+1]),  vec4f(x0,y1,z0,s[sx]),
+          vec4f(x0,y0,z1,s[sxy+0]), vec4f(x1,y0,z1,s[sxy+1]),
+          vec4f(x1,y1,z1,s[sxy+sx+1]), vec4f(x0,y1,z1,s[sxy+sx])
+        };
+        float w[8];
+        for (int i=0;i<8;i++)
+          w[i] = asHex[i].w = classify(asHex[i]);
+        IsoValues::Iterator begin, end;
+        isoValues.findActive(w,begin,end);
+        if (begin == end) continue;
+        for (auto it = begin; it != end; ++it)
+          process(out,asHex,nullptr,it->value,it->index);
+      }
+  }
 
-#if 1
-    if (verbose)
-    std::cout << "#umesh.iso: pushing " << prettyNumber(in->pyrs.size())
-              << " pyramids" << std::endl;
-    parallel_for_blocked
-      (0,in->pyrs.size(),1024,
-       [&](size_t begin, size_t end){
-        doIsoSurfacePyrs(fatVertices,mutex,in,begin,end,isoValue);
-      });
+  /*! runs marching cubes directly on the cells of all (or, if 'active'
+      is specified, all active) grids, without ever creating any hexes
+      for them. Work gets split into slices of grid cells, each of
+      which writes to its own output array */
+  template<typename Classifier>
+  void doGridIsoSurface(MarchedVertices &out,
+                        UMesh::SP in,
+                        const std::vector<UMesh::PrimRef> *active,
+                        const IsoValues &isoValues,
+                        const Classifier &classify)
+  {
+    const UMesh::PrimRef *begin = nullptr, *end = nullptr;
+    if (active) findPrimsOfType(*active,UMesh::GRID,begin,end);
+    const size_t numGrids = active ? size_t(end-begin) : in->grids.size();
 
-    if (verbose)
-    std::cout << "#umesh.iso: pushing " << prettyNumber(in->wedges.size())
-              << " wedges" << std::endl;
-    parallel_for_blocked
-      (0,in->wedges.size(),1024,
-       [&](size_t begin, size_t end){
-        doIsoSurfaceWedges(fatVertices,mutex,in,begin,end,isoValue);
+    // (gridID,slice) pairs to process
+    std::vector<std::pair<size_t,int>> slices;
+    for (size_t i=0;i<numGrids;i++) {
+      const size_t gridID = active ? size_t(begin[i].ID) : i;
+      const Grid &grid = in->grids[gridID];
+      if (grid.numCells.x <= 0 || grid.numCells.y <= 0 || grid.numCells.z <= 0)
+        continue;
+      if (grid.scalarsOffset < 0 ||
+          grid.scalarsOffset+grid.numScalars() > in->gridScalars.size())
+        throw std::runtime_error("grid scalars out of range");
+      for (int iz=0;iz<grid.numCells.z;iz++)
+        slices.push_back({gridID,iz});
+    }
+    std::vector<MarchedVertices> blockVertices(slices.size(),
+                                               MarchedVertices(out.withEdges));
+    parallel_for(slices.size(),[&](size_t sliceID){
+        processGridSlice(blockVertices[sliceID],in,
+                         in->grids[slices[sliceID].first],
+                         slices[sliceID].second,
+                         isoValues,classify);
       });
+    appendBlocks(out,blockVertices);
+  }
 
-    if (verbose)
-    std::cout << "#umesh.iso: pushing " << prettyNumber(in->hexes.size())
-              << " hexes" << std::endl;
-    parallel_for_blocked
-      (0,in->hexes.size(),1024,
-       [&](size_t begin, size_t end){
-        doIsoSurfaceHexes(fatVertices,mutex,in,begin,end,isoValue);
-      });
-#endif
+  /*! the result of marching all cells for a set of iso-values, and
+      welding the resulting vertices: one triangle mesh with all
+      surfaces, where vertices are never shared between surfaces of
+      different iso-values, and the vertices of each iso-value's
+      surface are stored contiguously */
+  struct IsoSurfaces {
+    UMesh::SP             mesh;
+    /*! for each triangle, the index of its iso-value */
+    std::vector<uint32_t> triangleIsoIdx;
+    /*! for each iso-value, the index of the first vertex of its
+        surface (plus one final entry for the total number of
+        vertices) */
+    std::vector<int>      firstVertex;
+  };
+  
+  /*! welds the fat vertices by exact position, by sorting them: fills
+      in the surfaces' vertices, triangles, and first vertices, and
+      stores the (index of the) fat vertex each vertex came from in
+      'vertexSource' */
+  void weldByPosition(IsoSurfaces &result,
+                      ScratchVector<FatVertex> &fatVertices,
+                      size_t numIsoValues,
+                      std::vector<uint32_t> &vertexSource)
+  {
+    UMesh::SP out = result.mesh;
+    const std::vector<uint32_t> &triangleIsoIdx = result.triangleIsoIdx;
     const int numFatVertices = (int)fatVertices.size();
-    if (verbose)
-    std::cout << "#umesh.iso: found " << prettyNumber(numFatVertices/3) << " triangles ..." << std::endl;
-    if (verbose)
-    std::cout << "#umesh.iso: creating vertex/index arrays ..." << std::endl;
     for (int i=0;i<numFatVertices;i++)
       fatVertices[i].idx = i;
-#if UMESH_HAVE_TBB
-      tbb::parallel_sort(fatVertices.begin(),fatVertices.end(),FatVertexCompare());
-#else
-      std::sort(fatVertices.begin(),fatVertices.end(),FatVertexCompare());
-#endif
+    sortFatVertices(fatVertices);
+    if (numIsoValues > 1)
+      parallel_radix_sort(fatVertices,[&](const FatVertex &v)
+                          { return triangleIsoIdx[v.idx/3]; });
+    auto isoIdxOf = [&](int i) { return triangleIsoIdx[fatVertices[i].idx/3]; };
+    auto isNewVertex = [&](int i) {
+      return (i==0)
+        || (fatVertices[i].pos != fatVertices[i-1].pos)
+        || (isoIdxOf(i) != isoIdxOf(i-1));
+    };
 
     int numUniqueVertices = 0;
     for (int i=0;i<numFatVertices;i++)
-      if ((i==0) || (fatVertices[i].pos != fatVertices[i-1].pos))
+      if (isNewVertex(i))
         ++numUniqueVertices;
     if (verbose)
     std::cout << "#umesh.iso: found " << prettyNumber(numUniqueVertices) << " unique vertices ..." << std::endl;
     out->triangles.resize(numFatVertices/3);
     out->vertices.resize(numUniqueVertices);
+    vertexSource.resize(numUniqueVertices);
+    result.firstVertex.resize(numIsoValues+1,numUniqueVertices);
     int uniqueVertexID = -1;
     for (int i=0;i<numFatVertices;i++) {
       const auto &vtx = fatVertices[i];
-      if (i==0 || vtx.pos != fatVertices[i-1].pos) {
+      if (isNewVertex(i)) {
         ++uniqueVertexID;
         out->vertices[uniqueVertexID] = vtx.pos;
+        vertexSource[uniqueVertexID] = vtx.idx;
+        if (i == 0 || isoIdxOf(i) != isoIdxOf(i-1))
+          result.firstVertex[isoIdxOf(i)] = uniqueVertexID;
       }
       /* this line assumes that every triangle is three ints - make
          sure that's the case! */
@@ -587,7 +492,514 @@ namespace umesh {
                     "are three ints, and nothing but");
       ((int*)out->triangles.data())[vtx.idx] = uniqueVertexID;
     }
-    return out;
+  }
+
+  /*! concurrent hash table for welding fat vertices by the mesh edge
+      they got generated on, and the iso-value they belong to. Each
+      slot gets claimed by CAS'ing its key from EMPTY to BUSY, and
+      becomes visible to other threads once the final key gets
+      stored. For each key, the table tracks the smallest index of
+      all fat vertices with this key (its 'owner'), so the result does
+      not depend on the order in which threads insert vertices */
+  struct EdgeHashTable {
+    static const uint64_t EMPTY = ~0ull;
+    static const uint64_t BUSY  = ~0ull-1;
+    
+    struct Slot {
+      std::atomic<uint64_t> key;
+      uint32_t              tag;
+      std::atomic<uint32_t> owner;
+    };
+
+    EdgeHashTable(size_t minCapacity)
+    {
+      capacity = 1;
+      while (capacity < minCapacity) capacity *= 2;
+      maxUsed = capacity/8*7;
+      slots.reset(new Slot[capacity]);
+      parallel_for_blocked(0,capacity,64*1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            slots[i].key.store(EMPTY,std::memory_order_relaxed);
+        });
+    }
+
+    /*! inserts fat vertex 'fatID' with given key and tag; returns the
+        slot it ended up in, or -1 if the table is full - in which case
+        the table has to be rebuilt with a larger capacity */
+    int64_t insert(uint64_t key, uint32_t tag, uint32_t fatID)
+    {
+      if (full) return -1;
+      const size_t mask = capacity-1;
+      size_t slotID = ((key ^ (uint64_t(tag) << 48)) * 0x9e3779b97f4a7c15ull) >> 20 & mask;
+      for (size_t probe=0;probe<capacity;probe++,slotID=(slotID+1)&mask) {
+        Slot &slot = slots[slotID];
+        uint64_t current = slot.key.load(std::memory_order_acquire);
+        if (current == EMPTY) {
+          if (slot.key.compare_exchange_strong(current,BUSY)) {
+            slot.tag = tag;
+            slot.owner.store(fatID,std::memory_order_relaxed);
+            slot.key.store(key,std::memory_order_release);
+            if (++numUsed > maxUsed) full = true;
+            return slotID;
+          }
+        }
+        while (current == BUSY)
+          current = slot.key.load(std::memory_order_acquire);
+        if (current == key && slot.tag == tag) {
+          uint32_t owner = slot.owner.load(std::memory_order_relaxed);
+          while (fatID < owner &&
+                 !slot.owner.compare_exchange_weak(owner,fatID,
+                                                   std::memory_order_relaxed))
+            ;
+          return slotID;
+        }
+      }
+      full = true;
+      return -1;
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t                  capacity;
+    size_t                  maxUsed;
+    std::atomic<size_t>     numUsed { 0 };
+    std::atomic<bool>       full { false };
+  };
+
+  /*! welds the fat vertices by the edge they got generated on, using
+      a hash table; output vertices are ordered by iso-value, then by
+      where (in the fat vertex array) they first got used */
+  void weldByEdge(IsoSurfaces &result,
+                  const MarchedVertices &marched,
+                  size_t numIsoValues,
+                  std::vector<uint32_t> &vertexSource)
+  {
+    UMesh::SP out = result.mesh;
+    const std::vector<uint32_t> &triangleIsoIdx = result.triangleIsoIdx;
+    const size_t numFatVertices = marched.fat.size();
+    auto keyOf = [&](size_t i) {
+      const EdgeRef &edge = marched.edges[i];
+      const uint32_t lo = std::min(edge.v0,edge.v1);
+      const uint32_t hi = std::max(edge.v0,edge.v1);
+      return (uint64_t(lo) << 32) | hi;
+    };
+
+    std::unique_ptr<EdgeHashTable> table;
+    ScratchVector<int64_t> slotOf(numFatVertices);
+    for (size_t capacity = numFatVertices/2+1024; ; capacity = 2*numFatVertices+1024) {
+      table.reset(new EdgeHashTable(capacity));
+      parallel_for_blocked(0,numFatVertices,16*1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            slotOf[i] = table->insert(keyOf(i),triangleIsoIdx[i/3],uint32_t(i));
+        });
+      if (!table->full) break;
+    }
+
+    // the owners are the output vertices
+    std::vector<uint32_t> &owners = vertexSource;
+    owners.clear();
+    for (size_t i=0;i<numFatVertices;i++)
+      if (table->slots[slotOf[i]].owner.load(std::memory_order_relaxed) == i)
+        owners.push_back(uint32_t(i));
+    if (numIsoValues > 1)
+      parallel_radix_sort(owners,[&](uint32_t i){ return triangleIsoIdx[i/3]; });
+    const size_t numUniqueVertices = owners.size();
+    if (verbose)
+    std::cout << "#umesh.iso: found " << prettyNumber(numUniqueVertices) << " unique vertices ..." << std::endl;
+
+    out->vertices.resize(numUniqueVertices);
+    result.firstVertex.resize(numIsoValues+1,int(numUniqueVertices));
+    for (size_t i=numUniqueVertices;i-- > 0;)
+      result.firstVertex[triangleIsoIdx[owners[i]/3]] = int(i);
+    // from now on, each slot's owner is the ID of its output vertex
+    parallel_for_blocked(0,numUniqueVertices,16*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          out->vertices[i] = marched.fat[owners[i]].pos;
+          table->slots[slotOf[owners[i]]].owner.store(uint32_t(i),std::memory_order_relaxed);
+        }
+      });
+    out->triangles.resize(numFatVertices/3);
+    parallel_for_blocked(0,numFatVertices,16*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          ((int*)out->triangles.data())[i]
+            = int(table->slots[slotOf[i]].owner.load(std::memory_order_relaxed));
+      });
+  }
+
+  /*! linearly interpolates given per-vertex attribute to the output
+      vertices; vertices that did not get generated on a mesh edge (ie,
+      by grids) get NaN */
+  Attribute::SP interpolate(const Attribute &attribute,
+                            const ScratchVector<EdgeRef> &edges,
+                            const std::vector<uint32_t> &vertexSource)
+  {
+    Attribute::SP result = std::make_shared<Attribute>((int)vertexSource.size());
+    result->name = attribute.name;
+    parallel_for_blocked(0,vertexSource.size(),16*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          const EdgeRef &edge = edges[vertexSource[i]];
+          result->values[i]
+            = (edge.v0 < 0)
+            ? std::numeric_limits<float>::quiet_NaN()
+            : ((1.f-edge.t)*attribute.values[edge.v0]+edge.t*attribute.values[edge.v1]);
+        }
+      });
+    result->finalize();
+    return result;
+  }
+  
+  /*! computes the surfaces for all given values of the function
+      'classify' computes for the cells' corners, visiting each cell
+      only once; if 'active' is specified, only those cells (which
+      must be sorted by type and ID) get visited. If
+      'interpolatePerVertex' is set, the input's perVertex scalars (if
+      any) get interpolated to the output's perVertex */
+  template<typename Classifier>
+  IsoSurfaces computeSurfaces(UMesh::SP in, const std::vector<float> &values,
+                              const IsoSurfaceOptions &options,
+                              const Classifier &classify,
+                              const std::vector<UMesh::PrimRef> *active,
+                              bool interpolatePerVertex)
+  {
+    profile::ScopedTimer timer("iso.compute");
+    IsoValues isoValues(values);
+    IsoSurfaces result;
+    UMesh::SP out = result.mesh = std::make_shared<UMesh>();
+
+    // grid vertices don't have mesh vertex indices to weld by
+    const bool weldByEdges
+      =  options.welding == WELD_BY_EDGE
+      && in->grids.empty();
+    interpolatePerVertex = interpolatePerVertex && in->perVertex;
+    MarchedVertices marched(weldByEdges || options.interpolateAttributes
+                            || interpolatePerVertex);
+
+    // gathering a cell's corners from packed (x,y,z,scalar) vertices
+    // takes one load per corner, vs two (from different arrays) for
+    // the mesh's own vertices and scalars
+    VertexArrays::SP vertexArrays = options.vertexArrays;
+    if (!vertexArrays
+        || vertexArrays->layout != VERTEX_ARRAYS_PACKED
+        || vertexArrays->size() != in->vertices.size())
+      vertexArrays = options.quantizedScalars
+        ? VertexArrays::create(*in,VERTEX_ARRAYS_PACKED,*options.quantizedScalars)
+        : VertexArrays::create(*in,VERTEX_ARRAYS_PACKED);
+    const vec4f *xyzs = vertexArrays->xyzs.data();
+
+    {
+      profile::ScopedTimer timer
+        ("iso.march",0,active ? active->size() : in->size());
+      if (verbose)
+        std::cout << "#umesh.iso: pushing " << prettyNumber(in->tets.size())
+                << " tets" << std::endl;
+      doIsoSurface(marched,xyzs,in->tets,UMesh::TET,active,isoValues,classify);
+
+      if (verbose)
+      std::cout << "#umesh.iso: pushing " << prettyNumber(in->pyrs.size())
+                << " pyramids" << std::endl;
+      doIsoSurface(marched,xyzs,in->pyrs,UMesh::PYR,active,isoValues,classify);
+
+      if (verbose)
+      std::cout << "#umesh.iso: pushing " << prettyNumber(in->wedges.size())
+                << " wedges" << std::endl;
+      doIsoSurface(marched,xyzs,in->wedges,UMesh::WEDGE,active,isoValues,classify);
+
+      if (verbose)
+      std::cout << "#umesh.iso: pushing " << prettyNumber(in->hexes.size())
+                << " hexes" << std::endl;
+      doIsoSurface(marched,xyzs,in->hexes,UMesh::HEX,active,isoValues,classify);
+
+      if (verbose)
+      std::cout << "#umesh.iso: pushing " << prettyNumber(in->grids.size())
+                << " grids" << std::endl;
+      doGridIsoSurface(marched,in,active,isoValues,classify);
+    }
+
+    const size_t numFatVertices = marched.fat.size();
+    if (numFatVertices > size_t(std::numeric_limits<int>::max()))
+      throw std::runtime_error("iso-surface has too many vertices for 32-bit indices");
+    if (verbose)
+    std::cout << "#umesh.iso: found " << prettyNumber(numFatVertices/3) << " triangles ..." << std::endl;
+    if (verbose)
+    std::cout << "#umesh.iso: creating vertex/index arrays ..." << std::endl;
+    // during marching, fat vertices store their iso-value's index
+    std::vector<uint32_t> &triangleIsoIdx = result.triangleIsoIdx;
+    triangleIsoIdx.resize(numFatVertices/3);
+    for (size_t i=0;i<numFatVertices/3;i++)
+      triangleIsoIdx[i] = marched.fat[3*i].idx;
+
+    std::vector<uint32_t> vertexSource;
+    {
+      profile::ScopedTimer timer("iso.weld",0,numFatVertices);
+      if (weldByEdges)
+        weldByEdge(result,marched,values.size(),vertexSource);
+      else
+        weldByPosition(result,marched.fat,values.size(),vertexSource);
+    }
+    // iso-values without any triangles start where the next one does
+    for (int i=(int)values.size()-1;i>=0;--i)
+      result.firstVertex[i] = std::min(result.firstVertex[i],result.firstVertex[i+1]);
+
+    if (options.interpolateAttributes && !in->attributes.empty()) {
+      profile::ScopedTimer timer("iso.interpolate",0,
+                                 in->attributes.size()*vertexSource.size());
+      for (auto attribute : in->attributes) {
+        out->attributes.push_back(interpolate(*attribute,marched.edges,vertexSource));
+        if (interpolatePerVertex && attribute == in->perVertex)
+          out->perVertex = out->attributes.back();
+      }
+    }
+    if (interpolatePerVertex && !out->perVertex)
+      out->perVertex = interpolate(*in->perVertex,marched.edges,vertexSource);
+    if (options.computeNormals)
+      addNormalAttributes(*out,computeVertexNormals(*out));
+    timer.addItems(out->triangles.size());
+    return result;
+  }
+
+  /*! computes the iso-surfaces for all given iso-values, visiting each
+      cell only once; if 'active' is specified, only those cells (which
+      must be sorted by type and ID) get visited */
+  IsoSurfaces computeIsoSurfaces(UMesh::SP in, const std::vector<float> &values,
+                                 const IsoSurfaceOptions &options,
+                                 const std::vector<UMesh::PrimRef> *active = nullptr)
+  {
+    if (!in) throw std::runtime_error("null input mesh");
+    if (!in->perVertex && !options.quantizedScalars &&
+        !(in->tets.empty() && in->pyrs.empty() && in->wedges.empty() && in->hexes.empty()))
+      throw std::runtime_error("input mesh w/o scalar field");
+    return computeSurfaces(in,values,options,ScalarClassifier(),active,false);
+  }
+
+  /*! stores each triangle's iso-value in a "isoValue" element
+      attribute of the surfaces' mesh, and returns that mesh */
+  UMesh::SP tagWithIsoValues(IsoSurfaces &surfaces,
+                             const std::vector<float> &isoValues)
+  {
+    Attribute::SP tag = std::make_shared<Attribute>();
+    tag->name = "isoValue";
+    tag->values.resize(surfaces.triangleIsoIdx.size());
+    for (size_t i=0;i<tag->values.size();i++)
+      tag->values[i] = isoValues[surfaces.triangleIsoIdx[i]];
+    tag->finalize();
+    surfaces.mesh->elementAttributes.push_back({UMesh::TRI,tag});
+    return surfaces.mesh;
+  }
+
+  /*! splits the surfaces' mesh into one mesh per iso-value */
+  std::vector<UMesh::SP> splitByIsoValue(const IsoSurfaces &surfaces,
+                                         size_t numIsoValues)
+  {
+    const UMesh &all = *surfaces.mesh;
+    std::vector<UMesh::SP> result(numIsoValues);
+    for (size_t i=0;i<numIsoValues;i++) {
+      result[i] = std::make_shared<UMesh>();
+      const int begin = surfaces.firstVertex[i];
+      const int end   = surfaces.firstVertex[i+1];
+      result[i]->vertices.assign(all.vertices.begin()+begin,
+                                 all.vertices.begin()+end);
+      for (auto attribute : all.attributes) {
+        Attribute::SP part = std::make_shared<Attribute>();
+        part->name = attribute->name;
+        part->values.assign(attribute->values.begin()+begin,
+                            attribute->values.begin()+end);
+        part->finalize();
+        result[i]->attributes.push_back(part);
+      }
+    }
+    for (size_t i=0;i<all.triangles.size();i++) {
+      const uint32_t isoIdx = surfaces.triangleIsoIdx[i];
+      const int offset = surfaces.firstVertex[isoIdx];
+      const Triangle &tri = all.triangles[i];
+      result[isoIdx]->triangles.push_back({tri.x-offset,tri.y-offset,tri.z-offset});
+    }
+    return result;
+  }
+
+  /*! computes the iso-surfaces for given iso-values on the index'
+      mesh, visiting only the cells that are active for (any of)
+      those values */
+  IsoSurfaces computeIsoSurfaces(IsoSurfaceIndex::SP index,
+                                 const std::vector<float> &isoValues,
+                                 const IsoSurfaceOptions &options)
+  {
+    if (!index) throw std::runtime_error("null iso-surface index");
+    if (options.quantizedScalars)
+      throw std::runtime_error("quantized scalars cannot be used with an iso-surface index");
+    const std::vector<UMesh::PrimRef> active = index->findActiveCells(isoValues);
+    if (verbose)
+      std::cout << "#umesh.iso: index found " << prettyNumber(active.size())
+                << " active cells" << std::endl;
+    return computeIsoSurfaces(index->mesh,isoValues,options,&active);
+  }
+  
+  /*! given a umesh with volumetric elemnets (any sort), compute a new
+    umesh (containing only triangles) that contains the triangular
+    iso-surface for given iso-value. Input *must* have a per-vertex
+    scalar field, but can have any combinatoin of volumetric
+    elemnets; tris and quads in the input get ignored; input remains
+    unchanged. */
+  UMesh::SP extractIsoSurface(UMesh::SP in, float isoValue,
+                              const IsoSurfaceOptions &options)
+  {
+    return computeIsoSurfaces(in,{isoValue},options).mesh;
+  }
+  
+  UMesh::SP extractIsoSurfaces(UMesh::SP in, const std::vector<float> &isoValues,
+                               const IsoSurfaceOptions &options)
+  {
+    IsoSurfaces surfaces = computeIsoSurfaces(in,isoValues,options);
+    return tagWithIsoValues(surfaces,isoValues);
+  }
+
+  std::vector<UMesh::SP>
+  extractIsoSurfacesSeparately(UMesh::SP in, const std::vector<float> &isoValues,
+                               const IsoSurfaceOptions &options)
+  {
+    return splitByIsoValue(computeIsoSurfaces(in,isoValues,options),isoValues.size());
+  }
+
+  UMesh::SP extractIsoSurface(IsoSurfaceIndex::SP index, float isoValue,
+                              const IsoSurfaceOptions &options)
+  {
+    return computeIsoSurfaces(index,{isoValue},options).mesh;
+  }
+  
+  UMesh::SP extractIsoSurfaces(IsoSurfaceIndex::SP index,
+                               const std::vector<float> &isoValues,
+                               const IsoSurfaceOptions &options)
+  {
+    IsoSurfaces surfaces = computeIsoSurfaces(index,isoValues,options);
+    return tagWithIsoValues(surfaces,isoValues);
+  }
+
+  std::vector<UMesh::SP>
+  extractIsoSurfacesSeparately(IsoSurfaceIndex::SP index,
+                               const std::vector<float> &isoValues,
+                               const IsoSurfaceOptions &options)
+  {
+    return splitByIsoValue(computeIsoSurfaces(index,isoValues,options),isoValues.size());
+  }
+
+
+  /*! computes the slice with given plane, visiting only 'active'
+      cells if specified */
+  UMesh::SP computeSlice(UMesh::SP in, const vec4f &plane,
+                         const IsoSurfaceOptions &options,
+                         const std::vector<UMesh::PrimRef> *active)
+  {
+    if (!in) throw std::runtime_error("null input mesh");
+    if (plane.x == 0.f && plane.y == 0.f && plane.z == 0.f)
+      throw std::runtime_error("slice plane without a normal");
+    // the scalars only get interpolated, so there is nothing to
+    // dequantize them for
+    IsoSurfaceOptions sliceOptions = options;
+    sliceOptions.quantizedScalars = nullptr;
+    return computeSurfaces(in,{0.f},sliceOptions,PlaneClassifier(plane),
+                           active,true).mesh;
+  }
+  
+  /*! range of signed distances to the plane of all points in the i'th
+      child box of given BVH node */
+  inline range1f planeDistanceRange(const PlaneClassifier &distance,
+                                    const PointLocator::Node &node, int i)
+  {
+    const vec3f lower(node.lower[0][i],node.lower[1][i],node.lower[2][i]);
+    const vec3f upper(node.upper[0][i],node.upper[1][i],node.upper[2][i]);
+    const vec4f &n = distance.plane;
+    const vec4f lo(n.x < 0.f ? upper.x : lower.x,
+                   n.y < 0.f ? upper.y : lower.y,
+                   n.z < 0.f ? upper.z : lower.z, 0.f);
+    const vec4f hi(n.x < 0.f ? lower.x : upper.x,
+                   n.y < 0.f ? lower.y : upper.y,
+                   n.z < 0.f ? lower.z : upper.z, 0.f);
+    range1f range;
+    range.lower = distance(lo);
+    range.upper = distance(hi);
+    return range;
+  }
+
+  /*! finds - sorted by type and ID - all cells in the locator's BVH
+      that can produce any slice triangles: a cell has triangles only
+      if at least one corner is above (> 0) the plane and one is not,
+      so its box has to be, too. Since the corners' distances are
+      computed the same way, this never misses any cell the full
+      pass would produce triangles for. The top of the tree gets
+      expanded serially, until there are enough subtrees to traverse
+      in parallel */
+  std::vector<UMesh::PrimRef> findStraddlingCells(const PointLocator &locator,
+                                                  const vec4f &plane)
+  {
+    std::vector<UMesh::PrimRef> result;
+    if (locator.nodes.empty()) return result;
+    const PlaneClassifier distance(plane);
+
+    /*! visits the given node's straddling children, appending their
+        prims to 'prims', and calling 'inner(nodeID)' for all inner
+        ones */
+    auto visit = [&](uint32_t nodeID,
+                     std::vector<UMesh::PrimRef> &prims,
+                     const auto &inner) {
+      const PointLocator::Node &node = locator.nodes[nodeID];
+      for (int i=0;i<4;i++) {
+        // skip empty (ie, unused) child slots
+        if (!(node.lower[0][i] <= node.upper[0][i])) continue;
+        const range1f range = planeDistanceRange(distance,node,i);
+        if (!(range.lower <= 0.f && range.upper > 0.f)) continue;
+        if (node.count[i] == 0)
+          inner(node.offset[i]);
+        else
+          prims.insert(prims.end(),
+                       locator.prims.begin()+node.offset[i],
+                       locator.prims.begin()+node.offset[i]+node.count[i]);
+      }
+    };
+
+    const size_t minSubtrees = 256;
+    std::vector<uint32_t> subtrees = { 0 };
+    size_t numExpanded = 0;
+    for (; numExpanded < subtrees.size()
+           && subtrees.size()-numExpanded < minSubtrees; numExpanded++)
+      visit(subtrees[numExpanded],result,
+            [&](uint32_t child){ subtrees.push_back(child); });
+    subtrees.erase(subtrees.begin(),subtrees.begin()+numExpanded);
+
+    std::vector<std::vector<UMesh::PrimRef>> subtreePrims(subtrees.size());
+    parallel_for(subtrees.size(),[&](size_t subtreeID){
+        std::vector<uint32_t> stack = { subtrees[subtreeID] };
+        while (!stack.empty()) {
+          const uint32_t nodeID = stack.back();
+          stack.pop_back();
+          visit(nodeID,subtreePrims[subtreeID],
+                [&](uint32_t child){ stack.push_back(child); });
+        }
+      });
+    for (auto &prims : subtreePrims)
+      result.insert(result.end(),prims.begin(),prims.end());
+    parallel_radix_sort(result,[](const UMesh::PrimRef &pr)
+                        { return (uint64_t(pr.type) << 60) | uint64_t(pr.ID); });
+    return result;
+  }
+  
+  UMesh::SP extractSlice(UMesh::SP in, const vec4f &plane,
+                         const IsoSurfaceOptions &options)
+  {
+    return computeSlice(in,plane,options,nullptr);
+  }
+
+  UMesh::SP extractSlice(PointLocator::SP locator, const vec4f &plane,
+                         const IsoSurfaceOptions &options)
+  {
+    if (!locator) throw std::runtime_error("null point locator");
+    std::vector<UMesh::PrimRef> active;
+    {
+      profile::ScopedTimer timer("slice.findCells");
+      active = findStraddlingCells(*locator,plane);
+      timer.addItems(active.size());
+    }
+    if (verbose)
+      std::cout << "#umesh.slice: BVH found " << prettyNumber(active.size())
+                << " straddling cells" << std::endl;
+    return computeSlice(locator->mesh,plane,options,&active);
   }
   
 } // ::umesh
@@ -17,16 +17,131 @@
 #pragma once
 
 #include "umesh/UMesh.h"
+#include "umesh/IsoSurfaceIndex.h"
+#include "umesh/PointLocator.h"
+#include "umesh/VertexArrays.h"
 
 namespace umesh {
 
+  /*! how the iso-surface vertices that different cells generate get
+      merged ("welded") into shared vertices */
+  typedef enum {
+    /*! merge all vertices with exactly the same position; this sorts
+        all generated vertices */
+    WELD_BY_POSITION,
+    /*! merge all vertices generated on the same edge of the input
+        mesh (as identified by the edge's two vertex indices), using
+        a hash table. This is linear in the number of generated
+        vertices, and does not rely on floating point positions
+        matching up. Grid cells don't have vertex indices, so meshes
+        with grids always get welded by position */
+    WELD_BY_EDGE
+  } IsoSurfaceWelding;
+
+  /*! optional settings for iso-surface extraction */
+  struct IsoSurfaceOptions {
+    IsoSurfaceWelding welding = WELD_BY_POSITION;
+    /*! if enabled, each of the input's (named) per-vertex attributes
+        gets linearly interpolated to the output vertices, and
+        stored in the output's 'attributes'; vertices generated by
+        grid cells get NaN */
+    bool interpolateAttributes = false;
+    /*! packed (VERTEX_ARRAYS_PACKED) copy of the input's vertices and
+        scalars to gather cell corners from; if not specified (or not
+        matching the input), one gets created for each extraction, so
+        for repeated extractions from the same mesh it is cheaper to
+        create it once, and pass it here */
+    VertexArrays::SP vertexArrays;
+    /*! if set, the per-vertex scalars to extract iso-surfaces of,
+        instead of the input's 'perVertex'. These get dequantized
+        while creating the vertex arrays above, so they never get
+        expanded into a float attribute. Cannot be used with the
+        IsoSurfaceIndex variants, as the index was built for the
+        mesh's own scalars */
+    QuantizedAttribute::SP quantizedScalars;
+    /*! if enabled, the output gets area-weighted per-vertex normals
+        of its (welded) triangles, as the "normal.x/y/z" per-vertex
+        attributes (see computeNormals.h). These are computed from
+        the surface itself, so vertices where different iso-values'
+        surfaces (or separate sheets of the same surface) meet do
+        not get averaged */
+    bool computeNormals = false;
+  };
+
   /*! given a umesh with volumetric elemnets (any sort), compute a new
       umesh (containing only triangles) that contains the triangular
       iso-surface for given iso-value. Input *must* have a per-vertex
       scalar field, but can have any combinatoin of volumetric
       elemnets; tris and quads in the input get ignored; input remains
       unchanged. */
-  UMesh::SP extractIsoSurface(UMesh::SP input, float isoValue);
+  UMesh::SP extractIsoSurface(UMesh::SP input, float isoValue,
+                              const IsoSurfaceOptions &options = IsoSurfaceOptions());
+
+  /*! same as extractIsoSurface(), but for multiple iso-values at
+      once, visiting each cell (and gathering its vertices) only
+      once. Returns a single triangle mesh with the surfaces for all
+      iso-values, with a per-triangle element attribute named
+      "isoValue" that stores the iso-value each triangle belongs
+      to. Vertices never get shared between different iso-values'
+      surfaces */
+  UMesh::SP extractIsoSurfaces(UMesh::SP input,
+                               const std::vector<float> &isoValues,
+                               const IsoSurfaceOptions &options = IsoSurfaceOptions());
+
+  /*! same as extractIsoSurfaces(), but returns a separate triangle
+      mesh for each iso-value, with result[i] being the surface for
+      isoValues[i] */
+  std::vector<UMesh::SP>
+  extractIsoSurfacesSeparately(UMesh::SP input,
+                               const std::vector<float> &isoValues,
+                               const IsoSurfaceOptions &options = IsoSurfaceOptions());
+
+  /*! same as extractIsoSurface(UMesh::SP,float), for the mesh the
+      given index was built for; but only visits the cells the index
+      finds to be active for the given iso-value, which for
+      repeated extractions from the same mesh (eg, interactively
+      changing the iso-value) is (much) cheaper than visiting all
+      cells. Produces exactly the same output */
+  UMesh::SP extractIsoSurface(IsoSurfaceIndex::SP index, float isoValue,
+                              const IsoSurfaceOptions &options = IsoSurfaceOptions());
+
+  /*! same as extractIsoSurfaces(UMesh::SP,...), but using the given
+      index (see extractIsoSurface(IsoSurfaceIndex::SP,float)) */
+  UMesh::SP extractIsoSurfaces(IsoSurfaceIndex::SP index,
+                               const std::vector<float> &isoValues,
+                               const IsoSurfaceOptions &options = IsoSurfaceOptions());
+
+  /*! same as extractIsoSurfacesSeparately(UMesh::SP,...), but using
+      the given index (see extractIsoSurface(IsoSurfaceIndex::SP,float)) */
+  std::vector<UMesh::SP>
+  extractIsoSurfacesSeparately(IsoSurfaceIndex::SP index,
+                               const std::vector<float> &isoValues,
+                               const IsoSurfaceOptions &options = IsoSurfaceOptions());
+
+  /*! computes the cut of given volume mesh with the plane (a,b,c,d)
+      - ie, all points where a*x+b*y+c*z+d == 0, the same convention
+      as the BrickSet's planes - as a triangle mesh. This runs the same
+      marching kernels as extractIsoSurface(), but classifies the
+      cells' corners by their signed distance to the plane (computed
+      while gathering them) rather than by their scalars, so the input
+      does not need a scalar field. If it does have one, that gets
+      interpolated to the slice's vertices, and becomes the output's
+      perVertex (as do all other attributes, with
+      options.interpolateAttributes); vertices generated by grid cells
+      get NaN. options.quantizedScalars gets ignored. Visits all
+      cells */
+  UMesh::SP extractSlice(UMesh::SP input, const vec4f &plane,
+                         const IsoSurfaceOptions &options = IsoSurfaceOptions());
+
+  /*! same as extractSlice(UMesh::SP,...), for the mesh the given
+      locator was built for; but only visits the cells whose bounds
+      straddle the plane, as found by traversing the locator's BVH,
+      which is sublinear in the number of cells. For repeated slices
+      of the same mesh (eg, interactively moving the plane) the
+      locator only has to be built once. Produces exactly the same
+      output */
+  UMesh::SP extractSlice(PointLocator::SP locator, const vec4f &plane,
+                         const IsoSurfaceOptions &options = IsoSurfaceOptions());
   
 } // ::umesh
 
@@ -0,0 +1,381 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* device-side iso-surface extraction. Like all code built on
+   deviceHelpers.h this also compiles as plain C++ (in which case all
+   "kernels" run on the host), which helps with debugging the
+   algorithm on machines without a GPU. */
+
+#include "umesh/extractIsoSurfaceGPU.h"
+#include "umesh/marchingCubesTables.h"
+#include "umesh/deviceHelpers.h"
+#include "umesh/parallel_radix_sort.h"
+#ifdef __CUDACC__
+# include <thrust/sort.h>
+#endif
+#include <limits>
+#include <string.h>
+
+namespace umesh {
+  namespace {
+
+  /*! same layout as the host side's fat vertices: a position, and
+      the index (in the array of all generated vertices) it got
+      generated with */
+  struct DeviceFatVertex {
+    float    x, y, z;
+    uint32_t idx;
+  };
+
+  /*! the i'th four bytes of a fat vertex's position, as a key that
+      orders the same way memcmp() orders these bytes */
+  inline __umesh_gpu_both__ uint32_t memcmpKey(const DeviceFatVertex &v, int i)
+  {
+    const uint8_t *bytes = (const uint8_t *)&v.x + 4*i;
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16)
+      |    (uint32_t(bytes[2]) <<  8) |  uint32_t(bytes[3]);
+  }
+
+  /*! orders fat vertices the same way the host side's
+      sortFatVertices() does: by memcmp() order of their positions,
+      and by index for equal positions */
+  struct FatVertexComparator {
+    inline __umesh_gpu_both__
+    bool operator()(const DeviceFatVertex &a, const DeviceFatVertex &b) const
+    {
+      for (int i=0;i<3;i++) {
+        const uint32_t ka = memcmpKey(a,i), kb = memcmpKey(b,i);
+        if (ka != kb) return ka < kb;
+      }
+      return a.idx < b.idx;
+    }
+  };
+
+  void sortFatVertices(DeviceFatVertex *fatVertices, size_t numFatVertices)
+  {
+#ifdef __CUDACC__
+    thrust::sort(thrust::device,fatVertices,fatVertices+numFatVertices,
+                 FatVertexComparator());
+#else
+    // vertices are in index order, so two stable passes are enough
+    parallel_radix_sort(fatVertices,numFatVertices,[](const DeviceFatVertex &v)
+                        { return memcmpKey(v,2); });
+    parallel_radix_sort(fatVertices,numFatVertices,[](const DeviceFatVertex &v)
+                        { return (uint64_t(memcmpKey(v,0)) << 32) | memcmpKey(v,1); });
+#endif
+  }
+
+  /*! a cell corner: position and scalar value */
+  struct Corner {
+    float x, y, z, w;
+  };
+
+  /*! (1-t)*a+t*b, in doubles, and rounded the same way as on the
+      host (ie, w/o any fused multiply-adds) */
+  inline __umesh_gpu_device__ float lerp(double t, float a, float b)
+  {
+#ifdef __CUDA_ARCH__
+    return float(__dadd_rn(__dmul_rn(1.-t,a),__dmul_rn(t,b)));
+#else
+    return float((1.f-t)*a+t*b);
+#endif
+  }
+
+  /*! the device copy of the mesh: vertices (three floats each), their
+      scalars, and the vertex indices of all tets, pyramids, wedges,
+      and hexes. Cells are numbered in that order */
+  struct DeviceMesh {
+    const float *vertices;
+    const float *scalars;
+    const int   *prims[4];
+    size_t       numPrims[4];
+    size_t       numCells;
+
+    /*! gathers the cell's corners in VTK hex vertex order, blowing up
+        non-hexes by replicating vertices the same way the host side
+        does */
+    inline __umesh_gpu_device__ void gather(size_t cellID, Corner corner[8]) const
+    {
+      // corners of each prim type, as indices into its vertices
+      const int8_t asHex[4][8] = {
+        { 0,1,2,2, 3,3,3,3 },
+        { 0,1,2,3, 4,4,4,4 },
+        { 0,1,4,3, 2,2,5,5 },
+        { 0,1,2,3, 4,5,6,7 }
+      };
+      const int numVertices[4] = { 4,5,6,8 };
+      int type = 0;
+      while (cellID >= numPrims[type]) cellID -= numPrims[type++];
+      const int *prim = prims[type]+cellID*numVertices[type];
+      for (int i=0;i<8;i++) {
+        const int idx = prim[asHex[type][i]];
+        corner[i] = { vertices[3*idx+0],vertices[3*idx+1],vertices[3*idx+2],
+                      scalars[idx] };
+      }
+    }
+  };
+
+  /*! runs marching cubes on given cell the same way the host side's
+      process() does, including dropping degenerate triangles; returns
+      the number of triangles. If 'out' is specified, also writes the
+      triangles' vertices to it, with indices starting at 'firstIdx' */
+  inline __umesh_gpu_device__
+  int march(const Corner vertex[8], float isoValue,
+            DeviceFatVertex *out = nullptr, uint32_t firstIdx = 0)
+  {
+    int index = 0;
+    for (int i=0;i<8;i++)
+      if (vertex[i].w > isoValue)
+        index += (1<<i);
+    if (index == 0 || index == 0xff) return 0;
+
+    int numTriangles = 0;
+    for (const int8_t *edge = &vtkMarchingCubesTriangleCases[index][0];
+         edge[0] > -1;
+         edge += 3 ) {
+      DeviceFatVertex triVertex[3];
+      for (int ii=0; ii<3; ii++) {
+        const int8_t *vert = vtkMarchingCubes_edges[edge[ii]];
+        const Corner v0 = vertex[vert[0]];
+        const Corner v1 = vertex[vert[1]];
+        const double t
+          = (v1.w == v0.w)
+          ? 0.f
+          : ((isoValue - v0.w) / double(v1.w - v0.w));
+        triVertex[ii].x = lerp(t,v0.x,v1.x);
+        triVertex[ii].y = lerp(t,v0.y,v1.y);
+        triVertex[ii].z = lerp(t,v0.z,v1.z);
+      }
+      auto same = [](const DeviceFatVertex &a, const DeviceFatVertex &b)
+      { return a.x == b.x && a.y == b.y && a.z == b.z; };
+      if (same(triVertex[1],triVertex[0])) continue;
+      if (same(triVertex[2],triVertex[0])) continue;
+      if (same(triVertex[1],triVertex[2])) continue;
+
+      if (out)
+        for (int j=0;j<3;j++) {
+          triVertex[j].idx = firstIdx+3*numTriangles+j;
+          out[3*numTriangles+j] = triVertex[j];
+        }
+      ++numTriangles;
+    }
+    return numTriangles;
+  }
+
+  /*! classification: number of triangles for each cell; writes a
+      zero count for the extra item at cellID==numCells, so an
+      exclusive scan over all counts also yields the total */
+  struct CountTriangles {
+    DeviceMesh mesh;
+    float      isoValue;
+    uint64_t  *numTriangles;
+    inline __umesh_gpu_device__ void operator()(size_t cellID) const
+    {
+      if (cellID == mesh.numCells) { numTriangles[cellID] = 0; return; }
+      Corner corner[8];
+      mesh.gather(cellID,corner);
+      numTriangles[cellID] = march(corner,isoValue);
+    }
+  };
+
+  /*! emits each cell's triangles at the offset the (exclusive) scan
+      over the counts computed for it; this produces the vertices in
+      the same order as the host side does */
+  struct EmitTriangles {
+    DeviceMesh       mesh;
+    float            isoValue;
+    const uint64_t  *firstTriangle;
+    DeviceFatVertex *fatVertices;
+    inline __umesh_gpu_device__ void operator()(size_t cellID) const
+    {
+      if (firstTriangle[cellID] == firstTriangle[cellID+1]) return;
+      Corner corner[8];
+      mesh.gather(cellID,corner);
+      const uint32_t firstIdx = uint32_t(3*firstTriangle[cellID]);
+      march(corner,isoValue,fatVertices+firstIdx,firstIdx);
+    }
+  };
+
+  /*! flags all sorted fat vertices that differ from their
+      predecessor */
+  struct FlagNewVertices {
+    const DeviceFatVertex *fatVertices;
+    uint32_t              *isNew;
+    inline __umesh_gpu_device__ void operator()(size_t i) const
+    {
+      if (i == 0) { isNew[i] = 1; return; }
+      const DeviceFatVertex &a = fatVertices[i-1];
+      const DeviceFatVertex &b = fatVertices[i];
+      isNew[i] = !(a.x == b.x && a.y == b.y && a.z == b.z);
+    }
+  };
+
+  /*! writes the unique vertices, and each fat vertex' index into the
+      triangles' index array */
+  struct WriteVerticesAndIndices {
+    const DeviceFatVertex *fatVertices;
+    const uint32_t        *isNew;
+    /*! inclusive scan over isNew */
+    const uint32_t        *numNewUntil;
+    float                 *vertices;
+    int                   *indices;
+    inline __umesh_gpu_device__ void operator()(size_t i) const
+    {
+      const DeviceFatVertex &v = fatVertices[i];
+      const uint32_t vertexID = numNewUntil[i]-1;
+      if (isNew[i]) {
+        vertices[3*vertexID+0] = v.x;
+        vertices[3*vertexID+1] = v.y;
+        vertices[3*vertexID+2] = v.z;
+      }
+      indices[v.idx] = int(vertexID);
+    }
+  };
+
+  } // ::umesh::<anonymous>
+
+  struct DeviceIsoSurfaceExtractor::Impl {
+    DeviceMesh mesh;
+
+    /*! the mesh, which may be shared with other device algorithms */
+    DeviceUMesh::SP              device;
+
+    // temporary data, and results, of the last extraction
+    DeviceArray<uint64_t>        numTriangles;
+    DeviceArray<uint64_t>        firstTriangle;
+    DeviceArray<DeviceFatVertex> fatVertices;
+    DeviceArray<uint32_t>        isNew;
+    DeviceArray<uint32_t>        numNewUntil;
+    DeviceArray<float>           outVertices;
+    DeviceArray<int>             outIndices;
+  };
+
+  DeviceIsoSurfaceExtractor::SP DeviceIsoSurfaceExtractor::create(UMesh::SP mesh)
+  {
+    return std::make_shared<DeviceIsoSurfaceExtractor>(mesh);
+  }
+
+  DeviceIsoSurfaceExtractor::SP DeviceIsoSurfaceExtractor::create(DeviceUMesh::SP mesh)
+  {
+    return std::make_shared<DeviceIsoSurfaceExtractor>(mesh);
+  }
+
+  /*! checks a host mesh before uploading it */
+  DeviceUMesh::SP uploadForIso(UMesh::SP in)
+  {
+    if (!in) throw std::runtime_error("null input mesh");
+    if (!in->grids.empty())
+      throw std::runtime_error("device iso-surface extraction does not support grids");
+    return DeviceUMesh::upload(*in);
+  }
+  
+  DeviceIsoSurfaceExtractor::DeviceIsoSurfaceExtractor(UMesh::SP in)
+    : DeviceIsoSurfaceExtractor(uploadForIso(in))
+  {}
+  
+  DeviceIsoSurfaceExtractor::DeviceIsoSurfaceExtractor(DeviceUMesh::SP device)
+    : impl(new Impl)
+  {
+    if (!device) throw std::runtime_error("null input mesh");
+    const DeviceUMeshView view = device->view();
+    if (device->hasVolumeElements() && !view.scalars)
+      throw std::runtime_error("input mesh w/o scalar field");
+    impl->device = device;
+
+    DeviceMesh &mesh = impl->mesh;
+    mesh.vertices    = (const float *)view.vertices;
+    mesh.scalars     = view.scalars;
+    mesh.prims[0]    = (const int *)view.tets;
+    mesh.prims[1]    = (const int *)view.pyrs;
+    mesh.prims[2]    = (const int *)view.wedges;
+    mesh.prims[3]    = (const int *)view.hexes;
+    mesh.numPrims[0] = view.numTets;
+    mesh.numPrims[1] = view.numPyrs;
+    mesh.numPrims[2] = view.numWedges;
+    mesh.numPrims[3] = view.numHexes;
+    mesh.numCells    = 0;
+    for (int i=0;i<4;i++)
+      mesh.numCells += mesh.numPrims[i];
+  }
+
+  DeviceIsoSurfaceExtractor::~DeviceIsoSurfaceExtractor()
+  {}
+
+  DeviceIsoSurface DeviceIsoSurfaceExtractor::extractToDevice(float isoValue)
+  {
+    Impl &d = *impl;
+    const size_t numCells = d.mesh.numCells;
+
+    // classify, and compute where each cell's outputs go
+    d.numTriangles.resize(numCells+1);
+    d.firstTriangle.resize(numCells+1);
+    launch(numCells+1,CountTriangles{d.mesh,isoValue,d.numTriangles.ptr});
+    exclusiveScan(d.numTriangles.ptr,d.firstTriangle.ptr,numCells+1);
+    uint64_t numTriangles = 0;
+    d.firstTriangle.download(&numTriangles,numCells,1);
+    if (3*numTriangles > uint64_t(std::numeric_limits<int>::max()))
+      throw std::runtime_error("iso-surface has too many vertices for 32-bit indices");
+    const size_t numFatVertices = 3*numTriangles;
+    if (verbose)
+      std::cout << "#umesh.iso: found " << prettyNumber(numTriangles)
+                << " triangles ..." << std::endl;
+
+    DeviceIsoSurface result;
+    result.numTriangles = numTriangles;
+    if (numTriangles == 0) return result;
+
+    // emit
+    d.fatVertices.resize(numFatVertices);
+    launch(numCells,EmitTriangles{d.mesh,isoValue,d.firstTriangle.ptr,
+                                  d.fatVertices.ptr});
+
+    // weld, by sorting
+    sortFatVertices(d.fatVertices.ptr,numFatVertices);
+    d.isNew.resize(numFatVertices);
+    d.numNewUntil.resize(numFatVertices);
+    launch(numFatVertices,FlagNewVertices{d.fatVertices.ptr,d.isNew.ptr});
+    inclusiveScan(d.isNew.ptr,d.numNewUntil.ptr,numFatVertices);
+    uint32_t numVertices = 0;
+    d.numNewUntil.download(&numVertices,numFatVertices-1,1);
+    if (verbose)
+      std::cout << "#umesh.iso: found " << prettyNumber(numVertices)
+                << " unique vertices ..." << std::endl;
+
+    d.outVertices.resize(3*size_t(numVertices));
+    d.outIndices.resize(numFatVertices);
+    launch(numFatVertices,WriteVerticesAndIndices{d.fatVertices.ptr,d.isNew.ptr,
+                                                  d.numNewUntil.ptr,
+                                                  d.outVertices.ptr,
+                                                  d.outIndices.ptr});
+    result.vertices    = d.outVertices.ptr;
+    result.indices     = d.outIndices.ptr;
+    result.numVertices = numVertices;
+    return result;
+  }
+
+  UMesh::SP DeviceIsoSurfaceExtractor::extract(float isoValue)
+  {
+    const DeviceIsoSurface surface = extractToDevice(isoValue);
+    UMesh::SP out = std::make_shared<UMesh>();
+    out->vertices.resize(surface.numVertices);
+    out->triangles.resize(surface.numTriangles);
+    if (surface.numTriangles == 0) return out;
+    impl->outVertices.download((float *)out->vertices.data(),0,3*surface.numVertices);
+    impl->outIndices.download((int *)out->triangles.data(),0,3*surface.numTriangles);
+    return out;
+  }
+
+} // ::umesh
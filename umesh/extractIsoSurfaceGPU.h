@@ -0,0 +1,78 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/DeviceUMesh.h"
+
+#if UMESH_HAVE_CUDA
+namespace umesh {
+
+  /*! an iso-surface that lives in device memory: 'numVertices'
+      vertices (three floats each), and 'numTriangles' triangles
+      (three int vertex indices each) */
+  struct DeviceIsoSurface {
+    const float *vertices     = nullptr;
+    const int   *indices      = nullptr;
+    size_t       numVertices  = 0;
+    size_t       numTriangles = 0;
+  };
+  
+  /*! extracts iso-surfaces on the GPU, from a copy of a mesh's
+      vertices, per-vertex scalars, and volumetric elements that gets
+      uploaded to the device only once (when the extractor gets
+      created) - or that already is on the device, as a DeviceUMesh
+      - so repeated extractions (eg, for interactively
+      changing iso-values) do not have to move the mesh again.
+
+      Runs the same marching-cubes code and welds vertices by position
+      the same way as extractIsoSurface(), so produces exactly the
+      same surface; but all steps - classifying cells, compacting
+      their outputs, emitting triangles, and welding vertices - run
+      on the device. Grids are not supported. */
+  struct DeviceIsoSurfaceExtractor {
+    typedef std::shared_ptr<DeviceIsoSurfaceExtractor> SP;
+
+    /*! uploads given mesh (which must have a per-vertex scalar
+        field, and must not have any grids) to the device; later
+        changes to the mesh do not affect the extractor */
+    static DeviceIsoSurfaceExtractor::SP create(UMesh::SP mesh);
+    /*! same, for a mesh that already is on the device (and which
+        must not change while the extractor is in use) */
+    static DeviceIsoSurfaceExtractor::SP create(DeviceUMesh::SP mesh);
+
+    DeviceIsoSurfaceExtractor(UMesh::SP mesh);
+    DeviceIsoSurfaceExtractor(DeviceUMesh::SP mesh);
+    DeviceIsoSurfaceExtractor(const DeviceIsoSurfaceExtractor &) = delete;
+    ~DeviceIsoSurfaceExtractor();
+
+    /*! extracts the iso-surface for given value, and leaves it in
+        device memory; the returned arrays are owned by the
+        extractor, and stay valid until the next extraction */
+    DeviceIsoSurface extractToDevice(float isoValue);
+
+    /*! extracts the iso-surface for given value, and downloads it
+        into a new (triangle-only) host mesh */
+    UMesh::SP extract(float isoValue);
+
+    struct Impl;
+  private:
+    std::unique_ptr<Impl> impl;
+  };
+
+} // ::umesh
+#endif
@@ -16,10 +16,15 @@
 
 #include "umesh/extractShellFaces.h"
 #include "umesh/FaceConn.h"
+#include "umesh/FaceConnKernels.h"
 #include "umesh/RemeshHelper.h"
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/ScratchArena.h"
+#include "umesh/profile.h"
 # ifdef UMESH_HAVE_TBB
 #  include "tbb/parallel_sort.h"
 # endif
+#include <atomic>
 #include <set>
 #include <algorithm>
 #include <string.h>
@@ -52,7 +57,107 @@ namespace umesh {
 } // ::umesh
 
 namespace umesh {
+
+  /*! block size for the parallel passes over all faces */
+  const size_t shellBlockSize = 64*1024;
+
+  /*! writes the triangle or quad for given (unique-ordered) face
+      into the next slot of the output mesh; 'swap' flips the face's
+      orientation, for faces whose only prim is on their back side */
+  inline void writeShellFace(UMesh &output, const vec4i &idx, bool swap,
+                             size_t &nextTri, size_t &nextQuad)
+  {
+    if (swap) {
+      if (idx.w < 0)
+        output.triangles[nextTri++] = vec3i(idx.x,idx.z,idx.y);
+      else
+        output.quads[nextQuad++] = vec4i(idx.x,idx.w,idx.z,idx.y);
+    } else {
+      if (idx.w < 0)
+        output.triangles[nextTri++] = vec3i(idx.x,idx.y,idx.z);
+      else
+        output.quads[nextQuad++] = idx;
+    }
+  }
   
+  /*! computes the outward-facing shell faces of given view's
+      volume elements from their face connectivity, with vertex
+      indices that refer to the view's vertices (ie, without any
+      vertices of their own) */
+  UMesh::SP computeShellFaces(const MeshView &input,
+                              const FaceConn &faceConn)
+  {
+    auto &faces = faceConn.faces;
+
+    assert(faces.empty() || !input.vertices.empty());
+    UMesh::SP output = std::make_shared<UMesh>();
+
+    // count the shell triangles and quads in each block of faces, so
+    // each block knows where to write its own ones (in the same order
+    // as a serial loop over the faces would)
+    const size_t numFaces  = faces.size();
+    const size_t numBlocks = divRoundUp(numFaces,shellBlockSize);
+    std::vector<size_t> trisBegin(numBlocks+1,0);
+    std::vector<size_t> quadsBegin(numBlocks+1,0);
+    std::atomic<bool> unusedFace(false);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*shellBlockSize;
+        const size_t end   = std::min(begin+shellBlockSize,numFaces);
+        size_t numTris = 0, numQuads = 0;
+        for (size_t faceID=begin;faceID<end;faceID++) {
+          const FaceConn::SharedFace &face = faces[faceID];
+          if (face.vertexIdx.x < 0)
+            // invalid face
+            continue;
+          if (face.onFront.primIdx < 0 && face.onBack.primIdx < 0)
+            unusedFace = true;
+          else if (face.onFront.primIdx >= 0 && face.onBack.primIdx >= 0)
+            /* inner face ... ignore */
+            continue;
+          else if (face.vertexIdx.w < 0)
+            numTris++;
+          else
+            numQuads++;
+        }
+        trisBegin[blockID+1]  = numTris;
+        quadsBegin[blockID+1] = numQuads;
+      });
+    if (unusedFace)
+      throw std::runtime_error("face that has BOTH sides unused!?");
+    for (size_t blockID=0;blockID<numBlocks;blockID++) {
+      trisBegin[blockID+1]  += trisBegin[blockID];
+      quadsBegin[blockID+1] += quadsBegin[blockID];
+    }
+    
+    output->triangles.resize(trisBegin[numBlocks]);
+    output->quads.resize(quadsBegin[numBlocks]);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*shellBlockSize;
+        const size_t end   = std::min(begin+shellBlockSize,numFaces);
+        size_t nextTri  = trisBegin[blockID];
+        size_t nextQuad = quadsBegin[blockID];
+        for (size_t faceID=begin;faceID<end;faceID++) {
+          const FaceConn::SharedFace &face = faces[faceID];
+          if (face.vertexIdx.x < 0)
+            continue;
+          if (face.onFront.primIdx < 0)
+            writeShellFace(*output,face.vertexIdx,true,nextTri,nextQuad);
+          else if (face.onBack.primIdx < 0)
+            writeShellFace(*output,face.vertexIdx,false,nextTri,nextQuad);
+        }
+      });
+    return output;
+  }
+
+  /*! same, computing the face connectivity with given method */
+  UMesh::SP computeShellFaces(const MeshView &input,
+                              FaceConn::Method method)
+  {
+    profile::ScopedTimer timer("extractShellFaces",0,input.numVolumeElements());
+    FaceConn::SP faceConn = FaceConn::compute(input,method);
+    return computeShellFaces(input,*faceConn);
+  }
+
   /*! given a umesh with mixed volumetric elements, create a a new
       mesh of surface elemnts (ie, triangles and quads) that
       corresponds to the outside facing "shell" faces of the input
@@ -66,124 +171,258 @@ namespace umesh {
                                 vertices array empty, and have the
                                 vertex indices refer to the
                                 original input mesh */
-                              bool remeshVertices
+                              bool remeshVertices,
+                              FaceConn::Method method
                               )
   {
-    FaceConn::SP faceConn = FaceConn::compute(input);
-    auto &faces = faceConn->faces;
+    assert(input);
+    UMesh::SP output = computeShellFaces(MeshView(*input),method);
+    if (remeshVertices) {
+      copyUsedVertices(*output,*input);
+      output->finalize();
+    }
+    return output;
+  }
 
-    assert(faces.empty() || !input->vertices.empty());
-    UMesh::SP output = std::make_shared<UMesh>();
+  UMesh::SP extractShellFaces(UMesh::SP input,
+                              const FaceConn &faceConn,
+                              bool remeshVertices)
+  {
+    assert(input);
+    UMesh::SP output = computeShellFaces(MeshView(*input),faceConn);
+    if (remeshVertices) {
+      copyUsedVertices(*output,*input);
+      output->finalize();
+    }
+    return output;
+  }
 
-#if 1
-    output->vertices = input->vertices;
-    if (input->perVertex)  {
-      output->perVertex = std::make_shared<Attribute>();
-      output->perVertex->name = input->perVertex->name;
-      output->perVertex->values = input->perVertex->values;
+  UMesh::SP extractShellFaces(const MeshView &input,
+                              bool remeshVertices,
+                              FaceConn::Method method)
+  {
+    UMesh::SP output = computeShellFaces(input,method);
+    if (remeshVertices) {
+      copyUsedVertices(*output,input);
+      output->finalize();
     }
+    return output;
+  }
+  
+  // ==================================================================
+  // boundary-only extraction
+  // ==================================================================
 
-    for (auto &face: faces) {
-      if (face.vertexIdx.x < 0)
-        // invalid face
-        continue;
-      
-      if (face.onFront.primIdx < 0 && face.onBack.primIdx < 0) {
-        PRINT(face.vertexIdx);
-        throw std::runtime_error("face that has BOTH sides unused!?");
-      } else if (face.onFront.primIdx < 0) {
-        if (face.vertexIdx.w < 0) {
-          // SWAP
-          vec3i tri(face.vertexIdx.x,
-                    face.vertexIdx.z,
-                    face.vertexIdx.y);
-          output->triangles.push_back(tri);
-        } else {
-          // SWAP
-          vec4i quad(face.vertexIdx.x,
-                     face.vertexIdx.w,
-                     face.vertexIdx.z,
-                     face.vertexIdx.y);
-          output->quads.push_back(quad);
-        }
-      } else if (face.onBack.primIdx < 0) {
-        if (face.vertexIdx.w < 0) {
-          // NO SWAP
-          vec3i tri(face.vertexIdx.x,
-                    face.vertexIdx.y,
-                    face.vertexIdx.z);
-          output->triangles.push_back(tri);
-        } else {
-          // NO SWAP
-          vec4i quad(face.vertexIdx.x,
-                     face.vertexIdx.y,
-                     face.vertexIdx.z,
-                     face.vertexIdx.w);
-          output->quads.push_back(quad);
-        }
-      } else {
-        /* inner face ... ignore */
-      }
+  /*! a facet as used by extractBoundaryFaces(): only its
+      (unique-ordered) vertex indices, without the PrimFacetRef that
+      FaceConn keeps for each side of a face, and with the facet's
+      orientation in the top bit of 'y' (which can never be negative
+      for non-degenerate facets); that is half the size of a Facet */
+  struct BoundaryFacet {
+    enum { ORIENTATION_BIT = int(0x80000000u) };
+
+    inline bool  degenerate()  const { return idx.x < 0; }
+    inline int   orientation() const { return (idx.y & ORIENTATION_BIT) != 0; }
+    inline vec4i vertexIdx()   const
+    { return vec4i(idx.x,idx.y & ~ORIENTATION_BIT,idx.z,idx.w); }
+
+    vec4i idx;
+  };
+
+  inline bool sameFace(const BoundaryFacet &a, const BoundaryFacet &b)
+  {
+    const vec4i ia = a.vertexIdx(), ib = b.vertexIdx();
+    return ia.x == ib.x && ia.y == ib.y && ia.z == ib.z && ia.w == ib.w;
+  }
+
+  /*! writes the facets of all prims - in the same order as
+      writeFacets() - already brought into their unique vertex
+      order; returns the largest vertex index used by any of them */
+  int writeBoundaryFacets(BoundaryFacet *facets, const InputMesh &mesh)
+  {
+    const size_t numPrims
+      = mesh.numTets + mesh.numPyrs + mesh.numWedges + mesh.numHexes;
+    /* index of the first facet of given prim */
+    auto firstFacet = [&](size_t primIdx) {
+      if (primIdx < mesh.numTets) return 4*primIdx;
+      size_t offset = 4*mesh.numTets;
+      primIdx -= mesh.numTets;
+      if (primIdx < mesh.numPyrs) return offset+5*primIdx;
+      offset  += 5*mesh.numPyrs;
+      primIdx -= mesh.numPyrs;
+      if (primIdx < mesh.numWedges) return offset+5*primIdx;
+      offset  += 5*mesh.numWedges;
+      primIdx -= mesh.numWedges;
+      return offset+6*primIdx;
+    };
+    const size_t blockSize = 16*1024;
+    std::vector<int> blockMax(divRoundUp(numPrims,blockSize),-1);
+    parallel_for_blocked
+      (0,numPrims,blockSize,
+       [&](size_t begin, size_t end) {
+         int maxIdx = -1;
+         BoundaryFacet *out = facets+firstFacet(begin);
+         for (size_t primIdx=begin;primIdx<end;primIdx++) {
+           Facet primFacets[6];
+           const int numFacets = writePrimFacets(primFacets,primIdx,mesh);
+           for (int i=0;i<numFacets;i++) {
+             Facet &facet = primFacets[i];
+             computeUniqueVertexOrder(facet);
+             vec4i idx = facet.vertexIdx;
+             maxIdx = std::max(maxIdx,std::max(std::max(idx.x,idx.y),
+                                               std::max(idx.z,idx.w)));
+             if (idx.x >= 0 && facet.orientation)
+               idx.y |= BoundaryFacet::ORIENTATION_BIT;
+             (out++)->idx = idx;
+           }
+         }
+         blockMax[begin/blockSize] = maxIdx;
+       });
+    return blockMax.empty() ? -1 : *std::max_element(blockMax.begin(),blockMax.end());
+  }
+
+  /*! sorts facets by their vertex indices, ignoring orientation, the
+      same way sortFacets() does for FaceConn; degenerate facets all
+      end up at the front */
+  void sortBoundaryFacets(BoundaryFacet *facets, size_t numFacets, int maxVertexIdx)
+  {
+    int bits = 1;
+    while (bits < 32 && (uint64_t(maxVertexIdx)+1) >> bits) bits++;
+
+    auto index = [](int idx) { return uint64_t(uint32_t(idx+1)); };
+    if (4*bits <= 64) {
+      parallel_radix_sort(facets,numFacets,[&](const BoundaryFacet &facet){
+          if (facet.degenerate()) return uint64_t(0);
+          const vec4i v = facet.vertexIdx();
+          return (index(v.x) << (3*bits)) | (index(v.y) << (2*bits))
+            |    (index(v.z) << bits)     |  index(v.w);
+        });
+      return;
     }
-    if (remeshVertices)
-      removeUnusedVertices(output);
-#else
-    
-    
-    RemeshHelper helper(*output);
-    for (auto &face: faces) {
-      if (face.vertexIdx.x < 0)
-        // invalid face
-        continue;
-      
-      if (face.onFront.primIdx < 0 && face.onBack.primIdx < 0) {
-        PRINT(face.vertexIdx);
-        throw std::runtime_error("face that has BOTH sides unused!?");
-      } else if (face.onFront.primIdx < 0) {
-        if (face.vertexIdx.w < 0) {
-          // SWAP
-          vec3i tri(face.vertexIdx.x,
-                    face.vertexIdx.z,
-                    face.vertexIdx.y);
-          if (remeshVertices)
-            helper.translate(&tri.x,3,input);
-          output->triangles.push_back(tri);
-        } else {
-          // SWAP
-          vec4i quad(face.vertexIdx.x,
-                     face.vertexIdx.w,
-                     face.vertexIdx.z,
-                     face.vertexIdx.y);
-          if (remeshVertices)
-            helper.translate(&quad.x,4,input);
-          output->quads.push_back(quad);
+    parallel_radix_sort(facets,numFacets,[&](const BoundaryFacet &facet){
+        if (facet.degenerate()) return uint64_t(0);
+        const vec4i v = facet.vertexIdx();
+        return (index(v.z) << bits) | index(v.w);
+      });
+    parallel_radix_sort(facets,numFacets,[&](const BoundaryFacet &facet){
+        if (facet.degenerate()) return uint64_t(0);
+        const vec4i v = facet.vertexIdx();
+        return (index(v.x) << bits) | index(v.y);
+      });
+  }
+
+  /*! same as extractShellFaces(), but without ever computing the
+      mesh's FaceConn: we only sort the facets' vertex indices (plus
+      one orientation bit each), after which each face's facets are
+      next to each other, and every face with only a single facet is
+      a shell face. Faces (and thus the output elements) are in the
+      same order as with FaceConn::SORT, so the result is the same
+      as that of extractShellFaces(mesh,remeshVertices,FaceConn::SORT),
+      but needs less than half the memory */
+  UMesh::SP computeBoundaryFaces(const MeshView &input)
+  {
+    profile::ScopedTimer timer("extractBoundaryFaces",0,input.numVolumeElements());
+    const InputMesh mesh = makeInputMesh(input);
+
+    const size_t numFacets
+      = 4 * mesh.numTets
+      + 5 * mesh.numPyrs
+      + 5 * mesh.numWedges
+      + 6 * mesh.numHexes;
+    ScratchVector<BoundaryFacet> facets(numFacets);
+    const int maxVertexIdx = writeBoundaryFacets(facets.data(),mesh);
+    sortBoundaryFacets(facets.data(),numFacets,maxVertexIdx);
+
+    UMesh::SP output = std::make_shared<UMesh>();
+
+    /* each face gets handled by the block its first facet is in;
+       that face is a shell face if it has only that one facet, and
+       an inner face if it has two facets with opposite orientation -
+       anything else is the same bad connectivity that FaceConn
+       complains about */
+    auto faceSize = [&](size_t facetID) -> int {
+      if (facets[facetID].degenerate() ||
+          (facetID > 0 && sameFace(facets[facetID-1],facets[facetID])))
+        return 0;
+      if (facetID+1 == numFacets || !sameFace(facets[facetID],facets[facetID+1]))
+        return 1;
+      if (facets[facetID].orientation() == facets[facetID+1].orientation() ||
+          (facetID+2 < numFacets && sameFace(facets[facetID],facets[facetID+2])))
+        return -1;
+      return 2;
+    };
+
+    const size_t numBlocks = divRoundUp(numFacets,shellBlockSize);
+    std::vector<size_t> trisBegin(numBlocks+1,0);
+    std::vector<size_t> quadsBegin(numBlocks+1,0);
+    std::atomic<bool> usedTwice(false);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*shellBlockSize;
+        const size_t end   = std::min(begin+shellBlockSize,numFacets);
+        size_t numTris = 0, numQuads = 0;
+        for (size_t facetID=begin;facetID<end;facetID++) {
+          const int size = faceSize(facetID);
+          if (size < 0)
+            usedTwice = true;
+          else if (size != 1)
+            continue;
+          else if (facets[facetID].idx.w < 0)
+            numTris++;
+          else
+            numQuads++;
         }
-      } else if (face.onBack.primIdx < 0) {
-        if (face.vertexIdx.w < 0) {
-          // NO SWAP
-          vec3i tri(face.vertexIdx.x,
-                    face.vertexIdx.y,
-                    face.vertexIdx.z);
-          if (remeshVertices)
-            helper.translate(&tri.x,3,input);
-          output->triangles.push_back(tri);
-        } else {
-          // NO SWAP
-          vec4i quad(face.vertexIdx.x,
-                     face.vertexIdx.y,
-                     face.vertexIdx.z,
-                     face.vertexIdx.w);
-          if (remeshVertices)
-            helper.translate(&quad.x,4,input);
-          output->quads.push_back(quad);
+        trisBegin[blockID+1]  = numTris;
+        quadsBegin[blockID+1] = numQuads;
+      });
+    if (usedTwice)
+      throw std::runtime_error("side is used twice!?");
+    for (size_t blockID=0;blockID<numBlocks;blockID++) {
+      trisBegin[blockID+1]  += trisBegin[blockID];
+      quadsBegin[blockID+1] += quadsBegin[blockID];
+    }
+
+    output->triangles.resize(trisBegin[numBlocks]);
+    output->quads.resize(quadsBegin[numBlocks]);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*shellBlockSize;
+        const size_t end   = std::min(begin+shellBlockSize,numFacets);
+        size_t nextTri  = trisBegin[blockID];
+        size_t nextQuad = quadsBegin[blockID];
+        for (size_t facetID=begin;facetID<end;facetID++) {
+          if (faceSize(facetID) != 1)
+            continue;
+          const BoundaryFacet &facet = facets[facetID];
+          // facets with orientation 0 are on the face's back side
+          writeShellFace(*output,facet.vertexIdx(),!facet.orientation(),
+                         nextTri,nextQuad);
         }
-      } else {
-        /* inner face ... ignore */
-      }
+      });
+    facets.clear();
+    facets.shrink_to_fit();
+    return output;
+  }
+
+  UMesh::SP extractBoundaryFaces(UMesh::SP input,
+                                 bool remeshVertices)
+  {
+    assert(input);
+    UMesh::SP output = computeBoundaryFaces(MeshView(*input));
+    if (remeshVertices) {
+      copyUsedVertices(*output,*input);
+      output->finalize();
     }
-#endif
-    // dbg_input = 0;
     return output;
   }
-  
+
+  UMesh::SP extractBoundaryFaces(const MeshView &input,
+                                 bool remeshVertices)
+  {
+    UMesh::SP output = computeBoundaryFaces(input);
+    if (remeshVertices) {
+      copyUsedVertices(*output,input);
+      output->finalize();
+    }
+    return output;
+  }
+
 }
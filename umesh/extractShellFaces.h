@@ -17,6 +17,7 @@
 #pragma once
 
 #include "umesh/UMesh.h"
+#include "umesh/FaceConn.h"
 
 namespace umesh {
 
@@ -25,7 +26,10 @@ namespace umesh {
     corresponds to the outside facing "shell" faces of the input
     elements (ie, all those that re not shared by two different
     elements. All surface elements in the output mesh will be
-    OUTWARD facing. */
+    OUTWARD facing, and in the order of their faces in the mesh's
+    FaceConn. Faces get counted and written in parallel; with
+    'remeshVertices', the used vertices (and their attributes) get
+    copied directly, and the result is finalized. */
   UMesh::SP extractShellFaces(UMesh::SP mesh,
                               /*! if true, we'll create a new set of
                                 vertices for ONLY the required
@@ -33,6 +37,37 @@ namespace umesh {
                                 vertices array empty, and have the
                                 vertex indices refer to the
                                 original input mesh */
+                              bool remeshVertices,
+                              /*! engine for computing the mesh's
+                                  faces; see FaceConn::Method */
+                              FaceConn::Method method = FaceConn::AUTO);
+
+  /*! same as extractShellFaces(mesh,remeshVertices,...), with an
+      already computed face connectivity of the mesh (eg, from
+      io::DerivedCache) */
+  UMesh::SP extractShellFaces(UMesh::SP mesh,
+                              const FaceConn &faceConn,
                               bool remeshVertices);
+
+  /*! boundary-only version of extractShellFaces(), for meshes whose
+    FaceConn would not fit into memory: instead of computing all
+    faces (with the prims on either side), this only sorts the
+    facets' vertex indices to find those that occur only once. Needs
+    less than half the memory, and produces the same output as
+    extractShellFaces(mesh,remeshVertices,FaceConn::SORT) */
+  UMesh::SP extractBoundaryFaces(UMesh::SP mesh,
+                                 bool remeshVertices);
+
+  /*! same as extractShellFaces(UMesh::SP,...), for the elements of
+      given view; with 'remeshVertices' the output gets copies of the
+      used vertices, with the view's scalars (if any) as 'perVertex' */
+  UMesh::SP extractShellFaces(const MeshView &mesh,
+                              bool remeshVertices,
+                              FaceConn::Method method = FaceConn::AUTO);
+
+  /*! same as extractBoundaryFaces(UMesh::SP,...), for the elements
+      of given view (see above) */
+  UMesh::SP extractBoundaryFaces(const MeshView &mesh,
+                                 bool remeshVertices);
 } // ::umesh
 
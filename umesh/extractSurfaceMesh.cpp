@@ -43,8 +43,7 @@ namespace umesh {
     UMesh::SP output = std::make_shared<UMesh>();
     RemeshHelper helper(*output);
 
-    for (auto prim : input->createSurfacePrimRefs())
-      helper.add(input,prim);
+    helper.addAll(input,input->createSurfacePrimRefs());
     return output;
   }
 } // ::umesh
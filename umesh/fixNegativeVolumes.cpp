@@ -0,0 +1,71 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/fixNegativeVolumes.h"
+#include "umesh/profile.h"
+#include <atomic>
+
+namespace umesh {
+
+  /*! block size for the parallel passes over all elements */
+  const size_t fixBlockSize = 64*1024;
+
+  /*! flips all inside-out prims in given array, returns how many
+      that were */
+  template<typename Prim>
+  size_t fixNegativeVolumes(const std::vector<vec3f> &vertices,
+                            std::vector<Prim> &prims)
+  {
+    std::atomic<size_t> numFlipped(0);
+    parallel_for_blocked
+      (0,prims.size(),fixBlockSize,
+       [&](size_t begin, size_t end) {
+         size_t blockFlipped = 0;
+         for (size_t i=begin;i<end;i++)
+           blockFlipped += fixNegativeVolume(vertices.data(),prims[i]);
+         numFlipped += blockFlipped;
+       });
+    return numFlipped;
+  }
+
+  /*! flips - in place, and in parallel - all volume elements of given
+      mesh that are inside-out, and returns how many of each type it
+      flipped */
+  NegativeVolumeCounts fixNegativeVolumes(UMesh::SP mesh)
+  {
+    assert(mesh);
+    profile::ScopedTimer timer("fixNegativeVolumes",0,mesh->numVolumeElements());
+    NegativeVolumeCounts counts;
+    counts.numTets   = fixNegativeVolumes(mesh->vertices,mesh->tets);
+    counts.numPyrs   = fixNegativeVolumes(mesh->vertices,mesh->pyrs);
+    counts.numWedges = fixNegativeVolumes(mesh->vertices,mesh->wedges);
+    counts.numHexes  = fixNegativeVolumes(mesh->vertices,mesh->hexes);
+    return counts;
+  }
+
+  /*! same as fixNegativeVolumes(), but works on (and returns) a
+      copy */
+  UMesh::SP withFixedNegativeVolumes(UMesh::SP mesh,
+                                     NegativeVolumeCounts *counts)
+  {
+    assert(mesh);
+    UMesh::SP fixed = std::make_shared<UMesh>(*mesh);
+    NegativeVolumeCounts fixedCounts = fixNegativeVolumes(fixed);
+    if (counts) *counts = fixedCounts;
+    return fixed;
+  }
+  
+} // ::umesh
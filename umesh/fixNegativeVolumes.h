@@ -0,0 +1,123 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! number of elements of each type that fixNegativeVolumes() found
+      to be inside-out, and flipped */
+  struct NegativeVolumeCounts {
+    inline size_t total() const
+    { return numTets+numPyrs+numWedges+numHexes; }
+    
+    size_t numTets   = 0;
+    size_t numPyrs   = 0;
+    size_t numWedges = 0;
+    size_t numHexes  = 0;
+  };
+
+  // ==================================================================
+  // volume-sign tests and orientation fixes for individual elements
+  // ==================================================================
+  
+  /*! (six times the) signed volume of the tet (v0,v1,v2,v3), positive
+      for tets in VTK order */
+  inline float signedVolume(const vec3f &v0,
+                            const vec3f &v1,
+                            const vec3f &v2,
+                            const vec3f &v3)
+  {
+    return dot(v3-v0,cross(v1-v0,v2-v0));
+  }
+
+  /*! surface elements do not have a volume */
+  inline bool hasNegativeVolume(const vec3f *, const Triangle &) { return false; }
+  inline bool hasNegativeVolume(const vec3f *, const Quad &)     { return false; }
+  
+  inline bool hasNegativeVolume(const vec3f *v, const Tet &tet)
+  {
+    return signedVolume(v[tet[0]],v[tet[1]],v[tet[2]],v[tet[3]]) < 0.f;
+  }
+
+  /*! tests the tet formed by the first two base vertices, the base
+      center, and the top */
+  inline bool hasNegativeVolume(const vec3f *v, const Pyr &pyr)
+  {
+    const vec3f b = 0.25f*(v[pyr[0]]+v[pyr[1]]+v[pyr[2]]+v[pyr[3]]);
+    return signedVolume(v[pyr[0]],v[pyr[1]],b,v[pyr[4]]) < 0.f;
+  }
+
+  /*! tests the tet formed by the back triangle, and the center of the
+      quad face between the first two front and back vertices */
+  inline bool hasNegativeVolume(const vec3f *v, const Wedge &wedge)
+  {
+    const vec3f b = 0.25f*(v[wedge[0]]+v[wedge[1]]+v[wedge[3]]+v[wedge[4]]);
+    return signedVolume(v[wedge[3]],v[wedge[4]],v[wedge[5]],b) < 0.f;
+  }
+
+  /*! tests the tet formed by the first two base vertices, the base
+      center, and the hex center */
+  inline bool hasNegativeVolume(const vec3f *v, const Hex &hex)
+  {
+    vec3f c = v[hex[0]];
+    for (int i=1;i<8;i++) c = c + v[hex[i]];
+    c = 0.125f*c;
+    const vec3f b = 0.25f*(v[hex[0]]+v[hex[1]]+v[hex[2]]+v[hex[3]]);
+    return signedVolume(v[hex[0]],v[hex[1]],b,c) < 0.f;
+  }
+
+  /*! reverses the orientation of given element */
+  inline void flipOrientation(Triangle &) {}
+  inline void flipOrientation(Quad &)     {}
+  inline void flipOrientation(Tet &tet)
+  { std::swap(tet.x,tet.y); }
+  inline void flipOrientation(Pyr &pyr)
+  { std::swap(pyr.base.x,pyr.base.y); std::swap(pyr.base.z,pyr.base.w); }
+  inline void flipOrientation(Wedge &wedge)
+  { for (int i=0;i<3;i++) std::swap(wedge[i],wedge[3+i]); }
+  inline void flipOrientation(Hex &hex)
+  { for (int i=0;i<4;i++) std::swap(hex[i],hex[4+i]); }
+
+  /*! flips given element if it is inside-out; returns whether it
+      did */
+  template<typename Prim>
+  inline bool fixNegativeVolume(const vec3f *vertices, Prim &prim)
+  {
+    if (!hasNegativeVolume(vertices,prim)) return false;
+    flipOrientation(prim);
+    return true;
+  }
+  
+  // ==================================================================
+  // fixing entire meshes
+  // ==================================================================
+
+  /*! flips - in place, and in parallel - all volume elements of given
+      mesh that are inside-out (ie, whose vertices are not in VTK
+      order), and returns how many of each type it flipped. Element
+      order (and thus per-element attributes) stays the same */
+  NegativeVolumeCounts fixNegativeVolumes(UMesh::SP mesh);
+
+  /*! same as fixNegativeVolumes(), but leaves the input unmodified,
+      and returns a fixed copy; the copy shares the input's
+      attributes */
+  UMesh::SP withFixedNegativeVolumes(UMesh::SP mesh,
+                                     NegativeVolumeCounts *counts = nullptr);
+  
+} // ::umesh
@@ -0,0 +1,144 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include <algorithm>
+
+namespace umesh {
+
+  /*! default number of elements per task in
+      parallelForEachElement() */
+  const size_t defaultElementBlockSize = 16*1024;
+
+  /*! which of a mesh's element arrays to visit */
+  typedef enum {
+    VOLUME_ELEMENTS  = (1<<0),
+    SURFACE_ELEMENTS = (1<<1),
+    ALL_ELEMENTS     = VOLUME_ELEMENTS|SURFACE_ELEMENTS
+  } ElementTypes;
+
+  /*! the number of vertices of given element, as a compile-time
+      constant of its type */
+  template<typename Prim>
+  inline constexpr int numVerticesOf(const Prim &)
+  { return Prim::numVertices; }
+
+  /*! the bounds of the vertices of given element */
+  template<typename Prim, typename Vertices>
+  inline box3f elementBounds(const Prim &prim, const Vertices &vertices)
+  {
+    box3f bounds;
+    for (int i=0;i<Prim::numVertices;i++)
+      bounds.extend(vertices[prim[i]]);
+    return bounds;
+  }
+
+  /*! calls 'f(prims,type)' for each of given mesh's element arrays
+      (of the given 'which'), with 'prims' being that array - so a
+      generic lambda gets instantiated once per element type, and
+      can use that type's numVertices as a compile-time constant,
+      without any per-element switch over types. Arrays get visited
+      in the same order as in UMesh::createAllPrimRefs(), ie, tets,
+      pyrs, wedges, and hexes, then triangles and quads. Grids are
+      not visited, as they do not have any vertices. 'Mesh' can be a
+      UMesh, a const UMesh, or a MeshView */
+  template<typename Mesh, typename Lambda>
+  inline void forEachElementType(Mesh &mesh, const Lambda &f,
+                                 ElementTypes which = ALL_ELEMENTS)
+  {
+    if (which & VOLUME_ELEMENTS) {
+      f(mesh.tets,  UMesh::TET);
+      f(mesh.pyrs,  UMesh::PYR);
+      f(mesh.wedges,UMesh::WEDGE);
+      f(mesh.hexes, UMesh::HEX);
+    }
+    if (which & SURFACE_ELEMENTS) {
+      f(mesh.triangles,UMesh::TRI);
+      f(mesh.quads,    UMesh::QUAD);
+    }
+  }
+
+  /*! a range [begin,end) of elements in the array of given type, as
+      handed to the visitors of parallelForEachElementRange(); 'index'
+      is the position of element 'begin' in the sequence of all
+      visited elements (in forEachElementType() order) */
+  struct ElementRange {
+    /*! position of given element (of this range's type) in the
+        sequence of all visited elements */
+    inline size_t indexOf(size_t primID) const
+    { return index+(primID-begin); }
+
+    UMesh::PrimType type;
+    size_t          begin, end;
+    size_t          index;
+  };
+
+  /*! calls 'visitor(prims,range)' - in parallel - for each block of
+      'blockSize' elements of all the mesh's element arrays of the
+      given 'which', with 'prims' the array that the elements in
+      'range' belong to (see forEachElementType()). Blocks are cut
+      from the sequence of all those elements, so the work is split
+      evenly no matter how many elements of each type there are; a
+      block that straddles two arrays gets split into one call per
+      array. Visitors that do per-block reductions thus get (at
+      most) one call per block and array */
+  template<typename Mesh, typename Visitor>
+  void parallelForEachElementRange(Mesh &mesh, const Visitor &visitor,
+                                   ElementTypes which = ALL_ELEMENTS,
+                                   size_t blockSize = defaultElementBlockSize)
+  {
+    size_t typeBegin[UMesh::INVALID];
+    size_t numElements = 0;
+    forEachElementType(mesh,[&](auto &prims, UMesh::PrimType type){
+        typeBegin[type] = numElements;
+        numElements += prims.size();
+      },which);
+    parallel_for_blocked
+      (0,numElements,blockSize,
+       [&](size_t begin, size_t end) {
+         forEachElementType(mesh,[&](auto &prims, UMesh::PrimType type){
+             const size_t lo = std::max(begin,typeBegin[type]);
+             const size_t hi = std::min(end,typeBegin[type]+prims.size());
+             if (lo >= hi) return;
+             ElementRange range;
+             range.type  = type;
+             range.begin = lo-typeBegin[type];
+             range.end   = hi-typeBegin[type];
+             range.index = lo;
+             visitor(prims,range);
+           },which);
+       });
+  }
+
+  /*! calls 'visitor(prim,type,primID)' - in parallel - for every
+      element of the given 'which' in given mesh, with 'prim' being
+      (a reference to) the element itself, of its actual type (see
+      parallelForEachElementRange()) */
+  template<typename Mesh, typename Visitor>
+  void parallelForEachElement(Mesh &mesh, const Visitor &visitor,
+                              ElementTypes which = ALL_ELEMENTS,
+                              size_t blockSize = defaultElementBlockSize)
+  {
+    parallelForEachElementRange
+      (mesh,[&](auto &prims, const ElementRange &range){
+          for (size_t i=range.begin;i<range.end;i++)
+            visitor(prims[i],range.type,i);
+        },which,blockSize);
+  }
+
+} // ::umesh
@@ -0,0 +1,424 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/hexesToGrids.h"
+#include "umesh/Adjacency.h"
+#include "umesh/RemeshHelper.h"
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/profile.h"
+#include <cmath>
+#include <limits>
+
+namespace umesh {
+
+  /*! the twelve edges of a hex in VTK order, as pairs of corners */
+  static const int hexEdges[12][2] = {
+    { 0,1 },{ 1,2 },{ 2,3 },{ 3,0 },
+    { 4,5 },{ 5,6 },{ 6,7 },{ 7,4 },
+    { 0,4 },{ 1,5 },{ 2,6 },{ 3,7 }
+  };
+
+  /*! a hex that is an axis-aligned box: its bounds, and for each of
+      its corners which of the box's corners it is on (bit 0 set for
+      upper x, bit 1 for upper y, bit 2 for upper z) */
+  struct BoxCell {
+    box3f   bounds;
+    uint8_t corner[8];
+    bool    valid = false;
+  };
+
+  /*! checks whether given hex is an axis-aligned box (within given
+      tolerance): each of its corners has to be on a different corner
+      of its bounding box, such that each of the hex's edges is one
+      of the box's. That allows for any of the box's 48 symmetries,
+      which all have the same trilinear interpolation as the box */
+  BoxCell makeBoxCell(const UMesh &mesh, const UMesh::Hex &hex, float tolerance)
+  {
+    BoxCell cell;
+    box3f bounds;
+    for (int i=0;i<8;i++)
+      bounds.extend(mesh.vertices[hex[i]]);
+    const vec3f size = bounds.size();
+    if (!(size.x > 0.f && size.y > 0.f && size.z > 0.f))
+      return cell;
+    int used = 0;
+    for (int i=0;i<8;i++) {
+      const vec3f v = mesh.vertices[hex[i]];
+      int corner = 0;
+      for (int axis=0;axis<3;axis++) {
+        const float eps = tolerance*size[axis];
+        if (fabsf(v[axis]-bounds.upper[axis]) <= eps)
+          corner |= (1<<axis);
+        else if (!(fabsf(v[axis]-bounds.lower[axis]) <= eps))
+          return cell;
+      }
+      if (used & (1<<corner)) return cell;
+      used |= (1<<corner);
+      cell.corner[i] = uint8_t(corner);
+    }
+    for (auto &edge : hexEdges) {
+      const int axis = cell.corner[edge[0]] ^ cell.corner[edge[1]];
+      if (axis != 1 && axis != 2 && axis != 4) return cell;
+    }
+    cell.bounds = bounds;
+    cell.valid  = true;
+    return cell;
+  }
+
+  /*! a set of box cells that got connected through shared faces, and
+      that all have the same size and lie on the same regular
+      lattice; cells' lattice coordinates are relative to the first
+      cell */
+  struct Region {
+    vec3f  origin;
+    vec3f  cellSize;
+    box3i  bounds;
+    size_t numCells  = 0;
+    /*! the (global) ID of this region's first tile, for regions that
+        get tiled */
+    size_t firstTile = 0;
+  };
+
+  /*! number of tiles (of B^3 cells each) a region gets split into */
+  inline vec3i numTilesOf(const Region &region, int B)
+  {
+    const vec3i size = region.bounds.size()+vec3i(1);
+    return vec3i(divRoundUp(size.x,B),divRoundUp(size.y,B),divRoundUp(size.z,B));
+  }
+
+  /*! the mesh's hexes' cells, grouped into regions, and tiles of those */
+  struct HexesToGrids {
+    HexesToGrids(UMesh::SP mesh, const HexesToGridsOptions &options);
+
+    /*! computes the lattice coordinates of given cell in given
+        region; returns false if it's not on that region's lattice
+        (or doesn't have the region's cell size) */
+    bool onLattice(const BoxCell &cell, const Region &region, vec3i &lattice) const;
+
+    /*! grows the region seeded by given cell, through its neighbors */
+    void growRegion(uint32_t seedID, const Adjacency &adjacency);
+
+    /*! converts the cells of the tile with given ID to grids, with
+        their scalars' offsets relative to 'scalars' */
+    void convertTile(size_t tileID,
+                     std::vector<Grid> &grids,
+                     std::vector<float> &scalars);
+
+    /*! tries to create a grid for the numCells cells starting at
+        'begin' in a tile, whose cells are as specified in 'slots' */
+    bool makeGrid(const std::vector<int> &slots,
+                  const vec3i &begin, const vec3i &numCells,
+                  Grid &grid, std::vector<float> &scalars) const;
+
+    UMesh::SP                  mesh;
+    const HexesToGridsOptions  options;
+    std::vector<BoxCell>       cells;
+    std::vector<int>           regionOf;
+    std::vector<vec3i>         lattice;
+    std::vector<Region>        regions;
+    /*! the cells of all tiled regions, sorted by their (global) tile ID */
+    struct TileCell {
+      uint64_t tileID;
+      uint32_t hexID;
+    };
+    std::vector<TileCell>      tileCells;
+    /*! for each non-empty tile, where its cells begin in 'tileCells';
+        plus one final entry with the total */
+    std::vector<size_t>        tileBegin;
+    std::vector<uint8_t>       converted;
+  };
+
+  HexesToGrids::HexesToGrids(UMesh::SP mesh, const HexesToGridsOptions &options)
+    : mesh(mesh), options(options)
+  {}
+
+  bool HexesToGrids::onLattice(const BoxCell &cell, const Region &region,
+                               vec3i &lattice) const
+  {
+    for (int axis=0;axis<3;axis++) {
+      const float size = region.cellSize[axis];
+      const float eps  = options.tolerance*size;
+      const float lower = cell.bounds.lower[axis];
+      const float upper = cell.bounds.upper[axis];
+      if (!(fabsf((upper-lower)-size) <= eps)) return false;
+      const float rel = (lower-region.origin[axis])/size;
+      if (!(fabsf(rel) < float(std::numeric_limits<int>::max()/2))) return false;
+      lattice[axis] = int(std::round(rel));
+      if (!(fabsf(lower-(region.origin[axis]+lattice[axis]*size)) <= eps))
+        return false;
+    }
+    return true;
+  }
+
+  void HexesToGrids::growRegion(uint32_t seedID, const Adjacency &adjacency)
+  {
+    const int regionID = (int)regions.size();
+    Region region;
+    region.origin   = cells[seedID].bounds.lower;
+    region.cellSize = cells[seedID].bounds.size();
+    const uint32_t hexBegin = adjacency.typeBegin[UMesh::HEX-UMesh::TET];
+    const uint32_t hexEnd   = adjacency.typeBegin[UMesh::HEX-UMesh::TET+1];
+
+    std::vector<uint32_t> stack = { seedID };
+    regionOf[seedID] = regionID;
+    lattice[seedID]  = vec3i(0);
+    while (!stack.empty()) {
+      const uint32_t hexID = stack.back();
+      stack.pop_back();
+      region.bounds.extend(lattice[hexID]);
+      region.numCells++;
+      for (uint32_t elementID : adjacency.neighborsOf(hexBegin+hexID)) {
+        if (elementID < hexBegin || elementID >= hexEnd) continue;
+        const uint32_t otherID = elementID-hexBegin;
+        if (regionOf[otherID] >= 0 || !cells[otherID].valid) continue;
+        if (!onLattice(cells[otherID],region,lattice[otherID])) continue;
+        regionOf[otherID] = regionID;
+        stack.push_back(otherID);
+      }
+    }
+    regions.push_back(region);
+  }
+
+  bool HexesToGrids::makeGrid(const std::vector<int> &slots,
+                              const vec3i &begin, const vec3i &numCells,
+                              Grid &grid, std::vector<float> &scalars) const
+  {
+    const int B = options.maxGridCells;
+    auto slotOf = [&](int x, int y, int z) { return slots[x+B*(y+B*z)]; };
+    const vec3i sv = numCells+vec3i(1);
+    const size_t numScalars = sv.x*size_t(sv.y)*sv.z;
+    // which mesh vertex each grid vertex is; cells that are adjacent
+    // in the lattice but didn't share that vertex (eg, along a crack)
+    // can't be in the same grid
+    std::vector<int> vertexOf(numScalars,-1);
+    const size_t scalarsBegin = scalars.size();
+    scalars.resize(scalarsBegin+numScalars);
+    float *gridScalars = scalars.data()+scalarsBegin;
+    const float *values = mesh->perVertex->values.data();
+    for (int iz=0;iz<numCells.z;iz++)
+      for (int iy=0;iy<numCells.y;iy++)
+        for (int ix=0;ix<numCells.x;ix++) {
+          const int hexID = slotOf(begin.x+ix,begin.y+iy,begin.z+iz);
+          const UMesh::Hex &hex = mesh->hexes[hexID];
+          const BoxCell &cell = cells[hexID];
+          for (int i=0;i<8;i++) {
+            const int c = cell.corner[i];
+            const size_t idx
+              = (ix+(c&1))
+              + sv.x*((iy+((c>>1)&1))
+                      + size_t(sv.y)*(iz+((c>>2)&1)));
+            if (vertexOf[idx] >= 0 && vertexOf[idx] != hex[i]) {
+              scalars.resize(scalarsBegin);
+              return false;
+            }
+            vertexOf[idx]    = hex[i];
+            gridScalars[idx] = values[hex[i]];
+          }
+        }
+
+    const box3f lower = cells[slotOf(begin.x,begin.y,begin.z)].bounds;
+    const box3f upper = cells[slotOf(begin.x+numCells.x-1,
+                                     begin.y+numCells.y-1,
+                                     begin.z+numCells.z-1)].bounds;
+    range1f range;
+    for (size_t i=0;i<numScalars;i++)
+      if (!std::isnan(gridScalars[i]))
+        range.extend(gridScalars[i]);
+    grid.domain.lower = vec4f(lower.lower.x,lower.lower.y,lower.lower.z,range.lower);
+    grid.domain.upper = vec4f(upper.upper.x,upper.upper.y,upper.upper.z,range.upper);
+    grid.numCells      = numCells;
+    grid.scalarsOffset = int(scalarsBegin);
+    return true;
+  }
+
+  void HexesToGrids::convertTile(size_t tileID,
+                                 std::vector<Grid> &grids,
+                                 std::vector<float> &scalars)
+  {
+    const int B = options.maxGridCells;
+    const TileCell *begin = tileCells.data()+tileBegin[tileID];
+    const TileCell *end   = tileCells.data()+tileBegin[tileID+1];
+    const Region &region = regions[regionOf[begin->hexID]];
+    const vec3i numTiles = numTilesOf(region,B);
+    const size_t localTileID = begin->tileID-region.firstTile;
+    const vec3i tile(int(localTileID % numTiles.x),
+                     int(localTileID / numTiles.x % numTiles.y),
+                     int(localTileID / numTiles.x / numTiles.y));
+    const vec3i tileOrigin = region.bounds.lower+B*tile;
+    
+    // the hex in each of the tile's lattice cells, if any
+    std::vector<int> slots(B*B*B,-1);
+    for (const TileCell *it = begin; it != end; ++it) {
+      const vec3i local = lattice[it->hexID]-tileOrigin;
+      slots[local.x+B*(local.y+B*local.z)] = int(it->hexID);
+    }
+    std::vector<uint8_t> taken(slots.size(),0);
+    auto isFree = [&](int x, int y, int z) {
+      const int slot = x+B*(y+B*z);
+      return slots[slot] >= 0 && !taken[slot];
+    };
+
+    // greedily cover the tile's cells with boxes; each one grows along
+    // x, then y, then z, for as long as all new cells are free
+    for (int z=0;z<B;z++)
+      for (int y=0;y<B;y++)
+        for (int x=0;x<B;x++) {
+          if (!isFree(x,y,z)) continue;
+          vec3i n(1);
+          while (x+n.x < B && isFree(x+n.x,y,z)) n.x++;
+          auto rowIsFree = [&](int yy, int zz) {
+            for (int xx=x;xx<x+n.x;xx++)
+              if (!isFree(xx,yy,zz)) return false;
+            return true;
+          };
+          while (y+n.y < B && rowIsFree(y+n.y,z)) n.y++;
+          auto sliceIsFree = [&](int zz) {
+            for (int yy=y;yy<y+n.y;yy++)
+              if (!rowIsFree(yy,zz)) return false;
+            return true;
+          };
+          while (z+n.z < B && sliceIsFree(z+n.z)) n.z++;
+          for (int zz=z;zz<z+n.z;zz++)
+            for (int yy=y;yy<y+n.y;yy++)
+              for (int xx=x;xx<x+n.x;xx++)
+                taken[xx+B*(yy+B*zz)] = 1;
+
+          if (n.x*n.y*n.z < options.minGridCells) continue;
+          Grid grid;
+          if (!makeGrid(slots,vec3i(x,y,z),n,grid,scalars)) continue;
+          grids.push_back(grid);
+          for (int zz=z;zz<z+n.z;zz++)
+            for (int yy=y;yy<y+n.y;yy++)
+              for (int xx=x;xx<x+n.x;xx++)
+                converted[slots[xx+B*(yy+B*zz)]] = 1;
+        }
+  }
+
+  /*! removes all elements of 'values' whose 'converted' flag is set */
+  template<typename T>
+  void removeConverted(std::vector<T> &values, const std::vector<uint8_t> &converted)
+  {
+    size_t numKept = 0;
+    for (size_t i=0;i<values.size();i++)
+      if (!converted[i])
+        values[numKept++] = values[i];
+    values.resize(numKept);
+  }
+  
+  size_t convertHexesToGrids(UMesh::SP mesh, const HexesToGridsOptions &options)
+  {
+    if (!mesh) throw std::runtime_error("#umesh.hexesToGrids: null mesh");
+    if (options.maxGridCells < 1 || options.maxGridCells > 256)
+      throw std::runtime_error("#umesh.hexesToGrids: invalid max grid size");
+    const size_t numHexes = mesh->hexes.size();
+    if (numHexes == 0) return 0;
+    if (!mesh->perVertex)
+      throw std::runtime_error("#umesh.hexesToGrids: mesh has no per-vertex scalars");
+    profile::ScopedTimer timer("hexesToGrids",0,numHexes);
+
+    HexesToGrids state(mesh,options);
+    state.cells.resize(numHexes);
+    parallel_for_blocked(0,numHexes,16*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          state.cells[i] = makeBoxCell(*mesh,mesh->hexes[i],options.tolerance);
+      });
+
+    {
+      profile::ScopedTimer timer("hexesToGrids.regions",0,numHexes);
+      Adjacency::SP adjacency = Adjacency::compute(mesh);
+      state.regionOf.resize(numHexes,-1);
+      state.lattice.resize(numHexes);
+      for (size_t i=0;i<numHexes;i++)
+        if (state.cells[i].valid && state.regionOf[i] < 0)
+          state.growRegion(uint32_t(i),*adjacency);
+    }
+
+    // regions too small for even one grid don't get tiled at all
+    const int B = options.maxGridCells;
+    size_t numTiles = 0;
+    for (auto &region : state.regions) {
+      if (region.numCells < size_t(options.minGridCells)) continue;
+      const vec3i tiles = numTilesOf(region,B);
+      region.firstTile = numTiles;
+      numTiles += tiles.x*size_t(tiles.y)*tiles.z;
+    }
+    for (size_t i=0;i<numHexes;i++) {
+      if (state.regionOf[i] < 0) continue;
+      const Region &region = state.regions[state.regionOf[i]];
+      if (region.numCells < size_t(options.minGridCells)) continue;
+      const vec3i tiles = numTilesOf(region,B);
+      const vec3i tile  = (state.lattice[i]-region.bounds.lower)/B;
+      state.tileCells.push_back
+        ({region.firstTile+tile.x+tiles.x*(tile.y+size_t(tiles.y)*tile.z),uint32_t(i)});
+    }
+    parallel_radix_sort(state.tileCells,[](const HexesToGrids::TileCell &tc)
+                        { return tc.tileID; });
+    for (size_t i=0;i<state.tileCells.size();i++)
+      if (i == 0 || state.tileCells[i].tileID != state.tileCells[i-1].tileID)
+        state.tileBegin.push_back(i);
+    const size_t numNonEmpty = state.tileBegin.size();
+    state.tileBegin.push_back(state.tileCells.size());
+
+    // each tile creates its own grids and scalars, which then get
+    // appended in tile order
+    state.converted.resize(numHexes,0);
+    std::vector<std::vector<Grid>>  tileGrids(numNonEmpty);
+    std::vector<std::vector<float>> tileScalars(numNonEmpty);
+    parallel_for(numNonEmpty,[&](size_t tileID){
+        state.convertTile(tileID,tileGrids[tileID],tileScalars[tileID]);
+      });
+    const size_t numGridsBefore = mesh->grids.size();
+    size_t numGridScalars = mesh->gridScalars.size();
+    for (size_t tileID=0;tileID<numNonEmpty;tileID++) {
+      for (auto grid : tileGrids[tileID]) {
+        grid.scalarsOffset += int(numGridScalars);
+        mesh->grids.push_back(grid);
+      }
+      numGridScalars += tileScalars[tileID].size();
+      if (numGridScalars > size_t(std::numeric_limits<int>::max()))
+        throw std::runtime_error("#umesh.hexesToGrids: too many grid scalars "
+                                 "for 32-bit scalar offsets");
+      mesh->gridScalars.insert(mesh->gridScalars.end(),
+                               tileScalars[tileID].begin(),
+                               tileScalars[tileID].end());
+      tileGrids[tileID]   = std::vector<Grid>();
+      tileScalars[tileID] = std::vector<float>();
+    }
+
+    size_t numConverted = 0;
+    for (size_t i=0;i<numHexes;i++)
+      numConverted += state.converted[i];
+    if (verbose)
+      std::cout << "#umesh.hexesToGrids: found " << prettyNumber(state.regions.size())
+                << " structured regions, replaced " << prettyNumber(numConverted)
+                << " hexes with " << prettyNumber(mesh->grids.size()-numGridsBefore)
+                << " grids" << std::endl;
+    if (numConverted == 0) return 0;
+
+    removeConverted(mesh->hexes,state.converted);
+    for (auto &attr : mesh->elementAttributes)
+      if (attr.first == UMesh::HEX && attr.second->values.size() == numHexes) {
+        removeConverted(attr.second->values,state.converted);
+        attr.second->finalize();
+      }
+    mesh->markDirty();
+    if (options.removeUnusedVertices)
+      removeUnusedVertices(mesh);
+    mesh->finalize();
+    return numConverted;
+  }
+  
+} // ::umesh
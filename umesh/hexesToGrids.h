@@ -0,0 +1,65 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! settings for convertHexesToGrids() */
+  struct HexesToGridsOptions {
+    /*! max number of cells of each created grid, per dimension */
+    int   maxGridCells = 8;
+    /*! blocks of fewer hexes than this stay hexes, as a grid for
+        those would hardly be any smaller */
+    int   minGridCells = 8;
+    /*! how far - relative to the cell size along that axis - a hex's
+        vertices may be from where a regular grid would put them */
+    float tolerance    = 1e-3f;
+    /*! whether to remove all vertices that are no longer used by any
+        element afterwards (which includes those that already were
+        unused before) */
+    bool  removeUnusedVertices = true;
+  };
+
+  /*! replaces - in place - the logically structured blocks of hexes
+      in given mesh with grids: hexes that are axis-aligned boxes, of
+      the same size, on the same regular lattice, and connected
+      through shared faces (as per the mesh's Adjacency) form a
+      structured region, which then gets tiled into grids of at most
+      options.maxGridCells cells per dimension. All other hexes (and
+      all other elements) remain as they are. Since a box's trilinear
+      interpolation doesn't depend on which of its corners the hex's
+      first vertex is on, hexes do not have to be in any particular
+      orientation.
+
+      A grid stores its vertices' positions implicitly, and only
+      their 'perVertex' scalars (which the mesh therefore needs to
+      have); other per-vertex attributes, and the converted hexes'
+      per-element attributes, do not carry over to the grids. For
+      large structured blocks this takes about an eighth of the
+      memory of the hexes, their vertices, and their scalars. The
+      mesh gets re-finalized, and - with
+      options.removeUnusedVertices - re-indexed, so anything that
+      refers to its vertex or prim IDs is invalid afterwards.
+      Finding the regions uses the mesh's Adjacency, so this has the
+      same requirements on the mesh as Adjacency::compute(). Returns
+      the number of hexes that got replaced */
+  size_t convertHexesToGrids(UMesh::SP mesh,
+                             const HexesToGridsOptions &options = HexesToGridsOptions());
+  
+} // ::umesh
@@ -0,0 +1,382 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/BrickSet.h"
+#include "umesh/io/IO.h"
+#include <algorithm>
+#include <fstream>
+
+namespace umesh {
+  namespace io {
+
+    template<typename T>
+    inline size_t vectorBytes(const std::vector<T> &v)
+    { return v.capacity()*sizeof(T); }
+
+    /*! (approximate) number of bytes that given mesh's arrays use */
+    size_t memoryUsageOf(const UMesh &mesh)
+    {
+      size_t numBytes
+        = vectorBytes(mesh.vertices)
+        + vectorBytes(mesh.triangles)
+        + vectorBytes(mesh.quads)
+        + vectorBytes(mesh.tets)
+        + vectorBytes(mesh.pyrs)
+        + vectorBytes(mesh.wedges)
+        + vectorBytes(mesh.hexes)
+        + vectorBytes(mesh.grids)
+        + vectorBytes(mesh.gridScalars)
+        + vectorBytes(mesh.vertexTags);
+      for (auto attr : mesh.attributes)
+        numBytes += vectorBytes(attr->values);
+      for (auto attr : mesh.elementAttributes)
+        numBytes += vectorBytes(attr.second->values);
+      for (auto attr : mesh.quantizedAttributes)
+        numBytes += vectorBytes(attr->codes8)+vectorBytes(attr->codes16);
+      return numBytes;
+    }
+
+    /*! reads a std::vector as written by io::writeVector(), but
+        checks the element count against what is left in the file
+        first; returns false if there is no such vector */
+    template<typename T>
+    bool readCheckedVector(std::ifstream &in, size_t fileSize,
+                           std::vector<T> &v)
+    {
+      size_t N;
+      if (!in.read((char*)&N,sizeof(N)))
+        return false;
+      const size_t left = fileSize - (size_t)in.tellg();
+      if (N > left/sizeof(T))
+        return false;
+      v.resize(N);
+      in.read((char*)v.data(),N*sizeof(T));
+      return (bool)in;
+    }
+
+    BrickSet::SP BrickSet::open(const std::string &baseName,
+                                size_t memoryBudget,
+                                int numIOThreads,
+                                const LoadSelection &selection)
+    {
+      return std::make_shared<BrickSet>(baseName,memoryBudget,
+                                        numIOThreads,selection);
+    }
+
+    BrickSet::BrickSet(const std::string &baseName,
+                       size_t memoryBudget,
+                       int numIOThreads,
+                       const LoadSelection &selection)
+      : baseName(baseName),
+        memoryBudget(memoryBudget),
+        selection(selection)
+    {
+      bool found = false;
+      for (auto ext : { ".domains", ".bricks" }) {
+        std::ifstream in(baseName+ext,std::ios::binary|std::ios::ate);
+        if (!in.good()) continue;
+        const size_t fileSize = (size_t)in.tellg();
+        in.seekg(0);
+        if (!readCheckedVector(in,fileSize,domains))
+          throw std::runtime_error("#umesh.io: could not read brick domains from '"
+                                   +baseName+ext+"'");
+        if (!readCheckedVector(in,fileSize,valueRanges)
+            || valueRanges.size() != domains.size())
+          valueRanges.clear();
+        found = true;
+        break;
+      }
+      if (!found)
+        throw std::runtime_error("#umesh.io: could not open '"+baseName
+                                 +".domains' (or '"+baseName+".bricks')");
+
+      std::ifstream in(baseName+".neighbors",std::ios::binary|std::ios::ate);
+      if (in.good()) {
+        const size_t fileSize = (size_t)in.tellg();
+        in.seekg(0);
+        size_t numBricks = 0;
+        io::readElement(in,numBricks);
+        if (!in || numBricks != domains.size())
+          throw std::runtime_error("#umesh.io: '"+baseName+".neighbors' does not match '"
+                                   +baseName+"' domains");
+        neighbors.resize(numBricks);
+        for (auto &list : neighbors)
+          if (!readCheckedVector(in,fileSize,list))
+            throw std::runtime_error("#umesh.io: could not read '"+baseName+".neighbors'");
+      }
+
+      bricks.resize(domains.size());
+      for (int i=0;i<std::max(1,numIOThreads);i++)
+        workers.push_back(std::thread([this](){ workerLoop(); }));
+    }
+
+    BrickSet::~BrickSet()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+      }
+      changed.notify_all();
+      for (auto &worker : workers)
+        worker.join();
+    }
+
+    void BrickSet::saveNeighbors(const std::string &baseName,
+                                 const std::vector<std::vector<int>> &neighbors)
+    {
+      const std::string fileName = baseName+".neighbors";
+      std::ofstream out(fileName,std::ios::binary);
+      io::writeElement(out,neighbors.size());
+      for (auto &list : neighbors)
+        io::writeVector(out,list);
+      if (!out.good())
+        throw std::runtime_error("#umesh.io: error writing to '"+fileName+"'");
+    }
+
+    std::string BrickSet::brickFileName(int brickID) const
+    {
+      char ext[20];
+      sprintf(ext,"_%05d",brickID);
+      return baseName+ext+".umesh";
+    }
+
+    void BrickSet::checkID(int brickID) const
+    {
+      if (brickID < 0 || brickID >= (int)bricks.size())
+        throw std::runtime_error("#umesh.io: invalid brick ID "
+                                 +std::to_string(brickID)+" (data set has "
+                                 +std::to_string(bricks.size())+" bricks)");
+    }
+
+    UMesh::SP BrickSet::get(int brickID)
+    {
+      checkID(brickID);
+      std::unique_lock<std::mutex> lock(mutex);
+      Brick &brick = bricks[brickID];
+      while (true) {
+        switch (brick.state) {
+        case CACHED:
+          touch(brickID);
+          return brick.mesh;
+        case FAILED:
+          std::rethrow_exception(brick.error);
+        case NOT_LOADED:
+          brick.state = QUEUED;
+          // fall through
+        case QUEUED:
+          if (!brick.demanded) {
+            brick.demanded = true;
+            demandQueue.push_back(brickID);
+            changed.notify_all();
+          }
+          break;
+        case LOADING:
+          break;
+        }
+        changed.wait(lock);
+      }
+    }
+
+    UMesh::SP BrickSet::tryGet(int brickID)
+    {
+      checkID(brickID);
+      std::lock_guard<std::mutex> lock(mutex);
+      Brick &brick = bricks[brickID];
+      if (brick.state != CACHED)
+        return nullptr;
+      touch(brickID);
+      return brick.mesh;
+    }
+
+    void BrickSet::prefetch(const std::vector<int> &brickIDs)
+    {
+      for (auto brickID : brickIDs)
+        checkID(brickID);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      // drop whatever is left of the previous hint
+      for (auto brickID : prefetchQueue) {
+        Brick &brick = bricks[brickID];
+        if (brick.state == QUEUED && !brick.demanded)
+          brick.state = NOT_LOADED;
+      }
+      prefetchQueue.clear();
+      for (auto &brick : bricks)
+        brick.hinted = false;
+      hintedBytes = 0;
+
+      // touch cached bricks in reverse order, so the most important
+      // one ends up being the most recently used
+      for (int i=(int)brickIDs.size()-1;i>=0;--i) {
+        Brick &brick = bricks[brickIDs[i]];
+        if (brick.hinted) continue;
+        brick.hinted = true;
+        if (brick.state == CACHED) {
+          hintedBytes += brick.numBytes;
+          touch(brickIDs[i]);
+        }
+      }
+      for (auto brickID : brickIDs) {
+        Brick &brick = bricks[brickID];
+        if (brick.state == NOT_LOADED) {
+          brick.state = QUEUED;
+          prefetchQueue.push_back(brickID);
+        }
+      }
+      changed.notify_all();
+    }
+
+    void BrickSet::waitIdle()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock,[this](){
+          return demandQueue.empty() && prefetchQueue.empty() && numLoading == 0;
+        });
+    }
+
+    size_t BrickSet::memoryUsage()
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return cachedBytes;
+    }
+
+    void BrickSet::touch(int brickID)
+    {
+      lru.splice(lru.begin(),lru,bricks[brickID].lruPos);
+    }
+
+    void BrickSet::evict(int keep)
+    {
+      // first only consider bricks that are not part of the current
+      // hint, then all of them
+      for (int pass=0;pass<2 && cachedBytes > memoryBudget;pass++) {
+        auto it = lru.end();
+        while (it != lru.begin() && cachedBytes > memoryBudget) {
+          --it;
+          Brick &brick = bricks[*it];
+          if (*it == keep || (pass == 0 && brick.hinted)) continue;
+          cachedBytes -= brick.numBytes;
+          if (brick.hinted) hintedBytes -= brick.numBytes;
+          brick.mesh     = nullptr;
+          brick.numBytes = 0;
+          brick.state    = NOT_LOADED;
+          it = lru.erase(it);
+        }
+      }
+    }
+
+    void BrickSet::workerLoop()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true) {
+        changed.wait(lock,[this](){
+            return quit || !demandQueue.empty() || !prefetchQueue.empty();
+          });
+        if (quit) return;
+
+        int brickID;
+        if (!demandQueue.empty()) {
+          brickID = demandQueue.front();
+          demandQueue.pop_front();
+          bricks[brickID].demanded = false;
+        } else {
+          brickID = prefetchQueue.front();
+          prefetchQueue.pop_front();
+          if (hintedBytes >= memoryBudget) {
+            // the hinted bricks already fill the budget on their own;
+            // loading any more of them would only push out others
+            prefetchQueue.push_front(brickID);
+            for (auto dropped : prefetchQueue)
+              if (bricks[dropped].state == QUEUED && !bricks[dropped].demanded)
+                bricks[dropped].state = NOT_LOADED;
+            prefetchQueue.clear();
+            changed.notify_all();
+            continue;
+          }
+        }
+
+        Brick &brick = bricks[brickID];
+        // the same brick can be in both queues, and get loaded
+        // through the other one first
+        if (brick.state != QUEUED) continue;
+        brick.state = LOADING;
+        ++numLoading;
+
+        lock.unlock();
+        UMesh::SP mesh;
+        std::exception_ptr error;
+        try {
+          mesh = UMesh::loadFrom(brickFileName(brickID),selection);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        lock.lock();
+
+        --numLoading;
+        if (mesh) {
+          brick.mesh     = mesh;
+          brick.numBytes = memoryUsageOf(*mesh);
+          brick.state    = CACHED;
+          brick.lruPos   = lru.insert(lru.begin(),brickID);
+          cachedBytes += brick.numBytes;
+          if (brick.hinted) hintedBytes += brick.numBytes;
+          evict(brickID);
+        } else {
+          brick.error = error;
+          brick.state = FAILED;
+        }
+        changed.notify_all();
+      }
+    }
+
+    std::vector<int> BrickSet::bricksOverlapping(const box3f &region) const
+    {
+      std::vector<int> result;
+      for (size_t i=0;i<domains.size();i++)
+        if (domains[i].overlaps(region))
+          result.push_back((int)i);
+      return result;
+    }
+
+    std::vector<int> BrickSet::bricksInFrustum(const std::vector<vec4f> &planes,
+                                               const vec3f &eye) const
+    {
+      std::vector<std::pair<float,int>> inside;
+      for (size_t i=0;i<domains.size();i++) {
+        const box3f &box = domains[i];
+        bool culled = false;
+        for (auto plane : planes) {
+          // the box corner farthest along the plane's normal
+          const vec3f corner(plane.x >= 0.f ? box.upper.x : box.lower.x,
+                             plane.y >= 0.f ? box.upper.y : box.lower.y,
+                             plane.z >= 0.f ? box.upper.z : box.lower.z);
+          if (dot(vec3f(plane.x,plane.y,plane.z),corner)+plane.w < 0.f) {
+            culled = true;
+            break;
+          }
+        }
+        if (!culled)
+          inside.push_back({length(box.center()-eye),(int)i});
+      }
+      std::sort(inside.begin(),inside.end());
+      std::vector<int> result;
+      for (auto it : inside)
+        result.push_back(it.second);
+      return result;
+    }
+
+  } // ::umesh::io
+} // ::umesh
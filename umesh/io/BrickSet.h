@@ -0,0 +1,170 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <list>
+#include <mutex>
+#include <thread>
+
+namespace umesh {
+  namespace io {
+
+    /*! reads the bricks of a partitioned data set, as written by
+        umeshPartitionSpatially and umeshPartitionObjectSpace: one
+        <baseName>_%05d.umesh file per brick, plus a <baseName>.domains
+        file with one box3f per brick (followed by one range1f value
+        range per brick). Older data sets that only have a
+        <baseName>.bricks file with the boxes work, too. Data sets
+        partitioned with ghost layers also have a <baseName>.neighbors
+        file with each brick's neighboring bricks (see
+        addGhostLayers()). Bricks written with 16-bit vertices and
+        indices (see umesh/CompactBrick.h) get decoded on load.
+
+        Bricks get loaded by a small pool of background I/O threads,
+        either on demand (get()), or ahead of time, from hints
+        (prefetch()). Loaded bricks stay cached until the memory they
+        use exceeds the given budget, at which point the least
+        recently used ones get dropped - preferably those that are
+        not part of the latest prefetch hint. A dropped brick stays
+        alive for as long as a caller still holds on to it, but will
+        have to be loaded again the next time it is asked for.
+
+        All methods can get called from multiple threads
+        concurrently. */
+    struct BrickSet {
+      typedef std::shared_ptr<BrickSet> SP;
+
+      /*! default memory budget (in bytes) for cached bricks */
+      static const size_t defaultMemoryBudget = size_t(4)<<30;
+
+      /*! opens the data set with given base name; throws if neither
+          its .domains nor its .bricks file can be read. Only the
+          given parts of each brick get loaded */
+      static BrickSet::SP open(const std::string &baseName,
+                               size_t memoryBudget = defaultMemoryBudget,
+                               int numIOThreads = 2,
+                               const LoadSelection &selection = LoadSelection());
+
+      BrickSet(const std::string &baseName,
+               size_t memoryBudget,
+               int numIOThreads,
+               const LoadSelection &selection);
+      BrickSet(const BrickSet &) = delete;
+      /*! waits for loads that are already in progress, and drops all
+          others */
+      ~BrickSet();
+
+      inline size_t numBricks() const { return domains.size(); }
+
+      /*! writes the <baseName>.neighbors file for given neighbor
+          lists (one per brick) */
+      static void saveNeighbors(const std::string &baseName,
+                                const std::vector<std::vector<int>> &neighbors);
+
+      /*! name of the file that given brick gets loaded from */
+      std::string brickFileName(int brickID) const;
+
+      /*! returns given brick, waiting for it to get loaded if it is
+          not cached yet; rethrows whatever error loading it
+          produced */
+      UMesh::SP get(int brickID);
+
+      /*! returns given brick if it is already cached, and nullptr
+          otherwise (without asking for it to get loaded) */
+      UMesh::SP tryGet(int brickID);
+
+      /*! asks for given bricks to get loaded in the background, in
+          the given order (so the most important ones should come
+          first). Replaces any earlier hint's bricks that have not
+          started loading yet, so this can be called every frame.
+          Prefetching stops once the hinted bricks fill the memory
+          budget on their own */
+      void prefetch(const std::vector<int> &brickIDs);
+
+      /*! waits until no more (demand or prefetch) loads are queued or
+          running */
+      void waitIdle();
+
+      /*! IDs of all bricks whose domain overlaps given box */
+      std::vector<int> bricksOverlapping(const box3f &region) const;
+
+      /*! IDs of all bricks whose domain is at least partly inside all
+          given planes, where a plane (a,b,c,d) has all points p with
+          a*p.x+b*p.y+c*p.z+d >= 0 on its inside; sorted by distance
+          of their domains' centers from 'eye' (closest first), which
+          makes it a useful prefetch hint for a view frustum */
+      std::vector<int> bricksInFrustum(const std::vector<vec4f> &planes,
+                                       const vec3f &eye) const;
+
+      /*! memory (in bytes) used by the currently cached bricks */
+      size_t memoryUsage();
+
+      const std::string          baseName;
+      const size_t               memoryBudget;
+      const LoadSelection        selection;
+      /*! each brick's domain */
+      std::vector<box3f>         domains;
+      /*! each brick's value range; empty if the data set does not
+          have any */
+      std::vector<range1f>       valueRanges;
+      /*! each brick's neighboring bricks; empty if the data set does
+          not have a .neighbors file */
+      std::vector<std::vector<int>> neighbors;
+
+    private:
+      typedef enum { NOT_LOADED, QUEUED, LOADING, CACHED, FAILED } State;
+      struct Brick {
+        State              state   = NOT_LOADED;
+        UMesh::SP          mesh;
+        size_t             numBytes = 0;
+        /*! whether the brick is part of the latest prefetch hint */
+        bool               hinted  = false;
+        /*! whether the brick is in the demand queue */
+        bool               demanded = false;
+        std::exception_ptr error;
+        std::list<int>::iterator lruPos;
+      };
+
+      void workerLoop();
+      /*! marks the brick as most recently used; 'lock' is held */
+      void touch(int brickID);
+      /*! drops least recently used bricks (other than 'keep') until
+          the cached ones fit the budget; 'lock' is held */
+      void evict(int keep);
+      void checkID(int brickID) const;
+
+      std::vector<Brick>       bricks;
+      /*! cached bricks, most recently used first */
+      std::list<int>           lru;
+      size_t                   cachedBytes = 0;
+      size_t                   hintedBytes = 0;
+      int                      numLoading  = 0;
+      std::deque<int>          demandQueue;
+      std::deque<int>          prefetchQueue;
+      bool                     quit = false;
+      std::mutex               mutex;
+      /*! signals both new work for the workers, and finished loads */
+      std::condition_variable  changed;
+      std::vector<std::thread> workers;
+    };
+
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,362 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/Compression.h"
+#include "umesh/parallel_for.h"
+#include <atomic>
+#include <cstring>
+
+namespace umesh {
+  namespace io {
+    namespace compression {
+
+      using namespace container;
+
+      /*! (approximate) number of words per block */
+      const size_t wordsPerBlock = 256*1024;
+      /*! number of words that share one bit width in INDICES blocks */
+      const size_t groupSize     = 128;
+      /*! zero runs shorter than this get stored as literals */
+      const size_t minZeroRun    = 4;
+
+      /*! first byte of each set of packed byte planes */
+      typedef enum : uint8_t {
+        /*! the byte planes as they are (if packing doesn't help) */
+        PLANES_STORED = 0,
+        /*! (literal count, literals, zero count)* sequences */
+        PLANES_RLE    = 1
+      } PlanesTag;
+
+      inline void corrupt()
+      { throw std::runtime_error("#umesh.io: corrupt compressed data"); }
+      
+      inline void putVarint(std::vector<uint8_t> &out, size_t value)
+      {
+        while (value >= 0x80) {
+          out.push_back(uint8_t(value) | 0x80);
+          value >>= 7;
+        }
+        out.push_back(uint8_t(value));
+      }
+
+      inline size_t getVarint(const uint8_t *&in, const uint8_t *end)
+      {
+        size_t value = 0;
+        for (int shift=0;shift<64;shift+=7) {
+          if (in == end) corrupt();
+          const uint8_t byte = *in++;
+          value |= size_t(byte & 0x7f) << shift;
+          if (!(byte & 0x80)) return value;
+        }
+        corrupt();
+        return 0;
+      }
+
+      inline uint32_t zigZag(uint32_t diff)
+      { return (diff << 1) ^ uint32_t(int32_t(diff) >> 31); }
+      
+      inline uint32_t unZigZag(uint32_t v)
+      { return (v >> 1) ^ (0u-(v & 1)); }
+
+      void packBytePlanes(const uint32_t *words, size_t n,
+                          std::vector<uint8_t> &out)
+      {
+        std::vector<uint8_t> planes(4*n);
+        for (size_t i=0;i<n;i++)
+          for (int p=0;p<4;p++)
+            planes[p*n+i] = uint8_t(words[i] >> (8*p));
+        
+        const size_t outBegin = out.size();
+        out.push_back(PLANES_RLE);
+        const size_t size = planes.size();
+        size_t i = 0;
+        while (i < size) {
+          // literals, up to the next long-enough run of zeroes
+          const size_t literalBegin = i;
+          while (i < size) {
+            if (planes[i] != 0) { i++; continue; }
+            size_t runEnd = i;
+            while (runEnd < size && planes[runEnd] == 0) runEnd++;
+            if (runEnd-i >= minZeroRun || runEnd == size) break;
+            i = runEnd;
+          }
+          putVarint(out,i-literalBegin);
+          out.insert(out.end(),planes.begin()+literalBegin,planes.begin()+i);
+          const size_t zeroBegin = i;
+          while (i < size && planes[i] == 0) i++;
+          putVarint(out,i-zeroBegin);
+          if (out.size()-outBegin > size) break;
+        }
+        if (out.size()-outBegin > size) {
+          out.resize(outBegin+1+size);
+          out[outBegin] = PLANES_STORED;
+          memcpy(out.data()+outBegin+1,planes.data(),size);
+        }
+      }
+      
+      void unpackBytePlanes(const uint8_t *in, const uint8_t *end,
+                            uint32_t *words, size_t n)
+      {
+        std::vector<uint8_t> planes(4*n);
+        const size_t size = planes.size();
+        if (in == end) corrupt();
+        const uint8_t tag = *in++;
+        if (tag == PLANES_STORED) {
+          if (size_t(end-in) != size) corrupt();
+          memcpy(planes.data(),in,size);
+        } else if (tag == PLANES_RLE) {
+          size_t pos = 0;
+          while (pos < size) {
+            const size_t numLiterals = getVarint(in,end);
+            if (numLiterals > size-pos || numLiterals > size_t(end-in))
+              corrupt();
+            memcpy(planes.data()+pos,in,numLiterals);
+            in  += numLiterals;
+            pos += numLiterals;
+            const size_t numZeroes = getVarint(in,end);
+            if (numZeroes > size-pos) corrupt();
+            // (planes are zero-initialized)
+            pos += numZeroes;
+          }
+          if (in != end) corrupt();
+        } else
+          corrupt();
+
+        for (size_t i=0;i<n;i++)
+          words[i]
+            =  uint32_t(planes[i])
+            | (uint32_t(planes[n+i])   << 8)
+            | (uint32_t(planes[2*n+i]) << 16)
+            | (uint32_t(planes[3*n+i]) << 24);
+      }
+
+      /*! bit-packs 'n' words in groups of 'groupSize', each group
+          starting with a byte for its bit width */
+      void packBits(const uint32_t *words, size_t n,
+                    std::vector<uint8_t> &out)
+      {
+        for (size_t begin=0;begin<n;begin+=groupSize) {
+          const size_t end = std::min(begin+groupSize,n);
+          uint32_t bits = 0;
+          for (size_t i=begin;i<end;i++)
+            bits |= words[i];
+          int width = 0;
+          while (width < 32 && (bits >> width)) width++;
+          out.push_back(uint8_t(width));
+          if (width == 0) continue;
+
+          uint64_t acc = 0;
+          int numBits = 0;
+          for (size_t i=begin;i<end;i++) {
+            acc |= uint64_t(words[i]) << numBits;
+            numBits += width;
+            while (numBits >= 8) {
+              out.push_back(uint8_t(acc));
+              acc >>= 8;
+              numBits -= 8;
+            }
+          }
+          if (numBits > 0)
+            out.push_back(uint8_t(acc));
+        }
+      }
+
+      /*! inverse of packBits() */
+      void unpackBits(const uint8_t *in, const uint8_t *end,
+                      uint32_t *words, size_t n)
+      {
+        for (size_t begin=0;begin<n;begin+=groupSize) {
+          const size_t count = std::min(begin+groupSize,n)-begin;
+          if (in == end) corrupt();
+          const int width = *in++;
+          if (width > 32) corrupt();
+          const size_t numBytes = (count*width+7)/8;
+          if (numBytes > size_t(end-in)) corrupt();
+          if (width == 0) {
+            std::fill(words+begin,words+begin+count,0u);
+            continue;
+          }
+          const uint64_t mask = (1ULL << width)-1;
+          uint64_t acc = 0;
+          int numBits = 0;
+          for (size_t i=0;i<count;i++) {
+            while (numBits < width) {
+              acc |= uint64_t(*in++) << numBits;
+              numBits += 8;
+            }
+            words[begin+i] = uint32_t(acc & mask);
+            acc >>= width;
+            numBits -= width;
+          }
+        }
+        if (in != end) corrupt();
+      }
+      
+      Codec codecFor(uint32_t sectionType, uint32_t &stride)
+      {
+        switch (sectionType) {
+        case VERTICES:
+          stride = sizeof(vec3f)/4;    return FLOATS;
+        case VERTEX_ATTRIBUTE:
+        case ELEMENT_ATTRIBUTE:
+        case GRID_SCALARS:
+          stride = 1;                  return FLOATS;
+        case GRIDS:
+          stride = sizeof(Grid)/4;     return FLOATS;
+        case TRIANGLES:
+          stride = sizeof(Triangle)/4; return INDICES;
+        case QUADS:
+          stride = sizeof(Quad)/4;     return INDICES;
+        case TETS:
+          stride = sizeof(Tet)/4;      return INDICES;
+        case PYRS:
+          stride = sizeof(Pyr)/4;      return INDICES;
+        case WEDGES:
+          stride = sizeof(Wedge)/4;    return INDICES;
+        case HEXES:
+          stride = sizeof(Hex)/4;      return INDICES;
+        case VERTEX_TAGS:
+          stride = sizeof(size_t)/4;   return INDICES;
+        default:
+          stride = 1;                  return NONE;
+        }
+      }
+
+      std::vector<uint8_t> compress(Codec codec,
+                                    const void *data,
+                                    size_t numBytes,
+                                    uint32_t stride)
+      {
+        if (codec != INDICES && codec != FLOATS)
+          throw std::runtime_error("#umesh.io: invalid compression codec "
+                                   +std::to_string(codec));
+        if (stride == 0 || numBytes % (4*stride))
+          throw std::runtime_error("#umesh.io: cannot compress data that is not"
+                                   " a multiple of the element size");
+        const uint32_t *words = (const uint32_t *)data;
+        const size_t numWords = numBytes/4;
+        
+        Header header;
+        header.codec      = codec;
+        header.stride     = stride;
+        header.rawBytes   = numBytes;
+        header.blockWords = uint32_t(std::max(size_t(1),wordsPerBlock/stride)*stride);
+        header.numBlocks  = uint32_t(divRoundUp(numWords,size_t(header.blockWords)));
+        
+        std::vector<std::vector<uint8_t>> blocks(header.numBlocks);
+        parallel_for(header.numBlocks,[&](size_t blockID){
+            const size_t begin = blockID*header.blockWords;
+            const size_t n     = std::min(begin+header.blockWords,numWords)-begin;
+            const uint32_t *in = words+begin;
+            std::vector<uint32_t> diffs(n);
+            for (size_t i=0;i<n;i++)
+              diffs[i] = zigZag(in[i] - (i >= stride ? in[i-stride] : 0u));
+            if (codec == INDICES)
+              packBits(diffs.data(),n,blocks[blockID]);
+            else
+              packBytePlanes(diffs.data(),n,blocks[blockID]);
+          });
+        
+        std::vector<uint64_t> offsets(header.numBlocks+1,0);
+        for (size_t blockID=0;blockID<header.numBlocks;blockID++)
+          offsets[blockID+1] = offsets[blockID]+blocks[blockID].size();
+        const size_t dataBegin = sizeof(header)+offsets.size()*sizeof(uint64_t);
+        std::vector<uint8_t> out(dataBegin+offsets.back());
+        memcpy(out.data(),&header,sizeof(header));
+        memcpy(out.data()+sizeof(header),offsets.data(),offsets.size()*sizeof(uint64_t));
+        parallel_for(header.numBlocks,[&](size_t blockID){
+            memcpy(out.data()+dataBegin+offsets[blockID],
+                   blocks[blockID].data(),blocks[blockID].size());
+          });
+        return out;
+      }
+      
+      void decompress(const void *data, size_t numBytes,
+                      void *dst, size_t rawBytes)
+      {
+        const uint8_t *in  = (const uint8_t *)data;
+        const uint8_t *end = in+numBytes;
+        Header header;
+        if (numBytes < sizeof(header)) corrupt();
+        memcpy(&header,in,sizeof(header));
+        in += sizeof(header);
+        if (header.codec != INDICES && header.codec != FLOATS)
+          throw std::runtime_error("#umesh.io: unknown compression codec "
+                                   +std::to_string(header.codec));
+        if (header.rawBytes != rawBytes)
+          throw std::runtime_error("#umesh.io: compressed section has wrong size");
+        const size_t numWords = rawBytes/4;
+        if (rawBytes % 4 ||
+            header.stride == 0 ||
+            header.blockWords == 0 ||
+            header.blockWords % header.stride ||
+            header.numBlocks != divRoundUp(numWords,size_t(header.blockWords)) ||
+            size_t(end-in) < (header.numBlocks+1)*sizeof(uint64_t))
+          corrupt();
+        std::vector<uint64_t> offsets(header.numBlocks+1);
+        memcpy(offsets.data(),in,offsets.size()*sizeof(uint64_t));
+        in += offsets.size()*sizeof(uint64_t);
+        if (offsets[0] != 0 || offsets.back() != uint64_t(end-in)) corrupt();
+
+        uint32_t *words = (uint32_t *)dst;
+        const size_t stride = header.stride;
+        std::atomic<bool> failed(false);
+        parallel_for(header.numBlocks,[&](size_t blockID){
+            const size_t begin = blockID*header.blockWords;
+            const size_t n     = std::min(begin+header.blockWords,numWords)-begin;
+            if (offsets[blockID] > offsets[blockID+1] ||
+                offsets[blockID+1] > offsets.back()) {
+              failed = true;
+              return;
+            }
+            uint32_t *out = words+begin;
+            try {
+              if (header.codec == INDICES)
+                unpackBits(in+offsets[blockID],in+offsets[blockID+1],out,n);
+              else
+                unpackBytePlanes(in+offsets[blockID],in+offsets[blockID+1],out,n);
+            } catch (std::runtime_error &) {
+              failed = true;
+              return;
+            }
+            for (size_t i=0;i<n;i++)
+              out[i] = unZigZag(out[i]) + (i >= stride ? out[i-stride] : 0u);
+          });
+        if (failed) corrupt();
+      }
+
+      bool compressSection(Section &desc,
+                           const void *data,
+                           std::vector<uint8_t> &compressed)
+      {
+        uint32_t stride;
+        const Codec codec = codecFor(desc.type,stride);
+        if (codec == NONE || desc.compression != NONE ||
+            desc.numBytes == 0 || desc.numBytes % (4*stride))
+          return false;
+        compressed = compress(codec,data,desc.numBytes,stride);
+        if (compressed.size() >= desc.numBytes) {
+          compressed.clear();
+          return false;
+        }
+        desc.numBytes    = compressed.size();
+        desc.compression = codec;
+        return true;
+      }
+      
+    } // ::umesh::io::compression
+  } // ::umesh::io
+} // ::umesh
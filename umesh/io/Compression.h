@@ -0,0 +1,107 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* optional compression of (version-2) .umesh sections. Neither
+   compressing nor decompressing needs anything beyond this library:
+   a section's data gets split into fixed-size blocks that get
+   (de)compressed independently, and in parallel, so decompressing is
+   usually a lot faster than reading the same data uncompressed from
+   a (shared) file system.
+
+   Both codecs first replace each 32-bit word with the zig-zag
+   encoded difference to the same word of the previous element (ie,
+   'stride' words earlier), which for SFC-reordered meshes (and
+   smooth fields) makes most of the words small; they differ in how
+   they store these differences. */
+
+#pragma once
+
+#include "umesh/io/Container.h"
+
+namespace umesh {
+  namespace io {
+    namespace compression {
+
+      typedef enum : uint32_t {
+        NONE    = 0,
+        /*! for integer arrays (vertex indices, tags): the differences
+            get bit-packed, in groups of 128 with one bit width per
+            group */
+        INDICES = 1,
+        /*! for float arrays (vertices, attributes, grids): the
+            differences get split into byte planes (all lowest bytes
+            first, etc), and runs of zero bytes get run-length
+            encoded */
+        FLOATS  = 2
+      } Codec;
+
+      /*! header at the start of a compressed section's data, followed
+          by 'numBlocks+1' uint64 block offsets (relative to the end of
+          that table), and then the blocks */
+      struct Header {
+        uint32_t codec      = NONE;
+        /*! number of 32-bit words per element */
+        uint32_t stride     = 1;
+        /*! size of the uncompressed data */
+        uint64_t rawBytes   = 0;
+        /*! number of words per block; a multiple of 'stride' */
+        uint32_t blockWords = 0;
+        uint32_t numBlocks  = 0;
+      };
+
+      /*! the codec to use for given section type, with the number of
+          32-bit words per element (stored in 'stride'); NONE for
+          section types that do not get compressed */
+      Codec codecFor(uint32_t sectionType, uint32_t &stride);
+
+      /*! compresses 'numBytes' (a multiple of 4*stride) bytes of given
+          data */
+      std::vector<uint8_t> compress(Codec codec,
+                                    const void *data,
+                                    size_t numBytes,
+                                    uint32_t stride);
+      
+      /*! decompresses given data (as produced by compress()) into
+          'dst', which has to hold exactly 'rawBytes' bytes; throws if
+          the data is corrupt, or does not decompress to that size */
+      void decompress(const void *data, size_t numBytes,
+                      void *dst, size_t rawBytes);
+
+      /*! compresses given section's data with the codec suited for
+          the section's type, and updates its descriptor's 'numBytes'
+          and 'compression' accordingly. Returns false (and leaves
+          both unchanged) if the section does not get compressed,
+          either because of its type or because compressing would not
+          make it any smaller */
+      bool compressSection(container::Section &desc,
+                           const void *data,
+                           std::vector<uint8_t> &compressed);
+      
+      /*! packs 'n' words into byte planes, with runs of zero bytes
+          run-length encoded (and falls back to storing the planes as
+          they are if that does not make things smaller), and appends
+          the result to 'out'. Used by FLOATS, and by the time-series
+          encoding (io/TimeSeries.h) */
+      void packBytePlanes(const uint32_t *words, size_t n,
+                          std::vector<uint8_t> &out);
+      /*! inverse of packBytePlanes(), for data in [in,end); throws if
+          that is not exactly 'n' words worth of packed planes */
+      void unpackBytePlanes(const uint8_t *in, const uint8_t *end,
+                            uint32_t *words, size_t n);
+
+    } // ::umesh::io::compression
+  } // ::umesh::io
+} // ::umesh
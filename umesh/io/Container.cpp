@@ -0,0 +1,215 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/Container.h"
+#include "umesh/io/IO.h"
+
+namespace umesh {
+  namespace io {
+    namespace container {
+
+      static_assert(sizeof(Header)  ==  64, "wrong size of container header");
+      static_assert(sizeof(Section) == 128, "wrong size of container section");
+
+      void Section::setName(const std::string &name)
+      {
+        if (name.size() >= sizeof(this->name))
+          throw std::runtime_error("#umesh.io: section name '"+name+"' too long"
+                                   " (at most "+std::to_string(sizeof(this->name)-1)
+                                   +" characters)");
+        memset(this->name,0,sizeof(this->name));
+        memcpy(this->name,name.data(),name.size());
+      }
+
+      const uint64_t checksumPrime   = 0x9E3779B97F4A7C15ULL;
+
+      inline uint64_t mix(uint64_t h, uint64_t w)
+      {
+        h ^= w;
+        h *= checksumPrime;
+        h ^= h >> 29;
+        return h;
+      }
+
+      uint64_t checksumBlock(const uint8_t *data, size_t numBytes, size_t blockID)
+      {
+        uint64_t h = mix(0xcbf29ce484222325ULL,blockID);
+        const size_t numWords = numBytes / sizeof(uint64_t);
+        for (size_t i=0;i<numWords;i++) {
+          uint64_t w;
+          memcpy(&w,data+i*sizeof(w),sizeof(w));
+          h = mix(h,w);
+        }
+        const size_t numTail = numBytes - numWords*sizeof(uint64_t);
+        if (numTail) {
+          uint64_t w = 0;
+          memcpy(&w,data+numWords*sizeof(w),numTail);
+          h = mix(h,w);
+        }
+        return h;
+      }
+
+      uint64_t checksum(const void *data, size_t numBytes)
+      {
+        IncrementalChecksum checksum;
+        checksum.add(data,numBytes);
+        return checksum.finish();
+      }
+
+      void IncrementalChecksum::add(const void *data, size_t count)
+      {
+        if (numBytes % checksumBlockSize)
+          throw std::runtime_error("#umesh.io: IncrementalChecksum::add()"
+                                   " after a partial block");
+        const size_t firstBlock = blockHashes.size();
+        const size_t numBlocks  = divRoundUp(count,checksumBlockSize);
+        blockHashes.resize(firstBlock+numBlocks);
+        parallel_for(numBlocks,[&](size_t blockID){
+          const size_t begin = blockID*checksumBlockSize;
+          const size_t end   = std::min(begin+checksumBlockSize,count);
+          blockHashes[firstBlock+blockID]
+            = checksumBlock((const uint8_t *)data+begin,end-begin,
+                            firstBlock+blockID);
+        });
+        numBytes += count;
+      }
+
+      uint64_t IncrementalChecksum::finish() const
+      {
+        uint64_t h = mix(0x84222325cbf29ce4ULL,numBytes);
+        for (auto bh : blockHashes)
+          h = mix(h,bh);
+        return h;
+      }
+
+      std::string toString(uint32_t sectionType)
+      {
+        switch (sectionType) {
+        case VERTICES:          return "vertices";
+        case VERTEX_ATTRIBUTE:  return "vertexAttribute";
+        case ELEMENT_ATTRIBUTE: return "elementAttribute";
+        case TRIANGLES:         return "triangles";
+        case QUADS:             return "quads";
+        case TETS:              return "tets";
+        case PYRS:              return "pyramids";
+        case WEDGES:            return "wedges";
+        case HEXES:             return "hexes";
+        case GRIDS:             return "grids";
+        case GRID_SCALARS:      return "gridScalars";
+        case VERTEX_TAGS:       return "vertexTags";
+        case TIME_STEP:         return "timeStep";
+        case QUANTIZED_ATTRIBUTE: return "quantizedAttribute";
+        case ATTRIBUTE_STATS:   return "attributeStats";
+        case QUANTIZED_VERTICES: return "quantizedVertices";
+        case INDICES_16:        return "indices16";
+        default:
+          return "<unknown section type "+std::to_string(sectionType)+">";
+        }
+      }
+
+      void layout(Header &header, std::vector<OutputSection> &sections)
+      {
+        header.numSections = (uint32_t)sections.size();
+        header.tocOffset   = sizeof(Header);
+
+        uint64_t offset = header.tocOffset + sections.size()*sizeof(Section);
+        for (auto &section : sections) {
+          offset = alignUp(offset);
+          section.desc.offset   = offset;
+          section.desc.checksum = checksum(section.data,section.desc.numBytes);
+          offset += section.desc.numBytes;
+        }
+
+        std::vector<Section> toc;
+        for (auto &section : sections)
+          toc.push_back(section.desc);
+        header.tocChecksum = checksum(toc.data(),toc.size()*sizeof(Section));
+      }
+
+      void write(std::ostream &out,
+                 const Header &header,
+                 const std::vector<OutputSection> &sections)
+      {
+        if (header.tocOffset != sizeof(Header))
+          throw std::runtime_error("#umesh.io: container::write() requires the "
+                                   "TOC to follow the header; did you call layout()?");
+        writeElement(out,header);
+        for (auto &section : sections)
+          writeElement(out,section.desc);
+
+        uint64_t position = header.tocOffset + sections.size()*sizeof(Section);
+        const std::vector<char> padding(alignment,0);
+        for (auto &section : sections) {
+          if (section.desc.offset < position)
+            throw std::runtime_error("#umesh.io: container sections not in file order");
+          writeArray(out,padding.data(),section.desc.offset-position);
+          writeArray(out,(const char *)section.data,section.desc.numBytes);
+          position = section.desc.offset+section.desc.numBytes;
+        }
+        if (!out.good())
+          throw std::runtime_error("#umesh.io: error writing umesh container");
+      }
+
+      uint64_t readTOC(std::istream &in,
+                       uint64_t magic,
+                       Header &header,
+                       std::vector<Section> &sections)
+      {
+        if (!isContainer(magic))
+          throw std::runtime_error("#umesh.io: not a umesh container (wrong magic)");
+        header.magic = magic;
+        readArray(in,(char*)&header+sizeof(magic),sizeof(Header)-sizeof(magic));
+        if (header.version != container::version)
+          throw std::runtime_error("#umesh.io: unsupported container version "
+                                   +std::to_string(header.version));
+
+        uint64_t position = sizeof(Header);
+        if (header.tocOffset != position)
+          in.seekg(std::streamoff(header.tocOffset)-std::streamoff(position),
+                   std::ios::cur);
+        sections.resize(header.numSections);
+        readArray(in,sections.data(),sections.size());
+        if (checksum(sections.data(),sections.size()*sizeof(Section))
+            != header.tocChecksum)
+          throw std::runtime_error("#umesh.io: checksum mismatch in container TOC");
+        position = header.tocOffset+sections.size()*sizeof(Section);
+        return position;
+      }
+
+      void SectionReader::seek(uint64_t offset)
+      {
+        if (offset > position)
+          in.ignore(std::streamsize(offset-position));
+        else if (offset < position)
+          in.seekg(-std::streamoff(position-offset),std::ios::cur);
+        if (!in.good())
+          throw std::runtime_error("#umesh.io: could not seek to container section");
+        position = offset;
+      }
+
+      void SectionReader::read(const Section &section, void *dst)
+      {
+        seek(section.offset);
+        readArray(in,(char *)dst,section.numBytes);
+        position += section.numBytes;
+        if (checksum(dst,section.numBytes) != section.checksum)
+          throw std::runtime_error("#umesh.io: checksum mismatch in section '"
+                                   +toString(section.type)+"'");
+      }
+
+    } // ::umesh::io::container
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,269 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include <iostream>
+#include <cstring>
+
+namespace umesh {
+  namespace io {
+
+    /*! the (version 2) .umesh container format. A file consists of
+
+        - a 64-byte Header;
+
+        - a table of contents (TOC) of 'numSections' Section
+          descriptors of 128 bytes each, starting at
+          'header.tocOffset' (usually right after the header, but a
+          streaming writer may put it at the end of the file);
+
+        - the actual section data, each section starting at a
+          64-byte aligned file offset.
+
+        Each section describes one contiguous array (vertices, tets,
+        one named attribute, etc), either as it is in memory or
+        compressed (see io/Compression.h); an array may be split into
+        multiple consecutive sections of the same type (and name),
+        in which case readers concatenate them in TOC order. Readers
+        are expected to skip section types they do not know.
+
+        All offsets are relative to the start of the header, so a
+        container can be embedded in another stream. */
+    namespace container {
+
+      /*! magic number for version-2 .umesh files; the older formats
+          used 0x234235566, 0x234235567, and 0x234235568 */
+      const uint64_t magic      = 0x234235569ULL;
+      const uint32_t version    = 2;
+      /*! alignment of each section's data, in bytes */
+      const uint64_t alignment  = 64;
+
+      typedef enum : uint32_t {
+        INVALID_SECTION   = 0,
+        VERTICES          = 1,
+        /*! named per-vertex attribute, one float per vertex */
+        VERTEX_ATTRIBUTE  = 2,
+        /*! named per-element attribute, one float per element of the
+            prim type specified in the section's 'flags' */
+        ELEMENT_ATTRIBUTE = 3,
+        TRIANGLES         = 4,
+        QUADS             = 5,
+        TETS              = 6,
+        PYRS              = 7,
+        WEDGES            = 8,
+        HEXES             = 9,
+        GRIDS             = 10,
+        GRID_SCALARS      = 11,
+        VERTEX_TAGS       = 12,
+        /*! one time step of a time-varying per-vertex variable; the
+            name is the variable's, 'flags' the time step ID, and the
+            data encoded as described in io/TimeSeries.h */
+        TIME_STEP         = 13,
+        /*! named per-vertex QuantizedAttribute: one 8- or 16-bit code
+            (as given in 'flags') per vertex, relative to the section's
+            'valueRange' */
+        QUANTIZED_ATTRIBUTE = 14,
+        /*! ScalarStats (as encoded by ScalarStats::encode()) of the
+            attribute of the same name; 'flags' is the UMesh::PrimType
+            for per-element attributes, and UMesh::INVALID for
+            per-vertex ones. Written after all other sections, so
+            sequential readers get to them last */
+        ATTRIBUTE_STATS   = 15,
+        /*! one axis ('flags' = 0, 1, or 2) of the vertices'
+            CompactBrick-quantized coordinates: one 16-bit code per
+            vertex, relative to the section's 'valueRange' (see
+            umesh/CompactBrick.h). Replaces the VERTICES section */
+        QUANTIZED_VERTICES = 16,
+        /*! 16-bit vertex indices of the elements of the
+            UMesh::PrimType given in 'flags'; unlike for the element
+            sections the count is the number of indices, not of
+            elements. Replaces that type's element section */
+        INDICES_16        = 17
+      } SectionType;
+
+      struct Header {
+        uint64_t magic            = container::magic;
+        uint32_t version          = container::version;
+        uint32_t numSections      = 0;
+        /*! file offset of the first TOC entry */
+        uint64_t tocOffset        = 0;
+        /*! bounds and grid-scalar range as computed by
+            UMesh::finalize(); allows for getting these without
+            having to read any section data */
+        box3f    bounds;
+        range1f  gridsScalarRange;
+        /*! checksum over all TOC entries */
+        uint64_t tocChecksum      = 0;
+      };
+
+      struct Section {
+        /*! one of SectionType */
+        uint32_t type             = INVALID_SECTION;
+        /*! type-specific flags; for ELEMENT_ATTRIBUTEs this is the
+            UMesh::PrimType the attribute is associated with, for
+            TIME_STEPs the time step ID */
+        uint32_t flags            = 0;
+        /*! file offset, relative to start of the header */
+        uint64_t offset           = 0;
+        /*! number of bytes stored in the file; for compressed
+            sections that is the size of the compressed data */
+        uint64_t numBytes         = 0;
+        /*! number of elements in this section */
+        uint64_t count            = 0;
+        /*! io::container::checksum() of this section's data as
+            stored in the file */
+        uint64_t checksum         = 0;
+        /*! for attribute sections, the range of values in this
+            section (may be empty if not known) */
+        range1f  valueRange;
+        /*! for named sections (attributes) the name, else empty */
+        char     name[76]         = { 0 };
+        /*! the io::compression::Codec this section's data is
+            compressed with. This used to be the end of a (zero-padded)
+            80-character name, so for older files it is 0 -
+            uncompressed - unless a name was longer than 75 characters */
+        uint32_t compression      = 0;
+
+        inline std::string getName() const
+        { return std::string(name,strnlen(name,sizeof(name))); }
+        void setName(const std::string &name);
+      };
+
+      /*! a section to be written, describing where its data lives in
+          host memory */
+      struct OutputSection {
+        Section     desc;
+        const void *data = nullptr;
+      };
+
+      /*! fast, 64-bit checksum over given range of memory. This is
+          computed in parallel over fixed-size blocks (and thus
+          independent of the number of threads), so it can be
+          verified on load without dominating load time */
+      uint64_t checksum(const void *data, size_t numBytes);
+
+      /*! block size for checksum() - each block gets hashed
+          independently (and in parallel), then the block hashes get
+          combined */
+      const size_t checksumBlockSize = 1024*1024;
+
+      /*! computes the same checksum as checksum(), over data that
+          arrives in consecutive pieces (eg, the chunks of a section
+          as they get read); all pieces but the last one have to be
+          multiples of checksumBlockSize */
+      struct IncrementalChecksum {
+        void add(const void *data, size_t numBytes);
+        uint64_t finish() const;
+      private:
+        size_t                numBytes = 0;
+        std::vector<uint64_t> blockHashes;
+      };
+
+      /*! returns a human-readable name for given section type */
+      std::string toString(uint32_t sectionType);
+
+      /*! returns the smallest multiple of 'alignment' that is >=
+          given offset */
+      inline uint64_t alignUp(uint64_t offset)
+      { return (offset + alignment - 1) / alignment * alignment; }
+
+      /*! computes file offsets (TOC right after the header, then
+          64-byte aligned sections in the given order) and checksums
+          for all given sections, and fills in the header's TOC
+          fields */
+      void layout(Header &header, std::vector<OutputSection> &sections);
+
+      /*! writes the entire container - header, TOC, and all section
+          data, including padding - to given stream. Requires that
+          layout() has been called before */
+      void write(std::ostream &out,
+                 const Header &header,
+                 const std::vector<OutputSection> &sections);
+
+      /*! reads header and TOC from given stream. The magic number
+          (the first eight bytes of the header) has already been read
+          from the stream, and is passed in as 'magic'. Returns the
+          position (relative to the start of the container) the
+          stream was left at */
+      uint64_t readTOC(std::istream &in,
+                       uint64_t magic,
+                       Header &header,
+                       std::vector<Section> &sections);
+
+      /*! helper class that sequentially reads sections from a
+          stream; sections should be requested in increasing file
+          order (going backwards requires a seekable stream) */
+      struct SectionReader {
+        /*! 'position' is the current stream position relative to the
+            start of the container (ie, the start of its header) */
+        SectionReader(std::istream &in, uint64_t position)
+          : in(in), position(position)
+        {}
+
+        /*! read given section's data into 'dst' (which must have
+            space for section.numBytes bytes), and verify its
+            checksum */
+        void read(const Section &section, void *dst);
+
+        /*! move to given offset (relative to start of container) */
+        void seek(uint64_t offset);
+
+        std::istream &in;
+        uint64_t      position;
+      };
+
+      /*! reads given section's data into a std::vector of T's; throws
+          if the section's size does not match */
+      template<typename T>
+      inline void readSection(SectionReader &reader,
+                              const Section &section,
+                              std::vector<T> &vec)
+      {
+        if (section.numBytes != section.count*sizeof(T))
+          throw std::runtime_error("#umesh.io: section '"
+                                   +toString(section.type)
+                                   +"' has wrong element size");
+        vec.resize(section.count);
+        reader.read(section,vec.data());
+      }
+
+      /*! create a section descriptor for given array */
+      template<typename T>
+      inline OutputSection makeSection(uint32_t type,
+                                       const std::vector<T> &vec,
+                                       const std::string &name = "",
+                                       uint32_t flags = 0)
+      {
+        OutputSection section;
+        section.desc.type     = type;
+        section.desc.flags    = flags;
+        section.desc.count    = vec.size();
+        section.desc.numBytes = vec.size()*sizeof(T);
+        section.desc.setName(name);
+        section.data          = vec.data();
+        return section;
+      }
+
+      /*! returns true if given magic number is that of a version-2
+          container */
+      inline bool isContainer(uint64_t magic)
+      { return magic == container::magic; }
+
+    } // ::umesh::io::container
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,234 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/DerivedCache.h"
+#include "umesh/io/IO.h"
+#include "umesh/io/Container.h"
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <random>
+
+namespace umesh {
+  namespace io {
+
+    /*! magic number at the beginning and end of each cache file */
+    const uint64_t cacheMagic   = 0x2342355c4ac4e5ULL;
+    /*! version of the cache file layout; bump this whenever the
+        layout - or that of any of the cached structures - changes,
+        so old cache files get ignored */
+    const uint32_t cacheVersion = 1;
+
+    inline uint64_t combine(uint64_t h, uint64_t v)
+    {
+      h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+      return h;
+    }
+
+    inline uint64_t bitsOf(float f)
+    {
+      uint32_t bits;
+      memcpy(&bits,&f,sizeof(bits));
+      return bits;
+    }
+
+    template<typename T>
+    inline uint64_t hashArray(uint64_t h, uint32_t tag, const std::vector<T> &v)
+    { return combine(combine(h,tag),container::checksum(v.data(),v.size()*sizeof(T))); }
+    
+    inline uint64_t hashName(uint64_t h, const std::string &name)
+    { return combine(h,container::checksum(name.data(),name.size())); }
+    
+    uint64_t contentHash(const UMesh &mesh, uint32_t parts)
+    {
+      using namespace container;
+      uint64_t h = combine(0xcbf29ce484222325ULL,parts);
+      if (parts & HASH_VERTICES)
+        h = hashArray(h,VERTICES,mesh.vertices);
+      if (parts & HASH_ELEMENTS) {
+        h = hashArray(h,TRIANGLES,mesh.triangles);
+        h = hashArray(h,QUADS,mesh.quads);
+        h = hashArray(h,TETS,mesh.tets);
+        h = hashArray(h,PYRS,mesh.pyrs);
+        h = hashArray(h,WEDGES,mesh.wedges);
+        h = hashArray(h,HEXES,mesh.hexes);
+        h = hashArray(h,GRIDS,mesh.grids);
+      }
+      if (parts & HASH_ATTRIBUTES) {
+        if (mesh.perVertex)
+          h = hashArray(hashName(h,mesh.perVertex->name),
+                        VERTEX_ATTRIBUTE,mesh.perVertex->values);
+        for (auto attr : mesh.attributes)
+          h = hashArray(hashName(h,attr->name),VERTEX_ATTRIBUTE,attr->values);
+        for (auto attr : mesh.elementAttributes)
+          h = hashArray(hashName(combine(h,attr.first),attr.second->name),
+                        ELEMENT_ATTRIBUTE,attr.second->values);
+        for (auto attr : mesh.quantizedAttributes) {
+          h = combine(hashName(h,attr->name),attr->bits);
+          h = combine(combine(h,bitsOf(attr->valueRange.lower)),
+                      bitsOf(attr->valueRange.upper));
+          h = attr->bits == 8
+            ? hashArray(h,QUANTIZED_ATTRIBUTE,attr->codes8)
+            : hashArray(h,QUANTIZED_ATTRIBUTE,attr->codes16);
+        }
+        h = hashArray(h,GRID_SCALARS,mesh.gridScalars);
+        h = hashArray(h,VERTEX_TAGS,mesh.vertexTags);
+      }
+      return h;
+    }
+
+    DerivedCache::DerivedCache(UMesh::SP mesh, const std::string &prefix)
+      : mesh(mesh), prefix(prefix)
+    {}
+
+    std::string DerivedCache::fileNameOf(const std::string &kind) const
+    { return prefix+"."+kind+".cache"; }
+
+    uint64_t DerivedCache::hash(uint32_t parts)
+    {
+      auto it = hashes.find(parts);
+      if (it != hashes.end()) return it->second;
+      return hashes[parts] = contentHash(*mesh,parts);
+    }
+    
+    bool DerivedCache::load(const std::string &kind, uint64_t key,
+                            const std::function<void(std::istream &)> &read) const
+    {
+      std::ifstream in(fileNameOf(kind),std::ios::binary);
+      if (!in.good()) return false;
+      try {
+        if (readElement<uint64_t>(in) != cacheMagic   ||
+            readElement<uint32_t>(in) != cacheVersion ||
+            readString(in)            != kind         ||
+            readElement<uint64_t>(in) != key)
+          return false;
+        const std::streampos begin = in.tellg();
+        read(in);
+        if (!in.good()) return false;
+        const uint64_t numBytes = uint64_t(in.tellg()-begin);
+        // the trailer only gets written after all of the data, so
+        // this also catches truncated files
+        return
+          readElement<uint64_t>(in) == cacheMagic &&
+          readElement<uint64_t>(in) == numBytes;
+      } catch (std::exception &) {
+        return false;
+      }
+    }
+
+    void DerivedCache::store(const std::string &kind, uint64_t key,
+                             const std::function<void(std::ostream &)> &write) const
+    {
+      const std::string fileName = fileNameOf(kind);
+      const std::string tmpFileName
+        = fileName+".tmp"+std::to_string(std::random_device()()
+                                         ^ std::chrono::steady_clock::now().time_since_epoch().count());
+      std::ofstream out(tmpFileName,std::ios::binary);
+      if (out.good()) {
+        writeElement(out,cacheMagic);
+        writeElement(out,cacheVersion);
+        writeString(out,kind);
+        writeElement(out,key);
+        const std::streampos begin = out.tellp();
+        write(out);
+        const uint64_t numBytes = uint64_t(out.tellp()-begin);
+        writeElement(out,cacheMagic);
+        writeElement(out,numBytes);
+        out.close();
+      }
+      if (out.fail()) {
+        std::cerr << "#umesh.io: warning - could not write cache file '"
+                  << tmpFileName << "'" << std::endl;
+        std::remove(tmpFileName.c_str());
+        return;
+      }
+      // (on some platforms renaming does not replace existing files)
+      if (std::rename(tmpFileName.c_str(),fileName.c_str()) != 0 &&
+          (std::remove(fileName.c_str()),
+           std::rename(tmpFileName.c_str(),fileName.c_str()) != 0)) {
+        std::cerr << "#umesh.io: warning - could not write cache file '"
+                  << fileName << "'" << std::endl;
+        std::remove(tmpFileName.c_str());
+      }
+    }
+
+    /*! loads the structure of given kind from the cache if it's
+        there (and valid), or computes (and caches) it otherwise;
+        works for all structures with read() and write() members */
+    template<typename T, typename Compute>
+    std::shared_ptr<T> loadOrCompute(const DerivedCache &cache,
+                                     const std::string &kind,
+                                     uint64_t key,
+                                     const Compute &compute)
+    {
+      std::shared_ptr<T> result = std::make_shared<T>();
+      if (cache.load(kind,key,[&](std::istream &in){ result->read(in); })) {
+        if (verbose)
+          std::cout << "#umesh.io: using cached " << kind
+                    << " from '" << cache.fileNameOf(kind) << "'" << std::endl;
+        return result;
+      }
+      result = compute();
+      cache.store(kind,key,[&](std::ostream &out){ result->write(out); });
+      return result;
+    }
+
+    FaceConn::SP DerivedCache::faceConn(FaceConn::Method method)
+    {
+      return loadOrCompute<FaceConn>
+        (*this,method == FaceConn::HASH ? "faceConn.hash" : "faceConn",
+         hash(HASH_ELEMENTS),
+         [&]{ return FaceConn::compute(mesh,method); });
+    }
+
+    TetConn::SP DerivedCache::tetConn(TetConn::FaceOrder faceOrder)
+    {
+      return loadOrCompute<TetConn>
+        (*this,"tetConn",combine(hash(HASH_ELEMENTS),faceOrder),
+         [&]{ return TetConn::computeFrom(mesh,faceOrder); });
+    }
+
+    Adjacency::SP DerivedCache::adjacency()
+    {
+      return loadOrCompute<Adjacency>
+        (*this,"adjacency",hash(HASH_ELEMENTS),
+         [&]{ return Adjacency::compute(mesh,*faceConn()); });
+    }
+
+    std::vector<PartitionBrick> DerivedCache::partition(const PartitionOptions &options)
+    {
+      const std::string kind
+        = options.method == PARTITION_SPATIAL
+        ? "partition.spatial"
+        : "partition.objectSpace";
+      uint64_t key = hash(HASH_VERTICES|HASH_ELEMENTS);
+      key = combine(key,options.method);
+      key = combine(key,options.maxBricks);
+      key = combine(key,options.leafThreshold);
+      std::vector<PartitionBrick> bricks;
+      if (load(kind,key,[&](std::istream &in){ bricks = readBricks(in); })) {
+        if (verbose)
+          std::cout << "#umesh.io: using cached " << kind
+                    << " from '" << fileNameOf(kind) << "'" << std::endl;
+        return bricks;
+      }
+      bricks = umesh::partition(mesh,options);
+      store(kind,key,[&](std::ostream &out){ writeBricks(out,bricks); });
+      return bricks;
+    }
+    
+  } // ::umesh::io
+} // ::umesh
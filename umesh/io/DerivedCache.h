@@ -0,0 +1,111 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/FaceConn.h"
+#include "umesh/TetConn.h"
+#include "umesh/Adjacency.h"
+#include "umesh/partition.h"
+#include <functional>
+#include <map>
+
+namespace umesh {
+  namespace io {
+
+    /*! the parts of a mesh that contentHash() can cover */
+    typedef enum : uint32_t {
+      /*! the vertex positions */
+      HASH_VERTICES   = (1<<0),
+      /*! all surface and volume element arrays, and the grids (but
+          not their scalars) */
+      HASH_ELEMENTS   = (1<<1),
+      /*! all (vertex, element, and quantized) attributes, the grid
+          scalars, and the vertex tags */
+      HASH_ATTRIBUTES = (1<<2),
+      HASH_ALL        = HASH_VERTICES|HASH_ELEMENTS|HASH_ATTRIBUTES
+    } HashParts;
+    
+    /*! a 64-bit hash of the content of given parts of a mesh; each
+        array gets hashed with container::checksum() (ie, in parallel,
+        over fixed-size blocks), so this runs at memory bandwidth and
+        does not depend on the number of threads. Attributes get
+        hashed with their names */
+    uint64_t contentHash(const UMesh &mesh, uint32_t parts = HASH_ALL);
+
+    /*! an (opt-in) on-disk cache of structures derived from a mesh -
+        its face connectivity, tet connectivity, adjacency, and
+        partitionings - so that tools that get run on the same mesh
+        over and over do not have to recompute them every time.
+
+        Each structure gets stored in a sidecar file of its own, named
+        '<prefix>.<kind>.cache', where the prefix usually is the
+        mesh's file name, so the files end up next to it. Each file
+        records the content hash of those parts of the mesh the
+        structure depends on (and of the parameters it got computed
+        with); if that doesn't match the mesh's - or the file is
+        incomplete or unreadable - the structure gets recomputed, and
+        the file rewritten. Files get written to a temporary file
+        first and then renamed, so concurrent jobs on the same mesh
+        never see half-written files; failing to write a cache file
+        only prints a warning. */
+    struct DerivedCache {
+      typedef std::shared_ptr<DerivedCache> SP;
+
+      /*! creates a cache for given mesh, with given prefix for its
+          files */
+      DerivedCache(UMesh::SP mesh, const std::string &prefix);
+      
+      /*! the mesh's face connectivity; faces computed with HASH are
+          cached separately from those computed with any other method
+          (which all produce the same faces) */
+      FaceConn::SP  faceConn(FaceConn::Method method = FaceConn::SORT);
+      /*! the mesh's tet connectivity, with given face order */
+      TetConn::SP   tetConn(TetConn::FaceOrder faceOrder = TetConn::FIRST_USE);
+      /*! the mesh's adjacency; computing it uses (and, if needed,
+          computes and caches) faceConn() */
+      Adjacency::SP adjacency();
+      /*! the bricks of partition(mesh,options); these depend on the
+          vertices, too, not only on the elements. Only the last
+          partitioning for each method gets kept */
+      std::vector<PartitionBrick> partition(const PartitionOptions &options);
+
+      /*! reads the cache file of given kind with 'read', if there is
+          one that was stored for given key; returns false (and
+          leaves it to the caller to compute the data) otherwise */
+      bool load(const std::string &kind, uint64_t key,
+                const std::function<void(std::istream &)> &read) const;
+      /*! (re-)writes the cache file of given kind, with given key and
+          'write' writing the data */
+      void store(const std::string &kind, uint64_t key,
+                 const std::function<void(std::ostream &)> &write) const;
+      
+      /*! name of the cache file for given kind of structure */
+      std::string fileNameOf(const std::string &kind) const;
+      /*! contentHash() of given parts of the mesh; computed once per
+          combination of parts */
+      uint64_t hash(uint32_t parts);
+      
+      const UMesh::SP   mesh;
+      const std::string prefix;
+      
+    private:
+      std::map<uint32_t,uint64_t> hashes;
+    };
+    
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,98 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/MappedFile.h"
+#include <fstream>
+#ifndef _WIN32
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace umesh {
+  namespace io {
+
+    MappedFile::SP MappedFile::open(const std::string &fileName)
+    {
+      return std::make_shared<MappedFile>(fileName);
+    }
+
+#ifdef _WIN32
+    MappedFile::MappedFile(const std::string &fileName)
+      : fileName(fileName)
+    {
+      std::ifstream in(fileName,std::ios::binary|std::ios::ate);
+      if (!in.good())
+        throw std::runtime_error("#umesh.io: could not open '"+fileName+"'");
+      numBytes = (size_t)in.tellg();
+      in.seekg(0,std::ios::beg);
+      fallback.resize(numBytes);
+      in.read((char*)fallback.data(),numBytes);
+      if (!in.good())
+        throw std::runtime_error("#umesh.io: could not read '"+fileName+"'");
+      base = fallback.data();
+    }
+
+    MappedFile::~MappedFile()
+    {}
+#else
+    MappedFile::MappedFile(const std::string &fileName)
+      : fileName(fileName)
+    {
+      int fd = ::open(fileName.c_str(),O_RDONLY);
+      if (fd < 0)
+        throw std::runtime_error("#umesh.io: could not open '"+fileName+"'");
+      struct stat st;
+      if (fstat(fd,&st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("#umesh.io: could not stat '"+fileName+"'");
+      }
+      numBytes = (size_t)st.st_size;
+      if (numBytes == 0) {
+        // mmap() refuses zero-sized mappings; an empty file simply
+        // maps to an empty range
+        ::close(fd);
+        return;
+      }
+      void *mem = mmap(nullptr,numBytes,PROT_READ,MAP_SHARED,fd,0);
+      // the mapping stays valid after the file descriptor is closed
+      ::close(fd);
+      if (mem == MAP_FAILED)
+        throw std::runtime_error("#umesh.io: could not mmap '"+fileName+"'");
+      base = (const uint8_t *)mem;
+    }
+
+    MappedFile::~MappedFile()
+    {
+      if (base && fallback.empty())
+        munmap((void*)base,numBytes);
+    }
+#endif
+
+    const uint8_t *MappedFile::at(size_t offset, size_t numBytes) const
+    {
+      if (offset > this->numBytes || numBytes > this->numBytes - offset)
+        throw std::runtime_error("#umesh.io: trying to access bytes ["
+                                 +std::to_string(offset)+","
+                                 +std::to_string(offset+numBytes)
+                                 +") past end of mapped file '"
+                                 +fileName+"'");
+      return base+offset;
+    }
+
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,56 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+  namespace io {
+
+    /*! a read-only mapping of an entire file into the address
+        space. On posix systems this uses a shared, read-only mmap(),
+        so multiple processes mapping the same file all share the
+        same page-cached copy of it; on systems without mmap we fall
+        back to reading the file into (private) host memory */
+    struct MappedFile {
+      typedef std::shared_ptr<MappedFile> SP;
+
+      /*! map given file; throws if file can't be opened or mapped */
+      static MappedFile::SP open(const std::string &fileName);
+
+      MappedFile(const std::string &fileName);
+      MappedFile(const MappedFile &) = delete;
+      ~MappedFile();
+
+      /*! returns pointer to given byte offset within the file; throws
+          if the range [offset,offset+numBytes) is not entirely
+          inside the file */
+      const uint8_t *at(size_t offset, size_t numBytes=0) const;
+
+      inline const uint8_t *data() const { return base; }
+      inline size_t size() const { return numBytes; }
+
+      const std::string fileName;
+    private:
+      const uint8_t *base     = nullptr;
+      size_t         numBytes = 0;
+      /*! only used if we could not mmap, and had to read the file */
+      std::vector<uint8_t> fallback;
+    };
+
+  } // ::umesh::io
+} // ::umesh
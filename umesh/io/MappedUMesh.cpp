@@ -0,0 +1,408 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/MappedUMesh.h"
+#include "umesh/io/Container.h"
+#include "umesh/io/Compression.h"
+#include "umesh/CompactBrick.h"
+#include <sstream>
+#include <cstring>
+
+namespace umesh {
+  namespace io {
+
+    /*! helper that walks over a mapped file the same way the
+        istream-based readers walk over a stream */
+    struct MappedCursor {
+      MappedCursor(MappedFile::SP file) : file(file) {}
+
+      inline bool atEnd() const { return offset >= file->size(); }
+
+      template<typename T>
+      T readElement()
+      {
+        T t;
+        memcpy(&t,file->at(offset,sizeof(T)),sizeof(T));
+        offset += sizeof(T);
+        return t;
+      }
+
+      std::string readString()
+      {
+        int size = readElement<int>();
+        if (size < 0)
+          throw std::runtime_error("#umesh.io: invalid string in mapped file");
+        const char *chars = (const char *)file->at(offset,size);
+        offset += size;
+        return std::string(chars,size);
+      }
+
+      /*! "reads" a vector the way io::readVector() would have, but
+          only sets the array to point to the right range in the
+          mapped file */
+      template<typename T>
+      void readVector(MappedArray<T> &array)
+      {
+        const size_t N = readElement<size_t>();
+        if (N > (file->size()-offset)/sizeof(T))
+          throw std::runtime_error("#umesh.io: array size in mapped file "
+                                   "exceeds size of file");
+        const uint8_t *begin = file->at(offset,N*sizeof(T));
+        offset += N*sizeof(T);
+
+        array.count = N;
+        if (((size_t)begin % alignof(T)) == 0) {
+          array.ptr  = (const T*)begin;
+          array.copy = nullptr;
+        } else {
+          array.copy = std::make_shared<std::vector<T>>(N);
+          memcpy(array.copy->data(),begin,N*sizeof(T));
+          array.ptr = array.copy->data();
+        }
+      }
+
+      MappedFile::SP file;
+      size_t         offset = 0;
+    };
+
+    /*! sets given array to point to given container section; if the
+        array already points to a previous section of the same type
+        the two get concatenated (which requires a copy), and
+        compressed sections get decompressed into a copy */
+    template<typename T>
+    void mapSection(MappedFile::SP file,
+                    const container::Section &section,
+                    MappedArray<T> &array)
+    {
+      if (section.compression) {
+        std::shared_ptr<std::vector<T>> copy
+          = std::make_shared<std::vector<T>>(array.begin(),array.end());
+        copy->resize(array.size()+section.count);
+        compression::decompress(file->at(section.offset,section.numBytes),
+                                section.numBytes,
+                                copy->data()+array.size(),
+                                section.count*sizeof(T));
+        array.copy  = copy;
+        array.ptr   = copy->data();
+        array.count = copy->size();
+        return;
+      }
+      if (section.numBytes != section.count*sizeof(T))
+        throw std::runtime_error("#umesh.io: section '"
+                                 +container::toString(section.type)
+                                 +"' has wrong element size");
+      const T *begin = (const T *)file->at(section.offset,section.numBytes);
+      if (array.empty() && ((size_t)begin % alignof(T)) == 0) {
+        array.ptr   = begin;
+        array.count = section.count;
+        array.copy  = nullptr;
+        return;
+      }
+      std::shared_ptr<std::vector<T>> copy
+        = std::make_shared<std::vector<T>>(array.begin(),array.end());
+      copy->insert(copy->end(),begin,begin+section.count);
+      array.copy  = copy;
+      array.ptr   = copy->data();
+      array.count = copy->size();
+    }
+
+    /*! map a version-2 container; all its sections are 64-byte
+        aligned, so (unless an array is split across multiple
+        sections) all arrays point directly into the file */
+    void mapContainer(MappedUMesh *mesh)
+    {
+      using namespace container;
+      MappedFile::SP file = mesh->file;
+      Header header;
+      memcpy(&header,file->at(0,sizeof(header)),sizeof(header));
+      if (header.version != container::version)
+        throw std::runtime_error("#umesh.io: unsupported container version "
+                                 +std::to_string(header.version));
+      mesh->bounds           = header.bounds;
+      mesh->gridsScalarRange = header.gridsScalarRange;
+      std::vector<Section> sections(header.numSections);
+      memcpy(sections.data(),
+             file->at(header.tocOffset,sections.size()*sizeof(Section)),
+             sections.size()*sizeof(Section));
+      if (checksum(sections.data(),sections.size()*sizeof(Section))
+          != header.tocChecksum)
+        throw std::runtime_error("#umesh.io: checksum mismatch in container TOC");
+
+      for (auto &section : sections) {
+        switch (section.type) {
+        case VERTICES:
+          mapSection(file,section,mesh->vertices); break;
+        case VERTEX_ATTRIBUTE: {
+          MappedUMesh::MappedAttribute *attr = nullptr;
+          for (auto &existing : mesh->attributes)
+            if (existing.name == section.getName()) attr = &existing;
+          if (!attr) {
+            mesh->attributes.push_back({section.getName()});
+            attr = &mesh->attributes.back();
+          }
+          mapSection(file,section,attr->values);
+        } break;
+        case ELEMENT_ATTRIBUTE: {
+          if (section.flags >= UMesh::INVALID)
+            throw std::runtime_error("#umesh.io: invalid prim type for element attribute '"
+                                     +section.getName()+"'");
+          const UMesh::PrimType primType = (UMesh::PrimType)section.flags;
+          MappedUMesh::MappedAttribute *attr = nullptr;
+          for (auto &existing : mesh->elementAttributes)
+            if (existing.first == primType && existing.second.name == section.getName())
+              attr = &existing.second;
+          if (!attr) {
+            mesh->elementAttributes.push_back({primType,{section.getName()}});
+            attr = &mesh->elementAttributes.back().second;
+          }
+          mapSection(file,section,attr->values);
+        } break;
+        case QUANTIZED_ATTRIBUTE: {
+          if (section.flags != 8 && section.flags != 16)
+            throw std::runtime_error("#umesh.io: invalid number of bits for quantized "
+                                     "attribute '"+section.getName()+"'");
+          MappedUMesh::MappedQuantizedAttribute *attr = nullptr;
+          for (auto &existing : mesh->quantizedAttributes)
+            if (existing.name == section.getName()) {
+              if (existing.bits != (int)section.flags ||
+                  existing.valueRange.lower != section.valueRange.lower ||
+                  existing.valueRange.upper != section.valueRange.upper)
+                throw std::runtime_error("#umesh.io: sections of quantized attribute '"
+                                         +existing.name+"' have different quantizations");
+              attr = &existing;
+            }
+          if (!attr) {
+            mesh->quantizedAttributes.push_back({section.getName(),(int)section.flags,
+                                                 section.valueRange});
+            attr = &mesh->quantizedAttributes.back();
+          }
+          if (attr->bits == 8) mapSection(file,section,attr->codes8);
+          else                 mapSection(file,section,attr->codes16);
+        } break;
+        case TRIANGLES:
+          mapSection(file,section,mesh->triangles); break;
+        case QUADS:
+          mapSection(file,section,mesh->quads); break;
+        case TETS:
+          mapSection(file,section,mesh->tets); break;
+        case PYRS:
+          mapSection(file,section,mesh->pyrs); break;
+        case WEDGES:
+          mapSection(file,section,mesh->wedges); break;
+        case HEXES:
+          mapSection(file,section,mesh->hexes); break;
+        case GRIDS:
+          mapSection(file,section,mesh->grids); break;
+        case GRID_SCALARS:
+          mapSection(file,section,mesh->gridScalars); break;
+        case VERTEX_TAGS:
+          mapSection(file,section,mesh->vertexTags); break;
+        case QUANTIZED_VERTICES:
+          if (section.flags > 2)
+            throw std::runtime_error("#umesh.io: invalid axis for quantized vertices");
+          mapSection(file,section,mesh->quantizedVertices[section.flags]);
+          mesh->quantizedRange[section.flags] = section.valueRange;
+          break;
+        case INDICES_16:
+          if (section.flags > UMesh::HEX)
+            throw std::runtime_error("#umesh.io: invalid prim type for 16-bit indices");
+          mapSection(file,section,mesh->indices16[section.flags]);
+          break;
+        default:
+          /* unknown section type, or one we don't map - skip */
+          break;
+        }
+      }
+    }
+
+    MappedUMesh::SP MappedUMesh::map(const std::string &fileName)
+    {
+      MappedUMesh::SP mesh = std::make_shared<MappedUMesh>();
+      mesh->file = MappedFile::open(fileName);
+      MappedCursor in(mesh->file);
+
+      const size_t magic = in.readElement<size_t>();
+      if (container::isContainer(magic)) {
+        mapContainer(mesh.get());
+        return mesh;
+      }
+      bool hasGrids = true;
+      bool hasAttributeHeaders = true;
+      if (magic == 0x234235566ULL) {
+        hasGrids = false;
+        hasAttributeHeaders = false;
+      } else if (magic == 0x234235567ULL) {
+        hasGrids = false;
+      } else if (magic != 0x234235568ULL)
+        throw std::runtime_error("wrong magic number in umesh file ...");
+
+      in.readVector(mesh->vertices);
+      size_t numPerVertexAttributes = 1;
+      if (hasAttributeHeaders)
+        numPerVertexAttributes = in.readElement<size_t>();
+      for (size_t i=0;i<numPerVertexAttributes;i++) {
+        MappedAttribute attr;
+        if (hasAttributeHeaders)
+          attr.name = in.readString();
+        in.readVector(attr.values);
+        mesh->attributes.push_back(attr);
+      }
+      if (hasAttributeHeaders) {
+        size_t numPerElementAttributes = in.readElement<size_t>();
+        if (numPerElementAttributes != 0)
+          throw std::runtime_error("#umesh.io: per-element attributes "
+                                   "not supported in this file format");
+      }
+
+      in.readVector(mesh->triangles);
+      in.readVector(mesh->quads);
+      in.readVector(mesh->tets);
+      in.readVector(mesh->pyrs);
+      in.readVector(mesh->wedges);
+      in.readVector(mesh->hexes);
+      if (hasGrids) {
+        in.readVector(mesh->grids);
+        in.readVector(mesh->gridScalars);
+      }
+      if (!in.atEnd())
+        in.readVector(mesh->vertexTags);
+      return mesh;
+    }
+
+    /*! create a regular (owning, and finalized) UMesh with a deep
+      copy of all arrays in this view */
+    UMesh::SP MappedUMesh::toUMesh() const
+    {
+      UMesh::SP mesh = std::make_shared<UMesh>();
+      mesh->vertices = vertices.toVector();
+      for (auto &attr : attributes) {
+        Attribute::SP copy = std::make_shared<Attribute>();
+        copy->name   = attr.name;
+        copy->values = attr.values.toVector();
+        copy->finalize();
+        mesh->attributes.push_back(copy);
+      }
+      if (!mesh->attributes.empty())
+        mesh->perVertex = mesh->attributes[0];
+      for (auto &attr : elementAttributes) {
+        Attribute::SP copy = std::make_shared<Attribute>();
+        copy->name   = attr.second.name;
+        copy->values = attr.second.values.toVector();
+        copy->finalize();
+        mesh->elementAttributes.push_back({attr.first,copy});
+      }
+      for (auto &attr : quantizedAttributes) {
+        QuantizedAttribute::SP copy = std::make_shared<QuantizedAttribute>();
+        copy->name    = attr.name;
+        copy->setQuantization(attr.bits,attr.valueRange);
+        copy->codes8  = attr.codes8.toVector();
+        copy->codes16 = attr.codes16.toVector();
+        mesh->quantizedAttributes.push_back(copy);
+      }
+      mesh->triangles   = triangles.toVector();
+      mesh->quads       = quads.toVector();
+      mesh->tets        = tets.toVector();
+      mesh->pyrs        = pyrs.toVector();
+      mesh->wedges      = wedges.toVector();
+      mesh->hexes       = hexes.toVector();
+      mesh->grids       = grids.toVector();
+      mesh->gridScalars = gridScalars.toVector();
+      mesh->vertexTags  = vertexTags.toVector();
+
+      CompactBrick compact;
+      for (int axis=0;axis<3;axis++) {
+        compact.setQuantization(axis,quantizedRange[axis]);
+        compact.codes[axis] = quantizedVertices[axis].toVector();
+      }
+      if (!compact.codes[0].empty())
+        compact.decodeVertices(mesh->vertices);
+      for (int type=UMesh::TRI;type<=UMesh::HEX;type++) {
+        compact.indices[type] = indices16[type].toVector();
+        compact.hasIndices16 |= !indices16[type].empty();
+      }
+      compact.decodeElements(*mesh);
+      mesh->finalize();
+      return mesh;
+    }
+
+    /*! return a string of the form "MappedUMesh{#tris=...}" */
+    MeshView MappedUMesh::view() const
+    {
+      MeshView view;
+      view.vertices    = vertices.span();
+      if (perVertex())
+        view.scalars   = perVertex()->values.span();
+      view.triangles   = triangles.span();
+      view.quads       = quads.span();
+      view.tets        = tets.span();
+      view.pyrs        = pyrs.span();
+      view.wedges      = wedges.span();
+      view.hexes       = hexes.span();
+      view.grids       = grids.span();
+      view.gridScalars = gridScalars.span();
+      view.bounds      = bounds;
+      return view;
+    }
+
+    std::string MappedUMesh::toString() const
+    {
+      std::stringstream ss;
+      ss << "MappedUMesh(";
+      ss << "#verts=" << prettyNumber(vertices.size());
+      if (!triangles.empty())
+        ss << ",#tris=" << prettyNumber(triangles.size());
+      if (!quads.empty())
+        ss << ",#quads=" << prettyNumber(quads.size());
+      if (!tets.empty())
+        ss << ",#tets=" << prettyNumber(tets.size());
+      if (!pyrs.empty())
+        ss << ",#pyrs=" << prettyNumber(pyrs.size());
+      if (!wedges.empty())
+        ss << ",#wedges=" << prettyNumber(wedges.size());
+      if (!hexes.empty())
+        ss << ",#hexes=" << prettyNumber(hexes.size());
+      if (!grids.empty())
+        ss << ",#grids=" << prettyNumber(grids.size())
+           << " (with " << prettyNumber(gridScalars.size()) << " grid scalars)";
+      ss << ",attributes=(";
+      for (size_t i=0;i<attributes.size();i++) {
+        if (i) ss << ",";
+        ss << "'" << attributes[i].name << "'";
+      }
+      ss << ")";
+      if (!elementAttributes.empty()) {
+        ss << ",elementAttributes=(";
+        for (size_t i=0;i<elementAttributes.size();i++) {
+          if (i) ss << ",";
+          ss << "'" << elementAttributes[i].second.name << "'";
+        }
+        ss << ")";
+      }
+      if (!quantizedAttributes.empty()) {
+        ss << ",quantizedAttributes=(";
+        for (size_t i=0;i<quantizedAttributes.size();i++) {
+          if (i) ss << ",";
+          ss << "'" << quantizedAttributes[i].name << "'";
+        }
+        ss << ")";
+      }
+      ss << ",tags=" << (vertexTags.empty()?"no":"yes");
+      ss << ")";
+      return ss.str();
+    }
+
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,155 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/MeshView.h"
+#include "umesh/io/MappedFile.h"
+
+namespace umesh {
+  namespace io {
+
+    /*! a read-only, typed range of elements inside a mapped
+        file. Usually this points directly into the mapping; only if
+        the file's data for this array is not properly aligned for
+        type T (which can happen in files written before sections got
+        aligned), or is compressed, do we fall back to a private,
+        aligned copy */
+    template<typename T>
+    struct MappedArray {
+      inline size_t   size()  const { return count; }
+      inline bool     empty() const { return count == 0; }
+      inline const T *data()  const { return ptr; }
+      inline const T *begin() const { return ptr; }
+      inline const T *end()   const { return ptr+count; }
+      inline const T &operator[](size_t i) const
+      { assert(i < count); return ptr[i]; }
+
+      /*! returns true if this array points directly into the mapped
+          file (ie, no copy was made) */
+      inline bool isZeroCopy() const { return copy == nullptr; }
+
+      /*! create a (deep) copy of this array, as a std::vector */
+      inline std::vector<T> toVector() const
+      { return std::vector<T>(ptr,ptr+count); }
+
+      /*! a (non-owning) span of this array's elements */
+      inline Span<T> span() const { return Span<T>(ptr,count); }
+
+      const T *ptr   = nullptr;
+      size_t   count = 0;
+      /*! only used if the data in the file was mis-aligned, or
+          compressed */
+      std::shared_ptr<std::vector<T>> copy;
+    };
+
+    /*! a read-only view of a .umesh file, with each array pointing
+        directly into a memory-mapped version of that file. Mapping a
+        file does not read any of its element data (that only gets
+        paged in on first access), and multiple processes mapping the
+        same file share the same page-cached copy. Note that checksums
+        stored in the file do not get verified, as that would require
+        touching all data. Compressed sections (see io/Compression.h)
+        cannot be mapped, and get decompressed into private copies
+        right away.
+
+        Note that unlike UMesh::loadFrom() this does not call
+        finalize(), so bounds and value ranges have to be computed by
+        the user, if required. */
+    struct MappedUMesh {
+      typedef std::shared_ptr<MappedUMesh> SP;
+
+      struct MappedAttribute {
+        std::string        name;
+        MappedArray<float> values;
+      };
+
+      /*! a quantized per-vertex attribute (see QuantizedAttribute),
+          with its 8- or 16-bit codes pointing into the file */
+      struct MappedQuantizedAttribute {
+        std::string           name;
+        /*! 8 or 16; only the codes for that are used */
+        int                   bits = 16;
+        range1f               valueRange;
+        MappedArray<uint8_t>  codes8;
+        MappedArray<uint16_t> codes16;
+      };
+
+      /*! map given .umesh file, and set up all arrays to point into
+          that file */
+      static MappedUMesh::SP map(const std::string &fileName);
+
+      /*! create a regular (owning, and finalized) UMesh with a deep
+          copy of all arrays in this view */
+      UMesh::SP toUMesh() const;
+
+      /*! a view of all of this mesh's arrays, with perVertex() (if
+          any) as the scalars; this does not copy anything, so is
+          only valid as long as this mesh is alive */
+      MeshView view() const;
+
+      /*! return a string of the form "MappedUMesh{#tris=...}" */
+      std::string toString() const;
+
+      /*! the first per-vertex attribute, if any; this is what a
+          UMesh would use as its 'perVertex' attribute */
+      inline const MappedAttribute *perVertex() const
+      { return attributes.empty() ? nullptr : &attributes[0]; }
+
+      MappedArray<vec3f>           vertices;
+      std::vector<MappedAttribute> attributes;
+      /*! per-element attributes, by the type of element they have
+          one value per; same as UMesh::elementAttributes */
+      std::vector<std::pair<UMesh::PrimType,MappedAttribute>> elementAttributes;
+      /*! same as UMesh::quantizedAttributes */
+      std::vector<MappedQuantizedAttribute> quantizedAttributes;
+      MappedArray<Triangle>        triangles;
+      MappedArray<Quad>            quads;
+      MappedArray<Tet>             tets;
+      MappedArray<Pyr>             pyrs;
+      MappedArray<Wedge>           wedges;
+      MappedArray<Hex>             hexes;
+      MappedArray<Grid>            grids;
+      MappedArray<float>           gridScalars;
+      MappedArray<size_t>          vertexTags;
+
+      /*! for files written with a CompactBrick (see
+          umesh/CompactBrick.h), the per-axis 16-bit vertex codes and
+          the ranges they are relative to - in which case 'vertices'
+          is empty ... */
+      MappedArray<uint16_t>        quantizedVertices[3];
+      range1f                      quantizedRange[3];
+      /*! ... and, if the brick's indices got stored as 16-bit
+          values, those, per element type (UMesh::TRI to UMesh::HEX);
+          the element arrays above are empty then. These can be used
+          (eg, uploaded to a GPU) as they are; toUMesh() decodes
+          them, view() does not include them */
+      MappedArray<uint16_t>        indices16[UMesh::HEX+1];
+
+      /*! bounds and grid-scalar range as stored in the file's header;
+          only version-2 files store these, for older files these
+          are empty */
+      box3f                        bounds;
+      range1f                      gridsScalarRange;
+
+      /*! the mapped file that all the above arrays point into; will
+          stay mapped for as long as this view is alive */
+      MappedFile::SP file;
+    };
+
+  } // ::umesh::io
+} // ::umesh
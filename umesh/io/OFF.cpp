@@ -0,0 +1,93 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/OFF.h"
+#include "umesh/io/TextParser.h"
+#include "umesh/profile.h"
+
+namespace umesh {
+  namespace io {
+
+    UMesh::SP loadOFF(const std::string &fileName)
+    {
+      TextFile::SP file = TextFile::open(fileName);
+      profile::ScopedTimer timer("io.loadOFF",file->size());
+
+      size_t offset = 0;
+      TextCursor header(nullptr,nullptr);
+      int64_t numVerts = 0, numTets = 0;
+      if (!file->nextRecord(offset,header) ||
+          !header.read(numVerts) || !header.read(numTets) ||
+          !header.atLineEnd() ||
+          numVerts < 0 || numVerts > INT32_MAX || numTets < 0)
+        throw std::runtime_error("#umesh.io: '"+fileName+"' is not a valid OFF file");
+      
+      const std::vector<TextChunk> chunks = file->split(offset);
+      if (TextFile::numRecords(chunks) < size_t(numVerts+numTets))
+        throw std::runtime_error("#umesh.io: '"+fileName+"' is truncated (expected "
+                                 +std::to_string(numVerts)+" vertices and "
+                                 +std::to_string(numTets)+" tets)");
+
+      UMesh::SP mesh = std::make_shared<UMesh>();
+      mesh->perVertex = std::make_shared<Attribute>();
+      mesh->vertices.resize(numVerts);
+      mesh->perVertex->values.resize(numVerts);
+      std::vector<Tet> tets(numTets);
+      // anything after the last tet gets ignored
+      file->parseRecords(chunks,[&](size_t recordID, TextCursor &line){
+          if (recordID < size_t(numVerts)) {
+            vec3f &v = mesh->vertices[recordID];
+            return line.read(v.x) && line.read(v.y) && line.read(v.z)
+              && line.read(mesh->perVertex->values[recordID]);
+          }
+          recordID -= numVerts;
+          if (recordID >= size_t(numTets)) {
+            line.ptr = line.end;
+            return true;
+          }
+          Tet &tet = tets[recordID];
+          for (int i=0;i<4;i++)
+            if (!line.read(tet[i]) || tet[i] < 0 || tet[i] >= numVerts)
+              return false;
+          return true;
+        });
+
+      // flip inside-out tets, and mark degenerate ones (for removal)
+      // by setting their first index to -1
+      parallel_for_blocked(0,tets.size(),16*1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++) {
+            Tet &tet = tets[i];
+            const vec3f v0 = mesh->vertices[tet.x];
+            const vec3f v1 = mesh->vertices[tet.y];
+            const vec3f v2 = mesh->vertices[tet.z];
+            const vec3f v3 = mesh->vertices[tet.w];
+            const float volume = dot(v3-v0,cross(v1-v0,v2-v0));
+            if (volume == 0.f)
+              tet.x = -1;
+            else if (volume < 0.f)
+              std::swap(tet.y,tet.w);
+          }
+        });
+      tets.erase(std::remove_if(tets.begin(),tets.end(),
+                                [](const Tet &tet){ return tet.x < 0; }),
+                 tets.end());
+      mesh->tets = std::move(tets);
+      mesh->finalize();
+      return mesh;
+    }
+
+  } // ::umesh::io
+} // ::umesh
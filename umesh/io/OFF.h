@@ -0,0 +1,35 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+  namespace io {
+
+    /*! loads a tetrahedral mesh from an ascii "OFF" file, as written
+        by some external tet meshers: a header line with the number
+        of vertices and tets, then one line per vertex (x, y, z, and
+        a scalar value that becomes the mesh's perVertex attribute),
+        then one line per tet (four 0-based vertex indices). The file
+        gets parsed in parallel (see io/TextParser.h). Degenerate
+        (zero-volume) tets get dropped, and inside-out ones get
+        flipped; throws if the file is truncated or malformed. */
+    UMesh::SP loadOFF(const std::string &fileName);
+
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,186 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/ParallelIO.h"
+#include <cerrno>
+#include <cstring>
+#ifndef _WIN32
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+namespace umesh {
+  namespace io {
+
+    size_t parallelIOChunkSize = 16*1024*1024;
+
+    PositionalFile::SP PositionalFile::openForReading(const std::string &fileName)
+    {
+      return std::make_shared<PositionalFile>(fileName,READ);
+    }
+
+    PositionalFile::SP PositionalFile::openForWriting(const std::string &fileName)
+    {
+      return std::make_shared<PositionalFile>(fileName,WRITE);
+    }
+
+#ifdef _WIN32
+    PositionalFile::PositionalFile(const std::string &fileName, Mode mode)
+      : fileName(fileName)
+    {
+      if (mode == READ)
+        file.open(fileName,std::ios::in|std::ios::binary);
+      else
+        file.open(fileName,std::ios::out|std::ios::trunc|std::ios::binary);
+      if (!file.good())
+        throw std::runtime_error("#umesh.io: could not open '"+fileName+"'");
+    }
+
+    PositionalFile::~PositionalFile()
+    {}
+
+    size_t PositionalFile::size() const
+    {
+      std::ifstream in(fileName,std::ios::binary|std::ios::ate);
+      return (size_t)in.tellg();
+    }
+
+    void PositionalFile::read(uint64_t offset, void *dst, size_t numBytes)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      file.seekg(offset);
+      file.read((char *)dst,numBytes);
+      if (!file.good())
+        throw std::runtime_error("#umesh.io: partial read from '"+fileName+"'");
+    }
+
+    void PositionalFile::write(uint64_t offset, const void *src, size_t numBytes)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      file.seekp(offset);
+      file.write((const char *)src,numBytes);
+      if (!file.good())
+        throw std::runtime_error("#umesh.io: could not write to '"+fileName+"'");
+    }
+#else
+    PositionalFile::PositionalFile(const std::string &fileName, Mode mode)
+      : fileName(fileName)
+    {
+      if (mode == READ)
+        fd = ::open(fileName.c_str(),O_RDONLY);
+      else
+        fd = ::open(fileName.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644);
+      if (fd < 0)
+        throw std::runtime_error("#umesh.io: could not open '"+fileName+"' ("
+                                 +strerror(errno)+")");
+    }
+
+    PositionalFile::~PositionalFile()
+    {
+      if (fd >= 0) ::close(fd);
+    }
+
+    size_t PositionalFile::size() const
+    {
+      struct stat st;
+      if (fstat(fd,&st) != 0)
+        throw std::runtime_error("#umesh.io: could not stat '"+fileName+"'");
+      return (size_t)st.st_size;
+    }
+
+    void PositionalFile::read(uint64_t offset, void *dst, size_t numBytes)
+    {
+      uint8_t *ptr = (uint8_t *)dst;
+      while (numBytes > 0) {
+        ssize_t numRead = pread(fd,ptr,numBytes,(off_t)offset);
+        if (numRead < 0 && errno == EINTR) continue;
+        if (numRead <= 0)
+          throw std::runtime_error("#umesh.io: partial read from '"+fileName+"'");
+        ptr      += numRead;
+        offset   += numRead;
+        numBytes -= numRead;
+      }
+    }
+
+    void PositionalFile::write(uint64_t offset, const void *src, size_t numBytes)
+    {
+      const uint8_t *ptr = (const uint8_t *)src;
+      while (numBytes > 0) {
+        ssize_t numWritten = pwrite(fd,ptr,numBytes,(off_t)offset);
+        if (numWritten < 0 && errno == EINTR) continue;
+        if (numWritten <= 0)
+          throw std::runtime_error("#umesh.io: could not write to '"+fileName+"' ("
+                                   +strerror(errno)+")");
+        ptr      += numWritten;
+        offset   += numWritten;
+        numBytes -= numWritten;
+      }
+    }
+#endif
+
+    /*! splits all given requests into chunks of at most
+        parallelIOChunkSize bytes */
+    std::vector<IORequest> splitIntoChunks(const std::vector<IORequest> &requests)
+    {
+      const size_t chunkSize = std::max(parallelIOChunkSize,size_t(4096));
+      std::vector<IORequest> chunks;
+      for (auto &request : requests)
+        for (size_t begin=0;begin<request.numBytes;begin+=chunkSize)
+          chunks.push_back({ request.offset+begin,
+                             (uint8_t *)request.data+begin,
+                             std::min(chunkSize,request.numBytes-begin) });
+      return chunks;
+    }
+
+    /*! runs given function over all chunks in parallel; since
+        exceptions must not escape from a parallel_for, the first error
+        gets captured and re-thrown once all chunks are done */
+    template<typename Lambda>
+    void forEachChunk(const std::vector<IORequest> &chunks, const Lambda &fn)
+    {
+      std::mutex  mutex;
+      std::string error;
+      parallel_for(chunks.size(),[&](size_t chunkID){
+        try {
+          fn(chunks[chunkID]);
+        } catch (std::exception &e) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (error.empty()) error = e.what();
+        }
+      });
+      if (!error.empty())
+        throw std::runtime_error(error);
+    }
+
+    void parallelRead(PositionalFile &file,
+                      const std::vector<IORequest> &requests)
+    {
+      forEachChunk(splitIntoChunks(requests),[&](const IORequest &chunk){
+        file.read(chunk.offset,chunk.data,chunk.numBytes);
+      });
+    }
+
+    void parallelWrite(PositionalFile &file,
+                       const std::vector<IORequest> &requests)
+    {
+      forEachChunk(splitIntoChunks(requests),[&](const IORequest &chunk){
+        file.write(chunk.offset,chunk.data,chunk.numBytes);
+      });
+    }
+
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,88 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include <fstream>
+
+namespace umesh {
+  namespace io {
+
+    /*! size of the chunks (in bytes) that large reads and writes get
+        split into; each chunk is read/written by a different thread */
+    extern size_t parallelIOChunkSize;
+
+    /*! a file opened for positional (pread/pwrite-style) access, so
+        that multiple threads can concurrently read or write different
+        parts of the same file. On systems without pread/pwrite all
+        accesses get serialized through a regular fstream. */
+    struct PositionalFile {
+      typedef std::shared_ptr<PositionalFile> SP;
+
+      typedef enum { READ, WRITE } Mode;
+
+      /*! open given file for reading; throws if not possible */
+      static PositionalFile::SP openForReading(const std::string &fileName);
+      /*! create (or truncate) given file for writing */
+      static PositionalFile::SP openForWriting(const std::string &fileName);
+
+      PositionalFile(const std::string &fileName, Mode mode);
+      PositionalFile(const PositionalFile &) = delete;
+      ~PositionalFile();
+
+      /*! size of the file, in bytes */
+      size_t size() const;
+
+      /*! read 'numBytes' bytes starting at 'offset', from the calling
+          thread only */
+      void read(uint64_t offset, void *dst, size_t numBytes);
+      /*! write 'numBytes' bytes starting at 'offset', from the
+          calling thread only */
+      void write(uint64_t offset, const void *src, size_t numBytes);
+
+      const std::string fileName;
+    private:
+#ifdef _WIN32
+      std::fstream file;
+      std::mutex   mutex;
+#else
+      int          fd = -1;
+#endif
+    };
+
+    /*! a single contiguous block of memory to be read from or written
+        to a given file offset */
+    struct IORequest {
+      uint64_t offset;
+      void    *data;
+      size_t   numBytes;
+    };
+
+    /*! executes all given read requests, splitting each into chunks
+        of at most parallelIOChunkSize bytes, and reading all chunks
+        of all requests in parallel */
+    void parallelRead(PositionalFile &file,
+                      const std::vector<IORequest> &requests);
+
+    /*! executes all given write requests, splitting each into chunks
+        of at most parallelIOChunkSize bytes, and writing all chunks
+        of all requests in parallel */
+    void parallelWrite(PositionalFile &file,
+                       const std::vector<IORequest> &requests);
+
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,131 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/TextParser.h"
+#include <cstdlib>
+
+namespace umesh {
+  namespace io {
+
+    size_t textChunkSize = 4*1024*1024;
+
+    bool parseDoubleSlow(const char *&ptr, const char *end, double &value)
+    {
+      const char *tokenEnd = ptr;
+      while (tokenEnd < end && !TextCursor::isBlank(*tokenEnd)) ++tokenEnd;
+      // the mapped file is not null-terminated, so strtod needs a copy
+      char token[64];
+      const size_t length = tokenEnd-ptr;
+      if (length == 0 || length >= sizeof(token))
+        return false;
+      memcpy(token,ptr,length);
+      token[length] = 0;
+      char *parsedEnd = nullptr;
+      const double v = strtod(token,&parsedEnd);
+      if (parsedEnd != token+length)
+        return false;
+      value = v;
+      ptr = tokenEnd;
+      return true;
+    }
+
+    TextFile::SP TextFile::open(const std::string &fileName)
+    {
+      return std::make_shared<TextFile>(fileName);
+    }
+
+    TextFile::TextFile(const std::string &fileName)
+      : file(MappedFile::open(fileName)),
+        fileName(fileName)
+    {}
+
+    TextCursor TextFile::nextLine(size_t &offset) const
+    {
+      const char *begin = data()+offset;
+      const char *end   = data()+size();
+      const char *eol   = (const char *)memchr(begin,'\n',end-begin);
+      if (!eol) eol = end;
+      offset = std::min(size_t(eol+1-data()),size());
+      return TextCursor(begin,eol);
+    }
+
+    bool TextFile::nextRecord(size_t &offset, TextCursor &cursor) const
+    {
+      while (offset < size()) {
+        cursor = nextLine(offset);
+        if (!cursor.atLineEnd(commentChar))
+          return true;
+      }
+      return false;
+    }
+
+    std::vector<TextChunk> TextFile::split(size_t begin) const
+    {
+      std::vector<TextChunk> chunks;
+      const size_t end = size();
+      while (begin < end) {
+        TextChunk chunk;
+        chunk.begin = begin;
+        size_t chunkEnd = std::min(begin+textChunkSize,end);
+        // extend to the end of the line we're in
+        if (chunkEnd < end && data()[chunkEnd-1] != '\n') {
+          const char *eol
+            = (const char *)memchr(data()+chunkEnd,'\n',end-chunkEnd);
+          chunkEnd = eol ? size_t(eol+1-data()) : end;
+        }
+        chunk.end = chunkEnd;
+        chunks.push_back(chunk);
+        begin = chunkEnd;
+      }
+
+      if (chunks.empty()) return chunks;
+
+      std::vector<size_t> numLines(chunks.size());
+      parallel_for(chunks.size(),[&](size_t chunkID){
+          TextChunk &chunk = chunks[chunkID];
+          size_t offset = chunk.begin;
+          chunk.numRecords = 0;
+          numLines[chunkID] = 0;
+          while (offset < chunk.end) {
+            TextCursor cursor = nextLine(offset);
+            chunk.numRecords += !cursor.atLineEnd(commentChar);
+            numLines[chunkID]++;
+          }
+        });
+      size_t firstRecord = 0;
+      size_t firstLine   = std::count(data(),data()+chunks.front().begin,'\n');
+      for (size_t i=0;i<chunks.size();i++) {
+        chunks[i].firstRecord = firstRecord;
+        chunks[i].firstLine   = firstLine;
+        firstRecord += chunks[i].numRecords;
+        firstLine   += numLines[i];
+      }
+      return chunks;
+    }
+
+    size_t TextFile::numRecords(const std::vector<TextChunk> &chunks)
+    {
+      return chunks.empty() ? 0 : chunks.back().firstRecord+chunks.back().numRecords;
+    }
+
+    void TextFile::parseError(size_t line) const
+    {
+      throw std::runtime_error("#umesh.io: parse error in '"+fileName
+                               +"', line "+std::to_string(line+1));
+    }
+
+  } // ::umesh::io
+} // ::umesh
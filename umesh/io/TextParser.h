@@ -0,0 +1,267 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* a shared layer for fast parsing of large ascii files (OFF, and
+   whatever text formats come next): the file gets memory-mapped,
+   split into line-aligned chunks, and all chunks get parsed in
+   parallel, with a locale-independent, from_chars-style number
+   parser that works directly on the mapped bytes (no
+   istream/fscanf, no copies).
+
+   Text formats are described in terms of 'records': every line
+   that has anything other than blanks or a comment on it is one
+   record, and records get numbered consecutively from where
+   parsing starts (usually, right after the header). Each chunk first counts its records, so every chunk knows
+   the number of its first record before parsing, and can write its
+   results directly to their final place (eg, vertex
+   'recordID-numHeaderRecords') - no per-thread buffers that would
+   need to be concatenated afterwards. */
+
+#pragma once
+
+#include "umesh/io/MappedFile.h"
+#include <atomic>
+#include <charconv>
+#include <cstring>
+
+namespace umesh {
+  namespace io {
+
+    /*! size (in bytes) of the chunks that text files get split into
+        for parsing; each chunk is parsed by a different thread */
+    extern size_t textChunkSize;
+
+    /*! parses the (blank-terminated) number at 'ptr' with strtod, and
+        moves 'ptr' past it; used by TextCursor::read() for everything
+        its fast path doesn't handle ('nan', 'inf', more than 19
+        digits, large exponents) */
+    bool parseDoubleSlow(const char *&ptr, const char *end, double &value);
+
+    /*! a cursor over a single line of text, that reads whitespace
+        separated numbers from it. All reads skip leading blanks, and
+        return false (without moving the cursor) if the next token is
+        not a number of the requested type, or if the line is
+        exhausted */
+    struct TextCursor {
+      TextCursor(const char *ptr, const char *end) : ptr(ptr), end(end) {}
+
+      inline static bool isBlank(char c)
+      { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+      
+      inline void skipBlanks()
+      { while (ptr < end && isBlank(*ptr)) ++ptr; }
+
+      /*! whether there is nothing but blanks or a comment (starting
+          with 'commentChar') left on the line */
+      inline bool atLineEnd(char commentChar = '#')
+      { skipBlanks(); return ptr == end || *ptr == commentChar; }
+      
+      template<typename T>
+      inline bool readInt(T &value)
+      {
+        skipBlanks();
+        const char *begin = ptr;
+        if (begin < end && *begin == '+') ++begin;
+        std::from_chars_result rc = std::from_chars(begin,end,value);
+        if (rc.ec != std::errc() || (rc.ptr < end && !isBlank(*rc.ptr)))
+          return false;
+        ptr = rc.ptr;
+        return true;
+      }
+      
+      inline bool read(int32_t  &value) { return readInt(value); }
+      inline bool read(int64_t  &value) { return readInt(value); }
+      inline bool read(uint32_t &value) { return readInt(value); }
+      inline bool read(uint64_t &value) { return readInt(value); }
+      
+      /*! reads a decimal floating point number. The common case (at
+          most 19 significant digits, and a small exponent) gets
+          converted exactly, with a single (correctly rounded)
+          multiplication or division in double precision; anything
+          else goes through strtod */
+      inline bool read(double &value)
+      {
+        skipBlanks();
+        const char *p = ptr;
+        const bool negative = (p < end && *p == '-');
+        if (p < end && (*p == '-' || *p == '+')) ++p;
+        uint64_t mantissa  = 0;
+        int      numDigits = 0;
+        int      exponent  = 0;
+        bool     anyDigits = false;
+        bool     truncated = false;
+        while (p < end && unsigned(*p-'0') < 10) {
+          if (numDigits < 19) {
+            mantissa = 10*mantissa + (*p-'0');
+            numDigits += (mantissa != 0);
+          } else {
+            ++exponent;
+            truncated = true;
+          }
+          anyDigits = true;
+          ++p;
+        }
+        if (p < end && *p == '.') {
+          ++p;
+          while (p < end && unsigned(*p-'0') < 10) {
+            if (numDigits < 19) {
+              mantissa = 10*mantissa + (*p-'0');
+              numDigits += (mantissa != 0);
+              --exponent;
+            } else
+              truncated = true;
+            anyDigits = true;
+            ++p;
+          }
+        }
+        if (!anyDigits)
+          // 'nan', 'inf', or garbage
+          return parseDoubleSlow(ptr,end,value);
+        if (p < end && (*p == 'e' || *p == 'E')) {
+          ++p;
+          const bool negativeExp = (p < end && *p == '-');
+          if (p < end && (*p == '-' || *p == '+')) ++p;
+          if (p == end || unsigned(*p-'0') >= 10)
+            return false;
+          int e = 0;
+          while (p < end && unsigned(*p-'0') < 10) {
+            if (e < 100000) e = 10*e + (*p-'0');
+            ++p;
+          }
+          exponent += negativeExp ? -e : e;
+        }
+        if (p < end && !isBlank(*p))
+          return false;
+        
+        static const double powersOf10[23] = {
+          1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        // doubles represent all integers up to 2^53, and all powers
+        // of 10 up to 10^22, exactly
+        if (truncated || mantissa > (1ull<<53) || exponent < -22 || exponent > 22)
+          return parseDoubleSlow(ptr,end,value);
+        double v = double(mantissa);
+        v = exponent < 0 ? v / powersOf10[-exponent] : v * powersOf10[exponent];
+        value = negative ? -v : v;
+        ptr = p;
+        return true;
+      }
+
+      /*! reads a double, and rounds it to float; this can (in rare
+          cases) differ in the last bit from parsing directly to
+          float */
+      inline bool read(float &value)
+      {
+        double d;
+        if (!read(d)) return false;
+        value = float(d);
+        return true;
+      }
+
+      const char *ptr;
+      const char *end;
+    };
+
+    /*! a contiguous, line-aligned range of a text file, plus the
+        number of records and lines before it */
+    struct TextChunk {
+      size_t begin, end;
+      size_t firstRecord;
+      size_t firstLine;
+      size_t numRecords;
+    };
+
+    /*! a memory-mapped text file (see io/MappedFile.h) to be parsed
+        record by record */
+    struct TextFile {
+      typedef std::shared_ptr<TextFile> SP;
+
+      /*! map given file; throws if file can't be opened or mapped */
+      static TextFile::SP open(const std::string &fileName);
+
+      TextFile(const std::string &fileName);
+
+      inline const char *data() const { return (const char *)file->data(); }
+      inline size_t size() const { return file->size(); }
+
+      /*! returns a cursor over the line that starts at given byte
+          offset, and sets 'offset' to the start of the next line */
+      TextCursor nextLine(size_t &offset) const;
+      /*! same as nextLine(), but skips over lines that are blank or
+          comments; returns false if there are no more records */
+      bool nextRecord(size_t &offset, TextCursor &cursor) const;
+
+      /*! splits everything from byte offset 'begin' on into
+          line-aligned chunks of about textChunkSize bytes, and counts
+          the records in each (in parallel); 'begin' has to be the
+          start of a line, and is where record 0 is */
+      std::vector<TextChunk> split(size_t begin) const;
+
+      /*! total number of records in given chunks */
+      static size_t numRecords(const std::vector<TextChunk> &chunks);
+      
+      /*! calls 'parseRecord(recordID,cursor)' for each record in
+          given chunks, in parallel, with a cursor over just that
+          record's line. 'parseRecord' returns false if it could not
+          parse the line; the same happens if it leaves anything
+          other than blanks or a comment on the line. Either way, this
+          throws after all chunks are done, with the first offending
+          line number in the error message */
+      template<typename Lambda>
+      void parseRecords(const std::vector<TextChunk> &chunks,
+                        const Lambda &parseRecord) const;
+
+      /*! lines starting (after blanks) with this are comments */
+      char commentChar = '#';
+      MappedFile::SP file;
+      const std::string fileName;
+
+    private:
+      /*! throws a parse error for given (0-based) line */
+      void parseError(size_t line) const;
+    };
+
+    template<typename Lambda>
+    void TextFile::parseRecords(const std::vector<TextChunk> &chunks,
+                                const Lambda &parseRecord) const
+    {
+      // first (0-based) line that failed to parse, if any
+      std::atomic<size_t> firstBadLine(size_t(-1));
+      parallel_for(chunks.size(),[&](size_t chunkID){
+          const TextChunk &chunk = chunks[chunkID];
+          size_t offset   = chunk.begin;
+          size_t line     = chunk.firstLine;
+          size_t recordID = chunk.firstRecord;
+          while (offset < chunk.end) {
+            TextCursor cursor = nextLine(offset);
+            if (!cursor.atLineEnd(commentChar)) {
+              if (!parseRecord(recordID,cursor) || !cursor.atLineEnd(commentChar)) {
+                size_t bad = firstBadLine.load();
+                while (line < bad && !firstBadLine.compare_exchange_weak(bad,line));
+                return;
+              }
+              ++recordID;
+            }
+            ++line;
+          }
+        });
+      if (firstBadLine != size_t(-1))
+        parseError(firstBadLine);
+    }
+
+  } // ::umesh::io
+} // ::umesh
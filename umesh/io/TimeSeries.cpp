@@ -0,0 +1,303 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/TimeSeries.h"
+#include "umesh/io/Compression.h"
+#include <atomic>
+#include <cstring>
+
+namespace umesh {
+  namespace io {
+    namespace timeSteps {
+
+      using namespace container;
+
+      inline uint32_t bitsOf(float f)
+      {
+        uint32_t bits;
+        memcpy(&bits,&f,sizeof(bits));
+        return bits;
+      }
+      
+      /*! packs one block of 'n' values */
+      std::vector<uint8_t> packBlock(const float *values,
+                                     const float *previous,
+                                     size_t n)
+      {
+        std::vector<uint32_t> words(n);
+        for (size_t i=0;i<n;i++)
+          words[i] = bitsOf(values[i]) ^ (previous ? bitsOf(previous[i]) : 0u);
+        std::vector<uint8_t> out;
+        compression::packBytePlanes(words.data(),n,out);
+        return out;
+      }
+      
+      /*! unpacks one block of 'n' values; for DELTA blocks 'values'
+          contains the previous step's values on input */
+      void unpackBlock(const uint8_t *in, const uint8_t *end,
+                       bool delta, float *values, size_t n)
+      {
+        std::vector<uint32_t> words(n);
+        compression::unpackBytePlanes(in,end,words.data(),n);
+        for (size_t i=0;i<n;i++) {
+          const uint32_t bits = words[i] ^ (delta ? bitsOf(values[i]) : 0u);
+          memcpy(&values[i],&bits,sizeof(bits));
+        }
+      }
+      
+      std::vector<uint8_t> encode(const float *values,
+                                  size_t count,
+                                  Encoding encoding,
+                                  const float *previous)
+      {
+        Header header;
+        header.encoding = encoding;
+        std::vector<uint8_t> out(sizeof(header));
+        if (encoding == RAW) {
+          memcpy(out.data(),&header,sizeof(header));
+          out.insert(out.end(),(const uint8_t*)values,(const uint8_t*)(values+count));
+          return out;
+        }
+        if (encoding == DELTA && !previous)
+          throw std::runtime_error("#umesh.io: delta-encoding a time step requires its previous step");
+        
+        header.blockSize = defaultBlockSize;
+        header.numBlocks = divRoundUp(count,size_t(header.blockSize));
+        memcpy(out.data(),&header,sizeof(header));
+        std::vector<std::vector<uint8_t>> blocks(header.numBlocks);
+        parallel_for(header.numBlocks,[&](size_t blockID){
+            const size_t begin = blockID*header.blockSize;
+            const size_t end   = std::min(begin+header.blockSize,count);
+            blocks[blockID] = packBlock(values+begin,
+                                        encoding == DELTA ? previous+begin : nullptr,
+                                        end-begin);
+          });
+        std::vector<uint64_t> offsets(header.numBlocks+1,0);
+        for (size_t blockID=0;blockID<header.numBlocks;blockID++)
+          offsets[blockID+1] = offsets[blockID]+blocks[blockID].size();
+        out.insert(out.end(),(const uint8_t*)offsets.data(),
+                   (const uint8_t*)(offsets.data()+offsets.size()));
+        const size_t dataBegin = out.size();
+        out.resize(dataBegin+offsets.back());
+        parallel_for(header.numBlocks,[&](size_t blockID){
+            memcpy(out.data()+dataBegin+offsets[blockID],
+                   blocks[blockID].data(),blocks[blockID].size());
+          });
+        return out;
+      }
+
+      Header readHeader(const uint8_t *data, size_t numBytes)
+      {
+        Header header;
+        if (numBytes < sizeof(header))
+          throw std::runtime_error("#umesh.io: corrupt time step data");
+        memcpy(&header,data,sizeof(header));
+        return header;
+      }
+      
+      Encoding getEncoding(const uint8_t *data, size_t numBytes)
+      {
+        return (Encoding)readHeader(data,numBytes).encoding;
+      }
+      
+      void decode(const uint8_t *data, size_t numBytes,
+                  size_t count, float *values)
+      {
+        const Header header = readHeader(data,numBytes);
+        const uint8_t *end = data+numBytes;
+        data += sizeof(header);
+        if (header.encoding == RAW) {
+          if (size_t(end-data) != count*sizeof(float))
+            throw std::runtime_error("#umesh.io: corrupt time step data");
+          memcpy(values,data,count*sizeof(float));
+          return;
+        }
+        if (header.encoding != PACKED && header.encoding != DELTA)
+          throw std::runtime_error("#umesh.io: unknown time step encoding "
+                                   +std::to_string(header.encoding));
+        if (header.blockSize == 0 ||
+            header.numBlocks != divRoundUp(count,size_t(header.blockSize)) ||
+            size_t(end-data) < (header.numBlocks+1)*sizeof(uint64_t))
+          throw std::runtime_error("#umesh.io: corrupt time step data");
+        std::vector<uint64_t> offsets(header.numBlocks+1);
+        memcpy(offsets.data(),data,offsets.size()*sizeof(uint64_t));
+        data += offsets.size()*sizeof(uint64_t);
+        if (offsets.back() != uint64_t(end-data))
+          throw std::runtime_error("#umesh.io: corrupt time step data");
+
+        std::atomic<bool> corrupt(false);
+        parallel_for(header.numBlocks,[&](size_t blockID){
+            const size_t begin = blockID*header.blockSize;
+            const size_t n     = std::min(begin+header.blockSize,count)-begin;
+            if (offsets[blockID] > offsets[blockID+1] ||
+                offsets[blockID+1] > offsets.back()) {
+              corrupt = true;
+              return;
+            }
+            try {
+              unpackBlock(data+offsets[blockID],data+offsets[blockID+1],
+                          header.encoding == DELTA,values+begin,n);
+            } catch (std::runtime_error &) {
+              corrupt = true;
+            }
+          });
+        if (corrupt)
+          throw std::runtime_error("#umesh.io: corrupt time step data");
+      }
+      
+    } // ::umesh::io::timeSteps
+
+    using namespace container;
+    
+    TimeSeriesReader::SP TimeSeriesReader::open(const std::string &fileName)
+    {
+      return std::make_shared<TimeSeriesReader>(fileName);
+    }
+      
+    TimeSeriesReader::TimeSeriesReader(const std::string &fileName)
+      : fileName(fileName),
+        file(PositionalFile::openForReading(fileName))
+    {
+      Header header;
+      if (file->size() < sizeof(header))
+        throw std::runtime_error("#umesh.io: '"+fileName+"' is not a umesh container");
+      file->read(0,&header,sizeof(header));
+      if (!isContainer(header.magic))
+        throw std::runtime_error("#umesh.io: '"+fileName+"' is not a umesh container");
+      std::vector<Section> sections(header.numSections);
+      file->read(header.tocOffset,sections.data(),sections.size()*sizeof(Section));
+      if (checksum(sections.data(),sections.size()*sizeof(Section))
+          != header.tocChecksum)
+        throw std::runtime_error("#umesh.io: checksum mismatch in container TOC");
+      for (auto &section : sections)
+        if (section.type == TIME_STEP)
+          variables[section.getName()].steps.push_back(section);
+    }
+
+    std::vector<std::string> TimeSeriesReader::getVariables() const
+    {
+      std::vector<std::string> result;
+      for (auto &it : variables)
+        result.push_back(it.first);
+      return result;
+    }
+    
+    std::vector<int> TimeSeriesReader::getTimeSteps(const std::string &variable) const
+    {
+      std::vector<int> result;
+      auto it = variables.find(variable);
+      if (it != variables.end())
+        for (auto &step : it->second.steps)
+          result.push_back((int)step.flags);
+      return result;
+    }
+
+    const TimeSeriesReader::Variable &
+    TimeSeriesReader::getVariable(const std::string &variable) const
+    {
+      auto it = variables.find(variable);
+      if (it == variables.end())
+        throw std::runtime_error("#umesh.io: no time-varying variable '"+variable
+                                 +"' in '"+fileName+"'");
+      return it->second;
+    }
+    
+    int TimeSeriesReader::findStep(const Variable &var, int timeStep) const
+    {
+      for (size_t i=0;i<var.steps.size();i++)
+        if ((int)var.steps[i].flags == timeStep)
+          return (int)i;
+      return -1;
+    }
+    
+    bool TimeSeriesReader::hasTimeStep(const std::string &variable, int timeStep) const
+    {
+      auto it = variables.find(variable);
+      return it != variables.end() && findStep(it->second,timeStep) >= 0;
+    }
+    
+    range1f TimeSeriesReader::getValueRange(const std::string &variable, int timeStep) const
+    {
+      const Variable &var = getVariable(variable);
+      const int stepID = findStep(var,timeStep);
+      if (stepID < 0)
+        throw std::runtime_error("#umesh.io: variable '"+variable+"' has no time step "
+                                 +std::to_string(timeStep));
+      return var.steps[stepID].valueRange;
+    }
+      
+    std::vector<float> TimeSeriesReader::read(const std::string &variable, int timeStep)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Variable &var = const_cast<Variable &>(getVariable(variable));
+      const int stepID = findStep(var,timeStep);
+      if (stepID < 0)
+        throw std::runtime_error("#umesh.io: variable '"+variable+"' has no time step "
+                                 +std::to_string(timeStep));
+      if (stepID == var.cachedStep)
+        return var.cached;
+      
+      /* walk back to the step's key frame (or to the cached step, if
+         that is in between), reading each step on the way */
+      std::vector<std::vector<uint8_t>> chain;
+      int first = stepID;
+      while (true) {
+        const Section &section = var.steps[first];
+        std::vector<uint8_t> data(section.numBytes);
+        file->read(section.offset,data.data(),data.size());
+        if (checksum(data.data(),data.size()) != section.checksum)
+          throw std::runtime_error("#umesh.io: checksum mismatch in time step "
+                                   +std::to_string(section.flags)+" of '"+variable+"'");
+        chain.push_back(std::move(data));
+        if (timeSteps::getEncoding(chain.back().data(),chain.back().size())
+            != timeSteps::DELTA)
+          break;
+        if (first == 0)
+          throw std::runtime_error("#umesh.io: first time step of '"+variable
+                                   +"' is a delta");
+        if (first-1 == var.cachedStep)
+          break;
+        --first;
+      }
+
+      const size_t count = var.steps[stepID].count;
+      std::vector<float> values;
+      if (first-1 == var.cachedStep &&
+          timeSteps::getEncoding(chain.back().data(),chain.back().size()) == timeSteps::DELTA)
+        values = var.cached;
+      values.resize(count);
+      for (int i=(int)chain.size()-1;i>=0;--i) {
+        if (var.steps[stepID-i].count != count)
+          throw std::runtime_error("#umesh.io: time steps of '"+variable
+                                   +"' differ in size");
+        timeSteps::decode(chain[i].data(),chain[i].size(),count,values.data());
+      }
+      var.cachedStep = stepID;
+      var.cached     = values;
+      return values;
+    }
+
+    Attribute::SP TimeSeriesReader::readAttribute(const std::string &variable, int timeStep)
+    {
+      Attribute::SP attribute = std::make_shared<Attribute>();
+      attribute->name   = variable;
+      attribute->values = read(variable,timeStep);
+      attribute->finalize();
+      return attribute;
+    }
+    
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,150 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* time-varying per-vertex variables in (version-2) .umesh files: the
+   geometry gets stored once, and each time step of each variable as
+   a TIME_STEP section of its own. Each such section's TOC entry has
+   the variable's name, the time step ID (in 'flags'), the number of
+   values, and the step's value range, so finding out what's in a
+   file only requires reading its TOC, and each step can be read
+   without reading any of the others (except, if delta-encoded, those
+   back to the previous key frame). UMesh::loadFrom() skips these
+   sections; use a TimeSeriesReader to read them, and
+   UMeshWriter::addTimeStep() to write them. */
+
+#pragma once
+
+#include "umesh/io/Container.h"
+#include "umesh/io/ParallelIO.h"
+#include <map>
+#include <mutex>
+
+namespace umesh {
+  namespace io {
+    namespace timeSteps {
+
+      /*! how a TIME_STEP section's values are stored */
+      typedef enum : uint32_t {
+        /*! plain floats */
+        RAW    = 0,
+        /*! independently packed blocks of values: each block's floats
+            get split into four byte planes (all lowest bytes first,
+            then all second bytes, etc), and runs of zero bytes get
+            run-length encoded */
+        PACKED = 1,
+        /*! same as PACKED, but of the bitwise XOR with the same
+            variable's previous step (in file order); for slowly
+            changing variables most upper bytes of that are zero */
+        DELTA  = 2
+      } Encoding;
+
+      /*! how UMeshWriter::addTimeStep() encodes time steps */
+      struct Options {
+        /*! if false, steps get stored as RAW floats */
+        bool compress         = true;
+        /*! if true (and compressing), steps get stored as DELTAs to
+            their previous step */
+        bool delta            = true;
+        /*! maximum number of steps in a chain of one key frame (a
+            non-DELTA step) and the DELTAs that follow it; reading a
+            step reads at most that many sections */
+        int  keyframeInterval = 16;
+      };
+      
+      /*! header at the start of each TIME_STEP section's data; for
+          PACKED and DELTA it is followed by 'numBlocks+1' uint64 offsets
+          of the blocks (relative to the end of that table), and then
+          the blocks; for RAW by the floats */
+      struct Header {
+        uint32_t encoding  = RAW;
+        /*! number of values per (packed) block */
+        uint32_t blockSize = 0;
+        uint64_t numBlocks = 0;
+      };
+
+      /*! number of values per block that get packed independently (and
+          in parallel) */
+      const uint32_t defaultBlockSize = 64*1024;
+      
+      /*! encodes given values into a TIME_STEP section's data; for
+          DELTA 'previous' has to point to the previous step's
+          'count' values */
+      std::vector<uint8_t> encode(const float *values,
+                                  size_t count,
+                                  Encoding encoding,
+                                  const float *previous = nullptr);
+
+      /*! returns the encoding of given section data */
+      Encoding getEncoding(const uint8_t *data, size_t numBytes);
+      
+      /*! decodes given section data into 'values' (which must have
+          space for 'count' floats); for DELTA sections 'values' has
+          to contain the previous step's values on input. Throws if
+          the data is corrupt */
+      void decode(const uint8_t *data, size_t numBytes,
+                  size_t count, float *values);
+      
+    } // ::umesh::io::timeSteps
+
+    /*! random access to the TIME_STEP sections of a .umesh file: only
+        the TOC gets read when opening the file, and each read() then
+        only reads the requested step (and, for delta-encoded steps,
+        the ones it depends on). The last step read of each variable
+        gets cached, so reading a variable's steps in order decodes
+        each step only once. Thread-safe. */
+    struct TimeSeriesReader {
+      typedef std::shared_ptr<TimeSeriesReader> SP;
+
+      static TimeSeriesReader::SP open(const std::string &fileName);
+
+      TimeSeriesReader(const std::string &fileName);
+
+      /*! names of all time-varying variables in the file */
+      std::vector<std::string> getVariables() const;
+      /*! IDs of all time steps of given variable, in file order;
+          empty if there's no such variable */
+      std::vector<int> getTimeSteps(const std::string &variable) const;
+      bool hasTimeStep(const std::string &variable, int timeStep) const;
+      /*! value range of given step, as stored in the TOC */
+      range1f getValueRange(const std::string &variable, int timeStep) const;
+
+      /*! reads one time step of one variable; throws if there's no
+          such step */
+      std::vector<float> read(const std::string &variable, int timeStep);
+      /*! same as read(), as a (finalized) attribute named after the
+          variable, eg, to be used as a mesh's perVertex */
+      Attribute::SP readAttribute(const std::string &variable, int timeStep);
+
+      const std::string fileName;
+      
+    private:
+      struct Variable {
+        /*! all of its TIME_STEP sections, in file order */
+        std::vector<container::Section> steps;
+        /*! index (into 'steps') of the cached step, or -1 */
+        int                             cachedStep = -1;
+        std::vector<float>              cached;
+      };
+      const Variable &getVariable(const std::string &variable) const;
+      int findStep(const Variable &var, int timeStep) const;
+      
+      PositionalFile::SP              file;
+      std::map<std::string,Variable>  variables;
+      std::mutex                      mutex;
+    };
+
+  } // ::umesh::io
+} // ::umesh
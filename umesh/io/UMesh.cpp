@@ -16,19 +16,264 @@
 
 #include "UMesh.h"
 #include "../UMesh.h"
+#include "Container.h"
+#include "../ScalarStats.h"
+#include <sstream>
 
 namespace umesh {
   namespace io {
 
     void saveBinaryUMesh(const std::string &fileName,
-                         UMesh::SP mesh)
+                         UMesh::SP mesh,
+                         bool compress)
     {
-      mesh->saveTo(fileName);
+      mesh->saveTo(fileName,compress);
     }
     
-    UMesh::SP loadBinaryUMesh(const std::string &fileName)
+    UMesh::SP loadBinaryUMesh(const std::string &fileName,
+                              const LoadSelection &selection)
     {
-      return UMesh::loadFrom(fileName);
+      return UMesh::loadFrom(fileName,selection);
+    }
+
+    MappedUMesh::SP mapBinaryUMesh(const std::string &fileName)
+    {
+      return MappedUMesh::map(fileName);
+    }
+
+    /*! reads the size of the next array in the stream, and skips over
+        that array's data */
+    template<typename T>
+    size_t skipVector(std::istream &in)
+    {
+      size_t N;
+      readElement(in,N);
+      in.seekg(N*sizeof(T),std::ios::cur);
+      if (!in.good())
+        throw std::runtime_error("#umesh.io: array size in file exceeds size of file");
+      return N;
+    }
+    
+    /*! gathers info for a version-2 container, from its header and
+        table of contents only */
+    void readContainerInfo(UMeshInfo &info, std::istream &in, size_t magic)
+    {
+      using namespace container;
+      Header header;
+      std::vector<Section> sections;
+      SectionReader reader(in,readTOC(in,magic,header,sections));
+      info.formatVersion    = header.version;
+      info.bounds           = header.bounds;
+      info.gridsScalarRange = header.gridsScalarRange;
+
+      for (auto &section : sections) {
+        switch (section.type) {
+        case VERTICES:     info.numVertices    += section.count; break;
+        case TRIANGLES:    info.numTriangles   += section.count; break;
+        case QUADS:        info.numQuads       += section.count; break;
+        case TETS:         info.numTets        += section.count; break;
+        case PYRS:         info.numPyrs        += section.count; break;
+        case WEDGES:       info.numWedges      += section.count; break;
+        case HEXES:        info.numHexes       += section.count; break;
+        case GRIDS:        info.numGrids       += section.count; break;
+        case GRID_SCALARS: info.numGridScalars += section.count; break;
+        case VERTEX_TAGS:  info.numVertexTags  += section.count; break;
+        case QUANTIZED_VERTICES:
+          info.quantizedVertices = true;
+          if (section.flags == 0) info.numVertices += section.count;
+          break;
+        case INDICES_16: {
+          info.indices16 = true;
+          switch (section.flags) {
+          case UMesh::TRI:   info.numTriangles += section.count/3; break;
+          case UMesh::QUAD:  info.numQuads     += section.count/4; break;
+          case UMesh::TET:   info.numTets      += section.count/4; break;
+          case UMesh::PYR:   info.numPyrs      += section.count/5; break;
+          case UMesh::WEDGE: info.numWedges    += section.count/6; break;
+          case UMesh::HEX:   info.numHexes     += section.count/8; break;
+          }
+        } break;
+        case QUANTIZED_ATTRIBUTE: {
+          UMeshInfo::AttributeInfo *attr = nullptr;
+          for (auto &existing : info.attributes)
+            if (existing.name == section.getName() && existing.quantizedBits)
+              attr = &existing;
+          if (!attr) {
+            info.attributes.push_back({});
+            attr = &info.attributes.back();
+            attr->name          = section.getName();
+            attr->quantizedBits = section.flags;
+          }
+          attr->count += section.count;
+          attr->valueRange.extend(section.valueRange);
+        } break;
+        case VERTEX_ATTRIBUTE:
+        case ELEMENT_ATTRIBUTE: {
+          std::vector<UMeshInfo::AttributeInfo> &attributes
+            = (section.type == VERTEX_ATTRIBUTE)
+            ? info.attributes
+            : info.elementAttributes;
+          const UMesh::PrimType primType
+            = (section.type == VERTEX_ATTRIBUTE)
+            ? UMesh::INVALID
+            : (UMesh::PrimType)section.flags;
+          UMeshInfo::AttributeInfo *attr = nullptr;
+          for (auto &existing : attributes)
+            if (existing.name == section.getName() && existing.primType == primType &&
+                !existing.quantizedBits)
+              attr = &existing;
+          if (!attr) {
+            attributes.push_back({});
+            attr = &attributes.back();
+            attr->name     = section.getName();
+            attr->primType = primType;
+          }
+          attr->count += section.count;
+          attr->valueRange.extend(section.valueRange);
+        } break;
+        default:
+          /* unknown section type - skip */
+          break;
+        }
+      }
+
+      // stats are small, and come last, so those are the only data
+      // worth reading
+      for (auto &section : sections) {
+        if (section.type != ATTRIBUTE_STATS || section.compression) continue;
+        std::vector<UMeshInfo::AttributeInfo> &attributes
+          = (section.flags == UMesh::INVALID)
+          ? info.attributes
+          : info.elementAttributes;
+        for (auto &attr : attributes)
+          if (attr.name == section.getName() && !attr.quantizedBits &&
+              attr.primType == (UMesh::PrimType)section.flags) {
+            std::vector<uint8_t> bytes(section.numBytes);
+            reader.read(section,bytes.data());
+            attr.stats = ScalarStats::decode(bytes.data(),bytes.size());
+          }
+      }
+    }
+
+    /*! gathers info for one of the pre-container formats; these do
+        not store bounds, so the vertices have to be read, but all
+        other arrays get skipped over */
+    void readLegacyInfo(UMeshInfo &info, std::istream &in, size_t magic)
+    {
+      if (magic != 0x234235566ULL &&
+          magic != 0x234235567ULL &&
+          magic != 0x234235568ULL)
+        throw std::runtime_error("wrong magic number in umesh file ...");
+      const bool hasAttributeHeaders = (magic != 0x234235566ULL);
+      const bool hasGrids            = (magic == 0x234235568ULL);
+      
+      std::vector<vec3f> vertices;
+      readVector(in,vertices,"vertices");
+      info.numVertices = vertices.size();
+      std::mutex mutex;
+      parallel_for_blocked
+        (0,vertices.size(),16*1024,
+         [&](size_t begin, size_t end) {
+           box3f rangeBounds;
+           for (size_t i=begin;i<end;i++)
+             rangeBounds.extend(vertices[i]);
+           std::lock_guard<std::mutex> lock(mutex);
+           info.bounds.extend(rangeBounds);
+         });
+
+      size_t numPerVertexAttributes = 1;
+      if (hasAttributeHeaders)
+        readElement(in,numPerVertexAttributes);
+      if (numPerVertexAttributes) {
+        UMeshInfo::AttributeInfo attr;
+        if (hasAttributeHeaders)
+          readString(in,attr.name);
+        attr.count = skipVector<float>(in);
+        info.attributes.push_back(attr);
+      }
+      if (hasAttributeHeaders) {
+        size_t numPerElementAttributes = 0;
+        readElement(in,numPerElementAttributes);
+      }
+      
+      info.numTriangles = skipVector<Triangle>(in);
+      info.numQuads     = skipVector<Quad>(in);
+      info.numTets      = skipVector<Tet>(in);
+      info.numPyrs      = skipVector<Pyr>(in);
+      info.numWedges    = skipVector<Wedge>(in);
+      info.numHexes     = skipVector<Hex>(in);
+      if (hasGrids) {
+        info.numGrids       = skipVector<Grid>(in);
+        info.numGridScalars = skipVector<float>(in);
+      }
+      if (in.peek() != EOF)
+        info.numVertexTags = skipVector<size_t>(in);
+    }
+    
+    UMeshInfo readUMeshInfo(const std::string &fileName)
+    {
+      std::ifstream in(fileName, std::ios_base::binary);
+      if (!in.good())
+        throw std::runtime_error("#umesh: could not open '"+fileName+"'");
+      UMeshInfo info;
+      size_t magic;
+      readElement(in,magic);
+      if (container::isContainer(magic))
+        readContainerInfo(info,in,magic);
+      else
+        readLegacyInfo(info,in,magic);
+      return info;
+    }
+    
+    /*! return a multi-line string in the same form as
+        UMesh::toString(false) */
+    std::string UMeshInfo::toString() const
+    {
+      std::stringstream ss;
+      ss << "format : " << (formatVersion ? "v"+std::to_string(formatVersion)
+                                          : std::string("pre-container")) << std::endl;
+      ss << "#verts : " << prettyNumber(numVertices);
+      if (quantizedVertices)
+        ss << " (quantized to 16 bits)";
+      ss << std::endl;
+      if (indices16)
+        ss << "indices : 16 bits" << std::endl;
+      ss << "#tris  : " << prettyNumber(numTriangles) << std::endl;
+      ss << "#quads : " << prettyNumber(numQuads) << std::endl;
+      ss << "#tets  : " << prettyNumber(numTets) << std::endl;
+      ss << "#pyrs  : " << prettyNumber(numPyrs) << std::endl;
+      ss << "#wedges: " << prettyNumber(numWedges) << std::endl;
+      ss << "#hexes : " << prettyNumber(numHexes) << std::endl;
+      ss << "#grids : " << prettyNumber(numGrids)
+         << " (with " << prettyNumber(numGridScalars) << " grid scalars)" << std::endl;
+      if (!bounds.empty())
+        ss << "bounds : " << bounds << std::endl;
+      if (numGrids && gridsScalarRange.lower <= gridsScalarRange.upper)
+        ss << "grid values : " << gridsScalarRange << std::endl;
+      ss << "tags : " << (numVertexTags?"yes":"no") << std::endl;
+      ss << "total attributes: " << attributes.size() << std::endl;
+      for (auto &attr : attributes) {
+        ss << "  '" << attr.name << "' : " << prettyNumber(attr.count) << " values";
+        if (attr.quantizedBits)
+          ss << " (quantized to " << attr.quantizedBits << " bits)";
+        if (attr.valueRange.lower <= attr.valueRange.upper)
+          ss << ", range " << attr.valueRange;
+        ss << std::endl;
+        if (attr.stats)
+          ss << "    stats: " << attr.stats->toString() << std::endl;
+      }
+      if (!elementAttributes.empty()) {
+        ss << "total per-element attributes: " << elementAttributes.size() << std::endl;
+        for (auto &attr : elementAttributes) {
+          ss << "  '" << attr.name << "' : " << prettyNumber(attr.count) << " values";
+          if (attr.valueRange.lower <= attr.valueRange.upper)
+            ss << ", range " << attr.valueRange;
+          ss << std::endl;
+          if (attr.stats)
+            ss << "    stats: " << attr.stats->toString() << std::endl;
+        }
+      }
+      return ss.str();
     }
     
   }
@@ -18,13 +18,76 @@
 
 #include "umesh/UMesh.h"
 #include "umesh/io/IO.h"
+#include "umesh/io/MappedUMesh.h"
 
 namespace umesh {
   namespace io {
 
+    /*! see UMesh::saveTo() */
     void saveBinaryUMesh(const std::string &fileName,
-                         UMesh::SP mesh);
-    UMesh::SP loadBinaryUMesh(const std::string &fileName);
+                         UMesh::SP mesh,
+                         bool compress = false);
+    UMesh::SP loadBinaryUMesh(const std::string &fileName,
+                              const LoadSelection &selection = LoadSelection());
+
+    /*! memory-map given .umesh file, and return a read-only view
+        whose arrays point directly into the mapping */
+    MappedUMesh::SP mapBinaryUMesh(const std::string &fileName);
+
+    /*! sizes, bounds, and attributes of a .umesh file, as far as they
+        can be determined without reading any element data */
+    struct UMeshInfo {
+      struct AttributeInfo {
+        std::string     name;
+        size_t          count = 0;
+        /*! only known for version-2 files; empty otherwise */
+        range1f         valueRange;
+        /*! for per-element attributes: the type of element the
+            attribute is defined over */
+        UMesh::PrimType primType = UMesh::INVALID;
+        /*! for quantized attributes the number of bits per value,
+            else 0 */
+        int             quantizedBits = 0;
+        /*! the attribute's stats, if the file has them (see
+            umesh/ScalarStats.h) */
+        std::shared_ptr<ScalarStats> stats;
+      };
+
+      /*! return a multi-line string in the same form as
+          UMesh::toString(false) */
+      std::string toString() const;
+
+      /*! the file format's version: 2 for containers, and 0 for
+          earlier formats */
+      uint32_t formatVersion = 0;
+      size_t numVertices    = 0;
+      size_t numTriangles   = 0;
+      size_t numQuads       = 0;
+      size_t numTets        = 0;
+      size_t numPyrs        = 0;
+      size_t numWedges      = 0;
+      size_t numHexes       = 0;
+      size_t numGrids       = 0;
+      size_t numGridScalars = 0;
+      size_t numVertexTags  = 0;
+      /*! whether the vertices are CompactBrick-quantized, and the
+          elements' indices 16-bit (see umesh/CompactBrick.h) */
+      bool   quantizedVertices = false;
+      bool   indices16         = false;
+      std::vector<AttributeInfo> attributes;
+      std::vector<AttributeInfo> elementAttributes;
+      /*! bounds of the mesh; for version-2 files these come from the
+          header, for older ones they get computed from the vertices
+          (which is the only array that then has to be read) */
+      box3f   bounds;
+      /*! only known for version-2 files */
+      range1f gridsScalarRange;
+    };
+
+    /*! reads the sizes, bounds, and attributes of given .umesh file;
+        for version-2 files this only reads the header and table of
+        contents */
+    UMeshInfo readUMeshInfo(const std::string &fileName);
     
   }
 }
@@ -0,0 +1,301 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/UMeshWriter.h"
+#include "umesh/io/IO.h"
+#include "umesh/io/Compression.h"
+#include <algorithm>
+
+namespace umesh {
+  namespace io {
+
+    using namespace container;
+
+    UMeshWriter::SP UMeshWriter::create(const std::string &fileName,
+                                        size_t bufferSize)
+    {
+      return std::make_shared<UMeshWriter>(fileName,bufferSize);
+    }
+
+    UMeshWriter::UMeshWriter(const std::string &fileName,
+                             size_t bufferSize)
+      : fileName(fileName),
+        out(fileName,std::ios::binary),
+        bufferSize(bufferSize)
+    {
+      if (!out.good())
+        throw std::runtime_error("#umesh.io: could not open '"+fileName+"' for writing");
+      // placeholder, gets overwritten in close()
+      writeElement(out,header);
+      position = sizeof(header);
+    }
+
+    UMeshWriter::~UMeshWriter()
+    {
+      if (closed) return;
+      try {
+        close();
+      } catch (std::exception &e) {
+        std::cerr << "#umesh.io: error closing '" << fileName << "': "
+                  << e.what() << std::endl;
+      }
+    }
+
+    void UMeshWriter::addVertices(const vec3f *vertices, size_t count)
+    {
+      box3f batchBounds;
+      for (size_t i=0;i<count;i++)
+        batchBounds.extend(vertices[i]);
+      header.bounds.extend(batchBounds);
+      add(VERTICES,vertices,count);
+    }
+
+    /*! computes the range of the given values */
+    range1f computeValueRange(const float *values, size_t count)
+    {
+      range1f range;
+      for (size_t i=0;i<count;i++)
+        range.extend(values[i]);
+      return range;
+    }
+
+    void UMeshWriter::addVertexAttribute(const std::string &name,
+                                         const float *values, size_t count)
+    {
+      add(VERTEX_ATTRIBUTE,values,count,name,0,
+          computeValueRange(values,count));
+    }
+
+    void UMeshWriter::addElementAttribute(UMesh::PrimType primType,
+                                          const std::string &name,
+                                          const float *values, size_t count)
+    {
+      add(ELEMENT_ATTRIBUTE,values,count,name,(uint32_t)primType,
+          computeValueRange(values,count));
+    }
+
+    void UMeshWriter::addTriangles(const Triangle *triangles, size_t count)
+    { add(TRIANGLES,triangles,count); }
+
+    void UMeshWriter::addQuads(const Quad *quads, size_t count)
+    { add(QUADS,quads,count); }
+
+    void UMeshWriter::addTets(const Tet *tets, size_t count)
+    { add(TETS,tets,count); }
+
+    void UMeshWriter::addPyrs(const Pyr *pyrs, size_t count)
+    { add(PYRS,pyrs,count); }
+
+    void UMeshWriter::addWedges(const Wedge *wedges, size_t count)
+    { add(WEDGES,wedges,count); }
+
+    void UMeshWriter::addHexes(const Hex *hexes, size_t count)
+    { add(HEXES,hexes,count); }
+
+    void UMeshWriter::addGrids(const Grid *grids, size_t count)
+    { add(GRIDS,grids,count); }
+
+    void UMeshWriter::addGridScalars(const float *scalars, size_t count)
+    {
+      header.gridsScalarRange.extend(computeValueRange(scalars,count));
+      add(GRID_SCALARS,scalars,count);
+    }
+
+    void UMeshWriter::addVertexTags(const size_t *tags, size_t count)
+    { add(VERTEX_TAGS,tags,count); }
+
+    void UMeshWriter::addQuantizedAttribute(const QuantizedAttribute &attr)
+    {
+      if (attr.bits == 8)
+        add(QUANTIZED_ATTRIBUTE,attr.codes8.data(),attr.codes8.size(),
+            attr.name,8,attr.valueRange);
+      else
+        add(QUANTIZED_ATTRIBUTE,attr.codes16.data(),attr.codes16.size(),
+            attr.name,16,attr.valueRange);
+    }
+
+    template<typename T>
+    void UMeshWriter::addNow(uint32_t type, const std::vector<T> &vec,
+                             const std::string &name, uint32_t flags,
+                             const range1f &valueRange)
+    {
+      add(type,vec.data(),vec.size(),name,flags,valueRange);
+      flush(pending[SectionKey(type,flags,name)]);
+    }
+    
+    void UMeshWriter::addMesh(const UMesh &mesh)
+    {
+      addVertices(mesh.vertices);
+      flush(pending[SectionKey(VERTICES,0,"")]);
+      std::vector<Attribute::SP> attributes = mesh.attributes;
+      if (mesh.perVertex) {
+        attributes.erase(std::remove(attributes.begin(),attributes.end(),mesh.perVertex),
+                         attributes.end());
+        attributes.insert(attributes.begin(),mesh.perVertex);
+      }
+      for (auto attr : attributes)
+        addNow(VERTEX_ATTRIBUTE,attr->values,attr->name,0,
+               computeValueRange(attr->values.data(),attr->values.size()));
+      for (auto attr : mesh.quantizedAttributes) {
+        addQuantizedAttribute(*attr);
+        flush(pending[SectionKey(QUANTIZED_ATTRIBUTE,attr->bits,attr->name)]);
+      }
+      for (auto attr : mesh.elementAttributes)
+        addNow(ELEMENT_ATTRIBUTE,attr.second->values,attr.second->name,
+               (uint32_t)attr.first,
+               computeValueRange(attr.second->values.data(),attr.second->values.size()));
+      addNow(TRIANGLES,mesh.triangles);
+      addNow(QUADS,mesh.quads);
+      addNow(TETS,mesh.tets);
+      addNow(PYRS,mesh.pyrs);
+      addNow(WEDGES,mesh.wedges);
+      addNow(HEXES,mesh.hexes);
+      addNow(GRIDS,mesh.grids);
+      addGridScalars(mesh.gridScalars);
+      flush(pending[SectionKey(GRID_SCALARS,0,"")]);
+      addNow(VERTEX_TAGS,mesh.vertexTags);
+    }
+
+    void UMeshWriter::addTimeStep(const std::string &variable, int timeStep,
+                                  const float *values, size_t count)
+    {
+      if (closed)
+        throw std::runtime_error("#umesh.io: UMeshWriter already closed");
+      TimeSeriesState &state = timeSeries[variable];
+      const timeSteps::Options &options = timeStepOptions;
+      const bool delta
+        =  options.compress && options.delta
+        && state.chainLength > 0
+        && state.chainLength < options.keyframeInterval
+        && state.previous.size() == count;
+      const timeSteps::Encoding encoding
+        = !options.compress ? timeSteps::RAW
+        : delta             ? timeSteps::DELTA
+        :                     timeSteps::PACKED;
+      const std::vector<uint8_t> data
+        = timeSteps::encode(values,count,encoding,
+                            delta ? state.previous.data() : nullptr);
+      
+      Section desc;
+      desc.type       = TIME_STEP;
+      desc.flags      = (uint32_t)timeStep;
+      desc.count      = count;
+      desc.numBytes   = data.size();
+      desc.valueRange = computeValueRange(values,count);
+      desc.setName(variable);
+      writeSection(desc,data.data());
+
+      state.chainLength = delta ? state.chainLength+1 : 1;
+      if (options.compress && options.delta)
+        state.previous.assign(values,values+count);
+    }
+    
+    size_t UMeshWriter::numAdded(uint32_t type) const
+    {
+      auto it = totalCount.find(type);
+      return it == totalCount.end() ? 0 : it->second;
+    }
+
+    /*! adds given batch to the pending section for that array. Large
+        batches that would fill the buffer on their own get written
+        directly, without first copying them */
+    template<typename T>
+    void UMeshWriter::add(uint32_t type, const T *data, size_t count,
+                          const std::string &name, uint32_t flags,
+                          const range1f &valueRange)
+    {
+      if (closed)
+        throw std::runtime_error("#umesh.io: UMeshWriter already closed");
+      totalCount[type] += count;
+
+      PendingSection &section = pending[SectionKey(type,flags,name)];
+      if (section.desc.type == INVALID_SECTION) {
+        section.desc.type  = type;
+        section.desc.flags = flags;
+        section.desc.setName(name);
+      }
+      if (count == 0) return;
+
+      const size_t numBytes = count*sizeof(T);
+      if (section.data.empty() && numBytes >= bufferSize) {
+        Section desc    = section.desc;
+        desc.count      = count;
+        desc.numBytes   = numBytes;
+        desc.valueRange = valueRange;
+        writeSection(desc,data);
+        return;
+      }
+      section.data.insert(section.data.end(),
+                          (const uint8_t *)data,
+                          (const uint8_t *)data+numBytes);
+      section.desc.count    += count;
+      section.desc.numBytes += numBytes;
+      section.desc.valueRange.extend(valueRange);
+      if (section.data.size() >= bufferSize)
+        flush(section);
+    }
+
+    void UMeshWriter::writeSection(Section desc, const void *data)
+    {
+      std::vector<uint8_t> compressed;
+      if (compress && compression::compressSection(desc,data,compressed))
+        data = compressed.data();
+
+      const std::vector<char> padding(alignment,0);
+      const uint64_t offset = alignUp(position);
+      writeArray(out,padding.data(),offset-position);
+      desc.offset   = offset;
+      desc.checksum = checksum(data,desc.numBytes);
+      writeArray(out,(const char *)data,desc.numBytes);
+      if (!out.good())
+        throw std::runtime_error("#umesh.io: error writing to '"+fileName+"'");
+      position = offset+desc.numBytes;
+      toc.push_back(desc);
+    }
+
+    void UMeshWriter::flush(PendingSection &section)
+    {
+      if (section.data.empty()) return;
+      writeSection(section.desc,section.data.data());
+      section.data.clear();
+      section.data.shrink_to_fit();
+      section.desc.count      = 0;
+      section.desc.numBytes   = 0;
+      section.desc.valueRange = range1f();
+    }
+
+    void UMeshWriter::close()
+    {
+      if (closed) return;
+      closed = true;
+      for (auto &it : pending)
+        flush(it.second);
+
+      const std::vector<char> padding(alignment,0);
+      header.tocOffset   = alignUp(position);
+      header.numSections = (uint32_t)toc.size();
+      header.tocChecksum = checksum(toc.data(),toc.size()*sizeof(Section));
+      writeArray(out,padding.data(),header.tocOffset-position);
+      writeArray(out,toc.data(),toc.size());
+      out.seekp(0);
+      writeElement(out,header);
+      out.close();
+      if (out.fail())
+        throw std::runtime_error("#umesh.io: error writing to '"+fileName+"'");
+    }
+
+  } // ::umesh::io
+} // ::umesh
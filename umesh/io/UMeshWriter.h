@@ -0,0 +1,195 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/io/Container.h"
+#include "umesh/io/TimeSeries.h"
+#include <fstream>
+#include <map>
+#include <tuple>
+
+namespace umesh {
+  namespace io {
+
+    /*! writes a (version-2) .umesh file incrementally: vertices,
+        attributes, and elements get added in batches, and get written
+        to disk as soon as enough of them have been gathered, so only
+        those batches ever have to be in memory. An array that gets
+        added in multiple batches ends up split across multiple
+        sections, which UMesh::loadFrom() concatenates (in order) when
+        reading the file back. The table of contents goes to the end
+        of the file, and the header gets patched in close().
+
+        The writer does not care in which order vertices and elements
+        get added; it is up to the user to make sure that element
+        indices refer to the right vertices (numVertices() can help
+        with that). Note the bounds stored in the header are those of
+        all vertices written. */
+    struct UMeshWriter {
+      typedef std::shared_ptr<UMeshWriter> SP;
+
+      /*! default size (in bytes) up to which batches of the same
+          array get gathered in memory before being written */
+      static const size_t defaultBufferSize = 64*1024*1024;
+
+      static UMeshWriter::SP create(const std::string &fileName,
+                                    size_t bufferSize = defaultBufferSize);
+
+      UMeshWriter(const std::string &fileName,
+                  size_t bufferSize = defaultBufferSize);
+      UMeshWriter(const UMeshWriter &) = delete;
+      /*! closes the file, if not done already */
+      ~UMeshWriter();
+
+      void addVertices(const vec3f *vertices, size_t count);
+      void addVertexAttribute(const std::string &name,
+                              const float *values, size_t count);
+      void addElementAttribute(UMesh::PrimType primType,
+                               const std::string &name,
+                               const float *values, size_t count);
+      void addTriangles(const Triangle *triangles, size_t count);
+      void addQuads(const Quad *quads, size_t count);
+      void addTets(const Tet *tets, size_t count);
+      void addPyrs(const Pyr *pyrs, size_t count);
+      void addWedges(const Wedge *wedges, size_t count);
+      void addHexes(const Hex *hexes, size_t count);
+      /*! note a grid's 'scalarsOffset' refers to the grid scalars
+          array, see numGridScalars() */
+      void addGrids(const Grid *grids, size_t count);
+      void addGridScalars(const float *scalars, size_t count);
+      void addVertexTags(const size_t *tags, size_t count);
+      /*! adds (a batch of) the codes of a quantized attribute; all
+          batches of the same attribute need the same quantization */
+      void addQuantizedAttribute(const QuantizedAttribute &attr);
+
+      /*! adds all of given mesh's arrays, with 'perVertex' (if set) as
+          the first vertex attribute, so it becomes the perVertex again
+          when loading the file; vertex indices are written as they
+          are, so this is (usually) only useful as the first thing that
+          gets added */
+      void addMesh(const UMesh &mesh);
+      
+      /*! adds one time step of a time-varying per-vertex variable, as
+          a TIME_STEP section of its own (see io/TimeSeries.h), encoded
+          as specified in 'timeStepOptions'. Each variable's steps have
+          to be added in the order they are supposed to be read in
+          (usually, by time), and all have to have the same number of
+          values */
+      void addTimeStep(const std::string &variable, int timeStep,
+                       const float *values, size_t count);
+
+      inline void addVertices(const std::vector<vec3f> &v)
+      { addVertices(v.data(),v.size()); }
+      inline void addVertexAttribute(const std::string &name, const std::vector<float> &v)
+      { addVertexAttribute(name,v.data(),v.size()); }
+      inline void addElementAttribute(UMesh::PrimType primType,
+                                      const std::string &name,
+                                      const std::vector<float> &v)
+      { addElementAttribute(primType,name,v.data(),v.size()); }
+      inline void addTriangles(const std::vector<Triangle> &v)
+      { addTriangles(v.data(),v.size()); }
+      inline void addQuads(const std::vector<Quad> &v)
+      { addQuads(v.data(),v.size()); }
+      inline void addTets(const std::vector<Tet> &v)
+      { addTets(v.data(),v.size()); }
+      inline void addPyrs(const std::vector<Pyr> &v)
+      { addPyrs(v.data(),v.size()); }
+      inline void addWedges(const std::vector<Wedge> &v)
+      { addWedges(v.data(),v.size()); }
+      inline void addHexes(const std::vector<Hex> &v)
+      { addHexes(v.data(),v.size()); }
+      inline void addGrids(const std::vector<Grid> &v)
+      { addGrids(v.data(),v.size()); }
+      inline void addGridScalars(const std::vector<float> &v)
+      { addGridScalars(v.data(),v.size()); }
+      inline void addVertexTags(const std::vector<size_t> &v)
+      { addVertexTags(v.data(),v.size()); }
+      inline void addTimeStep(const std::string &variable, int timeStep,
+                              const std::vector<float> &v)
+      { addTimeStep(variable,timeStep,v.data(),v.size()); }
+
+      /*! number of vertices added so far; ie, the index the next
+          added vertex will have */
+      inline size_t numVertices() const { return numAdded(container::VERTICES); }
+      /*! number of grid scalars added so far */
+      inline size_t numGridScalars() const { return numAdded(container::GRID_SCALARS); }
+
+      /*! writes all still-pending batches, the table of contents, and
+          the final header; the writer cannot be used after this */
+      void close();
+
+      const std::string fileName;
+      /*! how addTimeStep() encodes time steps */
+      timeSteps::Options timeStepOptions;
+      /*! if set, sections get compressed (see io/Compression.h) where
+          that makes them smaller; time steps are not affected by
+          this */
+      bool               compress = false;
+
+    private:
+      /*! a batch of data for one array that has been added, but not
+          yet written */
+      struct PendingSection {
+        container::Section   desc;
+        std::vector<uint8_t> data;
+      };
+      typedef std::tuple<uint32_t,uint32_t,std::string> SectionKey;
+
+      /*! adds a batch of elements to the pending section of given
+          type, flags, and name; 'valueRange' is that of the batch's
+          values (for attributes only) */
+      template<typename T>
+      void add(uint32_t type, const T *data, size_t count,
+               const std::string &name = "", uint32_t flags = 0,
+               const range1f &valueRange = range1f());
+
+      /*! writes given section descriptor's data to the file, and adds
+          it to the toc */
+      void writeSection(container::Section desc, const void *data);
+      void flush(PendingSection &pending);
+      /*! same as add(), but writes the section right away (including
+          anything already pending for it) */
+      template<typename T>
+      void addNow(uint32_t type, const std::vector<T> &vec,
+                  const std::string &name = "", uint32_t flags = 0,
+                  const range1f &valueRange = range1f());
+      size_t numAdded(uint32_t type) const;
+
+      std::ofstream                        out;
+      /*! current write position in the file */
+      uint64_t                             position = 0;
+      const size_t                         bufferSize;
+      container::Header                    header;
+      std::vector<container::Section>      toc;
+      std::map<SectionKey,PendingSection>  pending;
+      /*! total number of elements added per section type */
+      std::map<uint32_t,size_t>            totalCount;
+      bool                                 closed = false;
+
+      /*! per time-varying variable, the values of its last step (to
+          delta-encode the next one against), and the number of steps
+          since its last key frame */
+      struct TimeSeriesState {
+        std::vector<float> previous;
+        int                chainLength = 0;
+      };
+      std::map<std::string,TimeSeriesState> timeSeries;
+    };
+
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,898 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/io/VTU.h"
+#include "umesh/io/MappedFile.h"
+#include "umesh/profile.h"
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#if UMESH_HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+namespace umesh {
+  namespace io {
+    namespace vtu {
+
+      /*! the vtk cell types we can read and write */
+      enum {
+        VTK_TRIANGLE   = 5,
+        VTK_PIXEL      = 8,
+        VTK_QUAD       = 9,
+        VTK_TETRA      = 10,
+        VTK_VOXEL      = 11,
+        VTK_HEXAHEDRON = 12,
+        VTK_WEDGE      = 13,
+        VTK_PYRAMID    = 14
+      };
+
+      /*! the umesh element types that become vtk cells, in the order
+          the cells get written in; same as UMesh::PrimType's values */
+      static const int numPrimTypes = 6;
+      static const int numVerticesOf[numPrimTypes] = { 3, 4, 4, 5, 6, 8 };
+      static const uint8_t vtkTypeOf[numPrimTypes] = {
+        VTK_TRIANGLE, VTK_QUAD, VTK_TETRA, VTK_PYRAMID, VTK_WEDGE, VTK_HEXAHEDRON
+      };
+      
+      /*! uncompressed size of the blocks that compressed arrays get
+          split into; each block gets (de)compressed independently */
+      static const size_t blockSize = 1<<20;
+      /*! number of blocks that get produced (and compressed) in
+          parallel before being written */
+      static const size_t blocksPerBatch = 64;
+
+      /*! all of a mesh's elements of one type, as a range of cells */
+      struct CellRange {
+        const int *indices   = nullptr;
+        size_t     count     = 0;
+        /*! index of the range's first cell, and of its first vertex
+            index in the connectivity array */
+        size_t     firstCell = 0;
+        size_t     firstIndex = 0;
+      };
+
+      /*! one array to be written to the appended data; 'fill(begin,
+          end, dst)' produces the (little-endian) bytes of values
+          [begin,end) from wherever they actually live */
+      struct ArraySource {
+        std::string name;
+        std::string type;
+        int         numComponents = 1;
+        size_t      numValues = 0;
+        size_t      valueSize = 4;
+        std::function<void(size_t, size_t, uint8_t *)> fill;
+      };
+
+      std::string escape(const std::string &s)
+      {
+        std::string result;
+        for (char c : s)
+          switch (c) {
+          case '&': result += "&amp;";  break;
+          case '<': result += "&lt;";   break;
+          case '>': result += "&gt;";   break;
+          case '"': result += "&quot;"; break;
+          default:  result += c;
+          }
+        return result;
+      }
+
+      std::string unescape(const std::string &s)
+      {
+        static const std::pair<const char *,char> entities[] = {
+          { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' },
+          { "&quot;", '"' }, { "&apos;", '\'' }
+        };
+        std::string result;
+        for (size_t i=0;i<s.size();i++) {
+          bool replaced = false;
+          if (s[i] == '&')
+            for (auto &entity : entities)
+              if (s.compare(i,strlen(entity.first),entity.first) == 0) {
+                result += entity.second;
+                i += strlen(entity.first)-1;
+                replaced = true;
+                break;
+              }
+          if (!replaced) result += s[i];
+        }
+        return result;
+      }
+
+      /*! writes the array's data in raw form: a uint64 byte count,
+          followed by the bytes */
+      void writeRaw(std::ofstream &out, const ArraySource &array)
+      {
+        const uint64_t numBytes = array.numValues*array.valueSize;
+        out.write((const char *)&numBytes,sizeof(numBytes));
+        const size_t valuesPerBlock = blockSize/array.valueSize;
+        const size_t valuesPerBatch = blocksPerBatch*valuesPerBlock;
+        std::vector<uint8_t> batch(std::min(numBytes,uint64_t(blocksPerBatch*blockSize)));
+        for (size_t batchBegin=0;batchBegin<array.numValues;batchBegin+=valuesPerBatch) {
+          const size_t batchEnd = std::min(batchBegin+valuesPerBatch,array.numValues);
+          parallel_for_blocked(batchBegin,batchEnd,valuesPerBlock,
+                               [&](size_t begin, size_t end){
+                                 array.fill(begin,end,batch.data()
+                                            +(begin-batchBegin)*array.valueSize);
+                               });
+          out.write((const char *)batch.data(),(batchEnd-batchBegin)*array.valueSize);
+        }
+      }
+
+#if UMESH_HAVE_ZLIB
+      /*! writes the array's data in vtk's zlib format: a uint64
+          header (number of blocks, uncompressed block size, size of
+          the last block if partial, then the compressed size of each
+          block), followed by the compressed blocks. The header can
+          only be completed once all blocks are compressed, so it gets
+          written as a placeholder first, and patched at the end */
+      void writeCompressed(std::ofstream &out, const ArraySource &array, int level)
+      {
+        const uint64_t numBytes  = array.numValues*array.valueSize;
+        const uint64_t numBlocks = (numBytes+blockSize-1)/blockSize;
+        std::vector<uint64_t> header(3+numBlocks);
+        header[0] = numBlocks;
+        header[1] = blockSize;
+        header[2] = numBytes % blockSize;
+        const std::streampos headerPos = out.tellp();
+        out.write((const char *)header.data(),header.size()*sizeof(uint64_t));
+
+        const size_t valuesPerBlock = blockSize/array.valueSize;
+        std::vector<std::vector<uint8_t>> compressed(blocksPerBatch);
+        std::atomic<bool> failed(false);
+        for (size_t batchBegin=0;batchBegin<numBlocks;batchBegin+=blocksPerBatch) {
+          const size_t batchEnd = std::min(batchBegin+blocksPerBatch,size_t(numBlocks));
+          parallel_for(batchEnd-batchBegin,[&](size_t i){
+              const size_t begin = (batchBegin+i)*valuesPerBlock;
+              const size_t end   = std::min(begin+valuesPerBlock,array.numValues);
+              std::vector<uint8_t> raw((end-begin)*array.valueSize);
+              array.fill(begin,end,raw.data());
+              uLongf size = compressBound(raw.size());
+              compressed[i].resize(size);
+              if (compress2(compressed[i].data(),&size,raw.data(),raw.size(),level) != Z_OK)
+                failed = true;
+              compressed[i].resize(size);
+            });
+          if (failed)
+            throw std::runtime_error("#umesh.io: zlib compression failed");
+          for (size_t i=0;i<batchEnd-batchBegin;i++) {
+            header[3+batchBegin+i] = compressed[i].size();
+            out.write((const char *)compressed[i].data(),compressed[i].size());
+          }
+        }
+        const std::streampos endPos = out.tellp();
+        out.seekp(headerPos);
+        out.write((const char *)header.data(),header.size()*sizeof(uint64_t));
+        out.seekp(endPos);
+      }
+#endif
+
+      /*! the arrays with the connectivity, offsets, and types of all
+          cells */
+      void addCellArrays(std::vector<ArraySource> &arrays,
+                         const std::array<CellRange,numPrimTypes> &cells,
+                         size_t numCells, size_t numIndices)
+      {
+        ArraySource connectivity;
+        connectivity.name      = "connectivity";
+        connectivity.type      = "Int32";
+        connectivity.numValues = numIndices;
+        connectivity.fill = [&cells](size_t begin, size_t end, uint8_t *dst){
+          for (int t=0;t<numPrimTypes;t++) {
+            const CellRange &range = cells[t];
+            const size_t rangeBegin = range.firstIndex;
+            const size_t rangeEnd   = rangeBegin+range.count*numVerticesOf[t];
+            const size_t lo = std::max(begin,rangeBegin);
+            const size_t hi = std::min(end,rangeEnd);
+            if (lo < hi)
+              memcpy(dst+(lo-begin)*sizeof(int),range.indices+(lo-rangeBegin),
+                     (hi-lo)*sizeof(int));
+          }
+        };
+        arrays.push_back(connectivity);
+        
+        ArraySource offsets;
+        offsets.name      = "offsets";
+        offsets.type      = "Int64";
+        offsets.numValues = numCells;
+        offsets.valueSize = sizeof(int64_t);
+        offsets.fill = [&cells](size_t begin, size_t end, uint8_t *dst){
+          for (int t=0;t<numPrimTypes;t++) {
+            const CellRange &range = cells[t];
+            const size_t lo = std::max(begin,range.firstCell);
+            const size_t hi = std::min(end,range.firstCell+range.count);
+            for (size_t i=lo;i<hi;i++) {
+              const int64_t offset
+                = range.firstIndex+(i-range.firstCell+1)*numVerticesOf[t];
+              memcpy(dst+(i-begin)*sizeof(offset),&offset,sizeof(offset));
+            }
+          }
+        };
+        arrays.push_back(offsets);
+        
+        ArraySource types;
+        types.name      = "types";
+        types.type      = "UInt8";
+        types.numValues = numCells;
+        types.valueSize = 1;
+        types.fill = [&cells](size_t begin, size_t end, uint8_t *dst){
+          for (int t=0;t<numPrimTypes;t++) {
+            const CellRange &range = cells[t];
+            const size_t lo = std::max(begin,range.firstCell);
+            const size_t hi = std::min(end,range.firstCell+range.count);
+            if (lo < hi)
+              memset(dst+(lo-begin),vtkTypeOf[t],hi-lo);
+          }
+        };
+        arrays.push_back(types);
+      }
+
+      // ==================================================================
+      // reading
+      // ==================================================================
+      
+      /*! a (start or end) tag in the xml header, with its attributes */
+      struct XmlTag {
+        std::string name;
+        bool        isEnd = false;
+        std::map<std::string,std::string> attributes;
+
+        std::string get(const std::string &attribute,
+                        const std::string &defaultValue="") const
+        {
+          auto it = attributes.find(attribute);
+          return it == attributes.end() ? defaultValue : it->second;
+        }
+      };
+
+      /*! parses the next tag at or after 'ptr' (skipping the xml
+          declaration, comments, and any text); returns false at the
+          end of the header */
+      bool nextTag(const char *&ptr, const char *end, XmlTag &tag)
+      {
+        while (true) {
+          ptr = (const char *)memchr(ptr,'<',end-ptr);
+          if (!ptr) return false;
+          if (end-ptr >= 4 && !strncmp(ptr,"<!--",4)) {
+            const char *p = ptr;
+            while (p+3 <= end && strncmp(p,"-->",3)) ++p;
+            ptr = p+3;
+            continue;
+          }
+          if (end-ptr >= 2 && (ptr[1] == '?' || ptr[1] == '!')) {
+            ++ptr;
+            continue;
+          }
+          break;
+        }
+        const char *p = ptr+1;
+        tag = XmlTag();
+        if (p < end && *p == '/') { tag.isEnd = true; ++p; }
+        auto isNameChar = [](char c){
+          return isalnum((unsigned char)c) || c == '_' || c == ':' || c == '-' || c == '.';
+        };
+        while (p < end && isNameChar(*p)) tag.name += *p++;
+        while (p < end && *p != '>') {
+          if (!isNameChar(*p)) { ++p; continue; }
+          std::string attribute;
+          while (p < end && isNameChar(*p)) attribute += *p++;
+          while (p < end && isspace((unsigned char)*p)) ++p;
+          if (p == end || *p != '=') continue;
+          ++p;
+          while (p < end && isspace((unsigned char)*p)) ++p;
+          if (p == end || (*p != '"' && *p != '\'')) continue;
+          const char quote = *p++;
+          const char *valueEnd = (const char *)memchr(p,quote,end-p);
+          if (!valueEnd) break;
+          tag.attributes[attribute] = unescape(std::string(p,valueEnd));
+          p = valueEnd+1;
+        }
+        if (p == end)
+          throw std::runtime_error("#umesh.io: unterminated tag in .vtu header");
+        ptr = p+1;
+        return true;
+      }
+
+      /*! an array in the appended data, as described in the header */
+      struct ArrayInfo {
+        std::string name;
+        std::string type;
+        int         numComponents = 1;
+        uint64_t    offset = 0;
+      };
+
+      /*! the appended data of a .vtu file, and how to get arrays out
+          of it */
+      struct AppendedData {
+        const MappedFile::SP file;
+        /*! offset of the first byte after the '_' marker */
+        size_t begin          = 0;
+        bool   headerIs64Bit  = false;
+        bool   zlib           = false;
+
+        /*! reads header word 'i' at given offset */
+        uint64_t headerWord(size_t offset, size_t i) const
+        {
+          if (headerIs64Bit) {
+            uint64_t word;
+            memcpy(&word,file->at(offset+i*8,8),8);
+            return word;
+          }
+          uint32_t word;
+          memcpy(&word,file->at(offset+i*4,4),4);
+          return word;
+        }
+
+        /*! returns pointer to given array's (uncompressed) bytes,
+            decompressing into 'storage' if required */
+        const uint8_t *bytes(const ArrayInfo &array, size_t &numBytes,
+                             std::vector<uint8_t> &storage) const
+        {
+          const size_t offset = begin+array.offset;
+          const size_t wordSize = headerIs64Bit ? 8 : 4;
+          if (!zlib) {
+            numBytes = headerWord(offset,0);
+            return file->at(offset+wordSize,numBytes);
+          }
+#if UMESH_HAVE_ZLIB
+          const size_t numBlocks = headerWord(offset,0);
+          const size_t blockBytes = headerWord(offset,1);
+          const size_t lastBytes  = headerWord(offset,2);
+          numBytes = numBlocks == 0 ? 0
+            : (numBlocks-1)*blockBytes + (lastBytes ? lastBytes : blockBytes);
+          std::vector<size_t> blockBegin(numBlocks+1);
+          blockBegin[0] = offset+(3+numBlocks)*wordSize;
+          for (size_t i=0;i<numBlocks;i++)
+            blockBegin[i+1] = blockBegin[i]+headerWord(offset,3+i);
+          storage.resize(numBytes);
+          std::atomic<bool> failed(false);
+          parallel_for(numBlocks,[&](size_t i){
+              const size_t compressedBytes = blockBegin[i+1]-blockBegin[i];
+              uLongf expected = std::min(blockBytes,numBytes-i*blockBytes);
+              uLongf size = expected;
+              if (uncompress(storage.data()+i*blockBytes,&size,
+                             file->at(blockBegin[i],compressedBytes),
+                             compressedBytes) != Z_OK || size != expected)
+                failed = true;
+            });
+          if (failed)
+            throw std::runtime_error("#umesh.io: corrupt compressed array '"
+                                     +array.name+"' in '"+file->fileName+"'");
+          return storage.data();
+#else
+          throw std::runtime_error("#umesh.io: '"+file->fileName+"' is zlib-compressed,"
+                                   " but umesh was built without zlib");
+#endif
+        }
+
+        /*! reads given array, converting (in parallel) whatever type
+            it is stored as to T; throws if that doesn't give
+            'expectedCount' values */
+        template<typename T>
+        std::vector<T> read(const ArrayInfo &array, size_t expectedCount) const
+        {
+          std::vector<uint8_t> storage;
+          size_t numBytes;
+          const uint8_t *src = bytes(array,numBytes,storage);
+          std::vector<T> result;
+#define UMESH_VTU_CONVERT(typeName,SrcT)                                \
+          if (array.type == typeName) {                                 \
+            if (numBytes != expectedCount*sizeof(SrcT))                 \
+              throw std::runtime_error("#umesh.io: array '"+array.name  \
+                                       +"' in '"+file->fileName         \
+                                       +"' has the wrong size");        \
+            result.resize(expectedCount);                               \
+            parallel_for_blocked(0,expectedCount,64*1024,               \
+                                 [&](size_t begin, size_t end){         \
+                                   for (size_t i=begin;i<end;i++) {     \
+                                     SrcT value;                        \
+                                     memcpy(&value,src+i*sizeof(SrcT),sizeof(SrcT)); \
+                                     result[i] = T(value);              \
+                                   }                                    \
+                                 });                                    \
+            return result;                                              \
+          }
+          UMESH_VTU_CONVERT("Int8",    int8_t);
+          UMESH_VTU_CONVERT("UInt8",   uint8_t);
+          UMESH_VTU_CONVERT("Int16",   int16_t);
+          UMESH_VTU_CONVERT("UInt16",  uint16_t);
+          UMESH_VTU_CONVERT("Int32",   int32_t);
+          UMESH_VTU_CONVERT("UInt32",  uint32_t);
+          UMESH_VTU_CONVERT("Int64",   int64_t);
+          UMESH_VTU_CONVERT("UInt64",  uint64_t);
+          UMESH_VTU_CONVERT("Float32", float);
+          UMESH_VTU_CONVERT("Float64", double);
+#undef UMESH_VTU_CONVERT
+          throw std::runtime_error("#umesh.io: array '"+array.name+"' in '"
+                                   +file->fileName+"' has unsupported type '"
+                                   +array.type+"'");
+        }
+      };
+
+      /*! umesh element type, and the order in which to take its
+          vertices, for given vtk cell type; -1 if we can't represent
+          that type */
+      int primTypeOf(uint8_t vtkType, const int *&vertexOrder)
+      {
+        static const int identity[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        // pixels and voxels have their vertices in lexicographical,
+        // not in cyclical order
+        static const int pixelToQuad[4] = { 0, 1, 3, 2 };
+        static const int voxelToHex[8]  = { 0, 1, 3, 2, 4, 5, 7, 6 };
+        vertexOrder = identity;
+        switch (vtkType) {
+        case VTK_TRIANGLE:   return UMesh::TRI;
+        case VTK_QUAD:       return UMesh::QUAD;
+        case VTK_PIXEL:      vertexOrder = pixelToQuad; return UMesh::QUAD;
+        case VTK_TETRA:      return UMesh::TET;
+        case VTK_PYRAMID:    return UMesh::PYR;
+        case VTK_WEDGE:      return UMesh::WEDGE;
+        case VTK_HEXAHEDRON: return UMesh::HEX;
+        case VTK_VOXEL:      vertexOrder = voxelToHex; return UMesh::HEX;
+        default:             return -1;
+        }
+      }
+      
+    } // ::umesh::io::vtu
+
+    using namespace vtu;
+
+    void saveVTU(const std::string &fileName,
+                 const UMesh &mesh,
+                 const VTUOptions &options)
+    {
+      if (!mesh.grids.empty())
+        throw std::runtime_error("#umesh.io: cannot save grids to a .vtu file");
+#if !UMESH_HAVE_ZLIB
+      if (options.compress)
+        throw std::runtime_error("#umesh.io: cannot write compressed .vtu files,"
+                                 " umesh was built without zlib");
+#endif
+      static_assert(sizeof(Triangle) == 3*sizeof(int) && sizeof(Quad) == 4*sizeof(int) &&
+                    sizeof(Tet) == 4*sizeof(int) && sizeof(Pyr) == 5*sizeof(int) &&
+                    sizeof(Wedge) == 6*sizeof(int) && sizeof(Hex) == 8*sizeof(int),
+                    "elements have to be packed arrays of vertex indices");
+      
+      std::array<CellRange,numPrimTypes> cells;
+      cells[UMesh::TRI].indices   = (const int *)mesh.triangles.data();
+      cells[UMesh::TRI].count     = mesh.triangles.size();
+      cells[UMesh::QUAD].indices  = (const int *)mesh.quads.data();
+      cells[UMesh::QUAD].count    = mesh.quads.size();
+      cells[UMesh::TET].indices   = (const int *)mesh.tets.data();
+      cells[UMesh::TET].count     = mesh.tets.size();
+      cells[UMesh::PYR].indices   = (const int *)mesh.pyrs.data();
+      cells[UMesh::PYR].count     = mesh.pyrs.size();
+      cells[UMesh::WEDGE].indices = (const int *)mesh.wedges.data();
+      cells[UMesh::WEDGE].count   = mesh.wedges.size();
+      cells[UMesh::HEX].indices   = (const int *)mesh.hexes.data();
+      cells[UMesh::HEX].count     = mesh.hexes.size();
+      size_t numCells = 0, numIndices = 0;
+      for (int t=0;t<numPrimTypes;t++) {
+        cells[t].firstCell  = numCells;
+        cells[t].firstIndex = numIndices;
+        numCells   += cells[t].count;
+        numIndices += cells[t].count*numVerticesOf[t];
+      }
+
+      // ------------------------------------------------------------------
+      // point data; perVertex (if any) first, as the active scalars
+      // ------------------------------------------------------------------
+      std::vector<ArraySource> pointData;
+      std::vector<Attribute::SP> attributes = mesh.attributes;
+      if (mesh.perVertex) {
+        attributes.erase(std::remove(attributes.begin(),attributes.end(),mesh.perVertex),
+                         attributes.end());
+        attributes.insert(attributes.begin(),mesh.perVertex);
+      }
+      for (auto attr : attributes) {
+        if (attr->values.size() != mesh.vertices.size())
+          throw std::runtime_error("#umesh.io: vertex attribute '"+attr->name
+                                   +"' does not have one value per vertex");
+        ArraySource array;
+        array.name      = attr->name.empty() ? "scalars" : attr->name;
+        array.type      = "Float32";
+        array.numValues = attr->values.size();
+        const float *values = attr->values.data();
+        array.fill = [values](size_t begin, size_t end, uint8_t *dst){
+          memcpy(dst,values+begin,(end-begin)*sizeof(float));
+        };
+        pointData.push_back(array);
+      }
+      for (auto attr : mesh.quantizedAttributes) {
+        if (attr->size() != mesh.vertices.size())
+          throw std::runtime_error("#umesh.io: quantized attribute '"+attr->name
+                                   +"' does not have one value per vertex");
+        ArraySource array;
+        array.name      = attr->name;
+        array.type      = "Float32";
+        array.numValues = attr->size();
+        const QuantizedAttribute *q = attr.get();
+        array.fill = [q](size_t begin, size_t end, uint8_t *dst){
+          for (size_t i=begin;i<end;i++) {
+            const float value = (*q)[i];
+            memcpy(dst+(i-begin)*sizeof(float),&value,sizeof(float));
+          }
+        };
+        pointData.push_back(array);
+      }
+
+      // ------------------------------------------------------------------
+      // cell data; one array per element attribute name
+      // ------------------------------------------------------------------
+      std::vector<ArraySource> cellData;
+      std::vector<std::string> cellDataNames;
+      for (auto &attr : mesh.elementAttributes) {
+        if (attr.first >= numPrimTypes)
+          throw std::runtime_error("#umesh.io: cannot save grid attributes to a .vtu file");
+        if (attr.second->values.size() != cells[attr.first].count)
+          throw std::runtime_error("#umesh.io: element attribute '"+attr.second->name
+                                   +"' does not have one value per element");
+        if (std::find(cellDataNames.begin(),cellDataNames.end(),attr.second->name)
+            == cellDataNames.end())
+          cellDataNames.push_back(attr.second->name);
+      }
+      for (auto &name : cellDataNames) {
+        // the attribute's values for each type of cell, if it has any
+        std::array<const float *,numPrimTypes> values;
+        values.fill(nullptr);
+        for (auto &attr : mesh.elementAttributes)
+          if (attr.second->name == name)
+            values[attr.first] = attr.second->values.data();
+        ArraySource array;
+        array.name      = name.empty() ? "cellScalars" : name;
+        array.type      = "Float32";
+        array.numValues = numCells;
+        array.fill = [values,&cells](size_t begin, size_t end, uint8_t *dst){
+          for (int t=0;t<numPrimTypes;t++) {
+            const CellRange &range = cells[t];
+            const size_t lo = std::max(begin,range.firstCell);
+            const size_t hi = std::min(end,range.firstCell+range.count);
+            for (size_t i=lo;i<hi;i++) {
+              const float value = values[t] ? values[t][i-range.firstCell] : NAN;
+              memcpy(dst+(i-begin)*sizeof(float),&value,sizeof(float));
+            }
+          }
+        };
+        cellData.push_back(array);
+      }
+
+      ArraySource points;
+      points.name          = "Points";
+      points.type          = "Float32";
+      points.numComponents = 3;
+      points.numValues     = 3*mesh.vertices.size();
+      const float *coords = (const float *)mesh.vertices.data();
+      points.fill = [coords](size_t begin, size_t end, uint8_t *dst){
+        memcpy(dst,coords+begin,(end-begin)*sizeof(float));
+      };
+
+      std::vector<ArraySource> cellArrays;
+      addCellArrays(cellArrays,cells,numCells,numIndices);
+
+      // ------------------------------------------------------------------
+      // the xml header, with placeholders for where each array's data
+      // will be (these can only be known once the - possibly
+      // compressed - data for all previous arrays has been written)
+      // ------------------------------------------------------------------
+      profile::ScopedTimer timer("io.saveVTU",0,numCells);
+      std::ofstream out(fileName,std::ios::binary);
+      if (!out.good())
+        throw std::runtime_error("#umesh.io: could not open '"+fileName+"' for writing");
+
+      std::vector<const ArraySource *> allArrays;
+      std::vector<std::streampos>      offsetPos;
+      static const int offsetWidth = 20;
+      auto writeDataArray = [&](const ArraySource &array, const char *indent){
+        out << indent << "<DataArray type=\"" << array.type << "\" Name=\""
+            << escape(array.name) << "\"";
+        if (array.numComponents != 1)
+          out << " NumberOfComponents=\"" << array.numComponents << "\"";
+        out << " format=\"appended\" offset=\"";
+        offsetPos.push_back(out.tellp());
+        out << std::string(offsetWidth,' ') << "\"/>\n";
+        allArrays.push_back(&array);
+      };
+      
+      out << "<?xml version=\"1.0\"?>\n"
+          << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\""
+          << " byte_order=\"LittleEndian\" header_type=\"UInt64\"";
+      if (options.compress)
+        out << " compressor=\"vtkZLibDataCompressor\"";
+      out << ">\n"
+          << "  <UnstructuredGrid>\n"
+          << "    <Piece NumberOfPoints=\"" << mesh.vertices.size()
+          << "\" NumberOfCells=\"" << numCells << "\">\n";
+      out << "      <PointData";
+      if (!pointData.empty())
+        out << " Scalars=\"" << escape(pointData[0].name) << "\"";
+      out << ">\n";
+      for (auto &array : pointData)
+        writeDataArray(array,"        ");
+      out << "      </PointData>\n"
+          << "      <CellData>\n";
+      for (auto &array : cellData)
+        writeDataArray(array,"        ");
+      out << "      </CellData>\n"
+          << "      <Points>\n";
+      writeDataArray(points,"        ");
+      out << "      </Points>\n"
+          << "      <Cells>\n";
+      for (auto &array : cellArrays)
+        writeDataArray(array,"        ");
+      out << "      </Cells>\n"
+          << "    </Piece>\n"
+          << "  </UnstructuredGrid>\n"
+          << "  <AppendedData encoding=\"raw\">\n"
+          << "   _";
+
+      // ------------------------------------------------------------------
+      // the appended data
+      // ------------------------------------------------------------------
+      const std::streampos dataBegin = out.tellp();
+      std::vector<uint64_t> offsets;
+      for (auto array : allArrays) {
+        offsets.push_back(uint64_t(out.tellp()-dataBegin));
+#if UMESH_HAVE_ZLIB
+        if (options.compress)
+          writeCompressed(out,*array,options.compressionLevel);
+        else
+#endif
+          writeRaw(out,*array);
+        timer.addBytes(array->numValues*array->valueSize);
+      }
+      out << "\n  </AppendedData>\n"
+          << "</VTKFile>\n";
+      for (size_t i=0;i<offsets.size();i++) {
+        std::string offset = std::to_string(offsets[i]);
+        offset = std::string(offsetWidth-offset.size(),' ')+offset;
+        out.seekp(offsetPos[i]);
+        out.write(offset.data(),offset.size());
+      }
+      out.close();
+      if (out.fail())
+        throw std::runtime_error("#umesh.io: error writing to '"+fileName+"'");
+    }
+
+    UMesh::SP loadVTU(const std::string &fileName)
+    {
+      MappedFile::SP file = MappedFile::open(fileName);
+      profile::ScopedTimer timer("io.loadVTU",file->size());
+      
+      // ------------------------------------------------------------------
+      // parse the xml header, up to the start of the appended data
+      // ------------------------------------------------------------------
+      AppendedData appended{file};
+      const char *ptr = (const char *)file->data();
+      const char *end = ptr+file->size();
+      size_t numPoints = 0, numCells = 0;
+      int numPieces = 0;
+      std::string section, activeScalars;
+      std::vector<ArrayInfo> pointData, cellData;
+      std::map<std::string,ArrayInfo> cellArrays;
+      ArrayInfo points;
+      bool havePoints = false, haveAppendedData = false;
+      XmlTag tag;
+      while (!haveAppendedData && nextTag(ptr,end,tag)) {
+        if (tag.isEnd) {
+          if (tag.name == section) section = "";
+          continue;
+        }
+        if (tag.name == "VTKFile") {
+          if (tag.get("type") != "UnstructuredGrid")
+            throw std::runtime_error("#umesh.io: '"+fileName+"' is not an unstructured grid");
+          if (tag.get("byte_order","LittleEndian") != "LittleEndian")
+            throw std::runtime_error("#umesh.io: '"+fileName+"' is big-endian");
+          appended.headerIs64Bit = (tag.get("header_type","UInt32") == "UInt64");
+          const std::string compressor = tag.get("compressor");
+          if (compressor == "vtkZLibDataCompressor")
+            appended.zlib = true;
+          else if (compressor != "")
+            throw std::runtime_error("#umesh.io: '"+fileName+"' uses unsupported compressor '"
+                                     +compressor+"'");
+        } else if (tag.name == "Piece") {
+          numPieces++;
+          numPoints = std::stoull(tag.get("NumberOfPoints","0"));
+          numCells  = std::stoull(tag.get("NumberOfCells","0"));
+        } else if (tag.name == "PointData" || tag.name == "CellData" ||
+                   tag.name == "Points" || tag.name == "Cells") {
+          section = tag.name;
+          if (tag.name == "PointData")
+            activeScalars = tag.get("Scalars");
+        } else if (tag.name == "DataArray") {
+          if (tag.get("format") != "appended")
+            throw std::runtime_error("#umesh.io: array '"+tag.get("Name")+"' in '"+fileName
+                                     +"' is not in appended format (only binary appended"
+                                     " .vtu files are supported)");
+          ArrayInfo array;
+          array.name          = tag.get("Name");
+          array.type          = tag.get("type");
+          array.numComponents = std::stoi(tag.get("NumberOfComponents","1"));
+          array.offset        = std::stoull(tag.get("offset","0"));
+          if (section == "PointData")
+            pointData.push_back(array);
+          else if (section == "CellData")
+            cellData.push_back(array);
+          else if (section == "Points") {
+            points = array;
+            havePoints = true;
+          } else if (section == "Cells")
+            cellArrays[array.name] = array;
+        } else if (tag.name == "AppendedData") {
+          if (tag.get("encoding") != "raw")
+            throw std::runtime_error("#umesh.io: '"+fileName+"' has base64-encoded data"
+                                     " (only raw appended data is supported)");
+          const char *marker = (const char *)memchr(ptr,'_',end-ptr);
+          if (!marker)
+            throw std::runtime_error("#umesh.io: '"+fileName+"' has no appended data");
+          appended.begin = marker+1-(const char *)file->data();
+          haveAppendedData = true;
+        }
+      }
+      if (!haveAppendedData)
+        throw std::runtime_error("#umesh.io: '"+fileName+"' has no appended data"
+                                 " (only binary appended .vtu files are supported)");
+      if (numPieces != 1)
+        throw std::runtime_error("#umesh.io: '"+fileName+"' has "+std::to_string(numPieces)
+                                 +" pieces (only single-piece files are supported)");
+      if (numPoints > 0 && (!havePoints || points.numComponents != 3))
+        throw std::runtime_error("#umesh.io: '"+fileName+"' has no (3D) points");
+      if (numCells > 0 && (!cellArrays.count("connectivity") ||
+                           !cellArrays.count("offsets") ||
+                           !cellArrays.count("types")))
+        throw std::runtime_error("#umesh.io: '"+fileName+"' is missing cell arrays");
+      if (numPoints > size_t(INT32_MAX))
+        throw std::runtime_error("#umesh.io: '"+fileName+"' has too many points");
+
+      UMesh::SP mesh = std::make_shared<UMesh>();
+      
+      // ------------------------------------------------------------------
+      // points and point data
+      // ------------------------------------------------------------------
+      if (numPoints > 0) {
+        std::vector<float> coords = appended.read<float>(points,3*numPoints);
+        mesh->vertices.resize(numPoints);
+        memcpy(mesh->vertices.data(),coords.data(),coords.size()*sizeof(float));
+      }
+      for (auto &array : pointData) {
+        if (array.numComponents != 1) continue;
+        Attribute::SP attr = std::make_shared<Attribute>();
+        attr->name   = array.name;
+        attr->values = appended.read<float>(array,numPoints);
+        mesh->attributes.push_back(attr);
+        if (!mesh->perVertex || array.name == activeScalars)
+          mesh->perVertex = attr;
+      }
+
+      // ------------------------------------------------------------------
+      // cells: count cells of each type per block of cells, so every
+      // block knows where its elements of each type go
+      // ------------------------------------------------------------------
+      if (numCells > 0) {
+        const std::vector<uint8_t> types
+          = appended.read<uint8_t>(cellArrays["types"],numCells);
+        const std::vector<int64_t> offsets
+          = appended.read<int64_t>(cellArrays["offsets"],numCells);
+        const size_t numIndices = offsets.back();
+        const std::vector<int64_t> connectivity
+          = appended.read<int64_t>(cellArrays["connectivity"],numIndices);
+
+        const size_t cellsPerBlock = 64*1024;
+        const size_t numBlocks = (numCells+cellsPerBlock-1)/cellsPerBlock;
+        std::vector<std::array<size_t,numPrimTypes>> blockBegin(numBlocks+1);
+        std::atomic<int> badType(-1);
+        parallel_for(numBlocks,[&](size_t block){
+            std::array<size_t,numPrimTypes> &count = blockBegin[block+1];
+            count.fill(0);
+            const size_t end = std::min((block+1)*cellsPerBlock,numCells);
+            for (size_t i=block*cellsPerBlock;i<end;i++) {
+              const int *vertexOrder;
+              const int primType = primTypeOf(types[i],vertexOrder);
+              if (primType < 0)
+                badType = types[i];
+              else
+                count[primType]++;
+            }
+          });
+        if (badType >= 0)
+          throw std::runtime_error("#umesh.io: '"+fileName+"' has cells of unsupported type "
+                                   +std::to_string(badType.load()));
+        blockBegin[0].fill(0);
+        for (size_t block=0;block<numBlocks;block++)
+          for (int t=0;t<numPrimTypes;t++)
+            blockBegin[block+1][t] += blockBegin[block][t];
+        const std::array<size_t,numPrimTypes> &numElements = blockBegin[numBlocks];
+
+        /*! calls lambda(cellID,primType,elementID,vertexOrder) for
+            every cell, in parallel */
+        auto forEachCell = [&](const auto &lambda){
+          parallel_for(numBlocks,[&](size_t block){
+              std::array<size_t,numPrimTypes> next = blockBegin[block];
+              const size_t end = std::min((block+1)*cellsPerBlock,numCells);
+              for (size_t i=block*cellsPerBlock;i<end;i++) {
+                const int *vertexOrder;
+                const int primType = primTypeOf(types[i],vertexOrder);
+                lambda(i,primType,next[primType]++,vertexOrder);
+              }
+            });
+        };
+        
+        mesh->triangles.resize(numElements[UMesh::TRI]);
+        mesh->quads.resize(numElements[UMesh::QUAD]);
+        mesh->tets.resize(numElements[UMesh::TET]);
+        mesh->pyrs.resize(numElements[UMesh::PYR]);
+        mesh->wedges.resize(numElements[UMesh::WEDGE]);
+        mesh->hexes.resize(numElements[UMesh::HEX]);
+        int *const elements[numPrimTypes] = {
+          (int *)mesh->triangles.data(), (int *)mesh->quads.data(),
+          (int *)mesh->tets.data(), (int *)mesh->pyrs.data(),
+          (int *)mesh->wedges.data(), (int *)mesh->hexes.data()
+        };
+        std::atomic<bool> badCell(false);
+        forEachCell([&](size_t cellID, int primType, size_t elementID,
+                        const int *vertexOrder){
+            const int64_t begin = cellID ? offsets[cellID-1] : 0;
+            const int numVertices = numVerticesOf[primType];
+            if (begin < 0 || offsets[cellID]-begin != numVertices ||
+                size_t(offsets[cellID]) > numIndices) {
+              badCell = true;
+              return;
+            }
+            int *element = elements[primType]+elementID*numVertices;
+            for (int i=0;i<numVertices;i++) {
+              const int64_t index = connectivity[begin+vertexOrder[i]];
+              if (index < 0 || size_t(index) >= numPoints) {
+                badCell = true;
+                return;
+              }
+              element[i] = int(index);
+            }
+          });
+        if (badCell)
+          throw std::runtime_error("#umesh.io: '"+fileName+"' has invalid cell offsets"
+                                   " or vertex indices");
+
+        // ------------------------------------------------------------------
+        // cell data, split up by element type
+        // ------------------------------------------------------------------
+        for (auto &array : cellData) {
+          if (array.numComponents != 1) continue;
+          const std::vector<float> values = appended.read<float>(array,numCells);
+          std::array<Attribute::SP,numPrimTypes> attrs;
+          for (int t=0;t<numPrimTypes;t++) {
+            if (numElements[t] == 0) continue;
+            attrs[t] = std::make_shared<Attribute>();
+            attrs[t]->name = array.name;
+            attrs[t]->values.resize(numElements[t]);
+          }
+          forEachCell([&](size_t cellID, int primType, size_t elementID, const int *){
+              attrs[primType]->values[elementID] = values[cellID];
+            });
+          for (int t=0;t<numPrimTypes;t++)
+            if (attrs[t])
+              mesh->elementAttributes.push_back({(UMesh::PrimType)t,attrs[t]});
+        }
+      }
+      mesh->finalize();
+      return mesh;
+    }
+
+  } // ::umesh::io
+} // ::umesh
@@ -0,0 +1,70 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* native reading and writing of VTK's XML unstructured grid (.vtu)
+   files, without any dependency on VTK itself. Only the "binary
+   appended" flavor is supported: all arrays are stored as raw bytes
+   (optionally zlib-compressed, in independent blocks) in a single
+   <AppendedData> section after the XML header. */
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+  namespace io {
+
+    /*! how saveVTU() writes its arrays */
+    struct VTUOptions {
+      /*! zlib-compress all arrays, in blocks that get compressed in
+          parallel; only available if umesh was built with zlib
+          (UMESH_HAVE_ZLIB) */
+      bool compress         = false;
+      /*! zlib level, from 1 (fastest) to 9 (smallest) */
+      int  compressionLevel = 1;
+    };
+
+    /*! writes given mesh as a single-piece .vtu file, with triangles,
+        quads, tets, pyramids, wedges, and hexes (in that order) as
+        its cells. Vertex attributes become point data ('perVertex'
+        first, and marked as the active scalars), quantized ones get
+        written dequantized, and element attributes become cell data
+        - one array per name, with NaN for all cells whose type does
+        not have that attribute. Grids cannot be stored in a .vtu
+        file, so meshes with grids get rejected.
+
+        The connectivity, offsets, and types arrays are never built as
+        a whole: each array gets produced block by block (in
+        parallel) directly from the mesh's own arrays, and written
+        right away, so memory use stays at a few blocks beyond the
+        mesh itself */
+    void saveVTU(const std::string &fileName,
+                 const UMesh &mesh,
+                 const VTUOptions &options = VTUOptions());
+
+    /*! loads a single-piece .vtu file with binary appended data in
+        'raw' encoding (zlib-compressed or not), as written by
+        saveVTU(), or by VTK's vtkXMLUnstructuredGridWriter with
+        EncodeAppendedDataOff(). Supported cells are triangles, quads
+        and pixels, tets, pyramids, wedges, and hexes and voxels;
+        anything else throws. One-component point and cell data
+        arrays become vertex and element attributes (the active
+        scalars, or else the first point data array, becoming
+        'perVertex'); arrays with more components get ignored */
+    UMesh::SP loadVTU(const std::string &fileName);
+
+  } // ::umesh::io
+} // ::umesh
@@ -16,43 +16,130 @@
 
 #include "BTM.h"
 #include "umesh/io/IO.h"
+#include "umesh/io/ParallelIO.h"
+#include "umesh/computeNormals.h"
+#include "umesh/profile.h"
 #include <fstream>
 
 namespace umesh {
   namespace btm {
 
-    static Mesh::SP load(const std::string &fileName)
+    /*! number of vectors in a btm file */
+    const int numArrays = 6;
+    
+    /*! calls 'lambda(vec)' for each of the mesh's vectors, in the
+        order they appear in the file */
+    template<typename MeshT, typename Lambda>
+    void forEachArray(MeshT &mesh, const Lambda &lambda)
+    {
+      lambda(mesh.vertex);
+      lambda(mesh.normal);
+      lambda(mesh.color);
+      lambda(mesh.texcoord);
+      lambda(mesh.index);
+      lambda(mesh.triColor);
+    }
+
+    Mesh::SP Mesh::fromUMesh(const UMesh &surface, bool withNormals)
     {
       Mesh::SP mesh = std::make_shared<Mesh>();
-      std::ifstream in(fileName,std::ios::binary);
-      mesh->loadFrom(in);
+      mesh->vertex = surface.vertices;
+      if (withNormals)
+        mesh->normal = computeVertexNormals(surface);
+      const size_t numTris = surface.triangles.size();
+      mesh->index.resize(numTris+2*surface.quads.size());
+      parallel_for_blocked
+        (0,numTris,64*1024,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++) {
+             const Triangle &tri = surface.triangles[i];
+             mesh->index[i] = vec3i(tri.x,tri.y,tri.z);
+           }
+         });
+      parallel_for_blocked
+        (0,surface.quads.size(),64*1024,
+         [&](size_t begin, size_t end) {
+           for (size_t i=begin;i<end;i++) {
+             const Quad &quad = surface.quads[i];
+             mesh->index[numTris+2*i+0] = vec3i(quad.x,quad.y,quad.z);
+             mesh->index[numTris+2*i+1] = vec3i(quad.x,quad.z,quad.w);
+           }
+         });
+      return mesh;
+    }
+    
+    Mesh::SP Mesh::load(const std::string &fileName)
+    {
+      profile::ScopedTimer timer("btm.load");
+      io::PositionalFile::SP file = io::PositionalFile::openForReading(fileName);
+      const uint64_t fileSize = file->size();
+      timer.addBytes(fileSize);
+      Mesh::SP mesh = std::make_shared<Mesh>();
+      // each vector's size comes right before its data, so the sizes
+      // have to be read one after another; the data then all at once
+      std::vector<io::IORequest> requests;
+      uint64_t offset = 0;
+      forEachArray(*mesh,[&](auto &vec){
+          typedef typename std::decay<decltype(vec)>::type::value_type T;
+          size_t N = 0;
+          if (offset+sizeof(N) > fileSize)
+            throw std::runtime_error("#umesh.btm: '"+fileName+"' is truncated");
+          file->read(offset,&N,sizeof(N));
+          offset += sizeof(N);
+          if (N > (fileSize-offset)/sizeof(T))
+            throw std::runtime_error("#umesh.btm: '"+fileName+"' is truncated");
+          vec.resize(N);
+          requests.push_back({offset,vec.data(),N*sizeof(T)});
+          offset += N*sizeof(T);
+        });
+      io::parallelRead(*file,requests);
       return mesh;
     }
       
     void Mesh::loadFrom(std::ifstream &in)
     {
-      io::readVector(in,vertex);
-      io::readVector(in,normal);
-      io::readVector(in,color);
-      io::readVector(in,texcoord);
-      io::readVector(in,index);
-      io::readVector(in,triColor);
+      forEachArray(*this,[&](auto &vec){ io::readVector(in,vec); });
     }
-      
+
+    /*! throws if given mesh's optional arrays have the wrong size */
+    void checkSizes(const Mesh &mesh)
+    {
+      const size_t numVertices = mesh.vertex.size();
+      if ((!mesh.normal.empty()   && mesh.normal.size()   != numVertices) ||
+          (!mesh.color.empty()    && mesh.color.size()    != numVertices) ||
+          (!mesh.texcoord.empty() && mesh.texcoord.size() != numVertices))
+        throw std::runtime_error("#umesh.btm: per-vertex arrays have to be empty, "
+                                 "or have one entry per vertex");
+      if (!mesh.triColor.empty() && mesh.triColor.size() != mesh.index.size())
+        throw std::runtime_error("#umesh.btm: per-triangle colors have to be empty, "
+                                 "or have one entry per triangle");
+    }
+    
     void Mesh::save(const std::string &fileName) const
     {
-      std::ofstream out(fileName,std::ios::binary);
-      saveTo(out);
+      checkSizes(*this);
+      size_t counts[numArrays];
+      std::vector<io::IORequest> requests;
+      uint64_t offset = 0;
+      int arrayID = 0;
+      forEachArray(*this,[&](const auto &vec){
+          typedef typename std::decay<decltype(vec)>::type::value_type T;
+          counts[arrayID] = vec.size();
+          requests.push_back({offset,&counts[arrayID],sizeof(size_t)});
+          offset += sizeof(size_t);
+          requests.push_back({offset,(void *)vec.data(),vec.size()*sizeof(T)});
+          offset += vec.size()*sizeof(T);
+          ++arrayID;
+        });
+      profile::ScopedTimer timer("btm.save",offset);
+      io::PositionalFile::SP file = io::PositionalFile::openForWriting(fileName);
+      io::parallelWrite(*file,requests);
     }
       
     void Mesh::saveTo(std::ofstream &out) const
     {
-      io::writeVector(out,vertex);
-      io::writeVector(out,normal);
-      io::writeVector(out,color);
-      io::writeVector(out,texcoord);
-      io::writeVector(out,index);
-      io::writeVector(out,triColor);
+      checkSizes(*this);
+      forEachArray(*this,[&](const auto &vec){ io::writeVector(out,vec); });
     }
       
   } // ::umesh::btm
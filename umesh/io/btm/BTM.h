@@ -29,8 +29,22 @@ namespace umesh {
     struct Mesh {
       typedef std::shared_ptr<Mesh> SP;
 
+      /*! creates a btm mesh from given UMesh's vertices and surface
+          elements (volume elements get ignored), with each quad
+          split into two triangles; if 'withNormals' is set, the
+          vertices get area-weighted normals (see
+          computeVertexNormals()) */
+      static Mesh::SP fromUMesh(const UMesh &surface, bool withNormals = true);
+      
+      /*! reads given file; all arrays get read by multiple threads in
+          parallel (see io/ParallelIO.h) */
       static Mesh::SP load(const std::string &fileName);
-        
+
+      /*! writes this mesh to given file; all arrays get written by
+          multiple threads in parallel, straight from this mesh's
+          vectors (without any intermediate copies). Throws if the
+          per-vertex or per-triangle arrays do not have the right
+          sizes */
       void save(const std::string &fileName) const;
 
       /*! load tihs mesh's vectors from current positoin in given
@@ -15,85 +15,155 @@
 // ======================================================================== //
 
 #include "umesh/io/fun3dScalars.h"
+#include <cstring>
 
 namespace umesh {
   namespace io {
     namespace fun3d {
       
-      /*! class that loads a fun3d "volume_data" file */
-      struct Fun3DScalarsReader {
-
-        Fun3DScalarsReader(const std::string &fileName)
+      /*! helper that walks over the header of a mapped file */
+      struct HeaderCursor {
+        template<typename T>
+        T read()
         {
-          in.open(fileName,std::ios::binary);
-          uint32_t magicNumber = io::readElement<uint32_t>(in);
-
-          std::string versionString = io::readString(in);
+          T t;
+          memcpy(&t,file.at(offset,sizeof(T)),sizeof(T));
+          offset += sizeof(T);
+          return t;
+        }
+        std::string readString()
+        {
+          const int size = read<int>();
+          if (size < 0)
+            throw std::runtime_error("#umesh.io: invalid string in fun3d file");
+          const char *chars = (const char *)file.at(offset,size);
+          offset += size;
+          return std::string(chars,size);
+        }
+        const MappedFile &file;
+        size_t offset;
+      };
       
-          uint32_t ignore = io::readElement<uint32_t>(in);
-          numScalars = io::readElement<uint32_t>(in);
-          
-          variableNames.resize(io::readElement<uint32_t>(in));
-          for (auto &var : variableNames) 
-            var = io::readString(in);
+      ScalarsReader::ScalarsReader(const std::string &fileName)
+        : fileName(fileName),
+          file(MappedFile::open(fileName))
+      {
+        HeaderCursor in{*file,0};
+        uint32_t magicNumber = in.read<uint32_t>();
+        std::string versionString = in.readString();
+        uint32_t ignore = in.read<uint32_t>();
+        numScalars = in.read<uint32_t>();
 
-          globalVertexIDs.resize(numScalars);
-          io::readArray(in,globalVertexIDs.data(),globalVertexIDs.size());
+        variableNames.resize(in.read<uint32_t>());
+        for (auto &var : variableNames) 
+          var = in.readString();
 
-          size_t dataBegin = in.tellg();
-          for (int tsNo=0;;tsNo++) {
-            try {
-              uint32_t timeStepID = io::readElement<uint32_t>(in);
-              timeStepOffsets[timeStepID] = in.tellg();
-              in.seekg(dataBegin
-                       +tsNo*(variableNames.size()*globalVertexIDs.size()*sizeof(float)
-                              +sizeof(timeStepID)),
-                       std::ios::beg);
-            } catch (std::exception e) {
-              in.clear(in.goodbit);
-              break;
-            };
-          }
+        globalVertexIDsOffset = in.offset;
+        const size_t dataBegin = globalVertexIDsOffset + numScalars*sizeof(uint64_t);
+        /* each time step is its ID, followed by all variables'
+           scalars, interleaved */
+        const size_t timeStepSize
+          = sizeof(uint32_t) + variableNames.size()*numScalars*sizeof(float);
+        for (size_t begin = dataBegin;
+             begin+timeStepSize <= file->size();
+             begin += timeStepSize) {
+          uint32_t timeStepID;
+          memcpy(&timeStepID,file->at(begin,sizeof(timeStepID)),sizeof(timeStepID));
+          timeStepOffsets[timeStepID] = begin+sizeof(timeStepID);
         }
+      }
 
-        void readTimeStep(std::vector<float> &scalars,
-                          const std::string &desiredVariable,
-                          int desiredTimeStep)
-        {
-          scalars.resize(globalVertexIDs.size());
+      ScalarsReader::SP ScalarsReader::open(const std::string &fileName)
+      {
+        static std::mutex mutex;
+        static std::map<std::string,ScalarsReader::SP> cache;
+        std::lock_guard<std::mutex> lock(mutex);
+        ScalarsReader::SP &reader = cache[fileName];
+        if (!reader)
+          reader = std::make_shared<ScalarsReader>(fileName);
+        return reader;
+      }
       
-          /* offsets based on _blocks_ of time steps (one per variable) */
-          auto it = timeStepOffsets.find(desiredTimeStep);
-          if (it == timeStepOffsets.end())
-            throw std::runtime_error("could not find requested time step #"
-                                     +std::to_string(desiredTimeStep)+"!");
-          size_t offset = it->second;
+      int ScalarsReader::findVariable(const std::string &name) const
+      {
+        for (int varID=0;varID<(int)variableNames.size();varID++)
+          if (variableNames[varID] == name)
+            return varID;
+        throw std::runtime_error("couldn't find requested variable");
+      }
 
-          /* offsets based on which variable */
-          int varID = 0;
-          for (varID=0;;varID++) {
-            if (varID >= variableNames.size())
-              throw std::runtime_error("couldn't find requested variable");
-            if (variableNames[varID] == desiredVariable)
-              break;
-          }
-          std::vector<float> timeStepForAllVariables(scalars.size()*variableNames.size());
-          in.seekg(offset,std::ios::beg);
-          io::readArray(in,timeStepForAllVariables.data(),timeStepForAllVariables.size());
-          
-          for (int i=0;i<scalars.size();i++) {
-            scalars[i] = timeStepForAllVariables[varID+i*variableNames.size()];
-          }
-        }
+      bool ScalarsReader::hasTimeStep(int timeStep) const
+      {
+        return timeStepOffsets.find(timeStep) != timeStepOffsets.end();
+      }
 
-        size_t numScalars;
-        std::ifstream in;
-        std::vector<std::string> variableNames;
-        std::vector<uint64_t>    globalVertexIDs;
-        /*! .first is time step ID, .second is the offset in the file */
-        std::map<int,size_t>  timeStepOffsets;
-        size_t sizeOfTimeStep;
-      };
+      std::vector<int> ScalarsReader::getTimeSteps() const
+      {
+        std::vector<int> timeSteps;
+        for (auto it : timeStepOffsets)
+          timeSteps.push_back(it.first);
+        return timeSteps;
+      }
+      
+      std::vector<uint64_t> ScalarsReader::getGlobalVertexIDs() const
+      {
+        std::vector<uint64_t> globalVertexIDs(numScalars);
+        memcpy(globalVertexIDs.data(),
+               file->at(globalVertexIDsOffset,numScalars*sizeof(uint64_t)),
+               numScalars*sizeof(uint64_t));
+        return globalVertexIDs;
+      }
+
+      std::vector<float> ScalarsReader::read(const std::string &variable,
+                                             int timeStep) const
+      {
+        return read(std::vector<std::string>{variable},timeStep)[0];
+      }
+      
+      std::vector<std::vector<float>>
+      ScalarsReader::read(const std::vector<std::string> &variables,
+                          int timeStep) const
+      {
+        /* offsets based on _blocks_ of time steps (one per variable) */
+        auto it = timeStepOffsets.find(timeStep);
+        if (it == timeStepOffsets.end())
+          throw std::runtime_error("could not find requested time step #"
+                                   +std::to_string(timeStep)+"!");
+        const size_t numVariables = variableNames.size();
+        const uint8_t *timeStepData
+          = file->at(it->second,numScalars*numVariables*sizeof(float));
+
+        std::vector<int> varIDs;
+        for (auto &var : variables)
+          varIDs.push_back(findVariable(var));
+        std::vector<std::vector<float>> result(variables.size());
+        for (auto &scalars : result)
+          scalars.resize(numScalars);
+
+        /* de-interleave all requested variables in one pass, so every
+           page of this time step gets touched only once */
+        parallel_for_blocked
+          (0,numScalars,64*1024,
+           [&](size_t begin, size_t end){
+             for (size_t i=begin;i<end;i++) {
+               const uint8_t *vertexData = timeStepData+i*numVariables*sizeof(float);
+               for (size_t j=0;j<varIDs.size();j++)
+                 memcpy(&result[j][i],vertexData+varIDs[j]*sizeof(float),sizeof(float));
+             }
+           });
+        return result;
+      }
+
+      std::vector<std::vector<float>>
+      ScalarsReader::read(const std::vector<std::string> &variables,
+                          const std::vector<int> &timeSteps) const
+      {
+        std::vector<std::vector<float>> result;
+        for (auto timeStep : timeSteps)
+          for (auto &scalars : read(variables,timeStep))
+            result.push_back(std::move(scalars));
+        return result;
+      }
     
       /*! read header from fun3d data file, and reutrn info on what's
         contained */
@@ -101,11 +171,9 @@ namespace umesh {
                    std::vector<std::string> &variables,
                    std::vector<int> &timeSteps)
       {
-        Fun3DScalarsReader scalarReader(scalarsFileName);
-        variables = scalarReader.variableNames;
-        timeSteps.clear();
-        for (auto it : scalarReader.timeStepOffsets)
-          timeSteps.push_back(it.first);
+        ScalarsReader::SP reader = ScalarsReader::open(scalarsFileName);
+        variables = reader->variableNames;
+        timeSteps = reader->getTimeSteps();
       }
   
       /*! read one time step for one variable, from given file */
@@ -114,14 +182,10 @@ namespace umesh {
                                       int desiredTimeStep,
                                       std::vector<uint64_t> *globalIDs)
       {
-        Fun3DScalarsReader scalarReader(scalarsFileName);
-        std::vector<float> result;
-        scalarReader.readTimeStep(result,
-                                  desiredVariable,
-                                  desiredTimeStep);
+        ScalarsReader::SP reader = ScalarsReader::open(scalarsFileName);
         if (globalIDs)
-          *globalIDs = scalarReader.globalVertexIDs;
-        return result;
+          *globalIDs = reader->getGlobalVertexIDs();
+        return reader->read(desiredVariable,desiredTimeStep);
       }
 
     }
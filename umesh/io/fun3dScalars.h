@@ -17,12 +17,65 @@
 #pragma once
 
 #include "umesh/io/IO.h"
+#include "umesh/io/MappedFile.h"
 #include "umesh/UMesh.h"
 
 namespace umesh {
   namespace io {
     namespace fun3d {
+
+      /*! random-access reader for fun3d "volume_data" files. The file
+          gets memory-mapped, and only its (small) header - variable
+          names and time step offsets - gets parsed when opening it;
+          any number of variables and time steps can then be extracted
+          without re-opening or re-parsing the file, and without
+          reading any data other than that of the requested time
+          steps. Extracting multiple variables of the same time step
+          reads that time step's (interleaved) data only once. */
+      struct ScalarsReader {
+        typedef std::shared_ptr<ScalarsReader> SP;
+
+        /*! returns a reader for given file; readers get cached, so
+            opening the same file again does not re-parse it */
+        static ScalarsReader::SP open(const std::string &fileName);
+
+        ScalarsReader(const std::string &fileName);
+
+        /*! returns index of variable of given name; throws if the file
+            doesn't have this variable */
+        int findVariable(const std::string &name) const;
+        bool hasTimeStep(int timeStep) const;
+        std::vector<int> getTimeSteps() const;
+
+        /*! returns this file's vertex Ids that say where the scalars
+            are supposed to go in the reconstitued single mesh */
+        std::vector<uint64_t> getGlobalVertexIDs() const;
+
+        /*! extract one variable of one time step */
+        std::vector<float> read(const std::string &variable, int timeStep) const;
+        /*! extract multiple variables of one time step, in a single
+            (parallel) pass over that time step's data; result[i] is
+            the i'th requested variable */
+        std::vector<std::vector<float>> read(const std::vector<std::string> &variables,
+                                             int timeStep) const;
+        /*! extract multiple variables for multiple time steps;
+            result[i*variables.size()+j] is variable j of time step
+            i */
+        std::vector<std::vector<float>> read(const std::vector<std::string> &variables,
+                                             const std::vector<int> &timeSteps) const;
+        
+        const std::string        fileName;
+        /*! number of scalars (ie, vertices) per variable */
+        size_t                   numScalars = 0;
+        std::vector<std::string> variableNames;
+        /*! .first is time step ID, .second is the offset in the file */
+        std::map<int,size_t>     timeStepOffsets;
+      private:
+        MappedFile::SP file;
+        size_t         globalVertexIDsOffset = 0;
+      };
       
+
       /*! read header from fun3d data file, and reutrn info on what's
           contained */
       void getInfo(const std::string        &dataFileName,
@@ -22,6 +22,9 @@
 namespace umesh {
   namespace io {
 
+    /*! loader for "regular" (32-bit index) fun3d ugrid files; with
+        'fixNegativeVolumes', inside-out elements get flipped while
+        loading (see umesh/fixNegativeVolumes.h) */
     struct UGrid32Loader {
       
       typedef enum
@@ -33,14 +36,17 @@ namespace umesh {
       
       UGrid32Loader(const VertexFormat vertexFormat,
                     const std::string &dataFileName,
-                    const std::string &scalarFileName);
+                    const std::string &scalarFileName,
+                    bool fixNegativeVolumes = false);
 
       static UMesh::SP load(const VertexFormat vertexFormat,
                             const std::string &dataFileName,
-                            const std::string &scalarFileName="");
+                            const std::string &scalarFileName="",
+                            bool fixNegativeVolumes = false);
       static UMesh::SP load(const std::string &dataFileName,
-                            const std::string &scalarFileName="")
-      { return load(AUTO,dataFileName,scalarFileName); }
+                            const std::string &scalarFileName="",
+                            bool fixNegativeVolumes = false)
+      { return load(AUTO,dataFileName,scalarFileName,fixNegativeVolumes); }
       
       UMesh::SP result;
     };
@@ -22,13 +22,18 @@
 namespace umesh {
   namespace io {
 
-    /*! loader for the specially modified fun3d format that uses 64-bit indices */
+    /*! loader for the specially modified fun3d format that uses
+        64-bit indices; with 'fixNegativeVolumes', inside-out
+        elements get flipped while loading (see
+        umesh/fixNegativeVolumes.h) */
     struct UGrid64Loader {
       UGrid64Loader(const std::string &dataFileName,
-                    const std::string &scalarFileName);
+                    const std::string &scalarFileName,
+                    bool fixNegativeVolumes = false);
 
       static UMesh::SP load(const std::string &dataFileName,
-                            const std::string &scalarFileName="");
+                            const std::string &scalarFileName="",
+                            bool fixNegativeVolumes = false);
       
       UMesh::SP result; 
     };
@@ -0,0 +1,309 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* helpers shared by the ugrid32 and ugrid64 loaders: both formats use
+   the same layout, and only differ in the types used for vertex
+   coordinates and indices. All conversions operate directly on the
+   memory-mapped file, and run in parallel. */
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/fixNegativeVolumes.h"
+#include "umesh/profile.h"
+#include "umesh/io/MappedFile.h"
+#include <atomic>
+#include <cstring>
+
+namespace umesh {
+  namespace io {
+    namespace ugrid {
+
+      /*! number of element counts at the start of a ugrid file */
+      const int numHeaderCounts = 7;
+
+      /*! block size for the parallel conversion and compaction of
+          elements */
+      const size_t blockSize = 64*1024;
+
+      /*! reads the T at given position; ugrid files do not guarantee
+          any alignment (eg, double vertices in ugrid32 files follow
+          a 28-byte header) */
+      template<typename T>
+      inline T readUnaligned(const uint8_t *ptr)
+      {
+        T t;
+        memcpy(&t,ptr,sizeof(t));
+        return t;
+      }
+
+      /*! reads the seven element counts from the start of the file */
+      template<typename Index>
+      void readHeader(const MappedFile &file, size_t counts[numHeaderCounts])
+      {
+        const uint8_t *ptr = file.at(0,numHeaderCounts*sizeof(Index));
+        for (int i=0;i<numHeaderCounts;i++)
+          counts[i] = (size_t)readUnaligned<Index>(ptr+i*sizeof(Index));
+      }
+
+      /*! converts 'numVertices' vertices of three 'Scalar's each,
+          starting at given file offset; returns the number of
+          vertices with "degenerate" (ie, extremely large)
+          coordinates */
+      template<typename Scalar>
+      size_t convertVertices(const MappedFile &file,
+                             size_t offset,
+                             size_t numVertices,
+                             std::vector<vec3f> &vertices)
+      {
+        const uint8_t *src = file.at(offset,numVertices*3*sizeof(Scalar));
+        vertices.resize(numVertices);
+        std::atomic<size_t> numDegen(0);
+        parallel_for_blocked
+          (0,numVertices,blockSize,
+           [&](size_t begin, size_t end){
+             size_t blockDegen = 0;
+             for (size_t i=begin;i<end;i++) {
+               const uint8_t *pos = src+3*i*sizeof(Scalar);
+               const vec3f v((float)readUnaligned<Scalar>(pos+0*sizeof(Scalar)),
+                             (float)readUnaligned<Scalar>(pos+1*sizeof(Scalar)),
+                             (float)readUnaligned<Scalar>(pos+2*sizeof(Scalar)));
+               if (v.x < -1e20f || v.y < -1e20f || v.z < -1e20f ||
+                   v.x > +1e20f || v.y > +1e20f || v.z > +1e20f)
+                 blockDegen++;
+               vertices[i] = v;
+             }
+             numDegen += blockDegen;
+           });
+        return numDegen;
+      }
+
+      /*! checks if given element (with already 0-based indices) is
+          degenerate, in the same way the original (serial) loaders
+          did */
+      inline bool isDegenerate(const std::vector<vec3f> &vertices,
+                               const int index[],
+                               const int N)
+      {
+        box3f bounds;
+        for (int i=0;i<N;i++)
+          bounds.extend(vertices[index[i]]);
+        bool degen
+          =  (bounds.lower.x==bounds.upper.x)
+          || (bounds.lower.y==bounds.upper.y)
+          || (bounds.lower.z==bounds.upper.z);
+        if (N == 4 &&
+            (vertices[index[0]] == vertices[index[1]] ||
+             vertices[index[0]] == vertices[index[2]] ||
+             vertices[index[0]] == vertices[index[3]] ||
+             vertices[index[1]] == vertices[index[2]] ||
+             vertices[index[1]] == vertices[index[3]] ||
+             vertices[index[2]] == vertices[index[3]]))
+          degen = true;
+        return degen;
+      }
+
+      /*! converts 'numPrims' elements of type 'Prim' starting at given
+          file offset - each stored as Prim::numVertices 1-based
+          indices of type 'Index' - to 0-based ints, drops degenerate
+          ones, and appends the remaining ones (in original order) to
+          'prims'. 'order' (if specified) is the reordering from the
+          file's to umesh's vertex order. Runs in parallel, in two
+          passes: the first tests each block of elements and counts
+          the good ones, the second decodes the good ones again
+          (cheaper than keeping a full copy of all elements around)
+          and writes them to their final, compacted, positions. If
+          'numFlipped' is specified, inside-out elements get flipped
+          right when they get written (see fixNegativeVolumes()), and
+          counted in there. Returns number of degenerate elements */
+      template<typename Prim, typename Index>
+      size_t convertPrims(const MappedFile &file,
+                          size_t offset,
+                          size_t numPrims,
+                          const std::vector<vec3f> &vertices,
+                          std::vector<Prim> &prims,
+                          const int *order = nullptr,
+                          size_t *numFlipped = nullptr)
+      {
+        const int N = Prim::numVertices;
+        const uint8_t *src = file.at(offset,numPrims*N*sizeof(Index));
+        const size_t numBlocks = divRoundUp(numPrims,blockSize);
+        std::vector<uint8_t> isGood(numPrims);
+        std::vector<size_t>  numGoodInBlock(numBlocks+1,0);
+        std::atomic<bool>    invalidIndex(false);
+
+        /* reads the 0-based indices of given prim, returns false if any
+           of them is out of range */
+        auto decode = [&](size_t primID, int idx[]) {
+          const uint8_t *in = src+primID*N*sizeof(Index);
+          bool valid = true;
+          for (int i=0;i<N;i++) {
+            const Index fileIdx = readUnaligned<Index>(in+i*sizeof(Index));
+            valid = valid && fileIdx >= 1 && size_t(fileIdx) <= vertices.size();
+            idx[i] = int(fileIdx-1);
+          }
+          return valid;
+        };
+        
+        parallel_for(numBlocks,[&](size_t blockID){
+          const size_t begin = blockID*blockSize;
+          const size_t end   = std::min(begin+blockSize,numPrims);
+          size_t numGood = 0;
+          for (size_t primID=begin;primID<end;primID++) {
+            int idx[N];
+            if (!decode(primID,idx)) {
+              invalidIndex = true;
+              isGood[primID] = false;
+              continue;
+            }
+            isGood[primID] = !isDegenerate(vertices,idx,N);
+            numGood += isGood[primID];
+          }
+          numGoodInBlock[blockID] = numGood;
+        });
+        if (invalidIndex)
+          throw std::runtime_error("#umesh.io: invalid vertex index in ugrid file");
+
+        // exclusive prefix sum over blocks, then compact
+        size_t sum = 0;
+        for (size_t blockID=0;blockID<=numBlocks;blockID++) {
+          const size_t numGood = numGoodInBlock[blockID];
+          numGoodInBlock[blockID] = sum;
+          sum += numGood;
+        }
+        const size_t numExisting = prims.size();
+        prims.resize(numExisting+sum);
+        std::atomic<size_t> flipped(0);
+        parallel_for(numBlocks,[&](size_t blockID){
+          const size_t begin = blockID*blockSize;
+          const size_t end   = std::min(begin+blockSize,numPrims);
+          size_t out = numExisting+numGoodInBlock[blockID];
+          size_t blockFlipped = 0;
+          for (size_t primID=begin;primID<end;primID++) {
+            if (!isGood[primID]) continue;
+            int idx[N];
+            decode(primID,idx);
+            Prim &prim = prims[out++];
+            for (int i=0;i<N;i++)
+              prim[i] = idx[order ? order[i] : i];
+            if (numFlipped)
+              blockFlipped += fixNegativeVolume(vertices.data(),prim);
+          }
+          flipped += blockFlipped;
+        });
+        if (numFlipped)
+          *numFlipped = flipped;
+        return numPrims - sum;
+      }
+
+      /*! APPARENTLY, ugrid files do NOT use the VTK ordering for
+          wedges, but have front and back side swapped out */
+      const int wedgeOrder[6] = { 3,4,5, 0,1,2 };
+
+      /*! reads the 'numVertices' floats of a ugrid scalars file */
+      inline void readScalars(const std::string &scalarFileName,
+                              size_t numVertices,
+                              std::vector<float> &values)
+      {
+        MappedFile::SP scalars = MappedFile::open(scalarFileName);
+        values.resize(numVertices);
+        memcpy(values.data(),scalars->at(0,numVertices*sizeof(float)),
+               numVertices*sizeof(float));
+      }
+
+      /*! loads an entire ugrid file with given vertex-coordinate and
+          index types into given mesh, and finalizes it. If 'flipped'
+          is specified, inside-out volume elements get flipped while
+          being converted (rather than in a separate pass over the
+          loaded mesh), and get counted in there. Returns total
+          number of degenerate elements that got dropped */
+      template<typename Scalar, typename Index>
+      size_t load(UMesh::SP result,
+                  const std::string &dataFileName,
+                  const std::string &scalarFileName,
+                  NegativeVolumeCounts *flipped = nullptr)
+      {
+        profile::ScopedTimer timer("io.loadUGrid");
+        MappedFile::SP file = MappedFile::open(dataFileName);
+        timer.addBytes(file->size());
+        size_t counts[numHeaderCounts];
+        readHeader<Index>(*file,counts);
+        const size_t
+          n_verts  = counts[0],
+          n_tris   = counts[1],
+          n_quads  = counts[2],
+          n_tets   = counts[3],
+          n_pyrs   = counts[4],
+          n_prisms = counts[5],
+          n_hexes  = counts[6];
+        if (verbose) {
+          std::cout << "  expecting" << std::endl;
+          std::cout << "  num verts  " << n_verts << std::endl;
+          std::cout << "  num tris   " << n_tris << std::endl;
+          std::cout << "  num quads  " << n_quads << std::endl;
+          std::cout << "  num tets   " << n_tets << std::endl;
+          std::cout << "  num pyrs   " << n_pyrs << std::endl;
+          std::cout << "  num prisms " << n_prisms << std::endl;
+          std::cout << "  num hexes  " << n_hexes << std::endl;
+        }
+
+        size_t offset = numHeaderCounts*sizeof(Index);
+        const size_t numDegenVertices
+          = convertVertices<Scalar>(*file,offset,n_verts,result->vertices);
+        offset += n_verts*3*sizeof(Scalar);
+        if (numDegenVertices && verbose)
+          std::cout << "#umesh.io: " << prettyNumber(numDegenVertices)
+                    << " degenerate vertices" << std::endl;
+
+        if (scalarFileName != "") {
+          result->perVertex = std::make_shared<Attribute>();
+          readScalars(scalarFileName,n_verts,result->perVertex->values);
+          result->perVertex->finalize();
+        }
+
+        size_t numDegen = 0;
+        numDegen += convertPrims<Triangle,Index>(*file,offset,n_tris,
+                                                 result->vertices,result->triangles);
+        offset += n_tris*3*sizeof(Index);
+        numDegen += convertPrims<Quad,Index>(*file,offset,n_quads,
+                                             result->vertices,result->quads);
+        offset += n_quads*4*sizeof(Index);
+        // skip surface IDs
+        offset += (n_tris+n_quads)*sizeof(Index);
+        numDegen += convertPrims<Tet,Index>(*file,offset,n_tets,
+                                            result->vertices,result->tets,
+                                            nullptr,flipped ? &flipped->numTets : nullptr);
+        offset += n_tets*4*sizeof(Index);
+        numDegen += convertPrims<Pyr,Index>(*file,offset,n_pyrs,
+                                            result->vertices,result->pyrs,
+                                            nullptr,flipped ? &flipped->numPyrs : nullptr);
+        offset += n_pyrs*5*sizeof(Index);
+        numDegen += convertPrims<Wedge,Index>(*file,offset,n_prisms,
+                                              result->vertices,result->wedges,
+                                              wedgeOrder,
+                                              flipped ? &flipped->numWedges : nullptr);
+        offset += n_prisms*6*sizeof(Index);
+        numDegen += convertPrims<Hex,Index>(*file,offset,n_hexes,
+                                            result->vertices,result->hexes,
+                                            nullptr,flipped ? &flipped->numHexes : nullptr);
+
+        result->finalize();
+        return numDegen;
+      }
+
+    } // ::umesh::io::ugrid
+  } // ::umesh::io
+} // ::umesh
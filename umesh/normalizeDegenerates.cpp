@@ -0,0 +1,655 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/normalizeDegenerates.h"
+#include "umesh/forEachElement.h"
+#include "umesh/check.h"
+#include "umesh/profile.h"
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace umesh {
+
+  /*! block size for the parallel passes over all elements */
+  const size_t normalizeBlockSize = 16*1024;
+
+  /*! max number of faces of any element, after splitting its quad
+      faces (see reduceFaces()) */
+  const int maxElementFaces = 12;
+  
+  /*! a face of an element, with three or four vertex indices */
+  struct ElementFace {
+    inline bool contains(int v) const
+    {
+      for (int i=0;i<numVertices;i++)
+        if (vertex[i] == v) return true;
+      return false;
+    }
+    
+    int numVertices;
+    int vertex[4];
+  };
+
+  /*! the (inward-facing) faces of each volume element type, by
+      (VTK-order) vertex of the element; same as in FaceConn, with
+      -1 for the missing fourth vertex of triangular faces */
+  static const int tetFaces[4][4] = {
+    {1,3,2,-1},{0,2,3,-1},{0,3,1,-1},{0,1,2,-1}
+  };
+  static const int pyrFaces[5][4] = {
+    {4,1,0,-1},{4,2,1,-1},{4,3,2,-1},{4,0,3,-1},{0,1,2,3}
+  };
+  static const int wedgeFaces[5][4] = {
+    {0,2,1,-1},{3,4,5,-1},{0,3,5,2},{1,2,5,4},{0,1,4,3}
+  };
+  static const int hexFaces[6][4] = {
+    {0,1,2,3},{4,7,6,5},{0,4,5,1},{2,6,7,3},{1,5,6,2},{0,3,7,4}
+  };
+
+  template<typename Prim>
+  inline bool hasRepeatedVertex(const Prim &prim)
+  {
+    for (int i=1;i<Prim::numVertices;i++)
+      for (int j=0;j<i;j++)
+        if (prim[i] == prim[j]) return true;
+    return false;
+  }
+
+  /*! collapses runs of the same vertex in given face; returns false
+      if the face has no area left, ie, if it collapsed to a line or
+      point (this includes quads whose opposite vertices are the
+      same, which are two lines on top of each other) */
+  inline bool collapseFace(ElementFace &face)
+  {
+    int v[4];
+    int n = 0;
+    for (int i=0;i<face.numVertices;i++)
+      if (n == 0 || v[n-1] != face.vertex[i])
+        v[n++] = face.vertex[i];
+    while (n > 1 && v[0] == v[n-1]) n--;
+    if (n < 3) return false;
+    if (n == 4 && (v[0] == v[2] || v[1] == v[3])) return false;
+    face.numVertices = n;
+    for (int i=0;i<n;i++) face.vertex[i] = v[i];
+    return true;
+  }
+
+  /*! whether the two faces have the same vertices (in whatever
+      order); faces that went through collapseFace() do not have any
+      repeated vertices */
+  inline bool sameVertices(const ElementFace &a, const ElementFace &b)
+  {
+    if (a.numVertices != b.numVertices) return false;
+    for (int i=0;i<a.numVertices;i++)
+      if (!b.contains(a.vertex[i])) return false;
+    return true;
+  }
+
+  inline void addPiece(ReducedElement &reduced, UMesh::PrimType type,
+                       const int *vertex, int numVertices, int apex)
+  {
+    assert(reduced.numPieces < ReducedElement::maxPieces);
+    ReducedElement::Piece &piece = reduced.pieces[reduced.numPieces++];
+    piece.type = type;
+    for (int i=0;i<numVertices;i++) piece.vertex[i] = vertex[i];
+    if (apex >= 0) piece.vertex[numVertices] = apex;
+  }
+
+  /*! the vertex that follows 'v' in any of given quad faces, but is
+      not one of the three vertices of 'tri' - ie, the vertex at the
+      other end of the wedge's side edge through 'v'; -1 if there's
+      no (unique) such vertex */
+  inline int wedgePartner(const ElementFace *faces, int numFaces,
+                          const ElementFace &tri, int v)
+  {
+    int partner = -1;
+    for (int f=0;f<numFaces;f++) {
+      const ElementFace &face = faces[f];
+      if (face.numVertices != 4) continue;
+      for (int i=0;i<4;i++) {
+        if (face.vertex[i] != v) continue;
+        for (int other : { face.vertex[(i+1)%4], face.vertex[(i+3)%4] }) {
+          if (tri.contains(other)) continue;
+          if (partner >= 0 && partner != other) return -1;
+          partner = other;
+        }
+      }
+    }
+    return partner;
+  }
+  
+  /*! relative tolerance (wrt the product of the edges' lengths) of
+      the volume spanned by a triangle and a fourth vertex, below
+      which that vertex counts as lying in the triangle's plane */
+  const float coplanarEpsilon = 1e-5f;
+  
+  /*! whether vertex 'v' lies in the plane of triangle 'tri'; vertex
+      indices outside the vertex array count as being in the plane
+      (which is what reduceFaces() assumed before it looked at vertex
+      positions at all) */
+  inline bool inPlaneOf(const ElementFace &tri, int v,
+                        const std::vector<vec3f> &vertices)
+  {
+    for (int i : { tri.vertex[0], tri.vertex[1], tri.vertex[2], v })
+      if (i < 0 || size_t(i) >= vertices.size()) return true;
+    const vec3f a  = vertices[tri.vertex[0]];
+    const vec3f e0 = vertices[tri.vertex[1]] - a;
+    const vec3f e1 = vertices[tri.vertex[2]] - a;
+    const vec3f e2 = vertices[v] - a;
+    return fabsf(dot(cross(e0,e1),e2))
+      <= coplanarEpsilon * length(e0) * length(e1) * length(e2);
+  }
+  
+  /*! computes the reduced element from the (collapsed) faces that
+      are left of an element with repeated vertices */
+  void reduceFaces(const ElementFace *collapsed, int numCollapsed,
+                   const std::vector<vec3f> &vertices,
+                   ReducedElement &reduced)
+  {
+    reduced.numPieces = 0;
+
+    // a quad that has all three vertices of a triangle face is folded
+    // onto that triangle (eg, a pyramid whose apex collapsed onto a
+    // base vertex) if its fourth vertex lies in that triangle's
+    // plane; split it along the diagonal of that triangle, so the
+    // half that's on top of it cancels out below. If the fourth
+    // vertex is not in that plane the quad is not folded, but (being
+    // non-planar) bounds some volume together with the triangle, so
+    // split along the other diagonal, so neither half cancels out
+    ElementFace faces[maxElementFaces];
+    int numFaces = 0;
+    for (int i=0;i<numCollapsed;i++)
+      faces[numFaces++] = collapsed[i];
+    for (int t=0;t<numCollapsed;t++) {
+      const ElementFace &tri = faces[t];
+      if (tri.numVertices != 3) continue;
+      for (int q=0;q<numCollapsed;q++) {
+        ElementFace &quad = faces[q];
+        if (quad.numVertices != 4) continue;
+        int missing = -1;
+        for (int i=0;i<4;i++)
+          if (!tri.contains(quad.vertex[i]))
+            missing = (missing < 0) ? i : 4;
+        if (missing < 0 || missing == 4) continue;
+        const int v0 = quad.vertex[missing];
+        const int v1 = quad.vertex[(missing+1)%4];
+        const int v2 = quad.vertex[(missing+2)%4];
+        const int v3 = quad.vertex[(missing+3)%4];
+        if (inPlaneOf(tri,v0,vertices)) {
+          faces[numFaces++] = { 3, { v0, v1, v3 } };
+          quad = { 3, { v1, v2, v3 } };
+        } else {
+          faces[numFaces++] = { 3, { v0, v1, v2 } };
+          quad = { 3, { v0, v2, v3 } };
+        }
+      }
+    }
+
+    // remove pairs of faces that lie on top of each other; those are
+    // the flat parts of the element
+    bool removed[maxElementFaces] = {};
+    for (int i=0;i<numFaces;i++)
+      for (int j=i+1;j<numFaces && !removed[i];j++)
+        if (!removed[j] && sameVertices(faces[i],faces[j]))
+          removed[i] = removed[j] = true;
+    
+    ElementFace left[maxElementFaces];
+    int numLeft = 0;
+    int numTris = 0, numQuads = 0;
+    int vertex[8];
+    int numUnique = 0;
+    for (int i=0;i<numFaces;i++) {
+      if (removed[i]) continue;
+      const ElementFace &face = left[numLeft++] = faces[i];
+      (face.numVertices == 3 ? numTris : numQuads)++;
+      for (int j=0;j<face.numVertices;j++) {
+        bool known = false;
+        for (int k=0;k<numUnique;k++)
+          known |= (vertex[k] == face.vertex[j]);
+        if (!known && numUnique < 8) vertex[numUnique++] = face.vertex[j];
+      }
+    }
+    if (numLeft == 0 || numUnique < 4)
+      // nothing with any volume left
+      return;
+
+    if (numUnique == 4 && numTris == 4 && numQuads == 0) {
+      // a tet: any face, plus the one vertex it does not have
+      const ElementFace &face = left[0];
+      for (int k=0;k<numUnique;k++)
+        if (!face.contains(vertex[k]))
+          addPiece(reduced,UMesh::TET,face.vertex,3,vertex[k]);
+      return;
+    }
+    
+    if (numUnique == 5 && numTris == 4 && numQuads == 1) {
+      // a pyramid: the quad face, plus the one vertex it does not
+      // have - provided all triangles have that vertex
+      const ElementFace *base = nullptr;
+      for (int f=0;f<numLeft;f++)
+        if (left[f].numVertices == 4) base = &left[f];
+      int apex = -1;
+      for (int k=0;k<numUnique;k++)
+        if (!base->contains(vertex[k])) apex = vertex[k];
+      bool valid = true;
+      for (int f=0;f<numLeft;f++)
+        valid &= left[f].contains(apex);
+      if (valid) {
+        addPiece(reduced,UMesh::PYR,base->vertex,4,apex);
+        return;
+      }
+    }
+
+    if (numUnique == 6 && numTris == 2 && numQuads == 3) {
+      // a wedge: one of its triangles is (w0,w2,w1), and the quads
+      // tell which vertices of the other one go with those
+      const ElementFace *tri = nullptr, *otherTri = nullptr;
+      for (int f=0;f<numLeft;f++)
+        if (left[f].numVertices == 3)
+          (tri ? otherTri : tri) = &left[f];
+      int w[6] = { tri->vertex[0], tri->vertex[2], tri->vertex[1] };
+      bool valid = true;
+      for (int i=0;i<3;i++) {
+        w[3+i] = wedgePartner(left,numLeft,*tri,w[i]);
+        valid &= (w[3+i] >= 0) && otherTri->contains(w[3+i]);
+      }
+      valid &= (w[3] != w[4] && w[3] != w[5] && w[4] != w[5]);
+      if (valid) {
+        addPiece(reduced,UMesh::WEDGE,w,6,-1);
+        return;
+      }
+    }
+
+    // anything else (say, a hex with a single collapsed edge) does
+    // not form any of the element types, so split it into a fan
+    // around one of its vertices: each face that does not have that
+    // vertex becomes a tet (or pyramid) with that vertex as apex. The
+    // quad faces that do have the apex end up split into two
+    // triangles, so pick the vertex with the fewest quads (and, of
+    // those, the one with the most faces, for the fewest pieces) -
+    // but not one that's part of all faces, which for a twisted quad
+    // (say, one with four vertices that also form the other faces)
+    // would leave nothing
+    int apex = -1;
+    int apexQuads = 0, apexFaces = 0;
+    for (int k=0;k<numUnique;k++) {
+      int numQuadsShared = 0, numShared = 0;
+      for (int f=0;f<numLeft;f++)
+        if (left[f].contains(vertex[k])) {
+          numShared++;
+          numQuadsShared += (left[f].numVertices == 4);
+        }
+      if (numShared == numLeft) continue;
+      if (apex < 0 || numQuadsShared < apexQuads ||
+          (numQuadsShared == apexQuads && numShared > apexFaces)) {
+        apex      = vertex[k];
+        apexQuads = numQuadsShared;
+        apexFaces = numShared;
+      }
+    }
+    for (int f=0;f<numLeft;f++) {
+      const ElementFace &face = left[f];
+      if (face.contains(apex)) continue;
+      addPiece(reduced,face.numVertices == 3 ? UMesh::TET : UMesh::PYR,
+               face.vertex,face.numVertices,apex);
+    }
+  }
+
+  template<typename Prim, int numFaces>
+  bool reduceVolumeElement(const Prim &prim,
+                           const int (&faceVertices)[numFaces][4],
+                           const std::vector<vec3f> &vertices,
+                           ReducedElement &reduced)
+  {
+    if (!hasRepeatedVertex(prim)) return false;
+    
+    ElementFace faces[numFaces];
+    int numCollapsed = 0;
+    for (int f=0;f<numFaces;f++) {
+      ElementFace &face = faces[numCollapsed];
+      face.numVertices = faceVertices[f][3] < 0 ? 3 : 4;
+      for (int i=0;i<face.numVertices;i++)
+        face.vertex[i] = prim[faceVertices[f][i]];
+      if (collapseFace(face)) numCollapsed++;
+    }
+    reduceFaces(faces,numCollapsed,vertices,reduced);
+    return true;
+  }
+  
+  bool reduceDegenerate(const Triangle &tri, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced)
+  {
+    if (!hasRepeatedVertex(tri)) return false;
+    // a triangle with a repeated vertex has no area
+    reduced.numPieces = 0;
+    return true;
+  }
+  
+  bool reduceDegenerate(const Quad &quad, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced)
+  {
+    if (!hasRepeatedVertex(quad)) return false;
+    reduced.numPieces = 0;
+    ElementFace face = { 4, { quad[0], quad[1], quad[2], quad[3] } };
+    if (collapseFace(face))
+      addPiece(reduced,UMesh::TRI,face.vertex,3,-1);
+    return true;
+  }
+  
+  bool reduceDegenerate(const Tet &tet, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced)
+  { return reduceVolumeElement(tet,tetFaces,vertices,reduced); }
+  
+  bool reduceDegenerate(const Pyr &pyr, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced)
+  { return reduceVolumeElement(pyr,pyrFaces,vertices,reduced); }
+  
+  bool reduceDegenerate(const Wedge &wedge, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced)
+  { return reduceVolumeElement(wedge,wedgeFaces,vertices,reduced); }
+  
+  bool reduceDegenerate(const Hex &hex, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced)
+  { return reduceVolumeElement(hex,hexFaces,vertices,reduced); }
+
+  
+#if UMESH_ENABLE_SANITY_CHECKS
+  /*! throws unless given element (with given vertex positions)
+      reduces to at least one piece if 'hasVolume', and to nothing
+      otherwise */
+  template<typename Prim>
+  void checkReduction(const Prim &prim, const std::vector<vec3f> &vertices,
+                      bool hasVolume)
+  {
+    ReducedElement reduced;
+    if (!reduceDegenerate(prim,vertices,reduced) ||
+        (reduced.numPieces > 0) != hasVolume)
+      throw std::runtime_error("#umesh.normalizeDegenerates: sanity check failed - "
+                               "element with repeated vertices got reduced wrongly");
+  }
+
+  /*! reduces patterns whose quad faces have all vertices of a
+      triangle face: these must only get dropped if the quad is
+      folded onto that triangle (ie, is planar), and must produce
+      pieces if not */
+  void checkFoldedQuadPatterns()
+  {
+    // unit cube corners, in VTK order of a hex ...
+    const std::vector<vec3f> cube = {
+      {0,0,0},{1,0,0},{1,1,0},{0,1,0},{0,0,1},{1,0,1},{1,1,1},{0,1,1}
+    };
+    // ... and of a wedge
+    const std::vector<vec3f> prism = {
+      {0,0,0},{1,0,0},{0,1,0},{0,0,1},{1,0,1},{0,1,1}
+    };
+    const int wedgePatterns[][6] = {
+      {0,1,1,3,3,5},{0,0,2,3,4,3},{0,1,0,3,3,5},{0,0,2,3,4,4},
+      {0,1,2,3,1,1},{0,1,2,0,4,0}
+    };
+    const int hexPatterns[][8] = {
+      {0,0,2,2,4,4,4,7},{0,1,1,1,4,4,6,6},{0,1,2,3,4,1,1,1},
+      {0,0,2,3,4,4,3,3},{0,1,1,3,4,4,1,1},{0,1,2,2,4,2,2,2},
+      {0,0,0,3,4,4,6,6},{0,1,1,0,4,4,4,7},{0,0,2,3,0,0,0,7}
+    };
+    for (auto &pattern : wedgePatterns) {
+      Wedge wedge;
+      for (int i=0;i<6;i++) wedge[i] = pattern[i];
+      checkReduction(wedge,prism,true);
+    }
+    for (auto &pattern : hexPatterns) {
+      Hex hex;
+      for (int i=0;i<8;i++) hex[i] = pattern[i];
+      checkReduction(hex,cube,true);
+    }
+    // a pyramid with its apex on a base vertex is flat if (and only
+    // if) its base is planar
+    std::vector<vec3f> pyramid = {
+      {0,0,0},{1,0,0},{1,1,0},{0,1,0},{.5f,.5f,1}
+    };
+    const Pyr folded(0,1,2,3,2);
+    checkReduction(folded,pyramid,false);
+    pyramid[3].z = .5f;
+    checkReduction(folded,pyramid,true);
+  }
+#endif
+  
+  inline std::vector<Triangle> &elementsOf(UMesh &mesh, const Triangle *)
+  { return mesh.triangles; }
+  inline std::vector<Quad> &elementsOf(UMesh &mesh, const Quad *)
+  { return mesh.quads; }
+  inline std::vector<Tet> &elementsOf(UMesh &mesh, const Tet *)
+  { return mesh.tets; }
+  inline std::vector<Pyr> &elementsOf(UMesh &mesh, const Pyr *)
+  { return mesh.pyrs; }
+  inline std::vector<Wedge> &elementsOf(UMesh &mesh, const Wedge *)
+  { return mesh.wedges; }
+  inline std::vector<Hex> &elementsOf(UMesh &mesh, const Hex *)
+  { return mesh.hexes; }
+
+  template<typename Prim>
+  inline void setPiece(Prim &prim, const ReducedElement::Piece &piece)
+  {
+    for (int i=0;i<Prim::numVertices;i++)
+      prim[i] = piece.vertex[i];
+  }
+  
+  /*! writes given piece into position 'pos' of the array of its
+      type in 'mesh' */
+  inline void storePiece(UMesh &mesh, size_t pos,
+                         const ReducedElement::Piece &piece)
+  {
+    switch (piece.type) {
+    case UMesh::TRI:   setPiece(mesh.triangles[pos],piece); break;
+    case UMesh::QUAD:  setPiece(mesh.quads[pos],    piece); break;
+    case UMesh::TET:   setPiece(mesh.tets[pos],     piece); break;
+    case UMesh::PYR:   setPiece(mesh.pyrs[pos],     piece); break;
+    case UMesh::WEDGE: setPiece(mesh.wedges[pos],   piece); break;
+    case UMesh::HEX:   setPiece(mesh.hexes[pos],    piece); break;
+    default:
+      throw std::runtime_error("#umesh.normalizeDegenerates: invalid piece type");
+    };
+  }
+  
+  /*! what the elements of one block of one input array turn into */
+  struct NormalizeBlock {
+    /*! number of elements without any repeated vertices */
+    size_t numUnchanged = 0;
+    /*! number of elements of each type created for the reduced ones */
+    size_t numCreated[UMesh::HEX+1] = {};
+    size_t numReduced = 0;
+    size_t numDropped = 0;
+    /*! where this block's unchanged elements (in the array of their
+        own type), and its pieces (in the array of each type) go */
+    size_t unchangedBegin = 0;
+    size_t createdBegin[UMesh::HEX+1] = {};
+  };
+  
+  /*! replaces - in parallel - every element of given mesh that has
+      repeated vertex indices by its reduced form (see
+      reduceDegenerate()), or drops it, and compacts the element
+      arrays */
+  DegenerateElementCounts normalizeDegenerateElements(UMesh::SP mesh)
+  {
+    assert(mesh);
+#if UMESH_ENABLE_SANITY_CHECKS
+    static std::once_flag patternsChecked;
+    std::call_once(patternsChecked,checkFoldedQuadPatterns);
+#endif
+    profile::ScopedTimer timer("normalizeDegenerateElements",0,
+                               mesh->numVolumeElements()+mesh->triangles.size()+mesh->quads.size());
+    DegenerateElementCounts counts;
+    
+    // ------------------------------------------------------------------
+    // pass 1: count, per block, what its elements turn into
+    // ------------------------------------------------------------------
+    std::vector<NormalizeBlock> blocks[UMesh::HEX+1];
+    // number of pieces of type [t] created from elements of type [s]
+    size_t numCreatedFrom[UMesh::HEX+1][UMesh::HEX+1] = {};
+    forEachElementType(*mesh,[&](auto &prims, UMesh::PrimType type){
+        std::vector<NormalizeBlock> &typeBlocks = blocks[type];
+        typeBlocks.resize(divRoundUp(prims.size(),normalizeBlockSize));
+        parallel_for_blocked
+          (0,prims.size(),normalizeBlockSize,
+           [&](size_t begin, size_t end) {
+             NormalizeBlock &block = typeBlocks[begin/normalizeBlockSize];
+             ReducedElement reduced;
+             for (size_t i=begin;i<end;i++) {
+               if (!reduceDegenerate(prims[i],mesh->vertices,reduced)) {
+                 block.numUnchanged++;
+                 continue;
+               }
+               (reduced.numPieces ? block.numReduced : block.numDropped)++;
+               for (int p=0;p<reduced.numPieces;p++)
+                 block.numCreated[reduced.pieces[p].type]++;
+             }
+           });
+        for (auto &block : typeBlocks) {
+          counts.numReduced[type] += block.numReduced;
+          counts.numDropped[type] += block.numDropped;
+          for (int t=0;t<=UMesh::HEX;t++) {
+            counts.numCreated[t] += block.numCreated[t];
+            numCreatedFrom[type][t] += block.numCreated[t];
+          }
+        }
+      });
+    if (counts.total() == 0)
+      return counts;
+
+    // ------------------------------------------------------------------
+    // compute where each block's output goes: all unchanged elements
+    // first (in their old order), then the pieces, in order of the
+    // blocks they came from
+    // ------------------------------------------------------------------
+    size_t numOut[UMesh::HEX+1] = {};
+    forEachElementType(*mesh,[&](auto &prims, UMesh::PrimType type){
+        for (auto &block : blocks[type]) {
+          block.unchangedBegin = numOut[type];
+          numOut[type] += block.numUnchanged;
+        }
+      });
+    forEachElementType(*mesh,[&](auto &prims, UMesh::PrimType type){
+        for (auto &block : blocks[type])
+          for (int t=0;t<=UMesh::HEX;t++) {
+            block.createdBegin[t] = numOut[t];
+            numOut[t] += block.numCreated[t];
+          }
+      });
+
+    // ------------------------------------------------------------------
+    // pass 2: write the new element arrays, and - if there are any
+    // per-element attributes - remember where each element came from
+    // ------------------------------------------------------------------
+    UMesh normalized;
+    normalized.triangles.resize(numOut[UMesh::TRI]);
+    normalized.quads.resize(numOut[UMesh::QUAD]);
+    normalized.tets.resize(numOut[UMesh::TET]);
+    normalized.pyrs.resize(numOut[UMesh::PYR]);
+    normalized.wedges.resize(numOut[UMesh::WEDGE]);
+    normalized.hexes.resize(numOut[UMesh::HEX]);
+    const bool trackSources = !mesh->elementAttributes.empty();
+    std::vector<UMesh::PrimRef> sourceOf[UMesh::HEX+1];
+    if (trackSources)
+      for (int t=0;t<=UMesh::HEX;t++)
+        sourceOf[t].resize(numOut[t]);
+    
+    forEachElementType(*mesh,[&](auto &prims, UMesh::PrimType type){
+        auto &sameType = elementsOf(normalized,prims.data());
+        parallel_for_blocked
+          (0,prims.size(),normalizeBlockSize,
+           [&](size_t begin, size_t end) {
+             const NormalizeBlock &block = blocks[type][begin/normalizeBlockSize];
+             size_t unchanged = block.unchangedBegin;
+             size_t created[UMesh::HEX+1];
+             std::copy(block.createdBegin,block.createdBegin+UMesh::HEX+1,created);
+             ReducedElement reduced;
+             for (size_t i=begin;i<end;i++) {
+               if (!reduceDegenerate(prims[i],mesh->vertices,reduced)) {
+                 if (trackSources)
+                   sourceOf[type][unchanged] = UMesh::PrimRef(type,i);
+                 sameType[unchanged++] = prims[i];
+                 continue;
+               }
+               for (int p=0;p<reduced.numPieces;p++) {
+                 const ReducedElement::Piece &piece = reduced.pieces[p];
+                 if (trackSources)
+                   sourceOf[piece.type][created[piece.type]]
+                     = UMesh::PrimRef(type,i);
+                 storePiece(normalized,created[piece.type]++,piece);
+               }
+             }
+           });
+      });
+
+    // ------------------------------------------------------------------
+    // move per-element attributes along with their elements: for each
+    // attribute (by name), every output array that any of its
+    // elements' sources had that attribute for
+    // ------------------------------------------------------------------
+    if (trackSources) {
+      std::vector<std::pair<UMesh::PrimType,Attribute::SP>> attributes;
+      std::vector<std::string> names;
+      for (auto &typeAndAttribute : mesh->elementAttributes)
+        if (std::find(names.begin(),names.end(),
+                      typeAndAttribute.second->name) == names.end())
+          names.push_back(typeAndAttribute.second->name);
+      for (auto &name : names) {
+        Attribute::SP attributeOf[UMesh::HEX+1];
+        for (auto &typeAndAttribute : mesh->elementAttributes)
+          if (typeAndAttribute.first <= UMesh::HEX &&
+              typeAndAttribute.second->name == name)
+            attributeOf[typeAndAttribute.first] = typeAndAttribute.second;
+        for (int t=0;t<=UMesh::HEX;t++) {
+          const std::vector<UMesh::PrimRef> &sources = sourceOf[t];
+          bool used = false;
+          for (int s=0;s<=UMesh::HEX;s++)
+            used |= attributeOf[s] && (s == t || numCreatedFrom[s][t]);
+          if (!used || sources.empty()) continue;
+          Attribute::SP attribute = std::make_shared<Attribute>(sources.size());
+          attribute->name = name;
+          parallel_for_blocked
+            (0,sources.size(),normalizeBlockSize,
+             [&](size_t begin, size_t end) {
+               for (size_t i=begin;i<end;i++) {
+                 const Attribute::SP &source = attributeOf[sources[i].type];
+                 attribute->values[i]
+                   = source
+                   ? source->values[sources[i].ID]
+                   : std::numeric_limits<float>::quiet_NaN();
+               }
+             });
+          attribute->finalize();
+          attributes.push_back({(UMesh::PrimType)t,attribute});
+        }
+      }
+      // element attributes of other (ie, grid) types stay as they are
+      for (auto &typeAndAttribute : mesh->elementAttributes)
+        if (typeAndAttribute.first > UMesh::HEX)
+          attributes.push_back(typeAndAttribute);
+      mesh->elementAttributes = attributes;
+    }
+    
+    mesh->triangles.swap(normalized.triangles);
+    mesh->quads.swap(normalized.quads);
+    mesh->tets.swap(normalized.tets);
+    mesh->pyrs.swap(normalized.pyrs);
+    mesh->wedges.swap(normalized.wedges);
+    mesh->hexes.swap(normalized.hexes);
+    mesh->markDirty(UMesh::ELEMENTS_CHANGED);
+    return counts;
+  }
+  
+} // ::umesh
@@ -0,0 +1,111 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! number of elements normalizeDegenerateElements() found to have
+      repeated vertices, by (input) element type - indexed by
+      UMesh::PrimType, from TRI to HEX - and what became of them */
+  struct DegenerateElementCounts {
+    inline size_t total() const
+    {
+      size_t sum = 0;
+      for (int i=0;i<=UMesh::HEX;i++)
+        sum += numReduced[i]+numDropped[i];
+      return sum;
+    }
+    
+    /*! elements that got replaced by their reduced form ... */
+    size_t numReduced[UMesh::HEX+1] = {};
+    /*! ... elements that got dropped, because nothing with any
+        volume (or, for surface elements, area) was left of them ...  */
+    size_t numDropped[UMesh::HEX+1] = {};
+    /*! ... and elements of each type that got created for the reduced
+        ones */
+    size_t numCreated[UMesh::HEX+1] = {};
+  };
+  
+  /*! the reduced form of an element with repeated vertices: the
+      elements (of the same or lower types) that cover the same
+      region. No pieces means the element has to be dropped */
+  struct ReducedElement {
+    enum { maxPieces = 12 };
+    struct Piece {
+      UMesh::PrimType type;
+      /*! the piece's vertex indices, in VTK order of its type */
+      int             vertex[6];
+    };
+    int   numPieces = 0;
+    Piece pieces[maxPieces];
+  };
+
+  /*! computes the reduced form of given element if any of its
+      vertex indices repeats, from its pattern of unique vertices;
+      the (given mesh's) vertex positions only get looked at to tell
+      whether a quad face that has all vertices of a triangle face is
+      folded onto it. Returns false (and leaves 'reduced' untouched)
+      if the element has no repeated vertices.
+
+      The reduction collapses the repeated vertices in each face of
+      the element, drops faces that thereby collapse to lines or
+      points, splits quads that have all vertices of a triangle face
+      into two triangles (along that triangle's edge if the quad is
+      folded onto it, ie, its fourth vertex is in the triangle's
+      plane, and along the other diagonal otherwise), and removes
+      pairs of faces that end up with the same vertices (ie,
+      flat parts of the element). What's left is
+      either nothing (the element gets dropped), a proper tet,
+      pyramid, wedge (or, for surface elements, triangle), or - for
+      patterns that do not form any of those, like a hex with a
+      single collapsed edge - gets split into a fan of tets and
+      pyramids around one of its vertices. All pieces keep the
+      original element's orientation, and all faces other than those
+      of a fan's apex stay the same, so the result conforms to its
+      neighbors; quad faces that have the apex get split into two
+      triangles (the fan picks the apex with the fewest of those) */
+  bool reduceDegenerate(const Triangle &tri, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced);
+  bool reduceDegenerate(const Quad &quad, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced);
+  bool reduceDegenerate(const Tet &tet, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced);
+  bool reduceDegenerate(const Pyr &pyr, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced);
+  bool reduceDegenerate(const Wedge &wedge, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced);
+  bool reduceDegenerate(const Hex &hex, const std::vector<vec3f> &vertices,
+                        ReducedElement &reduced);
+
+  /*! replaces - in parallel - every element of given mesh that has
+      repeated vertex indices by its reduced form (see
+      reduceDegenerate()), or drops it, and compacts the element
+      arrays. Elements without repeated vertices keep their relative
+      order, and come first in each array; the pieces of reduced
+      elements get appended (in order of the elements they came
+      from, with arrays in forEachElementType() order). Per-element
+      attributes move along with their elements, and elements of
+      types that did not have a given attribute before get NaNs for
+      it. Grids and vertices are not touched (so vertices of dropped
+      elements may end up unused). The result is the same for any
+      number of threads, and the mesh does not get modified at all if
+      no element has repeated vertices */
+  DegenerateElementCounts normalizeDegenerateElements(UMesh::SP mesh);
+  
+} // ::umesh
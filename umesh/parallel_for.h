@@ -30,6 +30,8 @@
 #define UMESH_HAVE_PARALLEL_FOR 1
 #endif
 
+#include "umesh/Executor.h"
+
 namespace umesh {
 
   template<typename INDEX_T, typename TASK_T>
@@ -40,14 +42,27 @@ namespace umesh {
     }
   }
   
-#if UMESH_HAVE_TBB
+  /*! runs taskFunction(i) for all i in [0,nTasks) on the current
+      executor (see umesh/Executor.h), or - if none has been set in a
+      tbb build - directly through tbb::parallel_for. 'blockSize' only
+      applies to the latter; executors pick their own chunk sizes */
   template<typename INDEX_T, typename TASK_T>
   inline void parallel_for(INDEX_T nTasks, TASK_T&& taskFunction, size_t blockSize=1)
   {
     if (nTasks == 0) return;
-    if (nTasks == 1)
+    if (nTasks == 1) {
       taskFunction(size_t(0));
-    else if (blockSize==1) {
+      return;
+    }
+    if (Executor *executor = currentExecutor()) {
+      executor->run(size_t(nTasks),[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            taskFunction(INDEX_T(i));
+        });
+      return;
+    }
+#if UMESH_HAVE_TBB
+    if (blockSize==1) {
       tbb::parallel_for(INDEX_T(0), nTasks, std::forward<TASK_T>(taskFunction));
     } else {
       const size_t numBlocks = (nTasks+blockSize-1)/blockSize;
@@ -58,15 +73,10 @@ namespace umesh {
                                                   taskFunction(INDEX_T(i));
                                               });
     }
-  }
 #else
-#ifndef UMESH_DISABLE_TBB
-// # pragma message("(note): cmake did not find TBB, will replace all parallel_for's with serial_for's")
-#endif
-  template<typename INDEX_T, typename TASK_T>
-  inline void parallel_for(INDEX_T nTasks, TASK_T&& taskFunction, size_t blockSize=1)
-  { serial_for(nTasks,taskFunction); }
+    serial_for(nTasks,taskFunction);
 #endif
+  }
 
   template<typename TASK_T>
   void serial_for_blocked(size_t begin, size_t end, size_t blockSize,
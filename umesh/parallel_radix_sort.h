@@ -0,0 +1,147 @@
+// ======================================================================== //
+// Copyright 2018-2019 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/parallel_for.h"
+#include "umesh/ScratchArena.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace umesh {
+
+  /*! maps a float to an unsigned int whose (unsigned) order is the
+      same as the float's; -0.f and +0.f map to the same key (as they
+      compare as equal) */
+  inline uint32_t radixKey(float f)
+  {
+    if (f == 0.f) f = 0.f;
+    uint32_t bits;
+    memcpy(&bits,&f,sizeof(bits));
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+  }
+
+  /*! maps a (signed) int to an unsigned int with the same order */
+  inline uint32_t radixKey(int32_t i)
+  {
+    return uint32_t(i) ^ 0x80000000u;
+  }
+
+  /*! number of key bits that parallel_radix_sort() sorts by in each
+      pass */
+  const int radixSortDigitBits = 11;
+
+  /*! (stable) parallel LSD radix sort of 'items' by the unsigned
+      integer key (uint32_t or uint64_t) that 'getKey(item)' returns,
+      radixSortDigitBits bits at a time; digits in which all keys
+      agree get skipped, so keys that only use some of their bits are
+      cheaper to sort. Runs in time linear in the number of items,
+      but needs a temporary copy of the input. Since the sort is
+      stable, items with a key that is too wide for one integer can
+      be sorted by first sorting by the least significant part of the
+      key, then by the next, etc. Small arrays just use
+      std::stable_sort. */
+  template<typename T, typename GetKey>
+  void parallel_radix_sort(T *items, size_t numItems, const GetKey &getKey)
+  {
+    typedef typename std::decay<decltype(getKey(*items))>::type Key;
+    static_assert(std::is_integral<Key>::value && std::is_unsigned<Key>::value,
+                  "radix sort key has to be an unsigned integer");
+    const int    numBuckets = 1<<radixSortDigitBits;
+    const int    numDigits  = (8*sizeof(Key)+radixSortDigitBits-1)/radixSortDigitBits;
+    const size_t minBlockSize = 64*1024;
+    const size_t maxNumBlocks = 1024;
+
+    if (numItems < minBlockSize) {
+      std::stable_sort(items,items+numItems,[&](const T &a, const T &b)
+                       { return getKey(a) < getKey(b); });
+      return;
+    }
+
+    const size_t numBlocks = std::min(maxNumBlocks,(numItems+minBlockSize-1)/minBlockSize);
+    const size_t blockSize = (numItems+numBlocks-1)/numBlocks;
+    auto blockBegin = [&](size_t blockID) { return std::min(numItems,blockID*blockSize); };
+
+    // find the bits in which any two keys differ
+    std::vector<Key> blockDiff(numBlocks,Key(0));
+    const Key firstKey = getKey(items[0]);
+    parallel_for(numBlocks,[&](size_t blockID){
+        Key diff = 0;
+        for (size_t i=blockBegin(blockID);i<blockBegin(blockID+1);i++)
+          diff |= getKey(items[i]) ^ firstKey;
+        blockDiff[blockID] = diff;
+      });
+    Key diffBits = 0;
+    for (auto diff : blockDiff) diffBits |= diff;
+
+    /* per-block histogram of the current digit, which then gets
+       turned into the per-block output offsets (digit-major, so items
+       with the same digit stay in order) */
+    std::vector<size_t> blockCount(numBlocks*numBuckets);
+    std::unique_ptr<ScratchBuffer<T>> temp;
+    T *src = items;
+    T *dst = nullptr;
+    for (int d=0;d<numDigits;d++) {
+      const int shift = radixSortDigitBits*d;
+      // digits that all keys agree on do not change the order
+      if (((diffBits >> shift) & (numBuckets-1)) == 0)
+        continue;
+      if (!dst) {
+        temp.reset(new ScratchBuffer<T>(numItems));
+        dst = temp->data();
+      }
+
+      parallel_for(numBlocks,[&](size_t blockID){
+          size_t *count = blockCount.data()+blockID*numBuckets;
+          std::fill(count,count+numBuckets,size_t(0));
+          for (size_t i=blockBegin(blockID);i<blockBegin(blockID+1);i++)
+            count[(getKey(src[i]) >> shift) & (numBuckets-1)]++;
+        });
+
+      size_t sum = 0;
+      for (int b=0;b<numBuckets;b++)
+        for (size_t blockID=0;blockID<numBlocks;blockID++) {
+          size_t &count = blockCount[blockID*numBuckets+b];
+          const size_t c = count;
+          count = sum;
+          sum += c;
+        }
+
+      parallel_for(numBlocks,[&](size_t blockID){
+          size_t *offset = blockCount.data()+blockID*numBuckets;
+          for (size_t i=blockBegin(blockID);i<blockBegin(blockID+1);i++)
+            dst[offset[(getKey(src[i]) >> shift) & (numBuckets-1)]++] = src[i];
+        });
+      std::swap(src,dst);
+    }
+
+    if (src != items)
+      parallel_for(numBlocks,[&](size_t blockID){
+          std::copy(src+blockBegin(blockID),src+blockBegin(blockID+1),
+                    items+blockBegin(blockID));
+        });
+  }
+
+  template<typename T, typename Allocator, typename GetKey>
+  inline void parallel_radix_sort(std::vector<T,Allocator> &items, const GetKey &getKey)
+  {
+    parallel_radix_sort(items.data(),items.size(),getKey);
+  }
+
+} // ::umesh
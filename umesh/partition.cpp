@@ -0,0 +1,619 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/partition.h"
+#include "umesh/profile.h"
+#include "umesh/RemeshHelper.h"
+#include "umesh/io/IO.h"
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <limits>
+#include <mutex>
+
+namespace umesh {
+
+  /*! a prim, and its bounds - which only get computed once */
+  struct PrimInfo {
+    UMesh::PrimRef ref;
+    box3f          bounds;
+  };
+
+  /*! block size for all parallel loops over prims */
+  const size_t primBlockSize = 16*1024;
+  
+  /*! bounds and centroid bounds, for a set of prims */
+  struct PrimSetBounds {
+    void extend(const box3f &primBounds)
+    {
+      bounds.extend(primBounds);
+      centBounds.extend(primBounds.center());
+    }
+    void extend(const PrimSetBounds &other)
+    {
+      bounds.extend(other.bounds);
+      centBounds.extend(other.centBounds);
+    }
+    box3f bounds;
+    box3f centBounds;
+  };
+  
+  inline float halfArea(const box3f &box)
+  {
+    const vec3f size = box.size();
+    return size.x*size.y+size.y*size.z+size.z*size.x;
+  }
+
+  /*! number of bins along each axis; the planes between them are the
+      split candidates */
+  enum { numBins = 16 };
+
+  /*! the prim counts and bounds of the prims in each bin, for all
+      three axes */
+  struct Bins {
+    void extend(const Bins &other)
+    {
+      for (int dim=0;dim<3;dim++)
+        for (int bin=0;bin<numBins;bin++) {
+          count[dim][bin] += other.count[dim][bin];
+          bounds[dim][bin].extend(other.bounds[dim][bin]);
+        }
+    }
+    size_t count[3][numBins] = {};
+    box3f  bounds[3][numBins];
+  };
+
+  /*! maps centroids to bins, along each axis */
+  struct BinMapping {
+    BinMapping(const box3f &centBounds)
+      : lower(centBounds.lower)
+    {
+      const vec3f size = centBounds.size();
+      for (int dim=0;dim<3;dim++)
+        scale[dim] = size[dim] > 0.f ? numBins/size[dim] : 0.f;
+    }
+    inline int binOf(const vec3f &centroid, int dim) const
+    {
+      const int bin = int((centroid[dim]-lower[dim])*scale[dim]);
+      return std::min(std::max(bin,0),int(numBins)-1);
+    }
+    vec3f lower, scale;
+  };
+
+  /*! the number of bricks each half of a split brick may get split
+      into, in proportion to their number of prims */
+  void splitBudget(size_t budget, size_t numL, size_t numR, size_t childBudget[2])
+  {
+    const double fraction = numL/double(numL+numR);
+    childBudget[0] = std::min(std::max(size_t(budget*fraction+.5),size_t(1)),budget-1);
+    childBudget[1] = budget-childBudget[0];
+  }
+
+  // ==================================================================
+  // object-space partitioning
+  // ==================================================================
+
+  /*! object-space partitioning: every brick refers to a range of the
+      (shared) array of all prims; splitting a brick partitions its
+      range in place, so the prims of every brick are always
+      contiguous, and sibling bricks can be split concurrently */
+  struct ObjectSpacePartitioner {
+    struct Brick {
+      size_t numPrims() const { return end-begin; }
+    
+      size_t        begin, end;
+      PrimSetBounds bounds;
+    };
+
+    ObjectSpacePartitioner(UMesh::SP mesh, const PartitionOptions &options)
+      : options(options)
+    {
+      const std::vector<UMesh::PrimRef> primRefs = mesh->createAllPrimRefs();
+      prims.resize(primRefs.size());
+      scratch.resize(primRefs.size());
+      std::mutex mutex;
+      parallel_for_blocked
+        (0,prims.size(),primBlockSize,
+         [&](size_t begin, size_t end) {
+          PrimSetBounds blockBounds;
+          for (size_t i=begin;i<end;i++) {
+            prims[i].ref    = primRefs[i];
+            prims[i].bounds = mesh->getBounds(primRefs[i]);
+            blockBounds.extend(prims[i].bounds);
+          }
+          std::lock_guard<std::mutex> lock(mutex);
+          root.bounds.extend(blockBounds);
+        });
+      root.begin = 0;
+      root.end   = prims.size();
+    }
+
+    /*! finds the best split plane with a binned SAH: all prims get
+        binned along all three axes in a single parallel pass, and
+        the split candidates - the planes between bins - get
+        evaluated from the bins alone. Returns false if there's no
+        valid split */
+    bool findSplit(const Brick &in, int &bestDim, int &bestBin)
+    {
+      const BinMapping mapping(in.bounds.centBounds);
+      Bins bins;
+      std::mutex mutex;
+      parallel_for_blocked
+        (in.begin,in.end,primBlockSize,[&](size_t begin, size_t end){
+          Bins blockBins;
+          for (size_t i=begin;i<end;i++) {
+            const box3f &pb = prims[i].bounds;
+            const vec3f centroid = pb.center();
+            for (int dim=0;dim<3;dim++) {
+              const int bin = mapping.binOf(centroid,dim);
+              blockBins.count[dim][bin]++;
+              blockBins.bounds[dim][bin].extend(pb);
+            }
+          }
+          std::lock_guard<std::mutex> lock(mutex);
+          bins.extend(blockBins);
+        });
+
+      float bestCost = std::numeric_limits<float>::infinity();
+      bestDim = -1;
+      bestBin = -1;
+      for (int dim=0;dim<3;dim++) {
+        if (mapping.scale[dim] == 0.f) continue;
+        // sweep from the right, to get the right side of each plane
+        float  rightArea[numBins];
+        size_t rightCount[numBins];
+        box3f  rightBounds;
+        size_t count = 0;
+        for (int bin=numBins-1;bin>0;--bin) {
+          rightBounds.extend(bins.bounds[dim][bin]);
+          count += bins.count[dim][bin];
+          rightArea[bin]  = count ? halfArea(rightBounds) : 0.f;
+          rightCount[bin] = count;
+        }
+        // ... and from the left, evaluating the plane left of 'bin'
+        box3f  leftBounds;
+        size_t leftCount = 0;
+        for (int bin=1;bin<numBins;bin++) {
+          leftBounds.extend(bins.bounds[dim][bin-1]);
+          leftCount += bins.count[dim][bin-1];
+          if (leftCount == 0 || rightCount[bin] == 0) continue;
+          const float cost
+            = leftCount*halfArea(leftBounds)
+            + rightCount[bin]*rightArea[bin];
+          if (cost < bestCost) {
+            bestCost = cost;
+            bestDim  = dim;
+            bestBin  = bin;
+          }
+        }
+      }
+      return bestDim >= 0;
+    }
+
+    /*! partitions the brick's prims (in parallel, and preserving
+        their order) so that the ones left of the given plane come
+        first: counts left prims per block, does a prefix sum over
+        the blocks, then scatters to the scratch array, and copies
+        back */
+    void partition(const Brick &in, int dim, int splitBin, Brick out[2])
+    {
+      const BinMapping mapping(in.bounds.centBounds);
+      auto isLeft = [&](const PrimInfo &prim) {
+        return mapping.binOf(prim.bounds.center(),dim) < splitBin;
+      };
+      const size_t numBlocks = divRoundUp(in.numPrims(),primBlockSize);
+      std::vector<size_t> numLeftInBlock(numBlocks);
+      std::vector<PrimSetBounds> blockBounds[2] = {
+        std::vector<PrimSetBounds>(numBlocks),
+        std::vector<PrimSetBounds>(numBlocks)
+      };
+      parallel_for(numBlocks,[&](size_t blockID){
+          const size_t begin = in.begin+blockID*primBlockSize;
+          const size_t end   = std::min(begin+primBlockSize,in.end);
+          size_t numLeft = 0;
+          for (size_t i=begin;i<end;i++) {
+            const int side = isLeft(prims[i]) ? 0 : 1;
+            numLeft += (side == 0);
+            blockBounds[side][blockID].extend(prims[i].bounds);
+          }
+          numLeftInBlock[blockID] = numLeft;
+        });
+      std::vector<size_t> leftBegin(numBlocks);
+      out[0].bounds = out[1].bounds = PrimSetBounds();
+      size_t numLeft = 0;
+      for (size_t blockID=0;blockID<numBlocks;blockID++) {
+        leftBegin[blockID] = numLeft;
+        numLeft += numLeftInBlock[blockID];
+        out[0].bounds.extend(blockBounds[0][blockID]);
+        out[1].bounds.extend(blockBounds[1][blockID]);
+      }
+      parallel_for(numBlocks,[&](size_t blockID){
+          const size_t begin = in.begin+blockID*primBlockSize;
+          const size_t end   = std::min(begin+primBlockSize,in.end);
+          size_t outPos[2] = {
+            in.begin+leftBegin[blockID],
+            in.begin+numLeft+blockID*primBlockSize-leftBegin[blockID]
+          };
+          for (size_t i=begin;i<end;i++)
+            scratch[outPos[isLeft(prims[i]) ? 0 : 1]++] = prims[i];
+        });
+      parallel_for_blocked
+        (in.begin,in.end,primBlockSize,[&](size_t begin, size_t end){
+          std::copy(scratch.begin()+begin,scratch.begin()+end,
+                    prims.begin()+begin);
+        });
+
+      out[0].begin = in.begin;
+      out[0].end   = in.begin+numLeft;
+      out[1].begin = in.begin+numLeft;
+      out[1].end   = in.end;
+    }
+
+    PartitionBrick makeLeaf(const Brick &brick)
+    {
+      PartitionBrick leaf;
+      leaf.domain = leaf.bounds = brick.bounds.bounds;
+      leaf.prims.resize(brick.numPrims());
+      for (size_t i=0;i<brick.numPrims();i++)
+        leaf.prims[i] = prims[brick.begin+i].ref;
+      return leaf;
+    }
+    
+    std::vector<PartitionBrick> build(const Brick &brick, size_t budget)
+    {
+      int dim, splitBin;
+      if (budget <= 1 ||
+          brick.numPrims() < std::max(options.leafThreshold,size_t(2)) ||
+          !findSplit(brick,dim,splitBin))
+        return { makeLeaf(brick) };
+
+      Brick half[2];
+      partition(brick,dim,splitBin,half);
+      size_t childBudget[2];
+      splitBudget(budget,half[0].numPrims(),half[1].numPrims(),childBudget);
+      
+      std::vector<PartitionBrick> result[2];
+      parallel_for(2,[&](size_t side){
+          result[side] = build(half[side],childBudget[side]);
+        });
+      for (auto &leaf : result[1])
+        result[0].push_back(std::move(leaf));
+      return std::move(result[0]);
+    }
+    
+    const PartitionOptions &options;
+    std::vector<PrimInfo>   prims;
+    std::vector<PrimInfo>   scratch;
+    Brick                   root;
+  };
+
+  // ==================================================================
+  // spatial partitioning
+  // ==================================================================
+
+  /*! spatial partitioning: prims can end up in both halves of a
+      split, so every brick has its own list of prims */
+  struct SpatialPartitioner {
+    struct Brick {
+      std::vector<PrimInfo> prims;
+      box3f                 domain;
+    };
+
+    SpatialPartitioner(const PartitionOptions &options)
+      : options(options)
+    {}
+
+    /*! returns all prims of 'in' whose bounds overlap given domain,
+        in their original order, and computes their bounds */
+    static std::vector<PrimInfo> overlapping(const std::vector<PrimInfo> &in,
+                                             const box3f &domain,
+                                             box3f &bounds)
+    {
+      const size_t numBlocks = divRoundUp(in.size(),primBlockSize);
+      std::vector<size_t> blockBegin(numBlocks+1,0);
+      std::vector<box3f>  blockBounds(numBlocks);
+      parallel_for(numBlocks,[&](size_t blockID){
+          const size_t begin = blockID*primBlockSize;
+          const size_t end   = std::min(begin+primBlockSize,in.size());
+          size_t count = 0;
+          for (size_t i=begin;i<end;i++)
+            if (in[i].bounds.overlaps(domain)) {
+              ++count;
+              blockBounds[blockID].extend(in[i].bounds);
+            }
+          blockBegin[blockID+1] = count;
+        });
+      bounds = box3f();
+      for (size_t blockID=0;blockID<numBlocks;blockID++) {
+        blockBegin[blockID+1] += blockBegin[blockID];
+        bounds.extend(blockBounds[blockID]);
+      }
+      std::vector<PrimInfo> result(blockBegin[numBlocks]);
+      parallel_for(numBlocks,[&](size_t blockID){
+          const size_t begin = blockID*primBlockSize;
+          const size_t end   = std::min(begin+primBlockSize,in.size());
+          size_t out = blockBegin[blockID];
+          for (size_t i=begin;i<end;i++)
+            if (in[i].bounds.overlaps(domain))
+              result[out++] = in[i];
+        });
+      return result;
+    }
+
+    PartitionBrick makeLeaf(const Brick &brick)
+    {
+      PartitionBrick leaf;
+      leaf.domain = brick.domain;
+      leaf.prims.resize(brick.prims.size());
+      for (size_t i=0;i<brick.prims.size();i++) {
+        leaf.prims[i] = brick.prims[i].ref;
+        leaf.bounds.extend(brick.prims[i].bounds);
+      }
+      return leaf;
+    }
+    
+    /*! splits the brick's domain in the middle of its longest axis;
+        halves without any prims or with an empty domain get dropped,
+        and so do splits that don't reduce the number of prims on
+        either side (which would only ever replicate the same prims
+        over and over) */
+    std::vector<PartitionBrick> build(Brick &brick, size_t budget)
+    {
+      if (budget <= 1 ||
+          brick.prims.size() < options.leafThreshold ||
+          brick.domain.lower == brick.domain.upper)
+        return { makeLeaf(brick) };
+
+      const int dim = arg_max(brick.domain.size());
+      const float pos = brick.domain.center()[dim];
+      Brick half[2];
+      half[0].domain = half[1].domain = brick.domain;
+      half[0].domain.upper[dim] = pos;
+      half[1].domain.lower[dim] = pos;
+      std::vector<Brick*> valid;
+      for (int side=0;side<2;side++) {
+        box3f bounds;
+        half[side].prims = overlapping(brick.prims,half[side].domain,bounds);
+        half[side].domain = intersection(half[side].domain,bounds);
+        if (half[side].prims.empty() ||
+            reduce_min(half[side].domain.size()) == 0.f) {
+          std::cout << "WARNING: got invalid split, dropping!" << std::endl;
+          continue;
+        }
+        valid.push_back(&half[side]);
+      }
+      if (valid.empty() ||
+          (half[0].prims.size() == brick.prims.size() &&
+           half[1].prims.size() == brick.prims.size()))
+        return { makeLeaf(brick) };
+      brick.prims.clear();
+      brick.prims.shrink_to_fit();
+
+      if (valid.size() == 1)
+        return build(*valid[0],budget);
+      
+      size_t childBudget[2];
+      splitBudget(budget,half[0].prims.size(),half[1].prims.size(),childBudget);
+      std::vector<PartitionBrick> result[2];
+      parallel_for(2,[&](size_t side){
+          result[side] = build(half[side],childBudget[side]);
+        });
+      for (auto &leaf : result[1])
+        result[0].push_back(std::move(leaf));
+      return std::move(result[0]);
+    }
+    
+    const PartitionOptions &options;
+  };
+  
+  std::vector<PartitionBrick> partition(UMesh::SP mesh,
+                                        const PartitionOptions &options)
+  {
+    if (!mesh) throw std::runtime_error("null input mesh");
+    if (options.maxBricks < 1)
+      throw std::runtime_error("partition: max number of bricks has to be at least 1");
+    profile::ScopedTimer timer("partition",0,mesh->size());
+    
+    if (options.method == PARTITION_OBJECT_SPACE) {
+      ObjectSpacePartitioner partitioner(mesh,options);
+      return partitioner.build(partitioner.root,options.maxBricks);
+    } else {
+      SpatialPartitioner partitioner(options);
+      const std::vector<UMesh::PrimRef> primRefs = mesh->createAllPrimRefs();
+      SpatialPartitioner::Brick root;
+      root.prims.resize(primRefs.size());
+      std::mutex mutex;
+      parallel_for_blocked
+        (0,primRefs.size(),primBlockSize,
+         [&](size_t begin, size_t end) {
+          box3f blockBounds;
+          for (size_t i=begin;i<end;i++) {
+            root.prims[i].ref    = primRefs[i];
+            root.prims[i].bounds = mesh->getBounds(primRefs[i]);
+            blockBounds.extend(root.prims[i].bounds);
+          }
+          std::lock_guard<std::mutex> lock(mutex);
+          root.domain.extend(blockBounds);
+        });
+      return partitioner.build(root,options.maxBricks);
+    }
+  }
+  
+  // ==================================================================
+  // ghost layers
+  // ==================================================================
+
+  /*! whether given prim is one of the elements Adjacency knows
+      about */
+  inline bool isAdjacencyElement(const UMesh::PrimRef &pr)
+  { return pr.type >= UMesh::TET && pr.type <= UMesh::HEX; }
+  
+  std::vector<int> computeOwners(const std::vector<PartitionBrick> &bricks,
+                                 const Adjacency &adjacency)
+  {
+    const size_t numElements = adjacency.numElements();
+    std::unique_ptr<std::atomic<int>[]> owner(new std::atomic<int>[numElements]);
+    parallel_for_blocked
+      (0,numElements,primBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           owner[i] = std::numeric_limits<int>::max();
+       });
+    parallel_for(bricks.size(),[&](size_t brickID){
+        for (auto pr : bricks[brickID].prims) {
+          if (!isAdjacencyElement(pr)) continue;
+          std::atomic<int> &o = owner[adjacency.toElementID(pr)];
+          int current = o.load();
+          while ((int)brickID < current
+                 && !o.compare_exchange_weak(current,(int)brickID))
+            ;
+        }
+      });
+    std::vector<int> result(numElements);
+    parallel_for_blocked
+      (0,numElements,primBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           result[i] = (owner[i] == std::numeric_limits<int>::max()) ? -1 : owner[i].load();
+       });
+    return result;
+  }
+  
+  void addGhostLayers(std::vector<PartitionBrick> &bricks,
+                      int numRings,
+                      const Adjacency &adjacency)
+  {
+    profile::ScopedTimer timer("partition.addGhostLayers");
+    const std::vector<int> owners = computeOwners(bricks,adjacency);
+    parallel_for(bricks.size(),[&](size_t brickID){
+        PartitionBrick &brick = bricks[brickID];
+        std::set<int> neighbors;
+
+        // everything already in the brick won't become a ghost
+        std::vector<uint32_t> known;
+        for (auto pr : brick.prims)
+          if (isAdjacencyElement(pr))
+            known.push_back(adjacency.toElementID(pr));
+        std::sort(known.begin(),known.end());
+        known.erase(std::unique(known.begin(),known.end()),known.end());
+        for (auto elementID : known)
+          if (owners[elementID] != (int)brickID)
+            neighbors.insert(owners[elementID]);
+
+        brick.ghosts.clear();
+        brick.ghostOwners.clear();
+        std::vector<uint32_t> frontier = known;
+        for (int ring=0;ring<numRings && !frontier.empty();ring++) {
+          std::vector<uint32_t> candidates;
+          for (auto elementID : frontier)
+            for (auto neighborID : adjacency.neighborsOf(elementID))
+              candidates.push_back(neighborID);
+          std::sort(candidates.begin(),candidates.end());
+          candidates.erase(std::unique(candidates.begin(),candidates.end()),
+                           candidates.end());
+          std::vector<uint32_t> ghosts;
+          std::set_difference(candidates.begin(),candidates.end(),
+                              known.begin(),known.end(),
+                              std::back_inserter(ghosts));
+          for (auto elementID : ghosts) {
+            const int owner = owners[elementID];
+            brick.ghosts.push_back(adjacency.toPrimRef(elementID));
+            brick.ghostOwners.push_back(owner);
+            if (owner >= 0)
+              neighbors.insert(owner);
+          }
+          std::vector<uint32_t> merged;
+          std::merge(known.begin(),known.end(),ghosts.begin(),ghosts.end(),
+                     std::back_inserter(merged));
+          known.swap(merged);
+          frontier.swap(ghosts);
+        }
+        brick.neighbors.assign(neighbors.begin(),neighbors.end());
+      });
+
+    // a brick that has another one's prims as ghosts is a neighbor of
+    // that one, too, even if that one's ghosts do not reach back
+    std::vector<std::set<int>> symmetric(bricks.size());
+    for (size_t brickID=0;brickID<bricks.size();brickID++)
+      for (auto other : bricks[brickID].neighbors) {
+        symmetric[brickID].insert(other);
+        symmetric[other].insert((int)brickID);
+      }
+    for (size_t brickID=0;brickID<bricks.size();brickID++)
+      bricks[brickID].neighbors.assign(symmetric[brickID].begin(),
+                                       symmetric[brickID].end());
+  }
+  
+  void writeBricks(std::ostream &out,
+                   const std::vector<PartitionBrick> &bricks)
+  {
+    io::writeElement(out,bricks.size());
+    for (auto &brick : bricks) {
+      io::writeElement(out,brick.domain);
+      io::writeElement(out,brick.bounds);
+      io::writeVector(out,brick.prims);
+      io::writeVector(out,brick.ghosts);
+      io::writeVector(out,brick.ghostOwners);
+      io::writeVector(out,brick.neighbors);
+    }
+  }
+  
+  std::vector<PartitionBrick> readBricks(std::istream &in)
+  {
+    std::vector<PartitionBrick> bricks(io::readElement<size_t>(in));
+    for (auto &brick : bricks) {
+      io::readElement(in,brick.domain);
+      io::readElement(in,brick.bounds);
+      io::readVector(in,brick.prims);
+      io::readVector(in,brick.ghosts);
+      io::readVector(in,brick.ghostOwners);
+      io::readVector(in,brick.neighbors);
+    }
+    return bricks;
+  }
+  
+  const char *ownerBrickAttributeName = "ownerBrick";
+  
+  UMesh::SP extractBrick(UMesh::SP mesh,
+                         const PartitionBrick &brick,
+                         int brickID)
+  {
+    if (brick.ghosts.empty())
+      return extractPrims(mesh,brick.prims);
+
+    std::vector<UMesh::PrimRef> prims = brick.prims;
+    prims.insert(prims.end(),brick.ghosts.begin(),brick.ghosts.end());
+    UMesh::SP out = extractPrims(mesh,prims);
+
+    // extractPrims() keeps prims of the same type in the order they
+    // were given in, so each type's owners are in that order, too
+    std::vector<std::vector<float>> owners(UMesh::INVALID);
+    for (auto pr : brick.prims)
+      owners[pr.type].push_back(float(brickID));
+    for (size_t i=0;i<brick.ghosts.size();i++)
+      owners[brick.ghosts[i].type].push_back(float(brick.ghostOwners[i]));
+    for (int type=0;type<UMesh::INVALID;type++) {
+      if (type == UMesh::GRID || owners[type].empty()) continue;
+      Attribute::SP attr = std::make_shared<Attribute>();
+      attr->name   = ownerBrickAttributeName;
+      attr->values = std::move(owners[type]);
+      attr->finalize();
+      out->elementAttributes.push_back({UMesh::PrimType(type),attr});
+    }
+    return out;
+  }
+  
+} // ::umesh
@@ -0,0 +1,122 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include "umesh/Adjacency.h"
+
+namespace umesh {
+
+  /*! how a mesh gets partitioned into bricks */
+  typedef enum {
+    /*! every prim goes into exactly one brick; the bricks' bounds may
+        overlap */
+    PARTITION_OBJECT_SPACE,
+    /*! bricks have non-overlapping domains, and each prim goes into
+        every brick whose domain it overlaps (ie, prims on domain
+        boundaries get replicated) */
+    PARTITION_SPATIAL
+  } PartitionMethod;
+
+  /*! settings for partition() */
+  struct PartitionOptions {
+    PartitionMethod method = PARTITION_OBJECT_SPACE;
+    /*! max number of bricks to create */
+    size_t maxBricks = size_t(1)<<30;
+    /*! bricks with fewer prims than this don't get split any further */
+    size_t leafThreshold = 1;
+  };
+
+  /*! one brick of a partitioning */
+  struct PartitionBrick {
+    /*! for spatial partitionings, the region of space this brick is
+        responsible for (clipped to its prims' bounds); domains of
+        different bricks do not overlap. For object-space
+        partitionings, the same as 'bounds' */
+    box3f domain;
+    /*! bounds of the brick's prims */
+    box3f bounds;
+    /*! the brick's prims, in the same order as in the mesh */
+    std::vector<UMesh::PrimRef> prims;
+
+    /*! set by addGhostLayers(), empty otherwise: the brick's ghost
+        (halo) prims, which are not part of 'prims' ... */
+    std::vector<UMesh::PrimRef> ghosts;
+    /*! ... each one's owning brick ... */
+    std::vector<int>            ghostOwners;
+    /*! ... and the IDs of all other bricks that this brick shares
+        prims with, or has ghosts of (and vice versa) */
+    std::vector<int>            neighbors;
+  };
+
+  /*! partitions all prims of given mesh into bricks, by recursively
+      splitting bricks in two until either the max number of bricks is
+      reached, or bricks have fewer than 'leafThreshold' prims. Each
+      split divides its brick's share of the max number of bricks
+      among its two halves in proportion to their number of prims,
+      and both halves get split further concurrently. Object-space
+      partitioning splits bricks with a binned SAH; spatial
+      partitioning splits bricks' domains in the middle of their
+      longest axis. Bricks that cannot be split (any further) become
+      leaves, so there may be fewer bricks than requested. Bricks get
+      returned in depth-first (left to right) order */
+  std::vector<PartitionBrick> partition(UMesh::SP mesh,
+                                        const PartitionOptions &options
+                                        = PartitionOptions());
+
+  /*! the 'owner' of every volume element (by Adjacency element ID)
+      in given bricks - which for prims that are in more than one
+      brick (as in spatial partitionings) is the one with the lowest
+      ID - or -1 for elements that are not in any brick */
+  std::vector<int> computeOwners(const std::vector<PartitionBrick> &bricks,
+                                 const Adjacency &adjacency);
+
+  /*! adds a ghost layer of 'numRings' rings of volume elements to
+      each brick: the first ring are all volume prims that share a
+      face with one of the brick's own volume prims (but are not part
+      of the brick themselves), the second ring those that share a
+      face with the first ring, etc; ghosts get sorted by ring, and
+      by prim within each ring. Also fills in each ghost's owner (see
+      computeOwners()), and each brick's neighbors. Surface prims
+      never become ghosts. Bricks get processed in parallel */
+  void addGhostLayers(std::vector<PartitionBrick> &bricks,
+                      int numRings,
+                      const Adjacency &adjacency);
+
+  /*! write - binary - given bricks (including their ghosts) to
+      given stream */
+  void writeBricks(std::ostream &out,
+                   const std::vector<PartitionBrick> &bricks);
+  
+  /*! read bricks from given stream, assuming format as used by
+      writeBricks() */
+  std::vector<PartitionBrick> readBricks(std::istream &in);
+
+  /*! name of the element attribute extractBrick() tags elements
+      with their owning brick in */
+  extern const char *ownerBrickAttributeName;
+
+  /*! creates a mesh with given brick's prims; if the brick has
+      ghosts, those get added, too, and all elements get an element
+      attribute (named 'ownerBrickAttributeName') with their owning
+      brick's ID - which is 'brickID' for the brick's own prims, and
+      the ghosts' owners (or -1) for the ghosts */
+  UMesh::SP extractBrick(UMesh::SP mesh,
+                         const PartitionBrick &brick,
+                         int brickID);
+  
+} // ::umesh
@@ -0,0 +1,123 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/profile.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif
+
+namespace umesh {
+  namespace profile {
+
+    namespace detail {
+      std::atomic<bool> enabled(false);
+    }
+    
+    /*! the current sink, and whether to sample memory; shared_ptr so
+        that events that are already being emitted can finish while
+        the sink gets replaced */
+    std::shared_ptr<Sink> currentSink;
+    std::atomic<bool>     sampleMemory(false);
+    
+    void setSink(Sink sink, bool sample)
+    {
+      std::shared_ptr<Sink> newSink
+        = sink ? std::make_shared<Sink>(sink) : std::shared_ptr<Sink>();
+      sampleMemory = sample;
+      std::atomic_store(&currentSink,newSink);
+      detail::enabled = (bool)newSink;
+    }
+
+    uint64_t peakMemoryUsage()
+    {
+#ifdef _WIN32
+      return 0;
+#else
+      struct rusage usage;
+      if (getrusage(RUSAGE_SELF,&usage) != 0) return 0;
+# ifdef __APPLE__
+      return uint64_t(usage.ru_maxrss);
+# else
+      return uint64_t(usage.ru_maxrss)*1024;
+# endif
+#endif
+    }
+
+    void emit(const Event &event)
+    {
+      std::shared_ptr<Sink> sink = std::atomic_load(&currentSink);
+      if (sink) (*sink)(event);
+    }
+
+#if !UMESH_DISABLE_PROFILING
+    void ScopedTimer::finish()
+    {
+      Event event;
+      event.kind    = TIMER;
+      event.name    = name;
+      event.seconds = std::chrono::duration<double>
+        (std::chrono::steady_clock::now()-begin).count();
+      event.bytes   = bytes;
+      event.items   = items;
+      if (sampleMemory)
+        event.peakMemory = peakMemoryUsage();
+      emit(event);
+    }
+#endif
+
+    void Summary::add(const Event &event)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Totals &t = totals[event.name];
+      t.numEvents++;
+      t.seconds    += event.seconds;
+      t.bytes      += event.bytes;
+      t.items      += event.items;
+      t.peakMemory  = std::max(t.peakMemory,event.peakMemory);
+    }
+    
+    Sink Summary::sink()
+    {
+      return [this](const Event &event) { add(event); };
+    }
+
+    std::string Summary::toString() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::stringstream ss;
+      for (auto &it : totals) {
+        const Totals &t = it.second;
+        ss << std::left << std::setw(28) << it.first << std::right
+           << " #=" << std::setw(6) << t.numEvents;
+        if (t.seconds > 0.)
+          ss << " " << std::fixed << std::setprecision(4) << std::setw(10)
+             << t.seconds << "s";
+        if (t.bytes)
+          ss << " " << std::setprecision(3) << (t.bytes/1e9) << "GB";
+        if (t.items)
+          ss << " items=" << t.items;
+        if (t.peakMemory)
+          ss << " peak=" << (t.peakMemory>>20) << "MB";
+        ss << std::endl;
+      }
+      return ss.str();
+    }
+    
+  } // ::umesh::profile
+} // ::umesh
@@ -0,0 +1,161 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* lightweight instrumentation of the library's algorithms: the
+   main stages of FaceConn, iso-surface extraction, remeshing, file
+   I/O, etc, are wrapped in ScopedTimer's (and some have counters),
+   which - if a sink has been installed through setSink() - report
+   how long each stage took, and how many bytes and items it
+   processed, to that sink. Without a sink a timer costs a single
+   relaxed atomic load; building with UMESH_DISABLE_PROFILING removes
+   even that. */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace umesh {
+  namespace profile {
+
+    typedef enum { TIMER, COUNTER } EventKind;
+    
+    /*! one measurement, as passed to the sink */
+    struct Event {
+      EventKind   kind;
+      /*! name of the stage (for timers) or what got counted (for
+          counters), eg "FaceConn.sort"; always a string literal */
+      const char *name;
+      /*! wall-clock time the stage took (timers only) */
+      double      seconds    = 0.;
+      /*! number of bytes the stage processed, if known (timers only) */
+      uint64_t    bytes      = 0;
+      /*! number of items (elements, faces, ...) the stage processed;
+          or the counter's value */
+      uint64_t    items      = 0;
+      /*! peak resident memory of the process (in bytes) at the end of
+          the stage, if memory sampling is enabled (timers only) */
+      uint64_t    peakMemory = 0;
+    };
+
+    /*! receives all events; can get called concurrently from
+        different threads, so has to be thread-safe */
+    typedef std::function<void(const Event &)> Sink;
+
+    /*! installs the sink that receives all events from now on
+        (nullptr disables instrumentation again); if 'sampleMemory' is
+        set, each timer event also reports the process' peak memory
+        usage, which costs one system call per event */
+    void setSink(Sink sink, bool sampleMemory = false);
+
+    /*! peak resident memory of this process so far, in bytes (or 0 if
+        not supported on this platform) */
+    uint64_t peakMemoryUsage();
+
+    /*! sends given event to the current sink (if any) */
+    void emit(const Event &event);
+
+    namespace detail {
+      extern std::atomic<bool> enabled;
+    }
+
+    /*! whether there is a sink; if not, timers and counters do
+        nothing */
+    inline bool enabled()
+    {
+#if UMESH_DISABLE_PROFILING
+      return false;
+#else
+      return detail::enabled.load(std::memory_order_relaxed);
+#endif
+    }
+
+    /*! reports the value of given counter */
+    inline void count(const char *name, uint64_t value)
+    {
+      if (!enabled()) return;
+      Event event;
+      event.kind  = COUNTER;
+      event.name  = name;
+      event.items = value;
+      emit(event);
+    }
+
+    /*! measures the time from its construction to its destruction,
+        and then reports it (along with the bytes and items
+        processed) as an event of given name. Only checks whether
+        instrumentation is enabled at construction */
+    struct ScopedTimer {
+#if UMESH_DISABLE_PROFILING
+      inline ScopedTimer(const char *, uint64_t = 0, uint64_t = 0) {}
+      inline void addBytes(uint64_t) {}
+      inline void addItems(uint64_t) {}
+#else
+      inline ScopedTimer(const char *name, uint64_t bytes = 0, uint64_t items = 0)
+        : name(enabled() ? name : nullptr), bytes(bytes), items(items)
+      {
+        if (this->name) begin = std::chrono::steady_clock::now();
+      }
+      inline ~ScopedTimer() { if (name) finish(); }
+
+      /*! for stages that only find out how much they processed while
+          running */
+      inline void addBytes(uint64_t numBytes) { bytes += numBytes; }
+      inline void addItems(uint64_t numItems) { items += numItems; }
+      
+    private:
+      void finish();
+      
+      const char *const name;
+      uint64_t          bytes;
+      uint64_t          items;
+      std::chrono::steady_clock::time_point begin;
+#endif
+      ScopedTimer(const ScopedTimer &) = delete;
+    };
+
+    /*! a sink that sums up all events by name; eg, for printing a
+        per-stage breakdown at the end of a run */
+    struct Summary {
+      struct Totals {
+        size_t   numEvents  = 0;
+        double   seconds    = 0.;
+        uint64_t bytes      = 0;
+        uint64_t items      = 0;
+        uint64_t peakMemory = 0;
+      };
+
+      /*! adds given event to the totals for its name */
+      void add(const Event &event);
+      /*! a sink that adds all events to this summary (which has to
+          outlive the sink's use) */
+      Sink sink();
+      /*! one line per stage/counter, in alphabetical order */
+      std::string toString() const;
+
+      std::map<std::string,Totals> totals;
+    private:
+      mutable std::mutex mutex;
+    };
+    
+  } // ::umesh::profile
+} // ::umesh
@@ -0,0 +1,256 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "umesh/reorder.h"
+#include "umesh/RemeshHelper.h"
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/profile.h"
+#include <climits>
+#include <mutex>
+
+namespace umesh {
+
+  /*! number of bits per axis that positions get quantized to */
+  const int curveBits = 21;
+  
+  /*! block size for all parallel loops in reorder() */
+  const size_t reorderBlockSize = 16*1024;
+  
+  /*! spreads the lower 21 bits of 'x' such that there are two zero
+      bits between any two of them */
+  inline uint64_t spreadBits(uint64_t x)
+  {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x <<  8) & 0x100f00f00f00f00full;
+    x = (x | x <<  4) & 0x10c30c30c30c30c3ull;
+    x = (x | x <<  2) & 0x1249249249249249ull;
+    return x;
+  }
+
+  inline uint64_t mortonKey(const uint32_t q[3])
+  { return spreadBits(q[0]) | (spreadBits(q[1]) << 1) | (spreadBits(q[2]) << 2); }
+
+  /*! hilbert key of given quantized position, using Skilling's
+      ("Programming the Hilbert curve", 2004) transform from axes to
+      the transposed hilbert index, followed by interleaving its
+      bits */
+  inline uint64_t hilbertKey(const uint32_t q[3])
+  {
+    uint32_t X[3] = { q[0], q[1], q[2] };
+    const uint32_t M = 1u << (curveBits-1);
+    // inverse undo
+    for (uint32_t Q=M; Q>1; Q>>=1) {
+      const uint32_t P = Q-1;
+      for (int i=0;i<3;i++)
+        if (X[i] & Q)
+          X[0] ^= P;
+        else {
+          const uint32_t t = (X[0] ^ X[i]) & P;
+          X[0] ^= t;
+          X[i] ^= t;
+        }
+    }
+    // gray encode
+    for (int i=1;i<3;i++)
+      X[i] ^= X[i-1];
+    uint32_t t = 0;
+    for (uint32_t Q=M; Q>1; Q>>=1)
+      if (X[2] & Q) t ^= Q-1;
+    for (int i=0;i<3;i++)
+      X[i] ^= t;
+    // X[0] holds the most significant bit of each 3-bit digit
+    return spreadBits(X[2]) | (spreadBits(X[1]) << 1) | (spreadBits(X[0]) << 2);
+  }
+
+  /*! maps positions to keys along a space-filling curve through a
+      given box */
+  struct CurveKeys {
+    CurveKeys(const box3f &bounds, SpaceFillingCurve curve)
+      : lower(bounds.lower), curve(curve)
+    {
+      const float maxCoord = float((1<<curveBits)-1);
+      for (int dim=0;dim<3;dim++) {
+        const float extent = bounds.upper[dim]-bounds.lower[dim];
+        scale[dim] = (extent > 0.f) ? maxCoord/extent : 0.f;
+      }
+    }
+
+    inline uint64_t operator()(const vec3f &pos) const
+    {
+      const float maxCoord = float((1<<curveBits)-1);
+      uint32_t q[3];
+      for (int dim=0;dim<3;dim++) {
+        const float f = (pos[dim]-lower[dim])*scale[dim];
+        // (also maps NaNs to 0)
+        q[dim] = (f > 0.f) ? uint32_t(std::min(f,maxCoord)) : 0u;
+      }
+      return (curve == REORDER_MORTON) ? mortonKey(q) : hilbertKey(q);
+    }
+    
+    vec3f lower;
+    vec3f scale;
+    const SpaceFillingCurve curve;
+  };
+
+  struct KeyAndID {
+    uint64_t key;
+    uint32_t ID;
+  };
+  
+  /*! returns the IDs of 'numItems' items with keys 'getKey(i)', sorted
+      by those keys (stable) */
+  template<typename GetKey>
+  std::vector<uint32_t> sortedByKey(size_t numItems, const GetKey &getKey)
+  {
+    if (numItems > size_t(UINT_MAX))
+      throw std::runtime_error("#umesh.reorder: too many vertices or elements");
+    std::vector<KeyAndID> keys(numItems);
+    parallel_for_blocked
+      (0,numItems,reorderBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           keys[i] = { getKey(i), uint32_t(i) };
+       });
+    parallel_radix_sort(keys,[](const KeyAndID &k){ return k.key; });
+    std::vector<uint32_t> order(numItems);
+    parallel_for_blocked
+      (0,numItems,reorderBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           order[i] = keys[i].ID;
+       });
+    return order;
+  }
+
+  /*! returns the array of 'array[order[i]]'s */
+  template<typename T>
+  std::vector<T> permuted(const std::vector<T> &array,
+                          const std::vector<uint32_t> &order)
+  {
+    std::vector<T> result(order.size());
+    parallel_for_blocked
+      (0,order.size(),reorderBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           result[i] = array[order[i]];
+       });
+    return result;
+  }
+
+  /*! sorts given prims by their centroids' keys, along with all
+      element attributes of their type */
+  template<typename Prim>
+  std::vector<uint32_t> reorderPrims(UMesh &mesh,
+                                     std::vector<Prim> &prims,
+                                     UMesh::PrimType type,
+                                     const CurveKeys &curveKeys)
+  {
+    std::vector<uint32_t> order
+      = sortedByKey(prims.size(),[&](size_t primID) {
+          const Prim &prim = prims[primID];
+          vec3f centroid(0.f);
+          for (int i=0;i<Prim::numVertices;i++)
+            centroid = centroid + mesh.vertices[prim[i]];
+          return curveKeys(centroid * (1.f/Prim::numVertices));
+        });
+    prims = permuted(prims,order);
+    for (auto &attribute : mesh.elementAttributes)
+      if (attribute.first == type && attribute.second)
+        attribute.second->values = permuted(attribute.second->values,order);
+    return order;
+  }
+
+  /*! same as reorderPrims(), for the grids */
+  std::vector<uint32_t> reorderGrids(UMesh &mesh,
+                                     const CurveKeys &curveKeys)
+  {
+    std::vector<uint32_t> order
+      = sortedByKey(mesh.grids.size(),[&](size_t gridID) {
+          return curveKeys(mesh.getGridBounds(gridID).center());
+        });
+    mesh.grids = permuted(mesh.grids,order);
+    for (auto &attribute : mesh.elementAttributes)
+      if (attribute.first == UMesh::GRID && attribute.second)
+        attribute.second->values = permuted(attribute.second->values,order);
+    return order;
+  }
+  
+  void reorder(UMesh::SP mesh,
+               SpaceFillingCurve curve,
+               Reordering *permutation)
+  {
+    profile::ScopedTimer timer("reorder",0,mesh->size());
+    // bounds of _all_ vertices (the mesh's bounds might not include
+    // unused ones)
+    box3f bounds;
+    std::mutex mutex;
+    parallel_for_blocked
+      (0,mesh->vertices.size(),reorderBlockSize,
+       [&](size_t begin, size_t end) {
+         box3f blockBounds;
+         for (size_t i=begin;i<end;i++)
+           blockBounds.extend(mesh->vertices[i]);
+         std::lock_guard<std::mutex> lock(mutex);
+         bounds.extend(blockBounds);
+       });
+    for (auto &grid : mesh->grids) {
+      bounds.extend((const vec3f&)grid.domain.lower);
+      bounds.extend((const vec3f&)grid.domain.upper);
+    }
+    const CurveKeys curveKeys(bounds,curve);
+
+    // ------------------------------------------------------------------
+    // vertices first ...
+    // ------------------------------------------------------------------
+    std::vector<uint32_t> vertexOrder
+      = sortedByKey(mesh->vertices.size(),[&](size_t vertexID) {
+          return curveKeys(mesh->vertices[vertexID]);
+        });
+    std::vector<int> newID(vertexOrder.size());
+    parallel_for_blocked
+      (0,vertexOrder.size(),reorderBlockSize,
+       [&](size_t begin, size_t end) {
+         for (size_t i=begin;i<end;i++)
+           newID[vertexOrder[i]] = int(i);
+       });
+    reindexVertices(*mesh,vertexOrder,newID);
+    newID.clear();
+    newID.shrink_to_fit();
+
+    // ------------------------------------------------------------------
+    // ... then each element array, by the (re-indexed) elements'
+    // centroids
+    // ------------------------------------------------------------------
+    std::vector<uint32_t> primOrder[UMesh::INVALID];
+    primOrder[UMesh::TRI]   = reorderPrims(*mesh,mesh->triangles,UMesh::TRI,curveKeys);
+    primOrder[UMesh::QUAD]  = reorderPrims(*mesh,mesh->quads,UMesh::QUAD,curveKeys);
+    primOrder[UMesh::TET]   = reorderPrims(*mesh,mesh->tets,UMesh::TET,curveKeys);
+    primOrder[UMesh::PYR]   = reorderPrims(*mesh,mesh->pyrs,UMesh::PYR,curveKeys);
+    primOrder[UMesh::WEDGE] = reorderPrims(*mesh,mesh->wedges,UMesh::WEDGE,curveKeys);
+    primOrder[UMesh::HEX]   = reorderPrims(*mesh,mesh->hexes,UMesh::HEX,curveKeys);
+    primOrder[UMesh::GRID]  = reorderGrids(*mesh,curveKeys);
+
+    if (permutation) {
+      permutation->vertices = std::move(vertexOrder);
+      for (int type=0;type<UMesh::INVALID;type++)
+        permutation->prims[type] = std::move(primOrder[type]);
+    }
+  }
+  
+} // ::umesh
@@ -0,0 +1,62 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! the space-filling curves reorder() can sort by */
+  typedef enum {
+    /*! z-order curve; cheapest to compute */
+    REORDER_MORTON,
+    /*! hilbert curve; a bit more expensive to compute than morton
+        order, but consecutive keys are always spatial neighbors, so
+        it usually gives somewhat better locality */
+    REORDER_HILBERT
+  } SpaceFillingCurve;
+
+  /*! the permutation that reorder() applied */
+  struct Reordering {
+    /*! for each (new) vertex, the index it had before reordering */
+    std::vector<uint32_t> vertices;
+    /*! same, for the prims of each type, indexed by UMesh::PrimType */
+    std::vector<uint32_t> prims[UMesh::INVALID];
+  };
+  
+  /*! sorts the mesh's vertices, and each of its element arrays
+      (including grids), by the position of the vertices (or
+      elements' centroids, respectively) along the given
+      space-filling curve, so that vertices and elements that are
+      close in space also end up close in memory. All per-vertex and
+      per-element attributes and vertex tags get reordered along
+      with them, and all elements get re-indexed; the mesh remains
+      the same otherwise (its bounds and value ranges don't change,
+      so it does not need to be re-finalized). Anything that refers
+      to vertex or prim IDs of this mesh (eg, prim refs, or an
+      IsoSurfaceIndex) is invalid afterwards.
+
+      Positions get quantized to 21 bits per axis within the bounds
+      of all vertices; vertices and elements with the same key keep
+      their relative order. If 'permutation' is specified, it gets
+      set to the permutation that got applied. Runs in parallel */
+  void reorder(UMesh::SP mesh,
+               SpaceFillingCurve curve = REORDER_HILBERT,
+               Reordering *permutation = nullptr);
+  
+} // ::umesh
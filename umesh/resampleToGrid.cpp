@@ -0,0 +1,281 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "umesh/resampleToGrid.h"
+#include "umesh/sampleElements.h"
+#include "umesh/forEachElement.h"
+#include <cmath>
+
+namespace umesh {
+
+  /*! block size for the parallel loops over prims */
+  const size_t resampleBlockSize = 64*1024;
+
+  /*! tolerance (in units of the sample spacing) by which the range
+      of samples that may be inside an element extends beyond the
+      element's bounds */
+  const float rangeTolerance = 1e-3f;
+
+  /*! the sample positions of the target grid */
+  struct SampleGrid {
+    SampleGrid(const box3f &domain, const vec3i &dims)
+      : dims(dims)
+    {
+      for (int dim=0;dim<3;dim++) {
+        if (dims[dim] == 1) {
+          lower[dim]   = .5f*(domain.lower[dim]+domain.upper[dim]);
+          spacing[dim] = 0.f;
+        } else {
+          lower[dim]   = domain.lower[dim];
+          spacing[dim] = (domain.upper[dim]-domain.lower[dim])/(dims[dim]-1);
+        }
+      }
+    }
+
+    inline float coord(int dim, int i) const
+    { return lower[dim]+i*spacing[dim]; }
+    
+    /*! computes the (inclusive) range of sample indices along given
+        dimension whose positions are in [lo,hi] - give or take a
+        small tolerance, so samples on the boundary of the element
+        don't get lost to rounding. Returns false if the range is
+        empty */
+    inline bool range(int dim, float lo, float hi, int &begin, int &end) const
+    {
+      if (spacing[dim] == 0.f) {
+        begin = end = 0;
+        return lower[dim] >= lo && lower[dim] <= hi;
+      }
+      const float maxIndex = float(dims[dim]-1);
+      const float fBegin = ceilf ((lo-lower[dim])/spacing[dim]-rangeTolerance);
+      const float fEnd   = floorf((hi-lower[dim])/spacing[dim]+rangeTolerance);
+      if (!(fEnd >= 0.f && fBegin <= maxIndex)) return false;
+      begin = int(std::max(fBegin,0.f));
+      end   = int(std::min(fEnd,maxIndex));
+      return begin <= end;
+    }
+
+    vec3i dims;
+    vec3f lower;
+    vec3f spacing;
+  };
+
+  /*! rasterizes the part of given tet that overlaps slice 'iz' of the
+      sample grid into 'slice'. The barycentric coordinates - and the
+      scalar field - are linear within the tet, so along each row of
+      samples they're of the form 'c+d*ix': each coordinate bounds the
+      range of samples inside the tet from one side, and the samples
+      in that range get written without any further tests */
+  template<typename Scalars>
+  void rasterizeTet(float *slice, const SampleGrid &grid, int iz,
+                    const UMesh &mesh, const Scalars &scalars,
+                    const Tet &tet, const box3f &bounds)
+  {
+    const vec3f v0 = mesh.vertices[tet.x];
+    const vec3f e1 = mesh.vertices[tet.y]-v0;
+    const vec3f e2 = mesh.vertices[tet.z]-v0;
+    const vec3f e3 = mesh.vertices[tet.w]-v0;
+    const float volume = dot(e1,cross(e2,e3));
+    if (volume == 0.f) return;
+    const float rcpVolume = 1.f/volume;
+    // gradients of the barycentric coordinates, and of the field
+    vec3f g[4];
+    g[1] = cross(e2,e3)*rcpVolume;
+    g[2] = cross(e3,e1)*rcpVolume;
+    g[3] = cross(e1,e2)*rcpVolume;
+    g[0] = -(g[1]+g[2]+g[3]);
+    const float s0 = scalars[tet.x];
+    const vec3f gradient
+      = (scalars[tet.y]-s0)*g[1]
+      + (scalars[tet.z]-s0)*g[2]
+      + (scalars[tet.w]-s0)*g[3];
+    
+    int ix0, ix1, iy0, iy1;
+    if (!grid.range(0,bounds.lower.x,bounds.upper.x,ix0,ix1)) return;
+    if (!grid.range(1,bounds.lower.y,bounds.upper.y,iy0,iy1)) return;
+    const float z = grid.coord(2,iz)-v0.z;
+    for (int iy=iy0;iy<=iy1;iy++) {
+      // position of sample ix=0 of this row, relative to v0
+      const vec3f rowBegin(grid.lower.x-v0.x,grid.coord(1,iy)-v0.y,z);
+      float begin = float(ix0), end = float(ix1);
+      for (int i=0;i<4;i++) {
+        const float c = (i == 0 ? 1.f : 0.f)+dot(g[i],rowBegin);
+        const float d = g[i].x*grid.spacing.x;
+        // need c+d*ix >= -insideEpsilon
+        if (d > 0.f)
+          begin = std::max(begin,ceilf((-insideEpsilon-c)/d));
+        else if (d < 0.f)
+          end   = std::min(end,floorf((-insideEpsilon-c)/d));
+        else if (c < -insideEpsilon)
+          end   = begin-1.f;
+      }
+      if (!(begin <= end)) continue;
+      const float valueBegin = s0+dot(gradient,rowBegin);
+      const float valueStep  = gradient.x*grid.spacing.x;
+      float *row = slice+size_t(iy)*grid.dims.x;
+      for (int ix=int(begin);ix<=int(end);ix++)
+        row[ix] = valueBegin+valueStep*ix;
+    }
+  }
+
+  /*! rasterizes the part of given prim that overlaps slice 'iz' of
+      the sample grid into 'slice', testing each sample in the prim's
+      bounds individually */
+  template<typename Scalars>
+  void rasterizePerSample(float *slice, const SampleGrid &grid, int iz,
+                          const UMesh &mesh, const Scalars &scalars,
+                          const UMesh::PrimRef &prim,
+                          const box3f &bounds)
+  {
+    int ix0, ix1, iy0, iy1;
+    if (!grid.range(0,bounds.lower.x,bounds.upper.x,ix0,ix1)) return;
+    if (!grid.range(1,bounds.lower.y,bounds.upper.y,iy0,iy1)) return;
+    const float z = grid.coord(2,iz);
+    for (int iy=iy0;iy<=iy1;iy++) {
+      float *row = slice+size_t(iy)*grid.dims.x;
+      const float y = grid.coord(1,iy);
+      for (int ix=ix0;ix<=ix1;ix++) {
+        float value;
+        if (samplePrim(mesh,prim,vec3f(grid.coord(0,ix),y,z),&value,scalars))
+          row[ix] = value;
+      }
+    }
+  }
+
+  /*! does the actual resampling, with given per-vertex scalars */
+  template<typename Scalars>
+  std::vector<float> resample(UMesh::SP mesh,
+                              const Scalars &scalars,
+                              const box3f &domain,
+                              const vec3i &dims,
+                              float valueIfOutside)
+  {
+    if (dims.x <= 0 || dims.y <= 0 || dims.z <= 0)
+      throw std::runtime_error("#umesh.resampleToGrid: invalid grid dimensions");
+    
+    const SampleGrid grid(domain,dims);
+    const size_t sliceSize = size_t(dims.x)*dims.y;
+    std::vector<float> result(sliceSize*dims.z);
+    parallel_for_blocked
+      (0,result.size(),resampleBlockSize,
+       [&](size_t begin, size_t end){
+         std::fill(result.begin()+begin,result.begin()+end,valueIfOutside);
+       });
+
+    const std::vector<UMesh::PrimRef> prims = mesh->createVolumePrimRefs();
+    // bounds are in the same order as the prim refs: all elements,
+    // then grids
+    std::vector<box3f> bounds(prims.size());
+    parallelForEachElementRange
+      (*mesh,[&](const auto &elements, const ElementRange &range) {
+          for (size_t i=range.begin;i<range.end;i++)
+            bounds[range.indexOf(i)] = elementBounds(elements[i],mesh->vertices);
+        },VOLUME_ELEMENTS,resampleBlockSize);
+    const size_t gridsBegin = prims.size()-mesh->grids.size();
+    std::vector<vec2i> sliceRange(prims.size());
+    parallel_for_blocked
+      (0,prims.size(),resampleBlockSize,
+       [&](size_t begin, size_t end){
+         for (size_t i=begin;i<end;i++) {
+           if (i >= gridsBegin)
+             bounds[i] = mesh->getGridBounds(i-gridsBegin);
+           vec2i &r = sliceRange[i];
+           if (!grid.range(2,bounds[i].lower.z,bounds[i].upper.z,r.x,r.y))
+             r = vec2i(0,-1);
+         }
+       });
+
+    // bucket the prims by the slices they overlap: count per block
+    // and slice, prefix-sum, then write each block's prims in order -
+    // so each slice's prims are in mesh order
+    const size_t numBlocks = divRoundUp(prims.size(),resampleBlockSize);
+    std::vector<size_t> blockBegin((numBlocks+1)*dims.z,0);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*resampleBlockSize;
+        const size_t end   = std::min(begin+resampleBlockSize,prims.size());
+        size_t *count = &blockBegin[(blockID+1)*dims.z];
+        for (size_t i=begin;i<end;i++)
+          for (int iz=sliceRange[i].x;iz<=sliceRange[i].y;iz++)
+            count[iz]++;
+      });
+    // order is by slice first, then block
+    size_t sum = 0;
+    for (int iz=0;iz<dims.z;iz++)
+      for (size_t blockID=0;blockID<=numBlocks;blockID++) {
+        size_t &entry = blockBegin[blockID*dims.z+iz];
+        const size_t count = (blockID < numBlocks) ? blockBegin[(blockID+1)*dims.z+iz] : 0;
+        entry = sum;
+        sum += count;
+      }
+    std::vector<size_t> sliceBegin(dims.z+1);
+    for (int iz=0;iz<dims.z;iz++)
+      sliceBegin[iz] = blockBegin[iz];
+    sliceBegin[dims.z] = sum;
+    std::vector<uint32_t> slicePrims(sum);
+    parallel_for(numBlocks,[&](size_t blockID){
+        const size_t begin = blockID*resampleBlockSize;
+        const size_t end   = std::min(begin+resampleBlockSize,prims.size());
+        std::vector<size_t> out(blockBegin.begin()+blockID*dims.z,
+                                blockBegin.begin()+(blockID+1)*dims.z);
+        for (size_t i=begin;i<end;i++)
+          for (int iz=sliceRange[i].x;iz<=sliceRange[i].y;iz++)
+            slicePrims[out[iz]++] = uint32_t(i);
+      });
+
+    parallel_for(dims.z,[&](int iz){
+        float *slice = result.data()+iz*sliceSize;
+        for (size_t i=sliceBegin[iz];i<sliceBegin[iz+1];i++) {
+          const size_t primID = slicePrims[i];
+          const UMesh::PrimRef &prim = prims[primID];
+          if (prim.type == UMesh::TET)
+            rasterizeTet(slice,grid,iz,*mesh,scalars,mesh->tets[prim.ID],bounds[primID]);
+          else
+            rasterizePerSample(slice,grid,iz,*mesh,scalars,prim,bounds[primID]);
+        }
+      });
+    return result;
+  }
+
+  /*! whether given mesh has any unstructured volume elements */
+  inline bool hasUnstructuredElements(const UMesh &mesh)
+  {
+    return !(mesh.tets.empty() && mesh.pyrs.empty() &&
+             mesh.wedges.empty() && mesh.hexes.empty());
+  }
+  
+  std::vector<float> resampleToGrid(UMesh::SP mesh,
+                                    const box3f &domain,
+                                    const vec3i &dims,
+                                    float valueIfOutside)
+  {
+    if (!mesh->perVertex && hasUnstructuredElements(*mesh))
+      throw std::runtime_error("#umesh.resampleToGrid: mesh does not have per-vertex scalars");
+    return resample(mesh,FloatScalars(*mesh),domain,dims,valueIfOutside);
+  }
+  
+  std::vector<float> resampleToGrid(UMesh::SP mesh,
+                                    const QuantizedAttribute &scalars,
+                                    const box3f &domain,
+                                    const vec3i &dims,
+                                    float valueIfOutside)
+  {
+    if (scalars.size() != mesh->vertices.size() && hasUnstructuredElements(*mesh))
+      throw std::runtime_error("#umesh.resampleToGrid: quantized scalars do not have one "
+                               "value per vertex");
+    return resample(mesh,scalars,domain,dims,valueIfOutside);
+  }
+
+} // ::umesh
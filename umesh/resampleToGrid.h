@@ -0,0 +1,56 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "umesh/UMesh.h"
+
+namespace umesh {
+
+  /*! samples the scalar field of given mesh - ie, the per-vertex
+      scalars in unstructured elements, and the grid scalars in grids
+      - at the dims.x*dims.y*dims.z vertices of a regular grid that
+      spans 'domain', with the outermost samples exactly on the
+      domain's faces (the same way rawToGrids interprets a raw
+      volume; for a dimension of size 1 the one sample is in the
+      domain's center). Returns the samples in x-fastest order, with
+      samples that are not in any element set to 'valueIfOutside'.
+
+      Rather than locating each sample in the mesh, this rasterizes
+      elements into the grid: each z-slice of samples gets filled by
+      one task, which goes over all elements that overlap that slice,
+      and over the samples in each element's bounding box. Inside
+      tets the field is linear, so for each row of samples the range
+      of samples inside the tet, and their values, get computed in
+      closed form; other elements test and interpolate each sample
+      individually. Elements get rasterized in mesh order, so where
+      elements overlap the last one wins - which, for samples exactly
+      on faces shared by two elements, does not matter. */
+  std::vector<float> resampleToGrid(UMesh::SP mesh,
+                                    const box3f &domain,
+                                    const vec3i &dims,
+                                    float valueIfOutside = NAN);
+
+  /*! same as resampleToGrid(UMesh::SP,...), but sampling the given
+      quantized per-vertex scalars (instead of 'perVertex'), which
+      get dequantized as they get gathered */
+  std::vector<float> resampleToGrid(UMesh::SP mesh,
+                                    const QuantizedAttribute &scalars,
+                                    const box3f &domain,
+                                    const vec3i &dims,
+                                    float valueIfOutside = NAN);
+
+} // ::umesh
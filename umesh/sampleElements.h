@@ -0,0 +1,301 @@
+// ======================================================================== //
+// Copyright 2018-2020 Ingo Wald                                            //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/* point-in-element tests and interpolation weights for all volume
+   element types, shared by the PointLocator and resampleToGrid */
+
+#pragma once
+
+#include "umesh/UMesh.h"
+#include <algorithm>
+
+namespace umesh {
+
+  /*! tolerance for the point-in-element tests, in barycentric or
+      parametric coordinates */
+  const float insideEpsilon = 1e-5f;
+
+  /*! max number of Newton steps for inverting an element's parametric
+      mapping */
+  const int maxNewtonSteps = 16;
+
+  /*! Newton iteration stops once a step changes the parametric
+      coordinates by less than this, or the point is this close
+      (relative to the element's size) to the current estimate */
+  const float newtonTolerance = 1e-6f;
+
+  /*! per-vertex scalars given as plain floats; the sample functions
+      below work with any type that, like this one (and
+      QuantizedAttribute), returns vertex i's scalar from
+      operator[] */
+  struct FloatScalars {
+    FloatScalars(const float *values) : values(values) {}
+    /*! the mesh's 'perVertex' scalars (if any) */
+    FloatScalars(const UMesh &mesh)
+      : values(mesh.perVertex ? mesh.perVertex->values.data() : nullptr)
+    {}
+    inline float operator[](size_t i) const { return values[i]; }
+    const float *values;
+  };
+  
+  inline float maxAbs(const vec3f &v)
+  { return std::max(std::max(fabsf(v.x),fabsf(v.y)),fabsf(v.z)); }
+  
+  /*! computes the barycentric coordinates of P relative to given tet;
+      returns false if the point is not inside (or the tet is
+      degenerate) */
+  inline bool tetWeights(const vec3f v[4], const vec3f &P, float w[4])
+  {
+    const vec3f e1 = v[1]-v[0], e2 = v[2]-v[0], e3 = v[3]-v[0];
+    const float volume = dot(e1,cross(e2,e3));
+    if (volume == 0.f) return false;
+    const vec3f p = P-v[0];
+    const float rcpVolume = 1.f/volume;
+    w[1] = dot(p,cross(e2,e3))*rcpVolume;
+    w[2] = dot(e1,cross(p,e3))*rcpVolume;
+    w[3] = dot(e1,cross(e2,p))*rcpVolume;
+    w[0] = 1.f-w[1]-w[2]-w[3];
+    return
+      w[0] >= -insideEpsilon && w[1] >= -insideEpsilon &&
+      w[2] >= -insideEpsilon && w[3] >= -insideEpsilon;
+  }
+
+  /*! shape functions (and their derivatives) of a VTK pyramid, with
+      parametric coordinates in [0,1]^3 */
+  struct PyrShape {
+    enum { numVertices = 5 };
+    static inline vec3f center() { return vec3f(.5f,.5f,.2f); }
+    static inline bool inside(const vec3f &p)
+    {
+      return
+        p.x >= -insideEpsilon && p.x <= 1.f+insideEpsilon &&
+        p.y >= -insideEpsilon && p.y <= 1.f+insideEpsilon &&
+        p.z >= -insideEpsilon && p.z <= 1.f+insideEpsilon;
+    }
+    static inline void eval(const vec3f &p, float w[5], vec3f dw[5])
+    {
+      const float r = p.x, s = p.y, t = p.z;
+      const float rm = 1.f-r, sm = 1.f-s, tm = 1.f-t;
+      w[0] = rm*sm*tm; dw[0] = vec3f(-sm*tm,-rm*tm,-rm*sm);
+      w[1] = r *sm*tm; dw[1] = vec3f( sm*tm,-r *tm,-r *sm);
+      w[2] = r *s *tm; dw[2] = vec3f( s *tm, r *tm,-r *s );
+      w[3] = rm*s *tm; dw[3] = vec3f(-s *tm, rm*tm,-rm*s );
+      w[4] = t;        dw[4] = vec3f(0.f,0.f,1.f);
+    }
+  };
+
+  /*! shape functions (and their derivatives) of a VTK wedge, with
+      parametric coordinates r,s in the unit triangle, and t in
+      [0,1] */
+  struct WedgeShape {
+    enum { numVertices = 6 };
+    static inline vec3f center() { return vec3f(1.f/3.f,1.f/3.f,.5f); }
+    static inline bool inside(const vec3f &p)
+    {
+      return
+        p.x >= -insideEpsilon && p.y >= -insideEpsilon &&
+        p.x+p.y <= 1.f+insideEpsilon &&
+        p.z >= -insideEpsilon && p.z <= 1.f+insideEpsilon;
+    }
+    static inline void eval(const vec3f &p, float w[6], vec3f dw[6])
+    {
+      const float r = p.x, s = p.y, t = p.z;
+      const float u = 1.f-r-s, tm = 1.f-t;
+      w[0] = u*tm; dw[0] = vec3f(-tm,-tm,-u);
+      w[1] = r*tm; dw[1] = vec3f( tm,0.f,-r);
+      w[2] = s*tm; dw[2] = vec3f(0.f, tm,-s);
+      w[3] = u*t;  dw[3] = vec3f(-t, -t,  u);
+      w[4] = r*t;  dw[4] = vec3f( t, 0.f, r);
+      w[5] = s*t;  dw[5] = vec3f(0.f, t,  s);
+    }
+  };
+
+  /*! shape functions (and their derivatives) of a VTK hex, with
+      parametric coordinates in [0,1]^3 */
+  struct HexShape {
+    enum { numVertices = 8 };
+    static inline vec3f center() { return vec3f(.5f); }
+    static inline bool inside(const vec3f &p) { return PyrShape::inside(p); }
+    static inline void eval(const vec3f &p, float w[8], vec3f dw[8])
+    {
+      const float r = p.x, s = p.y, t = p.z;
+      const float rm = 1.f-r, sm = 1.f-s, tm = 1.f-t;
+      w[0] = rm*sm*tm; dw[0] = vec3f(-sm*tm,-rm*tm,-rm*sm);
+      w[1] = r *sm*tm; dw[1] = vec3f( sm*tm,-r *tm,-r *sm);
+      w[2] = r *s *tm; dw[2] = vec3f( s *tm, r *tm,-r *s );
+      w[3] = rm*s *tm; dw[3] = vec3f(-s *tm, rm*tm,-rm*s );
+      w[4] = rm*sm*t;  dw[4] = vec3f(-sm*t, -rm*t,  rm*sm);
+      w[5] = r *sm*t;  dw[5] = vec3f( sm*t, -r *t,  r *sm);
+      w[6] = r *s *t;  dw[6] = vec3f( s *t,  r *t,  r *s );
+      w[7] = rm*s *t;  dw[7] = vec3f(-s *t,  rm*t,  rm*s );
+    }
+  };
+
+  /*! finds the parametric coordinates of P in the element with given
+      vertices, by Newton iteration on the element's shape functions,
+      and computes P's interpolation weights; returns false if P is
+      not inside (or the iteration did not converge) */
+  template<typename Shape>
+  inline bool shapeWeights(const vec3f v[], const vec3f &P, float w[])
+  {
+    const int N = Shape::numVertices;
+    // vertex positions are relative to the first vertex, which makes
+    // the residual far more accurate for elements far from the origin
+    const vec3f origin = v[0];
+    const vec3f target = P-origin;
+    float scale = 0.f;
+    for (int i=1;i<N;i++)
+      scale = std::max(scale,maxAbs(v[i]-origin));
+    
+    vec3f p = Shape::center();
+    vec3f dw[N];
+    bool converged = false;
+    for (int step=0;step<maxNewtonSteps && !converged;step++) {
+      Shape::eval(p,w,dw);
+      vec3f x(0.f), dx(0.f), dy(0.f), dz(0.f);
+      for (int i=0;i<N;i++) {
+        const vec3f vi = v[i]-origin;
+        x  = x  + w[i]*vi;
+        dx = dx + dw[i].x*vi;
+        dy = dy + dw[i].y*vi;
+        dz = dz + dw[i].z*vi;
+      }
+      // testing the residual (rather than only the step size) also
+      // catches points on a pyramid's apex, where the jacobian is
+      // singular
+      if (maxAbs(target-x) <= newtonTolerance*scale)
+        break;
+      const mat3f jacobian(dx,dy,dz);
+      if (determinant(jacobian) == 0.f) return false;
+      const vec3f delta = inverse(jacobian)*(target-x);
+      p = p + delta;
+      converged = maxAbs(delta) <= newtonTolerance;
+      if (converged) Shape::eval(p,w,dw);
+      else if (step == maxNewtonSteps-1) return false;
+    }
+    return Shape::inside(p);
+  }
+
+  /*! if P is inside given grid, computes the index of the first
+      scalar of the cell it's in, and its trilinear weights within
+      that cell */
+  inline bool gridWeights(const Grid &grid, const vec3f &P,
+                          size_t &cellBegin, vec3f &frac)
+  {
+    const vec3f lower = (const vec3f &)grid.domain.lower;
+    const vec3f upper = (const vec3f &)grid.domain.upper;
+    if (!box3f(lower,upper).contains(P)) return false;
+    const vec3f numCells = vec3f(grid.numCells);
+    const vec3f size = upper-lower;
+    vec3i cell;
+    for (int dim=0;dim<3;dim++) {
+      if (grid.numCells[dim] <= 0) return false;
+      const float f = size[dim] > 0.f
+        ? (P[dim]-lower[dim])/size[dim]*numCells[dim]
+        : 0.f;
+      cell[dim] = std::min(std::max(int(f),0),grid.numCells[dim]-1);
+      frac[dim] = std::min(std::max(f-cell[dim],0.f),1.f);
+    }
+    const size_t sx  = grid.numCells.x+1;
+    const size_t sxy = sx*(grid.numCells.y+1);
+    cellBegin = grid.scalarsOffset+cell.x+cell.y*sx+cell.z*sxy;
+    return true;
+  }
+
+  /*! trilinearly interpolates the scalars of the grid cell whose first
+      scalar is at 's', at given position within the cell */
+  inline float interpolateGridCell(const Grid &grid, const float *s,
+                                   const vec3f &f)
+  {
+    const size_t sx  = grid.numCells.x+1;
+    const size_t sxy = sx*(grid.numCells.y+1);
+    const float v00 = (1.f-f.x)*s[0]       + f.x*s[1];
+    const float v10 = (1.f-f.x)*s[sx]      + f.x*s[sx+1];
+    const float v01 = (1.f-f.x)*s[sxy]     + f.x*s[sxy+1];
+    const float v11 = (1.f-f.x)*s[sxy+sx]  + f.x*s[sxy+sx+1];
+    return
+      (1.f-f.z)*((1.f-f.y)*v00+f.y*v10)
+      + f.z    *((1.f-f.y)*v01+f.y*v11);
+  }
+  
+  /*! tests if P is in given unstructured element, and if so, and
+      'value' is non-null, interpolates the per-vertex scalars at P */
+  template<typename Prim, typename Shape, typename Scalars>
+  inline bool sampleShape(const UMesh &mesh, const Prim &prim,
+                          const vec3f &P, float *value,
+                          const Scalars &scalars)
+  {
+    const int N = Prim::numVertices;
+    vec3f v[N];
+    for (int i=0;i<N;i++) v[i] = mesh.vertices[prim[i]];
+    float w[N];
+    if (!shapeWeights<Shape>(v,P,w)) return false;
+    if (value) {
+      *value = 0.f;
+      for (int i=0;i<N;i++)
+        *value += w[i]*scalars[prim[i]];
+    }
+    return true;
+  }
+  
+  /*! tests if P is in given element, and if so, and 'value' is
+      non-null, interpolates the scalar field at P - with given
+      per-vertex scalars for unstructured elements, and the grid
+      scalars for grids */
+  template<typename Scalars>
+  inline bool samplePrim(const UMesh &mesh, const UMesh::PrimRef &prim,
+                         const vec3f &P, float *value,
+                         const Scalars &s)
+  {
+    switch (prim.type) {
+    case UMesh::TET: {
+      const Tet &tet = mesh.tets[prim.ID];
+      const vec3f v[4] = {
+        mesh.vertices[tet.x], mesh.vertices[tet.y],
+        mesh.vertices[tet.z], mesh.vertices[tet.w]
+      };
+      float w[4];
+      if (!tetWeights(v,P,w)) return false;
+      if (value)
+        *value = w[0]*s[tet.x]+w[1]*s[tet.y]+w[2]*s[tet.z]+w[3]*s[tet.w];
+      return true;
+    }
+    case UMesh::PYR:
+      return sampleShape<Pyr,PyrShape>(mesh,mesh.pyrs[prim.ID],P,value,s);
+    case UMesh::WEDGE:
+      return sampleShape<Wedge,WedgeShape>(mesh,mesh.wedges[prim.ID],P,value,s);
+    case UMesh::HEX:
+      return sampleShape<Hex,HexShape>(mesh,mesh.hexes[prim.ID],P,value,s);
+    case UMesh::GRID: {
+      const Grid &grid = mesh.grids[prim.ID];
+      size_t cellBegin;
+      vec3f  f;
+      if (!gridWeights(grid,P,cellBegin,f)) return false;
+      if (value)
+        *value = interpolateGridCell(grid,mesh.gridScalars.data()+cellBegin,f);
+      return true;
+    }
+    default:
+      throw std::runtime_error("#umesh.PointLocator: not a volume element");
+    }
+  }
+
+  /*! same as samplePrim(), with the mesh's 'perVertex' scalars */
+  inline bool samplePrim(const UMesh &mesh, const UMesh::PrimRef &prim,
+                         const vec3f &P, float *value)
+  { return samplePrim(mesh,prim,P,value,FloatScalars(mesh)); }
+
+} // ::umesh
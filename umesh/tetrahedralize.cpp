@@ -15,8 +15,10 @@
 // ======================================================================== //
 
 #include "umesh/tetrahedralize.h"
+#include "umesh/parallel_radix_sort.h"
+#include "umesh/profile.h"
 #include <algorithm>
-#include <set>
+#include <atomic>
 
 #ifndef PRINT
 #ifdef __CUDA_ARCH__
@@ -33,55 +35,194 @@
 #endif
 
 namespace umesh {
-  struct MergedMesh {
+
+  inline float volume(const vec3f &v0,
+                      const vec3f &v1,
+                      const vec3f &v2,
+                      const vec3f &v3)
+  {
+    return dot(v3-v0,cross(v1-v0,v2-v0));
+  }
+                      
+  inline bool flat(const vec3f &v0,
+                   const vec3f &v1,
+                   const vec3f &v2,
+                   const vec3f &v3)
+  {
+    if (v0 == v1 ||
+        v0 == v2 ||
+        v0 == v3 ||
+        v1 == v2 ||
+        v1 == v3 ||
+        v2 == v3)
+      return false;
+    const vec3f n0 = cross(v1-v0,v2-v0);
+    if (length(n0) == 0.f) return false;
+      
+    const vec3f n1 = cross(v2-v0,v3-v0);
+    if (length(n1) == 0.f) return false;
+
+    return dot(n0,n1)/(length(n0)*length(n1)) >= .99f;
+  }
+
+  /*! the (sorted) list of vertices that a newly created center
+      vertex is the center of; padded with -1's */
+  struct CenterKey {
+    static const int maxVertices = 8;
     
-    MergedMesh(UMesh::SP in, bool passThroughFlatElements=false)
-      : in(in),
-        out(std::make_shared<UMesh>()),
-        passThroughFlatElements(passThroughFlatElements)
+    CenterKey(std::initializer_list<int> vertices)
+      : numVertices((int)vertices.size())
     {
-      out->vertices = in->vertices;
-      if (in->perVertex) {
-        out->perVertex = std::make_shared<Attribute>();
-        out->perVertex->name   = in->perVertex->name;
-        out->perVertex->values = in->perVertex->values;
-      }
+      std::copy(vertices.begin(),vertices.end(),idx);
+      std::sort(idx,idx+numVertices);
+      std::fill(idx+numVertices,idx+maxVertices,-1);
     }
-
-    inline float length(const vec3f v) { return sqrtf(dot(v,v)); }
+    CenterKey() = default;
     
-    inline float volume(const vec3f &v0,
-                        const vec3f &v1,
-                        const vec3f &v2,
-                        const vec3f &v3)
+    inline bool operator==(const CenterKey &other) const
     {
-      return dot(v3-v0,cross(v1-v0,v2-v0));
+      if (numVertices != other.numVertices) return false;
+      for (int i=0;i<numVertices;i++)
+        if (idx[i] != other.idx[i]) return false;
+      return true;
     }
-                      
-    inline bool flat(const vec3f &v0,
-                     const vec3f &v1,
-                     const vec3f &v2,
-                     const vec3f &v3)
+    inline uint64_t hash() const
     {
-      if (v0 == v1 ||
-          v0 == v2 ||
-          v0 == v3 ||
-          v1 == v2 ||
-          v1 == v3 ||
-          v2 == v3)
-        return false;
-      const vec3f n0 = cross(v1-v0,v2-v0);
-      if (length(n0) == 0.f) return false;
-      
-      const vec3f n1 = cross(v2-v0,v3-v0);
-      if (length(n1) == 0.f) return false;
+      uint64_t h = numVertices;
+      for (int i=0;i<numVertices;i++)
+        h = (h ^ uint32_t(idx[i])) * 0x9e3779b97f4a7c15ull;
+      return h ^ (h >> 29);
+    }
+    
+    int idx[maxVertices];
+    int numVertices;
+  };
+
+  /*! concurrent hash table of all center vertices that get created
+      during tetrahedralization, keyed by the vertices they are the
+      center of. Slots get claimed by CAS'ing their number of vertices
+      from EMPTY to BUSY, and become visible to other threads once the
+      final number gets stored. For each key the table tracks the
+      smallest 'rank' (ie, first use in the order in which the serial
+      code would have visited elements) of all requests for it, so
+      the center vertices can be created in exactly the order the
+      serial code would have created them. */
+  struct CenterHashTable {
+    static const int EMPTY = 0;
+    static const int BUSY  = -1;
+    
+    struct Slot {
+      std::atomic<int>      numVertices;
+      int                   idx[CenterKey::maxVertices];
+      std::atomic<uint64_t> owner;
+    };
+    
+    CenterHashTable(size_t minCapacity)
+    {
+      capacity = 1;
+      while (capacity < minCapacity) capacity *= 2;
+      maxUsed = capacity/8*7;
+      slots.reset(new Slot[capacity]);
+      parallel_for_blocked(0,capacity,64*1024,[&](size_t begin, size_t end){
+          for (size_t i=begin;i<end;i++)
+            slots[i].numVertices.store(EMPTY,std::memory_order_relaxed);
+        });
+    }
 
-      return dot(n0,n1)/(length(n0)*length(n1)) >= .99f;
+    inline bool matches(const Slot &slot, const CenterKey &key) const
+    {
+      for (int i=0;i<key.numVertices;i++)
+        if (slot.idx[i] != key.idx[i]) return false;
+      return true;
     }
-                      
     
-    void add(const UMesh::Tet &tet, const std::string &dbg="")
+    /*! adds a request for given center, with given rank; returns the
+        slot it ended up in, or -1 if the table is full - in which case
+        the table has to be rebuilt with a larger capacity */
+    int64_t insert(const CenterKey &key, uint64_t rank)
+    {
+      if (full) return -1;
+      const size_t mask = capacity-1;
+      size_t slotID = key.hash() & mask;
+      for (size_t probe=0;probe<capacity;probe++,slotID=(slotID+1)&mask) {
+        Slot &slot = slots[slotID];
+        int current = slot.numVertices.load(std::memory_order_acquire);
+        if (current == EMPTY) {
+          if (slot.numVertices.compare_exchange_strong(current,BUSY)) {
+            std::copy(key.idx,key.idx+CenterKey::maxVertices,slot.idx);
+            slot.owner.store(rank,std::memory_order_relaxed);
+            slot.numVertices.store(key.numVertices,std::memory_order_release);
+            if (++numUsed > maxUsed) full = true;
+            return slotID;
+          }
+        }
+        while (current == BUSY)
+          current = slot.numVertices.load(std::memory_order_acquire);
+        if (current == key.numVertices && matches(slot,key)) {
+          uint64_t owner = slot.owner.load(std::memory_order_relaxed);
+          while (rank < owner &&
+                 !slot.owner.compare_exchange_weak(owner,rank,
+                                                   std::memory_order_relaxed))
+            ;
+          return slotID;
+        }
+      }
+      full = true;
+      return -1;
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t                  capacity;
+    size_t                  maxUsed;
+    std::atomic<size_t>     numUsed { 0 };
+    std::atomic<bool>       full { false };
+  };
+
+  /*! the output's vertices: the input's, followed by the centers */
+  struct OutputVertices {
+    inline const vec3f &operator[](size_t i) const
+    { return i < numInputVertices ? inputVertices[i] : centers[i-numInputVertices]; }
+    
+    const vec3f *inputVertices;
+    size_t       numInputVertices;
+    const vec3f *centers;
+  };
+  
+  /*! the elements generated from one block of input elements */
+  struct TetrahedralizedBlock {
+    std::vector<UMesh::Tet>   tets;
+    std::vector<UMesh::Pyr>   pyrs;
+    std::vector<UMesh::Wedge> wedges;
+    std::vector<UMesh::Hex>   hexes;
+  };
+  
+  /*! decomposes individual elements into tets (or, if requested,
+      passes through flat ones), exactly as the serial code always has
+      done. Each center vertex that an element asks for is a
+      'request', and each element has a fixed range of request IDs
+      (in the order the serial code would have visited them). If
+      'emit' is false this only adds all requests to the hash table,
+      and stores their slots in 'centerOf' (and doesn't look at the
+      centers' positions, which don't exist yet); if true, 'centerOf'
+      has to contain the requests' vertex IDs, and the generated
+      elements get written to 'out' */
+  template<bool emit>
+  struct ElementSplitter {
+    ElementSplitter(const OutputVertices &vertices,
+                    CenterHashTable *centers,
+                    int64_t *centerOf,
+                    bool passThroughFlatElements,
+                    TetrahedralizedBlock *out = nullptr)
+      : vertices(vertices),
+        centers(centers),
+        centerOf(centerOf),
+        passThroughFlatElements(passThroughFlatElements),
+        out(out)
+    {}
+    
+    void add(const UMesh::Tet &tet)
     {
+      if (!emit) return;
       if (tet.x == tet.y ||
           tet.x == tet.z ||
           tet.x == tet.w ||
@@ -90,10 +231,10 @@ namespace umesh {
           tet.z == tet.w)
         /* degenerate/flat tet .... so in either case: dump this */
         return;
-      vec3f a = out->vertices[tet.x];
-      vec3f b = out->vertices[tet.y];
-      vec3f c = out->vertices[tet.z];
-      vec3f d = out->vertices[tet.w];
+      vec3f a = vertices[tet.x];
+      vec3f b = vertices[tet.y];
+      vec3f c = vertices[tet.z];
+      vec3f d = vertices[tet.w];
       float volume = dot(d-a,cross(b-a,c-a));
       
       if (volume == 0.f)
@@ -101,29 +242,29 @@ namespace umesh {
         return;
 
       if (volume < 0.f) {
-        static bool warned = false;
-        if (!warned) {
+        static std::atomic<bool> warned(false);
+        if (!warned.exchange(true))
           std::cout
             << UMESH_TERMINAL_RED
             <<"WARNING: at least one tet (or other element that generated a tet)\n was wrongly oriented!!! (I'll swap those tets, but that's still fishy...)"
             << UMESH_TERMINAL_DEFAULT
             << std::endl;
-          warned = true;
-        }
         out->tets.push_back({tet.x,tet.y,tet.w,tet.z});
       } else
         out->tets.push_back(tet);
     }
 
-    void add(const UMesh::Pyr &pyr, const std::string &dbg="")
+    void add(const UMesh::Pyr &pyr)
     {
       if (passThroughFlatElements) {
-        const vec3f v0 = out->vertices[pyr[0]];
-        const vec3f v1 = out->vertices[pyr[1]];
-        const vec3f v2 = out->vertices[pyr[2]];
-        const vec3f v3 = out->vertices[pyr[3]];
-        const vec3f v4 = out->vertices[pyr[4]];
+        const vec3f v0 = vertices[pyr[0]];
+        const vec3f v1 = vertices[pyr[1]];
+        const vec3f v2 = vertices[pyr[2]];
+        const vec3f v3 = vertices[pyr[3]];
         if (flat(v0,v1,v2,v3)) {
+          if (!emit) return;
+          // the tip may be a center vertex, so only look at it now
+          const vec3f v4 = vertices[pyr[4]];
           if (volume(v0,v1,v2,v4) < 0.f) {
             UMesh::Pyr _pyr = pyr;
             std::swap(_pyr.base.x,_pyr.base.y);
@@ -136,20 +277,20 @@ namespace umesh {
         }
       }
       int base = getCenter({pyr[0],pyr[1],pyr[2],pyr[3]});
-      add(UMesh::Tet(pyr[0],pyr[1],base,pyr[4]),dbg+"pyr0");
-      add(UMesh::Tet(pyr[1],pyr[2],base,pyr[4]),dbg+"pyr1");
-      add(UMesh::Tet(pyr[2],pyr[3],base,pyr[4]),dbg+"pyr2");
-      add(UMesh::Tet(pyr[3],pyr[0],base,pyr[4]),dbg+"pyr3");
+      add(UMesh::Tet(pyr[0],pyr[1],base,pyr[4]));
+      add(UMesh::Tet(pyr[1],pyr[2],base,pyr[4]));
+      add(UMesh::Tet(pyr[2],pyr[3],base,pyr[4]));
+      add(UMesh::Tet(pyr[3],pyr[0],base,pyr[4]));
     }
 
     void add(const UMesh::Wedge &wedge)
     {
-      const vec3f v0 = out->vertices[wedge[0]];
-      const vec3f v1 = out->vertices[wedge[1]];
-      const vec3f v2 = out->vertices[wedge[2]];
-      const vec3f v3 = out->vertices[wedge[3]];
-      const vec3f v4 = out->vertices[wedge[4]];
-      const vec3f v5 = out->vertices[wedge[5]];
+      const vec3f v0 = vertices[wedge[0]];
+      const vec3f v1 = vertices[wedge[1]];
+      const vec3f v2 = vertices[wedge[2]];
+      const vec3f v3 = vertices[wedge[3]];
+      const vec3f v4 = vertices[wedge[4]];
+      const vec3f v5 = vertices[wedge[5]];
       if (v2 == v5)
         throw std::runtime_error("wedge that should be a pyramid!?");
       
@@ -157,6 +298,7 @@ namespace umesh {
         if (flat(v0,v2,v5,v3) &&
             flat(v1,v2,v5,v4) &&
             flat(v0,v1,v4,v3)) {
+          if (!emit) return;
           if (volume(v0,v1,v4,v2) < 0.f) {
             UMesh::Wedge _wedge = wedge;
             std::swap(_wedge[0],_wedge[3]);
@@ -169,55 +311,55 @@ namespace umesh {
           return;
         }
       }
-      
-      std::set<vec3f> uniqueBaseVertices;
-      uniqueBaseVertices.insert(v0);
-      uniqueBaseVertices.insert(v1);
-      uniqueBaseVertices.insert(v3);
-      uniqueBaseVertices.insert(v4);
-      if (uniqueBaseVertices.size() == 4) {
+
+      const vec3f base[4] = { v0, v1, v3, v4 };
+      int numUniqueBaseVertices = 0;
+      for (int i=0;i<4;i++) 
+        if (std::find(base,base+i,base[i]) == base+i)
+          ++numUniqueBaseVertices;
+      if (numUniqueBaseVertices == 4) {
         // newly created points:
         int center = getCenter({wedge[0],wedge[1],wedge[2],
                                 wedge[3],wedge[4],wedge[5]});
         
         // bottom face to center
-        add(UMesh::Pyr(wedge[0],wedge[1],wedge[4],wedge[3],center),"wed1");
+        add(UMesh::Pyr(wedge[0],wedge[1],wedge[4],wedge[3],center));
         // left face to center
-        add(UMesh::Pyr(wedge[0],wedge[3],wedge[5],wedge[2],center),"wed2");
+        add(UMesh::Pyr(wedge[0],wedge[3],wedge[5],wedge[2],center));
         // right face to center
-        add(UMesh::Pyr(wedge[1],wedge[2],wedge[5],wedge[4],center),"wed3");
+        add(UMesh::Pyr(wedge[1],wedge[2],wedge[5],wedge[4],center));
         // front face to center
-        add(UMesh::Tet(wedge[0],wedge[2],wedge[1],center),"wed4");
+        add(UMesh::Tet(wedge[0],wedge[2],wedge[1],center));
         // back face to center
-        add(UMesh::Tet(wedge[3],wedge[4],wedge[5],center),"wed5");
-      } else if (uniqueBaseVertices.size() == 3) {
+        add(UMesh::Tet(wedge[3],wedge[4],wedge[5],center));
+      } else if (numUniqueBaseVertices == 3) {
         if (v0 == v1) {
           int center = getCenter({wedge[0],wedge[2],
                                   wedge[3],wedge[4],wedge[5]});
           // bottom face to center
-          add(UMesh::Tet(wedge[0],wedge[4],wedge[3],center),"wed1");
+          add(UMesh::Tet(wedge[0],wedge[4],wedge[3],center));
           // left face to center
-          add(UMesh::Pyr(wedge[0],wedge[3],wedge[5],wedge[2],center),"wed2");
+          add(UMesh::Pyr(wedge[0],wedge[3],wedge[5],wedge[2],center));
           // right face to center
-          add(UMesh::Pyr(wedge[1],wedge[2],wedge[5],wedge[4],center),"wed3");
+          add(UMesh::Pyr(wedge[1],wedge[2],wedge[5],wedge[4],center));
           // // front face to center
-          // add(UMesh::Tet(wedge[0],wedge[2],wedge[1],center),"wed4");
+          // add(UMesh::Tet(wedge[0],wedge[2],wedge[1],center));
           // back face to center
-          add(UMesh::Tet(wedge[3],wedge[4],wedge[5],center),"wed5");
+          add(UMesh::Tet(wedge[3],wedge[4],wedge[5],center));
           
         } else if (v3 == v4) {
           int center = getCenter({wedge[0],wedge[1],wedge[2],
                                   wedge[3],wedge[5]});
           // bottom face to center
-          add(UMesh::Tet(wedge[0],wedge[1],wedge[3],center),"wed1");
+          add(UMesh::Tet(wedge[0],wedge[1],wedge[3],center));
           // left face to center
-          add(UMesh::Pyr(wedge[0],wedge[3],wedge[5],wedge[2],center),"wed2");
+          add(UMesh::Pyr(wedge[0],wedge[3],wedge[5],wedge[2],center));
           // right face to center
-          add(UMesh::Pyr(wedge[1],wedge[2],wedge[5],wedge[4],center),"wed3");
+          add(UMesh::Pyr(wedge[1],wedge[2],wedge[5],wedge[4],center));
            // front face to center
-          add(UMesh::Tet(wedge[0],wedge[2],wedge[1],center),"wed4");
+          add(UMesh::Tet(wedge[0],wedge[2],wedge[1],center));
           // // back face to center
-          // add(UMesh::Tet(wedge[3],wedge[4],wedge[5],center),"wed5");
+          // add(UMesh::Tet(wedge[3],wedge[4],wedge[5],center));
         } else
           throw std::runtime_error("oy-wey.... what _is_ that shape!?");
       } else {
@@ -228,20 +370,21 @@ namespace umesh {
     void add(const UMesh::Hex &hex)
     {
       if (passThroughFlatElements) {
-        const vec3f v0 = out->vertices[hex[0]];
-        const vec3f v1 = out->vertices[hex[1]];
-        const vec3f v2 = out->vertices[hex[2]];
-        const vec3f v3 = out->vertices[hex[3]];
-        const vec3f v4 = out->vertices[hex[4]];
-        const vec3f v5 = out->vertices[hex[5]];
-        const vec3f v6 = out->vertices[hex[6]];
-        const vec3f v7 = out->vertices[hex[7]];
+        const vec3f v0 = vertices[hex[0]];
+        const vec3f v1 = vertices[hex[1]];
+        const vec3f v2 = vertices[hex[2]];
+        const vec3f v3 = vertices[hex[3]];
+        const vec3f v4 = vertices[hex[4]];
+        const vec3f v5 = vertices[hex[5]];
+        const vec3f v6 = vertices[hex[6]];
+        const vec3f v7 = vertices[hex[7]];
         if (flat(v0,v1,v2,v3) &&
             flat(v4,v5,v6,v7) &&
             flat(v1,v2,v6,v5) &&
             flat(v0,v3,v7,v4) &&
             flat(v0,v1,v5,v4) &&
             flat(v3,v2,v6,v7)) {
+          if (!emit) return;
           if (volume(v0,v1,v2,v5) < 0.f) {
             UMesh::Hex _hex = hex;
             std::swap(_hex[0],_hex[4]);
@@ -276,48 +419,269 @@ namespace umesh {
       // right face to center
       add(UMesh::Pyr(hex[1],hex[5],hex[6],hex[2],center));
     }
+
+    /*! when collecting, adds a request for given center to the table
+        and returns -1; otherwise returns the center's vertex ID */
+    int getCenter(std::initializer_list<int> idx)
+    {
+      const size_t requestID = nextRequest++;
+      if (emit)
+        return (int)centerOf[requestID];
+      // if the table is full it'll get rebuilt anyway, so ignore
+      centerOf[requestID] = centers->insert(CenterKey(idx),requestID);
+      return -1;
+    }
+
+    /*! the ID of the next request of the current element */
+    size_t nextRequest = 0;
     
-    int getCenter(std::vector<int> idx)
+    const OutputVertices      vertices;
+    CenterHashTable          *centers;
+    int64_t                  *centerOf;
+    /*! if true, then we'll tessellate only curved elements */
+    const bool                passThroughFlatElements;
+    TetrahedralizedBlock     *out;
+  };
+
+  /*! the number of tets, pyramids, wedges, and hexes to visit, in
+      that order */
+  struct ElementCounts {
+    size_t operator[](int i) const { return count[i]; }
+    size_t total() const { return count[0]+count[1]+count[2]+count[3]; }
+    size_t count[4];
+  };
+
+  /*! the maximum number of center vertices a tet, pyramid, wedge, or
+      hex can ask for (one for the element itself, and one for each of
+      the quad faces that get split into pyramids) */
+  const size_t maxCentersPerElement[4] = { 0, 1, 4, 7 };
+  
+  /*! the ID of the first request of each type of element, such that
+      the request IDs follow the order of the serial code */
+  struct RequestOffsets {
+    RequestOffsets(const UMesh &in)
     {
-      std::sort(idx.begin(),idx.end());
-      auto it = newVertices.find(idx);
-      if (it != newVertices.end())
-        return it->second;
-      
-      vec3f centerPos = vec3f(0.f);
-      float centerVal = 0.f;
-      for (auto i : idx) {
-        if (in->perVertex)
-          centerVal += in->perVertex->values[i];
-        centerPos = centerPos + in->vertices[i];
-      }
-      centerVal *= (1.f/idx.size());
-      centerPos = centerPos * (1.f/idx.size());
-
-      // now let's be super-pedantic, and check if the newly generated
-      // vertex by pure chance already exists in the input. shouldn't
-      // happen, but who knows...
-      int ID = -1;
-      auto it2 = vertices.find(centerPos);
-      if (it2 != vertices.end())
-        ID = it2->second;
-      else {
-        ID = (int)out->vertices.size();
-        out->vertices.push_back(centerPos);
-        if (out->perVertex)
-          out->perVertex->values.push_back(centerVal);
+      begin[0] = begin[1] = 0;
+      begin[2] = begin[1]+in.pyrs.size()*maxCentersPerElement[1];
+      begin[3] = begin[2]+in.wedges.size()*maxCentersPerElement[2];
+      end      = begin[3]+in.hexes.size()*maxCentersPerElement[3];
+    }
+    size_t begin[4];
+    size_t end;
+  };
+
+  /*! calls splitter.add() for the element with given index in the
+      sequence of all elements listed in 'counts' */
+  template<typename Splitter>
+  inline void addElement(Splitter &splitter, const UMesh &in,
+                         const RequestOffsets &requests,
+                         const ElementCounts &counts, size_t elementID)
+  {
+    int type = 0;
+    while (elementID >= counts[type]) elementID -= counts[type++];
+    splitter.nextRequest
+      = requests.begin[type]+elementID*maxCentersPerElement[type];
+    switch (type) {
+    case 0: splitter.add(in.tets[elementID]);   break;
+    case 1: splitter.add(in.pyrs[elementID]);   break;
+    case 2: splitter.add(in.wedges[elementID]); break;
+    case 3: splitter.add(in.hexes[elementID]);  break;
+    }
+  }
+
+  /*! does the actual work for all tetrahedralize() variants: creates
+      the center vertices for all of the input's elements, then
+      converts the first 'owned[i]' tets, pyramids, wedges, and hexes
+      into output elements, and passes both to the consumer.
+
+      This runs in parallel, but produces exactly what visiting all
+      elements one after another would: first, all elements get
+      visited (in parallel) to collect the center vertices they need
+      in a concurrent hash table, along with the (serial) order in
+      which they would have been created; the centers then get sorted
+      by that order. Then, each block of elements gets converted (in
+      parallel) into its own list of elements, and the blocks get
+      passed to the consumer in order, one batch of blocks at a
+      time. */
+  void tetrahedralize(const UMesh &in,
+                      bool passThroughFlatElements,
+                      const ElementCounts &owned,
+                      TetrahedralizeConsumer &consumer)
+  {
+    const size_t blockSize = 16*1024;
+    const size_t blocksPerBatch = 64;
+    const ElementCounts all
+      = {{ in.tets.size(), in.pyrs.size(), in.wedges.size(), in.hexes.size() }};
+    const size_t numElements = all.total();
+    profile::ScopedTimer timer("tetrahedralize",0,numElements);
+    const RequestOffsets requests(in);
+    const size_t numRequests = requests.end;
+    std::vector<int64_t> centerOf(numRequests,-1);
+    OutputVertices vertices = { in.vertices.data(), in.vertices.size(), nullptr };
+
+    // ------------------------------------------------------------------
+    // collect all center vertices, and the order of their first use
+    // ------------------------------------------------------------------
+    // (neighboring elements share their faces, so in a connected mesh
+    // there's one center per element, plus about half as many as the
+    // elements have quad faces)
+    const size_t expectedNumCenters
+      = in.pyrs.size()
+      + in.wedges.size()*5/2
+      + in.hexes.size()*4;
+    std::unique_ptr<CenterHashTable> table;
+    for (size_t capacity = expectedNumCenters/7*8+1024; ; capacity = 2*numRequests+1024) {
+      table.reset(new CenterHashTable(capacity));
+      parallel_for_blocked(0,numElements,blockSize,[&](size_t begin, size_t end){
+          ElementSplitter<false> collector(vertices,table.get(),
+                                           centerOf.data(),
+                                           passThroughFlatElements);
+          for (size_t elementID=begin;elementID<end;elementID++)
+            addElement(collector,in,requests,all,elementID);
+        });
+      if (!table->full) break;
+    }
+
+    // ------------------------------------------------------------------
+    // create the center vertices, in order of first use
+    // ------------------------------------------------------------------
+    std::vector<uint64_t> order;
+    for (size_t slotID=0;slotID<table->capacity;slotID++)
+      if (table->slots[slotID].numVertices.load(std::memory_order_relaxed)
+          != CenterHashTable::EMPTY)
+        order.push_back(slotID);
+    parallel_radix_sort(order,[&](uint64_t slotID)
+                        { return table->slots[slotID].owner.load(std::memory_order_relaxed); });
+
+    const size_t numInputVertices = in.vertices.size();
+    const size_t numCenters = order.size();
+    std::vector<vec3f> centers(numCenters);
+    std::vector<float> centerValues(in.perVertex ? numCenters : 0);
+    parallel_for_blocked(0,numCenters,16*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++) {
+          CenterHashTable::Slot &slot = table->slots[order[i]];
+          const int numVertices = slot.numVertices.load(std::memory_order_relaxed);
+          vec3f centerPos = vec3f(0.f);
+          float centerVal = 0.f;
+          for (int j=0;j<numVertices;j++) {
+            if (in.perVertex)
+              centerVal += in.perVertex->values[slot.idx[j]];
+            centerPos = centerPos + in.vertices[slot.idx[j]];
+          }
+          centerVal *= (1.f/numVertices);
+          centerPos = centerPos * (1.f/numVertices);
+
+          centers[i] = centerPos;
+          if (in.perVertex)
+            centerValues[i] = centerVal;
+          // from now on, each slot's owner is its center's vertex ID
+          slot.owner.store(numInputVertices+i,std::memory_order_relaxed);
+        }
+      });
+    // ... and each request's 'centerOf' is the vertex ID, too
+    parallel_for_blocked(0,numRequests,64*1024,[&](size_t begin, size_t end){
+        for (size_t i=begin;i<end;i++)
+          if (centerOf[i] >= 0)
+            centerOf[i] = table->slots[centerOf[i]].owner.load(std::memory_order_relaxed);
+      });
+    table.reset();
+    order.clear();
+    order.shrink_to_fit();
+    
+    consumer.addVertices(centers.data(),
+                         in.perVertex ? centerValues.data() : nullptr,
+                         numCenters);
+    centerValues.clear();
+    centerValues.shrink_to_fit();
+    vertices.centers = centers.data();
+    
+    // ------------------------------------------------------------------
+    // and create the output elements, block by block
+    // ------------------------------------------------------------------
+    const size_t numOwned = owned.total();
+    const size_t numBlocks = divRoundUp(numOwned,blockSize);
+    for (size_t batchBegin=0;batchBegin<numBlocks;batchBegin+=blocksPerBatch) {
+      const size_t batchEnd = std::min(batchBegin+blocksPerBatch,numBlocks);
+      std::vector<TetrahedralizedBlock> blocks(batchEnd-batchBegin);
+      parallel_for(blocks.size(),[&](size_t i){
+          ElementSplitter<true> splitter(vertices,nullptr,
+                                         centerOf.data(),
+                                         passThroughFlatElements,
+                                         &blocks[i]);
+          const size_t begin = (batchBegin+i)*blockSize;
+          const size_t end   = std::min(begin+blockSize,numOwned);
+          for (size_t elementID=begin;elementID<end;elementID++)
+            addElement(splitter,in,requests,owned,elementID);
+        });
+      for (auto &block : blocks) {
+        if (!block.tets.empty())
+          consumer.addTets(block.tets.data(),block.tets.size());
+        if (!block.pyrs.empty())
+          consumer.addPyrs(block.pyrs.data(),block.pyrs.size());
+        if (!block.wedges.empty())
+          consumer.addWedges(block.wedges.data(),block.wedges.size());
+        if (!block.hexes.empty())
+          consumer.addHexes(block.hexes.data(),block.hexes.size());
       }
-      newVertices[idx] = ID;
-      return ID;
     }
+  }
 
-    std::map<vec3f,int> vertices;
-    std::map<std::vector<int>,int> newVertices;
-    UMesh::SP in, out;
-    /*! if true, then we'll tessellate only curved elements */
-    bool passThroughFlatElements;
+  /*! consumer that builds a regular output mesh, with a copy of the
+      input's vertices and scalars */
+  struct OutputMeshBuilder : public TetrahedralizeConsumer {
+    OutputMeshBuilder(const UMesh &in)
+      : out(std::make_shared<UMesh>())
+    {
+      out->vertices = in.vertices;
+      if (in.perVertex) {
+        out->perVertex = std::make_shared<Attribute>();
+        out->perVertex->name   = in.perVertex->name;
+        out->perVertex->values = in.perVertex->values;
+      }
+    }
+    
+    template<typename T>
+    static void append(std::vector<T> &v, const T *t, size_t count)
+    { v.insert(v.end(),t,t+count); }
+    
+    void addVertices(const vec3f *vertices,
+                     const float *scalars,
+                     size_t count) override
+    {
+      append(out->vertices,vertices,count);
+      if (out->perVertex)
+        append(out->perVertex->values,scalars,count);
+    }
+    void addTets(const UMesh::Tet *tets, size_t count) override
+    { append(out->tets,tets,count); }
+    void addPyrs(const UMesh::Pyr *pyrs, size_t count) override
+    { append(out->pyrs,pyrs,count); }
+    void addWedges(const UMesh::Wedge *wedges, size_t count) override
+    { append(out->wedges,wedges,count); }
+    void addHexes(const UMesh::Hex *hexes, size_t count) override
+    { append(out->hexes,hexes,count); }
+    
+    UMesh::SP out;
   };
 
+  /*! runs the tetrahedralization, and returns the output mesh */
+  UMesh::SP tetrahedralize(UMesh::SP in,
+                           bool passThroughFlatElements,
+                           const ElementCounts &owned)
+  {
+    OutputMeshBuilder builder(*in);
+    tetrahedralize(*in,passThroughFlatElements,owned,builder);
+    return builder.out;
+  }
+  
+  void tetrahedralize(UMesh::SP in,
+                      TetrahedralizeConsumer &consumer,
+                      bool maintainFlatElements)
+  {
+    const ElementCounts all
+      = {{ in->tets.size(), in->pyrs.size(), in->wedges.size(), in->hexes.size() }};
+    tetrahedralize(*in,maintainFlatElements,all,consumer);
+  }
 
 
 #if 0
@@ -406,19 +770,13 @@ namespace umesh {
       }
 #endif    
 
-    MergedMesh merged(in);
-    for (auto tet : in->tets)
-      merged.add(tet);
-    for (auto pyr : in->pyrs)
-      merged.add(pyr);
-    for (auto wedge : in->wedges) 
-      merged.add(wedge);
-    for (auto hex : in->hexes) 
-      merged.add(hex);
+    const ElementCounts all
+      = {{ in->tets.size(), in->pyrs.size(), in->wedges.size(), in->hexes.size() }};
+    UMesh::SP out = tetrahedralize(in,/*pass through flat elements:*/false,all);
     std::cout << "done tetrahedralizing, got "
-              << sizeString(merged.out)
+              << sizeString(out)
               << " from " << sizeString(in) << std::endl;
-    return merged.out;
+    return out;
   }
 
 
@@ -432,41 +790,22 @@ namespace umesh {
                            int ownedWedges,
                            int ownedHexes)
   {
-    // ------------------------------------------------------------------
-    // first stage: push _all_ elements, to ensure we get same vertex
-    // array as 'non-owned' version
-    // ------------------------------------------------------------------
-    MergedMesh merged(in);
-    for (auto tet : in->tets)
-      merged.add(tet);
-    for (auto pyr : in->pyrs)
-      merged.add(pyr);
-    for (auto wedge : in->wedges) 
-      merged.add(wedge);
-    for (auto hex : in->hexes) 
-      merged.add(hex);
-    // ------------------------------------------------------------------
-    // now, kll all so-far generated tets in the output mesh, but keep
-    // the vertex array...
-    // ------------------------------------------------------------------
-    merged.out->tets.clear();
-    // ------------------------------------------------------------------
-    // and re-push (only) the owned ones
-    // ------------------------------------------------------------------
-    for (size_t i=0;i<std::min((int)in->tets.size(),ownedTets);i++)
-      merged.add(in->tets[i]);
-    for (size_t i=0;i<std::min((int)in->pyrs.size(),ownedPyrs);i++)
-      merged.add(in->pyrs[i]);
-    for (size_t i=0;i<std::min((int)in->wedges.size(),ownedWedges);i++)
-      merged.add(in->wedges[i]);
-    for (size_t i=0;i<std::min((int)in->hexes.size(),ownedHexes);i++)
-      merged.add(in->hexes[i]);
+    // the center vertices always get created for _all_ elements, to
+    // ensure we get same vertex array as 'non-owned' version
+    auto numOwned = [](size_t count, int owned)
+    { return std::min(count,(size_t)std::max(owned,0)); };
+    const ElementCounts owned
+      = {{ numOwned(in->tets.size(),ownedTets),
+           numOwned(in->pyrs.size(),ownedPyrs),
+           numOwned(in->wedges.size(),ownedWedges),
+           numOwned(in->hexes.size(),ownedHexes) }};
+    UMesh::SP out = tetrahedralize(in,/*pass through flat elements:*/false,owned);
     std::cout << "finalizing..." << std::endl;
-    merged.out->finalize();
+    out->finalize();
     std::cout << "done tetrahedralizing (second stage), got "
-              << sizeString(merged.out)
+              << sizeString(out)
               << " from " << sizeString(in) << std::endl;
-    return merged.out;
+    return out;
   }
 
   /*! same as tetrahedralize(), but chop up ONLY elements with curved
@@ -501,21 +840,15 @@ namespace umesh {
       }
 #endif    
 
-    MergedMesh merged(in,/*pass through flat elements:*/true);
-    for (auto tet : in->tets)
-      merged.add(tet);
-    for (auto pyr : in->pyrs)
-      merged.add(pyr);
-    for (auto wedge : in->wedges) 
-      merged.add(wedge);
-    for (auto hex : in->hexes) 
-      merged.add(hex);
+    const ElementCounts all
+      = {{ in->tets.size(), in->pyrs.size(), in->wedges.size(), in->hexes.size() }};
+    UMesh::SP out = tetrahedralize(in,/*pass through flat elements:*/true,all);
     std::cout << "finalizing..." << std::endl;
-    merged.out->finalize();
+    out->finalize();
     std::cout << "done tetrahedralizing curved elements (pass through for flat), got "
-              << sizeString(merged.out)
+              << sizeString(out)
               << " from " << sizeString(in) << std::endl;
-    return merged.out;
+    return out;
   }
   
 } // ::umesh
@@ -57,6 +57,42 @@ namespace umesh {
       this will ALSO (do the best job it can at) flipping
       negative-volume leemnts to positive volume */
   UMesh::SP tetrahedralize_maintainFlatElements(UMesh::SP mesh);
+
+  /*! receives the output of a streaming tetrahedralization (see
+      below). The output's vertices are the input's vertices, followed
+      by all newly created center vertices; the latter get passed to
+      addVertices() - all of them, and all before any elements - in
+      order of their vertex IDs, starting at the input's number of
+      vertices. Elements then get passed in batches, with the
+      elements of each type arriving in exactly the order in which
+      tetrahedralize() would have stored them. All calls happen on
+      the calling thread, and the pointers passed are only valid for
+      the duration of the call. */
+  struct TetrahedralizeConsumer {
+    virtual ~TetrahedralizeConsumer() = default;
+
+    /*! newly created vertices, and their interpolated scalars (or
+        null if the input doesn't have any) */
+    virtual void addVertices(const vec3f *vertices,
+                             const float *scalars,
+                             size_t count) = 0;
+    virtual void addTets(const UMesh::Tet *tets, size_t count) = 0;
+    /*! flat pyramids, wedges, and hexes that got passed through; only
+        called when flat elements get maintained */
+    virtual void addPyrs(const UMesh::Pyr *pyrs, size_t count) {}
+    virtual void addWedges(const UMesh::Wedge *wedges, size_t count) {}
+    virtual void addHexes(const UMesh::Hex *hexes, size_t count) {}
+  };
+
+  /*! same as tetrahedralize(mesh) (or, if 'maintainFlatElements' is
+      set, tetrahedralize_maintainFlatElements()), but instead of
+      building an output mesh, streams the generated vertices and
+      elements to given consumer. This neither copies the input's
+      vertices and scalars, nor keeps more than a batch of elements
+      around at any time. */
+  void tetrahedralize(UMesh::SP mesh,
+                      TetrahedralizeConsumer &consumer,
+                      bool maintainFlatElements = false);
   
 } // ::umesh
 